@@ -0,0 +1,193 @@
+/**
+ * @file audit_log.h
+ * @brief Append-only audit log with an asynchronous, batching writer.
+ *
+ * append() moves a record into a lock-free MpscRing and returns; a single
+ * writer thread drains the ring in batches, runs the optional seal hook on
+ * each record (ComplianceLogger adds its SHA-256 there), and writes the
+ * batch as one CRC-32 checked frame with one write call. Durability is a
+ * group commit: depending on SyncPolicy the writer fsyncs after every
+ * batch, on an interval, or leaves it to the OS. When the ring is full,
+ * append() either waits for the writer (Block) or drops the record (Drop).
+ *
+ * Frames go into numbered segment files next to the base path
+ * (`<base>.000001.seg`). Each segment has a sidecar `.idx` with one entry
+ * per frame: offset, size, record count and the frame's timestamp range.
+ * read(start, end) consults the index and seeks straight to the frames
+ * that overlap the range. open() repairs an index that lags its segment
+ * after a crash and drops a torn trailing frame; openReadOnly() loads the
+ * segments for read() without touching the files.
+ *
+ * @note Thread Safety: append(), flush(), rotate(), read() and stats() may be
+ *       called from any thread. open() and close() must not race each other.
+ *
+ * @copyright MIT License
+ */
+#pragma once
+
+#include "mpsc_ring.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @struct AuditRecord
+ * @brief One log record: when, a caller-defined tag (e.g. a level), and text.
+ */
+struct AuditRecord {
+    int64_t timestampMs = 0;   ///< Milliseconds since the Unix epoch
+    uint32_t tag = 0;
+    std::string text;
+};
+
+/**
+ * @class AuditLog
+ * @brief Segment files fed by a background writer thread.
+ *
+ * @par Usage Example:
+ * @code
+ * AuditLog log;
+ * AuditLog::Options options;
+ * options.sync = AuditLog::SyncPolicy::EveryBatch;
+ * log.open("/var/log/rawrxd/compliance.log", options);
+ * log.append({nowMs, kAudit, "User=alice Action=ModelLoad"});
+ * log.flush();
+ * log.read(dayStartMs, dayEndMs, [](const AuditRecord& r) { ... });
+ * @endcode
+ */
+class AuditLog {
+public:
+    enum class SyncPolicy {
+        None,         ///< Never fsync; the OS writes back on its own schedule
+        Interval,     ///< fsync at most every syncIntervalMs while there is unsynced data
+        EveryBatch    ///< fsync after each frame before counting it durable
+    };
+
+    enum class Backpressure {
+        Block,        ///< append() waits for room in the ring
+        Drop          ///< append() drops the record and returns false
+    };
+
+    struct Options {
+        size_t ringCapacity = 16384;
+        size_t maxBatch = 4096;                 ///< Records per frame at most
+        SyncPolicy sync = SyncPolicy::Interval;
+        int syncIntervalMs = 1000;
+        Backpressure backpressure = Backpressure::Block;
+        uint64_t segmentBytes = 64ull << 20;    ///< Start a new segment beyond this size
+        std::function<void(AuditRecord&)> seal; ///< Runs on the writer thread before a record is written
+    };
+
+    struct Stats {
+        uint64_t appended = 0;   ///< Accepted by append()
+        uint64_t dropped = 0;    ///< Refused by a full ring under Backpressure::Drop, or appended while closed
+        uint64_t written = 0;    ///< Handed to the OS
+        uint64_t batches = 0;
+        uint64_t syncs = 0;
+        uint64_t bytes = 0;      ///< Frame bytes written, headers included
+        uint64_t writeErrors = 0;///< Records lost to a failed write or segment open
+        uint32_t segments = 0;
+    };
+
+    AuditLog();
+    ~AuditLog();
+
+    AuditLog(const AuditLog&) = delete;
+    AuditLog& operator=(const AuditLog&) = delete;
+
+    /// Loads the existing segments for basePath and starts a new one
+    bool open(const std::string& basePath, const Options& options);
+    bool open(const std::string& basePath) { return open(basePath, Options()); }
+
+    /// Loads the segments of basePath for read() without repairing them (frames a crash left
+    /// unindexed stay hidden until open()); fails while open
+    bool openReadOnly(const std::string& basePath);
+
+    /// Writes everything queued, syncs and stops the writer
+    void close();
+
+    bool isOpen() const { return m_open.load(std::memory_order_acquire); }
+
+    /// Hot path: no lock and no I/O unless the ring is full under Block
+    bool append(AuditRecord record);
+
+    /// Waits until every record appended before the call is written and, unless SyncPolicy::None, synced.
+    /// False if a record appended since the previous flush() could not be written
+    bool flush();
+
+    /// The next frame starts a new segment
+    void rotate();
+
+    /// Deletes closed segments whose newest record is older than cutoffMs
+    size_t removeSegmentsBefore(int64_t cutoffMs);
+
+    /// Calls fn for each record with startMs <= timestamp <= endMs, in write order; returns the count
+    size_t read(int64_t startMs, int64_t endMs, const std::function<void(const AuditRecord&)>& fn) const;
+
+    Stats stats() const;
+    const std::string& basePath() const { return m_basePath; }
+
+private:
+    struct Segment {
+        uint32_t seq = 0;
+        int64_t minTs = INT64_MAX;
+        int64_t maxTs = INT64_MIN;
+        uint64_t bytes = 0;
+        uint64_t frames = 0;
+    };
+
+    std::string segmentPath(uint32_t seq, const char* ext) const;
+    bool loadSegments(bool repair);
+    bool startSegment();
+    void closeSegment();
+    bool rollbackSegment(uint64_t segBytes, uint64_t frames);
+    void writerLoop();
+    void writeBatch(std::vector<AuditRecord>& batch);
+    void sync();
+
+    std::string m_basePath;
+    Options m_options;
+    std::unique_ptr<MpscRing<AuditRecord>> m_ring;
+    std::thread m_writer;
+    std::atomic<bool> m_open{false};
+
+    // Writer wake-up; producers only touch the mutex when the writer is idle
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCv;
+    std::atomic<bool> m_writerIdle{false};
+    std::atomic<bool> m_stopping{false};
+    std::atomic<bool> m_rotateWanted{false};
+    std::atomic<bool> m_flushWanted{false};
+
+    // Backpressure and flush() waiters
+    std::mutex m_progressMutex;
+    std::condition_variable m_progressCv;
+    std::atomic<int> m_blockedProducers{0};
+    std::atomic<uint64_t> m_durable{0};   ///< Ring positions written and synced (or failed)
+    std::atomic<uint64_t> m_failedThrough{0};  ///< Ring position past the last record that failed to write
+    std::atomic<uint64_t> m_flushedThrough{0}; ///< Ticket of the latest flush() to return
+
+    // Writer thread only
+    std::FILE* m_segFile = nullptr;
+    std::FILE* m_idxFile = nullptr;
+    bool m_dirty = false;
+    std::string m_frame;
+
+    mutable std::mutex m_catalogMutex;
+    std::vector<Segment> m_segments;      ///< Oldest first; the last is being written
+
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<uint64_t> m_batches{0};
+    std::atomic<uint64_t> m_syncs{0};
+    std::atomic<uint64_t> m_bytes{0};
+    std::atomic<uint64_t> m_writeErrors{0};
+};
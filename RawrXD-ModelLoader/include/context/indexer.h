@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace RawrXD {
+namespace Context {
+
+struct Symbol {
+    std::string name;
+    std::string kind;   // "class", "struct", "union", "enum", "function" or "variable"
+    std::string file;
+    int line = 0;
+};
+
+struct IndexStats {
+    size_t files_indexed = 0;   // Files on disk that the index covers
+    size_t files_parsed = 0;    // Files read and tokenized by this build
+    size_t files_unchanged = 0; // Skipped: same size and mtime, or same content hash
+    size_t files_removed = 0;   // Dropped: no longer on disk
+    size_t symbols_found = 0;
+};
+
+/**
+ * @brief C/C++ symbol index over a source tree
+ *
+ * Files are tokenized by hand (comments, strings, raw strings and
+ * preprocessor lines skipped) and declarations are read off the token
+ * stream at namespace and class scope: class, struct, union and enum
+ * definitions, function definitions (members, qualified, operators) and
+ * variables. Function bodies are only brace-matched.
+ *
+ * build() reads files on several threads. A file whose size and mtime
+ * match the last build is skipped without reading; one whose content hash
+ * matches is skipped without tokenizing. Lookups by name, kind and file go
+ * through hash maps. save() writes a compact file with interned names that
+ * load() maps into memory in one pass.
+ *
+ * Not thread-safe: build(), indexFile() and load() must not run during a
+ * lookup.
+ */
+class Indexer {
+public:
+    explicit Indexer(const std::string& root);
+
+    // Re-indexes new and changed files under the root, drops deleted ones
+    IndexStats build(bool recursive = true);
+
+    // Re-indexes one file after an edit; a missing file is dropped
+    void indexFile(const std::string& path);
+    void removeFile(const std::string& path);
+
+    std::vector<Symbol> findByName(const std::string& name) const;
+    std::vector<Symbol> findByKind(const std::string& kind) const;
+    std::vector<Symbol> findInFile(const std::string& file) const;
+
+    bool save(const std::string& file) const;
+    bool load(const std::string& file);   // False leaves the index empty
+
+    const std::string& root() const { return m_root; }
+    const IndexStats& stats() const { return m_stats; }
+    size_t symbolCount() const { return m_symbolCount; }
+
+    // threads <= 0 uses the hardware concurrency
+    void setThreadCount(int threads) { m_threads = threads; }
+
+    static bool isCodeFile(const std::string& path);
+
+    // Symbols of one file's text, in source order; file is left empty
+    static std::vector<Symbol> extractSymbols(const char* data, size_t size);
+
+private:
+    struct Entry {
+        uint32_t name;      // Index into m_names
+        uint8_t kind;
+        uint32_t line;
+    };
+
+    struct FileRecord {
+        std::string path;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t hash = 0;
+        bool live = false;
+        std::vector<Entry> symbols;
+    };
+
+    // (file id, symbol index) ordered by file, then symbol
+    using Ref = std::pair<uint32_t, uint32_t>;
+
+    uint32_t internName(const std::string& name);
+    uint32_t fileId(const std::string& path);
+    void setSymbols(uint32_t id, std::vector<Entry> symbols);
+    void dropFile(uint32_t id);
+    void clearIndex();
+    Symbol makeSymbol(const Ref& ref) const;
+
+    std::string m_root;
+    int m_threads = 0;
+    IndexStats m_stats;
+    size_t m_symbolCount = 0;
+
+    std::vector<FileRecord> m_files;
+    std::unordered_map<std::string, uint32_t> m_fileIds;
+
+    std::vector<std::string> m_names;
+    std::unordered_map<std::string, uint32_t> m_nameIds;
+
+    std::unordered_map<uint32_t, std::vector<Ref>> m_byName;  // By interned name
+    std::vector<std::vector<Ref>> m_byKind;                   // By kind code
+};
+
+} // namespace Context
+} // namespace RawrXD
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace RawrXD {
+namespace Context {
+
+struct EmbeddingItem {
+    std::string id;
+    std::string text;
+    std::vector<float> vec;
+};
+
+struct SearchResult {
+    std::string id;
+    std::string text;
+    float score = 0.0f;
+};
+
+// How SemanticStore keeps the normalised vectors
+enum class VectorStorage {
+    F32,   // 4 bytes per dimension, exact
+    F16,   // 2 bytes per dimension
+    Int8   // 1 byte per dimension plus one scale per row
+};
+
+/**
+ * @brief In-memory cosine search over code chunk embeddings
+ *
+ * Vectors are normalised once on upsert and kept as rows of one contiguous
+ * matrix, so a search is a dot product per row with no allocation or norm
+ * work. Rows scan on several threads with AVX2 kernels where available,
+ * each thread keeping a bounded heap of its best top_k. Ids map to rows
+ * through a hash; remove() moves the last row into the hole.
+ *
+ * The first non-empty vector fixes the dimension. Items whose vector is
+ * missing are stored but never returned; a vector of another dimension
+ * scores 0, as cosine() does. Not thread-safe for writes during search.
+ */
+class SemanticStore {
+public:
+    explicit SemanticStore(VectorStorage storage = VectorStorage::F32);
+
+    void upsert(const EmbeddingItem& item);
+    bool remove(const std::string& id);
+    void clear();
+
+    std::vector<SearchResult> search(const std::vector<float>& query, size_t top_k = 5) const;
+
+    size_t size() const { return m_ids.size(); }
+    size_t dimension() const { return m_dim; }
+    VectorStorage storage() const { return m_storage; }
+
+    // threads <= 0 uses the hardware concurrency
+    void setThreadCount(int threads) { m_threads = threads; }
+
+private:
+    void writeRow(size_t row, const std::vector<float>& vec);
+    void moveRow(size_t from, size_t to);
+
+    VectorStorage m_storage;
+    int m_threads = 0;
+    size_t m_dim = 0;
+
+    // Row-aligned metadata
+    std::vector<std::string> m_ids;
+    std::vector<std::string> m_texts;
+    std::vector<uint8_t> m_live;        // Row has a vector
+    std::unordered_map<std::string, size_t> m_rows;
+
+    // One of these holds the matrix, m_dim values per row
+    std::vector<float> m_f32;
+    std::vector<uint16_t> m_f16;
+    std::vector<int8_t> m_i8;
+    std::vector<float> m_scale;         // Int8 dequantisation scale per row
+};
+
+float cosine(const std::vector<float>& a, const std::vector<float>& b);
+
+} // namespace Context
+} // namespace RawrXD
@@ -0,0 +1,191 @@
+/**
+ * @file file_search_engine.h
+ * @brief Parallel byte-level project search behind MultiFileSearchWidget.
+ *
+ * FileSearchEngine walks a project tree on a pool of threads, each with its
+ * own deque of directory and file tasks; idle threads steal from the others.
+ * Files are mapped (or read, when small), binaries are skipped on a NUL byte
+ * in their first 8 KB, and the bytes are scanned for the query's literal with
+ * a vectorised first/last-byte filter. A regex only runs on lines the literal
+ * prefilter accepts, and line numbers are counted only up to each hit.
+ *
+ * The engine is plain C++ so the widget, the agent's file tools and the
+ * benchmark share it; regex matching is supplied by the caller as a
+ * LineMatcher (the widget passes QRegularExpression).
+ *
+ * @note Thread Safety: search() may run concurrently on distinct queries.
+ *       The batch callback and the LineMatcher are called from pool threads.
+ *
+ * @copyright MIT License
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct FileSearchHit
+ * @brief One match, with byte offsets into a UTF-8 line.
+ */
+struct FileSearchHit {
+    std::string path;       ///< Path of the file, as the walk produced it
+    int line = 0;           ///< 1-based line number
+    int column = 0;         ///< 0-based byte offset of the match within lineText
+    std::string lineText;   ///< Line containing the match, without the line break
+    std::string matchText;  ///< Matched bytes
+};
+
+/**
+ * @struct FileSearchStats
+ * @brief Counters for one search() call.
+ */
+struct FileSearchStats {
+    uint64_t filesSearched = 0;  ///< Text files scanned
+    uint64_t binarySkipped = 0;  ///< Files skipped for a NUL byte
+    uint64_t ignored = 0;        ///< Files and directories excluded by .gitignore or the filter
+    uint64_t bytesSearched = 0;  ///< Bytes of text scanned
+    uint64_t hits = 0;           ///< Matches reported
+    bool cancelled = false;      ///< The cancel flag stopped the walk
+};
+
+/**
+ * @struct FileSearchEntry
+ * @brief A file the walk would search (or a directory it entered), with what its stat said.
+ */
+struct FileSearchEntry {
+    std::string path;   ///< Path of the file, as the walk produced it
+    uint64_t size = 0;  ///< Size in bytes (0 for a directory)
+    int64_t mtime = 0;  ///< Last write time, in the file clock's ticks
+};
+
+/**
+ * @struct FileSearchQuery
+ * @brief What to look for.
+ *
+ * Without a matcher every occurrence of @c literal is a hit (non-overlapping,
+ * left to right). With a matcher, @c literal is only a prefilter: it must
+ * occur in every line the matcher could accept, and may be empty, in which
+ * case the matcher sees every line. Case folding of the literal is ASCII.
+ */
+struct FileSearchQuery {
+    /**
+     * @brief Finds matches in one line.
+     * @param line  Line bytes, without the line break
+     * @param size  Line length in bytes
+     * @param out   Receives (byte offset, byte length) pairs, left to right
+     */
+    using LineMatcher = std::function<void(const char* line, size_t size,
+                                           std::vector<std::pair<size_t, size_t>>& out)>;
+
+    std::string literal;        ///< Search text, or the regex prefilter
+    bool caseSensitive = true;  ///< Compare the literal byte for byte
+    LineMatcher matcher;        ///< Regex (or other) matcher for candidate lines
+};
+
+/**
+ * @class FileSearchEngine
+ * @brief Searches a directory tree for a FileSearchQuery.
+ *
+ * @par Usage Example:
+ * @code
+ * FileSearchEngine::Options options;
+ * options.fileFilter = "*.cpp, *.h";
+ * FileSearchQuery query;
+ * query.literal = "TODO";
+ * FileSearchEngine engine(options);
+ * engine.search("/path/to/project", query, [](std::vector<FileSearchHit>& batch) {
+ *     // Called on a pool thread
+ * });
+ * @endcode
+ */
+class FileSearchEngine {
+public:
+    /**
+     * @struct Options
+     * @brief Walk and delivery settings.
+     */
+    struct Options {
+        std::string fileFilter = "*";             ///< Comma-separated wildcards on the file name
+        bool useGitignore = true;                 ///< Honour .gitignore files found on the way down
+        int threads = 0;                          ///< Pool size; <= 0 uses the hardware concurrency
+        size_t batchSize = 256;                   ///< Hits per callback
+        int flushIntervalMs = 50;                 ///< Deliver a partial batch after this long
+        uint64_t maxFileSize = uint64_t(1) << 30; ///< Larger files are skipped
+        const std::atomic<bool>* cancel = nullptr; ///< Polled between files and hits
+    };
+
+    using BatchCallback = std::function<void(std::vector<FileSearchHit>& batch)>;
+
+    FileSearchEngine() = default;
+    explicit FileSearchEngine(const Options& options) : m_options(options) {}
+
+    const Options& options() const { return m_options; }
+    void setOptions(const Options& options) { m_options = options; }
+
+    /**
+     * @brief Search every file under @p root.
+     * @param root    Directory to walk (a single file is searched as is)
+     * @param query   Literal and optional matcher
+     * @param onBatch Receives hits in batches; may be empty to only count
+     * @return Counters for the run
+     *
+     * Hits of one file arrive in order; files arrive in no particular order.
+     */
+    FileSearchStats search(const std::string& root, const FileSearchQuery& query,
+                           const BatchCallback& onBatch) const;
+
+    /**
+     * @brief Search the given files only, skipping the walk and ignore rules.
+     *
+     * The file filter still applies. Used when an index has already narrowed
+     * the candidates.
+     */
+    FileSearchStats searchFiles(const std::vector<std::string>& files, const FileSearchQuery& query,
+                                const BatchCallback& onBatch) const;
+
+    /**
+     * @brief Walk @p root as search() would, without reading any file.
+     * @param directories If set, receives every directory the walk entered
+     *                    (including @p root and empty ones) with its mtime,
+     *                    in no particular order
+     * @return Every file search() would open, in no particular order
+     */
+    std::vector<FileSearchEntry> listFiles(const std::string& root,
+                                           std::vector<FileSearchEntry>* directories = nullptr) const;
+
+    /**
+     * @brief The part of a walk of @p root that lies under @p dir.
+     *
+     * The .gitignore files from @p root down to @p dir apply as they would in
+     * the full walk, and a @p dir the full walk would skip (hidden, ignored,
+     * behind a symlink, or gone) lists nothing. A @p dir outside @p root is
+     * walked as its own root.
+     * @param recursive   When false, only @p dir's own files are listed; its
+     *                    subdirectories go to @p directories without being entered
+     * @param directories If set, receives @p dir and every directory listed
+     *                    below it, with their mtimes
+     */
+    std::vector<FileSearchEntry> listFiles(const std::string& root, const std::string& dir, bool recursive,
+                                           std::vector<FileSearchEntry>* directories = nullptr) const;
+
+    /**
+     * @brief Longest literal every match of @p regex must contain.
+     * @param regex         Perl-style pattern
+     * @param caseSensitive When false, non-ASCII bytes end a literal (folding is ASCII)
+     * @return The literal, or empty when none can be proven (alternation, inline flags, ...)
+     */
+    static std::string requiredLiteral(const std::string& regex, bool caseSensitive);
+
+    /**
+     * @brief Glob match with gitignore rules: '*' and '?' stop at '/', '**' does not.
+     */
+    static bool globMatch(const char* pattern, const char* text);
+
+private:
+    Options m_options;
+};
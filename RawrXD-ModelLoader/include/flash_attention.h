@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tiled flash attention (kernels/flash_attn_avx2.cc)
+//
+// O = softmax(scale * Q K^T + mask) V for every query head, computed one
+// (query block x K/V block) tile at a time with an online softmax, so the
+// n_q x n_kv score matrix is never materialized and memory stays O(n).
+// Query heads share KV heads (GQA): head h reads KV head h / (n_head / n_kv_head).
+//
+// Element (token t, head h, dim d) of each tensor lives at
+// base[t * token_stride + h * head_stride + d]; strides are in floats, so both
+// interleaved [token][head][dim] rows and per-head [head][token][dim] planes work.
+typedef struct flash_attn_params {
+    const float* q;
+    const float* k;
+    const float* v;
+    float* o;
+    const int32_t* q_pos;       // Absolute position of each query; NULL = the last n_q of n_kv
+    int n_q;
+    int n_kv;
+    int n_head;
+    int n_kv_head;              // Must divide n_head
+    int head_dim;
+    ptrdiff_t q_token_stride;
+    ptrdiff_t q_head_stride;
+    ptrdiff_t kv_token_stride;  // Shared by k and v
+    ptrdiff_t kv_head_stride;
+    ptrdiff_t o_token_stride;
+    ptrdiff_t o_head_stride;
+    float scale;                // Usually 1 / sqrt(head_dim)
+    int causal;                 // Key j is visible to a query at position p iff j <= p
+} flash_attn_params;
+
+// Independent work items (head x query block). Items write disjoint output
+// rows, so callers split [0, n) across their own thread pool.
+int flash_attn_work_items(const flash_attn_params* p);
+
+// Compute work items [begin, end). Items are ordered longest first under a
+// causal mask, which keeps dynamically scheduled threads evenly loaded.
+void flash_attn_run(const flash_attn_params* p, int begin, int end);
+
+// Convenience for callers without a pool: all items on n_threads std::threads
+void flash_attn_forward_mt(const flash_attn_params* p, int n_threads);
+
+// Single head, no mask: Q/K/V/O are [seq_len][head_dim]
+void flash_attn_forward(const float* Q, const float* K, const float* V, float* O,
+                        int seq_len, int head_dim, bool force_scalar);
+
+#ifdef __cplusplus
+}
+#endif
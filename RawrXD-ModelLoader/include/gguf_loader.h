@@ -7,22 +7,27 @@
 #include <fstream>
 #include <unordered_map>
 #include "vulkan_compute.h"
+#include "gguf_parser.h"
 
 class VulkanCompute;
 
+// ggml_type ids as stored in the GGUF tensor table
 enum class GGMLType : uint32_t {
     F32 = 0,
     F16 = 1,
     Q4_0 = 2,
     Q4_1 = 3,
-    Q4_K = 10,
-    Q5_K = 11,
-    Q3_K = 12,
-    Q2_K = 9,
-    Q6_K = 13,
-    Q8_0 = 7,
-    Q5_1 = 5,
-    F16_HALF = 4,
+    Q5_0 = 6,
+    Q5_1 = 7,
+    Q8_0 = 8,
+    Q8_1 = 9,
+    Q2_K = 10,
+    Q3_K = 11,
+    Q4_K = 12,
+    Q5_K = 13,
+    Q6_K = 14,
+    Q8_K = 15,
+    BF16 = 30,
 };
 
 struct GGUFHeader {
@@ -68,7 +73,8 @@ public:
     virtual uint64_t GetFileSize() const = 0;
     // Streaming friendly methods (no-op for non-streaming loader)
     virtual bool BuildTensorIndex() = 0;
-    virtual bool LoadZone(const std::string& zone_name, uint64_t max_memory_mb = 512) = 0;
+    // max_memory_mb replaces the resident budget; 0 keeps the current one
+    virtual bool LoadZone(const std::string& zone_name, uint64_t max_memory_mb = 0) = 0;
     virtual bool UnloadZone(const std::string& zone_name) = 0;
     virtual std::vector<std::string> GetLoadedZones() const = 0;
     virtual std::vector<std::string> GetAllZones() const = 0;
@@ -92,11 +98,19 @@ public:
     bool ParseMetadata() override;
     GGUFMetadata GetMetadata() const override { return metadata_; }
     const std::vector<std::string>& GetVocabulary() const { return metadata_.tokens; }
+    // Typed metadata and tensor table (views valid until Close())
+    const gguf::Parser& GetParser() const { return parser_; }
+    // Fill the string-keyed summary from a parsed header (shared with StreamingGGUFLoader)
+    static void FillMetadata(const gguf::Parser& parser, GGUFMetadata& metadata);
     
     // Tensor operations
     std::vector<TensorInfo> GetTensorInfo() const override { return tensors_; }
     bool LoadTensorZone(const std::string& tensor_name, std::vector<uint8_t>& data) override;
     bool LoadTensorRange(size_t start_idx, size_t count, std::vector<uint8_t>& data) override;
+    // Zero-copy pointer into the read-only file mapping (nullptr when not mapped);
+    // valid until Close()
+    const void* GetTensorView(const std::string& tensor_name) const;
+    bool IsMemoryMapped() const { return use_mmap_; }
     void AttachVulkanEngine(VulkanCompute* engine) { vulkan_engine_ = engine; }
     
     // GGUF Alignment Helpers (tensor data section is 32-byte aligned per spec)
@@ -105,8 +119,8 @@ public:
         return (offset + GGUF_TENSOR_ALIGNMENT - 1) & ~(GGUF_TENSOR_ALIGNMENT - 1);
     }
     inline uint64_t GetAlignedTensorDataStart() const {
-        // Tensor data section starts after metadata + tensor info, aligned to 32 bytes
-        return AlignTo32Bytes(static_cast<uint64_t>(file_.tellg()));
+        // Tensor data section starts after metadata + tensor info, aligned to general.alignment
+        return parser_.DataOffset();
     }
     bool UploadAllTensorsToVulkan();
     bool UploadTensorToVulkan(const std::string& tensor_name);
@@ -119,7 +133,7 @@ public:
     
     // Streaming interface stubs (non-streaming loader - minimal implementations)
     bool BuildTensorIndex() override { return true; }  // Already built during ParseHeader
-    bool LoadZone(const std::string& zone_name, uint64_t max_memory_mb = 512) override { return true; }
+    bool LoadZone(const std::string& zone_name, uint64_t max_memory_mb = 0) override { return true; }
     bool UnloadZone(const std::string& zone_name) override { return true; }
     std::vector<std::string> GetLoadedZones() const override { return {"all"}; }
     std::vector<std::string> GetAllZones() const override { return {"all"}; }
@@ -132,6 +146,7 @@ private:
     GGUFHeader header_;
     GGUFMetadata metadata_;
     std::vector<TensorInfo> tensors_;
+    gguf::Parser parser_;
     // O(1) tensor lookup index (Bottleneck #14 fix - eliminates std::find_if O(n) search)
     std::unordered_map<std::string, const TensorInfo*> tensor_index_;
     bool is_open_;
@@ -140,17 +155,13 @@ private:
     bool use_dummy_mode_{false};  // Skip tensor loading for huge files
     uint64_t file_size_{0};
     
-    // Memory-mapped file support (Windows)
+    // Memory-mapped file support (MapViewOfFile on Windows, mmap elsewhere)
     void* mmap_base_{nullptr};
     void* file_handle_{nullptr};  // HANDLE on Windows
     void* map_handle_{nullptr};   // HANDLE on Windows
     bool use_mmap_{false};
     
     // Internal parsing helpers
-    template<typename T>
-    bool ReadValue(T& value);
-    bool ReadString(std::string& value);
-    bool ReadMetadataKV(const std::string& key, std::string& value);
     uint64_t CalculateTensorSize(const std::vector<uint64_t>& shape, GGMLType type) const;
     bool CreateDummyModel();
     bool InitializeMemoryMap();
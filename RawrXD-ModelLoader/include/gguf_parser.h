@@ -0,0 +1,481 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// GGUF PARSER - single pass over the v2/v3 header, metadata and tensor table
+//
+// Shared by GGUFLoader, StreamingGGUFLoader, the Qt GGUFLoader and
+// VocabularyLoader. Keys, strings and arrays are views into the parsed bytes
+// (a file mapping, or a prefix buffer owned by the parser); arrays are only
+// decoded when a caller walks them, so a 100k-token vocabulary costs one scan
+// of the length prefixes and no string allocations.
+// ============================================================================
+
+namespace gguf {
+
+// Metadata value types (gguf.md)
+enum class ValueType : uint32_t {
+    UINT8 = 0, INT8 = 1, UINT16 = 2, INT16 = 3, UINT32 = 4, INT32 = 5,
+    FLOAT32 = 6, BOOL = 7, STRING = 8, ARRAY = 9, UINT64 = 10, INT64 = 11,
+    FLOAT64 = 12,
+};
+
+inline size_t ScalarSize(ValueType type) {
+    switch (type) {
+        case ValueType::UINT8: case ValueType::INT8: case ValueType::BOOL: return 1;
+        case ValueType::UINT16: case ValueType::INT16: return 2;
+        case ValueType::UINT32: case ValueType::INT32: case ValueType::FLOAT32: return 4;
+        case ValueType::UINT64: case ValueType::INT64: case ValueType::FLOAT64: return 8;
+        default: return 0;
+    }
+}
+
+inline const char* ValueTypeName(ValueType type) {
+    switch (type) {
+        case ValueType::UINT8: return "u8";
+        case ValueType::INT8: return "i8";
+        case ValueType::UINT16: return "u16";
+        case ValueType::INT16: return "i16";
+        case ValueType::UINT32: return "u32";
+        case ValueType::INT32: return "i32";
+        case ValueType::FLOAT32: return "f32";
+        case ValueType::BOOL: return "bool";
+        case ValueType::STRING: return "string";
+        case ValueType::ARRAY: return "array";
+        case ValueType::UINT64: return "u64";
+        case ValueType::INT64: return "i64";
+        case ValueType::FLOAT64: return "f64";
+        default: return "unknown";
+    }
+}
+
+// Forward iteration over a string array; each element is a view into the file
+class StringArrayIterator {
+public:
+    StringArrayIterator(const uint8_t* p, uint64_t remaining) : p_(p), remaining_(remaining) {}
+    std::string_view operator*() const {
+        uint64_t len;
+        std::memcpy(&len, p_, sizeof(len));
+        return {reinterpret_cast<const char*>(p_ + sizeof(len)), static_cast<size_t>(len)};
+    }
+    StringArrayIterator& operator++() {
+        uint64_t len;
+        std::memcpy(&len, p_, sizeof(len));
+        p_ += sizeof(len) + len;
+        --remaining_;
+        return *this;
+    }
+    bool operator!=(const StringArrayIterator& other) const { return remaining_ != other.remaining_; }
+
+private:
+    const uint8_t* p_;
+    uint64_t remaining_;
+};
+
+struct StringArrayRange {
+    const uint8_t* data;
+    uint64_t count;
+    StringArrayIterator begin() const { return {data, count}; }
+    StringArrayIterator end() const { return {data, 0}; }
+};
+
+// One metadata value; payload bytes stay in the parsed buffer
+struct Value {
+    ValueType type{ValueType::UINT8};
+    ValueType elem_type{ValueType::UINT8};  // arrays only
+    const uint8_t* data{nullptr};           // scalar bytes, string bytes, or first array element
+    uint64_t length{0};                     // string byte length, or array element count
+
+    bool IsArray() const { return type == ValueType::ARRAY; }
+    bool IsString() const { return type == ValueType::STRING; }
+
+    template<typename T>
+    static T Load(const uint8_t* p) {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        return v;
+    }
+
+    // Numeric scalar at p converted to double (also used for array elements)
+    static double ScalarAsDouble(ValueType t, const uint8_t* p) {
+        switch (t) {
+            case ValueType::UINT8: case ValueType::BOOL: return Load<uint8_t>(p);
+            case ValueType::INT8: return Load<int8_t>(p);
+            case ValueType::UINT16: return Load<uint16_t>(p);
+            case ValueType::INT16: return Load<int16_t>(p);
+            case ValueType::UINT32: return Load<uint32_t>(p);
+            case ValueType::INT32: return Load<int32_t>(p);
+            case ValueType::FLOAT32: return Load<float>(p);
+            case ValueType::UINT64: return static_cast<double>(Load<uint64_t>(p));
+            case ValueType::INT64: return static_cast<double>(Load<int64_t>(p));
+            case ValueType::FLOAT64: return Load<double>(p);
+            default: return 0.0;
+        }
+    }
+
+    static int64_t ScalarAsInt(ValueType t, const uint8_t* p) {
+        switch (t) {
+            case ValueType::UINT64: return static_cast<int64_t>(Load<uint64_t>(p));
+            case ValueType::INT64: return Load<int64_t>(p);
+            case ValueType::FLOAT32: case ValueType::FLOAT64: return static_cast<int64_t>(ScalarAsDouble(t, p));
+            default: return ScalarSize(t) ? static_cast<int64_t>(ScalarAsDouble(t, p)) : 0;
+        }
+    }
+
+    bool IsScalar() const { return ScalarSize(type) != 0; }
+    int64_t ToInt(int64_t fallback = 0) const { return IsScalar() ? ScalarAsInt(type, data) : fallback; }
+    double ToDouble(double fallback = 0.0) const { return IsScalar() ? ScalarAsDouble(type, data) : fallback; }
+    bool ToBool(bool fallback = false) const { return IsScalar() ? ScalarAsInt(type, data) != 0 : fallback; }
+
+    std::string_view ToStringView() const {
+        return IsString() ? std::string_view(reinterpret_cast<const char*>(data), static_cast<size_t>(length))
+                          : std::string_view();
+    }
+
+    // Human readable form for key/value dumps; arrays are summarised, not expanded
+    std::string ToDisplayString() const {
+        if (IsString()) return std::string(ToStringView());
+        if (IsArray()) return "[" + std::to_string(length) + " x " + ValueTypeName(elem_type) + "]";
+        if (type == ValueType::BOOL) return ToBool() ? "true" : "false";
+        if (type == ValueType::FLOAT32 || type == ValueType::FLOAT64) return std::to_string(ToDouble());
+        if (type == ValueType::UINT64) return std::to_string(Load<uint64_t>(data));
+        return std::to_string(ToInt());
+    }
+
+    // Array accessors
+    uint64_t ArraySize() const { return IsArray() ? length : 0; }
+    bool IsScalarArray() const { return IsArray() && ScalarSize(elem_type) != 0; }
+    // Raw little-endian elements of a scalar array (e.g. f32 token scores)
+    const void* ArrayData() const { return IsScalarArray() ? data : nullptr; }
+    double ArrayDouble(uint64_t i) const { return ScalarAsDouble(elem_type, data + i * ScalarSize(elem_type)); }
+    int64_t ArrayInt(uint64_t i) const { return ScalarAsInt(elem_type, data + i * ScalarSize(elem_type)); }
+    StringArrayRange Strings() const {
+        return (IsArray() && elem_type == ValueType::STRING) ? StringArrayRange{data, length}
+                                                              : StringArrayRange{data, 0};
+    }
+};
+
+// One tensor table entry; offset is absolute within the file
+struct TensorDesc {
+    std::string_view name;
+    uint32_t type{0};        // ggml_type id
+    uint32_t n_dims{0};
+    uint64_t ne[4]{1, 1, 1, 1};
+    uint64_t offset{0};
+    uint64_t size_bytes{0};  // 0 if the type is unknown
+
+    uint64_t ElementCount() const { return ne[0] * ne[1] * ne[2] * ne[3]; }
+};
+
+// Elements and bytes per block for each ggml_type id
+inline bool TypeLayout(uint32_t type, uint64_t& block_elems, uint64_t& block_bytes) {
+    struct Layout { uint32_t type; uint64_t elems; uint64_t bytes; };
+    static constexpr Layout kLayouts[] = {
+        {0, 1, 4},       // F32
+        {1, 1, 2},       // F16
+        {2, 32, 18},     // Q4_0
+        {3, 32, 20},     // Q4_1
+        {6, 32, 22},     // Q5_0
+        {7, 32, 24},     // Q5_1
+        {8, 32, 34},     // Q8_0
+        {9, 32, 36},     // Q8_1
+        {10, 256, 84},   // Q2_K
+        {11, 256, 110},  // Q3_K
+        {12, 256, 144},  // Q4_K
+        {13, 256, 176},  // Q5_K
+        {14, 256, 210},  // Q6_K
+        {15, 256, 292},  // Q8_K
+        {16, 256, 66},   // IQ2_XXS
+        {17, 256, 74},   // IQ2_XS
+        {18, 256, 98},   // IQ3_XXS
+        {19, 256, 50},   // IQ1_S
+        {20, 32, 18},    // IQ4_NL
+        {21, 256, 110},  // IQ3_S
+        {22, 256, 82},   // IQ2_S
+        {23, 256, 136},  // IQ4_XS
+        {24, 1, 1},      // I8
+        {25, 1, 2},      // I16
+        {26, 1, 4},      // I32
+        {27, 1, 8},      // I64
+        {28, 1, 8},      // F64
+        {29, 256, 56},   // IQ1_M
+        {30, 1, 2},      // BF16
+    };
+    for (const Layout& l : kLayouts) {
+        if (l.type == type) {
+            block_elems = l.elems;
+            block_bytes = l.bytes;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bytes occupied by n_elements of a ggml_type, or 0 for unknown types
+inline uint64_t TensorBytes(uint32_t type, uint64_t n_elements) {
+    uint64_t block_elems = 0, block_bytes = 0;
+    if (!TypeLayout(type, block_elems, block_bytes)) return 0;
+    return (n_elements + block_elems - 1) / block_elems * block_bytes;
+}
+
+class Parser {
+public:
+    enum class Status { Ok, Truncated, Invalid };
+
+    static constexpr uint32_t kMagic = 0x46554747;  // "GGUF"
+    static constexpr uint32_t kDefaultAlignment = 32;
+
+    Parser() = default;
+    Parser(const Parser&) = delete;             // views point into owned_
+    Parser& operator=(const Parser&) = delete;
+    Parser(Parser&&) = default;
+    Parser& operator=(Parser&&) = default;
+
+    /**
+     * Parse header, metadata and tensor table from memory that stays valid
+     * for the parser's lifetime (typically the file mapping). Truncated means
+     * the buffer ends inside the header; no views are retained in that case.
+     */
+    Status Parse(const void* data, size_t size) {
+        Reset();
+        Cursor c{static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size};
+
+        uint32_t magic = 0;
+        if (!c.Read(magic)) return Fail(Status::Truncated, "header truncated");
+        if (magic != kMagic) return Fail(Status::Invalid, "invalid GGUF magic");
+        if (!c.Read(version_)) return Fail(Status::Truncated, "header truncated");
+        if (version_ < 2 || version_ > 3) {
+            return Fail(Status::Invalid, "unsupported GGUF version " + std::to_string(version_));
+        }
+        if (!c.Read(tensor_count_) || !c.Read(kv_count_)) return Fail(Status::Truncated, "header truncated");
+
+        // Counts come from the file; cap reservations by what the buffer could hold
+        metadata_.reserve(static_cast<size_t>(std::min<uint64_t>(kv_count_, size / 16)));
+        for (uint64_t i = 0; i < kv_count_; ++i) {
+            std::string_view key;
+            uint32_t raw_type = 0;
+            if (!c.ReadString(key) || !c.Read(raw_type)) return Fail(Status::Truncated, "metadata truncated");
+            Value value;
+            value.type = static_cast<ValueType>(raw_type);
+            const Status s = ReadValue(c, value);
+            if (s != Status::Ok) {
+                return Fail(s, s == Status::Invalid ? "bad value type for key " + std::string(key)
+                                                    : "metadata truncated");
+            }
+            metadata_.emplace_back(key, value);
+        }
+        key_index_.reserve(metadata_.size());
+        for (size_t i = 0; i < metadata_.size(); ++i) key_index_.emplace(metadata_[i].first, i);
+
+        if (const Value* a = Find("general.alignment")) {
+            const int64_t align = a->ToInt(0);
+            alignment_ = align > 0 ? static_cast<uint32_t>(align) : kDefaultAlignment;
+        }
+
+        tensors_.reserve(static_cast<size_t>(std::min<uint64_t>(tensor_count_, size / 32)));
+        for (uint64_t i = 0; i < tensor_count_; ++i) {
+            TensorDesc t;
+            if (!c.ReadString(t.name) || !c.Read(t.n_dims)) return Fail(Status::Truncated, "tensor table truncated");
+            if (t.n_dims == 0 || t.n_dims > 4) {
+                return Fail(Status::Invalid, "bad rank for tensor " + std::string(t.name));
+            }
+            for (uint32_t d = 0; d < t.n_dims; ++d) {
+                if (!c.Read(t.ne[d])) return Fail(Status::Truncated, "tensor table truncated");
+            }
+            if (!c.Read(t.type) || !c.Read(t.offset)) return Fail(Status::Truncated, "tensor table truncated");
+            t.size_bytes = TensorBytes(t.type, t.ElementCount());
+            tensors_.push_back(t);
+        }
+
+        header_bytes_ = static_cast<uint64_t>(c.p - static_cast<const uint8_t*>(data));
+        data_offset_ = (header_bytes_ + alignment_ - 1) / alignment_ * alignment_;
+        tensor_index_.reserve(tensors_.size());
+        for (size_t i = 0; i < tensors_.size(); ++i) {
+            tensors_[i].offset += data_offset_;
+            tensor_index_.emplace(tensors_[i].name, i);
+        }
+        return Status::Ok;
+    }
+
+    /**
+     * Parse from a reader when no mapping is available. Reads a prefix of the
+     * file into an owned buffer and grows it until the whole header fits.
+     * @param read  size_t(uint64_t offset, void* dst, size_t n), returns bytes read
+     * @param file_size  Total file size, bounds the prefix
+     */
+    template<typename ReadFn>
+    Status ParseFrom(ReadFn&& read, uint64_t file_size, size_t initial_bytes = 1 << 20) {
+        std::vector<uint8_t> buffer;
+        size_t want = static_cast<size_t>(std::min<uint64_t>(initial_bytes, file_size));
+        for (;;) {
+            const size_t have = buffer.size();
+            buffer.resize(want);
+            if (read(static_cast<uint64_t>(have), buffer.data() + have, want - have) != want - have) {
+                Reset();
+                return Fail(Status::Invalid, "short read");
+            }
+            const Status s = Parse(buffer.data(), buffer.size());
+            if (s != Status::Truncated) {
+                owned_ = std::move(buffer);  // Moving keeps the heap block, so views stay valid
+                return s;
+            }
+            if (want >= file_size) return s;
+            want = static_cast<size_t>(std::min<uint64_t>(static_cast<uint64_t>(want) * 4, file_size));
+        }
+    }
+
+    // ---- Header ----
+    uint32_t Version() const { return version_; }
+    uint64_t TensorCount() const { return tensor_count_; }
+    uint64_t KVCount() const { return kv_count_; }
+    uint32_t Alignment() const { return alignment_; }
+    uint64_t HeaderBytes() const { return header_bytes_; }  // End of the tensor table
+    uint64_t DataOffset() const { return data_offset_; }    // Aligned start of tensor data
+    const std::string& Error() const { return error_; }
+
+    // ---- Metadata ----
+    const std::vector<std::pair<std::string_view, Value>>& Metadata() const { return metadata_; }
+
+    const Value* Find(std::string_view key) const {
+        auto it = key_index_.find(key);
+        return it == key_index_.end() ? nullptr : &metadata_[it->second].second;
+    }
+
+    int64_t GetInt(std::string_view key, int64_t fallback = 0) const {
+        const Value* v = Find(key);
+        return v ? v->ToInt(fallback) : fallback;
+    }
+
+    double GetDouble(std::string_view key, double fallback = 0.0) const {
+        const Value* v = Find(key);
+        return v ? v->ToDouble(fallback) : fallback;
+    }
+
+    std::string_view GetString(std::string_view key, std::string_view fallback = {}) const {
+        const Value* v = Find(key);
+        return v && v->IsString() ? v->ToStringView() : fallback;
+    }
+
+    std::string_view Architecture() const { return GetString("general.architecture"); }
+
+    // "<architecture>.<suffix>", e.g. GetArchInt("block_count") -> llama.block_count
+    int64_t GetArchInt(std::string_view suffix, int64_t fallback = 0) const {
+        const std::string_view arch = Architecture();
+        if (arch.empty()) return fallback;
+        std::string key;
+        key.reserve(arch.size() + 1 + suffix.size());
+        key.append(arch).append(1, '.').append(suffix);
+        return GetInt(key, fallback);
+    }
+
+    // ---- Tensors ----
+    const std::vector<TensorDesc>& Tensors() const { return tensors_; }
+
+    const TensorDesc* FindTensor(std::string_view name) const {
+        auto it = tensor_index_.find(name);
+        return it == tensor_index_.end() ? nullptr : &tensors_[it->second];
+    }
+
+private:
+    struct Cursor {
+        const uint8_t* p;
+        const uint8_t* end;
+
+        bool Skip(uint64_t n) {
+            if (n > static_cast<uint64_t>(end - p)) return false;
+            p += n;
+            return true;
+        }
+        template<typename T>
+        bool Read(T& out) {
+            if (sizeof(T) > static_cast<size_t>(end - p)) return false;
+            std::memcpy(&out, p, sizeof(T));
+            p += sizeof(T);
+            return true;
+        }
+        bool ReadString(std::string_view& out) {
+            uint64_t len = 0;
+            if (!Read(len) || len > static_cast<uint64_t>(end - p)) return false;
+            out = std::string_view(reinterpret_cast<const char*>(p), static_cast<size_t>(len));
+            p += len;
+            return true;
+        }
+    };
+
+    // Records where the payload lives and steps over it; arrays are not decoded
+    static Status ReadValue(Cursor& c, Value& value) {
+        if (value.type == ValueType::STRING) {
+            std::string_view s;
+            if (!c.ReadString(s)) return Status::Truncated;
+            value.data = reinterpret_cast<const uint8_t*>(s.data());
+            value.length = s.size();
+            return Status::Ok;
+        }
+        if (value.type == ValueType::ARRAY) {
+            uint32_t raw_elem = 0;
+            if (!c.Read(raw_elem) || !c.Read(value.length)) return Status::Truncated;
+            value.elem_type = static_cast<ValueType>(raw_elem);
+            value.data = c.p;
+            if (value.elem_type == ValueType::STRING) {
+                for (uint64_t i = 0; i < value.length; ++i) {
+                    uint64_t len = 0;
+                    if (!c.Read(len) || !c.Skip(len)) return Status::Truncated;
+                }
+                return Status::Ok;
+            }
+            const size_t elem = ScalarSize(value.elem_type);
+            if (elem == 0) return Status::Invalid;  // Nested arrays are not used by GGUF writers
+            if (value.length > static_cast<uint64_t>(c.end - c.p) / elem) return Status::Truncated;
+            c.p += value.length * elem;
+            return Status::Ok;
+        }
+        const size_t size = ScalarSize(value.type);
+        if (size == 0) return Status::Invalid;
+        value.data = c.p;
+        return c.Skip(size) ? Status::Ok : Status::Truncated;
+    }
+
+    void Reset() {
+        owned_.clear();
+        metadata_.clear();
+        key_index_.clear();
+        tensors_.clear();
+        tensor_index_.clear();
+        version_ = 0;
+        tensor_count_ = kv_count_ = 0;
+        alignment_ = kDefaultAlignment;
+        header_bytes_ = data_offset_ = 0;
+        error_.clear();
+    }
+
+    Status Fail(Status s, std::string message) {
+        metadata_.clear();
+        key_index_.clear();
+        tensors_.clear();
+        tensor_index_.clear();
+        error_ = std::move(message);
+        return s;
+    }
+
+    std::vector<uint8_t> owned_;  // Header prefix when parsing without a mapping
+    std::vector<std::pair<std::string_view, Value>> metadata_;
+    std::unordered_map<std::string_view, size_t> key_index_;
+    std::vector<TensorDesc> tensors_;
+    std::unordered_map<std::string_view, size_t> tensor_index_;
+    uint32_t version_{0};
+    uint64_t tensor_count_{0};
+    uint64_t kv_count_{0};
+    uint32_t alignment_{kDefaultAlignment};
+    uint64_t header_bytes_{0};
+    uint64_t data_offset_{0};
+    std::string error_;
+};
+
+} // namespace gguf
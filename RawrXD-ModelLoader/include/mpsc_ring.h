@@ -0,0 +1,98 @@
+/**
+ * @file mpsc_ring.h
+ * @brief Bounded lock-free queue for many producers and one consumer.
+ *
+ * Each cell carries a sequence number (Vyukov's bounded queue): a producer
+ * claims a position with one CAS on the tail and publishes the value by
+ * bumping the cell's sequence; the single consumer reads cells in order
+ * without any atomic read-modify-write. tryPush() fails instead of waiting
+ * when the ring is full, so the caller chooses the backpressure policy.
+ *
+ * @note Thread Safety: tryPush() and pushed() from any thread; tryPop() and
+ *       empty() from the one consumer thread only.
+ *
+ * @copyright MIT License
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+template <typename T>
+class MpscRing {
+public:
+    /// Capacity is rounded up to a power of two (at least 2)
+    explicit MpscRing(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        m_mask = size - 1;
+        m_cells = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    /// False when the ring is full; value is left untouched then
+    bool tryPush(T&& value)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = m_cells[pos & m_mask];
+            const size_t seq = cell.seq.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& out)
+    {
+        Cell& cell = m_cells[m_head & m_mask];
+        const size_t seq = cell.seq.load(std::memory_order_acquire);
+        if (intptr_t(seq) - intptr_t(m_head + 1) < 0) return false;
+        out = std::move(cell.value);
+        cell.value = T();
+        cell.seq.store(m_head + m_mask + 1, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+
+    /// Nothing published at the head (a claimed but unfilled cell counts as empty)
+    bool empty() const
+    {
+        const Cell& cell = m_cells[m_head & m_mask];
+        return intptr_t(cell.seq.load(std::memory_order_acquire)) - intptr_t(m_head + 1) < 0;
+    }
+
+    /// Positions claimed by producers so far; popped() reaches it once they are consumed
+    size_t pushed() const { return m_tail.load(std::memory_order_acquire); }
+    size_t popped() const { return m_head; }
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq{0};
+        T value{};
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) size_t m_head = 0;
+};
@@ -3,7 +3,8 @@
  * @brief VS Code-style multi-file search widget for RawrXD IDE.
  *
  * Provides a complete implementation of project-wide text search with:
- * - Asynchronous file traversal and search (QtConcurrent)
+ * - Parallel file traversal and search (FileSearchEngine)
+ * - Persistent trigram index that narrows searches to candidate files
  * - .gitignore-aware file filtering
  * - Regex and literal text search modes
  * - Case-sensitive/insensitive matching
@@ -12,9 +13,16 @@
  * - Interactive tree view with file grouping
  *
  * @par Architecture:
- * The widget uses QFutureWatcher to run searches on a background thread,
- * collecting results via thread-safe queue protected by QMutex. Results
- * are batched and emitted to the UI thread via queued signal connections.
+ * The widget uses QFutureWatcher to run each search on a background thread,
+ * which drives a FileSearchEngine over a pool of worker threads. Workers
+ * deliver hits in batches into a thread-safe queue protected by QMutex; each
+ * batch is announced to the UI thread via a queued signal connection.
+ *
+ * Setting the project root also builds (or loads and refreshes) a TrigramIndex
+ * for the enclosing project in the background. Once it is ready, searches with
+ * a literal of three or more bytes scan only the files the index returns;
+ * directory change notifications and notifyFileChanged() keep it current.
+ * Directories past the watch limit are checked by mtime before each search.
  *
  * @par Keyboard Shortcuts:
  * - Enter: Start search / Navigate to selected result
@@ -43,11 +51,19 @@
 #include <QMutex>
 #include <QFutureWatcher>
 #include <QRegularExpression>
+#include <QHash>
+#include <QStringList>
 #include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "file_manager.h"
 
+class QFileSystemWatcher;
+class TrigramIndex;
+
 /**
  * @class MultiFileSearchWidget
  * @brief Complete multi-file search panel with async search and result navigation.
@@ -105,6 +121,9 @@ public:
      * - File traversal during search
      * - Relative path display in results
      * - .gitignore file discovery
+     *
+     * Also starts the background index build for the project that contains
+     * @p path (as found by ProjectDetector).
      */
     void setProjectRoot(const QString& path);
 
@@ -172,6 +191,15 @@ public slots:
      */
     void focusSearchInput();
 
+    /**
+     * @brief Re-indexes a file the IDE has just saved, created or deleted.
+     * @param path Absolute path of the file
+     *
+     * Directory watching only reports added and removed entries, so editors
+     * call this after writing a file to keep indexed searches exact.
+     */
+    void notifyFileChanged(const QString& path);
+
 signals:
     /**
      * @brief Emitted when user double-clicks or presses Enter on a result.
@@ -221,6 +249,11 @@ private slots:
      */
     void onSearchFinished();
 
+    /**
+     * @brief Watches the indexed directories once a build or update finishes.
+     */
+    void onIndexUpdated();
+
 private:
     /**
      * @brief Core search implementation running on background thread.
@@ -230,8 +263,9 @@ private:
      * @param caseSensitive Whether matching is case-sensitive
      * @param fileFilter Glob patterns for file filtering (comma-separated)
      *
-     * Traverses the project directory, respects .gitignore rules, and
-     * collects matches into the thread-safe results queue.
+     * Runs a FileSearchEngine over the project directory (.gitignore rules,
+     * binary skipping and the literal prefilter live there) and converts each
+     * batch of hits into the thread-safe results queue.
      */
     void performSearch(const QString& searchText,
                        const QString& rootPath,
@@ -239,22 +273,6 @@ private:
                        bool caseSensitive,
                        const QString& fileFilter);
 
-    /**
-     * @brief Parses .gitignore files and builds exclusion patterns.
-     * @param rootPath Project root containing .gitignore
-     * @return List of compiled regex patterns for ignored paths
-     */
-    QVector<QRegularExpression> loadGitignorePatterns(const QString& rootPath);
-
-    /**
-     * @brief Checks if a file path should be excluded from search.
-     * @param filePath Absolute path to check
-     * @param patterns Compiled gitignore patterns
-     * @return true if the file should be skipped
-     */
-    bool isIgnored(const QString& filePath,
-                   const QVector<QRegularExpression>& patterns);
-
     /**
      * @brief Adds a result to the tree view, grouped by file.
      * @param result The search result to add
@@ -269,6 +287,23 @@ private:
      */
     void updateStatus(const QString& message);
 
+    /**
+     * @brief Loads, refreshes and saves the index for the current project root.
+     *
+     * Cancels a build already running. The index is unused until it finishes.
+     */
+    void startIndexBuild();
+
+    /**
+     * @brief Queues a file or directory for re-indexing on the index thread.
+     */
+    void queueIndexUpdate(const QString& path);
+
+    /**
+     * @brief Applies queued updates; runs on the index thread until the queue is empty.
+     */
+    void drainIndexQueue();
+
     // ─────────────────────────────────────────────────────────────────────
     // UI Components
     // ─────────────────────────────────────────────────────────────────────
@@ -281,6 +316,7 @@ private:
     QPushButton* m_searchButton;       ///< Search/Cancel button
     QTreeWidget* m_resultsTree;        ///< Grouped results display
     QLabel* m_statusLabel;             ///< Search status and result count
+    QHash<QString, QTreeWidgetItem*> m_fileItems; ///< File group node per path
 
     // ─────────────────────────────────────────────────────────────────────
     // Search State
@@ -298,4 +334,19 @@ private:
     mutable QMutex m_resultsMutex;                            ///< Protects m_pendingResults
     std::vector<MultiFileSearchResult> m_pendingResults;      ///< Results waiting for UI update
     int m_totalResultCount = 0;                               ///< Running total of matches found
+
+    // ─────────────────────────────────────────────────────────────────────
+    // Trigram Index
+    // ─────────────────────────────────────────────────────────────────────
+
+    std::unique_ptr<TrigramIndex> m_index;                    ///< Candidate files per literal
+    std::atomic<bool> m_indexCancelled{false};                ///< Stops the build and queued updates
+    std::atomic<bool> m_indexReady{false};                    ///< Index reflects the current project
+    std::atomic<bool> m_watchComplete{false};                 ///< Every indexed directory is watched
+    std::shared_ptr<const std::unordered_set<std::string>> m_watchedDirectories; ///< Guarded by m_indexMutex
+    QFutureWatcher<void>* m_indexWatcher = nullptr;           ///< Build or update task
+    QFileSystemWatcher* m_directoryWatcher = nullptr;         ///< Change notifications for indexed directories
+    QMutex m_indexMutex;                                      ///< Protects m_indexQueue, m_indexBusy and m_watchedDirectories
+    QStringList m_indexQueue;                                 ///< Paths waiting to be re-indexed
+    bool m_indexBusy = false;                                 ///< An index task is running or about to
 };
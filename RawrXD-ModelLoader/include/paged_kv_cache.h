@@ -0,0 +1,128 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// PAGED KV CACHE - Block-based K/V storage shared by many sequences
+// ============================================================================
+//
+// One pool is allocated up front and carved into fixed-size blocks of
+// block_size token positions. Each sequence owns a block table mapping its
+// logical positions to physical slots, so memory follows live tokens rather
+// than max context × sessions. Forked sequences share blocks copy-on-write,
+// and when the pool runs dry the least recently used idle sequence is evicted.
+//
+// Pool layout is plane-major: for every layer a K plane and a V plane of
+// [num_blocks * block_size][kv_dim] floats, so a plane can be wrapped as one
+// 2-D tensor whose rows are slots (slot = block * block_size + offset).
+
+struct PagedKVConfig {
+    uint32_t n_layers = 0;
+    uint32_t kv_dim = 0;                // Floats per K row (and per V row)
+    uint32_t block_size = 16;           // Token positions per block
+    uint32_t num_blocks = 0;            // Blocks in the preallocated pool
+};
+
+struct PagedKVStats {
+    uint32_t total_blocks = 0;
+    uint32_t free_blocks = 0;
+    uint32_t shared_blocks = 0;         // Blocks referenced by more than one sequence
+    uint32_t sequences = 0;
+    uint64_t live_tokens = 0;           // Sum of sequence lengths
+    uint64_t cow_copies = 0;            // Blocks duplicated on first write after a fork
+    uint64_t evicted_sequences = 0;
+};
+
+class PagedKVCache {
+public:
+    using SeqId = int32_t;
+    using EvictCallback = std::function<void(SeqId)>;
+    
+    PagedKVCache() = default;
+    ~PagedKVCache() = default;
+    PagedKVCache(const PagedKVCache&) = delete;
+    PagedKVCache& operator=(const PagedKVCache&) = delete;
+    
+    // ---- Pool ----
+    bool Init(const PagedKVConfig& config);   // Allocates and zeroes the pool
+    void Release();
+    bool IsInitialized() const { return pool_ != nullptr; }
+    const PagedKVConfig& GetConfig() const { return config_; }
+    uint32_t SlotCount() const { return config_.num_blocks * config_.block_size; }
+    
+    float* PoolData() { return pool_.get(); }
+    size_t PoolBytes() const { return pool_floats_ * sizeof(float); }
+    float* KeyPlane(uint32_t layer) { return Plane(layer, 0); }
+    float* ValuePlane(uint32_t layer) { return Plane(layer, 1); }
+    float* KeyRow(uint32_t layer, int64_t slot) { return KeyPlane(layer) + slot * config_.kv_dim; }
+    float* ValueRow(uint32_t layer, int64_t slot) { return ValuePlane(layer) + slot * config_.kv_dim; }
+    
+    // ---- Sequences ----
+    bool AddSequence(SeqId seq);
+    bool ForkSequence(SeqId parent, SeqId child);   // Child shares parent's blocks
+    bool RemoveSequence(SeqId seq);
+    bool HasSequence(SeqId seq) const;
+    uint32_t SequenceLength(SeqId seq) const;
+    bool TruncateSequence(SeqId seq, uint32_t n_tokens);
+    std::vector<SeqId> GetSequences() const;
+    
+    // Pinned sequences are never evicted (e.g. the one being decoded)
+    void SetPinned(SeqId seq, bool pinned);
+    
+    // Called (with the cache unlocked) for each sequence dropped to free blocks
+    void SetEvictCallback(EvictCallback callback) { on_evict_ = std::move(callback); }
+    
+    // ---- Appending ----
+    // Extend seq by n_tokens positions and write their slots to slots_out.
+    // Allocates blocks, un-shares a partially filled shared tail block, and
+    // evicts idle sequences if the pool is full. On failure seq is unchanged.
+    bool Append(SeqId seq, uint32_t n_tokens, int64_t* slots_out);
+    
+    // Physical slot of a logical position (-1 if out of range)
+    int64_t SlotOf(SeqId seq, uint32_t pos) const;
+    
+    // Slots of positions [0, n); positions past the sequence get pad_slot,
+    // which should be 0 (zeroed by Init) or a written slot
+    bool GatherSlots(SeqId seq, uint32_t n, int32_t* slots_out, int32_t pad_slot = 0) const;
+    
+    PagedKVStats GetStats() const;
+
+private:
+    struct Sequence {
+        std::vector<uint32_t> blocks;   // Block table: logical block -> physical block
+        uint32_t n_tokens = 0;
+        uint64_t last_use = 0;
+        bool pinned = false;
+    };
+    
+    // Cache-line aligned so the pool can back SIMD kernels and ggml buffers
+    static constexpr size_t kPoolAlignment = 64;
+    struct AlignedDelete {
+        void operator()(float* p) const { ::operator delete[](p, std::align_val_t(kPoolAlignment)); }
+    };
+    
+    PagedKVConfig config_;
+    std::unique_ptr<float[], AlignedDelete> pool_;
+    size_t pool_floats_ = 0;
+    std::vector<uint32_t> ref_counts_;      // Per physical block
+    std::vector<uint32_t> free_blocks_;     // Stack of unreferenced blocks
+    std::unordered_map<SeqId, Sequence> sequences_;
+    uint64_t clock_ = 0;
+    uint64_t cow_copies_ = 0;
+    uint64_t evicted_sequences_ = 0;
+    EvictCallback on_evict_;
+    mutable std::mutex mutex_;
+    
+    float* Plane(uint32_t layer, uint32_t kv) {
+        return pool_.get() + (size_t(layer) * 2 + kv) * SlotCount() * config_.kv_dim;
+    }
+    void ReleaseBlocksLocked(Sequence& seq, size_t keep_blocks);
+    void CopyBlockLocked(uint32_t src, uint32_t dst, uint32_t rows);
+    bool EvictOneLocked(SeqId requester, std::vector<SeqId>& evicted);
+};
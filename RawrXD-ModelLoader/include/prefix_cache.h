@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// PREFIX CACHE - Radix tree of prompt token prefixes with cached KV state
+// ============================================================================
+//
+// Each entry is a token sequence whose KV state is held elsewhere (a paged KV
+// sequence), identified by an opaque EntryId. Match() finds the longest prefix
+// of a new prompt that any entry starts with, so a shared system prompt is
+// prefilled once and reused by every request that begins with it.
+//
+// Edges carry runs of tokens (path compression), so lookups cost one hash
+// probe per branching point plus a linear compare of the matched tokens.
+// Entries are evicted least recently used first once the summed entry
+// lengths exceed the token budget; entries sharing a prefix are each counted
+// in full, so the budget is an upper bound on the KV they pin.
+
+struct PrefixCacheStats {
+    uint64_t lookups = 0;
+    uint64_t hits = 0;                  // Lookups that matched at least one token
+    uint64_t lookup_tokens = 0;         // Prompt tokens looked up
+    uint64_t matched_tokens = 0;        // Prompt tokens covered by a cached prefix
+    uint64_t evictions = 0;
+    uint32_t entries = 0;
+    uint64_t cached_tokens = 0;         // Sum of entry lengths
+};
+
+class PrefixCache {
+public:
+    using EntryId = int32_t;
+    using EvictCallback = std::function<void(EntryId)>;
+    static constexpr EntryId kNoEntry = INT32_MIN;
+    
+    explicit PrefixCache(size_t max_tokens = 0);
+    ~PrefixCache();
+    PrefixCache(const PrefixCache&) = delete;
+    PrefixCache& operator=(const PrefixCache&) = delete;
+    
+    // Budget in tokens (0 = cache nothing); shrinking evicts immediately
+    void SetMaxTokens(size_t max_tokens);
+    size_t GetMaxTokens() const;
+    
+    // Called (with the cache unlocked) for each entry evicted by the budget
+    void SetEvictCallback(EvictCallback callback) { on_evict_ = std::move(callback); }
+    
+    // Entry sharing the longest prefix with tokens, and that prefix's length
+    // in *matched. Returns kNoEntry (and 0) when nothing matches.
+    EntryId Match(const int32_t* tokens, size_t n, size_t* matched);
+    
+    // Cache tokens as entry id. Returns false if the tokens are already cached
+    // (that entry is refreshed instead), if id is in use, or if the entry
+    // alone exceeds the budget; the caller then still owns id's KV state.
+    bool Insert(const int32_t* tokens, size_t n, EntryId id);
+    
+    // Drop an entry without invoking the evict callback
+    bool Erase(EntryId id);
+    void Clear();
+    
+    PrefixCacheStats GetStats() const;
+
+private:
+    struct Node {
+        std::vector<int32_t> label;                         // Tokens on the edge from parent
+        std::unordered_map<int32_t, std::unique_ptr<Node>> children;  // Keyed by first label token
+        Node* parent = nullptr;
+        EntryId entry = kNoEntry;                           // Entry ending exactly here
+        uint32_t subtree_entries = 0;                       // Entries at or below this node
+    };
+    struct EntryInfo {
+        Node* node = nullptr;
+        size_t length = 0;
+        std::list<EntryId>::iterator lru;
+    };
+    
+    Node root_;
+    std::unordered_map<EntryId, EntryInfo> entries_;
+    std::list<EntryId> lru_;                                // Most recently used first
+    size_t max_tokens_ = 0;
+    PrefixCacheStats stats_;
+    EvictCallback on_evict_;
+    mutable std::mutex mutex_;
+    
+    void EraseLocked(EntryId id);
+    void EvictToBudgetLocked(std::vector<EntryId>& evicted);
+    void PruneLocked(Node* node);
+    void Notify(const std::vector<EntryId>& evicted);
+};
@@ -3,7 +3,15 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <string_view>
+#include <list>
+#include <deque>
+#include <set>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <cstdint>
 
 // ============================================================================
@@ -17,6 +25,7 @@ struct TensorZoneInfo {
     uint64_t total_bytes;               // Total size of all tensors in zone
     bool is_loaded;                     // Currently in RAM?
     std::vector<uint8_t> data;          // Actual tensor data (when loaded)
+    uint32_t pin_count = 0;             // Live TensorViews; pinned zones are never evicted
 };
 
 struct TensorRef {
@@ -26,6 +35,49 @@ struct TensorRef {
     uint64_t size;                      // Size of this tensor
     GGMLType type;
     std::vector<uint64_t> shape;
+    uint64_t zone_offset = 0;           // Byte offset inside the zone's data buffer
+};
+
+class StreamingGGUFLoader;
+
+// Zero-copy view of a tensor inside a resident zone. The zone stays pinned
+// until the view is released or destroyed; views must not outlive Close().
+class TensorView {
+public:
+    TensorView() = default;
+    TensorView(TensorView&& other) noexcept { *this = std::move(other); }
+    TensorView& operator=(TensorView&& other) noexcept;
+    TensorView(const TensorView&) = delete;
+    TensorView& operator=(const TensorView&) = delete;
+    ~TensorView() { Release(); }
+    
+    const uint8_t* data() const { return data_; }
+    uint64_t size() const { return size_; }
+    bool valid() const { return data_ != nullptr; }
+    explicit operator bool() const { return valid(); }
+    
+    // Unpin early (the view becomes empty)
+    void Release();
+    
+private:
+    friend class StreamingGGUFLoader;
+    StreamingGGUFLoader* loader_ = nullptr;
+    TensorZoneInfo* zone_ = nullptr;
+    const uint8_t* data_ = nullptr;
+    uint64_t size_ = 0;
+};
+
+// Residency counters for the zone cache (cumulative since Open)
+struct ZoneStreamStats {
+    uint64_t hits = 0;                  // LoadZone found the zone resident
+    uint64_t prefetch_hits = 0;         // ...and it was brought in by the prefetcher
+    uint64_t stalls = 0;                // LoadZone had to read the zone synchronously
+    uint64_t prefetch_waits = 0;        // LoadZone blocked on an in-flight prefetch
+    uint64_t prefetched_zones = 0;      // Zones loaded by the background thread
+    uint64_t dropped_prefetches = 0;    // Prefetches discarded for lack of budget
+    uint64_t evictions = 0;             // Zones dropped by the LRU policy
+    uint64_t bytes_read = 0;            // Tensor bytes read from disk (both paths)
+    uint64_t resident_bytes = 0;        // Bytes currently held by loaded zones
 };
 
 class StreamingGGUFLoader : public IGGUFLoader {
@@ -58,8 +110,22 @@ public:
     // Get which zone a tensor belongs to
     std::string GetTensorZone(const std::string& tensor_name) const;
     
-    // Load a zone into RAM (unloads other zones if needed)
-    bool LoadZone(const std::string& zone_name, uint64_t max_memory_mb = 512) override;
+    // Load a zone into RAM. Several zones stay resident; least recently used
+    // zones are evicted once the total exceeds the budget. A nonzero
+    // max_memory_mb replaces it; the default keeps SetMemoryBudgetMB's value
+    bool LoadZone(const std::string& zone_name, uint64_t max_memory_mb = 0) override;
+    
+    // Queue a zone for loading on the background thread (no-op if resident)
+    void PrefetchZone(const std::string& zone_name);
+    
+    // Prefetch the next zone in forward-pass order whenever a zone is used
+    void SetAutoPrefetch(bool enabled) { auto_prefetch_ = enabled; }
+    
+    // Resident-set budget shared by all loaded zones
+    void SetMemoryBudgetMB(uint64_t max_memory_mb);
+    uint64_t GetMemoryBudgetMB() const;
+    
+    ZoneStreamStats GetStreamStats() const;
     
     // Unload a zone from RAM
     bool UnloadZone(const std::string& zone_name) override;
@@ -68,6 +134,12 @@ public:
     bool LoadTensorZone(const std::string& tensor_name, std::vector<uint8_t>& data) override;
     bool GetTensorData(const std::string& tensor_name, std::vector<uint8_t>& data); // Non-virtual alias
     
+    // Zero-copy access: loads the zone if needed and pins it for the view's lifetime
+    TensorView GetTensorView(const std::string& tensor_name);
+    
+    // Index entry for a tensor (nullptr if unknown)
+    const TensorRef* FindTensor(const std::string& tensor_name) const;
+    
     // Get zone info (what's loaded, what's not)
     TensorZoneInfo GetZoneInfo(const std::string& zone_name) const;
     
@@ -82,6 +154,8 @@ public:
     std::vector<TensorInfo> GetAllTensorInfo() const override;
     
 private:
+    friend class TensorView;            // Releases its pin through UnpinZone
+    
     // ---- File Handle (kept open for streaming) ----
     std::string filepath_;
     mutable std::ifstream file_;
@@ -90,30 +164,65 @@ private:
     // ---- Metadata (always in RAM, ~50-100 MB) ----
     GGUFHeader header_;
     GGUFMetadata metadata_;
+    gguf::Parser parser_;               // Owns the header prefix that metadata views point into
     
     // ---- Tensor Index (always in RAM, ~40 MB) ----
-    // Maps tensor_name → {offset, size, type, shape}
-    std::map<std::string, TensorRef> tensor_index_;
+    // Flat array in file order plus a hash of name → slot; lookup keys view
+    // the names stored in tensor_index_, which is never resized after Open()
+    std::vector<TensorRef> tensor_index_;
+    std::unordered_map<std::string_view, uint32_t> tensor_lookup_;
     
     // ---- Zone Information ----
     // Maps zone_name → {tensors, total_bytes, is_loaded, data}
     std::map<std::string, TensorZoneInfo> zones_;
     
-    // Currently loaded zones (can have multiple active zones for pre-loading)
-    std::map<std::string, bool> active_zones_;
+    // Resident zones, most recently used first
+    std::list<std::string> lru_;
     std::string current_zone_;
     uint64_t current_zone_memory_;
+    uint64_t resident_bytes_;
     
     // ---- Configuration ----
-    uint64_t max_zone_memory_mb_;       // How much RAM per zone? (512 MB default)
+    uint64_t max_zone_memory_mb_;       // Budget for all resident zones (512 MB default)
+    bool auto_prefetch_;
+    
+    // ---- Background prefetch ----
+    // zones_, lru_, stats_ and the prefetch queue are guarded by zone_mutex_;
+    // tensor_index_ and zone tensor lists are immutable after Open()
+    mutable std::mutex zone_mutex_;
+    std::condition_variable zone_cv_;       // Signalled when an in-flight load finishes
+    std::condition_variable prefetch_cv_;   // Signalled when work is queued or on shutdown
+    std::deque<std::string> prefetch_queue_;
+    std::set<std::string> inflight_;        // Zones currently being read from disk
+    std::set<std::string> prefetched_unused_;  // Prefetched zones not yet requested
+    std::thread prefetch_thread_;
+    bool stop_prefetch_;
+    mutable std::mutex file_mutex_;         // Serialises foreground reads on file_
+    std::ifstream prefetch_file_;           // Second handle so prefetch never seeks file_
+    ZoneStreamStats stats_;
     
     // ---- Internal Helpers ----
     
     // Assign tensors to zones based on name patterns
     void AssignTensorsToZones();
     
-    // Load zone data from disk
-    bool StreamZoneFromDisk(const std::string& zone_name);
+    // Load zone data from disk (no locks held; tensors read in file order)
+    bool StreamZoneFromDisk(const TensorZoneInfo& zone, std::ifstream& file, std::vector<uint8_t>& out);
+    
+    // Make a freshly read zone resident, evicting LRU zones to fit the budget.
+    // Speculative installs never evict the most recently used zone.
+    bool InstallZone(const std::string& zone_name, std::vector<uint8_t>&& data, bool speculative);
+    void EvictZoneLocked(std::string zone_name);  // By value: callers pass lru_ elements
+    
+    // Least recently used zone that is not pinned, skipping the first `keep`
+    // entries of lru_ (nullptr if none)
+    const std::string* EvictionCandidateLocked(size_t keep) const;
+    void UnpinZone(TensorZoneInfo* zone);
+    void TouchZoneLocked(const std::string& zone_name);
+    
+    void PrefetchLoop();
+    void StopPrefetchThread();
+    void QueueNextZoneLocked(const std::string& zone_name);
     
     // Calculate which layer a tensor belongs to
     int32_t ExtractLayerNumber(const std::string& tensor_name) const;
@@ -121,9 +230,5 @@ private:
     // Get zone for tensor name
     std::string GetZoneForTensor(const std::string& tensor_name) const;
     
-    // Template reading
-    template<typename T>
-    bool ReadValue(T& value);
-    bool ReadString(std::string& value);
     uint64_t CalculateTensorSize(const std::vector<uint64_t>& shape, GGMLType type) const;
 };
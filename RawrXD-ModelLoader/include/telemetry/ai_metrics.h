@@ -0,0 +1,155 @@
+#pragma once
+
+#include "telemetry/latency_histogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace RawrXD {
+namespace Telemetry {
+
+struct LatencyStats {
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    double mean_ms = 0.0;
+    double max_ms = 0.0;
+    uint64_t sample_count = 0;
+};
+
+struct TokenStats {
+    uint64_t total_prompt_tokens = 0;
+    uint64_t total_completion_tokens = 0;
+    uint64_t total_tokens = 0;
+    double avg_prompt_tokens = 0.0;
+    double avg_completion_tokens = 0.0;
+};
+
+struct ToolStats {
+    std::string tool_name;
+    uint64_t invocation_count = 0;
+    uint64_t success_count = 0;
+    uint64_t error_count = 0;
+    double success_rate = 0.0;
+    LatencyStats latency;
+};
+
+struct ModelMetrics {
+    std::string model_name;
+    uint64_t request_count = 0;
+    uint64_t success_count = 0;
+    uint64_t error_count = 0;
+    double success_rate = 0.0;
+    TokenStats tokens;
+    LatencyStats latency;
+};
+
+struct MetricPoint {
+    std::chrono::system_clock::time_point timestamp;
+    double value = 0.0;
+    std::string label;
+};
+
+enum class ExportFormat {
+    JSON,
+    CSV,
+    TEXT
+};
+
+/**
+ * @brief Session metrics for Ollama requests, tool calls and errors
+ *
+ * Request latency goes into a LatencyHistogram without taking the mutex,
+ * and counters are atomics, so the dashboard's polling never waits on
+ * recording. Per-model and per-tool maps and the time series still take
+ * the mutex.
+ */
+class AIMetricsCollector {
+public:
+    using Window = LatencyHistogram::Window;
+
+    struct DisplayMetrics {
+        uint64_t total_requests = 0;
+        uint64_t successful_requests = 0;
+        uint64_t failed_requests = 0;
+        double success_rate = 0.0;
+        double last_request_latency_ms = 0.0;
+        LatencyStats latency_stats;          // Whole session
+        LatencyStats recent_latency_stats;   // Last five minutes
+        TokenStats token_stats;
+        std::vector<ToolStats> top_tools;
+        std::vector<std::string> recent_errors;
+        std::string current_model;
+        uint64_t current_model_requests = 0;
+    };
+
+    AIMetricsCollector();
+    ~AIMetricsCollector();
+
+    void recordOllamaRequest(const std::string& model, uint64_t latency_ms, bool success,
+                             uint64_t prompt_tokens, uint64_t completion_tokens);
+    void recordToolInvocation(const std::string& tool_name, uint64_t latency_ms, bool success);
+    void recordError(const std::string& error_type, const std::string& message);
+    void recordCustomMetric(const std::string& metric_name, double value, const std::string& label = "");
+
+    LatencyStats getOllamaLatencyStats(Window window = Window::Lifetime) const;
+    TokenStats getTokenStats() const;
+    std::vector<ToolStats> getToolStats() const;
+    std::vector<ModelMetrics> getModelMetrics() const;
+    std::vector<MetricPoint> getMetricTimeSeries(const std::string& metric_name, size_t max_points = 100) const;
+    std::map<std::string, uint64_t> getErrorCounts() const;
+    DisplayMetrics getDisplayMetrics() const;
+
+    std::string exportMetrics(ExportFormat format) const;
+    bool saveMetricsToFile(const std::string& filepath, ExportFormat format) const;
+
+    void clearMetrics();
+    void resetMetrics();
+    size_t getTotalRecordedMetrics() const;
+
+private:
+    static constexpr size_t MAX_TIME_SERIES_POINTS = 1000;
+    static constexpr size_t MAX_RECENT_ERRORS = 50;
+
+    TokenStats getTokenStatsInternal() const;
+    std::vector<ToolStats> getToolStatsInternal() const;
+    static LatencyStats calculateLatencyStats(const LatencyHistogram::Snapshot& snapshot);
+    void pruneTimeSeries(const std::string& metric_name);
+
+    std::string toJSON() const;
+    std::string toCSV() const;
+    std::string toText() const;
+
+    mutable std::mutex m_mutex;
+    std::chrono::system_clock::time_point m_session_start;
+
+    // Lock-free
+    LatencyHistogram m_latency;
+    std::atomic<uint64_t> m_last_latency_ms{0};
+    std::atomic<uint64_t> m_total_requests{0};
+    std::atomic<uint64_t> m_successful_requests{0};
+    std::atomic<uint64_t> m_failed_requests{0};
+    std::atomic<uint64_t> m_prompt_tokens{0};
+    std::atomic<uint64_t> m_completion_tokens{0};
+
+    // Guarded by m_mutex
+    std::map<std::string, std::deque<MetricPoint>> m_timeSeries;
+    std::map<std::string, ModelMetrics> m_model_metrics;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> m_model_latency;
+    std::map<std::string, ToolStats> m_tool_stats;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> m_tool_latency;
+    std::map<std::string, uint64_t> m_error_counts;
+    std::deque<std::string> m_recent_errors;
+};
+
+AIMetricsCollector& GetMetricsCollector();
+
+} // namespace Telemetry
+} // namespace RawrXD
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace RawrXD {
+namespace Telemetry {
+
+/**
+ * @brief Fixed-memory log-bucketed histogram for latencies and rates
+ *
+ * Values below 64 get a bucket each; every power of two above that is
+ * split into 32 linear sub-buckets, so a reported percentile is within
+ * about 1.6% of the true sample (bucket midpoint). Values from 2^40 up
+ * share the last bucket. The unit is the caller's (ms, us, ...).
+ *
+ * record() takes no lock: a thread adds into one of kShards shards with
+ * relaxed atomic increments, so concurrent writers rarely share a cache
+ * line. A windowed histogram also answers for the last minute, five
+ * minutes and hour: the first writer into each 10 s slice copies the
+ * lifetime totals into a small ring of checkpoints, and a window is the
+ * lifetime view minus the checkpoint that opens it (so a window spans the
+ * current slice plus the whole ones before it, e.g. 50-60 s for a minute).
+ * Queries merge the shards in O(buckets) and never block writers; a
+ * snapshot taken during writes may be a few samples behind, and a sample
+ * racing a checkpoint copy counts toward the slice before.
+ */
+class LatencyHistogram {
+public:
+    enum class Window {
+        Lifetime,
+        OneMinute,      // 6 x 10 s slices
+        FiveMinutes,    // 5 x 1 min slices
+        OneHour         // 12 x 5 min slices
+    };
+
+    static constexpr int kSubBuckets = 32;
+    static constexpr int kLinearLimit = 64;
+    static constexpr int kMaxOctave = 39;
+    static constexpr int kBuckets = kLinearLimit + (kMaxOctave - 5) * kSubBuckets;
+    static constexpr int kShards = 4;
+
+    struct Snapshot {
+        std::vector<uint64_t> counts;   // Per bucket; empty when count is 0
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t min = 0;
+        uint64_t max = 0;
+
+        // p in [0, 100]; 0 for an empty snapshot
+        uint64_t percentile(double p) const;
+        double mean() const { return count ? double(sum) / double(count) : 0.0; }
+        void merge(const Snapshot& other);
+    };
+
+    // windowed = false keeps only lifetime counts (about 37 KB instead of 280 KB)
+    explicit LatencyHistogram(bool windowed = true);
+    ~LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t value) { recordAt(value, m_windowed ? nowMs() : -1); }
+    void recordAt(uint64_t value, int64_t nowMs);   // nowMs < 0 skips the windows
+
+    Snapshot snapshot(Window window = Window::Lifetime) const { return snapshotAt(window, nowMs()); }
+    Snapshot snapshotAt(Window window, int64_t nowMs) const;
+
+    // Not atomic with respect to concurrent record() calls
+    void reset();
+
+    bool windowed() const { return m_windowed; }
+
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketLow(int index);
+    static uint64_t bucketHigh(int index);   // Inclusive
+    static int64_t nowMs();                  // Coarse monotonic clock
+
+private:
+    struct Ring;
+    struct Shard;
+
+    void checkpoint(int64_t nowMs);
+    void collectLifetime(std::vector<uint64_t>& counts, uint64_t& sum) const;
+
+    bool m_windowed;
+    std::unique_ptr<Shard[]> m_shards;
+    std::unique_ptr<Ring[]> m_rings;
+    std::atomic<int64_t> m_nextCheckpointMs{INT64_MIN};
+    std::atomic<uint64_t> m_min{UINT64_MAX};
+    std::atomic<uint64_t> m_max{0};
+};
+
+} // namespace Telemetry
+} // namespace RawrXD
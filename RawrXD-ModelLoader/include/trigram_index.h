@@ -0,0 +1,200 @@
+/**
+ * @file trigram_index.h
+ * @brief Persistent trigram index that narrows project searches to candidate files.
+ *
+ * TrigramIndex maps every three-byte sequence (ASCII case-folded) in the
+ * project's text files to the files containing it. A literal of three or more
+ * bytes can only occur in files that contain all of its trigrams, so a query
+ * intersects a few posting lists and FileSearchEngine scans just those files.
+ *
+ * The index is built from FileSearchEngine::listFiles(), so it sees exactly
+ * the files a search would (same .gitignore rules, filter and binary check).
+ * Postings are delta-varint encoded per trigram. Files added or changed after
+ * the build go into a small overlay that queries merge in; compact() folds
+ * the overlay back into the encoded lists. save() and load() keep the index
+ * in the project's .rawrxd directory between sessions, and refresh() brings a
+ * loaded index up to date by size and modification time.
+ *
+ * @note Thread Safety: queries may run concurrently with each other and with
+ *       updates; updates serialise on an internal lock.
+ *
+ * @copyright MIT License
+ */
+#pragma once
+
+#include "file_search_engine.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @class TrigramIndex
+ * @brief Trigram posting lists over one project tree.
+ *
+ * @par Usage Example:
+ * @code
+ * TrigramIndex index;
+ * const std::string file = TrigramIndex::defaultIndexPath(root);
+ * if (!index.load(file) || index.root() != root) index.clear();
+ * index.refresh(root);
+ * index.save(file);
+ *
+ * std::vector<std::string> files;
+ * if (index.candidates("parseHeader", files)) {
+ *     engine.searchFiles(files, query, onBatch);
+ * }
+ * @endcode
+ */
+class TrigramIndex {
+public:
+    /**
+     * @struct Stats
+     * @brief Size of the index.
+     */
+    struct Stats {
+        uint64_t files = 0;          ///< Live files, binaries included
+        uint64_t textBytes = 0;      ///< Bytes of indexed text
+        uint64_t trigrams = 0;       ///< Distinct trigrams
+        uint64_t postings = 0;       ///< (trigram, file) pairs
+        uint64_t encodedBytes = 0;   ///< Encoded posting bytes
+        uint64_t overlayFiles = 0;   ///< Files waiting for compact()
+    };
+
+    /**
+     * @brief Creates an empty index.
+     * @param walkOptions File filter, .gitignore, thread count, size limit and
+     *                    cancel flag used when walking and reading files
+     */
+    explicit TrigramIndex(const FileSearchEngine::Options& walkOptions = FileSearchEngine::Options());
+
+    /**
+     * @brief Index every file under @p root that is new or changed.
+     * @return false if the cancel flag stopped it (the index stays usable)
+     *
+     * Files no longer present are dropped. On an empty index this is the
+     * initial build. Sets root().
+     */
+    bool refresh(const std::string& root);
+
+    /**
+     * @brief Re-read one file after a change notification.
+     *
+     * A path that no longer exists (or is now ignored by size) is removed.
+     * New paths are added without checking .gitignore or the filter.
+     */
+    void updateFile(const std::string& path);
+
+    /// @brief Drop one file after a delete notification.
+    void removeFile(const std::string& path);
+
+    /**
+     * @brief Re-check one directory after a directory notification.
+     *
+     * Changed and new files are re-read, deleted ones dropped. A new
+     * subdirectory is walked and indexed whole; a deleted one is dropped with
+     * everything under it. The .gitignore files from root() down apply as in
+     * refresh(), so a directory they exclude is dropped rather than indexed.
+     */
+    void refreshDirectory(const std::string& dir);
+
+    /**
+     * @brief Re-check every directory whose mtime moved since it was listed.
+     *
+     * Catches files created, deleted or renamed without a notification, for
+     * directories nobody watches. Edits in place leave the directory's mtime
+     * alone; those still need updateFile().
+     * @param skip If set, directories it returns true for are not checked
+     * @return Number of directories re-checked
+     */
+    size_t refreshChangedDirectories(const std::function<bool(const std::string&)>& skip = nullptr);
+
+    /**
+     * @brief Files that may contain @p literal.
+     * @param literal       Search text; matching is ASCII case-insensitive
+     * @param out           Receives candidate paths (cleared first)
+     * @return false if the literal is too short to narrow the search, in
+     *         which case every file is a candidate and @p out is left empty
+     */
+    bool candidates(const std::string& literal, std::vector<std::string>& out) const;
+
+    /// @brief Fold the overlay of updated files into the encoded posting lists.
+    void compact();
+
+    /// @brief Forget every file and the root.
+    void clear();
+
+    /**
+     * @brief Write the index to @p file, compacting first.
+     * @return false on I/O failure
+     */
+    bool save(const std::string& file);
+
+    /**
+     * @brief Replace the index with the one stored in @p file.
+     * @return false if the file is missing or not a valid index (index left empty)
+     */
+    bool load(const std::string& file);
+
+    std::string root() const;
+    Stats stats() const;
+
+    /// @brief Every directory of the indexed tree (empty ones included), for change notifications.
+    std::vector<std::string> directories() const;
+
+    /// @brief root/.rawrxd/trigram.idx, next to ProjectDetector's project.json.
+    static std::string defaultIndexPath(const std::string& root);
+
+private:
+    struct FileEntry {
+        std::string path;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        bool live = false;
+        bool binary = false;
+    };
+
+    // Trigrams of one file, as read from disk
+    struct Extracted {
+        bool ok = false;                // Read successfully
+        bool binary = false;            // NUL byte in the first 8 KB; no trigrams
+        std::vector<uint32_t> trigrams; // Sorted, distinct
+    };
+
+    // Reads files in parallel, without the lock; empty if cancelled
+    std::vector<Extracted> extract(const std::vector<FileSearchEntry>& entries) const;
+    void applyLocked(const std::vector<FileSearchEntry>& entries, std::vector<Extracted>& extracted);
+    void dropFileLocked(const std::string& path);
+    void rebuildLocked(const std::vector<std::pair<uint32_t, const std::vector<uint32_t>*>>& fresh);
+    void postingsLocked(uint32_t trigram, std::vector<uint32_t>& out) const;
+    void clearLocked();
+    void rescanDirectory(const std::string& dirPath);  // Caller holds m_updateMutex
+
+    FileSearchEngine::Options m_options;
+    mutable std::shared_mutex m_mutex;
+    std::mutex m_updateMutex;  // Orders updates, whose disk reads happen outside m_mutex
+    std::string m_root;
+    std::map<std::string, int64_t> m_directories;  // Walked directory -> mtime when listed
+
+    // File table; ids index it, and dropped files leave a dead slot until compact()
+    std::vector<FileEntry> m_files;
+    std::unordered_map<std::string, uint32_t> m_ids;
+    uint64_t m_liveFiles = 0;
+
+    // Encoded lists: m_keys sorted, list k is m_blob[m_offsets[k], m_offsets[k + 1])
+    std::vector<uint32_t> m_keys;
+    std::vector<uint64_t> m_offsets;
+    std::vector<uint8_t> m_blob;
+    uint64_t m_postings = 0;
+
+    // Files indexed since the last compact(); their ids exceed every encoded id
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_overlay;
+    uint32_t m_firstOverlayId = 0;
+    uint64_t m_overlayPostings = 0;
+};
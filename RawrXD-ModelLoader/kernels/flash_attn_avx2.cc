@@ -1,167 +1,403 @@
-// flash_attn_avx2.cc — Flash-Attention with True Online Softmax (C+intrinsics)
-// Phase 4: O(n²) → O(n) memory for long-context inference
-// Target: ≥10× speedup on seq=4096, head_dim=64
+// flash_attn_avx2.cc — Tiled Flash-Attention with online softmax (C+intrinsics)
+// Q block x K/V block tiles, causal masking, GQA head sharing and
+// (head x query block) work items for threaded prefill; O(n) memory.
+// The AVX2 path is compiled for AVX2+FMA regardless of the target's /arch
+// flags and selected at runtime, so this file links into any build.
+
+#include "flash_attention.h"
 
-#include <cstring>
-#include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
 #include <limits>
+#include <thread>
+#include <vector>
 
-#ifdef __AVX2__
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FLASH_ATTN_X86 1
 #include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #endif
 
-// Baseline scalar flash-attention with true online softmax
-static void flash_attn_scalar(
-    const float* Q, const float* K, const float* V, float* O,
-    int seq_len, int head_dim
-) {
-    const float scale = 1.0f / std::sqrt(static_cast<float>(head_dim));
-    
-    for (int q_idx = 0; q_idx < seq_len; ++q_idx) {
-        const float* q_row = Q + q_idx * head_dim;
-        float* out_row = O + q_idx * head_dim;
-        
-        float running_max = -std::numeric_limits<float>::infinity();
-        float running_sum = 0.0f;
-        std::memset(out_row, 0, head_dim * sizeof(float));
-        
-        // Process all K/V rows for this query
-        for (int k_idx = 0; k_idx < seq_len; ++k_idx) {
-            const float* k_row = K + k_idx * head_dim;
-            const float* v_row = V + k_idx * head_dim;
-            
-            // Compute QK^T score
-            float qk_score = 0.0f;
-            for (int d = 0; d < head_dim; ++d) {
-                qk_score += q_row[d] * k_row[d];
-            }
-            qk_score *= scale;
-            
-            // Update running max
-            float old_max = running_max;
-            float new_max = std::max(old_max, qk_score);
-            float correction = std::exp(old_max - new_max);
-            
-            // Rescale previous contributions
-            for (int d = 0; d < head_dim; ++d) {
-                out_row[d] *= correction;
+namespace {
+
+constexpr int kBlockQ = 32;       // Query rows per work item
+constexpr int kBlockK = 64;       // K/V rows per tile: one query's scores fill 8 ymm
+constexpr int kMaxHeadDim = 256;  // Transposed K tile (64 KB) lives on the stack
+
+inline int query_pos(const flash_attn_params* p, int i) {
+    return p->q_pos ? p->q_pos[i] : p->n_kv - p->n_q + i;
+}
+
+// One work item: a query block of one head and the K/V range it can see
+struct WorkTile {
+    int h;
+    int q0;
+    int nq;
+    int kv_end;
+    const float* k;
+    const float* v;
+};
+
+WorkTile decode_item(const flash_attn_params* p, int item) {
+    const int n_blocks = (p->n_q + kBlockQ - 1) / kBlockQ;
+    const int group = p->n_kv_head > 0 ? p->n_head / p->n_kv_head : 1;
+    WorkTile t;
+    // Last (longest under the causal mask) query blocks first; the heads of a
+    // block are adjacent, so heads sharing a KV head run back to back
+    t.h = item % p->n_head;
+    t.q0 = (n_blocks - 1 - item / p->n_head) * kBlockQ;
+    t.nq = std::min(kBlockQ, p->n_q - t.q0);
+    const int kvh = t.h / std::max(1, group);
+    t.k = p->k + kvh * p->kv_head_stride;
+    t.v = p->v + kvh * p->kv_head_stride;
+    t.kv_end = p->n_kv;
+    if (p->causal) {
+        int last = -1;
+        for (int i = 0; i < t.nq; ++i) last = std::max(last, query_pos(p, t.q0 + i));
+        t.kv_end = std::min(p->n_kv, last + 1);
+    }
+    return t;
+}
+
+// Keys of [k0, k0 + kb) visible to query i
+inline int visible_keys(const flash_attn_params* p, int i, int k0, int kb) {
+    return p->causal ? std::min(kb, query_pos(p, i) + 1 - k0) : kb;
+}
+
+// Baseline scalar tile loop (also the path for head_dim not a multiple of 8)
+void run_item_scalar(const flash_attn_params* p, int item) {
+    const WorkTile t = decode_item(p, item);
+    const int hd = p->head_dim;
+    float m[kBlockQ];
+    float l[kBlockQ];
+    float s[kBlockK];
+
+    for (int i = 0; i < t.nq; ++i) {
+        m[i] = -std::numeric_limits<float>::infinity();
+        l[i] = 0.0f;
+        std::memset(p->o + (t.q0 + i) * p->o_token_stride + t.h * p->o_head_stride, 0, hd * sizeof(float));
+    }
+
+    for (int k0 = 0; k0 < t.kv_end; k0 += kBlockK) {
+        const int kb = std::min(kBlockK, t.kv_end - k0);
+        for (int i = 0; i < t.nq; ++i) {
+            const int limit = visible_keys(p, t.q0 + i, k0, kb);
+            if (limit <= 0) continue;
+            const float* q = p->q + (t.q0 + i) * p->q_token_stride + t.h * p->q_head_stride;
+            float* o = p->o + (t.q0 + i) * p->o_token_stride + t.h * p->o_head_stride;
+
+            float tile_max = -std::numeric_limits<float>::infinity();
+            for (int j = 0; j < limit; ++j) {
+                const float* k = t.k + (k0 + j) * p->kv_token_stride;
+                float dot = 0.0f;
+                for (int d = 0; d < hd; ++d) dot += q[d] * k[d];
+                s[j] = dot * p->scale;
+                tile_max = std::max(tile_max, s[j]);
             }
-            running_sum *= correction;
-            
-            // Add new contribution
-            float p = std::exp(qk_score - new_max);
-            running_sum += p;
-            for (int d = 0; d < head_dim; ++d) {
-                out_row[d] += p * v_row[d];
+
+            // One rescale of the running output per tile, not per key
+            const float new_max = std::max(m[i], tile_max);
+            const float alpha = std::exp(m[i] - new_max);
+            for (int d = 0; d < hd; ++d) o[d] *= alpha;
+            float sum = 0.0f;
+            for (int j = 0; j < limit; ++j) {
+                const float pj = std::exp(s[j] - new_max);
+                const float* v = t.v + (k0 + j) * p->kv_token_stride;
+                sum += pj;
+                for (int d = 0; d < hd; ++d) o[d] += pj * v[d];
             }
-            
-            running_max = new_max;
+            l[i] = l[i] * alpha + sum;
+            m[i] = new_max;
         }
-        
-        // Final normalization
-        float inv_sum = 1.0f / running_sum;
-        for (int d = 0; d < head_dim; ++d) {
-            out_row[d] *= inv_sum;
+    }
+
+    for (int i = 0; i < t.nq; ++i) {
+        if (l[i] <= 0.0f) continue;
+        float* o = p->o + (t.q0 + i) * p->o_token_stride + t.h * p->o_head_stride;
+        const float inv = 1.0f / l[i];
+        for (int d = 0; d < hd; ++d) o[d] *= inv;
+    }
+}
+
+bool cpu_has_avx2_fma() {
+#if defined(FLASH_ATTN_X86) && defined(_MSC_VER)
+    int info[4] = {0};
+    __cpuid(info, 1);
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    __cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0;
+    return fma && avx2 && osxsave && (_xgetbv(0) & 6) == 6;
+#elif defined(FLASH_ATTN_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+#if defined(FLASH_ATTN_X86)
+#define FLASH_ATTN_HAVE_AVX2 1
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#define FA_UNROLL _Pragma("GCC unroll 8")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#define FA_UNROLL _Pragma("unroll")
+#else
+#define FA_UNROLL
+#endif
+
+namespace {
+
+inline float hsum8(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+inline float hmax8(__m256 v) {
+    __m128 s = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_max_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_max_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+// Cephes expf: 2^n * P(r) with r = x - n ln2, |rel err| < 2e-7. Inputs here
+// are score - running max <= 0; -inf (masked keys) maps to exactly 0.
+inline __m256 exp8(__m256 x) {
+    const __m256 lo = _mm256_set1_ps(-87.33654f);
+    const __m256 keep = _mm256_cmp_ps(x, lo, _CMP_GE_OQ);
+    x = _mm256_max_ps(_mm256_min_ps(x, _mm256_set1_ps(88.0f)), lo);
+    const __m256 fx = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)),
+                                      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(0.693359375f), x);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(-2.12194440e-4f), x);
+    __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507e-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073e-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894e-2f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459e-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201e-1f));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+    const __m256i n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(fx), _mm256_set1_epi32(127)), 23);
+    return _mm256_and_ps(_mm256_mul_ps(y, _mm256_castsi256_ps(n)), keep);
+}
+
+// s[0, 8*NC) = scale * q . K[j] against the transposed tile kt[d][j]: one
+// broadcast of q[d] feeds NC independent accumulators, no horizontal sums
+template <int NC>
+inline void score_chunks(const float* q, const float* kt, int hd, float scale, float* s) {
+    __m256 acc[NC];
+    FA_UNROLL for (int c = 0; c < NC; ++c) acc[c] = _mm256_setzero_ps();
+    for (int d = 0; d < hd; ++d) {
+        const __m256 qd = _mm256_set1_ps(q[d]);
+        const float* row = kt + d * kBlockK;
+        FA_UNROLL for (int c = 0; c < NC; ++c) acc[c] = _mm256_fmadd_ps(qd, _mm256_load_ps(row + 8 * c), acc[c]);
+    }
+    const __m256 vs = _mm256_set1_ps(scale);
+    FA_UNROLL for (int c = 0; c < NC; ++c) _mm256_store_ps(s + 8 * c, _mm256_mul_ps(acc[c], vs));
+}
+
+inline void score_tile(int nc, const float* q, const float* kt, int hd, float scale, float* s) {
+    switch (nc) {
+        case 8: score_chunks<8>(q, kt, hd, scale, s); break;
+        case 7: score_chunks<7>(q, kt, hd, scale, s); break;
+        case 6: score_chunks<6>(q, kt, hd, scale, s); break;
+        case 5: score_chunks<5>(q, kt, hd, scale, s); break;
+        case 4: score_chunks<4>(q, kt, hd, scale, s); break;
+        case 3: score_chunks<3>(q, kt, hd, scale, s); break;
+        case 2: score_chunks<2>(q, kt, hd, scale, s); break;
+        default: score_chunks<1>(q, kt, hd, scale, s); break;
+    }
+}
+
+// o[0, 8*ND) = alpha * o + sum_j p[j] * V[j]; the output slice stays in
+// registers for the whole tile
+template <int ND>
+inline void pv_chunks(float* o, float alpha, const float* pr, const float* v, ptrdiff_t stride, int n) {
+    __m256 acc[ND];
+    const __m256 va = _mm256_set1_ps(alpha);
+    FA_UNROLL for (int c = 0; c < ND; ++c) acc[c] = _mm256_mul_ps(_mm256_loadu_ps(o + 8 * c), va);
+    for (int j = 0; j < n; ++j) {
+        const __m256 pj = _mm256_set1_ps(pr[j]);
+        const float* vr = v + j * stride;
+        FA_UNROLL for (int c = 0; c < ND; ++c) acc[c] = _mm256_fmadd_ps(pj, _mm256_loadu_ps(vr + 8 * c), acc[c]);
+    }
+    FA_UNROLL for (int c = 0; c < ND; ++c) _mm256_storeu_ps(o + 8 * c, acc[c]);
+}
+
+inline void pv_tile(float* o, float alpha, const float* pr, const float* v, ptrdiff_t stride, int n, int hd) {
+    for (int d0 = 0; d0 < hd; d0 += 64) {
+        switch ((hd - d0) / 8) {
+            case 1: pv_chunks<1>(o + d0, alpha, pr, v + d0, stride, n); break;
+            case 2: pv_chunks<2>(o + d0, alpha, pr, v + d0, stride, n); break;
+            case 3: pv_chunks<3>(o + d0, alpha, pr, v + d0, stride, n); break;
+            case 4: pv_chunks<4>(o + d0, alpha, pr, v + d0, stride, n); break;
+            case 5: pv_chunks<5>(o + d0, alpha, pr, v + d0, stride, n); break;
+            case 6: pv_chunks<6>(o + d0, alpha, pr, v + d0, stride, n); break;
+            case 7: pv_chunks<7>(o + d0, alpha, pr, v + d0, stride, n); break;
+            default: pv_chunks<8>(o + d0, alpha, pr, v + d0, stride, n); break;
         }
     }
 }
 
-#ifdef __AVX2__
-// AVX2-accelerated flash-attention with online softmax
-static void flash_attn_avx2_impl(
-    const float* Q, const float* K, const float* V, float* O,
-    int seq_len, int head_dim
-) {
-    const float scale = 1.0f / std::sqrt(static_cast<float>(head_dim));
-    const __m256 vscale = _mm256_set1_ps(scale);
-    
-    for (int q_idx = 0; q_idx < seq_len; ++q_idx) {
-        const float* q_row = Q + q_idx * head_dim;
-        float* out_row = O + q_idx * head_dim;
-        
-        __m256 vrunning_max = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
-        __m256 vrunning_sum = _mm256_setzero_ps();
-        
-        // Zero output
-        for (int d = 0; d < head_dim; d += 8) {
-            _mm256_storeu_ps(out_row + d, _mm256_setzero_ps());
+void run_item_avx2(const flash_attn_params* p, int item) {
+    const WorkTile t = decode_item(p, item);
+    const int hd = p->head_dim;
+    alignas(32) float kt[kMaxHeadDim * kBlockK];
+    alignas(32) float s[kBlockK];
+    float m[kBlockQ];
+    float l[kBlockQ];
+
+    for (int i = 0; i < t.nq; ++i) {
+        m[i] = -std::numeric_limits<float>::infinity();
+        l[i] = 0.0f;
+        std::memset(p->o + (t.q0 + i) * p->o_token_stride + t.h * p->o_head_stride, 0, hd * sizeof(float));
+    }
+
+    for (int k0 = 0; k0 < t.kv_end; k0 += kBlockK) {
+        const int kb = std::min(kBlockK, t.kv_end - k0);
+        const int padded = (kb + 7) & ~7;
+
+        // Transpose the K tile once; every query row of the block reuses it
+        for (int j = 0; j < kb; ++j) {
+            const float* k = t.k + (k0 + j) * p->kv_token_stride;
+            for (int d = 0; d < hd; ++d) kt[d * kBlockK + j] = k[d];
         }
-        
-        float running_max = -std::numeric_limits<float>::infinity();
-        float running_sum = 0.0f;
-        
-        // Process all K/V rows for this query
-        for (int k_idx = 0; k_idx < seq_len; ++k_idx) {
-            const float* k_row = K + k_idx * head_dim;
-            const float* v_row = V + k_idx * head_dim;
-            
-            // Compute QK^T score using AVX2
-            __m256 vdot = _mm256_setzero_ps();
-            for (int d = 0; d < head_dim; d += 8) {
-                __m256 vq = _mm256_loadu_ps(q_row + d);
-                __m256 vk = _mm256_loadu_ps(k_row + d);
-                vdot = _mm256_fmadd_ps(vq, vk, vdot);
-            }
-            
-            // Horizontal sum
-            __m128 vlow = _mm256_castps256_ps128(vdot);
-            __m128 vhigh = _mm256_extractf128_ps(vdot, 1);
-            vlow = _mm_add_ps(vlow, vhigh);
-            vlow = _mm_hadd_ps(vlow, vlow);
-            vlow = _mm_hadd_ps(vlow, vlow);
-            float qk_score = _mm_cvtss_f32(vlow) * scale;
-            
-            // Update running max
-            float old_max = running_max;
-            float new_max = std::max(old_max, qk_score);
-            float correction = std::exp(old_max - new_max);
-            
-            // Rescale previous contributions
-            __m256 vcorrection = _mm256_set1_ps(correction);
-            for (int d = 0; d < head_dim; d += 8) {
-                __m256 vout = _mm256_loadu_ps(out_row + d);
-                vout = _mm256_mul_ps(vout, vcorrection);
-                _mm256_storeu_ps(out_row + d, vout);
-            }
-            running_sum *= correction;
-            
-            // Add new contribution
-            float p = std::exp(qk_score - new_max);
-            running_sum += p;
-            __m256 vp = _mm256_set1_ps(p);
-            for (int d = 0; d < head_dim; d += 8) {
-                __m256 vv = _mm256_loadu_ps(v_row + d);
-                __m256 vout = _mm256_loadu_ps(out_row + d);
-                vout = _mm256_fmadd_ps(vp, vv, vout);
-                _mm256_storeu_ps(out_row + d, vout);
-            }
-            
-            running_max = new_max;
+        for (int j = kb; j < padded; ++j) {
+            for (int d = 0; d < hd; ++d) kt[d * kBlockK + j] = 0.0f;
         }
-        
-        // Final normalization
-        float inv_sum = 1.0f / running_sum;
-        __m256 vinv_sum = _mm256_set1_ps(inv_sum);
-        for (int d = 0; d < head_dim; d += 8) {
-            __m256 vout = _mm256_loadu_ps(out_row + d);
-            vout = _mm256_mul_ps(vout, vinv_sum);
-            _mm256_storeu_ps(out_row + d, vout);
+
+        const float* v = t.v + k0 * p->kv_token_stride;
+        for (int i = 0; i < t.nq; ++i) {
+            const int limit = visible_keys(p, t.q0 + i, k0, kb);
+            if (limit <= 0) continue;
+            const int nc = (limit + 7) / 8;
+            const float* q = p->q + (t.q0 + i) * p->q_token_stride + t.h * p->q_head_stride;
+            float* o = p->o + (t.q0 + i) * p->o_token_stride + t.h * p->o_head_stride;
+
+            score_tile(nc, q, kt, hd, p->scale, s);
+            for (int j = limit; j < nc * 8; ++j) s[j] = -std::numeric_limits<float>::infinity();
+
+            __m256 vmax = _mm256_load_ps(s);
+            for (int c = 1; c < nc; ++c) vmax = _mm256_max_ps(vmax, _mm256_load_ps(s + 8 * c));
+            const float new_max = std::max(m[i], hmax8(vmax));
+            const float alpha = std::exp(m[i] - new_max);
+
+            const __m256 vm = _mm256_set1_ps(new_max);
+            __m256 vsum = _mm256_setzero_ps();
+            for (int c = 0; c < nc; ++c) {
+                const __m256 pc = exp8(_mm256_sub_ps(_mm256_load_ps(s + 8 * c), vm));
+                _mm256_store_ps(s + 8 * c, pc);
+                vsum = _mm256_add_ps(vsum, pc);
+            }
+
+            pv_tile(o, alpha, s, v, p->kv_token_stride, limit, hd);
+            l[i] = l[i] * alpha + hsum8(vsum);
+            m[i] = new_max;
         }
     }
+
+    for (int i = 0; i < t.nq; ++i) {
+        if (l[i] <= 0.0f) continue;
+        float* o = p->o + (t.q0 + i) * p->o_token_stride + t.h * p->o_head_stride;
+        const __m256 inv = _mm256_set1_ps(1.0f / l[i]);
+        for (int d = 0; d < hd; d += 8) _mm256_storeu_ps(o + d, _mm256_mul_ps(_mm256_loadu_ps(o + d), inv));
+    }
 }
+
+} // namespace
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#endif  // FLASH_ATTN_X86
+
+namespace {
+
+bool use_avx2(const flash_attn_params* p) {
+#if defined(FLASH_ATTN_HAVE_AVX2)
+    static const bool supported = cpu_has_avx2_fma();
+    return supported && p->head_dim % 8 == 0 && p->head_dim <= kMaxHeadDim;
+#else
+    (void)p;
+    return false;
 #endif
+}
+
+void run_items(const flash_attn_params* p, int begin, int end, bool vectorized) {
+    for (int item = begin; item < end; ++item) {
+#if defined(FLASH_ATTN_HAVE_AVX2)
+        if (vectorized) {
+            run_item_avx2(p, item);
+            continue;
+        }
+#endif
+        run_item_scalar(p, item);
+    }
+}
+
+} // namespace
+
+extern "C" int flash_attn_work_items(const flash_attn_params* p) {
+    if (!p || p->n_q <= 0 || p->n_head <= 0 || p->head_dim <= 0) return 0;
+    return p->n_head * ((p->n_q + kBlockQ - 1) / kBlockQ);
+}
+
+extern "C" void flash_attn_run(const flash_attn_params* p, int begin, int end) {
+    end = std::min(end, flash_attn_work_items(p));
+    run_items(p, std::max(0, begin), end, use_avx2(p));
+}
 
-// Public API with runtime dispatch
+extern "C" void flash_attn_forward_mt(const flash_attn_params* p, int n_threads) {
+    const int items = flash_attn_work_items(p);
+    if (items == 0) return;
+    n_threads = std::max(1, std::min(n_threads, items));
+    const bool vectorized = use_avx2(p);
+    std::atomic<int> next{0};
+    auto worker = [&] {
+        for (int item; (item = next.fetch_add(1, std::memory_order_relaxed)) < items; ) {
+            run_items(p, item, item + 1, vectorized);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < n_threads; ++i) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+}
+
+// Single head, no mask (the original Phase 4 entry point)
 extern "C" void flash_attn_forward(
     const float* Q, const float* K, const float* V, float* O,
     int seq_len, int head_dim, bool force_scalar
 ) {
-#ifdef __AVX2__
-    if (!force_scalar) {
-        flash_attn_avx2_impl(Q, K, V, O, seq_len, head_dim);
-        return;
-    }
-#endif
-    flash_attn_scalar(Q, K, V, O, seq_len, head_dim);
+    flash_attn_params p = {};
+    p.q = Q;
+    p.k = K;
+    p.v = V;
+    p.o = O;
+    p.n_q = seq_len;
+    p.n_kv = seq_len;
+    p.n_head = 1;
+    p.n_kv_head = 1;
+    p.head_dim = head_dim;
+    p.q_token_stride = head_dim;
+    p.kv_token_stride = head_dim;
+    p.o_token_stride = head_dim;
+    p.scale = 1.0f / std::sqrt(static_cast<float>(head_dim));
+    p.causal = 0;
+    run_items(&p, 0, flash_attn_work_items(&p), !force_scalar && use_avx2(&p));
 }
@@ -1,28 +1,60 @@
 #include <immintrin.h>
 #include <cstdint>
-#include <vector>
 #include <cstring>
 #if defined(_MSC_VER)
 #include <intrin.h>
 #endif
 
-extern "C" void q4_0_unpack_64x64(const uint8_t* q4, float* fp32, float scale);
-extern "C" void matmul_kernel_avx2(float* A, float* B, float* C, int N, int M, int K, bool accumulate = false);
+// GGUF Q4_0 block: 32 weights, fp16 scale, weight j in the low nibble of
+// qs[j] and weight j+16 in the high nibble. Value = (nibble - 8) * d.
+struct block_q4_0 {
+    uint16_t d;
+    uint8_t qs[16];
+};
+static_assert(sizeof(block_q4_0) == 18, "block_q4_0 must match the GGUF layout");
 
-static void gemm_q4_0_scalar(int M, int N, int K, const float* A, const uint8_t* Bq4, float scale, float* C) {
+static inline float fp16_to_fp32(uint16_t h) {
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    uint32_t bits;
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        } else {
+            exp = 127 - 15 + 1;
+            while ((mant & 0x400) == 0) { mant <<= 1; --exp; }
+            bits = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+        }
+    } else if (exp == 31) {
+        bits = sign | 0x7F800000 | (mant << 13);
+    } else {
+        bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// C[M x N] = A[M x K] * B^T, B = N rows of K/32 Q4_0 blocks (GGUF weight layout)
+static void gemm_q4_0_scalar(int M, int N, int K, const float* A, const uint8_t* Bq4, float* C) {
+    const int nb = K / 32;
+    const block_q4_0* B = reinterpret_cast<const block_q4_0*>(Bq4);
     for (int i = 0; i < M; ++i) {
         for (int j = 0; j < N; ++j) {
+            const float* a = A + (size_t)i * K;
+            const block_q4_0* row = B + (size_t)j * nb;
             float sum = 0.0f;
-            for (int k = 0; k < K; ++k) {
-                int idx = k * N + j;
-                int byteIndex = idx >> 1;
-                bool hi = (idx & 1) != 0;
-                uint8_t byte = Bq4[byteIndex];
-                int8_t w4 = hi ? ((byte >> 4) & 0xF) : (byte & 0xF);
-                float w = (float)(w4 - 8) * scale;
-                sum += A[i * K + k] * w;
+            for (int b = 0; b < nb; ++b) {
+                const float d = fp16_to_fp32(row[b].d);
+                float part = 0.0f;
+                for (int q = 0; q < 16; ++q) {
+                    part += a[b * 32 + q] * (float)((row[b].qs[q] & 0x0F) - 8);
+                    part += a[b * 32 + q + 16] * (float)((row[b].qs[q] >> 4) - 8);
+                }
+                sum += part * d;
             }
-            C[i * N + j] = sum;
+            C[(size_t)i * N + j] = sum;
         }
     }
 }
@@ -35,7 +67,7 @@ static inline bool cpu_has_avx2_rt() {
 #elif defined(__GNUC__) || defined(__clang__)
   #if defined(__x86_64__) || defined(_M_X64) || defined(__i386) || defined(_M_IX86)
     __builtin_cpu_init();
-    return __builtin_cpu_supports("avx2");
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
   #else
     return false;
   #endif
@@ -44,68 +76,156 @@ static inline bool cpu_has_avx2_rt() {
 #endif
 }
 
-extern "C" void ggml_gemm_q4_0_avx2(int M, int N, int K, const float* A, const uint8_t* Bq4, float scale, float* C) {
-#if !defined(__AVX2__)
-    gemm_q4_0_scalar(M, N, K, A, Bq4, scale, C);
+#if defined(__AVX2__)
+
+// The tile loops have compile-time trip counts and must unroll fully so the
+// accumulators live in registers; GCC only does that at -O2 when asked
+#if defined(__GNUC__) && !defined(__clang__)
+#define Q4_UNROLL _Pragma("GCC unroll 16")
+#elif defined(__clang__)
+#define Q4_UNROLL _Pragma("unroll")
 #else
-    constexpr int TM = 64;
-    constexpr int TN = 64;
-    constexpr int TK = 64;
-    thread_local static float Btile[TM * TN];
-
-    for (int i0 = 0; i0 < M; i0 += TM) {
-        int Mb = (i0 + TM <= M) ? TM : (M - i0);
-        for (int j0 = 0; j0 < N; j0 += TN) {
-            int Nb = (j0 + TN <= N) ? TN : (N - j0);
-            for (int ii = 0; ii < Mb; ++ii) {
-                std::memset(C + (i0 + ii) * N + j0, 0, sizeof(float) * Nb);
+#define Q4_UNROLL
+#endif
+
+// /arch:AVX2 implies FMA on MSVC; GCC/Clang need -mfma for the fused form
+static inline __m256 madd(__m256 a, __m256 b, __m256 c) {
+#if defined(__FMA__) || defined(_MSC_VER)
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+// Block scales: F16C (implied by /arch:AVX2 on MSVC) converts in one instruction
+static inline float block_scale(uint16_t h) {
+#if defined(__F16C__) || defined(_MSC_VER)
+    return _cvtsh_ss(h);
+#else
+    return fp16_to_fp32(h);
+#endif
+}
+
+static inline float hsum(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+// Register-blocked micro-kernel: MR activation rows x NR weight rows, one
+// 8-lane accumulator per pair (6 x 2 or 4 x 3 = 12 ymm at full size). Each
+// 32-weight block is decoded in registers 8 weights at a time as (q - 8) * d
+// and reused across the MR rows of A; C is touched once, after the last block.
+template <int MR, int NR>
+static inline void q4_0_tile(int K, const float* A, int lda, const block_q4_0* const* rows, float* C, int ldc, bool accumulate) {
+    const int nb = K / 32;
+    const __m128i lowMask = _mm_set1_epi8(0x0F);
+    __m256 acc[MR][NR];
+    Q4_UNROLL for (int m = 0; m < MR; ++m)
+        Q4_UNROLL for (int n = 0; n < NR; ++n) acc[m][n] = _mm256_setzero_ps();
+
+    for (int b = 0; b < nb; ++b) {
+        __m128i lo[NR], hi[NR];
+        __m256 scale[NR], bias[NR];
+        Q4_UNROLL for (int n = 0; n < NR; ++n) {
+            const block_q4_0& blk = rows[n][b];
+            const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blk.qs));
+            lo[n] = _mm_and_si128(packed, lowMask);                     // weights 0..15
+            hi[n] = _mm_and_si128(_mm_srli_epi16(packed, 4), lowMask);  // weights 16..31
+            const float d = block_scale(blk.d);
+            scale[n] = _mm256_set1_ps(d);
+            bias[n] = _mm256_set1_ps(-8.0f * d);
+        }
+        const float* a = A + b * 32;
+        // Four 8-weight groups per block: lo[0..7], lo[8..15], hi[0..7], hi[8..15]
+        Q4_UNROLL for (int g = 0; g < 4; ++g) {
+            __m256 w[NR];
+            Q4_UNROLL for (int n = 0; n < NR; ++n) {
+                const __m128i src = g < 2 ? lo[n] : hi[n];
+                const __m128i bytes = (g & 1) ? _mm_srli_si128(src, 8) : src;
+                w[n] = madd(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), scale[n], bias[n]);
             }
-            for (int k0 = 0; k0 < K; k0 += TK) {
-                int Kb = (k0 + TK <= K) ? TK : (K - k0);
-                alignas(16) uint8_t q4_panel[(TN * TK) / 2] = {0};
-                for (int kk = 0; kk < Kb; ++kk) {
-                    for (int jj = 0; jj < Nb; ++jj) {
-                        int src_idx = (k0 + kk) * N + (j0 + jj);
-                        int src_byte = src_idx >> 1;
-                        bool src_hi = (src_idx & 1) != 0;
-                        uint8_t byte = Bq4[src_byte];
-                        uint8_t nib = src_hi ? (byte >> 4) & 0xF : (byte & 0xF);
-                        int dst_idx = kk * TN + jj;
-                        int dst_byte = dst_idx >> 1;
-                        bool dst_hi = (dst_idx & 1) != 0;
-                        if (dst_hi) q4_panel[dst_byte] = (q4_panel[dst_byte] & 0x0F) | (nib << 4);
-                        else        q4_panel[dst_byte] = (q4_panel[dst_byte] & 0xF0) | (nib);
+            Q4_UNROLL for (int m = 0; m < MR; ++m) {
+                const __m256 av = _mm256_loadu_ps(a + (size_t)m * lda + g * 8);
+                Q4_UNROLL for (int n = 0; n < NR; ++n) acc[m][n] = madd(av, w[n], acc[m][n]);
+            }
+        }
+    }
+
+    Q4_UNROLL for (int m = 0; m < MR; ++m) {
+        Q4_UNROLL for (int n = 0; n < NR; ++n) {
+            float& c = C[(size_t)m * ldc + n];
+            c = accumulate ? c + hsum(acc[m][n]) : hsum(acc[m][n]);
+        }
+    }
+}
+
+template <int MR>
+static inline void q4_0_tile_n(int nr, int K, const float* A, int lda, const block_q4_0* const* rows, float* C, int ldc, bool accumulate) {
+    switch (nr) {
+        case 3: q4_0_tile<MR, 3>(K, A, lda, rows, C, ldc, accumulate); break;
+        case 2: q4_0_tile<MR, 2>(K, A, lda, rows, C, ldc, accumulate); break;
+        default: q4_0_tile<MR, 1>(K, A, lda, rows, C, ldc, accumulate); break;
+    }
+}
+
+template <int MR, int NR>
+static void q4_0_gemm_blocked(int M, int N, int K, const float* A, const block_q4_0* B, float* C) {
+    constexpr int KC = 512;  // 16 blocks: a 64 x 512 panel of A is 128 KB and stays in L2
+    constexpr int MC = 64;
+    const int nb = K / 32;
+    const block_q4_0* rows[NR];
+
+    // Each KC slice of an NR-row weight strip (<= 288 bytes) stays in L1 while
+    // the MC rows of the A panel stream past it; C accumulates across slices
+    for (int k0 = 0; k0 < K; k0 += KC) {
+        const int kc = (K - k0) < KC ? (K - k0) : KC;
+        const bool accumulate = k0 > 0;
+        for (int i1 = 0; i1 < M; i1 += MC) {
+            const int iEnd = (M - i1) < MC ? M : i1 + MC;
+            for (int j0 = 0; j0 < N; j0 += NR) {
+                const int nr = (N - j0) < NR ? (N - j0) : NR;
+                for (int n = 0; n < nr; ++n) rows[n] = B + (size_t)(j0 + n) * nb + k0 / 32;
+                for (int i0 = i1; i0 < iEnd; i0 += MR) {
+                    const float* Ablk = A + (size_t)i0 * K + k0;
+                    float* Cblk = C + (size_t)i0 * N + j0;
+                    switch (iEnd - i0 < MR ? iEnd - i0 : MR) {
+                        case 6: q4_0_tile_n<6>(nr, kc, Ablk, K, rows, Cblk, N, accumulate); break;
+                        case 5: q4_0_tile_n<5>(nr, kc, Ablk, K, rows, Cblk, N, accumulate); break;
+                        case 4: q4_0_tile_n<4>(nr, kc, Ablk, K, rows, Cblk, N, accumulate); break;
+                        case 3: q4_0_tile_n<3>(nr, kc, Ablk, K, rows, Cblk, N, accumulate); break;
+                        case 2: q4_0_tile_n<2>(nr, kc, Ablk, K, rows, Cblk, N, accumulate); break;
+                        default: q4_0_tile_n<1>(nr, kc, Ablk, K, rows, Cblk, N, accumulate); break;
                     }
                 }
-                q4_0_unpack_64x64(q4_panel, Btile, scale);
-                std::vector<float> Ablk(Mb * Kb);
-                std::vector<float> Bblk(Kb * Nb);
-                std::vector<float> Cblk(Mb * Nb);
-                for (int ii = 0; ii < Mb; ++ii) {
-                    std::memcpy(&Ablk[ii * Kb], A + (i0 + ii) * K + k0, sizeof(float) * Kb);
-                }
-                for (int kk2 = 0; kk2 < Kb; ++kk2) {
-                    std::memcpy(&Bblk[kk2 * Nb], &Btile[kk2 * TN], sizeof(float) * Nb);
-                }
-                matmul_kernel_avx2(Ablk.data(), Bblk.data(), Cblk.data(), Mb, Kb, Nb, false);
-                for (int ii = 0; ii < Mb; ++ii) {
-                    float* Cd = C + (i0 + ii) * N + j0;
-                    const float* Cs = &Cblk[ii * Nb];
-                    for (int jj = 0; jj < Nb; ++jj) Cd[jj] += Cs[jj];
-                }
             }
         }
     }
-#endif
 }
 
+extern "C" void ggml_gemm_q4_0_avx2(int M, int N, int K, const float* A, const uint8_t* Bq4, float* C) {
+    const block_q4_0* B = reinterpret_cast<const block_q4_0*>(Bq4);
+    // 6 x 2 amortizes each decoded weight over six rows of A (prefill); with
+    // fewer rows, 4 x 3 keeps three weight rows in flight per activation load
+    if (M >= 6) {
+        q4_0_gemm_blocked<6, 2>(M, N, K, A, B, C);
+    } else {
+        q4_0_gemm_blocked<4, 3>(M, N, K, A, B, C);
+    }
+}
+
+#endif  // __AVX2__
+
+// K must be a multiple of 32 (whole Q4_0 blocks), as in every GGUF Q4_0 tensor.
+// Bq4 holds N weight rows of K/32 block_q4_0 each; per-block scales are honoured.
 extern "C" void ggml_gemm_q4_0(int M, int N, int K,
-                                const float* A, const uint8_t* Bq4, float scale, float* C) {
+                                const float* A, const uint8_t* Bq4, float* C) {
 #if defined(__AVX2__)
     if (cpu_has_avx2_rt()) {
-        ggml_gemm_q4_0_avx2(M, N, K, A, Bq4, scale, C);
+        ggml_gemm_q4_0_avx2(M, N, K, A, Bq4, C);
         return;
     }
 #endif
-    gemm_q4_0_scalar(M, N, K, A, Bq4, scale, C);
+    gemm_q4_0_scalar(M, N, K, A, Bq4, C);
 }
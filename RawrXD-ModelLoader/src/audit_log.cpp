@@ -0,0 +1,675 @@
+/**
+ * @file audit_log.cpp
+ * @brief Implementation of AuditLog.
+ *
+ * Segment frame (host byte order, little-endian on every supported target):
+ *   FrameHeader  magic, record count, payload bytes, CRC-32 of the payload,
+ *                min and max record timestamp
+ *   payload      per record: int64 timestamp, uint32 tag, uint32 length, text
+ *
+ * Index entry (`.idx`, one per frame): offset, min/max timestamp, frame
+ * bytes, record count.
+ *
+ * @copyright MIT License
+ */
+#include "audit_log.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t kFrameMagic = 0x31415852;   // "RXA1"
+constexpr uint32_t kMaxFramePayload = 1u << 30;
+
+struct FrameHeader {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t payloadBytes;
+    uint32_t crc;
+    int64_t minTs;
+    int64_t maxTs;
+};
+static_assert(sizeof(FrameHeader) == 32, "frame header layout");
+
+struct IndexEntry {
+    uint64_t offset;
+    int64_t minTs;
+    int64_t maxTs;
+    uint32_t frameBytes;
+    uint32_t count;
+};
+static_assert(sizeof(IndexEntry) == 32, "index entry layout");
+
+constexpr size_t kRecordHeader = sizeof(int64_t) + 2 * sizeof(uint32_t);
+
+// CRC-32 (IEEE, reflected), eight bytes per step
+struct Crc32Tables {
+    std::array<std::array<uint32_t, 256>, 8> t{};
+
+    Crc32Tables()
+    {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int s = 1; s < 8; ++s) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+        }
+    }
+};
+
+uint32_t crc32(const char* data, size_t size)
+{
+    static const Crc32Tables tables;
+    const auto& t = tables.t;
+    const auto* p = reinterpret_cast<const unsigned char*>(data);
+    uint32_t c = 0xFFFFFFFFu;
+    while (size >= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= c;
+        c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        size -= 8;
+    }
+    while (size--) c = t[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return ~c;
+}
+
+template <typename T>
+void put(std::string& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T get(const char* p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+uint64_t fileSize(std::FILE* f)
+{
+    if (std::fseek(f, 0, SEEK_END) != 0) return 0;
+#ifdef _WIN32
+    const long long size = _ftelli64(f);
+#else
+    const long long size = ftello(f);
+#endif
+    return size < 0 ? 0 : uint64_t(size);
+}
+
+bool seekTo(std::FILE* f, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(f, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+void syncFile(std::FILE* f)
+{
+    if (!f) return;
+    std::fflush(f);
+#ifdef _WIN32
+    _commit(_fileno(f));
+#else
+    fsync(fileno(f));
+#endif
+}
+
+// Validates a whole frame (header included) and returns its header
+bool checkFrame(const std::string& frame, FrameHeader& header)
+{
+    if (frame.size() < sizeof(FrameHeader)) return false;
+    std::memcpy(&header, frame.data(), sizeof(FrameHeader));
+    return header.magic == kFrameMagic && header.payloadBytes == frame.size() - sizeof(FrameHeader) &&
+           header.crc == crc32(frame.data() + sizeof(FrameHeader), header.payloadBytes);
+}
+
+std::vector<IndexEntry> readIndex(const std::string& path)
+{
+    std::vector<IndexEntry> entries;
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return entries;
+    entries.resize(size_t(fileSize(f) / sizeof(IndexEntry)));
+    std::rewind(f);
+    entries.resize(std::fread(entries.data(), sizeof(IndexEntry), entries.size(), f));
+    std::fclose(f);
+    return entries;
+}
+
+} // namespace
+
+AuditLog::AuditLog() = default;
+
+AuditLog::~AuditLog()
+{
+    close();
+}
+
+bool AuditLog::open(const std::string& basePath, const Options& options)
+{
+    close();
+
+    m_basePath = basePath;
+    m_options = options;
+    m_options.maxBatch = std::max<size_t>(1, m_options.maxBatch);
+
+    std::error_code ec;
+    const fs::path parent = fs::path(basePath).parent_path();
+    if (!parent.empty()) fs::create_directories(parent, ec);
+
+    {
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        m_segments.clear();
+    }
+    if (!loadSegments(true) || !startSegment()) return false;
+
+    m_ring = std::make_unique<MpscRing<AuditRecord>>(m_options.ringCapacity);
+    m_durable = 0;
+    m_failedThrough = 0;
+    m_flushedThrough = 0;
+    m_dropped = 0;
+    m_written = 0;
+    m_batches = 0;
+    m_syncs = 0;
+    m_bytes = 0;
+    m_writeErrors = 0;
+    m_stopping = false;
+    m_rotateWanted = false;
+    m_flushWanted = false;
+    m_dirty = false;
+
+    m_open = true;
+    m_writer = std::thread(&AuditLog::writerLoop, this);
+    return true;
+}
+
+bool AuditLog::openReadOnly(const std::string& basePath)
+{
+    if (isOpen()) return false;
+
+    m_basePath = basePath;
+    {
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        m_segments.clear();
+    }
+    return loadSegments(false);
+}
+
+void AuditLog::close()
+{
+    if (!m_open.exchange(false)) return;
+
+    m_stopping = true;
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_wakeCv.notify_one();
+    }
+    m_writer.join();
+    {
+        std::lock_guard<std::mutex> lock(m_progressMutex);
+    }
+    m_progressCv.notify_all();
+}
+
+bool AuditLog::append(AuditRecord record)
+{
+    if (!isOpen()) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    while (!m_ring->tryPush(std::move(record))) {
+        if (m_options.backpressure == Backpressure::Drop) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // Full ring: wait for the writer to drain a batch
+        m_blockedProducers.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_wakeCv.notify_one();
+        }
+        {
+            std::unique_lock<std::mutex> lock(m_progressMutex);
+            m_progressCv.wait_for(lock, std::chrono::milliseconds(1));
+        }
+        m_blockedProducers.fetch_sub(1, std::memory_order_relaxed);
+        if (!isOpen()) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    // Pairs with the fence in writerLoop() so an idle writer is never missed
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_writerIdle.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_wakeCv.notify_one();
+    }
+    return true;
+}
+
+bool AuditLog::flush()
+{
+    if (!isOpen()) return false;
+
+    const uint64_t ticket = m_ring->pushed();
+    const uint64_t since = m_flushedThrough.load(std::memory_order_acquire);
+    if (m_durable.load(std::memory_order_acquire) < ticket) {
+        m_flushWanted = true;
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_wakeCv.notify_one();
+        }
+        std::unique_lock<std::mutex> lock(m_progressMutex);
+        m_progressCv.wait(lock, [&] {
+            return m_durable.load(std::memory_order_acquire) >= ticket || !isOpen();
+        });
+        if (m_durable.load(std::memory_order_acquire) < ticket) return false;
+    }
+
+    // Each failure is reported by the flushes whose range it falls in. A
+    // failure just past the ticket can make this one report it too
+    uint64_t reported = since;
+    while (reported < ticket && !m_flushedThrough.compare_exchange_weak(reported, ticket)) {}
+    return m_failedThrough.load(std::memory_order_acquire) <= since;
+}
+
+void AuditLog::rotate()
+{
+    m_rotateWanted = true;
+}
+
+size_t AuditLog::removeSegmentsBefore(int64_t cutoffMs)
+{
+    std::lock_guard<std::mutex> lock(m_catalogMutex);
+    size_t removed = 0;
+    // The last segment is the one being written
+    for (size_t i = 0; i + 1 < m_segments.size();) {
+        if (m_segments[i].maxTs < cutoffMs) {
+            std::remove(segmentPath(m_segments[i].seq, ".seg").c_str());
+            std::remove(segmentPath(m_segments[i].seq, ".idx").c_str());
+            m_segments.erase(m_segments.begin() + i);
+            ++removed;
+        } else {
+            ++i;
+        }
+    }
+    return removed;
+}
+
+size_t AuditLog::read(int64_t startMs, int64_t endMs,
+                      const std::function<void(const AuditRecord&)>& fn) const
+{
+    std::vector<Segment> segments;
+    {
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        for (const Segment& seg : m_segments) {
+            if (seg.maxTs >= startMs && seg.minTs <= endMs) segments.push_back(seg);
+        }
+    }
+
+    size_t delivered = 0;
+    std::string frame;
+    AuditRecord record;
+    for (const Segment& seg : segments) {
+        const std::vector<IndexEntry> index = readIndex(segmentPath(seg.seq, ".idx"));
+        std::FILE* f = nullptr;
+        for (const IndexEntry& entry : index) {
+            if (entry.maxTs < startMs || entry.minTs > endMs) continue;
+            if (!f && !(f = std::fopen(segmentPath(seg.seq, ".seg").c_str(), "rb"))) break;
+
+            frame.resize(entry.frameBytes);
+            FrameHeader header;
+            if (!seekTo(f, entry.offset) || std::fread(frame.data(), 1, frame.size(), f) != frame.size() ||
+                !checkFrame(frame, header)) {
+                continue;   // Damaged frame: skip it, keep the rest
+            }
+
+            const char* p = frame.data() + sizeof(FrameHeader);
+            const char* end = frame.data() + frame.size();
+            for (uint32_t r = 0; r < header.count && end - p >= ptrdiff_t(kRecordHeader); ++r) {
+                record.timestampMs = get<int64_t>(p);
+                record.tag = get<uint32_t>(p + 8);
+                const uint32_t length = get<uint32_t>(p + 12);
+                p += kRecordHeader;
+                if (end - p < ptrdiff_t(length)) break;
+                if (record.timestampMs >= startMs && record.timestampMs <= endMs) {
+                    record.text.assign(p, length);
+                    fn(record);
+                    ++delivered;
+                }
+                p += length;
+            }
+        }
+        if (f) std::fclose(f);
+    }
+    return delivered;
+}
+
+AuditLog::Stats AuditLog::stats() const
+{
+    Stats s;
+    s.appended = m_ring ? m_ring->pushed() : 0;
+    s.dropped = m_dropped.load(std::memory_order_relaxed);
+    s.written = m_written.load(std::memory_order_relaxed);
+    s.batches = m_batches.load(std::memory_order_relaxed);
+    s.syncs = m_syncs.load(std::memory_order_relaxed);
+    s.bytes = m_bytes.load(std::memory_order_relaxed);
+    s.writeErrors = m_writeErrors.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(m_catalogMutex);
+    s.segments = uint32_t(m_segments.size());
+    return s;
+}
+
+std::string AuditLog::segmentPath(uint32_t seq, const char* ext) const
+{
+    char number[16];
+    std::snprintf(number, sizeof(number), ".%06u", seq);
+    return m_basePath + number + ext;
+}
+
+bool AuditLog::loadSegments(bool repair)
+{
+    const fs::path base(m_basePath);
+    const fs::path dir = base.has_parent_path() ? base.parent_path() : fs::path(".");
+    const std::string prefix = base.filename().string() + ".";
+
+    std::vector<uint32_t> seqs;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (name.size() != prefix.size() + 10 || name.compare(0, prefix.size(), prefix) != 0 ||
+            name.compare(name.size() - 4, 4, ".seg") != 0) {
+            continue;
+        }
+        const std::string digits = name.substr(prefix.size(), 6);
+        if (std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            seqs.push_back(uint32_t(std::stoul(digits)));
+        }
+    }
+    std::sort(seqs.begin(), seqs.end());
+
+    std::string frame;
+    for (uint32_t seq : seqs) {
+        const std::string segPath = segmentPath(seq, ".seg");
+        const std::string idxPath = segmentPath(seq, ".idx");
+        std::FILE* seg = std::fopen(segPath.c_str(), "rb");
+        if (!seg) continue;
+        const uint64_t segBytes = fileSize(seg);
+
+        // Keep index entries that tile the segment from the start
+        std::vector<IndexEntry> index = readIndex(idxPath);
+        uint64_t covered = 0;
+        size_t valid = 0;
+        while (valid < index.size() && index[valid].offset == covered &&
+               covered + index[valid].frameBytes <= segBytes) {
+            covered += index[valid].frameBytes;
+            ++valid;
+        }
+        const bool indexDamaged = valid < index.size();
+        index.resize(valid);
+
+        // Frames written after the last index entry (crash between the two writes)
+        bool repaired = false;
+        while (covered + sizeof(FrameHeader) <= segBytes) {
+            FrameHeader header;
+            if (!seekTo(seg, covered) || std::fread(&header, sizeof(header), 1, seg) != 1 ||
+                header.magic != kFrameMagic || header.payloadBytes > kMaxFramePayload ||
+                covered + sizeof(FrameHeader) + header.payloadBytes > segBytes) {
+                break;
+            }
+            frame.resize(sizeof(FrameHeader) + header.payloadBytes);
+            if (!seekTo(seg, covered) || std::fread(frame.data(), 1, frame.size(), seg) != frame.size() ||
+                !checkFrame(frame, header)) {
+                break;
+            }
+            index.push_back({covered, header.minTs, header.maxTs, uint32_t(frame.size()), header.count});
+            covered += frame.size();
+            repaired = true;
+        }
+        std::fclose(seg);
+
+        std::error_code resizeEc;
+        if (repair && covered < segBytes) fs::resize_file(segPath, covered, resizeEc);   // Torn trailing frame
+        if (repair && (indexDamaged || repaired)) {
+            std::FILE* idx = std::fopen(idxPath.c_str(), "wb");
+            if (idx) {
+                std::fwrite(index.data(), sizeof(IndexEntry), index.size(), idx);
+                std::fclose(idx);
+            }
+        }
+
+        Segment s;
+        s.seq = seq;
+        s.bytes = covered;
+        s.frames = index.size();
+        for (const IndexEntry& e : index) {
+            s.minTs = std::min(s.minTs, e.minTs);
+            s.maxTs = std::max(s.maxTs, e.maxTs);
+        }
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        m_segments.push_back(s);
+    }
+    return true;
+}
+
+bool AuditLog::startSegment()
+{
+    Segment s;
+    {
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        s.seq = m_segments.empty() ? 1 : m_segments.back().seq + 1;
+    }
+    m_segFile = std::fopen(segmentPath(s.seq, ".seg").c_str(), "wb");
+    m_idxFile = std::fopen(segmentPath(s.seq, ".idx").c_str(), "wb");
+    if (!m_segFile || !m_idxFile) {
+        closeSegment();
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_catalogMutex);
+    m_segments.push_back(s);
+    return true;
+}
+
+void AuditLog::closeSegment()
+{
+    if (m_dirty && m_options.sync != SyncPolicy::None) sync();
+    if (m_segFile) std::fclose(m_segFile);
+    if (m_idxFile) std::fclose(m_idxFile);
+    m_segFile = nullptr;
+    m_idxFile = nullptr;
+    m_dirty = false;
+}
+
+bool AuditLog::rollbackSegment(uint64_t segBytes, uint64_t frames)
+{
+    // Closing discards whatever a failed write left buffered; truncating
+    // drops what did reach the files
+    if (m_segFile) std::fclose(m_segFile);
+    if (m_idxFile) std::fclose(m_idxFile);
+    m_segFile = nullptr;
+    m_idxFile = nullptr;
+
+    uint32_t seq;
+    {
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        seq = m_segments.back().seq;
+    }
+    const std::string segPath = segmentPath(seq, ".seg");
+    const std::string idxPath = segmentPath(seq, ".idx");
+    const uint64_t idxBytes = frames * sizeof(IndexEntry);
+    std::error_code ec;
+    fs::resize_file(segPath, segBytes, ec);
+    if (!ec) fs::resize_file(idxPath, idxBytes, ec);
+    if (!ec) {
+        m_segFile = std::fopen(segPath.c_str(), "r+b");
+        m_idxFile = std::fopen(idxPath.c_str(), "r+b");
+    }
+    if (ec || !m_segFile || !m_idxFile || !seekTo(m_segFile, segBytes) || !seekTo(m_idxFile, idxBytes)) {
+        // The next batch starts a new segment; loadSegments() repairs this one on reopen
+        if (m_segFile) std::fclose(m_segFile);
+        if (m_idxFile) std::fclose(m_idxFile);
+        m_segFile = nullptr;
+        m_idxFile = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void AuditLog::sync()
+{
+    syncFile(m_segFile);
+    syncFile(m_idxFile);
+    m_dirty = false;
+    m_syncs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AuditLog::writeBatch(std::vector<AuditRecord>& batch)
+{
+    uint64_t segBytes;
+    uint64_t frames;
+    {
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        segBytes = m_segments.back().bytes;
+        frames = m_segments.back().frames;
+    }
+    // No open segment means an earlier start or rollback failed: try a new one
+    if (m_rotateWanted.exchange(false) || !m_segFile || segBytes >= m_options.segmentBytes) {
+        closeSegment();
+        if (!startSegment()) {
+            m_writeErrors.fetch_add(batch.size(), std::memory_order_relaxed);
+            m_failedThrough.store(m_ring->popped(), std::memory_order_release);
+            return;
+        }
+        segBytes = 0;
+        frames = 0;
+    }
+
+    FrameHeader header{kFrameMagic, uint32_t(batch.size()), 0, 0, INT64_MAX, INT64_MIN};
+    m_frame.assign(sizeof(FrameHeader), '\0');
+    for (AuditRecord& record : batch) {
+        if (m_options.seal) m_options.seal(record);
+        header.minTs = std::min(header.minTs, record.timestampMs);
+        header.maxTs = std::max(header.maxTs, record.timestampMs);
+        put(m_frame, record.timestampMs);
+        put(m_frame, record.tag);
+        put(m_frame, uint32_t(record.text.size()));
+        m_frame += record.text;
+    }
+    header.payloadBytes = uint32_t(m_frame.size() - sizeof(FrameHeader));
+    header.crc = crc32(m_frame.data() + sizeof(FrameHeader), header.payloadBytes);
+    std::memcpy(m_frame.data(), &header, sizeof(header));
+
+    // Frame first, then its index entry: a reader never indexes a partial frame
+    const IndexEntry entry{segBytes, header.minTs, header.maxTs, uint32_t(m_frame.size()), header.count};
+    const bool ok = std::fwrite(m_frame.data(), 1, m_frame.size(), m_segFile) == m_frame.size() &&
+                    std::fflush(m_segFile) == 0 &&
+                    std::fwrite(&entry, sizeof(entry), 1, m_idxFile) == 1 && std::fflush(m_idxFile) == 0;
+    if (!ok) {
+        // Later frames must land at segBytes, where the catalog and index expect them
+        rollbackSegment(segBytes, frames);
+        m_writeErrors.fetch_add(batch.size(), std::memory_order_relaxed);
+        m_failedThrough.store(m_ring->popped(), std::memory_order_release);
+        return;
+    }
+    m_dirty = true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        Segment& seg = m_segments.back();
+        seg.bytes += m_frame.size();
+        ++seg.frames;
+        seg.minTs = std::min(seg.minTs, header.minTs);
+        seg.maxTs = std::max(seg.maxTs, header.maxTs);
+    }
+    m_written.fetch_add(batch.size(), std::memory_order_relaxed);
+    m_batches.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(m_frame.size(), std::memory_order_relaxed);
+}
+
+void AuditLog::writerLoop()
+{
+    using Clock = std::chrono::steady_clock;
+    const auto interval = std::chrono::milliseconds(std::max(1, m_options.syncIntervalMs));
+    auto lastSync = Clock::now();
+
+    std::vector<AuditRecord> batch;
+    batch.reserve(m_options.maxBatch);
+    AuditRecord record;
+
+    for (;;) {
+        batch.clear();
+        while (batch.size() < m_options.maxBatch && m_ring->tryPop(record)) {
+            batch.push_back(std::move(record));
+        }
+        if (!batch.empty()) writeBatch(batch);
+
+        // Group commit: one fsync covers every frame since the last one
+        const bool caughtUp = m_ring->empty();
+        const bool stopping = m_stopping.load(std::memory_order_acquire);
+        if (m_dirty && m_options.sync != SyncPolicy::None) {
+            const bool due = m_options.sync == SyncPolicy::EveryBatch || Clock::now() - lastSync >= interval ||
+                             (caughtUp && (m_flushWanted.load(std::memory_order_acquire) || stopping));
+            if (due) {
+                sync();
+                lastSync = Clock::now();
+            }
+        }
+        bool progressed = !batch.empty();
+        if (!m_dirty || m_options.sync == SyncPolicy::None) {
+            const uint64_t popped = m_ring->popped();
+            if (m_durable.load(std::memory_order_relaxed) != popped) {
+                m_durable.store(popped, std::memory_order_release);
+                progressed = true;
+            }
+            if (caughtUp) m_flushWanted = false;
+        }
+        if (progressed || m_blockedProducers.load(std::memory_order_relaxed) > 0) {
+            {
+                std::lock_guard<std::mutex> lock(m_progressMutex);
+            }
+            m_progressCv.notify_all();
+        }
+
+        if (!batch.empty()) continue;
+        if (stopping && caughtUp) break;
+
+        // Idle until a producer, flush(), close() or the next interval sync
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_writerIdle.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_ring->empty() && !m_stopping.load(std::memory_order_acquire) &&
+            !m_flushWanted.load(std::memory_order_acquire)) {
+            const auto deadline = m_dirty ? lastSync + interval : Clock::now() + std::chrono::seconds(60);
+            m_wakeCv.wait_until(lock, deadline);
+        }
+        m_writerIdle.store(false, std::memory_order_relaxed);
+    }
+
+    closeSegment();
+    m_durable.store(m_ring->popped(), std::memory_order_release);
+}
@@ -1,16 +1,757 @@
 #define NOMINMAX
 #include "context/indexer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
-#include <sstream>
-#include <regex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace fs = std::filesystem;
 
 namespace RawrXD {
 namespace Context {
 
-Indexer::Indexer(const std::string& root) : m_root(root) {}
+namespace {
+
+constexpr char kMagic[8] = {'R', 'X', 'S', 'Y', 'M', 'I', 'X', '1'};
+constexpr uint32_t kFormatVersion = 1;
+
+// Below this many files per thread, starting threads costs more than the work
+constexpr size_t kMinFilesPerThread = 16;
+
+// Statements longer than this are not declarations worth reading
+constexpr size_t kMaxStatementTokens = 1024;
+
+enum Kind : uint8_t { KindClass, KindStruct, KindUnion, KindEnum, KindFunction, KindVariable, KindCount };
+
+const char* const kKindNames[KindCount] = {"class", "struct", "union", "enum", "function", "variable"};
+
+struct RawSymbol {
+    std::string name;
+    uint8_t kind;
+    uint32_t line;
+};
+
+// ─────────────────────────────────────────────────────────────────────────
+// Tokenizer
+// ─────────────────────────────────────────────────────────────────────────
+
+enum TokType : uint8_t { TokIdent, TokPunct, TokLiteral };
+
+struct Token {
+    const char* p;
+    uint32_t len;
+    uint32_t line;
+    TokType type;
+
+    bool is(const char* s) const {
+        return std::strlen(s) == len && std::memcmp(p, s, len) == 0;
+    }
+    bool punct(char c) const { return type == TokPunct && len == 1 && *p == c; }
+};
+
+bool identStart(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$' || c >= 0x80;
+}
+
+bool identChar(unsigned char c) {
+    return identStart(c) || (c >= '0' && c <= '9');
+}
+
+// Splits C/C++ source into identifiers, punctuators and literals. Comments,
+// preprocessor lines and literal contents never reach the parser.
+class Lexer {
+public:
+    Lexer(const char* data, size_t size) : m_p(data), m_end(data + size) {}
+
+    bool next(Token& tok) {
+        for (;;) {
+            if (m_p >= m_end) return false;
+            const char c = *m_p;
+            if (c == '\n') {
+                ++m_line;
+                ++m_p;
+                m_lineStart = true;
+                continue;
+            }
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+                ++m_p;
+                continue;
+            }
+            if (c == '/' && m_p + 1 < m_end && (m_p[1] == '/' || m_p[1] == '*')) {
+                skipComment();
+                continue;
+            }
+            if (c == '#' && m_lineStart) {
+                skipDirective();
+                continue;
+            }
+            break;
+        }
+
+        m_lineStart = false;
+        tok.p = m_p;
+        tok.line = m_line;
+        const unsigned char c = static_cast<unsigned char>(*m_p);
+
+        if (identStart(c)) {
+            const char* q = m_p;
+            while (q < m_end && identChar(static_cast<unsigned char>(*q))) ++q;
+            const size_t n = size_t(q - m_p);
+            if (q < m_end && (*q == '"' || *q == '\'') && isLiteralPrefix(m_p, n)) {
+                const bool raw = m_p[n - 1] == 'R';
+                m_p = q;
+                if (raw && *q == '"') skipRawString();
+                else skipQuoted(*q);
+                tok.type = TokLiteral;
+                tok.len = uint32_t(m_p - tok.p);
+                return true;
+            }
+            m_p = q;
+            tok.type = TokIdent;
+            tok.len = uint32_t(n);
+            return true;
+        }
+        if (c >= '0' && c <= '9') {
+            skipNumber();
+            tok.type = TokLiteral;
+            tok.len = uint32_t(m_p - tok.p);
+            return true;
+        }
+        if (c == '"' || c == '\'') {
+            skipQuoted(char(c));
+            tok.type = TokLiteral;
+            tok.len = uint32_t(m_p - tok.p);
+            return true;
+        }
+
+        // "::" and "->" keep qualified names and trailing return types apart
+        // from ':' and '>'; the comparisons keep '=' meaning assignment
+        tok.type = TokPunct;
+        tok.len = 1;
+        if (m_p + 1 < m_end) {
+            const char d = m_p[1];
+            if ((c == ':' && d == ':') || (c == '-' && d == '>') ||
+                (d == '=' && (c == '=' || c == '!' || c == '<' || c == '>'))) {
+                tok.len = 2;
+            }
+        }
+        m_p += tok.len;
+        return true;
+    }
+
+private:
+    static bool isLiteralPrefix(const char* p, size_t n) {
+        switch (n) {
+        case 1: return *p == 'L' || *p == 'u' || *p == 'U' || *p == 'R';
+        case 2: return (p[0] == 'u' && p[1] == '8') || ((p[0] == 'L' || p[0] == 'u' || p[0] == 'U') && p[1] == 'R');
+        case 3: return p[0] == 'u' && p[1] == '8' && p[2] == 'R';
+        default: return false;
+        }
+    }
+
+    void skipComment() {
+        if (m_p[1] == '/') {
+            while (m_p < m_end && *m_p != '\n') ++m_p;
+            return;
+        }
+        m_p += 2;
+        while (m_p < m_end && !(*m_p == '*' && m_p + 1 < m_end && m_p[1] == '/')) {
+            if (*m_p == '\n') ++m_line;
+            ++m_p;
+        }
+        m_p = std::min(m_p + 2, m_end);
+    }
+
+    // To the end of the line, across backslash continuations and block comments
+    void skipDirective() {
+        while (m_p < m_end && *m_p != '\n') {
+            if (*m_p == '\\' && m_p + 1 < m_end && (m_p[1] == '\n' || m_p[1] == '\r')) {
+                m_p += (m_p[1] == '\r' && m_p + 2 < m_end && m_p[2] == '\n') ? 3 : 2;
+                ++m_line;
+            } else if (*m_p == '/' && m_p + 1 < m_end && (m_p[1] == '/' || m_p[1] == '*')) {
+                skipComment();
+            } else {
+                ++m_p;
+            }
+        }
+    }
+
+    void skipQuoted(char quote) {
+        ++m_p;
+        while (m_p < m_end && *m_p != quote && *m_p != '\n') {
+            if (*m_p == '\\' && m_p + 1 < m_end) {
+                if (m_p[1] == '\n') ++m_line;
+                ++m_p;
+            }
+            ++m_p;
+        }
+        if (m_p < m_end && *m_p == quote) ++m_p;
+    }
+
+    // R"delim( ... )delim"
+    void skipRawString() {
+        const char* open = m_p + 1;
+        const char* paren = open;
+        while (paren < m_end && *paren != '(' && *paren != '\n' && paren - open <= 16) ++paren;
+        if (paren >= m_end || *paren != '(') {
+            skipQuoted('"');
+            return;
+        }
+        const std::string close = ")" + std::string(open, paren) + "\"";
+        const char* q = paren + 1;
+        while (q < m_end) {
+            if (*q == ')' && size_t(m_end - q) >= close.size() && std::memcmp(q, close.data(), close.size()) == 0) {
+                m_p = q + close.size();
+                return;
+            }
+            if (*q == '\n') ++m_line;
+            ++q;
+        }
+        m_p = m_end;
+    }
+
+    // Digit separators, exponents and suffixes: 1'000, 0x1p-3, 10ull
+    void skipNumber() {
+        while (m_p < m_end) {
+            const unsigned char c = static_cast<unsigned char>(*m_p);
+            if (identChar(c) || c == '.') {
+                ++m_p;
+            } else if (c == '\'' && m_p + 1 < m_end && identChar(static_cast<unsigned char>(m_p[1]))) {
+                ++m_p;
+            } else if ((c == '+' || c == '-') && (m_p[-1] == 'e' || m_p[-1] == 'E' || m_p[-1] == 'p' || m_p[-1] == 'P')) {
+                ++m_p;
+            } else {
+                break;
+            }
+        }
+    }
+
+    const char* m_p;
+    const char* m_end;
+    uint32_t m_line = 1;
+    bool m_lineStart = true;
+};
+
+// ─────────────────────────────────────────────────────────────────────────
+// Declaration reader
+// ─────────────────────────────────────────────────────────────────────────
+
+bool isKeyword(const Token& t) {
+    static const char* const kWords[] = {
+        "if", "for", "while", "switch", "catch", "return", "sizeof", "alignof", "decltype", "noexcept",
+        "throw", "else", "do", "case", "new", "delete", "static_assert", "alignas", "__attribute__",
+        "__declspec", "requires", "const", "volatile", "override", "final", "try", "goto", "default",
+    };
+    if (t.type != TokIdent) return false;
+    for (const char* w : kWords) {
+        if (t.is(w)) return true;
+    }
+    return false;
+}
+
+bool isAccessWord(const Token& t) {
+    return t.is("public") || t.is("private") || t.is("protected") || t.is("signals") || t.is("slots") ||
+           t.is("Q_SIGNALS") || t.is("Q_SLOTS");
+}
+
+// RAWRXD_API, Q_DECLARE_METATYPE: macro-looking, so its parentheses are not a parameter list
+bool isMacroName(const Token& t) {
+    if (t.type != TokIdent || t.len < 2) return false;
+    bool letter = false;
+    for (uint32_t i = 0; i < t.len; ++i) {
+        const char c = t.p[i];
+        if (c >= 'A' && c <= 'Z') letter = true;
+        else if (!(c == '_' || (c >= '0' && c <= '9'))) return false;
+    }
+    return letter;
+}
+
+// Parenthesis-like nesting: '(' '[' and braces inside a statement
+int nesting(const Token& t) {
+    if (t.type != TokPunct || t.len != 1) return 0;
+    switch (*t.p) {
+    case '(': case '[': case '{': return 1;
+    case ')': case ']': case '}': return -1;
+    default: return 0;
+    }
+}
+
+class DeclarationReader {
+public:
+    explicit DeclarationReader(std::vector<RawSymbol>& out) : m_out(out) {
+        m_scopes.push_back(ScopeDecl);
+    }
+
+    void feed(const Token& t) {
+        if (m_scopes.back() == ScopeBody) {
+            if (t.punct('{')) {
+                m_scopes.push_back(ScopeBody);
+            } else if (t.punct('}')) {
+                m_scopes.pop_back();
+            }
+            return;
+        }
+
+        if (m_depth > 0) {
+            m_depth += nesting(t);
+            push(t);
+            return;
+        }
+        if (t.punct('{')) {
+            // Brace initialisers in a constructor's member list
+            if (m_initList && !m_stmt.empty() && (m_stmt.back().type == TokIdent || m_stmt.back().punct('>'))) {
+                ++m_depth;
+                push(t);
+                return;
+            }
+            m_scopes.push_back(openBrace());
+            reset();
+            return;
+        }
+        if (t.punct('}')) {
+            if (m_scopes.size() > 1) m_scopes.pop_back();
+            reset();
+            return;
+        }
+        if (t.punct(';')) {
+            endStatement();
+            reset();
+            return;
+        }
+        if (t.punct(':')) {
+            if (!m_stmt.empty() && isAccessWord(m_stmt.back())) {
+                reset();
+                return;
+            }
+            // Foo::Foo(int a) noexcept : m_a(a)
+            if (!m_stmt.empty()) {
+                const Token& prev = m_stmt.back();
+                m_initList = prev.punct(')') || prev.is("noexcept") || prev.is("const");
+            }
+        }
+        m_depth += std::max(0, nesting(t));
+        push(t);
+    }
+
+private:
+    enum Scope : uint8_t { ScopeDecl, ScopeBody };
+
+    void push(const Token& t) {
+        if (m_stmt.size() < kMaxStatementTokens) m_stmt.push_back(t);
+        else m_overflow = true;
+    }
+
+    void reset() {
+        m_stmt.clear();
+        m_depth = 0;
+        m_initList = false;
+        m_overflow = false;
+    }
+
+    void emit(const Token& name, uint8_t kind) {
+        m_out.push_back({std::string(name.p, name.len), kind, name.line});
+    }
+
+    // Marks tokens outside parentheses, brackets, braces and template arguments
+    void layout() {
+        m_top.assign(m_stmt.size(), 0);
+        m_begin = 0;
+        // A leading MACRO(...) with more tokens after it is an annotation
+        if (m_stmt.size() > 2 && isMacroName(m_stmt[0]) && m_stmt[1].punct('(')) {
+            size_t i = 1;
+            int d = 0;
+            for (; i < m_stmt.size(); ++i) {
+                d += nesting(m_stmt[i]);
+                if (d == 0) break;
+            }
+            if (i + 1 < m_stmt.size()) m_begin = i + 1;
+        }
+        int depth = 0, angle = 0;
+        for (size_t i = m_begin; i < m_stmt.size(); ++i) {
+            const Token& t = m_stmt[i];
+            const int n = nesting(t);
+            if (n < 0 && depth > 0) --depth;
+            if (depth == 0) {
+                if (t.punct('<') && i > m_begin && m_stmt[i - 1].type == TokIdent && !m_stmt[i - 1].is("operator")) {
+                    ++angle;
+                } else if (t.punct('>') && angle > 0) {
+                    --angle;
+                } else if (angle == 0) {
+                    m_top[i] = 1;
+                }
+            }
+            if (n > 0) ++depth;
+        }
+    }
+
+    bool isAssign(size_t i) const {
+        return m_top[i] && m_stmt[i].punct('=') && !(i > 0 && m_stmt[i - 1].is("operator"));
+    }
+
+    size_t findTop(size_t from, size_t to, char c) const {
+        for (size_t i = from; i < to; ++i) {
+            if (m_top[i] && m_stmt[i].punct(c)) return i;
+        }
+        return to;
+    }
+
+    // class/struct/union/enum definition head: "struct RAWRXD_API Foo final : Base"
+    bool classHead(size_t& nameAt, uint8_t& kind) const {
+        for (size_t i = m_begin; i < m_stmt.size(); ++i) {
+            if (!m_top[i] || m_stmt[i].type != TokIdent) continue;
+            const Token& t = m_stmt[i];
+            if (t.is("class")) kind = KindClass;
+            else if (t.is("struct")) kind = KindStruct;
+            else if (t.is("union")) kind = KindUnion;
+            else if (t.is("enum")) kind = KindEnum;
+            else continue;
+            if (i > 0 && (m_stmt[i - 1].is("friend") || m_stmt[i - 1].is("enum"))) continue;
+
+            size_t j = i + 1;
+            if (kind == KindEnum && j < m_stmt.size() && (m_stmt[j].is("class") || m_stmt[j].is("struct"))) ++j;
+            nameAt = SIZE_MAX;
+            for (; j < m_stmt.size(); ++j) {
+                const Token& n = m_stmt[j];
+                if (n.type == TokIdent) {
+                    if (n.is("final")) break;
+                    if (!isKeyword(n)) nameAt = j;
+                } else if (n.punct('(') || n.punct('[')) {
+                    // alignas(16), __attribute__((packed)), [[nodiscard]]
+                    int d = 0;
+                    for (; j < m_stmt.size(); ++j) {
+                        d += nesting(m_stmt[j]);
+                        if (d == 0) break;
+                    }
+                } else if (!n.is("::")) {
+                    break;
+                }
+            }
+            const bool endsHead = j >= m_stmt.size() || m_stmt[j].punct(':') || m_stmt[j].punct('<') ||
+                                  m_stmt[j].is("final");
+            return endsHead;
+        }
+        return false;
+    }
+
+    // Name before the parameter list: qualified, destructor or operator
+    bool functionName(size_t end, std::string& name, uint32_t& line) const {
+        std::vector<size_t> parens;
+        for (size_t i = m_begin; i < end; ++i) {
+            if (m_top[i] && m_stmt[i].punct('(')) parens.push_back(i);
+        }
+        for (size_t k = 0; k < parens.size(); ++k) {
+            const size_t p = parens[k];
+            if (p == 0) continue;
+            const Token& prev = m_stmt[p - 1];
+            // operator() names itself with its first pair of parentheses
+            if (prev.is("operator") && p + 1 < end && m_stmt[p + 1].punct(')')) {
+                name = "operator()";
+                line = prev.line;
+                return true;
+            }
+            size_t op = SIZE_MAX;
+            for (size_t b = p; b > m_begin && p - b < 6; --b) {
+                if (m_stmt[b - 1].is("operator")) {
+                    op = b - 1;
+                    break;
+                }
+                if (!m_top[b - 1] || m_stmt[b - 1].punct(')')) break;
+            }
+            if (op != SIZE_MAX) {
+                name = "operator";
+                for (size_t i = op + 1; i < p; ++i) {
+                    if (m_stmt[i].type == TokIdent) name += ' ';
+                    name.append(m_stmt[i].p, m_stmt[i].len);
+                }
+                line = m_stmt[op].line;
+                return true;
+            }
+            if (prev.type != TokIdent || isKeyword(prev) || prev.is("operator")) continue;
+            if (isMacroName(prev) && k + 1 < parens.size()) continue;
+            name.assign(prev.p, prev.len);
+            if (p >= 2 && m_stmt[p - 2].punct('~')) name.insert(name.begin(), '~');
+            line = prev.line;
+            return true;
+        }
+        return false;
+    }
+
+    // Last identifier of a declarator, before any [] extents
+    size_t declaratorName(size_t from, size_t to) const {
+        size_t name = SIZE_MAX;
+        for (size_t i = from; i < to; ++i) {
+            if (!m_top[i]) continue;
+            if (m_stmt[i].punct('[')) break;
+            if (m_stmt[i].type == TokIdent && !isKeyword(m_stmt[i])) name = i;
+        }
+        return name;
+    }
+
+    bool skipsStatement() const {
+        static const char* const kLeading[] = {
+            "using", "typedef", "friend", "namespace", "return", "static_assert", "if", "for", "while",
+            "switch", "do", "else", "try", "throw", "goto", "case", "default", "delete",
+        };
+        if (m_overflow || m_begin >= m_stmt.size()) return true;
+        for (const char* w : kLeading) {
+            if (m_stmt[m_begin].is(w)) return true;
+        }
+        return false;
+    }
+
+    uint8_t openBrace() {
+        if (m_stmt.empty() || m_overflow) return ScopeBody;
+        layout();
+        if (m_begin >= m_stmt.size()) return ScopeBody;
+
+        for (size_t i = m_begin; i < m_stmt.size(); ++i) {
+            if (m_top[i] && m_stmt[i].is("namespace")) return ScopeDecl;
+        }
+        if (m_stmt[m_begin].is("extern") && m_begin + 1 < m_stmt.size() && m_stmt[m_begin + 1].type == TokLiteral) {
+            return ScopeDecl;
+        }
+
+        size_t assign = m_stmt.size();
+        for (size_t i = m_begin; i < m_stmt.size(); ++i) {
+            if (isAssign(i)) {
+                assign = i;
+                break;
+            }
+        }
+
+        size_t nameAt = SIZE_MAX;
+        uint8_t kind = KindClass;
+        if (assign == m_stmt.size() && classHead(nameAt, kind)) {
+            if (nameAt != SIZE_MAX) emit(m_stmt[nameAt], kind);
+            return kind == KindEnum ? ScopeBody : ScopeDecl;
+        }
+        if (skipsStatement()) return ScopeBody;
+
+        const size_t paren = findTop(m_begin, m_stmt.size(), '(');
+        if (assign < paren) {
+            // int table[] = {...}, auto f = [](...) {...}
+            const size_t name = declaratorName(m_begin, assign);
+            if (name != SIZE_MAX && name > m_begin) emit(m_stmt[name], KindVariable);
+            return ScopeBody;
+        }
+
+        std::string function;
+        uint32_t line = 0;
+        if (functionName(m_stmt.size(), function, line)) {
+            m_out.push_back({std::move(function), KindFunction, line});
+            return ScopeBody;
+        }
+
+        // std::vector<int> v{1, 2}
+        const size_t last = m_stmt.size() - 1;
+        if (last > m_begin && m_stmt[last].type == TokIdent && !isKeyword(m_stmt[last]) &&
+            (m_stmt[last - 1].type == TokIdent || m_stmt[last - 1].punct('>') || m_stmt[last - 1].punct('*') ||
+             m_stmt[last - 1].punct('&'))) {
+            emit(m_stmt[last], KindVariable);
+        }
+        return ScopeBody;
+    }
+
+    void endStatement() {
+        if (m_stmt.empty() || m_overflow) return;
+        layout();
+        if (skipsStatement()) return;
+
+        size_t end = m_stmt.size();
+        for (size_t i = m_begin; i < m_stmt.size(); ++i) {
+            if (isAssign(i) || (m_top[i] && m_stmt[i].punct(':'))) {
+                end = i;
+                break;
+            }
+        }
+        size_t nameAt = SIZE_MAX;
+        uint8_t kind = KindClass;
+        if (classHead(nameAt, kind) || findTop(m_begin, end, '(') < end) return;  // Forward or function declaration
+        for (size_t i = m_begin; i < end; ++i) {
+            if (m_top[i] && (m_stmt[i].is("class") || m_stmt[i].is("struct") || m_stmt[i].is("union") ||
+                             m_stmt[i].is("enum"))) {
+                return;
+            }
+        }
+
+        // int a, *b, c[4];
+        size_t from = m_begin;
+        bool first = true;
+        while (from < end) {
+            const size_t comma = findTop(from, end, ',');
+            const size_t name = declaratorName(from, comma);
+            if (name != SIZE_MAX && (!first || name > m_begin)) emit(m_stmt[name], KindVariable);
+            first = false;
+            from = comma + 1;
+        }
+    }
+
+    std::vector<RawSymbol>& m_out;
+    std::vector<uint8_t> m_scopes;
+    std::vector<Token> m_stmt;
+    std::vector<uint8_t> m_top;   // Nesting 0 and outside template arguments
+    size_t m_begin = 0;
+    int m_depth = 0;
+    bool m_initList = false;
+    bool m_overflow = false;
+};
+
+std::vector<RawSymbol> extract(const char* data, size_t size) {
+    std::vector<RawSymbol> out;
+    DeclarationReader reader(out);
+    Lexer lexer(data, size);
+    Token tok;
+    while (lexer.next(tok)) reader.feed(tok);
+    return out;
+}
+
+// ─────────────────────────────────────────────────────────────────────────
+// Files
+// ─────────────────────────────────────────────────────────────────────────
+
+// 64-bit FNV-1a over 8-byte words; identifies content, not a security hash
+uint64_t contentHash(const char* data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, data + i, 8);
+        h = (h ^ w) * 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+    for (; i < size; ++i) h = (h ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ull;
+    return h ^ (h >> 32);
+}
+
+bool readFile(const std::string& path, std::vector<char>& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    in.seekg(0, std::ios::end);
+    const std::streamoff size = in.tellg();
+    if (size < 0) return false;
+    in.seekg(0, std::ios::beg);
+    out.resize(size_t(size));
+    return size == 0 || bool(in.read(out.data(), size));
+}
+
+bool statFile(const std::string& path, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = fs::file_size(path, ec);
+    if (ec) return false;
+    mtime = int64_t(fs::last_write_time(path, ec).time_since_epoch().count());
+    return !ec;
+}
+
+// Read-only view of a whole file, mapped rather than copied
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+#ifdef _WIN32
+        if (m_data) UnmapViewOfFile(m_data);
+#else
+        if (m_data) ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+    }
+
+    bool open(const std::string& path) {
+#ifdef _WIN32
+        HANDLE file = CreateFileW(fs::path(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        HANDLE mapping = nullptr;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        }
+        CloseHandle(file);
+        if (!mapping) return false;
+        m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);  // The view keeps the mapping alive
+        m_size = m_data ? size_t(size.QuadPart) : 0;
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* base = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (base != MAP_FAILED) {
+                m_data = static_cast<const char*>(base);
+                m_size = size_t(st.st_size);
+            }
+        }
+        ::close(fd);
+#endif
+        return m_data != nullptr;
+    }
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(char(uint8_t(v) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(char(v));
+}
+
+template <typename T>
+void putPod(std::string& out, const T& v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+// Bounds-checked reader over a mapped index file
+struct Reader {
+    const char* p;
+    const char* end;
+
+    bool varint(uint64_t& v) {
+        v = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7) {
+            const uint8_t b = uint8_t(*p++);
+            v |= uint64_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+    template <typename T>
+    bool pod(T& v) {
+        if (size_t(end - p) < sizeof(T)) return false;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+    bool string(std::string& s) {
+        uint64_t n = 0;
+        if (!varint(n) || uint64_t(end - p) < n) return false;
+        s.assign(p, size_t(n));
+        p += n;
+        return true;
+    }
+};
+
+} // namespace
+
+Indexer::Indexer(const std::string& root) : m_root(root), m_byKind(KindCount) {}
 
 bool Indexer::isCodeFile(const std::string& path) {
     static const char* exts[] = {".cpp", ".c", ".hpp", ".h", ".cc", ".hh", ".ini", ".md", ".txt"};
@@ -20,76 +761,357 @@ bool Indexer::isCodeFile(const std::string& path) {
     return false;
 }
 
+std::vector<Symbol> Indexer::extractSymbols(const char* data, size_t size) {
+    std::vector<Symbol> out;
+    for (RawSymbol& s : extract(data, size)) out.push_back({std::move(s.name), kKindNames[s.kind], std::string(), int(s.line)});
+    return out;
+}
+
+uint32_t Indexer::internName(const std::string& name) {
+    const auto it = m_nameIds.find(name);
+    if (it != m_nameIds.end()) return it->second;
+    const uint32_t id = uint32_t(m_names.size());
+    m_names.push_back(name);
+    m_nameIds.emplace(name, id);
+    return id;
+}
+
+uint32_t Indexer::fileId(const std::string& path) {
+    const auto it = m_fileIds.find(path);
+    if (it != m_fileIds.end()) return it->second;
+    const uint32_t id = uint32_t(m_files.size());
+    m_files.emplace_back();
+    m_files.back().path = path;
+    m_files.back().live = true;
+    m_fileIds.emplace(path, id);
+    return id;
+}
+
+void Indexer::setSymbols(uint32_t id, std::vector<Entry> symbols) {
+    FileRecord& file = m_files[id];
+    const Ref lo(id, 0), hi(id, UINT32_MAX);
+
+    // Refs are ordered by file, so one file's are a contiguous run
+    for (const Entry& e : file.symbols) {
+        auto it = m_byName.find(e.name);
+        if (it == m_byName.end()) continue;
+        std::vector<Ref>& refs = it->second;
+        refs.erase(std::lower_bound(refs.begin(), refs.end(), lo), std::upper_bound(refs.begin(), refs.end(), hi));
+        if (refs.empty()) m_byName.erase(it);
+    }
+    for (std::vector<Ref>& refs : m_byKind) {
+        refs.erase(std::lower_bound(refs.begin(), refs.end(), lo), std::upper_bound(refs.begin(), refs.end(), hi));
+    }
+    m_symbolCount -= file.symbols.size();
+
+    file.symbols = std::move(symbols);
+    std::vector<std::vector<Ref>> kinds(KindCount);
+    for (uint32_t i = 0; i < file.symbols.size(); ++i) {
+        const Entry& e = file.symbols[i];
+        std::vector<Ref>& refs = m_byName[e.name];
+        if (refs.empty() || refs.back() < lo) refs.emplace_back(id, i);
+        else refs.insert(std::upper_bound(refs.begin(), refs.end(), Ref(id, i)), Ref(id, i));
+        kinds[e.kind].emplace_back(id, i);
+    }
+    for (size_t k = 0; k < KindCount; ++k) {
+        std::vector<Ref>& refs = m_byKind[k];
+        refs.insert(std::lower_bound(refs.begin(), refs.end(), lo), kinds[k].begin(), kinds[k].end());
+    }
+    m_symbolCount += file.symbols.size();
+}
+
+void Indexer::dropFile(uint32_t id) {
+    setSymbols(id, {});
+    m_files[id].live = false;
+    m_fileIds.erase(m_files[id].path);
+}
+
+void Indexer::clearIndex() {
+    m_files.clear();
+    m_fileIds.clear();
+    m_names.clear();
+    m_nameIds.clear();
+    m_byName.clear();
+    m_byKind.assign(KindCount, {});
+    m_symbolCount = 0;
+}
+
 IndexStats Indexer::build(bool recursive) {
-    m_symbols.clear();
     m_stats = {};
-    if (!fs::exists(m_root)) return m_stats;
+    std::error_code ec;
+    if (!fs::exists(m_root, ec)) {
+        clearIndex();
+        return m_stats;
+    }
 
-    if (recursive) {
-        for (auto& entry : fs::recursive_directory_iterator(m_root)) {
-            if (!entry.is_regular_file()) continue;
-            auto path = entry.path().string();
-            if (!isCodeFile(path)) continue;
-            indexFile(path);
-            m_stats.files_indexed++;
+    // Walk, and keep files whose size and mtime still match
+    struct Pending {
+        std::string path;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t previousHash = 0;
+        bool known = false;
+    };
+    std::vector<Pending> work;
+    std::vector<uint8_t> seen(m_files.size(), 0);
+    auto visit = [&](const fs::directory_entry& entry) {
+        std::error_code typeEc;
+        if (!entry.is_regular_file(typeEc)) return;
+        Pending p;
+        p.path = entry.path().string();
+        if (!isCodeFile(p.path)) return;
+        p.size = entry.file_size(typeEc);
+        if (typeEc) return;
+        p.mtime = int64_t(entry.last_write_time(typeEc).time_since_epoch().count());
+        if (typeEc) return;
+        const auto it = m_fileIds.find(p.path);
+        if (it != m_fileIds.end()) {
+            seen[it->second] = 1;
+            const FileRecord& file = m_files[it->second];
+            if (file.size == p.size && file.mtime == p.mtime) {
+                ++m_stats.files_unchanged;
+                return;
+            }
+            p.known = true;
+            p.previousHash = file.hash;
         }
+        work.push_back(std::move(p));
+    };
+    const auto options = fs::directory_options::skip_permission_denied;
+    if (recursive) {
+        for (fs::recursive_directory_iterator it(m_root, options, ec), end; !ec && it != end; it.increment(ec)) visit(*it);
     } else {
-        for (auto& entry : fs::directory_iterator(m_root)) {
-            if (!entry.is_regular_file()) continue;
-            auto path = entry.path().string();
-            if (!isCodeFile(path)) continue;
-            indexFile(path);
-            m_stats.files_indexed++;
+        for (fs::directory_iterator it(m_root, options, ec), end; !ec && it != end; it.increment(ec)) visit(*it);
+    }
+
+    // Read, hash and tokenize on the pool
+    struct Result {
+        bool ok = false;
+        bool sameContent = false;
+        uint64_t hash = 0;
+        std::vector<RawSymbol> symbols;
+    };
+    std::vector<Result> results(work.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        std::vector<char> buffer;
+        for (size_t i = next.fetch_add(1); i < work.size(); i = next.fetch_add(1)) {
+            Result& r = results[i];
+            if (!readFile(work[i].path, buffer)) continue;
+            r.ok = true;
+            r.hash = contentHash(buffer.data(), buffer.size());
+            r.sameContent = work[i].known && r.hash == work[i].previousHash;
+            if (!r.sameContent) r.symbols = extract(buffer.data(), buffer.size());
+        }
+    };
+    size_t threads = m_threads > 0 ? size_t(m_threads) : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max<size_t>(1, std::min(threads, work.size() / kMinFilesPerThread));
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool) t.join();
+
+    // Merge in walk order so ids and lookups do not depend on scheduling
+    for (size_t i = 0; i < work.size(); ++i) {
+        const Result& r = results[i];
+        if (!r.ok) continue;  // Gone since the walk; dropped below as unseen
+        const uint32_t id = fileId(work[i].path);
+        if (id >= seen.size()) seen.resize(id + 1, 0);
+        seen[id] = 1;
+        FileRecord& file = m_files[id];
+        file.size = work[i].size;
+        file.mtime = work[i].mtime;
+        file.hash = r.hash;
+        if (r.sameContent) {
+            ++m_stats.files_unchanged;
+            continue;
+        }
+        std::vector<Entry> entries;
+        entries.reserve(r.symbols.size());
+        for (const RawSymbol& s : r.symbols) entries.push_back({internName(s.name), s.kind, s.line});
+        setSymbols(id, std::move(entries));
+        ++m_stats.files_parsed;
+    }
+    for (uint32_t id = 0; id < m_files.size(); ++id) {
+        if (m_files[id].live && !seen[id]) {
+            dropFile(id);
+            ++m_stats.files_removed;
         }
     }
-    m_stats.symbols_found = m_symbols.size();
+
+    m_stats.files_indexed = m_fileIds.size();
+    m_stats.symbols_found = m_symbolCount;
     return m_stats;
 }
 
 void Indexer::indexFile(const std::string& path) {
-    std::ifstream ifs(path);
-    if (!ifs) return;
+    std::vector<char> buffer;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!statFile(path, size, mtime) || !readFile(path, buffer)) {
+        removeFile(path);
+        return;
+    }
+    const uint64_t hash = contentHash(buffer.data(), buffer.size());
+    const bool known = m_fileIds.count(path) != 0;
+    const uint32_t id = fileId(path);
+    FileRecord& file = m_files[id];
+    file.size = size;
+    file.mtime = mtime;
+    if (known && file.hash == hash) return;
+    file.hash = hash;
 
-    std::string line;
-    int lineno = 0;
+    std::vector<Entry> entries;
+    for (const RawSymbol& s : extract(buffer.data(), buffer.size())) entries.push_back({internName(s.name), s.kind, s.line});
+    setSymbols(id, std::move(entries));
+}
 
-    std::regex re_func(R"((?:^|\s)(?:[\w:\\*&<>]+)\s+([A-Za-z_][A-Za-z0-9_]*)\s*\([^;]*\)\s*\{)");
-    std::regex re_class(R"((?:^|\s)class\s+([A-Za-z_][A-Za-z0-9_]*)\s*)");
-    std::regex re_struct(R"((?:^|\s)struct\s+([A-Za-z_][A-Za-z0-9_]*)\s*)");
-    std::regex re_var(R"((?:^|\s)(?:int|float|double|bool|auto|std::\w+)\s+([A-Za-z_][A-Za-z0-9_]*)\s*(=|;))");
+void Indexer::removeFile(const std::string& path) {
+    const auto it = m_fileIds.find(path);
+    if (it != m_fileIds.end()) dropFile(it->second);
+}
 
-    while (std::getline(ifs, line)) {
-        lineno++;
-        std::smatch m;
-        if (std::regex_search(line, m, re_class)) {
-            m_symbols.push_back({m[1], "class", path, lineno});
-        } else if (std::regex_search(line, m, re_struct)) {
-            m_symbols.push_back({m[1], "struct", path, lineno});
-        } else if (std::regex_search(line, m, re_func)) {
-            m_symbols.push_back({m[1], "function", path, lineno});
-        } else if (std::regex_search(line, m, re_var)) {
-            m_symbols.push_back({m[1], "variable", path, lineno});
-        }
-    }
+Symbol Indexer::makeSymbol(const Ref& ref) const {
+    const FileRecord& file = m_files[ref.first];
+    const Entry& e = file.symbols[ref.second];
+    return {m_names[e.name], kKindNames[e.kind], file.path, int(e.line)};
 }
 
 std::vector<Symbol> Indexer::findByName(const std::string& name) const {
     std::vector<Symbol> out;
-    for (const auto& s : m_symbols) if (s.name == name) out.push_back(s);
+    const auto id = m_nameIds.find(name);
+    if (id == m_nameIds.end()) return out;
+    const auto refs = m_byName.find(id->second);
+    if (refs == m_byName.end()) return out;
+    out.reserve(refs->second.size());
+    for (const Ref& r : refs->second) out.push_back(makeSymbol(r));
     return out;
 }
 
 std::vector<Symbol> Indexer::findByKind(const std::string& kind) const {
     std::vector<Symbol> out;
-    for (const auto& s : m_symbols) if (s.kind == kind) out.push_back(s);
+    for (size_t k = 0; k < KindCount; ++k) {
+        if (kind != kKindNames[k]) continue;
+        out.reserve(m_byKind[k].size());
+        for (const Ref& r : m_byKind[k]) out.push_back(makeSymbol(r));
+    }
     return out;
 }
 
 std::vector<Symbol> Indexer::findInFile(const std::string& file) const {
     std::vector<Symbol> out;
-    for (const auto& s : m_symbols) if (s.file == file) out.push_back(s);
+    const auto id = m_fileIds.find(file);
+    if (id == m_fileIds.end()) return out;
+    const FileRecord& record = m_files[id->second];
+    out.reserve(record.symbols.size());
+    for (uint32_t i = 0; i < record.symbols.size(); ++i) out.push_back(makeSymbol({id->second, i}));
     return out;
 }
 
+// Layout (host byte order): magic, version, root, name table, then per live
+// file its path, size, mtime, hash and (name id, kind, line) varint triples
+bool Indexer::save(const std::string& file) const {
+    std::vector<uint32_t> remap(m_names.size(), UINT32_MAX);
+    std::vector<uint32_t> used;
+    uint32_t liveFiles = 0;
+    for (const FileRecord& f : m_files) {
+        if (!f.live) continue;
+        ++liveFiles;
+        for (const Entry& e : f.symbols) {
+            if (remap[e.name] != UINT32_MAX) continue;
+            remap[e.name] = uint32_t(used.size());
+            used.push_back(e.name);
+        }
+    }
+
+    std::string out(kMagic, sizeof(kMagic));
+    putPod(out, kFormatVersion);
+    putVarint(out, m_root.size());
+    out += m_root;
+    putVarint(out, used.size());
+    for (uint32_t name : used) {
+        putVarint(out, m_names[name].size());
+        out += m_names[name];
+    }
+    putVarint(out, liveFiles);
+    for (const FileRecord& f : m_files) {
+        if (!f.live) continue;
+        putVarint(out, f.path.size());
+        out += f.path;
+        putPod(out, f.size);
+        putPod(out, f.mtime);
+        putPod(out, f.hash);
+        putVarint(out, f.symbols.size());
+        for (const Entry& e : f.symbols) {
+            putVarint(out, remap[e.name]);
+            out.push_back(char(e.kind));
+            putVarint(out, e.line);
+        }
+    }
+
+    const std::string temp = file + ".tmp";
+    {
+        std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+        if (!stream || !stream.write(out.data(), std::streamsize(out.size()))) return false;
+    }
+    std::error_code ec;
+    fs::rename(temp, file, ec);
+    return !ec;
+}
+
+bool Indexer::load(const std::string& file) {
+    clearIndex();
+    m_stats = {};
+    MappedFile map;
+    if (!map.open(file)) return false;
+
+    Reader r{map.data(), map.data() + map.size()};
+    char magic[sizeof(kMagic)];
+    uint32_t version = 0;
+    std::string root;
+    uint64_t nameCount = 0, fileCount = 0;
+    bool ok = r.pod(magic) && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0 && r.pod(version) &&
+              version == kFormatVersion && r.string(root) && root == m_root && r.varint(nameCount) &&
+              nameCount <= uint64_t(r.end - r.p);
+    if (ok) {
+        m_names.resize(size_t(nameCount));
+        m_nameIds.reserve(size_t(nameCount));
+        for (uint32_t i = 0; ok && i < nameCount; ++i) {
+            ok = r.string(m_names[i]) && m_nameIds.emplace(m_names[i], i).second;
+        }
+    }
+    ok = ok && r.varint(fileCount) && fileCount <= uint64_t(r.end - r.p);
+    std::vector<Entry> entries;
+    for (uint64_t n = 0; ok && n < fileCount; ++n) {
+        std::string path;
+        uint64_t size = 0, hash = 0, symbols = 0;
+        int64_t mtime = 0;
+        ok = r.string(path) && r.pod(size) && r.pod(mtime) && r.pod(hash) && r.varint(symbols) &&
+             symbols <= uint64_t(r.end - r.p) && !m_fileIds.count(path);
+        entries.clear();
+        for (uint64_t i = 0; ok && i < symbols; ++i) {
+            uint64_t name = 0, line = 0;
+            uint8_t kind = 0;
+            ok = r.varint(name) && name < nameCount && r.pod(kind) && kind < KindCount && r.varint(line) &&
+                 line <= UINT32_MAX;
+            entries.push_back({uint32_t(name), kind, uint32_t(line)});
+        }
+        if (!ok) break;
+        const uint32_t id = fileId(path);
+        m_files[id].size = size;
+        m_files[id].mtime = mtime;
+        m_files[id].hash = hash;
+        setSymbols(id, std::move(entries));
+        entries = {};
+    }
+    if (!ok || r.p != r.end) {
+        clearIndex();
+        return false;
+    }
+    m_stats.files_indexed = m_fileIds.size();
+    m_stats.symbols_found = m_symbolCount;
+    return true;
+}
+
 } // namespace Context
 } // namespace RawrXD
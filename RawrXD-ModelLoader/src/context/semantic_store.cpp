@@ -2,33 +2,428 @@
 #include "context/semantic_store.h"
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SEMANTIC_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Kernels are compiled per function so the build needs no -mavx2
+#if defined(SEMANTIC_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SEMANTIC_AVX2 __attribute__((target("avx2,fma,f16c")))
+#else
+#define SEMANTIC_AVX2
+#endif
 
 namespace RawrXD {
 namespace Context {
 
+namespace {
+
+// Below this many rows per thread, starting threads costs more than the scan
+constexpr size_t kMinRowsPerThread = 16384;
+
+using RowDot = float (*)(const void* row, const void* q, size_t n);
+
+uint32_t floatBits(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+float bitsFloat(uint32_t u) {
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// IEEE half conversions (round to nearest even), as in QuantBackend
+float fp16ToFp32(uint16_t h) {
+    const uint32_t w = uint32_t(h) << 16;
+    const uint32_t sign = w & 0x80000000u;
+    const uint32_t twoW = w + w;
+    const float normalized = bitsFloat((twoW >> 4) + (0xE0u << 23)) * 0x1.0p-112f;
+    const float denormalized = bitsFloat((twoW >> 17) | (126u << 23)) - 0.5f;
+    const uint32_t bits = twoW < (1u << 27) ? floatBits(denormalized) : floatBits(normalized);
+    return bitsFloat(sign | bits);
+}
+
+uint16_t fp32ToFp16(float f) {
+    float base = (std::fabs(f) * 0x1.0p+112f) * 0x1.0p-110f;
+    const uint32_t w = floatBits(f);
+    const uint32_t shl1W = w + w;
+    const uint32_t sign = w & 0x80000000u;
+    uint32_t bias = shl1W & 0xFF000000u;
+    if (bias < 0x71000000u) bias = 0x71000000u;
+    base = bitsFloat((bias >> 1) + 0x07800000u) + base;
+    const uint32_t bits = floatBits(base);
+    const uint32_t nonsign = ((bits >> 13) & 0x00007C00u) + (bits & 0x00000FFFu);
+    return uint16_t((sign >> 16) | (shl1W > 0xFF000000u ? 0x7E00u : nonsign));
+}
+
+// Symmetric int8 with |q| <= 127; returns the dequantisation scale
+float quantizeI8(const float* x, size_t n, int8_t* q) {
+    float amax = 0.0f;
+    for (size_t i = 0; i < n; ++i) amax = std::max(amax, std::fabs(x[i]));
+    if (amax == 0.0f) {
+        std::fill(q, q + n, int8_t(0));
+        return 0.0f;
+    }
+    const float inv = 127.0f / amax;
+    for (size_t i = 0; i < n; ++i) q[i] = int8_t(std::lround(x[i] * inv));
+    return amax / 127.0f;
+}
+
+// ---------------------------------------------------------------------------
+// Scalar kernels
+// ---------------------------------------------------------------------------
+
+float dotF32Scalar(const void* row, const void* q, size_t n) {
+    const float* a = static_cast<const float*>(row);
+    const float* b = static_cast<const float*>(q);
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; ++i) s0 += a[i] * b[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+float dotF16Scalar(const void* row, const void* q, size_t n) {
+    const uint16_t* a = static_cast<const uint16_t*>(row);
+    const float* b = static_cast<const float*>(q);
+    float s = 0.0f;
+    for (size_t i = 0; i < n; ++i) s += fp16ToFp32(a[i]) * b[i];
+    return s;
+}
+
+float dotI8Scalar(const void* row, const void* q, size_t n) {
+    const int8_t* a = static_cast<const int8_t*>(row);
+    const int8_t* b = static_cast<const int8_t*>(q);
+    int32_t s = 0;
+    for (size_t i = 0; i < n; ++i) s += int32_t(a[i]) * int32_t(b[i]);
+    return float(s);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 kernels
+// ---------------------------------------------------------------------------
+
+#if defined(SEMANTIC_X86)
+
+SEMANTIC_AVX2 inline float hsum256(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+SEMANTIC_AVX2 float dotF32Avx2(const void* row, const void* q, size_t n) {
+    const float* a = static_cast<const float*>(row);
+    const float* b = static_cast<const float*>(q);
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    float s = hsum256(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+    for (; i < n; ++i) s += a[i] * b[i];
+    return s;
+}
+
+SEMANTIC_AVX2 float dotF16Avx2(const void* row, const void* q, size_t n) {
+    const uint16_t* a = static_cast<const uint16_t*>(row);
+    const float* b = static_cast<const float*>(q);
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256 a0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        const __m256 a1 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 8)));
+        acc0 = _mm256_fmadd_ps(a0, _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(a1, _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    float s = hsum256(_mm256_add_ps(acc0, acc1));
+    for (; i < n; ++i) s += _cvtsh_ss(a[i]) * b[i];
+    return s;
+}
+
+// Signed int8 dot: maddubs needs an unsigned left operand, so move a's sign
+// onto b (|a|, |b| <= 127 keeps the int16 pair sums exact)
+SEMANTIC_AVX2 float dotI8Avx2(const void* row, const void* q, size_t n) {
+    const int8_t* a = static_cast<const int8_t*>(row);
+    const int8_t* b = static_cast<const int8_t*>(q);
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        const __m256i dot16 = _mm256_maddubs_epi16(_mm256_sign_epi8(va, va), _mm256_sign_epi8(vb, va));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(dot16, ones));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    int32_t total = _mm_cvtsi128_si32(s);
+    for (; i < n; ++i) total += int32_t(a[i]) * int32_t(b[i]);
+    return float(total);
+}
+
+#endif
+
+bool hasAvx2() {
+#if defined(SEMANTIC_X86) && defined(_MSC_VER)
+    int info[4] = {0};
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool f16c = (info[2] & (1 << 29)) != 0;
+    if (!osxsave || !fma || !f16c) return false;
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+#elif defined(SEMANTIC_X86)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c");
+#else
+    return false;
+#endif
+}
+
+RowDot pickKernel(VectorStorage storage) {
+    static const bool avx2 = hasAvx2();
+#if defined(SEMANTIC_X86)
+    if (avx2) {
+        switch (storage) {
+            case VectorStorage::F16:  return dotF16Avx2;
+            case VectorStorage::Int8: return dotI8Avx2;
+            default:                  return dotF32Avx2;
+        }
+    }
+#else
+    (void)avx2;
+#endif
+    switch (storage) {
+        case VectorStorage::F16:  return dotF16Scalar;
+        case VectorStorage::Int8: return dotI8Scalar;
+        default:                  return dotF32Scalar;
+    }
+}
+
+// (score, row); the heap keeps the worst of the best top_k on top
+using Scored = std::pair<float, size_t>;
+
+bool betterThan(const Scored& a, const Scored& b) {
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+} // namespace
+
+SemanticStore::SemanticStore(VectorStorage storage) : m_storage(storage) {}
+
+void SemanticStore::writeRow(size_t row, const std::vector<float>& vec) {
+    m_live[row] = vec.empty() ? 0 : 1;
+
+    // Pre-normalised, so a search is one dot product per row; zero and
+    // wrong-sized vectors become zero rows and score 0
+    std::vector<float> unit(m_dim, 0.0f);
+    if (vec.size() == m_dim) {
+        double norm = 0.0;
+        for (float v : vec) norm += double(v) * v;
+        if (norm > 0.0) {
+            const double inv = 1.0 / std::sqrt(norm);
+            for (size_t i = 0; i < m_dim; ++i) unit[i] = float(vec[i] * inv);
+        }
+    }
+
+    const size_t at = row * m_dim;
+    switch (m_storage) {
+        case VectorStorage::F16:
+            for (size_t i = 0; i < m_dim; ++i) m_f16[at + i] = fp32ToFp16(unit[i]);
+            break;
+        case VectorStorage::Int8:
+            m_scale[row] = quantizeI8(unit.data(), m_dim, m_i8.data() + at);
+            break;
+        default:
+            std::copy(unit.begin(), unit.end(), m_f32.begin() + std::ptrdiff_t(at));
+            break;
+    }
+}
+
+void SemanticStore::moveRow(size_t from, size_t to) {
+    m_ids[to] = std::move(m_ids[from]);
+    m_texts[to] = std::move(m_texts[from]);
+    m_live[to] = m_live[from];
+    const size_t src = from * m_dim, dst = to * m_dim;
+    switch (m_storage) {
+        case VectorStorage::F16:
+            std::copy_n(m_f16.begin() + std::ptrdiff_t(src), m_dim, m_f16.begin() + std::ptrdiff_t(dst));
+            break;
+        case VectorStorage::Int8:
+            std::copy_n(m_i8.begin() + std::ptrdiff_t(src), m_dim, m_i8.begin() + std::ptrdiff_t(dst));
+            m_scale[to] = m_scale[from];
+            break;
+        default:
+            std::copy_n(m_f32.begin() + std::ptrdiff_t(src), m_dim, m_f32.begin() + std::ptrdiff_t(dst));
+            break;
+    }
+    m_rows[m_ids[to]] = to;
+}
+
 void SemanticStore::upsert(const EmbeddingItem& item) {
-    for (auto& it : m_items) {
-        if (it.id == item.id) { it = item; return; }
+    if (m_dim == 0 && !item.vec.empty()) {
+        // Rows added before the dimension was known carry no vector, so the
+        // matrix can be sized now
+        m_dim = item.vec.size();
+        const size_t cells = m_ids.size() * m_dim;
+        switch (m_storage) {
+            case VectorStorage::F16:  m_f16.assign(cells, 0); break;
+            case VectorStorage::Int8: m_i8.assign(cells, 0); m_scale.assign(m_ids.size(), 0.0f); break;
+            default:                  m_f32.assign(cells, 0.0f); break;
+        }
     }
-    m_items.push_back(item);
+
+    size_t row;
+    auto it = m_rows.find(item.id);
+    if (it != m_rows.end()) {
+        row = it->second;
+        m_texts[row] = item.text;
+    } else {
+        row = m_ids.size();
+        m_rows.emplace(item.id, row);
+        m_ids.push_back(item.id);
+        m_texts.push_back(item.text);
+        m_live.push_back(0);
+        switch (m_storage) {
+            case VectorStorage::F16:  m_f16.resize(m_f16.size() + m_dim); break;
+            case VectorStorage::Int8: m_i8.resize(m_i8.size() + m_dim); m_scale.push_back(0.0f); break;
+            default:                  m_f32.resize(m_f32.size() + m_dim); break;
+        }
+    }
+    writeRow(row, item.vec);
 }
 
 bool SemanticStore::remove(const std::string& id) {
-    auto n = m_items.size();
-    m_items.erase(std::remove_if(m_items.begin(), m_items.end(), [&](const EmbeddingItem& e){ return e.id == id; }), m_items.end());
-    return m_items.size() != n;
+    auto it = m_rows.find(id);
+    if (it == m_rows.end()) return false;
+    const size_t row = it->second;
+    m_rows.erase(it);
+
+    const size_t last = m_ids.size() - 1;
+    if (row != last) moveRow(last, row);
+    m_ids.pop_back();
+    m_texts.pop_back();
+    m_live.pop_back();
+    switch (m_storage) {
+        case VectorStorage::F16:  m_f16.resize(last * m_dim); break;
+        case VectorStorage::Int8: m_i8.resize(last * m_dim); m_scale.pop_back(); break;
+        default:                  m_f32.resize(last * m_dim); break;
+    }
+    return true;
+}
+
+void SemanticStore::clear() {
+    m_ids.clear();
+    m_texts.clear();
+    m_live.clear();
+    m_rows.clear();
+    m_f32.clear();
+    m_f16.clear();
+    m_i8.clear();
+    m_scale.clear();
+    m_dim = 0;
 }
 
 std::vector<SearchResult> SemanticStore::search(const std::vector<float>& query, size_t top_k) const {
-    std::vector<SearchResult> all;
-    for (const auto& it : m_items) {
-        if (it.vec.empty()) continue;
-        float s = cosine(query, it.vec);
-        all.push_back({it.id, it.text, s});
-    }
-    std::sort(all.begin(), all.end(), [](const SearchResult& a, const SearchResult& b){ return a.score > b.score; });
-    if (all.size() > top_k) all.resize(top_k);
-    return all;
+    std::vector<SearchResult> results;
+    const size_t rows = m_ids.size();
+    if (top_k == 0 || rows == 0 || m_dim == 0 || query.size() != m_dim) return results;
+
+    // Normalise the query once; int8 storage also quantises it
+    std::vector<float> q(m_dim, 0.0f);
+    double norm = 0.0;
+    for (float v : query) norm += double(v) * v;
+    if (norm > 0.0) {
+        const double inv = 1.0 / std::sqrt(norm);
+        for (size_t i = 0; i < m_dim; ++i) q[i] = float(query[i] * inv);
+    }
+    std::vector<int8_t> q8;
+    float qScale = 0.0f;
+    if (m_storage == VectorStorage::Int8) {
+        q8.resize(m_dim);
+        qScale = quantizeI8(q.data(), m_dim, q8.data());
+    }
+
+    const RowDot dot = pickKernel(m_storage);
+    const void* qv = m_storage == VectorStorage::Int8 ? static_cast<const void*>(q8.data()) : q.data();
+    const size_t k = std::min(top_k, rows);
+
+    int threads = m_threads > 0 ? m_threads : int(std::max(1u, std::thread::hardware_concurrency()));
+    threads = int(std::min<size_t>(size_t(threads), std::max<size_t>(1, rows / kMinRowsPerThread)));
+
+    std::vector<std::vector<Scored>> heaps(static_cast<size_t>(threads));
+    auto scan = [&](int t) {
+        const size_t begin = rows * size_t(t) / size_t(threads);
+        const size_t end = rows * size_t(t + 1) / size_t(threads);
+        std::vector<Scored>& heap = heaps[size_t(t)];
+        heap.reserve(k);
+        for (size_t r = begin; r < end; ++r) {
+            if (!m_live[r]) continue;
+            float s;
+            switch (m_storage) {
+                case VectorStorage::F16:  s = dot(m_f16.data() + r * m_dim, qv, m_dim); break;
+                case VectorStorage::Int8: s = dot(m_i8.data() + r * m_dim, qv, m_dim) * m_scale[r] * qScale; break;
+                default:                  s = dot(m_f32.data() + r * m_dim, qv, m_dim); break;
+            }
+            if (heap.size() < k) {
+                heap.emplace_back(s, r);
+                std::push_heap(heap.begin(), heap.end(), betterThan);
+            } else if (betterThan(Scored(s, r), heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), betterThan);
+                heap.back() = Scored(s, r);
+                std::push_heap(heap.begin(), heap.end(), betterThan);
+            }
+        }
+    };
+
+    if (threads == 1) {
+        scan(0);
+    } else {
+        std::vector<std::thread> workers;
+        workers.reserve(size_t(threads - 1));
+        for (int t = 1; t < threads; ++t) workers.emplace_back(scan, t);
+        scan(0);
+        for (auto& w : workers) w.join();
+    }
+
+    std::vector<Scored> best;
+    for (const auto& heap : heaps) best.insert(best.end(), heap.begin(), heap.end());
+    const size_t n = std::min(k, best.size());
+    std::partial_sort(best.begin(), best.begin() + std::ptrdiff_t(n), best.end(), betterThan);
+
+    results.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const size_t r = best[i].second;
+        results.push_back({m_ids[r], m_texts[r], best[i].first});
+    }
+    return results;
 }
 
 float cosine(const std::vector<float>& a, const std::vector<float>& b) {
@@ -0,0 +1,1058 @@
+/**
+ * @file file_search_engine.cpp
+ * @brief Work-stealing tree walk, mapped files and a vectorised literal scan.
+ *
+ * @copyright MIT License
+ */
+
+#include "file_search_engine.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SEARCH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Kernels are compiled per function so the build needs no -mavx2
+#if defined(SEARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SEARCH_AVX2 __attribute__((target("avx2,popcnt,bmi")))
+#else
+#define SEARCH_AVX2
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Binary detection window, as git and ripgrep use
+constexpr size_t kBinaryProbe = 8192;
+
+// Below this size a read() into a reused buffer beats setting up a mapping
+constexpr uint64_t kMapThreshold = 64 * 1024;
+
+constexpr size_t npos = size_t(-1);
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Paths
+// ─────────────────────────────────────────────────────────────────────────────
+
+std::string pathToUtf8(const fs::path& path) {
+#if defined(__cpp_char8_t)
+    const std::u8string s = path.u8string();
+    return std::string(s.begin(), s.end());
+#else
+    return path.u8string();
+#endif
+}
+
+fs::path utf8ToPath(const std::string& s) {
+#if defined(__cpp_char8_t)
+    return fs::path(std::u8string(s.begin(), s.end()));
+#else
+    return fs::u8path(s);
+#endif
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// File contents: mapped when large, read into a per-thread buffer when small
+// ─────────────────────────────────────────────────────────────────────────────
+
+class FileView {
+public:
+    FileView() = default;
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+    ~FileView() { close(); }
+
+    // False when the file cannot be opened or exceeds maxSize (tooLarge set)
+    bool open(const fs::path& path, uint64_t maxSize, std::vector<char>& scratch, bool& tooLarge) {
+        close();
+        tooLarge = false;
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            return false;
+        }
+        const uint64_t bytes = uint64_t(size.QuadPart);
+        if (bytes > maxSize) {
+            tooLarge = true;
+            CloseHandle(file);
+            return false;
+        }
+        bool ok = true;
+        if (bytes == 0) {
+            m_data = nullptr;
+        } else if (bytes < kMapThreshold) {
+            scratch.resize(size_t(bytes));
+            DWORD got = 0;
+            ok = ReadFile(file, scratch.data(), DWORD(bytes), &got, nullptr) != 0;
+            m_data = scratch.data();
+            m_size = got;
+        } else {
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            void* base = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (mapping) CloseHandle(mapping);  // The view keeps the mapping alive
+            ok = base != nullptr;
+            m_map = base;
+            m_data = static_cast<const char*>(base);
+            m_size = size_t(bytes);
+        }
+        CloseHandle(file);
+        return ok;
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return false;
+        }
+        const uint64_t bytes = uint64_t(st.st_size);
+        if (bytes > maxSize) {
+            tooLarge = true;
+            ::close(fd);
+            return false;
+        }
+        bool ok = true;
+        if (bytes == 0) {
+            m_data = nullptr;
+        } else if (bytes < kMapThreshold) {
+            scratch.resize(size_t(bytes));
+            size_t got = 0;
+            while (got < bytes) {
+                const ssize_t n = ::read(fd, scratch.data() + got, size_t(bytes) - got);
+                if (n <= 0) break;
+                got += size_t(n);
+            }
+            m_data = scratch.data();
+            m_size = got;
+        } else {
+            void* base = ::mmap(nullptr, size_t(bytes), PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = base != MAP_FAILED;
+            if (ok) {
+                ::madvise(base, size_t(bytes), MADV_SEQUENTIAL);
+                m_map = base;
+                m_data = static_cast<const char*>(base);
+                m_size = size_t(bytes);
+            }
+        }
+        ::close(fd);  // The mapping keeps its own reference to the file
+        return ok;
+#endif
+    }
+
+    void close() {
+        if (m_map) {
+#ifdef _WIN32
+            UnmapViewOfFile(m_map);
+#else
+            ::munmap(m_map, m_size);
+#endif
+        }
+        m_map = nullptr;
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    void* m_map = nullptr;
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Literal scan
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct FoldTable {
+    uint8_t lower[256];
+    FoldTable() {
+        for (int c = 0; c < 256; ++c) lower[c] = uint8_t(c >= 'A' && c <= 'Z' ? c + 32 : c);
+    }
+};
+const FoldTable kFold;
+
+bool isAsciiLetter(uint8_t c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+struct Needle {
+    std::string bytes;     // Lower-cased when folding
+    bool fold = false;
+    uint8_t first = 0, last = 0;          // Compared after OR-ing the fold bits in
+    uint8_t firstFold = 0, lastFold = 0;  // 0x20 for letters when folding
+
+    Needle(const std::string& literal, bool caseSensitive) : bytes(literal), fold(!caseSensitive) {
+        if (fold) {
+            for (char& c : bytes) c = char(kFold.lower[uint8_t(c)]);
+        }
+        if (bytes.empty()) return;
+        first = uint8_t(bytes.front());
+        last = uint8_t(bytes.back());
+        firstFold = fold && isAsciiLetter(first) ? 0x20 : 0;
+        lastFold = fold && isAsciiLetter(last) ? 0x20 : 0;
+    }
+
+    bool equalAt(const uint8_t* p) const {
+        if (!fold) return std::memcmp(p, bytes.data(), bytes.size()) == 0;
+        for (size_t k = 0; k < bytes.size(); ++k) {
+            if (kFold.lower[p[k]] != uint8_t(bytes[k])) return false;
+        }
+        return true;
+    }
+};
+
+size_t findScalar(const uint8_t* s, size_t n, const Needle& needle, size_t from) {
+    const size_t m = needle.bytes.size();
+    if (m == 0 || n < m) return npos;
+    if (!needle.fold) {
+        for (size_t i = from; i + m <= n;) {
+            const void* p = std::memchr(s + i, needle.first, n - m + 1 - i);
+            if (!p) return npos;
+            i = size_t(static_cast<const uint8_t*>(p) - s);
+            if (needle.equalAt(s + i)) return i;
+            ++i;
+        }
+        return npos;
+    }
+    for (size_t i = from; i + m <= n; ++i) {
+        if ((s[i] | needle.firstFold) == needle.first && (s[i + m - 1] | needle.lastFold) == needle.last &&
+            needle.equalAt(s + i)) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+size_t countNewlinesScalar(const char* p, size_t n) {
+    size_t count = 0;
+    for (const char* end = p + n; (p = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)))) != nullptr; ++p) {
+        ++count;
+    }
+    return count;
+}
+
+#ifdef SEARCH_X86
+
+int lowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return int(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Candidates are positions whose first and last bytes both match, 32 at a time
+SEARCH_AVX2 size_t findAvx2(const uint8_t* s, size_t n, const Needle& needle, size_t from) {
+    const size_t m = needle.bytes.size();
+    if (m == 0 || n < m) return npos;
+    const __m256i first = _mm256_set1_epi8(char(needle.first));
+    const __m256i last = _mm256_set1_epi8(char(needle.last));
+    const __m256i firstFold = _mm256_set1_epi8(char(needle.firstFold));
+    const __m256i lastFold = _mm256_set1_epi8(char(needle.lastFold));
+    size_t i = from;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        const __m256i head = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i)), firstFold);
+        const __m256i tail =
+            _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + m - 1)), lastFold);
+        uint32_t mask = uint32_t(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last))));
+        while (mask) {
+            const size_t at = i + size_t(lowestBit(mask));
+            if (needle.equalAt(s + at)) return at;
+            mask &= mask - 1;
+        }
+    }
+    return i + m <= n ? findScalar(s, n, needle, i) : npos;
+}
+
+SEARCH_AVX2 size_t countNewlinesAvx2(const char* p, size_t n) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+#if defined(_MSC_VER)
+        count += size_t(__popcnt(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)))));
+#else
+        count += size_t(__builtin_popcount(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)))));
+#endif
+    }
+    return count + countNewlinesScalar(p + i, n - i);
+}
+
+#endif
+
+bool hasAvx2() {
+#if defined(SEARCH_X86) && defined(_MSC_VER)
+    int info[4] = {0};
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool popcnt = (info[2] & (1 << 23)) != 0;
+    if (!osxsave || !popcnt) return false;
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0 && (info[1] & (1 << 3)) != 0 && (xcr0 & 0x6) == 0x6;
+#elif defined(SEARCH_X86)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi");
+#else
+    return false;
+#endif
+}
+
+struct Kernels {
+    size_t (*find)(const uint8_t*, size_t, const Needle&, size_t) = findScalar;
+    size_t (*countNewlines)(const char*, size_t) = countNewlinesScalar;
+
+    Kernels() {
+#ifdef SEARCH_X86
+        if (hasAvx2()) {
+            find = findAvx2;
+            countNewlines = countNewlinesAvx2;
+        }
+#endif
+    }
+};
+
+const Kernels& kernels() {
+    static const Kernels k;
+    return k;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// .gitignore and file filters
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct IgnoreRule {
+    std::string glob;
+    bool negate = false;
+    bool dirOnly = false;
+    bool anchored = false;  // Matched against the path below the .gitignore, not the name
+};
+
+// Rules of one .gitignore, chained to the ones above it
+struct IgnoreScope {
+    std::shared_ptr<const IgnoreScope> parent;
+    std::string base;  // Relative directory of the .gitignore, with a trailing '/', or empty
+    std::vector<IgnoreRule> rules;
+};
+
+std::vector<IgnoreRule> parseGitignore(const std::string& text) {
+    std::vector<IgnoreRule> rules;
+    size_t at = 0;
+    while (at < text.size()) {
+        size_t end = text.find('\n', at);
+        if (end == std::string::npos) end = text.size();
+        std::string line = text.substr(at, end - at);
+        at = end + 1;
+
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        IgnoreRule rule;
+        if (line[0] == '!') {
+            rule.negate = true;
+            line.erase(0, 1);
+        } else if (line[0] == '\\') {
+            line.erase(0, 1);
+        }
+        if (!line.empty() && line.back() == '/') {
+            rule.dirOnly = true;
+            line.pop_back();
+        }
+        if (!line.empty() && line[0] == '/') {
+            rule.anchored = true;
+            line.erase(0, 1);
+        }
+        if (line.empty()) continue;
+        rule.anchored = rule.anchored || line.find('/') != std::string::npos;
+        rule.glob = line;
+        rules.push_back(std::move(rule));
+    }
+    return rules;
+}
+
+// The innermost .gitignore with an opinion decides; within one, the last rule
+bool isIgnored(const IgnoreScope* scope, const std::string& rel, bool isDir) {
+    const size_t slash = rel.rfind('/');
+    const char* name = rel.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+    for (; scope; scope = scope->parent.get()) {
+        const char* below = rel.c_str() + scope->base.size();
+        for (auto it = scope->rules.rbegin(); it != scope->rules.rend(); ++it) {
+            if (it->dirOnly && !isDir) continue;
+            if (FileSearchEngine::globMatch(it->glob.c_str(), it->anchored ? below : name)) return !it->negate;
+        }
+    }
+    return false;
+}
+
+// Scope for the entries of dir: the enclosing one plus dir's own .gitignore
+std::shared_ptr<const IgnoreScope> withGitignore(const fs::path& dir, const std::string& rel,
+                                                 std::shared_ptr<const IgnoreScope> scope,
+                                                 std::vector<char>& scratch) {
+    FileView view;
+    bool tooLarge = false;
+    if (view.open(dir / ".gitignore", 1 << 20, scratch, tooLarge) && view.size() > 0) {
+        auto inner = std::make_shared<IgnoreScope>();
+        inner->parent = scope;
+        inner->base = rel.empty() ? std::string() : rel + "/";
+        inner->rules = parseGitignore(std::string(view.data(), view.size()));
+        if (!inner->rules.empty()) scope = std::move(inner);
+    }
+    return scope;
+}
+
+std::vector<std::string> parseFilter(const std::string& filter) {
+    std::vector<std::string> globs;
+    size_t at = 0;
+    while (at <= filter.size()) {
+        size_t end = filter.find(',', at);
+        if (end == std::string::npos) end = filter.size();
+        size_t b = at, e = end;
+        while (b < e && std::isspace(uint8_t(filter[b]))) ++b;
+        while (e > b && std::isspace(uint8_t(filter[e - 1]))) --e;
+        if (e > b) {
+            if (e - b == 1 && filter[b] == '*') return {};  // Everything
+            globs.push_back(filter.substr(b, e - b));
+        }
+        at = end + 1;
+    }
+    return globs;
+}
+
+// Offset just past a {n}, {n,} or {n,m} quantifier at i, or 0 when the
+// brace is a literal
+size_t braceQuantifierEnd(const std::string& s, size_t i) {
+    size_t j = i + 1;
+    const size_t digits = j;
+    while (j < s.size() && std::isdigit(uint8_t(s[j]))) ++j;
+    if (j == digits) return 0;
+    if (j < s.size() && s[j] == ',') {
+        ++j;
+        while (j < s.size() && std::isdigit(uint8_t(s[j]))) ++j;
+    }
+    return j < s.size() && s[j] == '}' ? j + 1 : 0;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Search run: per-thread task deques with stealing
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct Task {
+    fs::path path;
+    std::string rel;  // '/'-separated path below the root, for ignore rules
+    std::shared_ptr<const IgnoreScope> scope;
+    bool dir = false;
+};
+
+// Directory as list-only mode reports it; a failed stat leaves mtime 0
+FileSearchEntry directoryEntry(const fs::path& path) {
+    FileSearchEntry entry;
+    entry.path = pathToUtf8(path);
+    std::error_code ec;
+    const auto time = fs::last_write_time(path, ec);
+    if (!ec) entry.mtime = int64_t(time.time_since_epoch().count());
+    return entry;
+}
+
+class SearchRun {
+public:
+    SearchRun(const FileSearchEngine::Options& options, const FileSearchQuery& query,
+              const FileSearchEngine::BatchCallback& onBatch, bool listOnly = false, bool recursive = true)
+        : m_listOnly(listOnly)
+        , m_recursive(recursive)
+        , m_options(options)
+        , m_query(query)
+        , m_onBatch(onBatch)
+        , m_needle(query.literal, query.caseSensitive)
+        , m_filter(parseFilter(options.fileFilter)) {
+        int threads = options.threads > 0 ? options.threads : int(std::thread::hardware_concurrency());
+        threads = std::max(1, threads);
+        if (!recursive) threads = 1;  // One directory's stats are not worth starting threads for
+        m_queues = std::vector<Queue>(size_t(threads));
+        m_workers.resize(size_t(threads));
+    }
+
+    void push(int worker, Task task) {
+        m_outstanding.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(m_queues[size_t(worker)].mutex);
+            m_queues[size_t(worker)].tasks.push_back(std::move(task));
+        }
+        // Sequentially consistent with the idle count, so a sleeper either
+        // sees the task or is seen and woken
+        m_queued.fetch_add(1);
+        if (m_idle.load() > 0) {
+            { std::lock_guard<std::mutex> lock(m_idleMutex); }
+            m_idleCv.notify_one();
+        }
+    }
+
+    int threadCount() const { return int(m_queues.size()); }
+
+    bool matchesFilter(const std::string& name) const {
+        if (m_filter.empty()) return true;
+        for (const std::string& glob : m_filter) {
+            if (FileSearchEngine::globMatch(glob.c_str(), name.c_str())) return true;
+        }
+        return false;
+    }
+
+    // Directories the walk entered (or, when not recursive, found) in list-only mode
+    std::vector<FileSearchEntry> takeWalked() {
+        std::vector<FileSearchEntry> all;
+        for (Worker& w : m_workers) {
+            all.insert(all.end(), std::make_move_iterator(w.walked.begin()), std::make_move_iterator(w.walked.end()));
+            w.walked.clear();
+        }
+        return all;
+    }
+
+    // Files the walk found in list-only mode
+    std::vector<FileSearchEntry> takeListed() {
+        std::vector<FileSearchEntry> all;
+        for (Worker& w : m_workers) {
+            all.insert(all.end(), std::make_move_iterator(w.listed.begin()), std::make_move_iterator(w.listed.end()));
+            w.listed.clear();
+        }
+        return all;
+    }
+
+    FileSearchStats run() {
+        std::vector<std::thread> threads;
+        for (size_t w = 1; w < m_queues.size(); ++w) {
+            threads.emplace_back([this, w] { workerLoop(int(w)); });
+        }
+        workerLoop(0);
+        for (std::thread& t : threads) t.join();
+
+        FileSearchStats total;
+        for (const Worker& w : m_workers) {
+            total.filesSearched += w.stats.filesSearched;
+            total.binarySkipped += w.stats.binarySkipped;
+            total.ignored += w.stats.ignored;
+            total.bytesSearched += w.stats.bytesSearched;
+            total.hits += w.stats.hits;
+        }
+        total.cancelled = cancelled();
+        return total;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct Worker {
+        FileSearchStats stats;
+        std::vector<char> scratch;
+        std::vector<FileSearchHit> batch;
+        std::vector<std::pair<size_t, size_t>> matches;
+        std::vector<FileSearchEntry> listed;
+        std::vector<FileSearchEntry> walked;
+        std::chrono::steady_clock::time_point lastFlush = std::chrono::steady_clock::now();
+    };
+
+    bool cancelled() const {
+        return m_options.cancel && m_options.cancel->load(std::memory_order_relaxed);
+    }
+
+    // Own tasks newest first (depth first, warm directories); steal oldest
+    bool pop(int worker, Task& task) {
+        const size_t n = m_queues.size();
+        for (size_t k = 0; k < n; ++k) {
+            Queue& q = m_queues[(size_t(worker) + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            if (k == 0) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            } else {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            m_queued.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(int worker) {
+        Worker& self = m_workers[size_t(worker)];
+        Task task;
+        for (;;) {
+            if (cancelled()) break;
+            if (pop(worker, task)) {
+                if (task.dir) {
+                    walkDirectory(worker, task);
+                } else if (m_listOnly) {
+                    listFile(self, task.path);
+                } else {
+                    searchFile(self, task.path);
+                }
+                task = Task();
+                if (m_outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    { std::lock_guard<std::mutex> lock(m_idleMutex); }
+                    m_idleCv.notify_all();
+                }
+                continue;
+            }
+            if (m_outstanding.load(std::memory_order_acquire) == 0) break;
+
+            std::unique_lock<std::mutex> lock(m_idleMutex);
+            m_idle.fetch_add(1);
+            m_idleCv.wait_for(lock, std::chrono::milliseconds(5), [this] {
+                return m_queued.load() > 0 ||
+                       m_outstanding.load(std::memory_order_acquire) == 0 || cancelled();
+            });
+            m_idle.fetch_sub(1);
+        }
+        flush(self);
+    }
+
+    void walkDirectory(int worker, const Task& task) {
+        Worker& self = m_workers[size_t(worker)];
+        // Stat before listing, so a change made during the listing moves the mtime past the recorded one
+        if (m_listOnly) self.walked.push_back(directoryEntry(task.path));
+        std::shared_ptr<const IgnoreScope> scope = task.scope;
+        if (m_options.useGitignore) scope = withGitignore(task.path, task.rel, std::move(scope), self.scratch);
+
+        std::error_code ec;
+        fs::directory_iterator it(task.path, fs::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const fs::directory_entry& entry = *it;
+            const std::string name = pathToUtf8(entry.path().filename());
+            std::error_code typeEc;
+            const bool symlink = entry.is_symlink(typeEc);
+            // Symlinked directories are not followed, so the walk cannot cycle
+            const bool isDir = !symlink && entry.is_directory(typeEc);
+            if (!isDir && !entry.is_regular_file(typeEc)) continue;
+            // Hidden entries (.git among them) are skipped, as QDir's default listing did
+            if (!name.empty() && name[0] == '.') continue;
+
+            std::string rel = task.rel.empty() ? name : task.rel + "/" + name;
+            if (scope && isIgnored(scope.get(), rel, isDir)) {
+                ++self.stats.ignored;
+                continue;
+            }
+            if (!isDir && !matchesFilter(name)) {
+                ++self.stats.ignored;
+                continue;
+            }
+            if (isDir && !m_recursive) {
+                self.walked.push_back(directoryEntry(entry.path()));
+                continue;
+            }
+            push(worker, Task{entry.path(), std::move(rel), isDir ? scope : nullptr, isDir});
+        }
+    }
+
+    void listFile(Worker& self, const fs::path& path) {
+        std::error_code ec;
+        FileSearchEntry entry;
+        entry.size = fs::file_size(path, ec);
+        if (ec) return;
+        entry.mtime = int64_t(fs::last_write_time(path, ec).time_since_epoch().count());
+        if (ec) return;
+        entry.path = pathToUtf8(path);
+        self.listed.push_back(std::move(entry));
+    }
+
+    void searchFile(Worker& self, const fs::path& path) {
+        FileView view;
+        bool tooLarge = false;
+        if (!view.open(path, m_options.maxFileSize, self.scratch, tooLarge)) {
+            if (tooLarge) ++self.stats.ignored;
+            return;
+        }
+        const char* data = view.data();
+        const size_t size = view.size();
+        if (size > 0 && std::memchr(data, 0, std::min(size, kBinaryProbe))) {
+            ++self.stats.binarySkipped;
+            return;
+        }
+        ++self.stats.filesSearched;
+        self.stats.bytesSearched += size;
+        if (size == 0) return;
+
+        std::string pathText;  // Built on the first hit only
+        auto emit = [&](int line, const char* lineStart, size_t lineSize, size_t column, size_t length) {
+            ++self.stats.hits;
+            if (!m_onBatch) return;
+            if (pathText.empty()) pathText = pathToUtf8(path);
+            FileSearchHit hit;
+            hit.path = pathText;
+            hit.line = line;
+            hit.column = int(column);
+            hit.lineText.assign(lineStart, lineSize);
+            hit.matchText.assign(lineStart + column, std::min(length, lineSize - std::min(column, lineSize)));
+            self.batch.push_back(std::move(hit));
+            if (self.batch.size() >= m_options.batchSize) flush(self);
+        };
+        auto trimmedLength = [](const char* line, size_t n) {
+            return n > 0 && line[n - 1] == '\r' ? n - 1 : n;
+        };
+        auto runMatcher = [&](int line, const char* lineStart, size_t lineSize) {
+            self.matches.clear();
+            m_query.matcher(lineStart, lineSize, self.matches);
+            for (const auto& m : self.matches) emit(line, lineStart, lineSize, m.first, m.second);
+        };
+
+        const Kernels& k = kernels();
+
+        // A matcher without a prefilter literal sees every line
+        if (m_needle.bytes.empty()) {
+            if (!m_query.matcher) return;
+            int line = 1;
+            for (size_t at = 0; at < size; ++line) {
+                const char* nl = static_cast<const char*>(std::memchr(data + at, '\n', size - at));
+                const size_t end = nl ? size_t(nl - data) : size;
+                runMatcher(line, data + at, trimmedLength(data + at, end - at));
+                at = end + 1;
+                if ((line & 4095) == 0 && cancelled()) return;
+            }
+            return;
+        }
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        size_t countedTo = 0;  // Newlines before this offset are counted in lineNo
+        int lineNo = 1;
+        size_t lineStart = 0, lineEnd = 0;
+        bool haveLine = false;
+        for (size_t pos = 0; pos < size;) {
+            const size_t hit = k.find(bytes, size, m_needle, pos);
+            if (hit == npos) break;
+            if (!haveLine || hit > lineEnd) {
+                lineStart = hit;
+                while (lineStart > 0 && data[lineStart - 1] != '\n') --lineStart;
+                const char* nl = static_cast<const char*>(std::memchr(data + hit, '\n', size - hit));
+                lineEnd = nl ? size_t(nl - data) : size;
+                lineNo += int(k.countNewlines(data + countedTo, lineStart - countedTo));
+                countedTo = lineStart;
+                haveLine = true;
+            }
+            const size_t lineSize = trimmedLength(data + lineStart, lineEnd - lineStart);
+            if (m_query.matcher) {
+                runMatcher(lineNo, data + lineStart, lineSize);
+                pos = lineEnd + 1;
+            } else {
+                emit(lineNo, data + lineStart, lineSize, hit - lineStart, m_needle.bytes.size());
+                pos = hit + m_needle.bytes.size();
+            }
+            if (cancelled()) return;
+        }
+
+        if (!self.batch.empty() && std::chrono::steady_clock::now() - self.lastFlush >=
+                                       std::chrono::milliseconds(m_options.flushIntervalMs)) {
+            flush(self);
+        }
+    }
+
+    void flush(Worker& self) {
+        if (!self.batch.empty() && m_onBatch) m_onBatch(self.batch);
+        self.batch.clear();
+        self.lastFlush = std::chrono::steady_clock::now();
+    }
+
+    const bool m_listOnly;
+    const bool m_recursive;
+    const FileSearchEngine::Options& m_options;
+    const FileSearchQuery& m_query;
+    const FileSearchEngine::BatchCallback& m_onBatch;
+    const Needle m_needle;
+    const std::vector<std::string> m_filter;
+
+    std::vector<Queue> m_queues;
+    std::vector<Worker> m_workers;
+    std::atomic<size_t> m_outstanding{0};  // Pushed and not yet finished
+    std::atomic<size_t> m_queued{0};       // Sitting in a deque
+    std::atomic<int> m_idle{0};
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleCv;
+};
+
+} // namespace
+
+FileSearchStats FileSearchEngine::search(const std::string& root, const FileSearchQuery& query,
+                                         const BatchCallback& onBatch) const {
+    SearchRun run(m_options, query, onBatch);
+    const fs::path rootPath = utf8ToPath(root);
+    std::error_code ec;
+    if (fs::is_directory(rootPath, ec)) {
+        run.push(0, Task{rootPath, std::string(), nullptr, true});
+    } else if (fs::is_regular_file(rootPath, ec)) {
+        run.push(0, Task{rootPath, std::string(), nullptr, false});
+    }
+    return run.run();
+}
+
+FileSearchStats FileSearchEngine::searchFiles(const std::vector<std::string>& files, const FileSearchQuery& query,
+                                              const BatchCallback& onBatch) const {
+    SearchRun run(m_options, query, onBatch);
+    uint64_t filtered = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        fs::path path = utf8ToPath(files[i]);
+        if (!run.matchesFilter(pathToUtf8(path.filename()))) {
+            ++filtered;
+            continue;
+        }
+        // Spread over the deques up front; stealing evens out the rest
+        run.push(int(i % size_t(run.threadCount())), Task{std::move(path), std::string(), nullptr, false});
+    }
+    FileSearchStats stats = run.run();
+    stats.ignored += filtered;
+    return stats;
+}
+
+std::vector<FileSearchEntry> FileSearchEngine::listFiles(const std::string& root,
+                                                        std::vector<FileSearchEntry>* directories) const {
+    const FileSearchQuery none;
+    SearchRun run(m_options, none, BatchCallback(), true);
+    const fs::path rootPath = utf8ToPath(root);
+    std::error_code ec;
+    if (fs::is_directory(rootPath, ec)) {
+        run.push(0, Task{rootPath, std::string(), nullptr, true});
+    } else if (fs::is_regular_file(rootPath, ec)) {
+        run.push(0, Task{rootPath, std::string(), nullptr, false});
+    }
+    run.run();
+    if (directories) *directories = run.takeWalked();
+    return run.takeListed();
+}
+
+std::vector<FileSearchEntry> FileSearchEngine::listFiles(const std::string& root, const std::string& dir,
+                                                        bool recursive,
+                                                        std::vector<FileSearchEntry>* directories) const {
+    if (directories) directories->clear();
+    const fs::path rootPath = utf8ToPath(root).lexically_normal();
+    const fs::path dirPath = utf8ToPath(dir).lexically_normal();
+    std::error_code ec;
+    if (!fs::is_directory(dirPath, ec)) return {};
+
+    // Replay the full walk's decisions from root down to dir
+    Task task{dirPath, std::string(), nullptr, true};
+    const fs::path below = dirPath.lexically_relative(rootPath);
+    if (!below.empty() && below != "." && *below.begin() != "..") {
+        std::vector<char> scratch;
+        fs::path at = rootPath;
+        for (const fs::path& part : below) {
+            if (m_options.useGitignore) task.scope = withGitignore(at, task.rel, std::move(task.scope), scratch);
+            const std::string name = pathToUtf8(part);
+            at /= part;
+            if (name.empty() || name[0] == '.' || fs::is_symlink(at, ec)) return {};
+            task.rel = task.rel.empty() ? name : task.rel + "/" + name;
+            if (task.scope && isIgnored(task.scope.get(), task.rel, true)) return {};
+        }
+    }
+
+    const FileSearchQuery none;
+    SearchRun run(m_options, none, BatchCallback(), true, recursive);
+    run.push(0, std::move(task));
+    run.run();
+    if (directories) *directories = run.takeWalked();
+    return run.takeListed();
+}
+
+std::string FileSearchEngine::requiredLiteral(const std::string& regex, bool caseSensitive) {
+    // Only literals outside groups count: anything in a group may be optional
+    // or one branch of an alternation. A top-level '|' or inline flags make
+    // every literal optional, so nothing is required.
+    std::string best, run;
+    auto endRun = [&] {
+        if (run.size() > best.size()) best = run;
+        run.clear();
+    };
+    int depth = 0;
+    const size_t n = regex.size();
+    size_t i = 0;
+    while (i < n) {
+        const char c = regex[i];
+        std::string piece;  // A literal character at depth 0, or empty
+        bool literal = false;
+        if (c == '\\') {
+            if (i + 1 >= n) return std::string();
+            const uint8_t e = uint8_t(regex[i + 1]);
+            if (e == 'Q') return std::string();
+            if (std::isalnum(e)) {
+                // Class, anchor, back-reference or code point escape
+                i += 2;
+                endRun();
+                continue;
+            }
+            size_t len = 1;
+            if (e >= 0x80) {
+                while (i + 1 + len < n && (uint8_t(regex[i + 1 + len]) & 0xC0) == 0x80) ++len;
+            }
+            piece = regex.substr(i + 1, len);
+            literal = true;
+            i += 1 + len;
+        } else if (c == '[') {
+            // Skip the class; ']' right after '[' or '[^' is a member
+            size_t j = i + 1;
+            if (j < n && regex[j] == '^') ++j;
+            if (j < n && regex[j] == ']') ++j;
+            while (j < n && regex[j] != ']') j += regex[j] == '\\' ? 2 : 1;
+            if (j >= n) return std::string();
+            i = j + 1;
+            endRun();
+        } else if (c == '(') {
+            if (i + 1 < n && regex[i + 1] == '?' && i + 2 < n &&
+                (std::isalpha(uint8_t(regex[i + 2])) || regex[i + 2] == '^' || regex[i + 2] == '-')) {
+                return std::string();  // Inline flags
+            }
+            ++depth;
+            ++i;
+            endRun();
+        } else if (c == ')') {
+            --depth;
+            ++i;
+            endRun();
+        } else if (c == '|') {
+            if (depth == 0) return std::string();
+            ++i;
+        } else if (c == '{' && braceQuantifierEnd(regex, i)) {
+            i = braceQuantifierEnd(regex, i);
+            endRun();
+        } else if (c == '.' || c == '^' || c == '$' || c == '*' || c == '+' || c == '?') {
+            ++i;
+            endRun();
+        } else {
+            size_t len = 1;
+            if (uint8_t(c) >= 0x80) {
+                while (i + len < n && (uint8_t(regex[i + len]) & 0xC0) == 0x80) ++len;
+            }
+            piece = regex.substr(i, len);
+            literal = true;
+            i += len;
+        }
+        if (!literal) continue;
+
+        if (depth > 0 || (!caseSensitive && uint8_t(piece[0]) >= 0x80)) {
+            endRun();
+            continue;
+        }
+        // A quantifier that allows zero drops the piece; '+' keeps one copy
+        const char q = i < n ? regex[i] : '\0';
+        if (q == '?' || q == '*' || (q == '{' && braceQuantifierEnd(regex, i))) {
+            endRun();
+        } else if (q == '+') {
+            run += piece;
+            endRun();
+        } else {
+            run += piece;
+        }
+    }
+    endRun();
+    return best;
+}
+
+bool FileSearchEngine::globMatch(const char* p, const char* t) {
+    while (*p) {
+        if (p[0] == '*' && p[1] == '*') {
+            while (*p == '*') ++p;
+            if (*p == '\0') return true;
+            if (*p == '/') {
+                // "**/" matches zero or more whole directories
+                ++p;
+                for (;;) {
+                    if (globMatch(p, t)) return true;
+                    t = std::strchr(t, '/');
+                    if (!t) return false;
+                    ++t;
+                }
+            }
+            for (; *t; ++t) {
+                if (globMatch(p, t)) return true;
+            }
+            return globMatch(p, t);
+        }
+        switch (*p) {
+        case '*':
+            ++p;
+            for (;; ++t) {
+                if (globMatch(p, t)) return true;
+                if (*t == '\0' || *t == '/') return false;
+            }
+        case '?':
+            if (*t == '\0' || *t == '/') return false;
+            ++p;
+            ++t;
+            break;
+        case '[': {
+            if (*t == '\0' || *t == '/') return false;
+            const char* q = p + 1;
+            const bool negate = *q == '!' || *q == '^';
+            if (negate) ++q;
+            bool matched = false;
+            bool firstMember = true;
+            while (*q && (*q != ']' || firstMember)) {
+                firstMember = false;
+                char lo = *q;
+                if (lo == '\\' && q[1]) lo = *++q;
+                char hi = lo;
+                if (q[1] == '-' && q[2] && q[2] != ']') {
+                    hi = q[2];
+                    q += 2;
+                }
+                if (uint8_t(*t) >= uint8_t(lo) && uint8_t(*t) <= uint8_t(hi)) matched = true;
+                ++q;
+            }
+            if (*q != ']') {
+                // Unterminated: a literal '['
+                if (*t != '[') return false;
+                ++p;
+                ++t;
+                break;
+            }
+            if (matched == negate) return false;
+            p = q + 1;
+            ++t;
+            break;
+        }
+        case '\\':
+            if (p[1]) ++p;
+            [[fallthrough]];
+        default:
+            if (*p != *t) return false;
+            ++p;
+            ++t;
+            break;
+        }
+    }
+    return *t == '\0';
+}
@@ -4,6 +4,15 @@
 #include <stdexcept>
 #include <iostream>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 GGUFLoader::GGUFLoader() 
     : is_open_(false) {
     std::memset(&header_, 0, sizeof(GGUFHeader));
@@ -22,6 +31,10 @@ bool GGUFLoader::Open(const std::string& filepath) {
     
     is_open_ = true;
     
+    // Header parsing and tensor reads are served from a read-only mapping when
+    // available; failure is not fatal, the stream path still works
+    use_mmap_ = InitializeMemoryMap();
+    
     // ParseHeader now throws exceptions on error (consistent error handling)
     try {
         if (!ParseHeader()) {
@@ -37,11 +50,15 @@ bool GGUFLoader::Open(const std::string& filepath) {
 }
 
 bool GGUFLoader::Close() {
+    CleanupMemoryMap();
     if (file_.is_open()) {
         file_.close();
     }
     is_open_ = false;
     tensors_.clear();
+    tensor_index_.clear();
+    metadata_ = GGUFMetadata{};
+    parser_ = gguf::Parser();
     return true;
 }
 
@@ -50,38 +67,28 @@ bool GGUFLoader::ParseHeader() {
         throw std::runtime_error("Cannot parse header: file not open");
     }
     
-    file_.seekg(0);
-    
-    // Read magic
-    if (!ReadValue(header_.magic)) {
-        throw std::runtime_error("Failed to read GGUF magic bytes");
-    }
-    if (header_.magic != 0x46554747) {  // "GGUF"
-        throw std::runtime_error("Invalid GGUF magic: 0x" + std::to_string(header_.magic) + 
-                                 " (expected 0x46554747)");
-    }
-    
-    // Read version
-    if (!ReadValue(header_.version)) {
-        throw std::runtime_error("Failed to read GGUF version");
+    // One pass over header, metadata and tensor table; keys and strings stay
+    // views into the mapping (or into the parser's header buffer)
+    gguf::Parser::Status status;
+    if (use_mmap_) {
+        status = parser_.Parse(mmap_base_, static_cast<size_t>(file_size_));
+    } else {
+        status = parser_.ParseFrom([this](uint64_t offset, void* dst, size_t n) -> size_t {
+            file_.clear();
+            file_.seekg(static_cast<std::streamoff>(offset));
+            file_.read(static_cast<char*>(dst), static_cast<std::streamsize>(n));
+            return static_cast<size_t>(file_.gcount());
+        }, GetFileSize());
     }
-    if (header_.version != 3) {
-        throw std::runtime_error("Unsupported GGUF version: " + std::to_string(header_.version) + 
-                                 " (only version 3 supported)");
+    if (status != gguf::Parser::Status::Ok) {
+        throw std::runtime_error("Failed to parse GGUF header: " + parser_.Error());
     }
     
-    // Read tensor count
-    if (!ReadValue(header_.tensor_count)) {
-        throw std::runtime_error("Failed to read tensor count");
-    }
-    
-    // Read metadata KV count
-    if (!ReadValue(header_.metadata_kv_count)) {
-        throw std::runtime_error("Failed to read metadata KV count");
-    }
-    
-    // Calculate metadata offset
-    header_.metadata_offset = file_.tellg();
+    header_.magic = gguf::Parser::kMagic;
+    header_.version = parser_.Version();
+    header_.tensor_count = parser_.TensorCount();
+    header_.metadata_kv_count = parser_.KVCount();
+    header_.metadata_offset = 24;  // magic + version + two u64 counts
     
     std::cout << "GGUF Header: Magic=0x" << std::hex << header_.magic << std::dec 
               << ", Version=" << header_.version
@@ -91,151 +98,51 @@ bool GGUFLoader::ParseHeader() {
     return true;
 }
 
-bool GGUFLoader::ParseMetadata() {
-    if (!file_.is_open()) {
-        throw std::runtime_error("Cannot parse metadata: file not open");
-    }
-    if (header_.metadata_kv_count == 0) {
-        // Valid case: GGUF file with no metadata
-        return true;
+void GGUFLoader::FillMetadata(const gguf::Parser& parser, GGUFMetadata& metadata) {
+    metadata = GGUFMetadata{};
+    for (const auto& [key, value] : parser.Metadata()) {
+        metadata.kv_pairs.emplace(std::string(key), value.ToDisplayString());
     }
     
-    file_.seekg(header_.metadata_offset);
+    const std::string_view arch = parser.Architecture();
+    metadata.architecture_type = arch == "llama" ? 1 : 0;
+    metadata.layer_count = static_cast<uint32_t>(parser.GetArchInt("block_count"));
+    metadata.context_length = static_cast<uint32_t>(parser.GetArchInt("context_length"));
+    metadata.embedding_dim = static_cast<uint32_t>(parser.GetArchInt("embedding_length"));
     
-    for (uint64_t i = 0; i < header_.metadata_kv_count; ++i) {
-        std::string key, value;
-        
-        if (!ReadString(key)) {
-            throw std::runtime_error("Failed to read metadata key at index " + std::to_string(i));
-        }
-        
-        uint32_t value_type;
-        if (!ReadValue(value_type)) {
-            throw std::runtime_error("Failed to read metadata value type for key: " + key);
-        }
-        
-        // GGUF Value Types (https://github.com/ggerganov/ggml/blob/master/docs/gguf.md)
-        // 1=String, 4=UInt32, 5=Int32, 6=Float32, 8=UInt64, 9=Int64, 10=Float64, 11=Array, 12=Bool
-        
-        if (value_type == 1) {  // UTF-8 string
-            if (!ReadString(value)) {
-                throw std::runtime_error("Failed to read metadata string value for key: " + key);
-            }
-            metadata_.kv_pairs[key] = value;
-            
-            // Parse important metadata
-            if (key == "general.architecture") {
-                if (value == "llama") metadata_.architecture_type = 1;
-            } else if (key == "llama.block_count") {
-                metadata_.layer_count = std::stoul(value);
-            } else if (key == "llama.context_length") {
-                metadata_.context_length = std::stoul(value);
-            } else if (key == "llama.embedding_length") {
-                metadata_.embedding_dim = std::stoul(value);
-            } else if (key == "llama.vocab_size") {
-                metadata_.vocab_size = std::stoul(value);
-            }
-        } else if (value_type == 4) {  // uint32
-            uint32_t uint_val;
-            if (!ReadValue(uint_val)) throw std::runtime_error("Failed to read uint32 for key: " + key);
-            metadata_.kv_pairs[key] = std::to_string(uint_val);
-        } else if (value_type == 5) {  // int32
-            int32_t int_val;
-            if (!ReadValue(int_val)) throw std::runtime_error("Failed to read int32 for key: " + key);
-            metadata_.kv_pairs[key] = std::to_string(int_val);
-        } else if (value_type == 6) {  // float32
-            float float_val;
-            if (!ReadValue(float_val)) throw std::runtime_error("Failed to read float32 for key: " + key);
-            metadata_.kv_pairs[key] = std::to_string(float_val);
-        } else if (value_type == 8) {  // uint64
-            uint64_t uint64_val;
-            if (!ReadValue(uint64_val)) throw std::runtime_error("Failed to read uint64 for key: " + key);
-            metadata_.kv_pairs[key] = std::to_string(uint64_val);
-        } else if (value_type == 9) {  // int64
-            int64_t int64_val;
-            if (!ReadValue(int64_val)) throw std::runtime_error("Failed to read int64 for key: " + key);
-            metadata_.kv_pairs[key] = std::to_string(int64_val);
-        } else if (value_type == 10) {  // float64
-            double float64_val;
-            if (!ReadValue(float64_val)) throw std::runtime_error("Failed to read float64 for key: " + key);
-            metadata_.kv_pairs[key] = std::to_string(float64_val);
-        } else if (value_type == 12) {  // boolean
-            uint8_t bool_val;
-            if (!ReadValue(bool_val)) throw std::runtime_error("Failed to read bool for key: " + key);
-            metadata_.kv_pairs[key] = bool_val ? "true" : "false";
-        } else if (value_type == 11) {  // array
-            // Array format: value_type (uint32) + array_length (uint64) + elements
-            uint32_t array_type;
-            uint64_t array_length;
-            if (!ReadValue(array_type)) throw std::runtime_error("Failed to read array type for key: " + key);
-            if (!ReadValue(array_length)) throw std::runtime_error("Failed to read array length for key: " + key);
-            
-            // For now, serialize array as comma-separated string (improve later if needed)
-            std::string array_str = "[";
-            for (uint64_t j = 0; j < array_length; ++j) {
-                if (array_type == 1) {  // string array
-                    std::string elem;
-                    if (!ReadString(elem)) throw std::runtime_error("Failed to read array string element");
-                    array_str += "\"" + elem + "\"";
-                } else if (array_type == 4) {  // uint32 array
-                    uint32_t elem;
-                    if (!ReadValue(elem)) throw std::runtime_error("Failed to read array uint32 element");
-                    array_str += std::to_string(elem);
-                } else if (array_type == 5) {  // int32 array
-                    int32_t elem;
-                    if (!ReadValue(elem)) throw std::runtime_error("Failed to read array int32 element");
-                    array_str += std::to_string(elem);
-                } else if (array_type == 6) {  // float32 array
-                    float elem;
-                    if (!ReadValue(elem)) throw std::runtime_error("Failed to read array float32 element");
-                    array_str += std::to_string(elem);
-                } else {
-                    throw std::runtime_error("Unsupported array element type: " + std::to_string(array_type));
-                }
-                if (j < array_length - 1) array_str += ", ";
-            }
-            array_str += "]";
-            metadata_.kv_pairs[key] = array_str;
-        } else {
-            throw std::runtime_error("Unsupported metadata value type " + std::to_string(value_type) + " for key: " + key);
+    // Token strings are materialised once, straight from the file bytes
+    if (const gguf::Value* tokens = parser.Find("tokenizer.ggml.tokens")) {
+        metadata.tokens.reserve(static_cast<size_t>(tokens->ArraySize()));
+        for (std::string_view token : tokens->Strings()) {
+            metadata.tokens.emplace_back(token);
         }
     }
+    metadata.vocab_size = static_cast<uint32_t>(
+        parser.GetArchInt("vocab_size", static_cast<int64_t>(metadata.tokens.size())));
+}
+
+bool GGUFLoader::ParseMetadata() {
+    if (!file_.is_open()) {
+        throw std::runtime_error("Cannot parse metadata: file not open");
+    }
+    
+    FillMetadata(parser_, metadata_);
     
-    // Read tensor info
-    for (uint64_t i = 0; i < header_.tensor_count; ++i) {
+    // Tensor table (offsets are absolute: data section start + relative offset)
+    tensors_.clear();
+    tensors_.reserve(parser_.Tensors().size());
+    for (const gguf::TensorDesc& desc : parser_.Tensors()) {
         TensorInfo tensor;
-        
-        if (!ReadString(tensor.name)) {
-            throw std::runtime_error("Failed to read tensor name at index " + std::to_string(i));
-        }
-        
-        uint32_t n_dims;
-        if (!ReadValue(n_dims)) {
-            throw std::runtime_error("Failed to read dimension count for tensor: " + tensor.name);
-        }
-        
-        tensor.shape.resize(n_dims);
-        for (uint32_t d = 0; d < n_dims; ++d) {
-            if (!ReadValue(tensor.shape[d])) {
-                throw std::runtime_error("Failed to read dimension " + std::to_string(d) + " for tensor: " + tensor.name);
-            }
-        }
-        
-        uint32_t type_val;
-        if (!ReadValue(type_val)) {
-            throw std::runtime_error("Failed to read type for tensor: " + tensor.name);
-        }
-        tensor.type = static_cast<GGMLType>(type_val);
-        
-        if (!ReadValue(tensor.offset)) {
-            throw std::runtime_error("Failed to read offset for tensor: " + tensor.name);
-        }
-        
+        tensor.name.assign(desc.name);
+        tensor.shape.assign(desc.ne, desc.ne + desc.n_dims);
+        tensor.type = static_cast<GGMLType>(desc.type);
+        tensor.offset = desc.offset;
         tensor.size_bytes = CalculateTensorSize(tensor.shape, tensor.type);
-        tensors_.push_back(tensor);
+        tensors_.push_back(std::move(tensor));
     }
     
     // Build O(1) lookup index for tensor access (Bottleneck #14 fix)
+    tensor_index_.clear();
     for (auto& tensor : tensors_) {
         tensor_index_[tensor.name] = &tensor;
     }
@@ -259,6 +166,10 @@ bool GGUFLoader::LoadTensorZone(const std::string& tensor_name, std::vector<uint
     
     const TensorInfo* tensor_info = it->second;
     data.resize(tensor_info->size_bytes);
+    if (const void* src = GetMappedSlice(tensor_info->offset, tensor_info->size_bytes)) {
+        std::memcpy(data.data(), src, tensor_info->size_bytes);
+        return true;
+    }
     file_.seekg(tensor_info->offset);
     file_.read(reinterpret_cast<char*>(data.data()), tensor_info->size_bytes);
     
@@ -287,6 +198,11 @@ bool GGUFLoader::LoadTensorRange(size_t start_idx, size_t count, std::vector<uin
     // The GGUF writer ensures proper padding between tensors, so we just
     // seek to the stored offset directly without manual alignment calculation
     for (size_t i = start_idx; i < start_idx + count; ++i) {
+        if (const void* src = GetMappedSlice(tensors_[i].offset, tensors_[i].size_bytes)) {
+            std::memcpy(data.data() + offset, src, tensors_[i].size_bytes);
+            offset += tensors_[i].size_bytes;
+            continue;
+        }
         file_.seekg(tensors_[i].offset);
         file_.read(reinterpret_cast<char*>(data.data() + offset), tensors_[i].size_bytes);
         if (!file_.good()) {
@@ -306,19 +222,86 @@ std::string GGUFLoader::GetTypeString(GGMLType type) const {
     switch (type) {
         case GGMLType::F32: return "F32";
         case GGMLType::F16: return "F16";
+        case GGMLType::BF16: return "BF16";
         case GGMLType::Q4_0: return "Q4_0";
         case GGMLType::Q4_1: return "Q4_1";
+        case GGMLType::Q5_0: return "Q5_0";
         case GGMLType::Q5_1: return "Q5_1";
         case GGMLType::Q8_0: return "Q8_0";
+        case GGMLType::Q8_1: return "Q8_1";
         case GGMLType::Q2_K: return "Q2_K";
         case GGMLType::Q3_K: return "Q3_K";
         case GGMLType::Q4_K: return "Q4_K";
         case GGMLType::Q5_K: return "Q5_K";
         case GGMLType::Q6_K: return "Q6_K";
+        case GGMLType::Q8_K: return "Q8_K";
         default: return "UNKNOWN";
     }
 }
 
+const void* GGUFLoader::GetTensorView(const std::string& tensor_name) const {
+    auto it = tensor_index_.find(tensor_name);
+    if (it == tensor_index_.end()) {
+        throw std::runtime_error("Tensor not found: " + tensor_name);
+    }
+    return GetMappedSlice(it->second->offset, it->second->size_bytes);
+}
+
+bool GGUFLoader::InitializeMemoryMap() {
+    CleanupMemoryMap();
+    file_size_ = GetFileSize();
+    if (file_size_ == 0) return false;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath_.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!base) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    file_handle_ = file;
+    map_handle_ = mapping;
+    mmap_base_ = base;
+#else
+    int fd = ::open(filepath_.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    void* base = ::mmap(nullptr, file_size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // The mapping keeps its own reference to the file
+    if (base == MAP_FAILED) return false;
+    mmap_base_ = base;
+#endif
+    return true;
+}
+
+void GGUFLoader::CleanupMemoryMap() {
+#ifdef _WIN32
+    if (mmap_base_) UnmapViewOfFile(mmap_base_);
+    if (map_handle_) CloseHandle(static_cast<HANDLE>(map_handle_));
+    if (file_handle_) CloseHandle(static_cast<HANDLE>(file_handle_));
+#else
+    if (mmap_base_) ::munmap(mmap_base_, file_size_);
+#endif
+    mmap_base_ = nullptr;
+    map_handle_ = nullptr;
+    file_handle_ = nullptr;
+    use_mmap_ = false;
+}
+
+const void* GGUFLoader::GetMappedSlice(uint64_t offset, uint64_t size) const {
+    if (!use_mmap_ || !mmap_base_ || offset > file_size_ || size > file_size_ - offset) {
+        return nullptr;
+    }
+    return static_cast<const uint8_t*>(mmap_base_) + offset;
+}
+
 uint64_t GGUFLoader::GetFileSize() const {
     if (!file_.is_open()) return 0;
     
@@ -332,81 +315,18 @@ uint64_t GGUFLoader::GetFileSize() const {
 // Note: BuildTensorIndex, LoadZone, UnloadZone, GetLoadedZones, GetAllZones, 
 //       GetAllTensorInfo, GetCurrentMemoryUsage are implemented inline in gguf_loader.h
 
-template<typename T>
-bool GGUFLoader::ReadValue(T& value) {
-    file_.read(reinterpret_cast<char*>(&value), sizeof(T));
-    return file_.good();
-}
-
-bool GGUFLoader::ReadString(std::string& value) {
-    uint64_t len;
-    if (!ReadValue(len)) return false;
-    
-    value.resize(len);
-    file_.read(&value[0], len);
-    return file_.good();
-}
-
 uint64_t GGUFLoader::CalculateTensorSize(const std::vector<uint64_t>& shape, GGMLType type) const {
     uint64_t num_elements = 1;
     for (uint64_t dim : shape) {
         num_elements *= dim;
     }
     
-    // Helper lambda for block-aligned size calculation
-    // Formula: block_size × ceil(num_elements / block_elements)
-    auto block_aligned_size = [num_elements](uint64_t block_elements, uint64_t block_size) -> uint64_t {
-        uint64_t num_blocks = (num_elements + block_elements - 1) / block_elements;  // Ceiling division
-        return num_blocks * block_size;
-    };
-    
-    // Calculate the size in bytes based on the GGML type
-    // Reference: https://github.com/ggerganov/ggml/blob/master/include/ggml.h
-    switch (type) {
-        case GGMLType::F32: 
-            return num_elements * 4;
-        case GGMLType::F16: 
-            return num_elements * 2;
-        
-        // Q4_0: 32 elements per block, 18 bytes per block (2 bytes FP16 scale + 16 bytes data)
-        case GGMLType::Q4_0: 
-            return block_aligned_size(32, 18);
-        
-        // Q4_1: 32 elements per block, 20 bytes per block (2 bytes FP16 scale + 2 bytes FP16 min + 16 bytes data)
-        case GGMLType::Q4_1: 
-            return block_aligned_size(32, 20);
-        
-        // Q8_0: 32 elements per block, 34 bytes per block (2 bytes FP16 scale + 32 bytes data)
-        case GGMLType::Q8_0: 
-            return block_aligned_size(32, 34);
-        
-        // Q5_1: 32 elements per block, 24 bytes per block
-        case GGMLType::Q5_1:
-            return block_aligned_size(32, 24);
-        
-        // K-quantization (256 elements per super-block)
-        // Q2_K: 256 elements, 84 bytes per super-block
-        case GGMLType::Q2_K: 
-            return block_aligned_size(256, 84);
-        
-        // Q3_K: 256 elements, 110 bytes per super-block
-        case GGMLType::Q3_K: 
-            return block_aligned_size(256, 110);
-        
-        // Q4_K: 256 elements, 144 bytes per super-block
-        case GGMLType::Q4_K: 
-            return block_aligned_size(256, 144);
-        
-        // Q5_K: 256 elements, 176 bytes per super-block
-        case GGMLType::Q5_K: 
-            return block_aligned_size(256, 176);
-        
-        // Q6_K: 256 elements, 210 bytes per super-block
-        case GGMLType::Q6_K: 
-            return block_aligned_size(256, 210);
-        
-        default:
-            // In an enterprise setting, failing hard on an unknown type is safer
-            throw std::runtime_error("Unsupported GGMLType encountered for size calculation.");
+    // Block-aligned size from the shared ggml block table (gguf_parser.h)
+    const uint64_t bytes = gguf::TensorBytes(static_cast<uint32_t>(type), num_elements);
+    if (bytes == 0 && num_elements != 0) {
+        // In an enterprise setting, failing hard on an unknown type is safer
+        throw std::runtime_error("Unsupported GGMLType " + std::to_string(static_cast<uint32_t>(type)) +
+                                 " encountered for size calculation.");
     }
+    return bytes;
 }
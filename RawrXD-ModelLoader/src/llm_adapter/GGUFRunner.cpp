@@ -1,6 +1,7 @@
 #include "GGUFRunner.h"
 #include "QuantBackend.h"
 #include "brutal_gzip.h"
+#include "flash_attention.h"
 
 #include <QByteArray>
 #include <QCoreApplication>
@@ -32,10 +33,13 @@
 
 // Keep linkage visible to the ASM translation unit.
 extern "C" void matmul_kernel_avx2(float* A, float* B, float* C, int N, int M, int K, bool accumulate = false);
-extern "C" void ggml_gemm_q4_0(int M, int N, int K, const float* A, const uint8_t* Bq4, float scale, float* C);
 
 namespace {
 constexpr const char* kDefaultModelPath = "model/llama-7b-q4_0.gguf";
+// Prompt tokens per batched prefill pass: wide enough that each weight row is
+// reused across many tokens, small enough that the FFN activations
+// (chunk x ffnDim floats) stay bounded for multi-thousand-token prompts
+constexpr int kPrefillChunk = 512;
 struct GGUFHeader { uint32_t magic{0}; uint32_t version{0}; uint64_t tensorCount{0}; uint64_t kvCount{0}; };
 
 void skipGgufValue(QDataStream& ds, quint32 type) {
@@ -173,6 +177,7 @@ bool GGUFRunner::parseGgufTensorTable(QFile& file)
 
 GGUFRunner::GGUFRunner(QObject* parent)
     : QObject(parent)
+    , pool_(std::make_unique<WorkerPool>())
 {
     checkCpuFeatures();
     loadGGUFModel(QString::fromLatin1(kDefaultModelPath));
@@ -184,6 +189,8 @@ GGUFRunner::GGUFRunner(QObject* parent)
     qDebug() << "[GGUFRunner] Initialized"
              << "| Dims:" << context_.embedDim << "x" << context_.vocabSize
              << "| CPU: AVX2=" << context_.hasAVX2 << "AVX512=" << context_.hasAVX512 << "FMA=" << context_.hasFMA
+             << "| Quant kernels:" << QuantBackend::kernelName(QuantBackend::instance().currentKernel())
+             << "| Threads:" << pool_->threadCount()
              << "| Gen: temp=" << context_.temperature << "top_p=" << context_.topP << "max_tokens=" << context_.maxTokens;
 }
 
@@ -245,40 +252,55 @@ bool GGUFRunner::runInference(const QString& prompt, float* outputBuffer)
     const int maxTokens = std::max(1, context_.maxTokens > 0 ? context_.maxTokens : 64);
     size_t lastTokenId = 0;
 
+    // Every call is a fresh sequence: the prompt fills positions [0, n) and
+    // generated tokens follow it
+    const int promptTokens = static_cast<int>(embeddings.size() / static_cast<size_t>(M));
+    context_.kvLen = 0;
+    reserveKV(static_cast<size_t>(promptTokens) + static_cast<size_t>(maxTokens));
+
     for (int t = 0; t < maxTokens; ++t) {
-        // Transformer forward (scalar) to produce logits
+        // Transformer forward (threaded) to produce logits
         if (context_.logits.size() != context_.vocabSize) {
             context_.logits.resize(context_.vocabSize);
         }
 
-        std::vector<float> x(context_.embedDim);
-        std::memcpy(x.data(), embeddings.data(), context_.embedDim * sizeof(float));
-        for (qsizetype l = 0; l < context_.nLayers; ++l) {
-            std::vector<float> attn(context_.embedDim);
-            attentionForward(static_cast<int>(l), x.data(), attn.data());
-            for (qsizetype i = 0; i < context_.embedDim; ++i) x[i] += attn[i]; // residual
-            std::vector<float> ff(context_.embedDim);
-            mlpForward(static_cast<int>(l), x.data(), ff.data());
-            for (qsizetype i = 0; i < context_.embedDim; ++i) x[i] += ff[i]; // residual
+        // Per-token buffers come from the arena; the layers allocate after these
+        scratch_.reset();
+        const qsizetype D = context_.embedDim;
+        float* x = scratch_.alloc(D);
+        float* attn = scratch_.alloc(D);
+        float* ff = scratch_.alloc(D);
+        float* xnorm = scratch_.alloc(D);
+        if (t == 0) {
+            // The whole prompt in batched passes; only its last position needs logits
+            prefill(embeddings.data(), promptTokens, x);
+        } else {
+            embedToken(lastTokenId, context_.kvLen, x);
+            for (qsizetype l = 0; l < context_.nLayers; ++l) {
+                attentionForward(static_cast<int>(l), x, attn);
+                for (qsizetype i = 0; i < D; ++i) x[i] += attn[i]; // residual
+                mlpForward(static_cast<int>(l), x, ff);
+                for (qsizetype i = 0; i < D; ++i) x[i] += ff[i]; // residual
+            }
+            ++context_.kvLen;
         }
         // Final layernorm then logits projection
-        std::vector<float> xnorm(context_.embedDim);
-        layerNorm(x.data(), xnorm.data(), context_.ln_f_g, context_.ln_f_b, context_.embedDim);
-        // Prefer raw Q4_0 output.weight if available (runtime-dispatched GEMM)
-        if (!context_.raw_q4_output.empty()) {
-            if (context_.logits.size() != context_.vocabSize) context_.logits.resize(context_.vocabSize);
-            ggml_gemm_q4_0(1, static_cast<int>(context_.vocabSize), static_cast<int>(context_.embedDim),
-                           xnorm.data(), context_.raw_q4_output.data(), 1.0f, context_.logits.data());
-        } else if (context_.tok_embeddings.size() == static_cast<size_t>(context_.vocabSize * context_.embedDim)) {
-            for (qsizetype v = 0; v < context_.vocabSize; ++v) {
-                const float* Ev = context_.tok_embeddings.data() + v * context_.embedDim;
-                float dot = 0.0f;
-                for (qsizetype d = 0; d < context_.embedDim; ++d) dot += xnorm[d] * Ev[d];
-                context_.logits[v] = dot;
-            }
+        layerNorm(x, xnorm, context_.ln_f_g, context_.ln_f_b, D);
+        // Prefer output.weight in its stored format (runtime-dispatched Q4_0/Q8_0/F32 GEMV)
+        if (context_.output_w.rows == context_.vocabSize && context_.output_w.cols == D) {
+            parallelGemv(context_.output_w, xnorm, context_.logits.data());
+        } else if (context_.tok_embeddings.size() == static_cast<size_t>(context_.vocabSize * D)) {
+            pool_->parallelFor(static_cast<int>(context_.vocabSize), 16, [&](int vBegin, int vEnd) {
+                for (int v = vBegin; v < vEnd; ++v) {
+                    const float* Ev = context_.tok_embeddings.data() + static_cast<size_t>(v) * D;
+                    float dot = 0.0f;
+                    for (qsizetype d = 0; d < D; ++d) dot += xnorm[d] * Ev[d];
+                    context_.logits[v] = dot;
+                }
+            });
         } else {
             // Use quantization-aware backend (ggml Q4_0/Q8_0 or fallback)
-            QuantBackend::instance().matmul(xnorm.data(), layerWeightMatrix, context_.logits.data(), 1, M, K);
+            QuantBackend::instance().matmul(xnorm, layerWeightMatrix, context_.logits.data(), 1, M, K);
         }
         std::copy(context_.logits.cbegin(), context_.logits.cend(), outputBuffer);
         
@@ -302,16 +324,10 @@ bool GGUFRunner::runInference(const QString& prompt, float* outputBuffer)
         lastTokenId = tokenId;
         emit tokenChunkGenerated(decodeToken(tokenId));
 
-        if (!embeddings.empty()) {
-            embeddings.back() = static_cast<float>(tokenId % 1024) / 1024.0f;
-        }
-
         if (context_.eosTokenId >= 0 && static_cast<size_t>(context_.eosTokenId) == tokenId) {
             break;
         }
 
-        // advance KV position
-        context_.kvLen = std::min<size_t>(context_.kvLen + 1, static_cast<size_t>(context_.maxTokens - 1));
         QCoreApplication::processEvents();
     }
 
@@ -496,6 +512,7 @@ void GGUFRunner::loadGGUFModel(const QString& filePath)
     }
 
     // Allocate KV-cache for multi-head GQA: [nLayers, nKVHeads, maxTokens, headDim]
+    // (runInference grows it to prompt + maxTokens positions)
     if (context_.nLayers > 0 && context_.nKVHeads > 0 && context_.headDim > 0) {
         size_t cacheSize = static_cast<size_t>(context_.nLayers) * 
                           static_cast<size_t>(context_.nKVHeads) * 
@@ -504,6 +521,7 @@ void GGUFRunner::loadGGUFModel(const QString& filePath)
         context_.keyCache.resize(cacheSize, 0.0f);
         context_.valueCache.resize(cacheSize, 0.0f);
         context_.kvLen = 0;
+        context_.kvCapacity = static_cast<size_t>(context_.maxTokens);
         qDebug() << "KV-cache allocated:" << (cacheSize * sizeof(float) * 2 / 1024 / 1024) << "MB"
                  << "(nLayers=" << context_.nLayers << "nKVHeads=" << context_.nKVHeads 
                  << "maxTokens=" << context_.maxTokens << "headDim=" << context_.headDim << ")";
@@ -555,19 +573,33 @@ bool GGUFRunner::prepareLLMInput(const QString& prompt, std::vector<float>& embe
         return false;
     }
 
-    embeddings.assign(static_cast<size_t>(context_.embedDim), 0.0f);
-
+    // Byte-level tokens: one embedding row per UTF-8 byte (an empty prompt
+    // still gets one zero row to start generation from)
     const QByteArray utf8 = prompt.toUtf8();
-    const int limit = std::min<int>(utf8.size(), static_cast<int>(context_.embedDim));
-    for (int i = 0; i < limit; ++i) {
-        const float v = static_cast<unsigned char>(utf8.at(i)) / 255.0f;
-        const float pos = static_cast<float>(i) / static_cast<float>(context_.embedDim);
-        embeddings[static_cast<size_t>(i)] = v + 0.01f * pos;
+    const size_t D = static_cast<size_t>(context_.embedDim);
+    const size_t nTokens = std::max<size_t>(1, static_cast<size_t>(utf8.size()));
+    embeddings.assign(nTokens * D, 0.0f);
+    for (int i = 0; i < utf8.size(); ++i) {
+        embedToken(static_cast<unsigned char>(utf8.at(i)), static_cast<size_t>(i), embeddings.data() + static_cast<size_t>(i) * D);
     }
 
     return true;
 }
 
+void GGUFRunner::embedToken(size_t tokenId, size_t pos, float* out) const
+{
+    const qsizetype D = context_.embedDim;
+    if (context_.vocabSize > 0 && context_.tok_embeddings.size() == static_cast<size_t>(context_.vocabSize * D)) {
+        const float* row = context_.tok_embeddings.data() + (tokenId % static_cast<size_t>(context_.vocabSize)) * static_cast<size_t>(D);
+        std::memcpy(out, row, static_cast<size_t>(D) * sizeof(float));
+        return;
+    }
+    // No embedding table: a fixed pattern per token plus a small position signal
+    std::fill(out, out + D, 0.0f);
+    out[tokenId % static_cast<size_t>(D)] = 1.0f;
+    out[pos % static_cast<size_t>(D)] += 0.01f;
+}
+
 void GGUFRunner::applySoftmax(float* buffer)
 {
     if (!buffer || context_.vocabSize == 0) {
@@ -738,132 +770,299 @@ void GGUFRunner::matmul(const float* A, const float* B, float* C, int N, int M,
     }
 }
 
+void GGUFRunner::parallelGemv(const QuantMatrix& W, const float* x, float* y)
+{
+    parallelGemm(W, x, y, 1);
+}
+
+void GGUFRunner::parallelGemm(const QuantMatrix& W, const float* A, float* C, int nTokens)
+{
+    // Split by output rows; 16-row chunks keep threads off each other's cache lines in C
+    const QuantBackend& qb = QuantBackend::instance();
+    pool_->parallelFor(W.rows, 16, [&](int rowBegin, int rowEnd) {
+        qb.gemmRows(W, A, C, nTokens, rowBegin, rowEnd);
+    });
+}
+
 void GGUFRunner::attentionForward(int layerIdx, const float* x, float* y)
 {
     const qsizetype D = context_.embedDim;
     const qsizetype nHead = context_.nHeads;
     const qsizetype nKVHead = context_.nKVHeads;
     const qsizetype headDim = context_.headDim;
+    const ScratchArena::Mark scratchMark = scratch_.mark();
     
     if (nHead == 0 || headDim == 0 || nKVHead == 0) {
-        // Fallback to single-head scalar path if metadata missing
-        std::vector<float> n(D), q(D), k(D), v(D), attnOut(D);
+        // Fallback to single-head path if metadata missing
+        float* n = scratch_.alloc(D);
+        float* q = scratch_.alloc(D);
+        float* k = scratch_.alloc(D);
+        float* v = scratch_.alloc(D);
+        float* attnOut = scratch_.alloc(D);
         const auto& L = context_.layers[static_cast<size_t>(layerIdx)];
-        layerNorm(x, n.data(), L.ln_1_g, L.ln_1_b, D);
-        matmul(n.data(), L.attn_q_w.data(), q.data(), 1, static_cast<int>(D), static_cast<int>(D));
-        matmul(x, L.attn_k_w.data(), k.data(), 1, static_cast<int>(D), static_cast<int>(D));
-        matmul(x, L.attn_v_w.data(), v.data(), 1, static_cast<int>(D), static_cast<int>(D));
+        layerNorm(x, n, L.ln_1_g, L.ln_1_b, D);
+        parallelGemv(L.attn_q_w, n, q);
+        parallelGemv(L.attn_k_w, x, k);
+        parallelGemv(L.attn_v_w, x, v);
         size_t pos = context_.kvLen;
         size_t stride = static_cast<size_t>(D);
         size_t layerStride = static_cast<size_t>(context_.maxTokens) * stride;
         float* Kc = context_.keyCache.data() + static_cast<size_t>(layerIdx) * layerStride + pos * stride;
         float* Vc = context_.valueCache.data() + static_cast<size_t>(layerIdx) * layerStride + pos * stride;
-        std::memcpy(Kc, k.data(), static_cast<size_t>(D) * sizeof(float));
-        std::memcpy(Vc, v.data(), static_cast<size_t>(D) * sizeof(float));
-        std::vector<float> weights(pos + 1);
+        std::memcpy(Kc, k, static_cast<size_t>(D) * sizeof(float));
+        std::memcpy(Vc, v, static_cast<size_t>(D) * sizeof(float));
+        const size_t ctxLen = pos + 1;
+        float* weights = scratch_.alloc(ctxLen);
         float scale = 1.0f / std::sqrt(static_cast<float>(D));
-        for (size_t t = 0; t <= pos; ++t) {
+        for (size_t t = 0; t < ctxLen; ++t) {
             const float* Kt = context_.keyCache.data() + static_cast<size_t>(layerIdx) * layerStride + t * stride;
             float dot = 0.0f; for (qsizetype i = 0; i < D; ++i) dot += q[i] * Kt[i];
             weights[t] = dot * scale;
         }
-        float maxw = weights[0]; for (size_t t = 1; t < weights.size(); ++t) if (weights[t] > maxw) maxw = weights[t];
-        float sumw = 0.0f; for (size_t t = 0; t < weights.size(); ++t) { weights[t] = std::exp(weights[t] - maxw); sumw += weights[t]; }
-        for (size_t t = 0; t < weights.size(); ++t) weights[t] /= (sumw + 1e-9f);
-        std::fill(attnOut.begin(), attnOut.end(), 0.0f);
-        for (size_t t = 0; t < weights.size(); ++t) {
+        float maxw = weights[0]; for (size_t t = 1; t < ctxLen; ++t) if (weights[t] > maxw) maxw = weights[t];
+        float sumw = 0.0f; for (size_t t = 0; t < ctxLen; ++t) { weights[t] = std::exp(weights[t] - maxw); sumw += weights[t]; }
+        for (size_t t = 0; t < ctxLen; ++t) weights[t] /= (sumw + 1e-9f);
+        std::fill(attnOut, attnOut + D, 0.0f);
+        for (size_t t = 0; t < ctxLen; ++t) {
             const float* Vt = context_.valueCache.data() + static_cast<size_t>(layerIdx) * layerStride + t * stride;
             float wt = weights[t]; for (qsizetype i = 0; i < D; ++i) attnOut[i] += wt * Vt[i];
         }
-        matmul(attnOut.data(), context_.layers[static_cast<size_t>(layerIdx)].attn_o_w.data(), y, 1, static_cast<int>(D), static_cast<int>(D));
+        parallelGemv(L.attn_o_w, attnOut, y);
+        scratch_.rewind(scratchMark);
         return;
     }
 
     // Multi-head attention with GQA and RoPE
-    std::vector<float> n(D), q(D), k(D), v(D);
+    float* n = scratch_.alloc(D);
+    float* q = scratch_.alloc(D);
+    float* k = scratch_.alloc(D);
+    float* v = scratch_.alloc(D);
     const auto& L = context_.layers[static_cast<size_t>(layerIdx)];
-    layerNorm(x, n.data(), L.ln_1_g, L.ln_1_b, D);
-    matmul(n.data(), L.attn_q_w.data(), q.data(), 1, static_cast<int>(D), static_cast<int>(D));
-    matmul(x, L.attn_k_w.data(), k.data(), 1, static_cast<int>(D), static_cast<int>(D));
-    matmul(x, L.attn_v_w.data(), v.data(), 1, static_cast<int>(D), static_cast<int>(D));
+    layerNorm(x, n, L.ln_1_g, L.ln_1_b, D);
+    parallelGemv(L.attn_q_w, n, q);
+    parallelGemv(L.attn_k_w, x, k);
+    parallelGemv(L.attn_v_w, x, v);
 
-    // Apply RoPE to Q and K (in-place rotation per head)
+    // RoPE angles depend only on the position: compute them once for all heads
     size_t pos = context_.kvLen;
-    auto rotate = [&](float* vec, int head, size_t position) {
-        float* h = vec + head * headDim;
-        for (int i = 0; i < headDim; i += 2) {
-            float fcr = std::cos(static_cast<float>(position) * context_.invFreq[i / 2]);
-            float fsi = std::sin(static_cast<float>(position) * context_.invFreq[i / 2]);
-            float v0 = h[i];
-            float v1 = h[i + 1];
-            h[i] = v0 * fcr - v1 * fsi;
-            h[i + 1] = v0 * fsi + v1 * fcr;
+    const qsizetype halfDim = headDim / 2;
+    float* ropeCos = scratch_.alloc(halfDim);
+    float* ropeSin = scratch_.alloc(halfDim);
+    for (qsizetype i = 0; i < halfDim; ++i) {
+        const float angle = static_cast<float>(pos) * context_.invFreq[i];
+        ropeCos[i] = std::cos(angle);
+        ropeSin[i] = std::sin(angle);
+    }
+    auto rotate = [&](float* h) {
+        for (qsizetype i = 0; i < halfDim; ++i) {
+            float v0 = h[2 * i];
+            float v1 = h[2 * i + 1];
+            h[2 * i] = v0 * ropeCos[i] - v1 * ropeSin[i];
+            h[2 * i + 1] = v0 * ropeSin[i] + v1 * ropeCos[i];
         }
     };
+    for (int h = 0; h < nKVHead; ++h) rotate(k + h * headDim);
 
-    for (int h = 0; h < nHead; ++h) rotate(q.data(), h, pos);
-    for (int h = 0; h < nKVHead; ++h) rotate(k.data(), h, pos);
-
-    // Store K/V in cache: [nLayers, nKVHeads, maxTokens, headDim]
-    size_t cacheHeadStride = static_cast<size_t>(context_.maxTokens) * static_cast<size_t>(headDim);
+    // Store K/V in cache: [nLayers, nKVHeads, kvCapacity, headDim]
+    size_t cacheHeadStride = context_.kvCapacity * static_cast<size_t>(headDim);
     size_t cacheLayerStride = static_cast<size_t>(nKVHead) * cacheHeadStride;
     for (int kvh = 0; kvh < nKVHead; ++kvh) {
         float* Kc = context_.keyCache.data() + layerIdx * cacheLayerStride + kvh * cacheHeadStride + pos * headDim;
         float* Vc = context_.valueCache.data() + layerIdx * cacheLayerStride + kvh * cacheHeadStride + pos * headDim;
-        std::memcpy(Kc, k.data() + kvh * headDim, static_cast<size_t>(headDim) * sizeof(float));
-        std::memcpy(Vc, v.data() + kvh * headDim, static_cast<size_t>(headDim) * sizeof(float));
-    }
+        std::memcpy(Kc, k + kvh * headDim, static_cast<size_t>(headDim) * sizeof(float));
+        std::memcpy(Vc, v + kvh * headDim, static_cast<size_t>(headDim) * sizeof(float));
+    }
+
+    // Heads are independent once this position's K/V are cached, so they are
+    // split across threads. Score rows are sized for the full context and
+    // padded to whole cache lines, keeping the arena layout fixed per token.
+    float* attnOut = scratch_.alloc(D);
+    const size_t ctxLen = pos + 1;
+    const size_t scoreStride = (context_.kvCapacity + 15) & ~size_t(15);
+    float* scores = scratch_.alloc(static_cast<size_t>(nHead) * scoreStride);
+    const float scale = 1.0f / std::sqrt(static_cast<float>(headDim));
+
+    pool_->parallelFor(static_cast<int>(nHead), 1, [&](int hBegin, int hEnd) {
+        for (int h = hBegin; h < hEnd; ++h) {
+            const int kvH = static_cast<int>(h * nKVHead / nHead);  // GQA mapping: multiple query heads share one KV head
+            float* qHead = q + h * headDim;
+            rotate(qHead);
+            const float* Kh = context_.keyCache.data() + layerIdx * cacheLayerStride + kvH * cacheHeadStride;
+            const float* Vh = context_.valueCache.data() + layerIdx * cacheLayerStride + kvH * cacheHeadStride;
+            float* logits = scores + static_cast<size_t>(h) * scoreStride;
+
+            // Compute attention scores for this head
+            for (size_t t = 0; t < ctxLen; ++t) {
+                const float* Kt = Kh + t * headDim;
+                float score = 0.0f;
+                for (qsizetype d = 0; d < headDim; ++d) score += qHead[d] * Kt[d];
+                logits[t] = score * scale;
+            }
 
-    // Multi-head attention loop with GQA mapping
-    std::vector<float> attnOut(D, 0.0f);
-    std::vector<float> logits(pos + 1);
-    float scale = 1.0f / std::sqrt(static_cast<float>(headDim));
+            // Softmax over logits
+            float maxScore = logits[0];
+            for (size_t t = 1; t < ctxLen; ++t) if (logits[t] > maxScore) maxScore = logits[t];
+            float sumExp = 0.0f;
+            for (size_t t = 0; t < ctxLen; ++t) { logits[t] = std::exp(logits[t] - maxScore); sumExp += logits[t]; }
+            const float invSum = 1.0f / (sumExp + 1e-9f);
+
+            // Accumulate weighted values position by position: each cached V
+            // row is read once, front to back, instead of striding per column
+            float* out = attnOut + h * headDim;
+            std::fill(out, out + headDim, 0.0f);
+            for (size_t t = 0; t < ctxLen; ++t) {
+                const float* Vt = Vh + t * headDim;
+                const float w = logits[t] * invSum;
+                for (qsizetype d = 0; d < headDim; ++d) out[d] += w * Vt[d];
+            }
+        }
+    });
 
-    for (int h = 0; h < nHead; ++h) {
-        int kvH = h * nKVHead / nHead;  // GQA mapping: multiple query heads share one KV head
-        float* qHead = q.data() + h * headDim;
+    // Output projection
+    parallelGemv(L.attn_o_w, attnOut, y);
+    scratch_.rewind(scratchMark);
+}
 
-        // Compute attention scores for this head
-        for (size_t t = 0; t <= pos; ++t) {
-            const float* Kt = context_.keyCache.data() + layerIdx * cacheLayerStride + kvH * cacheHeadStride + t * headDim;
-            float score = 0.0f;
-            for (int d = 0; d < headDim; ++d) score += qHead[d] * Kt[d];
-            logits[t] = score * scale;
+void GGUFRunner::mlpForward(int layerIdx, const float* x, float* y, int nTokens)
+{
+    const qsizetype D = context_.embedDim;
+    const auto& L = context_.layers[static_cast<size_t>(layerIdx)];
+    const ScratchArena::Mark scratchMark = scratch_.mark();
+    float* n = scratch_.alloc(static_cast<size_t>(nTokens) * D);
+    for (int t = 0; t < nTokens; ++t) layerNorm(x + t * D, n + t * D, L.ln_2_g, L.ln_2_b, D);
+    const int F = L.mlp_up_w.rows;  // FFN width as stored
+    float* up = scratch_.alloc(static_cast<size_t>(nTokens) * F);
+    float* gate = scratch_.alloc(static_cast<size_t>(nTokens) * F);
+    float* act = scratch_.alloc(static_cast<size_t>(nTokens) * F);
+
+    // up and gate read the same input: one job computes both row slices and
+    // applies SwiGLU while they are still in cache
+    const QuantBackend& qb = QuantBackend::instance();
+    pool_->parallelFor(F, 16, [&](int rowBegin, int rowEnd) {
+        qb.gemmRows(L.mlp_up_w, n, up, nTokens, rowBegin, rowEnd);
+        qb.gemmRows(L.mlp_gate_w, n, gate, nTokens, rowBegin, rowEnd);
+        for (int t = 0; t < nTokens; ++t) {
+            const size_t row = static_cast<size_t>(t) * F;
+            for (int i = rowBegin; i < rowEnd; ++i) { float s = 1.0f / (1.0f + std::exp(-gate[row + i])); act[row + i] = up[row + i] * (gate[row + i] * s); }
         }
+    });
+    parallelGemm(L.mlp_down_w, act, y, nTokens);
+    scratch_.rewind(scratchMark);
+}
 
-        // Softmax over logits
-        float maxScore = logits[0];
-        for (size_t t = 1; t <= pos; ++t) if (logits[t] > maxScore) maxScore = logits[t];
-        float sumExp = 0.0f;
-        for (size_t t = 0; t <= pos; ++t) { logits[t] = std::exp(logits[t] - maxScore); sumExp += logits[t]; }
-        for (size_t t = 0; t <= pos; ++t) logits[t] /= (sumExp + 1e-9f);
-
-        // Accumulate weighted values into output
-        for (int d = 0; d < headDim; ++d) {
-            float acc = 0.0f;
-            for (size_t t = 0; t <= pos; ++t) {
-                const float* Vt = context_.valueCache.data() + layerIdx * cacheLayerStride + kvH * cacheHeadStride + t * headDim;
-                acc += logits[t] * Vt[d];
+void GGUFRunner::prefill(const float* embeddings, int nTokens, float* lastHidden)
+{
+    const qsizetype D = context_.embedDim;
+    const bool batched = context_.nHeads > 0 && context_.nKVHeads > 0 && context_.headDim > 0;
+    const int chunk = batched ? kPrefillChunk : 1;
+
+    for (int c0 = 0; c0 < nTokens; c0 += chunk) {
+        const int n = std::min(chunk, nTokens - c0);
+        const ScratchArena::Mark scratchMark = scratch_.mark();
+        float* x = scratch_.alloc(static_cast<size_t>(n) * D);
+        float* y = scratch_.alloc(static_cast<size_t>(n) * D);
+        std::memcpy(x, embeddings + static_cast<size_t>(c0) * D, static_cast<size_t>(n) * D * sizeof(float));
+        for (qsizetype l = 0; l < context_.nLayers; ++l) {
+            if (batched) {
+                attentionPrefill(static_cast<int>(l), x, y, n);
+            } else {
+                attentionForward(static_cast<int>(l), x, y);
             }
-            attnOut[h * headDim + d] = acc;
+            for (qsizetype i = 0; i < n * D; ++i) x[i] += y[i]; // residual
+            mlpForward(static_cast<int>(l), x, y, n);
+            for (qsizetype i = 0; i < n * D; ++i) x[i] += y[i]; // residual
+        }
+        context_.kvLen += static_cast<size_t>(n);
+        if (c0 + n == nTokens) {
+            std::memcpy(lastHidden, x + static_cast<size_t>(n - 1) * D, static_cast<size_t>(D) * sizeof(float));
         }
+        scratch_.rewind(scratchMark);
     }
-
-    // Output projection
-    matmul(attnOut.data(), L.attn_o_w.data(), y, 1, static_cast<int>(D), static_cast<int>(D));
 }
 
-void GGUFRunner::mlpForward(int layerIdx, const float* x, float* y)
+void GGUFRunner::attentionPrefill(int layerIdx, const float* x, float* y, int nTokens)
 {
     const qsizetype D = context_.embedDim;
+    const qsizetype nHead = context_.nHeads;
+    const qsizetype nKVHead = context_.nKVHeads;
+    const qsizetype headDim = context_.headDim;
     const auto& L = context_.layers[static_cast<size_t>(layerIdx)];
-    std::vector<float> n(D);
-    layerNorm(x, n.data(), L.ln_2_g, L.ln_2_b, D);
-    std::vector<float> up(4 * D), gate(4 * D), act(4 * D);
-    matmul(n.data(), L.mlp_up_w.data(), up.data(), 1, static_cast<int>(D), static_cast<int>(4 * D));
-    matmul(n.data(), L.mlp_gate_w.data(), gate.data(), 1, static_cast<int>(D), static_cast<int>(4 * D));
-    for (qsizetype i = 0; i < 4 * D; ++i) { float s = 1.0f / (1.0f + std::exp(-gate[i])); act[i] = up[i] * (gate[i] * s); }
-    matmul(act.data(), L.mlp_down_w.data(), y, 1, static_cast<int>(4 * D), static_cast<int>(D));
+    const ScratchArena::Mark scratchMark = scratch_.mark();
+    const size_t rows = static_cast<size_t>(nTokens);
+    const int qDim = L.attn_q_w.rows;
+    const int kvDim = L.attn_k_w.rows;
+
+    // Projections for the whole chunk: each weight row is read once for all
+    // tokens. K/V project the residual input, exactly as in the decode path.
+    float* n = scratch_.alloc(rows * D);
+    float* q = scratch_.alloc(rows * qDim);
+    float* k = scratch_.alloc(rows * kvDim);
+    float* v = scratch_.alloc(rows * kvDim);
+    float* attnOut = scratch_.alloc(rows * qDim);
+    for (int t = 0; t < nTokens; ++t) layerNorm(x + t * D, n + t * D, L.ln_1_g, L.ln_1_b, D);
+    parallelGemm(L.attn_q_w, n, q, nTokens);
+    parallelGemm(L.attn_k_w, x, k, nTokens);
+    parallelGemm(L.attn_v_w, x, v, nTokens);
+
+    // RoPE at each token's absolute position, then append K/V to the cache
+    const size_t pos0 = context_.kvLen;
+    const qsizetype halfDim = headDim / 2;
+    const size_t cacheHeadStride = context_.kvCapacity * static_cast<size_t>(headDim);
+    const size_t cacheLayerStride = static_cast<size_t>(nKVHead) * cacheHeadStride;
+    float* Kl = context_.keyCache.data() + layerIdx * cacheLayerStride;
+    float* Vl = context_.valueCache.data() + layerIdx * cacheLayerStride;
+    pool_->parallelFor(nTokens, 1, [&](int tBegin, int tEnd) {
+        for (int t = tBegin; t < tEnd; ++t) {
+            const size_t pos = pos0 + static_cast<size_t>(t);
+            float* qt = q + static_cast<size_t>(t) * qDim;
+            float* kt = k + static_cast<size_t>(t) * kvDim;
+            for (qsizetype i = 0; i < halfDim; ++i) {
+                const float angle = static_cast<float>(pos) * context_.invFreq[i];
+                const float c = std::cos(angle);
+                const float s = std::sin(angle);
+                auto rotatePair = [&](float* h) {
+                    const float v0 = h[2 * i];
+                    const float v1 = h[2 * i + 1];
+                    h[2 * i] = v0 * c - v1 * s;
+                    h[2 * i + 1] = v0 * s + v1 * c;
+                };
+                for (qsizetype h = 0; h < nHead; ++h) rotatePair(qt + h * headDim);
+                for (qsizetype h = 0; h < nKVHead; ++h) rotatePair(kt + h * headDim);
+            }
+            for (qsizetype kvh = 0; kvh < nKVHead; ++kvh) {
+                const size_t dst = kvh * cacheHeadStride + pos * static_cast<size_t>(headDim);
+                std::memcpy(Kl + dst, kt + kvh * headDim, static_cast<size_t>(headDim) * sizeof(float));
+                std::memcpy(Vl + dst, v + static_cast<size_t>(t) * kvDim + kvh * headDim, static_cast<size_t>(headDim) * sizeof(float));
+            }
+        }
+    });
+
+    // Causal flash attention of the chunk over everything cached so far:
+    // (head x query block) items on the decode pool, no score matrix
+    flash_attn_params p = {};
+    p.q = q;
+    p.k = Kl;
+    p.v = Vl;
+    p.o = attnOut;
+    p.n_q = nTokens;
+    p.n_kv = static_cast<int>(pos0) + nTokens;
+    p.n_head = static_cast<int>(nHead);
+    p.n_kv_head = static_cast<int>(nKVHead);
+    p.head_dim = static_cast<int>(headDim);
+    p.q_token_stride = qDim;
+    p.q_head_stride = headDim;
+    p.kv_token_stride = headDim;
+    p.kv_head_stride = static_cast<ptrdiff_t>(cacheHeadStride);
+    p.o_token_stride = qDim;
+    p.o_head_stride = headDim;
+    p.scale = 1.0f / std::sqrt(static_cast<float>(headDim));
+    p.causal = 1;
+    pool_->parallelFor(flash_attn_work_items(&p), 1, [&](int begin, int end) {
+        flash_attn_run(&p, begin, end);
+    });
+
+    parallelGemm(L.attn_o_w, attnOut, y, nTokens);
+    scratch_.rewind(scratchMark);
 }
 
 void GGUFRunner::fallback_matrix_multiply(float* A, float* B, float* C, int N, int M, int K)
@@ -933,11 +1132,6 @@ bool GGUFRunner::loadTensor(QFile& file, const QString& name, std::vector<float>
         const float* ptr = reinterpret_cast<const float*>(rawData.constData());
         std::copy(ptr, ptr + totalElements, weights.begin());
     } else if (desc.type == GgmlType::Q4_0) {
-        // Keep raw bytes for output.weight to enable runtime-dispatched GEMM
-        if (name == QLatin1String("output.weight")) {
-            context_.raw_q4_output.assign(reinterpret_cast<const uint8_t*>(rawData.constData()),
-                                          reinterpret_cast<const uint8_t*>(rawData.constData()) + rawData.size());
-        }
         dequantizeRowQ4_0_scalar(rawData.constData(), weights.data(), totalElements);
     } else if (desc.type == GgmlType::Q8_0) {
         dequantizeRowQ8_0_scalar(rawData.constData(), weights.data(), totalElements);
@@ -945,6 +1139,54 @@ bool GGUFRunner::loadTensor(QFile& file, const QString& name, std::vector<float>
     return true;
 }
 
+bool GGUFRunner::loadTensor(QFile& file, const QString& name, QuantMatrix& weights)
+{
+    if (!context_.tensorTable.contains(name)) {
+        qWarning() << "Tensor not found in table:" << name;
+        return false;
+    }
+    const auto& desc = context_.tensorTable[name];
+    
+    // GGUF dims are innermost first: dims[0] inputs per row, the rest rows
+    const int cols = desc.dims.empty() ? 0 : static_cast<int>(desc.dims[0]);
+    int rows = 1;
+    for (size_t d = 1; d < desc.dims.size(); ++d) rows *= static_cast<int>(desc.dims[d]);
+    
+    // Q4_0/Q8_0 stay in block format: the backend's kernels read them directly
+    if (desc.type == GgmlType::Q4_0 || desc.type == GgmlType::Q8_0) {
+        const quint64 numBytes = static_cast<quint64>(rows) * (cols / 32) * ggmlTypeSize(desc.type);
+        QByteArray rawData = readTensorData(file, desc.offset, numBytes);
+        if (static_cast<quint64>(rawData.size()) != numBytes) return false;
+        const QuantMode mode = desc.type == GgmlType::Q4_0 ? QuantMode::Q4_0 : QuantMode::Q8_0;
+        return QuantBackend::instance().loadBlocks(mode, rawData.constData(), rows, cols, weights);
+    }
+    
+    // F32/F16 are packed in the backend's current mode (Q4_0/Q8_0 shrink them)
+    std::vector<float> dense;
+    if (!readTensorFloat32(file, static_cast<qint64>(desc.offset), static_cast<qint64>(rows) * cols, dense)) {
+        return false;
+    }
+    return QuantBackend::instance().quantizeMatrix(dense.data(), rows, cols, weights);
+}
+
+bool GGUFRunner::loadLayerTensors(QFile& file, int layerIdx)
+{
+    auto& L = context_.layers[static_cast<size_t>(layerIdx)];
+    const QString prefix = QStringLiteral("blk.%1.").arg(layerIdx);
+    
+    // Norm weights stay F32; missing ones fall back to identity in layerNorm
+    loadTensor(file, prefix + "attn_norm.weight", L.ln_1_g);
+    loadTensor(file, prefix + "ffn_norm.weight", L.ln_2_g);
+    
+    return loadTensor(file, prefix + "attn_q.weight", L.attn_q_w) &&
+           loadTensor(file, prefix + "attn_k.weight", L.attn_k_w) &&
+           loadTensor(file, prefix + "attn_v.weight", L.attn_v_w) &&
+           loadTensor(file, prefix + "attn_output.weight", L.attn_o_w) &&
+           loadTensor(file, prefix + "ffn_up.weight", L.mlp_up_w) &&
+           loadTensor(file, prefix + "ffn_gate.weight", L.mlp_gate_w) &&
+           loadTensor(file, prefix + "ffn_down.weight", L.mlp_down_w);
+}
+
 bool GGUFRunner::parseGgufTensors(QFile& file)
 {
     // Load essential tensors using table-driven approach
@@ -961,6 +1203,17 @@ bool GGUFRunner::parseGgufTensors(QFile& file)
         qWarning() << "Warning: output.weight not found";
     }
     
+    // Transformer blocks; the forward pass only runs the layers that loaded
+    context_.layers.assign(static_cast<size_t>(context_.nLayers), ModelContext::Layer{});
+    for (qsizetype l = 0; l < context_.nLayers; ++l) {
+        if (!loadLayerTensors(file, static_cast<int>(l))) {
+            qWarning() << "Layer" << l << "weights incomplete; running" << l << "of" << context_.nLayers << "layers";
+            context_.nLayers = l;
+            context_.layers.resize(static_cast<size_t>(l));
+            break;
+        }
+    }
+    
     return true;
 }
 
@@ -1072,8 +1325,10 @@ bool GGUFRunner::setQuantizationMode(QuantMode mode) {
                      mode == QuantMode::F32 ? "F32 (full precision)" : "FALLBACK");
         qDebug() << "[GGUFRunner] Estimated RAM reduction:"
                  << QString::number(QuantBackend::instance().getCompressionRatio(), 'f', 1) << "x";
+        qDebug() << "[GGUFRunner] Applies to F32/F16 weights loaded from now on; Q4_0/Q8_0 tensors keep their format."
+                 << "Kernels:" << QuantBackend::kernelName(QuantBackend::instance().currentKernel());
     } else {
-        qWarning() << "[GGUFRunner] Failed to set quantization mode - ggml not available";
+        qWarning() << "[GGUFRunner] Failed to set quantization mode";
     }
     return success;
 }
@@ -1086,3 +1341,67 @@ float GGUFRunner::getCompressionRatio() const {
     return QuantBackend::instance().getCompressionRatio();
 }
 
+// ============================================================
+// THREADING
+// ============================================================
+
+void GGUFRunner::reserveKV(size_t positions) {
+    if (positions <= context_.kvCapacity || context_.nLayers <= 0 || context_.nKVHeads <= 0 || context_.headDim <= 0) {
+        return;
+    }
+    // Every (layer, KV head) plane moves to the new stride, keeping its first kvLen rows
+    const size_t planes = static_cast<size_t>(context_.nLayers) * static_cast<size_t>(context_.nKVHeads);
+    const size_t headDim = static_cast<size_t>(context_.headDim);
+    std::vector<float> keys(planes * positions * headDim, 0.0f);
+    std::vector<float> values(planes * positions * headDim, 0.0f);
+    const size_t keep = std::min(context_.kvLen, context_.kvCapacity) * headDim;
+    for (size_t plane = 0; plane < planes && keep > 0; ++plane) {
+        std::memcpy(keys.data() + plane * positions * headDim, context_.keyCache.data() + plane * context_.kvCapacity * headDim, keep * sizeof(float));
+        std::memcpy(values.data() + plane * positions * headDim, context_.valueCache.data() + plane * context_.kvCapacity * headDim, keep * sizeof(float));
+    }
+    context_.keyCache.swap(keys);
+    context_.valueCache.swap(values);
+    context_.kvCapacity = positions;
+}
+
+void GGUFRunner::setThreadCount(int threads) {
+    pool_ = std::make_unique<WorkerPool>(threads);
+    qDebug() << "[GGUFRunner] Decode threads:" << pool_->threadCount();
+}
+
+float* GGUFRunner::ScratchArena::alloc(size_t count) {
+    // Whole cache lines per request so threads writing neighbours never share one
+    const size_t padded = (count + 15) & ~size_t(15);
+    auto align64 = [](float* p) {
+        return reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(p) + 63) & ~uintptr_t(63));
+    };
+    // block_ carries one spare line so its aligned start stays in range
+    const size_t capacity = block_.size() >= 16 ? block_.size() - 16 : 0;
+    float* p = nullptr;
+    if (used_ + padded <= capacity) {
+        p = align64(block_.data()) + used_;
+        used_ += padded;
+    } else {
+        overflow_.emplace_back(padded + 16);
+        p = align64(overflow_.back().data());
+        overflowUsed_ += padded;
+    }
+    peak_ = std::max(peak_, used_ + overflowUsed_);
+    return p;
+}
+
+void GGUFRunner::ScratchArena::rewind(const Mark& mark) {
+    used_ = mark.used;
+    overflowUsed_ = mark.overflowUsed;
+    overflow_.resize(std::min(overflow_.size(), mark.overflowCount));
+}
+
+void GGUFRunner::ScratchArena::reset() {
+    // Size block_ to what was live at once, not to everything ever handed out
+    if (!overflow_.empty() || peak_ + 16 > block_.size()) {
+        block_.assign(peak_ + 16, 0.0f);
+    }
+    overflow_.clear();
+    overflowUsed_ = 0;
+    used_ = 0;
+}
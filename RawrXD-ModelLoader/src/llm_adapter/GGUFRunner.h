@@ -8,9 +8,11 @@
 #include <QtGlobal>
 
 #include <cstddef>
+#include <memory>
 #include <vector>
 
 #include "QuantBackend.h"  // Quantization backend switcher
+#include "WorkerPool.h"    // Decode threads
 
 // GGML tensor types
 enum class GgmlType : quint32 {
@@ -24,18 +26,6 @@ enum class GgmlType : quint32 {
     Q8_1 = 9
 };
 
-// Q4_0 block: 32 weights in 16 bytes + 1 float16 delta
-struct BlockQ4_0 {
-    quint16 d;      // delta (float16)
-    quint8 qs[16];  // 32 nibbles (2 per byte)
-};
-
-// Q8_0 block: 32 weights in 32 bytes + 1 float16 delta
-struct BlockQ8_0 {
-    quint16 d;      // delta (float16)
-    qint8 qs[32];   // 32 signed bytes
-};
-
 /**
  * @brief GGUFRunner manages the high-performance execution of GGUF language models.
  */
@@ -67,6 +57,10 @@ public:
     QuantMode currentQuantMode() const;
     float getCompressionRatio() const;
     
+    // Decode threading (default: one thread per physical core)
+    void setThreadCount(int threads);
+    int threadCount() const { return pool_->threadCount(); }
+    
     // Model info getters
     QString modelPath() const { return context_.modelPath; }
     QString modelName() const { return context_.modelName; }
@@ -144,34 +138,34 @@ private:
         // GGUF tensors (essential weights)
         std::vector<float> tok_embeddings;           // [vocabSize, embedDim]
         std::vector<float> output_norm_w;            // output norm weight
-        std::vector<float> output_w;                 // output projection weight
-        std::vector<uint8_t> raw_q4_output;          // raw Q4_0 bytes for output.weight (optional)
-        std::vector<int8_t> raw_q8_output;           // raw Q8_0 bytes for output.weight (optional)
+        QuantMatrix output_w;                        // output projection [vocabSize x embedDim]
         std::vector<float> ln_f_g;                   // final layernorm gamma [embedDim]
         std::vector<float> ln_f_b;                   // final layernorm beta [embedDim]
 
+        // Projections are QuantMatrix: Q4_0/Q8_0 tensors stay in block format
         struct Layer {
-            // Attention projections: [embedDim, embedDim]
-            std::vector<float> attn_q_w;
-            std::vector<float> attn_k_w;
-            std::vector<float> attn_v_w;
-            std::vector<float> attn_o_w;
+            // Attention projections: [embedDim, embedDim] (K/V rows shrink with GQA)
+            QuantMatrix attn_q_w;
+            QuantMatrix attn_k_w;
+            QuantMatrix attn_v_w;
+            QuantMatrix attn_o_w;
             // LayerNorm params
             std::vector<float> ln_1_g;
             std::vector<float> ln_1_b;
             std::vector<float> ln_2_g;
             std::vector<float> ln_2_b;
-            // MLP (SwiGLU): up, gate, down: [embedDim, 4*embedDim] and [4*embedDim, embedDim]
-            std::vector<float> mlp_up_w;
-            std::vector<float> mlp_gate_w;
-            std::vector<float> mlp_down_w;
+            // MLP (SwiGLU): up, gate: [ffnDim x embedDim], down: [embedDim x ffnDim]
+            QuantMatrix mlp_up_w;
+            QuantMatrix mlp_gate_w;
+            QuantMatrix mlp_down_w;
         };
         std::vector<Layer> layers;
 
         // KV-cache: per layer K/V for past tokens (multi-head GQA)
-        std::vector<float> keyCache;   // [nLayers, nKVHeads, maxTokens, headDim]
-        std::vector<float> valueCache; // [nLayers, nKVHeads, maxTokens, headDim]
+        std::vector<float> keyCache;   // [nLayers, nKVHeads, kvCapacity, headDim]
+        std::vector<float> valueCache; // [nLayers, nKVHeads, kvCapacity, headDim]
         size_t kvLen{0};
+        size_t kvCapacity{0};          // Positions per (layer, KV head) plane
 
         // Tensor directory
         struct TensorDesc { QString name; std::vector<uint32_t> dims; GgmlType type; uint64_t offset; };
@@ -183,6 +177,8 @@ private:
     void loadVocabulary(const QString& vocabPath);
     float* getLayerWeights();
     bool prepareLLMInput(const QString& prompt, std::vector<float>& embeddings);
+    void embedToken(size_t tokenId, size_t pos, float* out) const;
+    void reserveKV(size_t positions);
     void applySoftmax(float* buffer);
     void applyTemperature(float* buffer, float temperature);
     size_t sampleNextToken(float* buffer);
@@ -197,15 +193,50 @@ private:
     bool parseGgufTensorTable(class QFile& file);
     bool readTensorFloat32(class QFile& file, qint64 offset, qint64 count, std::vector<float>& out);
     bool loadTensor(class QFile& file, const QString& name, std::vector<float>& weights);
+    bool loadTensor(class QFile& file, const QString& name, QuantMatrix& weights);
+    bool loadLayerTensors(class QFile& file, int layerIdx);
     size_t ggmlTypeSize(GgmlType type);
     QByteArray readTensorData(class QFile& file, quint64 offset, quint64 numBytes);
 
-    // Transformer forward (scalar)
-private:
+    // Bump allocator for decode buffers. Layers rewind to a mark on exit so
+    // every layer reuses the same (cache-hot) floats; requests that do not fit
+    // go to overflow blocks until reset() grows the main block to the peak,
+    // so after the first token decode runs without heap allocations.
+    class ScratchArena {
+    public:
+        struct Mark {
+            size_t used;
+            size_t overflowCount;
+            size_t overflowUsed;
+        };
+
+        float* alloc(size_t count);  // 64-byte aligned, valid until rewound past or reset()
+        Mark mark() const { return {used_, overflow_.size(), overflowUsed_}; }
+        void rewind(const Mark& mark);  // frees overflow blocks allocated after mark
+        void reset();
+    private:
+        std::vector<float> block_;
+        std::vector<std::vector<float>> overflow_;
+        size_t used_{0};          // floats handed out from block_
+        size_t overflowUsed_{0};  // live floats in overflow_
+        size_t peak_{0};          // high-water mark of live used_ + overflowUsed_
+    };
+
+    // Transformer forward (threaded over output rows / heads)
+    void parallelGemv(const QuantMatrix& W, const float* x, float* y);
+    void parallelGemm(const QuantMatrix& W, const float* A, float* C, int nTokens);
     void layerNorm(const float* x, float* y, const std::vector<float>& gamma, const std::vector<float>& beta, qsizetype dim);
     void matmul(const float* A, const float* B, float* C, int N, int M, int K);
     void attentionForward(int layerIdx, const float* x, float* y);
-    void mlpForward(int layerIdx, const float* x, float* y);
+    void mlpForward(int layerIdx, const float* x, float* y, int nTokens = 1);
+
+    // Batched prompt pass: rows of nTokens embeddings go through every layer
+    // together (weights read once per chunk, causal flash attention over the
+    // cache), leaving the last position's hidden state in lastHidden
+    void prefill(const float* embeddings, int nTokens, float* lastHidden);
+    void attentionPrefill(int layerIdx, const float* x, float* y, int nTokens);
 
     ModelContext context_;
+    std::unique_ptr<WorkerPool> pool_;
+    ScratchArena scratch_;
 };
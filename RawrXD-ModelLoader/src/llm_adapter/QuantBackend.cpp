@@ -2,12 +2,332 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <stdexcept>
 
-// Conditional ggml inclusion
-#ifdef HAVE_GGML
-#include <ggml.h>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define QUANT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
 #endif
+#endif
+
+// SIMD kernels are compiled per function so the rest of the file (and the
+// build) needs no -mavx2; MSVC accepts the intrinsics without flags
+#if defined(QUANT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define QUANT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define QUANT_TARGET(isa)
+#endif
+#define QUANT_AVX2 QUANT_TARGET("avx2,fma,f16c")
+#define QUANT_AVX512 QUANT_TARGET("avx512f,avx512bw,avx2,fma,f16c")
+
+namespace {
+
+// Activations quantized per 32-element block; the scale stays F32 since it
+// is computed once per token rather than stored
+struct ActBlock {
+    float d;
+    int8_t qs[32];
+};
+
+using RowDot = float (*)(const void* row, const void* x, int n);
+
+inline uint32_t floatBits(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+inline float bitsFloat(uint32_t u) {
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// IEEE half conversions (round to nearest even), branch-light
+float fp16ToFp32(uint16_t h) {
+    const uint32_t w = uint32_t(h) << 16;
+    const uint32_t sign = w & 0x80000000u;
+    const uint32_t twoW = w + w;
+    const float normalized = bitsFloat((twoW >> 4) + (0xE0u << 23)) * 0x1.0p-112f;
+    const float denormalized = bitsFloat((twoW >> 17) | (126u << 23)) - 0.5f;
+    const uint32_t bits = twoW < (1u << 27) ? floatBits(denormalized) : floatBits(normalized);
+    return bitsFloat(sign | bits);
+}
+
+uint16_t fp32ToFp16(float f) {
+    float base = (std::fabs(f) * 0x1.0p+112f) * 0x1.0p-110f;
+    const uint32_t w = floatBits(f);
+    const uint32_t shl1W = w + w;
+    const uint32_t sign = w & 0x80000000u;
+    uint32_t bias = shl1W & 0xFF000000u;
+    if (bias < 0x71000000u) bias = 0x71000000u;
+    base = bitsFloat((bias >> 1) + 0x07800000u) + base;
+    const uint32_t bits = floatBits(base);
+    const uint32_t nonsign = ((bits >> 13) & 0x00007C00u) + (bits & 0x00000FFFu);
+    return uint16_t((sign >> 16) | (shl1W > 0xFF000000u ? 0x7E00u : nonsign));
+}
+
+void quantizeBlockQ4_0(const float* x, BlockQ4_0& b) {
+    // Signed extreme maps to -8 so the full [-8, 7] range is used
+    float amax = 0.0f;
+    float max = 0.0f;
+    for (int j = 0; j < kQuantBlockSize; ++j) {
+        if (std::fabs(x[j]) > amax) {
+            amax = std::fabs(x[j]);
+            max = x[j];
+        }
+    }
+    const float d = max / -8.0f;
+    const float id = d != 0.0f ? 1.0f / d : 0.0f;
+    b.d = fp32ToFp16(d);
+    for (int j = 0; j < 16; ++j) {
+        const int lo = std::min(15, int(x[j] * id + 8.5f));
+        const int hi = std::min(15, int(x[j + 16] * id + 8.5f));
+        b.qs[j] = uint8_t(lo | (hi << 4));
+    }
+}
+
+void quantizeBlockQ8_0(const float* x, BlockQ8_0& b) {
+    float amax = 0.0f;
+    for (int j = 0; j < kQuantBlockSize; ++j) {
+        amax = std::max(amax, std::fabs(x[j]));
+    }
+    const float d = amax / 127.0f;
+    const float id = d != 0.0f ? 1.0f / d : 0.0f;
+    b.d = fp32ToFp16(d);
+    for (int j = 0; j < kQuantBlockSize; ++j) {
+        b.qs[j] = int8_t(std::lround(x[j] * id));
+    }
+}
+
+void quantizeActivations(const float* x, int nb, ActBlock* out) {
+    for (int b = 0; b < nb; ++b) {
+        const float* xb = x + b * kQuantBlockSize;
+        float amax = 0.0f;
+        for (int j = 0; j < kQuantBlockSize; ++j) {
+            amax = std::max(amax, std::fabs(xb[j]));
+        }
+        const float d = amax / 127.0f;
+        const float id = d != 0.0f ? 1.0f / d : 0.0f;
+        out[b].d = d;
+        for (int j = 0; j < kQuantBlockSize; ++j) {
+            out[b].qs[j] = int8_t(std::lround(xb[j] * id));
+        }
+    }
+}
+
+// ---- Scalar kernels ----
+
+float dotQ4_0Scalar(const void* row, const void* x, int nb) {
+    const BlockQ4_0* w = static_cast<const BlockQ4_0*>(row);
+    const ActBlock* a = static_cast<const ActBlock*>(x);
+    float sum = 0.0f;
+    for (int b = 0; b < nb; ++b) {
+        int isum = 0;
+        for (int j = 0; j < 16; ++j) {
+            isum += ((w[b].qs[j] & 0x0F) - 8) * a[b].qs[j];
+            isum += ((w[b].qs[j] >> 4) - 8) * a[b].qs[j + 16];
+        }
+        sum += fp16ToFp32(w[b].d) * a[b].d * float(isum);
+    }
+    return sum;
+}
+
+float dotQ8_0Scalar(const void* row, const void* x, int nb) {
+    const BlockQ8_0* w = static_cast<const BlockQ8_0*>(row);
+    const ActBlock* a = static_cast<const ActBlock*>(x);
+    float sum = 0.0f;
+    for (int b = 0; b < nb; ++b) {
+        int isum = 0;
+        for (int j = 0; j < kQuantBlockSize; ++j) {
+            isum += w[b].qs[j] * a[b].qs[j];
+        }
+        sum += fp16ToFp32(w[b].d) * a[b].d * float(isum);
+    }
+    return sum;
+}
+
+float dotF32Scalar(const void* row, const void* x, int n) {
+    const float* w = static_cast<const float*>(row);
+    const float* a = static_cast<const float*>(x);
+    float sum = 0.0f;
+    for (int i = 0; i < n; ++i) {
+        sum += w[i] * a[i];
+    }
+    return sum;
+}
+
+#ifdef QUANT_X86
+
+// ---- AVX2 kernels ----
+
+QUANT_AVX2 inline float hsum256(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+// Signed int8 dot product in 32-bit lanes: maddubs needs an unsigned left
+// operand, so move a's sign onto b (|a| <= 127 keeps the int16 sums exact)
+QUANT_AVX2 inline __m256 dotI8Avx2(__m256i a, __m256i b) {
+    const __m256i dot16 = _mm256_maddubs_epi16(_mm256_sign_epi8(a, a), _mm256_sign_epi8(b, a));
+    return _mm256_cvtepi32_ps(_mm256_madd_epi16(dot16, _mm256_set1_epi16(1)));
+}
+
+// 32 nibbles to bytes in [-8, 7], in element order
+QUANT_AVX2 inline __m256i unpackQ4Avx2(const uint8_t* qs) {
+    const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(qs));
+    const __m256i both = _mm256_set_m128i(_mm_srli_epi16(packed, 4), packed);
+    return _mm256_sub_epi8(_mm256_and_si256(both, _mm256_set1_epi8(0x0F)), _mm256_set1_epi8(8));
+}
+
+QUANT_AVX2 float dotQ4_0Avx2(const void* row, const void* x, int nb) {
+    const BlockQ4_0* w = static_cast<const BlockQ4_0*>(row);
+    const ActBlock* a = static_cast<const ActBlock*>(x);
+    __m256 acc = _mm256_setzero_ps();
+    for (int b = 0; b < nb; ++b) {
+        const __m256 d = _mm256_set1_ps(_cvtsh_ss(w[b].d) * a[b].d);
+        const __m256i qa = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a[b].qs));
+        acc = _mm256_fmadd_ps(d, dotI8Avx2(unpackQ4Avx2(w[b].qs), qa), acc);
+    }
+    return hsum256(acc);
+}
+
+QUANT_AVX2 float dotQ8_0Avx2(const void* row, const void* x, int nb) {
+    const BlockQ8_0* w = static_cast<const BlockQ8_0*>(row);
+    const ActBlock* a = static_cast<const ActBlock*>(x);
+    __m256 acc = _mm256_setzero_ps();
+    for (int b = 0; b < nb; ++b) {
+        const __m256 d = _mm256_set1_ps(_cvtsh_ss(w[b].d) * a[b].d);
+        const __m256i qw = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w[b].qs));
+        const __m256i qa = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a[b].qs));
+        acc = _mm256_fmadd_ps(d, dotI8Avx2(qw, qa), acc);
+    }
+    return hsum256(acc);
+}
+
+QUANT_AVX2 float dotF32Avx2(const void* row, const void* x, int n) {
+    const float* w = static_cast<const float*>(row);
+    const float* a = static_cast<const float*>(x);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(w + i), _mm256_loadu_ps(a + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(w + i + 8), _mm256_loadu_ps(a + i + 8), acc1);
+    }
+    float sum = hsum256(_mm256_add_ps(acc0, acc1));
+    for (; i < n; ++i) {
+        sum += w[i] * a[i];
+    }
+    return sum;
+}
+
+// ---- AVX-512 kernels (two blocks per 512-bit register) ----
+
+QUANT_AVX512 inline __m512 dotI8Avx512(__m512i a, __m512i b) {
+    // No 512-bit sign_epi8: negate b where a is negative instead
+    const __m512i sb = _mm512_mask_sub_epi8(b, _mm512_movepi8_mask(a), _mm512_setzero_si512(), b);
+    const __m512i dot16 = _mm512_maddubs_epi16(_mm512_abs_epi8(a), sb);
+    return _mm512_cvtepi32_ps(_mm512_madd_epi16(dot16, _mm512_set1_epi16(1)));
+}
+
+QUANT_AVX512 inline __m512i join256(__m256i lo, __m256i hi) {
+    return _mm512_inserti64x4(_mm512_castsi256_si512(lo), hi, 1);
+}
+
+QUANT_AVX512 inline __m512 pairScale(float d0, float d1) {
+    return _mm512_mask_blend_ps(0xFF00, _mm512_set1_ps(d0), _mm512_set1_ps(d1));
+}
+
+QUANT_AVX512 float dotQ4_0Avx512(const void* row, const void* x, int nb) {
+    const BlockQ4_0* w = static_cast<const BlockQ4_0*>(row);
+    const ActBlock* a = static_cast<const ActBlock*>(x);
+    __m512 acc = _mm512_setzero_ps();
+    int b = 0;
+    for (; b + 2 <= nb; b += 2) {
+        const __m512i qw = join256(unpackQ4Avx2(w[b].qs), unpackQ4Avx2(w[b + 1].qs));
+        const __m512i qa = join256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a[b].qs)),
+                                   _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a[b + 1].qs)));
+        const __m512 d = pairScale(_cvtsh_ss(w[b].d) * a[b].d, _cvtsh_ss(w[b + 1].d) * a[b + 1].d);
+        acc = _mm512_fmadd_ps(d, dotI8Avx512(qw, qa), acc);
+    }
+    float sum = _mm512_reduce_add_ps(acc);
+    if (b < nb) {
+        sum += dotQ4_0Avx2(w + b, a + b, 1);
+    }
+    return sum;
+}
+
+QUANT_AVX512 float dotQ8_0Avx512(const void* row, const void* x, int nb) {
+    const BlockQ8_0* w = static_cast<const BlockQ8_0*>(row);
+    const ActBlock* a = static_cast<const ActBlock*>(x);
+    __m512 acc = _mm512_setzero_ps();
+    int b = 0;
+    for (; b + 2 <= nb; b += 2) {
+        const __m512i qw = join256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(w[b].qs)),
+                                   _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w[b + 1].qs)));
+        const __m512i qa = join256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a[b].qs)),
+                                   _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a[b + 1].qs)));
+        const __m512 d = pairScale(_cvtsh_ss(w[b].d) * a[b].d, _cvtsh_ss(w[b + 1].d) * a[b + 1].d);
+        acc = _mm512_fmadd_ps(d, dotI8Avx512(qw, qa), acc);
+    }
+    float sum = _mm512_reduce_add_ps(acc);
+    if (b < nb) {
+        sum += dotQ8_0Avx2(w + b, a + b, 1);
+    }
+    return sum;
+}
+
+QUANT_AVX512 float dotF32Avx512(const void* row, const void* x, int n) {
+    const float* w = static_cast<const float*>(row);
+    const float* a = static_cast<const float*>(x);
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(w + i), _mm512_loadu_ps(a + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(w + i + 16), _mm512_loadu_ps(a + i + 16), acc1);
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    for (; i < n; ++i) {
+        sum += w[i] * a[i];
+    }
+    return sum;
+}
+
+#endif  // QUANT_X86
+
+RowDot selectDot(QuantMode mode, QuantKernel kernel) {
+#ifdef QUANT_X86
+    if (kernel == QuantKernel::AVX512) {
+        return mode == QuantMode::Q4_0 ? dotQ4_0Avx512 : mode == QuantMode::Q8_0 ? dotQ8_0Avx512 : dotF32Avx512;
+    }
+    if (kernel == QuantKernel::AVX2) {
+        return mode == QuantMode::Q4_0 ? dotQ4_0Avx2 : mode == QuantMode::Q8_0 ? dotQ8_0Avx2 : dotF32Avx2;
+    }
+#else
+    (void)kernel;
+#endif
+    return mode == QuantMode::Q4_0 ? dotQ4_0Scalar : mode == QuantMode::Q8_0 ? dotQ8_0Scalar : dotF32Scalar;
+}
+
+}  // namespace
+
+size_t QuantMatrix::rowBytes() const {
+    switch (mode) {
+        case QuantMode::Q4_0:
+            return size_t(cols / kQuantBlockSize) * sizeof(BlockQ4_0);
+        case QuantMode::Q8_0:
+            return size_t(cols / kQuantBlockSize) * sizeof(BlockQ8_0);
+        default:
+            return size_t(cols) * sizeof(float);
+    }
+}
 
 QuantBackend& QuantBackend::instance() {
     static QuantBackend inst;
@@ -15,72 +335,153 @@ QuantBackend& QuantBackend::instance() {
 }
 
 QuantBackend::QuantBackend() {
-#ifdef HAVE_GGML
-    ggmlAvailable_ = true;
-#else
-    ggmlAvailable_ = false;
-#endif
+    if (kernelSupported(QuantKernel::AVX512)) {
+        kernel_ = QuantKernel::AVX512;
+    } else if (kernelSupported(QuantKernel::AVX2)) {
+        kernel_ = QuantKernel::AVX2;
+    }
 }
 
 QuantBackend::~QuantBackend() = default;
 
 bool QuantBackend::setMode(QuantMode mode) {
-    // Fallback always available
-    if (mode == QuantMode::FALLBACK) {
-        mode_ = mode;
-        return true;
-    }
-    
-    // Quantized modes require ggml
-    if (!ggmlAvailable_) {
+    // Every mode has a native kernel (scalar at worst)
+    mode_ = mode;
+    return true;
+}
+
+bool QuantBackend::setKernel(QuantKernel kernel) {
+    if (!kernelSupported(kernel)) {
         return false;
     }
-    
-    mode_ = mode;
+    kernel_ = kernel;
     return true;
 }
 
+bool QuantBackend::kernelSupported(QuantKernel kernel) {
+    if (kernel == QuantKernel::Scalar) {
+        return true;
+    }
+#if defined(QUANT_X86) && defined(_MSC_VER)
+    int info[4] = {0};
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool f16c = (info[2] & (1 << 29)) != 0;
+    if (!osxsave || !fma || !f16c) return false;
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+    if (kernel == QuantKernel::AVX2) return avx2;
+    return avx2 && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0 && (xcr0 & 0xE6) == 0xE6;
+#elif defined(QUANT_X86)
+    __builtin_cpu_init();
+    const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+                      __builtin_cpu_supports("f16c");
+    if (kernel == QuantKernel::AVX2) return avx2;
+    return avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#else
+    return false;
+#endif
+}
+
+const char* QuantBackend::kernelName(QuantKernel kernel) {
+    switch (kernel) {
+        case QuantKernel::AVX512: return "AVX-512";
+        case QuantKernel::AVX2: return "AVX2";
+        default: return "scalar";
+    }
+}
+
 void QuantBackend::matmul(
     const float* A, 
     const float* B, 
     float* C, 
     int N, int M, int K
 ) {
-    switch (mode_) {
-#ifdef HAVE_GGML
-        case QuantMode::Q4_0: {
-            // ggml Q4_0 matmul path
-            // NOTE: ggml expects row-major layout
-            // This is a simplified stub - full implementation needs:
-            // 1. Pre-quantized weight buffer
-            // 2. ggml context management
-            // 3. Proper tensor creation
-            
-            // For now, fall through to fallback
-            // TODO: Implement ggml_mul_mat with Q4_0 tensors
-            fallbackMatmul(A, B, C, N, M, K);
-            break;
+    // Dense F32 operands in every mode; quantized weights go through gemv/gemm
+    fallbackMatmul(A, B, C, N, M, K);
+}
+
+void QuantBackend::gemv(const QuantMatrix& W, const float* x, float* y) const {
+    gemm(W, x, y, 1);
+}
+
+void QuantBackend::gemm(const QuantMatrix& W, const float* A, float* C, int N) const {
+    gemmRows(W, A, C, N, 0, W.rows);
+}
+
+void QuantBackend::gemmRows(const QuantMatrix& W, const float* A, float* C, int N, int rowBegin, int rowEnd) const {
+    const RowDot dot = selectDot(W.mode, kernel_);
+    const size_t rowBytes = W.rowBytes();
+    
+    if (W.mode == QuantMode::F32) {
+        for (int r = rowBegin; r < rowEnd; ++r) {
+            const uint8_t* row = W.data.data() + r * rowBytes;
+            for (int i = 0; i < N; ++i) {
+                C[size_t(i) * W.rows + r] = dot(row, A + size_t(i) * W.cols, W.cols);
+            }
         }
-        
-        case QuantMode::Q8_0: {
-            // ggml Q8_0 matmul path
-            // Similar to Q4_0 but 8-bit quantization
-            fallbackMatmul(A, B, C, N, M, K);
-            break;
+        return;
+    }
+    
+    // Quantize each activation row once per call (per thread when split),
+    // then stream the weights
+    const int nb = W.cols / kQuantBlockSize;
+    thread_local std::vector<ActBlock> act;
+    act.resize(size_t(N) * nb);
+    for (int i = 0; i < N; ++i) {
+        quantizeActivations(A + size_t(i) * W.cols, nb, act.data() + size_t(i) * nb);
+    }
+    for (int r = rowBegin; r < rowEnd; ++r) {
+        const uint8_t* row = W.data.data() + r * rowBytes;
+        for (int i = 0; i < N; ++i) {
+            C[size_t(i) * W.rows + r] = dot(row, act.data() + size_t(i) * nb, nb);
         }
-        
-        case QuantMode::F32: {
-            // Full precision ggml path (still faster due to optimized kernels)
-            fallbackMatmul(A, B, C, N, M, K);
-            break;
+    }
+}
+
+bool QuantBackend::quantizeMatrix(const float* src, int rows, int cols, QuantMatrix& out) const {
+    if (!src || rows <= 0 || cols <= 0) {
+        return false;
+    }
+    
+    const bool quantized = (mode_ == QuantMode::Q4_0 || mode_ == QuantMode::Q8_0) && cols % kQuantBlockSize == 0;
+    out.mode = quantized ? mode_ : QuantMode::F32;
+    out.rows = rows;
+    out.cols = cols;
+    out.data.resize(out.rowBytes() * rows);
+    
+    if (!quantized) {
+        std::memcpy(out.data.data(), src, out.data.size());
+        return true;
+    }
+    const size_t count = size_t(rows) * cols;
+    if (out.mode == QuantMode::Q4_0) {
+        BlockQ4_0* blocks = reinterpret_cast<BlockQ4_0*>(out.data.data());
+        for (size_t b = 0; b < count / kQuantBlockSize; ++b) {
+            quantizeBlockQ4_0(src + b * kQuantBlockSize, blocks[b]);
         }
-#endif
-        
-        case QuantMode::FALLBACK:
-        default:
-            fallbackMatmul(A, B, C, N, M, K);
-            break;
+    } else {
+        BlockQ8_0* blocks = reinterpret_cast<BlockQ8_0*>(out.data.data());
+        for (size_t b = 0; b < count / kQuantBlockSize; ++b) {
+            quantizeBlockQ8_0(src + b * kQuantBlockSize, blocks[b]);
+        }
+    }
+    return true;
+}
+
+bool QuantBackend::loadBlocks(QuantMode mode, const void* blocks, int rows, int cols, QuantMatrix& out) const {
+    if (!blocks || rows <= 0 || cols <= 0 || cols % kQuantBlockSize != 0 ||
+        (mode != QuantMode::Q4_0 && mode != QuantMode::Q8_0)) {
+        return false;
     }
+    out.mode = mode;
+    out.rows = rows;
+    out.cols = cols;
+    const uint8_t* bytes = static_cast<const uint8_t*>(blocks);
+    out.data.assign(bytes, bytes + out.rowBytes() * rows);
+    return true;
 }
 
 bool QuantBackend::quantizeWeights(
@@ -88,36 +489,38 @@ bool QuantBackend::quantizeWeights(
     void* dst, 
     size_t count
 ) {
-#ifdef HAVE_GGML
+    if (!src || !dst || count % kQuantBlockSize != 0) {
+        return false;
+    }
+    
     switch (mode_) {
         case QuantMode::Q4_0: {
-            // ggml_quantize_q4_0(src, dst, count, ...);
-            // TODO: Implement using ggml quantization API
-            return false;
+            BlockQ4_0* blocks = static_cast<BlockQ4_0*>(dst);
+            for (size_t b = 0; b < count / kQuantBlockSize; ++b) {
+                quantizeBlockQ4_0(src + b * kQuantBlockSize, blocks[b]);
+            }
+            return true;
         }
         
         case QuantMode::Q8_0: {
-            // ggml_quantize_q8_0(src, dst, count, ...);
-            return false;
+            BlockQ8_0* blocks = static_cast<BlockQ8_0*>(dst);
+            for (size_t b = 0; b < count / kQuantBlockSize; ++b) {
+                quantizeBlockQ8_0(src + b * kQuantBlockSize, blocks[b]);
+            }
+            return true;
         }
         
         default:
             return false;
     }
-#else
-    (void)src;
-    (void)dst;
-    (void)count;
-    return false;
-#endif
 }
 
 float QuantBackend::getCompressionRatio() const {
     switch (mode_) {
         case QuantMode::Q4_0:
-            return 8.0f;  // 32-bit → 4-bit = 8:1
+            return 32.0f / 4.5f;  // 18 bytes per 32 weights
         case QuantMode::Q8_0:
-            return 4.0f;  // 32-bit → 8-bit = 4:1
+            return 32.0f / 8.5f;  // 34 bytes per 32 weights
         case QuantMode::F32:
         case QuantMode::FALLBACK:
         default:
@@ -9,9 +9,14 @@
  * 
  * Provides runtime switching between:
  * - Fallback (pure C++)
- * - Q4_0 (ggml 4-bit quantization)
- * - Q8_0 (ggml 8-bit quantization)
+ * - Q4_0 (GGUF 4-bit blocks)
+ * - Q8_0 (GGUF 8-bit blocks)
  * - F32 (full precision)
+ *
+ * Quantized weights stay in their block format (QuantMatrix). Activations are
+ * quantized to 8 bits per 32-element block on the fly, so Q4_0/Q8_0 products
+ * are integer dot products with one scale multiply per block. Kernels are
+ * picked at runtime: AVX-512BW, AVX2 (+FMA/F16C) or scalar.
  */
 
 enum class QuantMode {
@@ -21,15 +26,59 @@ enum class QuantMode {
     F32        // Full precision (baseline)
 };
 
+enum class QuantKernel {
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+constexpr int kQuantBlockSize = 32;
+
+// Q4_0 block: 32 weights in 16 bytes + 1 float16 delta
+struct BlockQ4_0 {
+    uint16_t d;      // delta (float16)
+    uint8_t qs[16];  // weight j in the low nibble of qs[j], weight j+16 in the high nibble
+};
+
+// Q8_0 block: 32 weights in 32 bytes + 1 float16 delta
+struct BlockQ8_0 {
+    uint16_t d;      // delta (float16)
+    int8_t qs[32];   // 32 signed bytes
+};
+
+static_assert(sizeof(BlockQ4_0) == 18, "BlockQ4_0 must match the GGUF layout");
+static_assert(sizeof(BlockQ8_0) == 34, "BlockQ8_0 must match the GGUF layout");
+
+/**
+ * @brief Weight matrix as GGUF stores it: rows (outputs) x cols (inputs),
+ *        each row contiguous - cols/32 blocks for Q4_0/Q8_0, cols floats for F32
+ */
+struct QuantMatrix {
+    QuantMode mode = QuantMode::F32;
+    int rows = 0;
+    int cols = 0;
+    std::vector<uint8_t> data;
+    
+    bool empty() const { return data.empty(); }
+    size_t rowBytes() const;
+};
+
 class QuantBackend {
 public:
     static QuantBackend& instance();
     
-    // Set quantization mode (returns false if backend unavailable)
+    // Set quantization mode used by quantizeMatrix/quantizeWeights
     bool setMode(QuantMode mode);
     QuantMode currentMode() const { return mode_; }
     
-    // Matrix multiply: C = A @ B (dimensions: N x M @ M x K = N x K)
+    // Kernel set for gemv/gemm; defaults to the best the CPU supports.
+    // Returns false (and keeps the current one) if the CPU lacks it.
+    bool setKernel(QuantKernel kernel);
+    QuantKernel currentKernel() const { return kernel_; }
+    static bool kernelSupported(QuantKernel kernel);
+    static const char* kernelName(QuantKernel kernel);
+    
+    // Matrix multiply on dense F32 operands: C = A @ B (N x M @ M x K = N x K)
     void matmul(
         const float* A, 
         const float* B, 
@@ -37,7 +86,24 @@ public:
         int N, int M, int K
     );
     
-    // Quantize weights from F32 to current mode
+    // y[W.rows] = W @ x[W.cols], straight from the block format
+    void gemv(const QuantMatrix& W, const float* x, float* y) const;
+    
+    // C[N x W.rows] = A[N x W.cols] @ W^T; each weight row is read once for all N
+    void gemm(const QuantMatrix& W, const float* A, float* C, int N) const;
+    
+    // gemm restricted to weight rows [rowBegin, rowEnd), for callers that
+    // split the output rows across threads (C keeps its full W.rows stride)
+    void gemmRows(const QuantMatrix& W, const float* A, float* C, int N, int rowBegin, int rowEnd) const;
+    
+    // Pack row-major F32 weights into out using the current mode (F32 is kept
+    // as-is for FALLBACK/F32, or when cols is not a multiple of 32)
+    bool quantizeMatrix(const float* src, int rows, int cols, QuantMatrix& out) const;
+    
+    // Adopt GGUF Q4_0/Q8_0 block data without converting it
+    bool loadBlocks(QuantMode mode, const void* blocks, int rows, int cols, QuantMatrix& out) const;
+    
+    // Quantize weights from F32 to current mode (count must be a multiple of 32)
     bool quantizeWeights(
         const float* src, 
         void* dst, 
@@ -52,7 +118,7 @@ private:
     ~QuantBackend();
     
     QuantMode mode_ = QuantMode::FALLBACK;
-    bool ggmlAvailable_ = false;
+    QuantKernel kernel_ = QuantKernel::Scalar;
     
     // Fallback implementation
     void fallbackMatmul(
@@ -0,0 +1,135 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define WORKER_PAUSE() _mm_pause()
+#else
+#define WORKER_PAUSE() std::this_thread::yield()
+#endif
+
+namespace {
+// Spin iterations before a worker sleeps; covers the gap between the
+// matmuls of one layer without burning a core when generation is idle
+constexpr int kSpinIterations = 4000;
+}
+
+WorkerPool::WorkerPool(int threads) {
+    const int total = threads > 0 ? threads : physicalCoreCount();
+    for (int i = 1; i < total; ++i) {
+        workers_.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+void WorkerPool::run(int n, int grain, ChunkFn fn, const void* ctx) {
+    if (n <= 0) return;
+    grain = std::max(1, grain);
+    if (workers_.empty() || n <= grain) {
+        fn(ctx, 0, n);
+        return;
+    }
+
+    // ~4 chunks per thread so a slow core does not hold up the rest
+    const int target = threadCount() * 4;
+    int chunk = (n + target - 1) / target;
+    chunk = std::max(grain, (chunk + grain - 1) / grain * grain);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = fn;
+        jobCtx_ = ctx;
+        jobSize_ = n;
+        chunkSize_ = chunk;
+        nextChunk_.store(0, std::memory_order_relaxed);
+        pending_ = static_cast<int>(workers_.size());
+        generation_.fetch_add(1, std::memory_order_release);
+    }
+    wake_.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    job_ = nullptr;
+    jobCtx_ = nullptr;
+}
+
+void WorkerPool::runChunks() {
+    for (;;) {
+        const int begin = nextChunk_.fetch_add(chunkSize_, std::memory_order_relaxed);
+        if (begin >= jobSize_) break;
+        job_(jobCtx_, begin, std::min(begin + chunkSize_, jobSize_));
+    }
+}
+
+void WorkerPool::workerLoop() {
+    uint64_t seen = 0;
+    for (;;) {
+        for (int i = 0; i < kSpinIterations && generation_.load(std::memory_order_acquire) == seen; ++i) {
+            WORKER_PAUSE();
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_.load(std::memory_order_relaxed) != seen; });
+            if (stop_) return;
+            seen = generation_.load(std::memory_order_relaxed);
+        }
+
+        runChunks();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--pending_ == 0) done_.notify_one();
+    }
+}
+
+int WorkerPool::physicalCoreCount() {
+    const int logical = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+#ifdef _WIN32
+    DWORD len = 0;
+    GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &len);
+    if (len == 0) return logical;
+    std::vector<char> buf(len);
+    auto* info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buf.data());
+    if (!GetLogicalProcessorInformationEx(RelationProcessorCore, info, &len)) return logical;
+    int cores = 0;
+    for (DWORD off = 0; off < len; ) {
+        auto* rec = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buf.data() + off);
+        if (rec->Relationship == RelationProcessorCore) ++cores;
+        off += rec->Size;
+    }
+    return cores > 0 ? cores : logical;
+#else
+    // One (package, core) pair per physical core; SMT siblings share it
+    std::set<std::pair<int, int>> cores;
+    for (int cpu = 0; cpu < logical; ++cpu) {
+        const std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        std::ifstream pkgFile(base + "physical_package_id");
+        std::ifstream coreFile(base + "core_id");
+        int pkg = -1, core = -1;
+        if (!(pkgFile >> pkg) || !(coreFile >> core)) return logical;
+        cores.insert({pkg, core});
+    }
+    return cores.empty() ? logical : static_cast<int>(cores.size());
+#endif
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Fixed worker pool for GGUFRunner's decode loop
+ *
+ * parallelFor() splits [0, n) into chunks that the calling thread and the
+ * workers claim from a shared counter, then blocks until every chunk ran.
+ * Workers spin briefly between jobs before sleeping, since decode issues
+ * several short jobs per layer. One caller at a time; jobs must not nest.
+ */
+class WorkerPool {
+public:
+    // threads <= 0 sizes the pool to the physical core count (caller included)
+    explicit WorkerPool(int threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Threads that run chunks, including the caller
+    int threadCount() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Run fn(begin, end) over [0, n); chunk bounds are multiples of grain
+    // (except the last), so grain can keep chunks off each other's cache lines
+    template <typename Fn>
+    void parallelFor(int n, int grain, Fn&& fn) {
+        using F = std::remove_reference_t<Fn>;
+        run(n, grain, [](const void* ctx, int begin, int end) { (*static_cast<F*>(const_cast<void*>(ctx)))(begin, end); }, &fn);
+    }
+
+    // Physical cores (SMT siblings counted once); falls back to logical CPUs
+    static int physicalCoreCount();
+
+private:
+    // Type-erased job: no std::function, so dispatch never allocates
+    using ChunkFn = void (*)(const void* ctx, int begin, int end);
+
+    void run(int n, int grain, ChunkFn fn, const void* ctx);
+    void workerLoop();
+    void runChunks();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+
+    // Current job, published under mutex_ before generation_ is bumped
+    ChunkFn job_ = nullptr;
+    const void* jobCtx_ = nullptr;
+    int jobSize_ = 0;
+    int chunkSize_ = 0;
+    std::atomic<int> nextChunk_{0};
+    int pending_ = 0;
+    std::atomic<uint64_t> generation_{0};
+    bool stop_ = false;
+};
@@ -5,9 +5,10 @@
  * @details
  * This implementation provides:
  * - Asynchronous search using QtConcurrent::run() with QFutureWatcher
+ * - Parallel, mapped-file scanning through FileSearchEngine
+ * - Background trigram index build and incremental updates (TrigramIndex)
  * - Thread-safe result collection via QMutex-protected queue
- * - .gitignore pattern parsing and matching
- * - Regex and literal text search modes
+ * - Regex and literal text search modes (regex only on prefiltered lines)
  * - Grouped tree view display with file context
  * - Proper signal marshalling to main thread via queued connections
  *
@@ -18,6 +19,9 @@
  */
 
 #include "multi_file_search.h"
+#include "file_search_engine.h"
+#include "trigram_index.h"
+#include "qtapp/utils/project_detector.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -30,13 +34,24 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QFile>
-#include <QTextStream>
+#include <QFileSystemWatcher>
+#include <QSet>
 #include <QRegularExpression>
 #include <QRegularExpressionMatch>
 #include <QtConcurrent>
 #include <QFutureWatcher>
 #include <QMutexLocker>
 #include <QDebug>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Directory watches cost a kernel handle each; past this, searches check the
+// remaining directories' mtimes against the index instead
+constexpr int kMaxWatchedDirectories = 4096;
+
+} // namespace
 
 
 /**
@@ -133,15 +148,20 @@ MultiFileSearchWidget::MultiFileSearchWidget(QWidget* parent)
 
     // Batched result updates (queued to ensure main thread)
     connect(this, &MultiFileSearchWidget::searchProgress,
-            this, [this](int filesSearched, int matchesFound) {
-                QMutexLocker locker(&m_resultsMutex);
-                if (!m_pendingResults.empty()) {
-                    for (const auto& result : m_pendingResults) {
-                        addResultToTree(result);
-                    }
-                    m_pendingResults.clear();
-                }
-            }, Qt::QueuedConnection);
+            this, &MultiFileSearchWidget::onSearchResultsReady, Qt::QueuedConnection);
+
+    // Trigram index, built and updated on its own background task
+    FileSearchEngine::Options indexOptions;
+    indexOptions.cancel = &m_indexCancelled;
+    m_index = std::make_unique<TrigramIndex>(indexOptions);
+
+    m_indexWatcher = new QFutureWatcher<void>(this);
+    connect(m_indexWatcher, &QFutureWatcher<void>::finished,
+            this, &MultiFileSearchWidget::onIndexUpdated);
+
+    m_directoryWatcher = new QFileSystemWatcher(this);
+    connect(m_directoryWatcher, &QFileSystemWatcher::directoryChanged,
+            this, &MultiFileSearchWidget::queueIndexUpdate);
 }
 
 /**
@@ -153,6 +173,10 @@ MultiFileSearchWidget::~MultiFileSearchWidget()
         m_searchCancelled.store(true, std::memory_order_release);
         m_searchWatcher->waitForFinished();
     }
+    if (m_indexWatcher && m_indexWatcher->isRunning()) {
+        m_indexCancelled.store(true, std::memory_order_release);
+        m_indexWatcher->waitForFinished();
+    }
 }
 
 /**
@@ -162,6 +186,154 @@ void MultiFileSearchWidget::setProjectRoot(const QString& path)
 {
     m_projectRoot = path;
     updateStatus(QString("Project root: %1").arg(QFileInfo(path).fileName()));
+    startIndexBuild();
+}
+
+/**
+ * @brief Builds the index for the project containing the search root.
+ */
+void MultiFileSearchWidget::startIndexBuild()
+{
+    m_indexReady.store(false, std::memory_order_release);
+    m_watchComplete.store(false, std::memory_order_release);
+    if (m_indexWatcher->isRunning()) {
+        m_indexCancelled.store(true, std::memory_order_release);
+        m_indexWatcher->waitForFinished();
+    }
+    m_indexCancelled.store(false, std::memory_order_release);
+
+    const QStringList watched = m_directoryWatcher->directories();
+    if (!watched.isEmpty()) {
+        m_directoryWatcher->removePaths(watched);
+    }
+    if (m_projectRoot.isEmpty()) {
+        return;
+    }
+
+    // Index the whole project even when the search root is a subdirectory
+    QString indexRoot = RawrXD::ProjectDetector().findProjectRoot(m_projectRoot);
+    if (indexRoot.isEmpty()) {
+        indexRoot = m_projectRoot;
+    }
+    const std::string root = QDir::cleanPath(indexRoot).toStdString();
+
+    {
+        QMutexLocker locker(&m_indexMutex);
+        m_indexQueue.clear();
+        m_indexBusy = true;
+        m_watchedDirectories.reset();
+    }
+
+    QFuture<void> future = QtConcurrent::run([this, root]() {
+        // A saved index only re-reads files whose size or mtime changed
+        const std::string file = TrigramIndex::defaultIndexPath(root);
+        m_index->load(file);
+        if (m_index->refresh(root)) {
+            if (!m_index->save(file)) {
+                qWarning() << "MultiFileSearchWidget: could not save index" << QString::fromStdString(file);
+            }
+            m_indexReady.store(true, std::memory_order_release);
+        }
+        drainIndexQueue();
+    });
+    m_indexWatcher->setFuture(future);
+}
+
+/**
+ * @brief Re-indexes one file after the IDE changed it.
+ */
+void MultiFileSearchWidget::notifyFileChanged(const QString& path)
+{
+    queueIndexUpdate(path);
+}
+
+/**
+ * @brief Queues a path and starts an update task if none is running.
+ */
+void MultiFileSearchWidget::queueIndexUpdate(const QString& path)
+{
+    if (m_projectRoot.isEmpty()) {
+        return;
+    }
+
+    bool start = false;
+    {
+        QMutexLocker locker(&m_indexMutex);
+        if (!m_indexQueue.contains(path)) {
+            m_indexQueue.append(path);
+        }
+        if (!m_indexBusy) {
+            m_indexBusy = true;
+            start = true;
+        }
+    }
+    if (start) {
+        m_indexWatcher->setFuture(QtConcurrent::run([this]() { drainIndexQueue(); }));
+    }
+}
+
+/**
+ * @brief Applies queued index updates - runs on the index thread.
+ */
+void MultiFileSearchWidget::drainIndexQueue()
+{
+    for (;;) {
+        QString path;
+        {
+            QMutexLocker locker(&m_indexMutex);
+            if (m_indexQueue.isEmpty() || m_indexCancelled.load(std::memory_order_acquire)) {
+                m_indexBusy = false;
+                return;
+            }
+            path = m_indexQueue.takeFirst();
+        }
+
+        const std::string target = QDir::cleanPath(path).toStdString();
+        if (QFileInfo(path).isDir()) {
+            m_index->refreshDirectory(target);
+        } else {
+            m_index->updateFile(target);
+        }
+    }
+}
+
+/**
+ * @brief Watches every directory of the indexed tree, new ones included.
+ */
+void MultiFileSearchWidget::onIndexUpdated()
+{
+    if (!m_indexReady.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    const QStringList current = m_directoryWatcher->directories();
+    const QSet<QString> watched(current.begin(), current.end());
+    QStringList added;
+    bool complete = true;
+    for (const std::string& dir : m_index->directories()) {
+        const QString path = QString::fromStdString(dir);
+        if (watched.contains(path)) {
+            continue;
+        }
+        if (watched.size() + added.size() >= kMaxWatchedDirectories) {
+            complete = false;
+            break;
+        }
+        added.append(path);
+    }
+    if (!added.isEmpty() && !m_directoryWatcher->addPaths(added).isEmpty()) {
+        complete = false;
+    }
+
+    auto watchedNow = std::make_shared<std::unordered_set<std::string>>();
+    for (const QString& dir : m_directoryWatcher->directories()) {
+        watchedNow->insert(dir.toStdString());
+    }
+    {
+        QMutexLocker locker(&m_indexMutex);
+        m_watchedDirectories = std::move(watchedNow);
+    }
+    m_watchComplete.store(complete, std::memory_order_release);
 }
 
 /**
@@ -232,6 +404,7 @@ void MultiFileSearchWidget::cancelSearch()
 void MultiFileSearchWidget::clearResults()
 {
     m_resultsTree->clear();
+    m_fileItems.clear();
     m_totalResultCount = 0;
     {
         QMutexLocker locker(&m_resultsMutex);
@@ -271,18 +444,39 @@ void MultiFileSearchWidget::onResultItemDoubleClicked(QTreeWidgetItem* item, int
 }
 
 /**
- * @brief Handles search completion and emits final signal.
+ * @brief Moves pending results from the search threads into the tree view.
  */
-void MultiFileSearchWidget::onSearchFinished()
+void MultiFileSearchWidget::onSearchResultsReady()
 {
-    // Flush any remaining pending results
+    std::vector<MultiFileSearchResult> results;
+    int total = 0;
     {
         QMutexLocker locker(&m_resultsMutex);
-        for (const auto& result : m_pendingResults) {
-            addResultToTree(result);
-        }
-        m_pendingResults.clear();
+        results.swap(m_pendingResults);
+        total = m_totalResultCount;
     }
+    if (results.empty()) {
+        return;
+    }
+
+    m_resultsTree->setUpdatesEnabled(false);
+    for (const auto& result : results) {
+        addResultToTree(result);
+    }
+    m_resultsTree->setUpdatesEnabled(true);
+
+    if (m_isSearching) {
+        updateStatus(QString("Searching... %1 results").arg(total));
+    }
+}
+
+/**
+ * @brief Handles search completion and emits final signal.
+ */
+void MultiFileSearchWidget::onSearchFinished()
+{
+    // Flush any remaining pending results
+    onSearchResultsReady();
 
     m_isSearching = false;
     m_searchButton->setText("Search");
@@ -305,186 +499,105 @@ void MultiFileSearchWidget::performSearch(const QString& searchText,
                                          bool caseSensitive,
                                          const QString& fileFilter)
 {
-    QRegularExpression searchPattern;
-
-    // Compile search pattern (regex or literal)
-    if (useRegex) {
-        QRegularExpression::PatternOptions options =
-            caseSensitive ? QRegularExpression::NoPatternOption
-                          : QRegularExpression::CaseInsensitiveOption;
-        searchPattern.setPattern(searchText);
-        searchPattern.setPatternOptions(options);
-
-        if (!searchPattern.isValid()) {
-            return;
+    FileSearchQuery query;
+    query.caseSensitive = caseSensitive;
+
+    // The byte scan folds ASCII only, so a non-ASCII literal searched without
+    // case goes through QRegularExpression like a regex does
+    bool asciiText = true;
+    for (QChar ch : searchText) {
+        if (ch.unicode() >= 0x80) {
+            asciiText = false;
+            break;
         }
     }
 
-    // Load gitignore patterns
-    auto gitignorePatterns = loadGitignorePatterns(rootPath);
-
-    // Parse file filter patterns
-    QStringList filterList = fileFilter.split(',', Qt::SkipEmptyParts);
-    for (auto& filter : filterList) {
-        filter = filter.trimmed();
-    }
-
-    // Recursive directory traversal
-    QDir dir(rootPath);
-    QFileInfoList fileList = dir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot,
-                                               QDir::DirsFirst);
-
-    for (const QFileInfo& fileInfo : fileList) {
-        if (m_searchCancelled.load(std::memory_order_acquire)) {
+    if (useRegex || (!caseSensitive && !asciiText)) {
+        const QString pattern = useRegex ? searchText : QRegularExpression::escape(searchText);
+        QRegularExpression searchPattern(pattern,
+                                         caseSensitive ? QRegularExpression::NoPatternOption
+                                                       : QRegularExpression::CaseInsensitiveOption);
+        if (!searchPattern.isValid()) {
             return;
         }
-
-        if (fileInfo.isDir()) {
-            performSearch(searchText, fileInfo.absoluteFilePath(), useRegex, caseSensitive, fileFilter);
-        } else if (fileInfo.isFile()) {
-            // Check if file should be ignored
-            if (isIgnored(fileInfo.absoluteFilePath(), gitignorePatterns)) {
-                continue;
+        searchPattern.optimize();  // Compile now, before the worker threads share it
+
+        // Only lines containing the pattern's required literal reach the regex
+        query.literal = FileSearchEngine::requiredLiteral(pattern.toStdString(), caseSensitive);
+        query.matcher = [searchPattern](const char* line, size_t size,
+                                        std::vector<std::pair<size_t, size_t>>& out) {
+            const QString text = QString::fromUtf8(line, qsizetype(size));
+            QRegularExpressionMatchIterator it = searchPattern.globalMatch(text);
+            while (it.hasNext()) {
+                const QRegularExpressionMatch match = it.next();
+                const size_t start = size_t(text.left(match.capturedStart()).toUtf8().size());
+                out.emplace_back(start, size_t(match.captured().toUtf8().size()));
             }
-
-            // Check file filter
-            bool matchesFilter = false;
-            for (const QString& filter : filterList) {
-                QRegularExpression filterPattern(QRegularExpression::wildcardToRegularExpression(filter));
-                if (filterPattern.match(fileInfo.fileName()).hasMatch()) {
-                    matchesFilter = true;
-                    break;
-                }
-            }
-
-            if (!matchesFilter) {
-                continue;
-            }
-
-            // Read and search file
-            QString fileContent = FileManager::readFile(fileInfo.absoluteFilePath());
-            if (fileContent.isEmpty()) {
-                continue;
-            }
-
-            QStringList lines = fileContent.split('\n');
-            for (int lineNum = 0; lineNum < lines.size(); ++lineNum) {
-                if (m_searchCancelled.load(std::memory_order_acquire)) {
-                    return;
-                }
-
-                const QString& line = lines[lineNum];
-
-                // Search for matches in line
-                if (useRegex) {
-                    QRegularExpressionMatchIterator it = searchPattern.globalMatch(line);
-                    while (it.hasNext()) {
-                        QRegularExpressionMatch match = it.next();
-                        MultiFileSearchResult result(
-                            fileInfo.absoluteFilePath(),
-                            lineNum + 1,
-                            match.capturedStart(),
-                            line,
-                            match.captured()
-                        );
-
-                        {
-                            QMutexLocker locker(&m_resultsMutex);
-                            m_pendingResults.push_back(result);
-                            m_totalResultCount++;
-                        }
-
-                        // Batch emit every 20 results for UI responsiveness
-                        if (m_totalResultCount % 20 == 0) {
-                            emit searchProgress(0, m_totalResultCount);
-                        }
-                    }
-                } else {
-                    // Literal string search
-                    Qt::CaseSensitivity cs = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
-                    int startPos = 0;
-
-                    while (true) {
-                        int pos = line.indexOf(searchText, startPos, cs);
-                        if (pos == -1) {
-                            break;
-                        }
-
-                        MultiFileSearchResult result(
-                            fileInfo.absoluteFilePath(),
-                            lineNum + 1,
-                            pos,
-                            line,
-                            searchText
-                        );
-
-                        {
-                            QMutexLocker locker(&m_resultsMutex);
-                            m_pendingResults.push_back(result);
-                            m_totalResultCount++;
-                        }
-
-                        // Batch emit every 20 results
-                        if (m_totalResultCount % 20 == 0) {
-                            emit searchProgress(0, m_totalResultCount);
-                        }
-
-                        startPos = pos + searchText.length();
-                    }
-                }
-            }
-        }
-    }
-}
-
-/**
- * @brief Parses .gitignore file and returns compiled regex patterns.
- */
-QVector<QRegularExpression> MultiFileSearchWidget::loadGitignorePatterns(const QString& rootPath)
-{
-    QVector<QRegularExpression> patterns;
-
-    QString gitignorePath = rootPath + "/.gitignore";
-    QFile gitignoreFile(gitignorePath);
-
-    if (!gitignoreFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return patterns;
+        };
+    } else {
+        query.literal = searchText.toStdString();
     }
 
-    QTextStream stream(&gitignoreFile);
-    while (!stream.atEnd()) {
-        QString line = stream.readLine().trimmed();
-
-        // Skip comments and empty lines
-        if (line.isEmpty() || line.startsWith('#')) {
-            continue;
+    FileSearchEngine::Options options;
+    options.fileFilter = fileFilter.toStdString();
+    options.cancel = &m_searchCancelled;
+    FileSearchEngine engine(options);
+
+    auto onBatch = [this](std::vector<FileSearchHit>& batch) {
+        std::vector<MultiFileSearchResult> results;
+        results.reserve(batch.size());
+        for (const FileSearchHit& hit : batch) {
+            // Hits carry byte offsets; the editor navigates by QString column
+            const QString lineText = QString::fromUtf8(hit.lineText.data(), qsizetype(hit.lineText.size()));
+            const int column = int(QString::fromUtf8(hit.lineText.data(), qsizetype(hit.column)).size());
+            results.emplace_back(QDir::fromNativeSeparators(QString::fromStdString(hit.path)),
+                                 hit.line,
+                                 column,
+                                 lineText,
+                                 QString::fromUtf8(hit.matchText.data(), qsizetype(hit.matchText.size())));
         }
 
-        // Convert gitignore glob pattern to regex
-        QString regexPattern = QRegularExpression::wildcardToRegularExpression(line);
-        QRegularExpression regex(regexPattern);
-
-        if (regex.isValid()) {
-            patterns.append(regex);
+        int total = 0;
+        {
+            QMutexLocker locker(&m_resultsMutex);
+            m_pendingResults.insert(m_pendingResults.end(),
+                                    std::make_move_iterator(results.begin()),
+                                    std::make_move_iterator(results.end()));
+            m_totalResultCount += int(results.size());
+            total = m_totalResultCount;
         }
-    }
 
-    gitignoreFile.close();
-    return patterns;
-}
-
-/**
- * @brief Checks if a file path matches any gitignore patterns.
- */
-bool MultiFileSearchWidget::isIgnored(const QString& filePath,
-                                      const QVector<QRegularExpression>& patterns)
-{
-    for (const auto& pattern : patterns) {
-        if (pattern.match(filePath).hasMatch()) {
-            return true;
+        // One queued UI update per batch
+        emit searchProgress(0, total);
+    };
+
+    // With the index ready, only files holding every trigram of the literal
+    // can match; files outside the search root are dropped. Directories
+    // without a watch get no notifications, so those whose mtime moved are
+    // rescanned first (a stat each, instead of reading the whole tree)
+    std::vector<std::string> candidates;
+    if (m_indexReady.load(std::memory_order_acquire) && !m_watchComplete.load(std::memory_order_acquire)) {
+        std::shared_ptr<const std::unordered_set<std::string>> watched;
+        {
+            QMutexLocker locker(&m_indexMutex);
+            watched = m_watchedDirectories;
         }
+        m_index->refreshChangedDirectories([&watched](const std::string& dir) {
+            return watched && watched->count(dir) > 0;
+        });
+    }
+    if (m_indexReady.load(std::memory_order_acquire) && m_index->candidates(query.literal, candidates)) {
+        const std::string prefix = QDir::cleanPath(rootPath).toStdString() + '/';
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [&prefix](const std::string& file) {
+                                            return file.compare(0, prefix.size(), prefix) != 0;
+                                        }),
+                         candidates.end());
+        engine.searchFiles(candidates, query, onBatch);
+        return;
     }
-    return false;
+
+    engine.search(rootPath.toStdString(), query, onBatch);
 }
 
 /**
@@ -493,15 +606,7 @@ bool MultiFileSearchWidget::isIgnored(const QString& filePath,
 void MultiFileSearchWidget::addResultToTree(const MultiFileSearchResult& result)
 {
     // Find or create file group item
-    QTreeWidgetItem* fileItem = nullptr;
-
-    for (int i = 0; i < m_resultsTree->topLevelItemCount(); ++i) {
-        QTreeWidgetItem* item = m_resultsTree->topLevelItem(i);
-        if (item->text(0) == result.file) {
-            fileItem = item;
-            break;
-        }
-    }
+    QTreeWidgetItem*& fileItem = m_fileItems[result.file];
 
     if (!fileItem) {
         fileItem = new QTreeWidgetItem();
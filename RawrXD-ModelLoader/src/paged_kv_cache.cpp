@@ -0,0 +1,269 @@
+#include "paged_kv_cache.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+bool PagedKVCache::Init(const PagedKVConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (config.n_layers == 0 || config.kv_dim == 0 || config.block_size == 0 || config.num_blocks == 0) {
+        std::cerr << "❌ Invalid paged KV cache configuration" << std::endl;
+        return false;
+    }
+    
+    config_ = config;
+    const size_t floats = size_t(config.n_layers) * 2 * config.num_blocks * config.block_size * config.kv_dim;
+    pool_.reset(static_cast<float*>(::operator new[](floats * sizeof(float), std::align_val_t(kPoolAlignment), std::nothrow)));
+    if (!pool_) {
+        std::cerr << "❌ Failed to allocate KV pool (" << (floats * sizeof(float)) / (1024 * 1024) << " MB)" << std::endl;
+        pool_floats_ = 0;
+        return false;
+    }
+    pool_floats_ = floats;
+    
+    // Only slot 0, the default padding slot gathered for masked positions,
+    // must be finite before it is written; the rest stays untouched so the
+    // pool's pages are only committed as tokens fill them
+    for (uint32_t layer = 0; layer < config.n_layers; ++layer) {
+        std::memset(Plane(layer, 0), 0, config.kv_dim * sizeof(float));
+        std::memset(Plane(layer, 1), 0, config.kv_dim * sizeof(float));
+    }
+    
+    ref_counts_.assign(config.num_blocks, 0);
+    free_blocks_.resize(config.num_blocks);
+    for (uint32_t i = 0; i < config.num_blocks; ++i) {
+        free_blocks_[i] = config.num_blocks - 1 - i;  // Hand out low blocks first
+    }
+    sequences_.clear();
+    clock_ = 0;
+    cow_copies_ = 0;
+    evicted_sequences_ = 0;
+    return true;
+}
+
+void PagedKVCache::Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pool_.reset();
+    pool_floats_ = 0;
+    ref_counts_.clear();
+    free_blocks_.clear();
+    sequences_.clear();
+}
+
+bool PagedKVCache::AddSequence(SeqId seq) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!pool_ || sequences_.count(seq)) {
+        return false;
+    }
+    sequences_[seq].last_use = ++clock_;
+    return true;
+}
+
+bool PagedKVCache::ForkSequence(SeqId parent, SeqId child) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sequences_.find(parent);
+    if (it == sequences_.end() || sequences_.count(child)) {
+        return false;
+    }
+    
+    // Share every block; the first append into a shared tail copies it.
+    // Forking counts as a use of the parent for LRU eviction.
+    it->second.last_use = ++clock_;
+    Sequence copy;
+    copy.blocks = it->second.blocks;
+    copy.n_tokens = it->second.n_tokens;
+    copy.last_use = ++clock_;
+    for (uint32_t block : copy.blocks) {
+        ++ref_counts_[block];
+    }
+    sequences_.emplace(child, std::move(copy));
+    return true;
+}
+
+bool PagedKVCache::RemoveSequence(SeqId seq) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sequences_.find(seq);
+    if (it == sequences_.end()) {
+        return false;
+    }
+    ReleaseBlocksLocked(it->second, 0);
+    sequences_.erase(it);
+    return true;
+}
+
+bool PagedKVCache::HasSequence(SeqId seq) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sequences_.count(seq) != 0;
+}
+
+uint32_t PagedKVCache::SequenceLength(SeqId seq) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sequences_.find(seq);
+    return it == sequences_.end() ? 0 : it->second.n_tokens;
+}
+
+bool PagedKVCache::TruncateSequence(SeqId seq, uint32_t n_tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sequences_.find(seq);
+    if (it == sequences_.end() || n_tokens > it->second.n_tokens) {
+        return false;
+    }
+    const uint32_t bs = config_.block_size;
+    ReleaseBlocksLocked(it->second, (n_tokens + bs - 1) / bs);
+    it->second.n_tokens = n_tokens;
+    return true;
+}
+
+std::vector<PagedKVCache::SeqId> PagedKVCache::GetSequences() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<SeqId> result;
+    result.reserve(sequences_.size());
+    for (const auto& [id, seq] : sequences_) {
+        result.push_back(id);
+    }
+    return result;
+}
+
+void PagedKVCache::SetPinned(SeqId seq, bool pinned) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sequences_.find(seq);
+    if (it != sequences_.end()) {
+        it->second.pinned = pinned;
+    }
+}
+
+bool PagedKVCache::Append(SeqId seq_id, uint32_t n_tokens, int64_t* slots_out) {
+    std::vector<SeqId> evicted;
+    bool ok = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sequences_.find(seq_id);
+        if (it == sequences_.end()) {
+            return false;
+        }
+        Sequence& seq = it->second;
+        const uint32_t bs = config_.block_size;
+        const uint32_t len = seq.n_tokens;
+        
+        // Blocks to take from the pool: new tail blocks, plus a private copy
+        // of a partially filled tail that another sequence still references
+        const size_t total_blocks = (size_t(len) + n_tokens + bs - 1) / bs;
+        const bool cow_tail = len % bs != 0 && ref_counts_[seq.blocks.back()] > 1;
+        const size_t needed = total_blocks - seq.blocks.size() + (cow_tail ? 1 : 0);
+        
+        // Erasing other sequences leaves the reference to this one valid
+        while (free_blocks_.size() < needed && EvictOneLocked(seq_id, evicted)) {
+        }
+        
+        ok = free_blocks_.size() >= needed;
+        if (ok) {
+            // Eviction may have dropped the tail's other owners; then it stays in place
+            if (cow_tail && ref_counts_[seq.blocks.back()] > 1) {
+                const uint32_t shared = seq.blocks.back();
+                const uint32_t copy = free_blocks_.back();
+                free_blocks_.pop_back();
+                CopyBlockLocked(shared, copy, len % bs);
+                --ref_counts_[shared];
+                ref_counts_[copy] = 1;
+                seq.blocks.back() = copy;
+                ++cow_copies_;
+            }
+            while (seq.blocks.size() < total_blocks) {
+                const uint32_t block = free_blocks_.back();
+                free_blocks_.pop_back();
+                ref_counts_[block] = 1;
+                seq.blocks.push_back(block);
+            }
+            for (uint32_t i = 0; i < n_tokens; ++i) {
+                const uint32_t pos = len + i;
+                slots_out[i] = int64_t(seq.blocks[pos / bs]) * bs + pos % bs;
+            }
+            seq.n_tokens = len + n_tokens;
+            seq.last_use = ++clock_;
+        }
+    }
+    
+    if (on_evict_) {
+        for (SeqId id : evicted) {
+            on_evict_(id);
+        }
+    }
+    return ok;
+}
+
+int64_t PagedKVCache::SlotOf(SeqId seq, uint32_t pos) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sequences_.find(seq);
+    if (it == sequences_.end() || pos >= it->second.n_tokens) {
+        return -1;
+    }
+    const uint32_t bs = config_.block_size;
+    return int64_t(it->second.blocks[pos / bs]) * bs + pos % bs;
+}
+
+bool PagedKVCache::GatherSlots(SeqId seq, uint32_t n, int32_t* slots_out, int32_t pad_slot) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sequences_.find(seq);
+    if (it == sequences_.end()) {
+        return false;
+    }
+    const uint32_t bs = config_.block_size;
+    const uint32_t live = std::min(n, it->second.n_tokens);
+    for (uint32_t pos = 0; pos < live; ++pos) {
+        slots_out[pos] = int32_t(it->second.blocks[pos / bs] * bs + pos % bs);
+    }
+    std::fill(slots_out + live, slots_out + n, pad_slot);
+    return true;
+}
+
+PagedKVStats PagedKVCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PagedKVStats stats;
+    stats.total_blocks = config_.num_blocks;
+    stats.free_blocks = uint32_t(free_blocks_.size());
+    stats.shared_blocks = uint32_t(std::count_if(ref_counts_.begin(), ref_counts_.end(),
+                                                 [](uint32_t refs) { return refs > 1; }));
+    stats.sequences = uint32_t(sequences_.size());
+    for (const auto& [id, seq] : sequences_) {
+        stats.live_tokens += seq.n_tokens;
+    }
+    stats.cow_copies = cow_copies_;
+    stats.evicted_sequences = evicted_sequences_;
+    return stats;
+}
+
+void PagedKVCache::ReleaseBlocksLocked(Sequence& seq, size_t keep_blocks) {
+    while (seq.blocks.size() > keep_blocks) {
+        const uint32_t block = seq.blocks.back();
+        seq.blocks.pop_back();
+        if (--ref_counts_[block] == 0) {
+            free_blocks_.push_back(block);
+        }
+    }
+}
+
+void PagedKVCache::CopyBlockLocked(uint32_t src, uint32_t dst, uint32_t rows) {
+    const size_t block_floats = size_t(config_.block_size) * config_.kv_dim;
+    const size_t plane_floats = size_t(SlotCount()) * config_.kv_dim;
+    for (size_t plane = 0; plane < size_t(config_.n_layers) * 2; ++plane) {
+        float* base = pool_.get() + plane * plane_floats;
+        std::memcpy(base + dst * block_floats, base + src * block_floats, sizeof(float) * rows * config_.kv_dim);
+    }
+}
+
+bool PagedKVCache::EvictOneLocked(SeqId requester, std::vector<SeqId>& evicted) {
+    auto victim = sequences_.end();
+    for (auto it = sequences_.begin(); it != sequences_.end(); ++it) {
+        if (it->first == requester || it->second.pinned || it->second.blocks.empty()) continue;
+        if (victim == sequences_.end() || it->second.last_use < victim->second.last_use) {
+            victim = it;
+        }
+    }
+    if (victim == sequences_.end()) {
+        return false;
+    }
+    ReleaseBlocksLocked(victim->second, 0);
+    evicted.push_back(victim->first);
+    sequences_.erase(victim);
+    ++evicted_sequences_;
+    return true;
+}
@@ -0,0 +1,221 @@
+#include "prefix_cache.h"
+#include <algorithm>
+
+PrefixCache::PrefixCache(size_t max_tokens)
+    : max_tokens_(max_tokens) {
+}
+
+PrefixCache::~PrefixCache() = default;
+
+void PrefixCache::SetMaxTokens(size_t max_tokens) {
+    std::vector<EntryId> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        max_tokens_ = max_tokens;
+        EvictToBudgetLocked(evicted);
+    }
+    Notify(evicted);
+}
+
+size_t PrefixCache::GetMaxTokens() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_tokens_;
+}
+
+PrefixCache::EntryId PrefixCache::Match(const int32_t* tokens, size_t n, size_t* matched) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.lookups;
+    stats_.lookup_tokens += n;
+    
+    // Follow edges while the prompt agrees; stopping mid-edge still counts
+    // the tokens compared so far
+    Node* node = &root_;
+    size_t pos = 0;
+    while (pos < n) {
+        auto it = node->children.find(tokens[pos]);
+        if (it == node->children.end()) break;
+        Node* child = it->second.get();
+        const size_t limit = std::min(child->label.size(), n - pos);
+        size_t k = 0;
+        while (k < limit && child->label[k] == tokens[pos + k]) {
+            ++k;
+        }
+        pos += k;
+        node = child;
+        if (k < child->label.size()) break;
+    }
+    
+    *matched = 0;
+    if (pos == 0) {
+        return kNoEntry;
+    }
+    
+    // Every entry below the stopping point starts with the matched tokens;
+    // prefer the one ending here, else walk down to any descendant entry
+    while (node->entry == kNoEntry) {
+        Node* next = nullptr;
+        for (auto& [token, child] : node->children) {
+            if (child->subtree_entries > 0) {
+                next = child.get();
+                break;
+            }
+        }
+        if (!next) return kNoEntry;
+        node = next;
+    }
+    
+    EntryInfo& info = entries_.at(node->entry);
+    lru_.splice(lru_.begin(), lru_, info.lru);
+    ++stats_.hits;
+    stats_.matched_tokens += pos;
+    *matched = pos;
+    return node->entry;
+}
+
+bool PrefixCache::Insert(const int32_t* tokens, size_t n, EntryId id) {
+    std::vector<EntryId> evicted;
+    bool inserted = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (n == 0 || n > max_tokens_ || id == kNoEntry || entries_.count(id)) {
+            return false;
+        }
+        
+        Node* node = &root_;
+        size_t pos = 0;
+        while (pos < n) {
+            auto it = node->children.find(tokens[pos]);
+            if (it == node->children.end()) {
+                // New leaf carrying the rest of the prompt
+                auto leaf = std::make_unique<Node>();
+                leaf->label.assign(tokens + pos, tokens + n);
+                leaf->parent = node;
+                Node* raw = leaf.get();
+                node->children.emplace(tokens[pos], std::move(leaf));
+                node = raw;
+                pos = n;
+                break;
+            }
+            
+            Node* child = it->second.get();
+            const size_t limit = std::min(child->label.size(), n - pos);
+            size_t k = 0;
+            while (k < limit && child->label[k] == tokens[pos + k]) {
+                ++k;
+            }
+            if (k < child->label.size()) {
+                // Split the edge: a new interior node takes the shared part
+                auto mid = std::make_unique<Node>();
+                mid->label.assign(child->label.begin(), child->label.begin() + k);
+                mid->parent = node;
+                mid->subtree_entries = child->subtree_entries;
+                std::unique_ptr<Node> tail = std::move(it->second);
+                tail->label.erase(tail->label.begin(), tail->label.begin() + k);
+                tail->parent = mid.get();
+                const int32_t tail_key = tail->label.front();
+                mid->children.emplace(tail_key, std::move(tail));
+                it->second = std::move(mid);
+                child = it->second.get();
+            }
+            node = child;
+            pos += k;
+        }
+        
+        if (node->entry != kNoEntry) {
+            // Same prompt already cached: keep the existing entry warm
+            lru_.splice(lru_.begin(), lru_, entries_.at(node->entry).lru);
+            PruneLocked(node);
+            return false;
+        }
+        
+        node->entry = id;
+        for (Node* up = node; up; up = up->parent) {
+            ++up->subtree_entries;
+        }
+        lru_.push_front(id);
+        entries_[id] = EntryInfo{node, n, lru_.begin()};
+        ++stats_.entries;
+        stats_.cached_tokens += n;
+        inserted = true;
+        
+        EvictToBudgetLocked(evicted);
+    }
+    Notify(evicted);
+    return inserted;
+}
+
+bool PrefixCache::Erase(EntryId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!entries_.count(id)) {
+        return false;
+    }
+    EraseLocked(id);
+    return true;
+}
+
+void PrefixCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    root_.children.clear();
+    root_.entry = kNoEntry;
+    root_.subtree_entries = 0;
+    entries_.clear();
+    lru_.clear();
+    stats_.entries = 0;
+    stats_.cached_tokens = 0;
+}
+
+PrefixCacheStats PrefixCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void PrefixCache::EraseLocked(EntryId id) {
+    auto it = entries_.find(id);
+    Node* node = it->second.node;
+    stats_.cached_tokens -= it->second.length;
+    --stats_.entries;
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+    
+    node->entry = kNoEntry;
+    for (Node* up = node; up; up = up->parent) {
+        --up->subtree_entries;
+    }
+    PruneLocked(node);
+}
+
+void PrefixCache::EvictToBudgetLocked(std::vector<EntryId>& evicted) {
+    while (stats_.cached_tokens > max_tokens_ && !lru_.empty()) {
+        const EntryId victim = lru_.back();
+        EraseLocked(victim);
+        evicted.push_back(victim);
+        ++stats_.evictions;
+    }
+}
+
+void PrefixCache::PruneLocked(Node* node) {
+    // Drop entry-less leaves up the path
+    while (node != &root_ && node->entry == kNoEntry && node->children.empty()) {
+        Node* parent = node->parent;
+        parent->children.erase(node->label.front());
+        node = parent;
+    }
+    
+    // Fold an entry-less pass-through node into its only child
+    if (node != &root_ && node->entry == kNoEntry && node->children.size() == 1) {
+        Node* parent = node->parent;
+        std::unique_ptr<Node> child = std::move(node->children.begin()->second);
+        child->label.insert(child->label.begin(), node->label.begin(), node->label.end());
+        child->parent = parent;
+        const int32_t key = child->label.front();
+        parent->children[key] = std::move(child);  // Destroys node
+    }
+}
+
+void PrefixCache::Notify(const std::vector<EntryId>& evicted) {
+    if (on_evict_) {
+        for (EntryId id : evicted) {
+            on_evict_(id);
+        }
+    }
+}
@@ -115,10 +115,15 @@ MainWindow::MainWindow(QWidget* parent)
     m_currentStreamId = 0;
     
         // Connect streaming signals (adapt signature qint64,QString -> QString)
+        // (only for the request being streamed; others are shown by showInferenceResult)
         connect(m_inferenceEngine, &InferenceEngine::streamToken,
-            this, [this](qint64 /*reqId*/, const QString& token) { m_streamer->pushToken(token); });
+            this, [this](qint64 reqId, const QString& token) {
+                if (m_streamingMode && reqId == m_currentStreamId) m_streamer->pushToken(token);
+            });
         connect(m_inferenceEngine, &InferenceEngine::streamFinished,
-            this, [this](qint64 /*reqId*/) { m_streamer->finishStream(); });
+            this, [this](qint64 reqId) {
+                if (m_streamingMode && reqId == m_currentStreamId) m_streamer->finishStream();
+            });
     
     // Set dark theme
     applyDarkTheme();
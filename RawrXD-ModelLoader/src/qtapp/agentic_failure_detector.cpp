@@ -2,6 +2,7 @@
 #include "agentic_failure_detector.hpp"
 #include <QDebug>
 #include <QRegularExpression>
+#include <QPointer>
 #include <algorithm>
 
 AgenticFailureDetector::AgenticFailureDetector(QObject* parent)
@@ -21,6 +22,17 @@ void AgenticFailureDetector::initializePatterns()
     initializeDefaultRefusalPatterns();
     initializeDefaultHallucinationPatterns();
     initializeDefaultSafetyPatterns();
+    rebuildPatternSet();
+}
+
+void AgenticFailureDetector::rebuildPatternSet()
+{
+    auto patterns = std::make_shared<FailurePatternSet>();
+    for (const QString& pattern : m_safetyPatterns) patterns->add(pattern, FailureType::SafetyViolation);
+    for (const QString& pattern : m_refusalPatterns) patterns->add(pattern, FailureType::Refusal);
+    for (const QString& pattern : m_hallucinationPatterns) patterns->add(pattern, FailureType::Hallucination);
+    patterns->build();
+    m_patternSet = patterns;
 }
 
 void AgenticFailureDetector::initializeDefaultRefusalPatterns()
@@ -410,6 +422,7 @@ void AgenticFailureDetector::addRefusalPattern(const QString& pattern)
     QMutexLocker locker(&m_mutex);
     if (!m_refusalPatterns.contains(pattern)) {
         m_refusalPatterns.append(pattern);
+        rebuildPatternSet();
     }
 }
 
@@ -418,6 +431,7 @@ void AgenticFailureDetector::addHallucinationPattern(const QString& pattern)
     QMutexLocker locker(&m_mutex);
     if (!m_hallucinationPatterns.contains(pattern)) {
         m_hallucinationPatterns.append(pattern);
+        rebuildPatternSet();
     }
 }
 
@@ -426,6 +440,7 @@ void AgenticFailureDetector::addSafetyPattern(const QString& pattern)
     QMutexLocker locker(&m_mutex);
     if (!m_safetyPatterns.contains(pattern)) {
         m_safetyPatterns.append(pattern);
+        rebuildPatternSet();
     }
 }
 
@@ -435,6 +450,55 @@ void AgenticFailureDetector::clearPatterns()
     m_refusalPatterns.clear();
     m_hallucinationPatterns.clear();
     m_safetyPatterns.clear();
+    rebuildPatternSet();
+}
+
+StreamingFailureDetector AgenticFailureDetector::createStream() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    StreamingFailureDetector::Options options;
+    options.refusal = m_enableRefusalDetection;
+    options.hallucination = m_enableHallucinationDetection;
+    options.safety = m_enableSafetyDetection;
+    options.loops = m_enableLoopDetection;
+    options.refusalThreshold = m_refusalThreshold;
+    options.repeatThreshold = m_repetitionThreshold;
+    options.tokenGram = m_loopNGram;
+    options.charGram = m_loopNGram * 2;
+    options.window = m_loopWindow;
+    
+    // Streams may outlive the detector; report only while it exists
+    QPointer<AgenticFailureDetector> self(const_cast<AgenticFailureDetector*>(this));
+    return StreamingFailureDetector(m_patternSet, options, [self](const FailureDetection& detection) {
+        if (self) {
+            self->recordStreamFailure(detection);
+        }
+    });
+}
+
+void AgenticFailureDetector::setLoopNGram(int tokens, int window)
+{
+    QMutexLocker locker(&m_mutex);
+    m_loopNGram = std::max(2, tokens);
+    m_loopWindow = std::max(m_loopNGram, window);
+}
+
+void AgenticFailureDetector::recordStreamFailure(const FailureDetection& detection)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        switch (detection.type) {
+            case FailureType::Refusal:         m_stats.refusalsDetected++; break;
+            case FailureType::Hallucination:   m_stats.hallucinationsDetected++; break;
+            case FailureType::InfiniteLoop:    m_stats.loopsDetected++; break;
+            case FailureType::SafetyViolation: m_stats.safetyViolations++; break;
+            default: break;
+        }
+        m_stats.totalDetections++;
+    }
+    
+    emit failureDetected(detection.type, detection.confidence, detection.description);
 }
 
 // Threshold configuration
@@ -7,38 +7,8 @@
 #include <QRegularExpression>
 #include <QHash>
 #include <QMutex>
-
-// Types of failures the detector can identify
-enum class FailureType {
-    None,
-    Refusal,              // Model refuses to answer
-    Hallucination,        // Model generates false information
-    FormatViolation,      // Output doesn't match expected format
-    InfiniteLoop,         // Model repeats itself endlessly
-    QualityDegradation,   // Response quality drops below threshold
-    ToolMisuse,           // Incorrect tool/function calling
-    ContextLoss,          // Model loses track of conversation context
-    SafetyViolation       // Unsafe or harmful content
-};
-
-// Failure detection result
-struct FailureDetection {
-    FailureType type = FailureType::None;
-    double confidence = 0.0;      // 0.0 to 1.0
-    QString description;
-    QString detectedPattern;
-    int position = -1;
-    
-    bool isFailure() const { return type != FailureType::None; }
-    
-    static FailureDetection none() {
-        return FailureDetection{FailureType::None, 0.0, "", "", -1};
-    }
-    
-    static FailureDetection detected(FailureType t, double conf, const QString& desc, const QString& pattern = "") {
-        return FailureDetection{t, conf, desc, pattern, 0};
-    }
-};
+#include <memory>
+#include "streaming_failure_detector.hpp"
 
 class AgenticFailureDetector : public QObject
 {
@@ -61,6 +31,12 @@ public:
     FailureDetection detectContextLoss(const QString& response, const QString& context = "");
     FailureDetection detectSafetyViolation(const QString& response);
     
+    // Incremental detection while a response is generated: phrases and
+    // repetition loops are reported as soon as they appear, so the caller
+    // can stop instead of spending the remaining token budget
+    StreamingFailureDetector createStream() const;
+    void setLoopNGram(int tokens, int window = 2048);
+    
     // Pattern management
     void addRefusalPattern(const QString& pattern);
     void addHallucinationPattern(const QString& pattern);
@@ -115,6 +91,8 @@ private:
     void initializeDefaultRefusalPatterns();
     void initializeDefaultHallucinationPatterns();
     void initializeDefaultSafetyPatterns();
+    void rebuildPatternSet();
+    void recordStreamFailure(const FailureDetection& detection);
     
     // Helper methods
     bool matchesAnyPattern(const QString& text, const QStringList& patterns) const;
@@ -132,11 +110,16 @@ private:
     QStringList m_hallucinationPatterns;
     QStringList m_safetyPatterns;
     
+    // All three lists as one automaton, shared with streams
+    std::shared_ptr<const FailurePatternSet> m_patternSet;
+    
     // Thresholds
     double m_refusalThreshold = 0.7;
     double m_qualityThreshold = 0.5;
     double m_confidenceThreshold = 0.6;
     int m_repetitionThreshold = 3;
+    int m_loopNGram = 32;
+    int m_loopWindow = 2048;
     
     // Flags
     bool m_enableRefusalDetection = true;
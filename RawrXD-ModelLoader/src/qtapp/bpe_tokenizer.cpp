@@ -1,35 +1,89 @@
 #include "bpe_tokenizer.hpp"
 #include <QFile>
 #include <QTextStream>
-#include <QRegularExpression>
+#include <QDataStream>
 #include <QDebug>
 #include <algorithm>
+#include <thread>
+
+namespace {
+
+// Below this many pre-tokens per thread, spawning costs more than it saves
+constexpr size_t kMinPiecesPerThread = 1024;
+
+// Long pre-tokens (hex blobs, base64, long runs of punctuation) rarely repeat
+constexpr size_t kMaxCachedWordBytes = 128;
+
+constexpr uint64_t kEmptyKey = ~uint64_t(0);
+
+enum CharClass : uint8_t { Space, Letter, Number, Other };
+
+// Character classes of the GPT-2 pattern: \s, \p{L}, \p{N} and the rest,
+// with an ASCII fast path
+inline CharClass classify(char32_t cp) {
+    if (cp < 128) {
+        if (cp == ' ' || (cp >= '\t' && cp <= '\r')) return Space;
+        if ((cp | 0x20) >= 'a' && (cp | 0x20) <= 'z') return Letter;
+        if (cp >= '0' && cp <= '9') return Number;
+        return Other;
+    }
+    if (QChar::isSpace(cp)) return Space;
+    if (QChar::isLetter(cp)) return Letter;
+    if (QChar::isNumber(cp)) return Number;
+    return Other;
+}
+
+inline void appendUtf8(std::string& out, char32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(char(cp));
+    } else if (cp < 0x800) {
+        out.push_back(char(0xC0 | (cp >> 6)));
+        out.push_back(char(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(char(0xE0 | (cp >> 12)));
+        out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(char(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(char(0xF0 | (cp >> 18)));
+        out.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(char(0x80 | (cp & 0x3F)));
+    }
+}
+
+inline uint64_t pairKey(int32_t left, int32_t right) {
+    return (uint64_t(uint32_t(left)) << 32) | uint32_t(right);
+}
+
+} // namespace
 
 BPETokenizer::BPETokenizer() {
-    // Initialize byte-level encoding (GPT-2 style)
-    // Maps 256 bytes to 256 unique printable Unicode characters
-    QVector<int> byteVals;
+    // Initialize byte-level encoding (GPT-2 bytes_to_unicode)
+    // Printable bytes map to themselves, the rest to 256, 257, ... in byte order
+    QVector<int> bytes;
     
     // Printable ASCII (33-126)
-    for (int i = 33; i <= 126; ++i) byteVals.append(i);
+    for (int i = 33; i <= 126; ++i) bytes.append(i);
     // Latin-1 supplement (161-172, 174-255)
-    for (int i = 161; i <= 172; ++i) byteVals.append(i);
-    for (int i = 174; i <= 255; ++i) byteVals.append(i);
+    for (int i = 161; i <= 172; ++i) bytes.append(i);
+    for (int i = 174; i <= 255; ++i) bytes.append(i);
     
-    // Fill remaining with shifted values
+    QVector<int> chars = bytes;
     int n = 0;
     for (int b = 0; b < 256; ++b) {
-        if (!byteVals.contains(b)) {
-            byteVals.append(256 + n);
+        if (!bytes.contains(b)) {
+            bytes.append(b);
+            chars.append(256 + n);
             ++n;
         }
     }
     
     // Create bidirectional mapping
     for (int i = 0; i < 256; ++i) {
-        m_byteEncoder[i] = QChar(byteVals[i]);
-        m_byteDecoder[QChar(byteVals[i])] = i;
+        m_byteEncoder[uint8_t(bytes[i])] = QChar(chars[i]);
+        m_byteDecoder[QChar(chars[i])] = uint8_t(bytes[i]);
     }
+    std::fill(std::begin(m_byteTokenIds), std::end(m_byteTokenIds), -1);
 }
 
 bool BPETokenizer::loadFromFiles(const QString& vocabPath, const QString& mergesPath) {
@@ -67,20 +121,21 @@ bool BPETokenizer::loadFromFiles(const QString& vocabPath, const QString& merges
     QTextStream mergesStream(&mergesFile);
     mergesStream.setEncoding(QStringConverter::Utf8);
     
-    int priority = 0;
+    QVector<QPair<QString, QString>> merges;
     while (!mergesStream.atEnd()) {
         QString line = mergesStream.readLine().trimmed();
         if (line.isEmpty() || line.startsWith("#")) continue;
         
         QStringList parts = line.split(' ');
         if (parts.size() >= 2) {
-            QPair<QString, QString> pair(parts[0], parts[1]);
-            m_merges[pair] = priority++;
+            merges.append(qMakePair(parts[0], parts[1]));
         }
     }
     mergesFile.close();
+    buildMergeTable(merges);
+    buildTokenBytes();
     
-    qInfo() << "BPE tokenizer loaded:" << m_vocab.size() << "tokens," << m_merges.size() << "merges";
+    qInfo() << "BPE tokenizer loaded:" << m_vocab.size() << "tokens," << m_merges.count << "merges";
     return true;
 }
 
@@ -108,104 +163,314 @@ bool BPETokenizer::loadFromGGUFMetadata(const QHash<QString, QByteArray>& metada
         }
     }
     
+    QVector<QPair<QString, QString>> merges;
     if (metadata.contains("tokenizer.ggml.merges")) {
         QByteArray mergesData = metadata["tokenizer.ggml.merges"];
         QTextStream stream(mergesData);
         
-        int priority = 0;
         while (!stream.atEnd()) {
             QString line = stream.readLine().trimmed();
             if (line.isEmpty()) continue;
             
             QStringList parts = line.split(' ');
             if (parts.size() >= 2) {
-                QPair<QString, QString> pair(parts[0], parts[1]);
-                m_merges[pair] = priority++;
+                merges.append(qMakePair(parts[0], parts[1]));
             }
         }
     }
+    buildMergeTable(merges);
+    buildTokenBytes();
     
-    qInfo() << "BPE loaded from GGUF:" << m_vocab.size() << "tokens";
+    qInfo() << "BPE loaded from GGUF:" << m_vocab.size() << "tokens," << m_merges.count << "merges";
     return !m_vocab.isEmpty();
 }
 
-QVector<QString> BPETokenizer::byteEncode(const QString& text) {
-    QVector<QString> result;
-    QByteArray utf8 = text.toUtf8();
+void BPETokenizer::buildMergeTable(const QVector<QPair<QString, QString>>& merges) {
+    for (int b = 0; b < 256; ++b) {
+        m_byteTokenIds[b] = m_vocab.value(QString(m_byteEncoder.value(uint8_t(b))), -1);
+    }
     
-    for (uint8_t byte : utf8) {
-        result.append(QString(m_byteEncoder[byte]));
+    // Rank is the line index. A rule is only reachable on ids when both sides
+    // and their concatenation are vocabulary tokens, which holds for every
+    // rule of a consistent GPT-2 style vocabulary.
+    std::vector<std::pair<uint64_t, MergeRule>> entries;
+    entries.reserve(size_t(merges.size()));
+    for (int rank = 0; rank < merges.size(); ++rank) {
+        const QPair<QString, QString>& merge = merges[rank];
+        const int32_t left = m_vocab.value(merge.first, -1);
+        const int32_t right = m_vocab.value(merge.second, -1);
+        const int32_t merged = m_vocab.value(merge.first + merge.second, -1);
+        if (left < 0 || right < 0 || merged < 0) continue;
+        entries.push_back({pairKey(left, right), MergeRule{rank, merged}});
     }
+    m_merges.build(entries);
     
-    return result;
+    // Cached ids belong to the previous vocabulary
+    std::lock_guard<std::mutex> lock(m_wordCache.mutex);
+    m_wordCache.index.clear();
+    m_wordCache.lru.clear();
 }
 
-QPair<int, int> BPETokenizer::findBestMergePair(const QVector<QString>& tokens) {
-    int bestIdx = -1;
-    int bestPriority = INT_MAX;
-    
-    for (int i = 0; i < tokens.size() - 1; ++i) {
-        QPair<QString, QString> pair(tokens[i], tokens[i + 1]);
-        
-        if (m_merges.contains(pair)) {
-            int priority = m_merges[pair];
-            if (priority < bestPriority) {
-                bestPriority = priority;
-                bestIdx = i;
+void BPETokenizer::buildTokenBytes() {
+    // Undo the byte-to-unicode mapping once per token so decoding is a copy
+    int32_t maxId = -1;
+    for (auto it = m_reverseVocab.constBegin(); it != m_reverseVocab.constEnd(); ++it) {
+        maxId = std::max(maxId, it.key());
+    }
+    m_tokenBytes.assign(size_t(maxId + 1), std::string());
+    for (auto it = m_reverseVocab.constBegin(); it != m_reverseVocab.constEnd(); ++it) {
+        if (it.key() < 0) continue;
+        std::string& bytes = m_tokenBytes[size_t(it.key())];
+        for (QChar ch : it.value()) {
+            auto byte = m_byteDecoder.constFind(ch);
+            if (byte != m_byteDecoder.constEnd()) {
+                bytes.push_back(char(byte.value()));
             }
         }
     }
+}
+
+void BPETokenizer::MergeTable::build(const std::vector<std::pair<uint64_t, MergeRule>>& entries) {
+    size_t slots = 16;
+    shift = 60;
+    while (slots < entries.size() * 2) {
+        slots <<= 1;
+        --shift;
+    }
+    mask = slots - 1;
+    keys.assign(slots, kEmptyKey);
+    rules.assign(slots, MergeRule{0, 0});
+    count = 0;
     
-    return QPair<int, int>(bestIdx, bestPriority);
+    for (const auto& entry : entries) {
+        uint64_t slot = (entry.first * 0x9E3779B97F4A7C15ull) >> shift;
+        while (keys[slot] != kEmptyKey && keys[slot] != entry.first) {
+            slot = (slot + 1) & mask;
+        }
+        if (keys[slot] == entry.first) continue;  // Duplicate: the earlier rank wins
+        keys[slot] = entry.first;
+        rules[slot] = entry.second;
+        ++count;
+    }
+}
+
+const BPETokenizer::MergeRule* BPETokenizer::MergeTable::find(int32_t left, int32_t right) const {
+    if (count == 0 || left < 0 || right < 0) return nullptr;
+    const uint64_t key = pairKey(left, right);
+    uint64_t slot = (key * 0x9E3779B97F4A7C15ull) >> shift;
+    while (keys[slot] != kEmptyKey) {
+        if (keys[slot] == key) return &rules[slot];
+        slot = (slot + 1) & mask;
+    }
+    return nullptr;
 }
 
-QVector<QString> BPETokenizer::applyBPE(const QVector<QString>& tokens) {
-    if (tokens.size() <= 1) return tokens;
+void BPETokenizer::splitText(const QString& text, std::string& utf8, std::vector<Piece>& pieces) const {
+    // Hand-rolled equivalent of the GPT-2 pattern
+    //   's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
+    // over code points, producing UTF-8 byte ranges
+    std::vector<char32_t> cps;
+    std::vector<uint32_t> offsets;
+    cps.reserve(size_t(text.size()));
+    offsets.reserve(size_t(text.size()) + 1);
+    utf8.clear();
+    utf8.reserve(size_t(text.size()) + 16);
     
-    QVector<QString> result = tokens;
+    const QChar* chars = text.constData();
+    const qsizetype length = text.size();
+    for (qsizetype i = 0; i < length; ++i) {
+        char32_t cp = chars[i].unicode();
+        if (QChar::isHighSurrogate(cp) && i + 1 < length && chars[i + 1].isLowSurrogate()) {
+            cp = QChar::surrogateToUcs4(chars[i], chars[i + 1]);
+            ++i;
+        } else if (QChar::isSurrogate(cp)) {
+            cp = 0xFFFD;
+        }
+        offsets.push_back(uint32_t(utf8.size()));
+        cps.push_back(cp);
+        appendUtf8(utf8, cp);
+    }
+    offsets.push_back(uint32_t(utf8.size()));
     
-    while (true) {
-        QPair<int, int> best = findBestMergePair(result);
-        if (best.first == -1) break;  // No more merges possible
-        
-        int idx = best.first;
-        QString merged = result[idx] + result[idx + 1];
+    const size_t n = cps.size();
+    pieces.clear();
+    pieces.reserve(n / 4 + 1);
+    auto emit = [&](size_t from, size_t to) {
+        pieces.push_back(Piece{offsets[from], offsets[to] - offsets[from]});
+    };
+    
+    size_t i = 0;
+    while (i < n) {
+        const char32_t c = cps[i];
         
-        QVector<QString> newResult;
-        for (int i = 0; i < result.size(); ++i) {
-            if (i == idx) {
-                newResult.append(merged);
-                ++i;  // Skip next token (already merged)
-            } else if (i < result.size()) {
-                newResult.append(result[i]);
+        // Contractions
+        if (c == '\'' && i + 1 < n) {
+            const char32_t c1 = cps[i + 1];
+            const char32_t c2 = i + 2 < n ? cps[i + 2] : 0;
+            size_t len = 0;
+            if (c1 == 's' || c1 == 't' || c1 == 'm' || c1 == 'd') {
+                len = 2;
+            } else if ((c1 == 'r' && c2 == 'e') || (c1 == 'v' && c2 == 'e') || (c1 == 'l' && c2 == 'l')) {
+                len = 3;
+            }
+            if (len) {
+                emit(i, i + len);
+                i += len;
+                continue;
             }
         }
         
-        result = newResult;
-        if (result.size() <= 1) break;
+        const CharClass cls = classify(c);
+        if (cls != Space || (c == ' ' && i + 1 < n && classify(cps[i + 1]) != Space)) {
+            // Optional leading space, then a run of one class
+            const size_t start = i;
+            if (c == ' ') ++i;
+            const CharClass run = classify(cps[i]);
+            while (i < n && classify(cps[i]) == run) ++i;
+            emit(start, i);
+        } else {
+            // Whitespace; before a non-space the last character is left to
+            // lead the next pre-token
+            size_t end = i;
+            while (end < n && classify(cps[end]) == Space) ++end;
+            if (end < n && end - i > 1) --end;
+            emit(i, end);
+            i = end;
+        }
     }
+}
+
+QStringList BPETokenizer::preTokenize(const QString& text) const {
+    std::string utf8;
+    std::vector<Piece> pieces;
+    splitText(text, utf8, pieces);
     
+    QStringList result;
+    result.reserve(qsizetype(pieces.size()));
+    for (const Piece& piece : pieces) {
+        result.append(QString::fromUtf8(utf8.data() + piece.offset, qsizetype(piece.length)));
+    }
     return result;
 }
 
-QVector<BPETokenizer::TextSplit> BPETokenizer::splitText(const QString& text) {
-    QVector<TextSplit> splits;
+void BPETokenizer::mergeWord(std::string_view word, std::vector<int32_t>& out) const {
+    // Symbols form a linked list over the word's bytes; the heap holds every
+    // adjacent pair with a merge rule, ordered by (rank, position) so the
+    // lowest-ranked leftmost pair merges first. Entries made stale by an
+    // earlier merge are detected on pop and skipped.
+    struct Symbol {
+        int32_t id;
+        int32_t prev;
+        int32_t next;
+    };
+    struct Candidate {
+        int32_t rank;
+        int32_t left;
+        int32_t right;
+        int32_t leftId;
+        int32_t rightId;
+        int32_t merged;
+    };
+    thread_local std::vector<Symbol> symbols;
+    thread_local std::vector<Candidate> heap;
+    
+    const int32_t n = int32_t(word.size());
+    symbols.resize(size_t(n));
+    for (int32_t i = 0; i < n; ++i) {
+        symbols[size_t(i)] = Symbol{m_byteTokenIds[uint8_t(word[size_t(i)])], i - 1, i + 1 < n ? i + 1 : -1};
+    }
+    
+    auto later = [](const Candidate& a, const Candidate& b) {
+        return a.rank != b.rank ? a.rank > b.rank : a.left > b.left;
+    };
+    auto push = [&](int32_t left, int32_t right) {
+        if (left < 0 || right < 0) return;
+        const int32_t leftId = symbols[size_t(left)].id;
+        const int32_t rightId = symbols[size_t(right)].id;
+        const MergeRule* rule = m_merges.find(leftId, rightId);
+        if (!rule) return;
+        heap.push_back(Candidate{rule->rank, left, right, leftId, rightId, rule->merged});
+        std::push_heap(heap.begin(), heap.end(), later);
+    };
     
-    // GPT-2 style pattern: splits on whitespace, punctuation, contractions
-    QRegularExpression pattern(
-        "'s|'t|'re|'ve|'m|'ll|'d| ?\\p{L}+| ?\\p{N}+| ?[^\\s\\p{L}\\p{N}]+|\\s+(?!\\S)|\\s+"
-    );
+    heap.clear();
+    for (int32_t i = 0; i + 1 < n; ++i) push(i, i + 1);
     
-    QRegularExpressionMatchIterator it = pattern.globalMatch(text);
-    while (it.hasNext()) {
-        QRegularExpressionMatch match = it.next();
-        TextSplit split;
-        split.text = match.captured(0);
-        split.isSpecial = false;
-        splits.append(split);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        const Candidate c = heap.back();
+        heap.pop_back();
+        
+        Symbol& left = symbols[size_t(c.left)];
+        Symbol& right = symbols[size_t(c.right)];
+        if (left.next != c.right || left.id != c.leftId || right.id != c.rightId) continue;
+        
+        left.id = c.merged;
+        left.next = right.next;
+        if (right.next >= 0) symbols[size_t(right.next)].prev = c.left;
+        right.id = -1;
+        right.next = -1;
+        
+        push(left.prev, c.left);
+        push(c.left, left.next);
     }
     
-    return splits;
+    for (int32_t i = n > 0 ? 0 : -1; i >= 0; i = symbols[size_t(i)].next) {
+        const int32_t id = symbols[size_t(i)].id;
+        out.push_back(id >= 0 ? id : m_unkToken);
+    }
+}
+
+bool BPETokenizer::lookupWord(std::string_view word, std::vector<int32_t>& out) {
+    std::lock_guard<std::mutex> lock(m_wordCache.mutex);
+    auto it = m_wordCache.index.find(word);
+    if (it == m_wordCache.index.end()) return false;
+    
+    m_wordCache.lru.splice(m_wordCache.lru.begin(), m_wordCache.lru, it->second);
+    const std::vector<int32_t>& ids = it->second->second;
+    out.insert(out.end(), ids.begin(), ids.end());
+    return true;
+}
+
+void BPETokenizer::storeWord(std::string_view word, const int32_t* ids, size_t count) {
+    if (word.size() > kMaxCachedWordBytes) return;
+    
+    std::lock_guard<std::mutex> lock(m_wordCache.mutex);
+    if (m_wordCache.capacity == 0 || m_wordCache.index.count(word)) return;
+    
+    // Index keys view the string owned by the list node, which never moves
+    m_wordCache.lru.emplace_front(std::string(word), std::vector<int32_t>(ids, ids + count));
+    m_wordCache.index.emplace(m_wordCache.lru.front().first, m_wordCache.lru.begin());
+    if (m_wordCache.lru.size() > m_wordCache.capacity) {
+        m_wordCache.index.erase(m_wordCache.lru.back().first);
+        m_wordCache.lru.pop_back();
+    }
+}
+
+void BPETokenizer::setWordCacheCapacity(size_t words) {
+    std::lock_guard<std::mutex> lock(m_wordCache.mutex);
+    m_wordCache.capacity = words;
+    while (m_wordCache.lru.size() > words) {
+        m_wordCache.index.erase(m_wordCache.lru.back().first);
+        m_wordCache.lru.pop_back();
+    }
+}
+
+void BPETokenizer::encodePieces(const std::string& utf8, const std::vector<Piece>& pieces,
+                                size_t begin, size_t end, std::vector<int32_t>& out) {
+    for (size_t p = begin; p < end; ++p) {
+        const std::string_view word(utf8.data() + pieces[p].offset, pieces[p].length);
+        if (word.size() == 1) {
+            const int32_t id = m_byteTokenIds[uint8_t(word[0])];
+            out.push_back(id >= 0 ? id : m_unkToken);
+            continue;
+        }
+        if (lookupWord(word, out)) continue;
+        
+        const size_t first = out.size();
+        mergeWord(word, out);
+        storeWord(word, out.data() + first, out.size() - first);
+    }
 }
 
 std::vector<int32_t> BPETokenizer::encode(const QString& text) {
@@ -214,26 +479,40 @@ std::vector<int32_t> BPETokenizer::encode(const QString& text) {
         return {};
     }
     
+    std::string utf8;
+    std::vector<Piece> pieces;
+    splitText(text, utf8, pieces);
+    
+    // Pre-tokens merge independently, so contiguous runs of them go to
+    // separate threads and the per-thread outputs concatenate in order
+    size_t threads = m_threadCount > 0 ? size_t(m_threadCount)
+                                       : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, pieces.size() / kMinPiecesPerThread);
+    
     std::vector<int32_t> result;
-    QVector<TextSplit> splits = splitText(text);
+    if (threads <= 1) {
+        result.reserve(utf8.size() / 3 + 1);
+        encodePieces(utf8, pieces, 0, pieces.size(), result);
+        return result;
+    }
     
-    for (const TextSplit& split : splits) {
-        // Byte-level encode the text chunk
-        QVector<QString> byteTokens = byteEncode(split.text);
-        
-        // Apply BPE merges
-        QVector<QString> bpeTokens = applyBPE(byteTokens);
-        
-        // Convert to token IDs
-        for (const QString& token : bpeTokens) {
-            if (m_vocab.contains(token)) {
-                result.push_back(m_vocab[token]);
-            } else {
-                result.push_back(m_unkToken);  // Unknown token
-            }
-        }
+    const size_t perThread = (pieces.size() + threads - 1) / threads;
+    std::vector<std::vector<int32_t>> parts(threads);
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (size_t t = 1; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            const size_t begin = std::min(pieces.size(), t * perThread);
+            encodePieces(utf8, pieces, begin, std::min(pieces.size(), begin + perThread), parts[t]);
+        });
     }
+    encodePieces(utf8, pieces, 0, std::min(pieces.size(), perThread), parts[0]);
+    for (std::thread& worker : workers) worker.join();
     
+    size_t total = 0;
+    for (const auto& part : parts) total += part.size();
+    result.reserve(total);
+    for (const auto& part : parts) result.insert(result.end(), part.begin(), part.end());
     return result;
 }
 
@@ -241,27 +520,25 @@ QString BPETokenizer::decode(const std::vector<int32_t>& tokens) {
     if (!isReady()) return QString();
     
     QByteArray utf8;
-    
     for (int32_t tokenId : tokens) {
-        // Skip special tokens
-        if (tokenId == m_bosToken || tokenId == m_eosToken || tokenId == m_padToken) {
-            continue;
-        }
-        
-        if (!m_reverseVocab.contains(tokenId)) {
+        if (!appendTokenBytes(tokenId, utf8)) {
             qWarning() << "Unknown token ID:" << tokenId;
-            continue;
-        }
-        
-        QString token = m_reverseVocab[tokenId];
-        
-        // Decode byte-level representation back to UTF-8
-        for (QChar ch : token) {
-            if (m_byteDecoder.contains(ch)) {
-                utf8.append(m_byteDecoder[ch]);
-            }
         }
     }
     
     return QString::fromUtf8(utf8);
 }
+
+bool BPETokenizer::appendTokenBytes(int32_t tokenId, QByteArray& out) const {
+    // Skip special tokens
+    if (tokenId == m_bosToken || tokenId == m_eosToken || tokenId == m_padToken) {
+        return true;
+    }
+    if (tokenId < 0 || size_t(tokenId) >= m_tokenBytes.size() || !m_reverseVocab.contains(tokenId)) {
+        return false;
+    }
+    
+    const std::string& bytes = m_tokenBytes[size_t(tokenId)];
+    out.append(bytes.data(), qsizetype(bytes.size()));
+    return true;
+}
@@ -1,9 +1,16 @@
 #pragma once
 #include <QString>
+#include <QByteArray>
+#include <QStringList>
 #include <QHash>
 #include <QVector>
 #include <QPair>
 #include <vector>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <cstdint>
 
 /**
@@ -11,6 +18,12 @@
  * 
  * Implements the BPE algorithm used by GPT-2, GPT-3, and GPT-4 models.
  * Supports both text encoding (str -> tokens) and decoding (tokens -> str).
+ *
+ * Encoding splits text into GPT-2 pre-tokens, then merges each pre-token's
+ * byte tokens independently on integer ids: a (left, right) -> (rank, merged)
+ * hash table plus a heap of candidate pairs over a linked list of symbols.
+ * Merged pre-tokens are kept in a bounded LRU cache, and large inputs are
+ * spread across threads in contiguous runs of pre-tokens.
  */
 class BPETokenizer {
 public:
@@ -46,15 +59,45 @@ public:
      */
     QString decode(const std::vector<int32_t>& tokens);
     
+    /**
+     * @brief Append the UTF-8 bytes of one token (nothing for BOS/EOS/PAD)
+     * @return false if the id is not in the vocabulary
+     *
+     * A token may end inside a multi-byte character; StreamingDetokenizer
+     * joins such fragments across tokens.
+     */
+    bool appendTokenBytes(int32_t tokenId, QByteArray& out) const;
+    
+    /**
+     * @brief Split text into the GPT-2 pre-tokens that BPE merges independently
+     */
+    QStringList preTokenize(const QString& text) const;
+    
+    /**
+     * @brief Threads used by encode() on large inputs (0 = hardware concurrency)
+     */
+    void setThreadCount(int threads) { m_threadCount = threads; }
+    int threadCount() const { return m_threadCount; }
+    
+    /**
+     * @brief Bound the pre-token -> ids cache (0 disables caching)
+     */
+    void setWordCacheCapacity(size_t words);
+    
     /**
      * @brief Get vocabulary size
      */
     int vocabSize() const { return m_vocab.size(); }
     
+    /**
+     * @brief Number of merge rules usable on vocabulary ids
+     */
+    int mergeCount() const { return int(m_merges.count); }
+    
     /**
      * @brief Check if tokenizer is ready
      */
-    bool isReady() const { return !m_vocab.isEmpty() && !m_merges.isEmpty(); }
+    bool isReady() const { return !m_vocab.isEmpty() && m_merges.count > 0; }
     
     /**
      * @brief Get special token IDs
@@ -65,14 +108,47 @@ public:
     int32_t unkToken() const { return m_unkToken; }
 
 private:
-    // Core BPE algorithm
-    QVector<QString> byteEncode(const QString& text);
-    QVector<QString> applyBPE(const QVector<QString>& tokens);
-    QPair<int, int> findBestMergePair(const QVector<QString>& tokens);
+    // Merge of an adjacent (left, right) id pair: lower rank merges first
+    struct MergeRule {
+        int32_t rank;
+        int32_t merged;
+    };
+    
+    // Open-addressed (left << 32 | right) -> rule table with linear probing
+    struct MergeTable {
+        std::vector<uint64_t> keys;
+        std::vector<MergeRule> rules;
+        uint64_t mask{0};
+        int shift{64};
+        size_t count{0};
+        
+        void build(const std::vector<std::pair<uint64_t, MergeRule>>& entries);
+        const MergeRule* find(int32_t left, int32_t right) const;
+    };
+    
+    // Bounded LRU cache of merged pre-tokens, shared by encode threads
+    struct WordCache {
+        using Entry = std::pair<std::string, std::vector<int32_t>>;
+        std::list<Entry> lru;  // Front = most recently used
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        size_t capacity{8192};
+        std::mutex mutex;
+    };
+    
+    // Pre-token as a byte range of the UTF-8 text
+    struct Piece {
+        uint32_t offset;
+        uint32_t length;
+    };
     
-    // Byte-level encoding helpers
-    QString byteToUnicode(uint8_t byte);
-    uint8_t unicodeToByte(QChar ch);
+    void splitText(const QString& text, std::string& utf8, std::vector<Piece>& pieces) const;
+    void buildMergeTable(const QVector<QPair<QString, QString>>& merges);
+    void buildTokenBytes();
+    void encodePieces(const std::string& utf8, const std::vector<Piece>& pieces,
+                      size_t begin, size_t end, std::vector<int32_t>& out);
+    void mergeWord(std::string_view word, std::vector<int32_t>& out) const;
+    bool lookupWord(std::string_view word, std::vector<int32_t>& out);
+    void storeWord(std::string_view word, const int32_t* ids, size_t count);
     
     // Vocabulary: token string -> token ID
     QHash<QString, int32_t> m_vocab;
@@ -80,8 +156,14 @@ private:
     // Reverse vocabulary: token ID -> token string
     QHash<int32_t, QString> m_reverseVocab;
     
-    // BPE merge rules: (token1, token2) -> priority
-    QHash<QPair<QString, QString>, int> m_merges;
+    // Byte-decoded UTF-8 of each token id (empty for unused ids)
+    std::vector<std::string> m_tokenBytes;
+    
+    // BPE merge rules on token ids
+    MergeTable m_merges;
+    
+    // Token id of each single-byte symbol (-1 if missing from the vocabulary)
+    int32_t m_byteTokenIds[256];
     
     // Special tokens
     int32_t m_bosToken{1};      // Beginning of sequence
@@ -93,10 +175,6 @@ private:
     QHash<uint8_t, QChar> m_byteEncoder;
     QHash<QChar, uint8_t> m_byteDecoder;
     
-    // Precompiled regex pattern cache for text splitting
-    struct TextSplit {
-        QString text;
-        bool isSpecial;
-    };
-    QVector<TextSplit> splitText(const QString& text);
+    WordCache m_wordCache;
+    int m_threadCount{0};
 };
@@ -0,0 +1,173 @@
+// byte_rewrite_engine.cpp - Aho-Corasick byte rewriting with carry-over between chunks
+#include "byte_rewrite_engine.hpp"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+namespace {
+
+// Append bytes [from, to) of the virtual buffer held + data, where negative
+// positions index into held
+void appendRange(const QByteArray& held, const char* data, qsizetype from, qsizetype to, QByteArray& out) {
+    if (from >= to) return;
+    if (from < 0) {
+        const qsizetype heldEnd = std::min<qsizetype>(to, 0);
+        out.append(held.constData() + held.size() + from, heldEnd - from);
+        from = 0;
+    }
+    if (to > from) {
+        out.append(data + from, to - from);
+    }
+}
+
+} // namespace
+
+void ByteRewriteEngine::add(const QByteArray& pattern, const QByteArray& replacement) {
+    if (pattern.isEmpty()) return;
+    m_rules.push_back(Rule{pattern, replacement});
+}
+
+void ByteRewriteEngine::clear() {
+    m_rules.clear();
+    m_next.clear();
+    m_match.clear();
+    m_depth.clear();
+    std::memset(m_class, 0, sizeof(m_class));
+    m_classCount = 1;
+    m_maxPattern = 0;
+}
+
+void ByteRewriteEngine::build() {
+    // Column per byte value that occurs in some pattern; the rest share column 0
+    std::memset(m_class, 0, sizeof(m_class));
+    m_classCount = 1;
+    m_maxPattern = 0;
+    for (const Rule& rule : m_rules) {
+        for (char ch : rule.pattern) {
+            uint16_t& column = m_class[uint8_t(ch)];
+            if (column == 0) column = uint16_t(m_classCount++);
+        }
+        m_maxPattern = std::max(m_maxPattern, int(rule.pattern.size()));
+    }
+
+    const size_t width = size_t(m_classCount);
+    m_next.assign(width, -1);
+    m_match.assign(1, -1);
+    m_depth.assign(1, 0);
+
+    // Trie; -1 marks a missing edge until the table is completed below
+    for (int r = 0; r < int(m_rules.size()); ++r) {
+        int32_t state = 0;
+        for (char ch : m_rules[size_t(r)].pattern) {
+            const size_t slot = size_t(state) * width + m_class[uint8_t(ch)];
+            int32_t next = m_next[slot];
+            if (next < 0) {
+                next = int32_t(m_match.size());
+                m_next[slot] = next;
+                m_next.resize(m_next.size() + width, -1);
+                m_match.push_back(-1);
+                m_depth.push_back(m_depth[size_t(state)] + 1);
+            }
+            state = next;
+        }
+        // Duplicate patterns keep the first rule
+        if (m_match[size_t(state)] < 0) {
+            m_match[size_t(state)] = r;
+        }
+    }
+
+    // Breadth-first, so a node's failure state already has a complete row and
+    // a final match: a node without its own pattern reports the longest one
+    // ending at its failure state
+    std::vector<int32_t> fail(m_match.size(), 0);
+    std::deque<int32_t> queue;
+    for (size_t c = 0; c < width; ++c) {
+        int32_t& next = m_next[c];
+        if (next < 0) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    while (!queue.empty()) {
+        const int32_t state = queue.front();
+        queue.pop_front();
+        const size_t row = size_t(state) * width;
+        const size_t failRow = size_t(fail[size_t(state)]) * width;
+        if (m_match[size_t(state)] < 0) {
+            m_match[size_t(state)] = m_match[size_t(fail[size_t(state)])];
+        }
+        for (size_t c = 0; c < width; ++c) {
+            int32_t& next = m_next[row + c];
+            if (next < 0) {
+                next = m_next[failRow + c];
+            } else {
+                fail[size_t(next)] = m_next[failRow + c];
+                queue.push_back(next);
+            }
+        }
+    }
+}
+
+int ByteRewriteEngine::rewrite(Stream& stream, const char* data, qsizetype size, QByteArray& out) const {
+    const qsizetype heldSize = stream.held.size();
+    if (m_next.empty()) {
+        out.append(stream.held);
+        out.append(data, size);
+        stream.held.clear();
+        stream.state = 0;
+        return 0;
+    }
+
+    out.reserve(out.size() + heldSize + size);
+    const size_t width = size_t(m_classCount);
+    const int32_t* next = m_next.data();
+    const int32_t* match = m_match.data();
+    int32_t state = stream.state;
+    qsizetype written = -heldSize;  // First byte of held + data not yet in out
+    int replaced = 0;
+
+    for (qsizetype i = 0; i < size; ++i) {
+        state = next[size_t(state) * width + m_class[uint8_t(data[i])]];
+        const int32_t r = match[state];
+        if (r < 0) continue;
+
+        const Rule& rule = m_rules[size_t(r)];
+        appendRange(stream.held, data, written, i + 1 - rule.pattern.size(), out);
+        out.append(rule.replacement);
+        written = i + 1;
+        state = 0;
+        ++replaced;
+        if (stream.hits.size() < m_rules.size()) stream.hits.resize(m_rules.size(), 0);
+        ++stream.hits[size_t(r)];
+    }
+
+    // Everything but a possible match in progress is final
+    const qsizetype keep = m_depth[size_t(state)];
+    appendRange(stream.held, data, written, size - keep, out);
+    if (keep <= size) {
+        stream.held = QByteArray(data + size - keep, keep);
+    } else {
+        QByteArray carried(stream.held.constData() + heldSize - (keep - size), keep - size);
+        carried.append(data, size);
+        stream.held = carried;
+    }
+    stream.state = state;
+    stream.replacements += replaced;
+    return replaced;
+}
+
+void ByteRewriteEngine::finish(Stream& stream, QByteArray& out) const {
+    out.append(stream.held);
+    stream.held.clear();
+    stream.state = 0;
+}
+
+QByteArray ByteRewriteEngine::rewriteAll(const QByteArray& data, Stream* stats) const {
+    Stream local;
+    Stream& stream = stats ? *stats : local;
+    QByteArray out;
+    rewrite(stream, data, out);
+    finish(stream, out);
+    return out;
+}
@@ -0,0 +1,75 @@
+// byte_rewrite_engine.hpp - Single-pass multi-pattern search and replace over byte streams
+#pragma once
+
+#include <QByteArray>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Aho-Corasick automaton that rewrites every rule's pattern in one pass
+ *
+ * All search patterns are compiled into one DFA over byte classes (bytes that
+ * occur in no pattern share a class), so each input byte costs one table
+ * lookup however many rules are loaded. Text between matches is copied to the
+ * output in bulk and each match appends its replacement; nothing is rescanned.
+ *
+ * Matching is non-overlapping and greedy by end position: a match is taken as
+ * soon as a pattern ends, the longest pattern ending there wins, and scanning
+ * restarts after it. For a single rule this is exactly QByteArray::replace().
+ * Replacement bytes are never matched again.
+ *
+ * Streams keep the automaton state between chunks and hold back only the
+ * bytes of a possible match in progress (at most the longest pattern minus
+ * one), so patterns split across chunk boundaries are still rewritten.
+ * Immutable after build(); one Stream per response.
+ */
+class ByteRewriteEngine {
+public:
+    struct Stream {
+        int32_t state{0};
+        QByteArray held;            // Unwritten bytes of a partial match
+        qint64 replacements{0};
+        std::vector<qint64> hits;   // Replacements per rule, sized on first match
+    };
+
+    void add(const QByteArray& pattern, const QByteArray& replacement);
+    void build();
+    void clear();
+
+    bool isEmpty() const { return m_rules.empty(); }
+    int ruleCount() const { return int(m_rules.size()); }
+    int maxPatternLength() const { return m_maxPattern; }
+
+    /**
+     * @brief Rewrite the next chunk of a stream, appending finished bytes to out
+     * @return Replacements made in this chunk
+     */
+    int rewrite(Stream& stream, const char* data, qsizetype size, QByteArray& out) const;
+    int rewrite(Stream& stream, const QByteArray& chunk, QByteArray& out) const {
+        return rewrite(stream, chunk.constData(), chunk.size(), out);
+    }
+
+    /**
+     * @brief End of stream: write any held-back bytes and reset the state
+     */
+    void finish(Stream& stream, QByteArray& out) const;
+
+    /**
+     * @brief Rewrite a complete buffer
+     */
+    QByteArray rewriteAll(const QByteArray& data, Stream* stats = nullptr) const;
+
+private:
+    struct Rule {
+        QByteArray pattern;
+        QByteArray replacement;
+    };
+
+    std::vector<Rule> m_rules;
+    uint16_t m_class[256] = {};     // Byte -> column; 0 for bytes in no pattern
+    int m_classCount{1};
+    int m_maxPattern{0};
+    std::vector<int32_t> m_next;    // nodes x m_classCount complete transition table
+    std::vector<int32_t> m_match;   // Longest rule ending at each node, -1 if none
+    std::vector<int32_t> m_depth;   // Bytes held back while in each node
+};
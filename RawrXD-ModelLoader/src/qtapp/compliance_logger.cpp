@@ -1,6 +1,10 @@
 #include "compliance_logger.hpp"
 #include <QStandardPaths>
 #include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QTextStream>
+#include <QRegularExpression>
 #include <QCryptographicHash>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -9,6 +13,28 @@
 #include <QHostInfo>
 #include <QNetworkInterface>
 
+namespace {
+
+// Plaintext logs from before the segmented format, oldest first: rotated
+// copies (<log>.yyyyMMdd_HHmmss), then the log path itself
+QStringList legacyLogFiles(const QString& logFilePath) {
+    const QFileInfo base(logFilePath);
+    const QDir dir = base.absoluteDir();
+    const QRegularExpression rotated("^" + QRegularExpression::escape(base.fileName()) + "\\.\\d{8}_\\d{6}$");
+    QStringList files;
+    for (const QString& name : dir.entryList(QStringList() << base.fileName() + ".*", QDir::Files, QDir::Name)) {
+        if (rotated.match(name).hasMatch()) {
+            files << dir.filePath(name);
+        }
+    }
+    if (base.isFile()) {
+        files << base.absoluteFilePath();
+    }
+    return files;
+}
+
+} // namespace
+
 ComplianceLogger& ComplianceLogger::instance() {
     static ComplianceLogger instance;
     return instance;
@@ -31,35 +57,38 @@ void ComplianceLogger::start(const QString& logFilePath) {
         return;
     }
     
-    // Default log path
-    if (logFilePath.isEmpty()) {
-        QString appData = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-        m_logFilePath = appData + "/logs/compliance.log";
-    } else {
-        m_logFilePath = logFilePath;
-    }
+    m_logFilePath = logFilePath.isEmpty() ? defaultLogFilePath() : logFilePath;
     
     // Ensure log directory exists
     QFileInfo fi(m_logFilePath);
     QDir().mkpath(fi.absolutePath());
     
-    // Open log file in append mode
-    m_logFile = new QFile(m_logFilePath);
-    if (!m_logFile->open(QIODevice::Append | QIODevice::Text)) {
+    // Segments are written next to the log path: compliance.log.000001.seg
+    AuditLog::Options options = m_options;
+    options.seal = &ComplianceLogger::sealEntry;
+    if (!m_log.open(m_logFilePath.toStdString(), options)) {
         qCritical() << "[ComplianceLogger] Failed to open log file:" << m_logFilePath;
-        delete m_logFile;
-        m_logFile = nullptr;
         return;
     }
     
-    m_logStream = new QTextStream(m_logFile);
+    // Get IP address once (for audit trail); enumerating interfaces per event is slow
+    m_ipAddress.clear();
+    foreach (const QHostAddress &address, QNetworkInterface::allAddresses()) {
+        if (address.protocol() == QAbstractSocket::IPv4Protocol && 
+            !address.isLoopback()) {
+            m_ipAddress = address.toString();
+            break;
+        }
+    }
+    
     m_running = true;
     
     qInfo() << "[ComplianceLogger] Started compliance logging";
     qInfo() << "[ComplianceLogger] Log file:" << m_logFilePath;
-    qInfo() << "[ComplianceLogger] Retention period:" << m_retentionDays << "days";
+    qInfo() << "[ComplianceLogger] Retention period:" << m_retentionDays.load() << "days";
     
-    // Log startup event
+    // Log startup event (after unlocking: m_mutex is not recursive)
+    locker.unlock();
     logEvent(LogLvl_Aud4, EvType_Sys4, "system", "ComplianceLoggingStarted");
 }
 
@@ -75,28 +104,29 @@ void ComplianceLogger::stop() {
     shutdownEntry.eventType = EvType_Sys4;
     shutdownEntry.userId = "system";
     shutdownEntry.action = "ComplianceLoggingStopped";
+    shutdownEntry.ipAddress = m_ipAddress;
     writeLogEntry(shutdownEntry);
     
-    if (m_logStream) {
-        delete m_logStream;
-        m_logStream = nullptr;
-    }
-    
-    if (m_logFile) {
-        m_logFile->close();
-        delete m_logFile;
-        m_logFile = nullptr;
-    }
-    
     m_running = false;
+    
+    // Writes everything still queued and syncs
+    m_log.close();
     qInfo() << "[ComplianceLogger] Stopped";
 }
 
+void ComplianceLogger::setSyncPolicy(AuditLog::SyncPolicy policy, int intervalMs) {
+    QMutexLocker locker(&m_mutex);
+    m_options.sync = policy;
+    m_options.syncIntervalMs = intervalMs;
+}
+
+bool ComplianceLogger::flush() {
+    return m_running && m_log.flush();
+}
+
 void ComplianceLogger::logEvent(LogLevel level, EventType eventType,
                                 const QString& userId, const QString& action,
                                 const QString& resourceId, const QString& details) {
-    QMutexLocker locker(&m_mutex);
-    
     if (!m_running) return;
     
     LogEntry entry;
@@ -107,21 +137,14 @@ void ComplianceLogger::logEvent(LogLevel level, EventType eventType,
     entry.action = action;
     entry.resourceId = resourceId;
     entry.details = details;
+    entry.ipAddress = m_ipAddress;
     
-    // Get IP address (for audit trail)
-    foreach (const QHostAddress &address, QNetworkInterface::allAddresses()) {
-        if (address.protocol() == QAbstractSocket::IPv4Protocol && 
-            !address.isLoopback()) {
-            entry.ipAddress = address.toString();
-            break;
-        }
+    // Queued for the writer thread, which adds the tamper-evident checksum.
+    // Refused after stop(); AuditLog counts it in Stats::dropped
+    if (!writeLogEntry(entry)) {
+        return;
     }
     
-    // Calculate tamper-evident checksum
-    entry.checksum = calculateEntryChecksum(entry);
-    
-    writeLogEntry(entry);
-    
     emit eventLogged(entry);
     
     // Emit security alerts for critical events
@@ -181,27 +204,57 @@ void ComplianceLogger::logSystemError(const QString& component, const QString& e
 QString ComplianceLogger::exportAuditLog(const QDateTime& startDate, const QDateTime& endDate) const {
     QMutexLocker locker(&m_mutex);
     
+    const QString path = m_logFilePath.isEmpty() ? defaultLogFilePath() : m_logFilePath;
+    const qint64 startMs = startDate.toMSecsSinceEpoch();
+    const qint64 endMs = endDate.toMSecsSinceEpoch();
+    
+    // Lines written before the segmented format predate every segment
     QJsonArray entries;
+    const QStringList legacyFiles = legacyLogFiles(path);
+    for (const QString& legacyPath : legacyFiles) {
+        QFile file(legacyPath);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qWarning() << "[ComplianceLogger] Failed to open legacy log for export:" << legacyPath;
+            continue;
+        }
+        QTextStream stream(&file);
+        while (!stream.atEnd()) {
+            const QString line = stream.readLine();
+            if (!line.contains("[AUDIT]") && !line.contains("[SECURITY]")) continue;
+            
+            // "[<ISO timestamp>] [LEVEL] ..."
+            const qsizetype bracket = line.indexOf(']');
+            const QDateTime timestamp = line.startsWith('[') && bracket > 1
+                ? QDateTime::fromString(line.mid(1, bracket - 1), Qt::ISODateWithMs) : QDateTime();
+            if (!timestamp.isValid()) continue;
+            const qint64 ms = timestamp.toMSecsSinceEpoch();
+            if (ms < startMs || ms > endMs) continue;
+            
+            QJsonObject entry;
+            entry["logLine"] = line;
+            entries.append(entry);
+        }
+    }
     
-    QFile file(m_logFilePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (m_running) {
+        // Include everything logged before the call; start() and stop() wait for the read
+        m_log.flush();
+    } else if (!m_log.openReadOnly(path.toStdString())) {
+        // Stopped or never started: the segments on disk are read without writing to them
         qWarning() << "[ComplianceLogger] Failed to open log for export";
-        return QString();
+        if (legacyFiles.isEmpty()) {
+            return QString();
+        }
     }
     
-    QTextStream stream(&file);
-    while (!stream.atEnd()) {
-        QString line = stream.readLine();
-        
-        // Parse log entry (simplified - actual parsing would be more robust)
-        if (line.contains("[AUDIT]") || line.contains("[SECURITY]")) {
+    // Seek by time via the segment index
+    m_log.read(startMs, endMs, [&](const AuditRecord& record) {
+        if (record.tag == LogLvl_Aud4 || record.tag == LogLvl_Sec3) {
             QJsonObject entry;
-            entry["logLine"] = line;
+            entry["logLine"] = QString::fromStdString(record.text);
             entries.append(entry);
         }
-    }
-    
-    file.close();
+    });
     
     QJsonObject root;
     root["exportDate"] = QDateTime::currentDateTime().toString(Qt::ISODate);
@@ -218,67 +271,47 @@ void ComplianceLogger::rotateLogs() {
     
     if (!m_running) return;
     
-    // Close current log
-    if (m_logStream) {
-        delete m_logStream;
-        m_logStream = nullptr;
-    }
-    if (m_logFile) {
-        m_logFile->close();
-        delete m_logFile;
-        m_logFile = nullptr;
-    }
-    
-    // Rename current log with timestamp
-    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss");
-    QString rotatedPath = m_logFilePath + "." + timestamp;
-    
-    QFile::rename(m_logFilePath, rotatedPath);
-    
-    // Open new log
-    m_logFile = new QFile(m_logFilePath);
-    m_logFile->open(QIODevice::Append | QIODevice::Text);
-    m_logStream = new QTextStream(m_logFile);
+    // The next batch starts a new segment; whole segments past retention are deleted
+    m_log.rotate();
+    const QDateTime cutoff = QDateTime::currentDateTime().addDays(-m_retentionDays.load());
+    const size_t expired = m_log.removeSegmentsBefore(cutoff.toMSecsSinceEpoch());
     
-    qInfo() << "[ComplianceLogger] Log rotated to:" << rotatedPath;
+    qInfo() << "[ComplianceLogger] Log rotated, expired segments removed:" << expired;
     
-    // Log rotation event
-    logEvent(LogLvl_Aud4, EvType_Sys4, "system", "LogRotated", rotatedPath);
+    // Log rotation event (after unlocking, as in start())
+    locker.unlock();
+    logEvent(LogLvl_Aud4, EvType_Sys4, "system", "LogRotated", m_logFilePath,
+             QString("Expired segments: %1").arg(expired));
 }
 
 void ComplianceLogger::setRetentionPeriod(int days) {
-    QMutexLocker locker(&m_mutex);
     m_retentionDays = days;
     qInfo() << "[ComplianceLogger] Retention period set to:" << days << "days";
 }
 
-void ComplianceLogger::writeLogEntry(const LogEntry& entry) {
-    if (!m_logStream) return;
-    
-    QString logLine = formatLogEntry(entry);
-    *m_logStream << logLine << "\n";
-    m_logStream->flush();
+bool ComplianceLogger::writeLogEntry(const LogEntry& entry) {
+    // Never blocks on disk; waits only if the writer falls a full ring behind
+    AuditRecord record;
+    record.timestampMs = entry.timestamp.toMSecsSinceEpoch();
+    record.tag = entry.level;
+    record.text = formatLogEntry(entry).toStdString();
+    return m_log.append(std::move(record));
 }
 
-QString ComplianceLogger::calculateEntryChecksum(const LogEntry& entry) const {
-    QCryptographicHash hash(QCryptographicHash::Sha256);
-    
-    QString data = QString("%1|%2|%3|%4|%5|%6|%7|%8")
-        .arg(entry.timestamp.toString(Qt::ISODate))
-        .arg(entry.level)
-        .arg(entry.eventType)
-        .arg(entry.userId)
-        .arg(entry.action)
-        .arg(entry.resourceId)
-        .arg(entry.ipAddress)
-        .arg(entry.details);
-    
-    hash.addData(data.toUtf8());
-    return QString(hash.result().toHex());
+QString ComplianceLogger::defaultLogFilePath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/logs/compliance.log";
+}
+
+void ComplianceLogger::sealEntry(AuditRecord& record) {
+    // Runs on the AuditLog writer thread: tamper-evident checksum over the formatted entry
+    const QByteArray digest = QCryptographicHash::hash(QByteArray::fromStdString(record.text),
+                                                       QCryptographicHash::Sha256).toHex();
+    record.text += " Checksum=";
+    record.text.append(digest.constData(), size_t(digest.size()));
 }
 
 QString ComplianceLogger::formatLogEntry(const LogEntry& entry) const {
-    return QString("[%1] [%2] [%3] User=%4 Action=%5 Resource=%6 IP=%7 Details=%8 Checksum=%9")
+    return QString("[%1] [%2] [%3] User=%4 Action=%5 Resource=%6 IP=%7 Details=%8")
         .arg(entry.timestamp.toString(Qt::ISODateWithMs))
         .arg(logLevelToString(entry.level))
         .arg(eventTypeToString(entry.eventType))
@@ -286,8 +319,7 @@ QString ComplianceLogger::formatLogEntry(const LogEntry& entry) const {
         .arg(entry.action)
         .arg(entry.resourceId)
         .arg(entry.ipAddress)
-        .arg(entry.details)
-        .arg(entry.checksum);
+        .arg(entry.details);
 }
 
 QString ComplianceLogger::eventTypeToString(EventType type) const {
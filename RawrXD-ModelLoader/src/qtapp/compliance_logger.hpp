@@ -2,15 +2,21 @@
 
 #include <QObject>
 #include <QString>
-#include <QFile>
-#include <QTextStream>
 #include <QDateTime>
 #include <QMutex>
 
+#include "audit_log.h"
+
+#include <atomic>
+
 // Enums defined outside class to avoid Windows header conflicts  
 enum ComplianceLogLevel { LogLvl_Info0, LogLvl_Warn1, LogLvl_Err2, LogLvl_Sec3, LogLvl_Aud4 };
 enum ComplianceEventType { EvType_Model0, EvType_Data1, EvType_User2, EvType_Cfg3, EvType_Sys4, EvType_SecViol5 };
 
+// Entries are formatted on the caller's thread and handed to an AuditLog;
+// its writer thread appends the SHA-256 checksum and writes them in batches,
+// so logEvent() never blocks on disk. exportAuditLog() also reads the
+// plaintext compliance.log files written before the segmented format.
 class ComplianceLogger : public QObject {
     Q_OBJECT
 
@@ -27,7 +33,7 @@ public:
         QString resourceId;
         QString ipAddress;
         QString details;
-        QString checksum;
+        QString checksum;   // Added by the writer thread; empty in eventLogged
     };
 
     static ComplianceLogger& instance();
@@ -35,6 +41,8 @@ public:
 
     void start(const QString& logFilePath = QString());
     void stop();
+    void setSyncPolicy(AuditLog::SyncPolicy policy, int intervalMs = 1000);   // Before start()
+    bool flush();
     void logEvent(LogLevel level, EventType eventType, const QString& userId, const QString& action,
                   const QString& resourceId = QString(), const QString& details = QString());
     void logModelAccess(const QString& userId, const QString& modelPath, const QString& action);
@@ -57,16 +65,18 @@ private:
     ComplianceLogger(const ComplianceLogger&) = delete;
     ComplianceLogger& operator=(const ComplianceLogger&) = delete;
 
-    void writeLogEntry(const LogEntry& entry);
-    QString calculateEntryChecksum(const LogEntry& entry) const;
+    bool writeLogEntry(const LogEntry& entry);
+    static QString defaultLogFilePath();
+    static void sealEntry(AuditRecord& record);
     QString formatLogEntry(const LogEntry& entry) const;
     QString eventTypeToString(EventType type) const;
     QString logLevelToString(LogLevel level) const;
 
-    mutable QMutex m_mutex;
-    QFile* m_logFile = nullptr;
-    QTextStream* m_logStream = nullptr;
+    mutable QMutex m_mutex;   // start(), stop(), rotateLogs() and exportAuditLog()
+    mutable AuditLog m_log;   // exportAuditLog() flushes before reading, or loads it read-only when stopped
+    AuditLog::Options m_options;
     QString m_logFilePath;
-    int m_retentionDays = 365;
-    bool m_running = false;
+    QString m_ipAddress;
+    std::atomic<int> m_retentionDays{365};
+    std::atomic<bool> m_running{false};
 };
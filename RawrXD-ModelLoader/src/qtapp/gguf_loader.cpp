@@ -10,56 +10,207 @@ GGUFLoader::GGUFLoader(const QString& path)
         return;
     }
     
-    QDataStream ds(&file);
-    ds.setByteOrder(QDataStream::LittleEndian);
-    
-    ds.readRawData(head.magic, 4);
-    if (memcmp(head.magic, "GGUF", 4) != 0) {
-        qWarning() << "Invalid GGUF magic:" << QByteArray(head.magic, 4).toHex();
-        file.close();
+    // Parse the header in place from the mapping; fall back to reading a
+    // prefix of the file when mapping is unavailable
+    gguf::Parser::Status status;
+    if (mapFile()) {
+        status = parser.Parse(mapped, size_t(mappedBytes));
+    } else {
+        status = parser.ParseFrom([this](uint64_t offset, void* dst, size_t n) -> size_t {
+            if (!file.seek(qint64(offset))) return 0;
+            return size_t(qMax<qint64>(0, file.read(static_cast<char*>(dst), qint64(n))));
+        }, quint64(file.size()));
+    }
+    if (status != gguf::Parser::Status::Ok) {
+        qWarning() << "Invalid GGUF file:" << path << QString::fromStdString(parser.Error());
+        close();
         return;
     }
     
-    ds >> head.version >> head.tensorCount >> head.metadataSize;
-    qDebug() << "GGUF version:" << head.version << "tensors:" << head.tensorCount;
+    std::memcpy(head.magic, "GGUF", 4);
+    head.version = parser.Version();
+    head.tensorCount = parser.TensorCount();
+    head.metadataSize = parser.KVCount();
+    qDebug() << "GGUF version:" << head.version << "tensors:" << head.tensorCount
+             << "metadata:" << head.metadataSize;
+    
+    tensors.reserve(int(parser.Tensors().size()));
+    for (const gguf::TensorDesc& desc : parser.Tensors()) {
+        GGUFTensorInfo info;
+        info.name = QString::fromUtf8(desc.name.data(), qsizetype(desc.name.size()));
+        info.type = desc.type;
+        for (uint32_t d = 0; d < desc.n_dims; ++d) {
+            info.dims.append(qint64(desc.ne[d]));
+        }
+        info.offset = desc.offset;
+        info.byteSize = desc.size_bytes;
+        if (info.byteSize == 0) {
+            qWarning() << "Unknown ggml type" << info.type << "for tensor" << info.name;
+        }
+        tensors.insert(info.name, info);
+    }
+    qDebug() << "Loaded" << tensors.size() << "tensor descriptors";
+}
+
+void GGUFLoader::close()
+{
+    if (mapped) {
+        file.unmap(mapped);
+        mapped = nullptr;
+        mappedBytes = 0;
+    }
+    file.close();
+}
+
+GGUFLoader::~GGUFLoader()
+{
+    close();
+}
+
+bool GGUFLoader::mapFile()
+{
+    if (mapped) return true;
+    if (!file.isOpen()) return false;
+    
+    const qint64 size = file.size();
+    mapped = file.map(0, size);
+    if (!mapped) {
+        qWarning() << "Failed to map GGUF file:" << file.errorString();
+        return false;
+    }
+    mappedBytes = size;
+    qDebug() << "Mapped GGUF file:" << size << "bytes";
+    return true;
+}
+
+QByteArray GGUFLoader::tensorView(const QString& tensor) const
+{
+    auto it = tensors.constFind(tensor);
+    if (!mapped || it == tensors.constEnd()) return {};
+    if (it->offset + it->byteSize > quint64(mappedBytes)) {
+        qWarning() << "Tensor extends past end of file:" << tensor;
+        return {};
+    }
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(mapped + it->offset),
+                                   qsizetype(it->byteSize));
+}
+
+QVariant GGUFLoader::getParam(const QString& key, const QVariant& defaultValue) const
+{
+    // Short hyperparameter names used by the engine map onto
+    // architecture-prefixed GGUF keys ("n_layer" -> "llama.block_count")
+    static const QHash<QString, QString> kArchKeys = {
+        {"n_layer", "block_count"},
+        {"n_embd", "embedding_length"},
+        {"n_head", "attention.head_count"},
+        {"n_head_kv", "attention.head_count_kv"},
+        {"n_ctx", "context_length"},
+        {"n_ff", "feed_forward_length"},
+        {"n_vocab", "vocab_size"},
+    };
+    
+    QByteArray ggufKey = key.toUtf8();
+    auto alias = kArchKeys.constFind(key);
+    if (alias != kArchKeys.constEnd()) {
+        const std::string_view arch = parser.Architecture();
+        ggufKey = QByteArray(arch.data(), qsizetype(arch.size())) + '.' + alias->toUtf8();
+    }
+    
+    const gguf::Value* value = parser.Find(std::string_view(ggufKey.constData(), size_t(ggufKey.size())));
+    if (!value) {
+        // Older exports omit <arch>.vocab_size; the token list is authoritative
+        if (key == "n_vocab") {
+            if (const gguf::Value* tokens = parser.Find("tokenizer.ggml.tokens")) {
+                return QVariant(qlonglong(tokens->ArraySize()));
+            }
+        }
+        return defaultValue;
+    }
+    if (value->IsString()) {
+        const std::string_view text = value->ToStringView();
+        return QString::fromUtf8(text.data(), qsizetype(text.size()));
+    }
+    if (value->IsArray()) {
+        return QVariant(qlonglong(value->ArraySize()));
+    }
+    if (value->type == gguf::ValueType::FLOAT32 || value->type == gguf::ValueType::FLOAT64) {
+        return value->ToDouble();
+    }
+    if (value->type == gguf::ValueType::BOOL) {
+        return value->ToBool();
+    }
+    return QVariant(qlonglong(value->ToInt()));
+}
 
-    /* Simplified offset map - replace with real GGUF parser */
-    for (quint64 i = 0; i < head.tensorCount; ++i) {
-        quint32 nameLen;
-        ds >> nameLen;
-        if (nameLen > 1024) { // Sanity check
-            qWarning() << "Suspicious tensor name length:" << nameLen;
-            break;
+QHash<QString, QByteArray> GGUFLoader::getTokenizerMetadata() const
+{
+    QHash<QString, QByteArray> out;
+    
+    // tokenizer.ggml.tokens: i32 count, then (u32 length, UTF-8 bytes) per token
+    if (const gguf::Value* tokens = parser.Find("tokenizer.ggml.tokens")) {
+        QByteArray packed;
+        const qint32 count = qint32(tokens->ArraySize());
+        packed.reserve(qsizetype(sizeof(qint32) + count * 12));
+        packed.append(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (std::string_view token : tokens->Strings()) {
+            const quint32 len = quint32(token.size());
+            packed.append(reinterpret_cast<const char*>(&len), sizeof(len));
+            packed.append(token.data(), qsizetype(token.size()));
         }
-        QByteArray name(nameLen, Qt::Uninitialized);
-        ds.readRawData(name.data(), nameLen);
-        quint64 offset;
-        ds >> offset;
-        offsetMap[QString::fromUtf8(name)] = offset;
+        out.insert("tokenizer.ggml.tokens", packed);
     }
-    qDebug() << "Loaded" << offsetMap.size() << "tensor offsets";
+    
+    // Scalar arrays (scores, token types) keep their raw little-endian payload
+    for (const char* key : {"tokenizer.ggml.scores", "tokenizer.ggml.token_type"}) {
+        const gguf::Value* value = parser.Find(key);
+        if (value && value->IsScalarArray()) {
+            out.insert(key, QByteArray(static_cast<const char*>(value->ArrayData()),
+                                       qsizetype(value->ArraySize() * gguf::ScalarSize(value->elem_type))));
+        }
+    }
+    
+    // tokenizer.ggml.merges: one "left right" pair per line, in priority order
+    if (const gguf::Value* merges = parser.Find("tokenizer.ggml.merges")) {
+        QByteArray text;
+        for (std::string_view merge : merges->Strings()) {
+            text.append(merge.data(), qsizetype(merge.size()));
+            text.append('\n');
+        }
+        out.insert("tokenizer.ggml.merges", text);
+    }
+    
+    for (const char* key : {"tokenizer.ggml.model", "tokenizer.ggml.pre"}) {
+        const std::string_view value = parser.GetString(key);
+        if (!value.empty()) out.insert(key, QByteArray(value.data(), qsizetype(value.size())));
+    }
+    return out;
 }
 
-GGUFLoader::~GGUFLoader() = default;
+const GGUFTensorInfo* GGUFLoader::tensorInfo(const QString& tensorName) const
+{
+    auto it = tensors.constFind(tensorName);
+    return it == tensors.constEnd() ? nullptr : &it.value();
+}
 
 QByteArray GGUFLoader::inflateWeight(const QString& tensor)
 {
-    auto it = offsetMap.constFind(tensor);
-    if (it == offsetMap.constEnd()) {
+    auto it = tensors.constFind(tensor);
+    if (it == tensors.constEnd()) {
         qWarning() << "Tensor not found:" << tensor;
         return {};
     }
     
-    file.seek(*it);
-    quint32 packedSz;
-    file.read(reinterpret_cast<char*>(&packedSz), 4);
-    
-    QByteArray packed = file.read(packedSz);
-    if (packed.size() != static_cast<int>(packedSz)) {
-        qWarning() << "Read mismatch: expected" << packedSz << "got" << packed.size();
+    // GGUF tensor data is stored uncompressed in its native ggml type
+    if (mapped) {
+        const QByteArray view = tensorView(tensor);
+        return QByteArray(view.constData(), view.size());
+    }
+    file.seek(qint64(it->offset));
+    QByteArray packed = file.read(qint64(it->byteSize));
+    if (packed.size() != static_cast<int>(it->byteSize)) {
+        qWarning() << "Read mismatch: expected" << it->byteSize << "got" << packed.size();
         return {};
     }
     
-    // For now, return the raw data (add inflate later if compressed)
     return packed;
 }
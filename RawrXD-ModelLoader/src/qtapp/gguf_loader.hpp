@@ -6,12 +6,25 @@
 #include <QHash>
 #include <QString>
 #include <QStringList>
+#include <QVariant>
+#include "gguf_parser.h"
 
 struct GGUFHeader {
     char magic[4];      // "GGUF"
     quint32 version;
     quint64 tensorCount;
-    quint64 metadataSize;
+    quint64 metadataSize;   // number of metadata key/value pairs
+};
+
+/**
+ * @brief One entry of the GGUF tensor table
+ */
+struct GGUFTensorInfo {
+    QString name;
+    quint32 type{0};         // ggml_type as stored in the file (0 = F32)
+    QVector<qint64> dims;    // ggml ne[] order: dims[0] is the contiguous dimension
+    quint64 offset{0};       // absolute file offset of the tensor data
+    quint64 byteSize{0};     // size of the tensor data in its native type
 };
 
 struct GGUFLoader {
@@ -19,11 +32,59 @@ struct GGUFLoader {
     ~GGUFLoader();
     bool  isOpen() const { return file.isOpen(); }
     QByteArray inflateWeight(const QString& tensorName);
-    QStringList tensorNames() const { return offsetMap.keys(); }
+    
+    /**
+     * @brief Map the whole file read-only (mmap / MapViewOfFile via QFile::map)
+     *
+     * Pages are shared through the OS page cache, so several loaders of the
+     * same file cost one copy of the weights and nothing is read up front.
+     * @return true if the mapping is available
+     */
+    bool mapFile();
+    bool isMapped() const { return mapped != nullptr; }
+    const uchar* mappedData() const { return mapped; }
+    qint64 mappedSize() const { return mappedBytes; }
+    
+    /**
+     * @brief Non-owning view of a tensor's bytes inside the file mapping
+     * @return QByteArray::fromRawData() over the mapping, empty if unmapped;
+     *         valid only while this loader is alive
+     */
+    QByteArray tensorView(const QString& tensorName) const;
+    
+    QStringList tensorNames() const { return tensors.keys(); }
+    const GGUFTensorInfo* tensorInfo(const QString& tensorName) const;
+    const QHash<QString, GGUFTensorInfo>& tensorInfos() const { return tensors; }
+    
+    /**
+     * @brief Typed metadata lookup
+     *
+     * Accepts raw GGUF keys ("llama.rope.freq_base") and the short names the
+     * engine uses ("n_layer", "n_embd", "n_head", "n_vocab", ...), which are
+     * resolved against general.architecture.
+     * @return Integer, double, bool or string value; arrays yield their length
+     */
+    QVariant getParam(const QString& key, const QVariant& defaultValue = QVariant()) const;
+    
+    /**
+     * @brief Tokenizer arrays in the packed form BPETokenizer and
+     *        SentencePieceTokenizer read (token list, scores, token types, merges)
+     */
+    QHash<QString, QByteArray> getTokenizerMetadata() const;
+    
+    /**
+     * @brief Parsed header, metadata and tensor table
+     */
+    const gguf::Parser& metadata() const { return parser; }
 
 private:
     QFile file;
     GGUFHeader head{};
     QSharedMemory shm;          // holds the *inflated* blob
-    QHash<QString, quint64> offsetMap; // tensor → file offset
+    QHash<QString, GGUFTensorInfo> tensors; // tensor → type, shape, file offset
+    uchar* mapped{nullptr};     // read-only view of the whole file
+    qint64 mappedBytes{0};
+    gguf::Parser parser;        // metadata views into the mapping (or its own header copy)
+    
+    void close();
 };
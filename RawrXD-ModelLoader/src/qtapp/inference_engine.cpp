@@ -1,4 +1,5 @@
 #include "inference_engine.hpp"
+#include "metrics_collector.hpp"
 #include <QDebug>
 #include <QFileInfo>
 #include <QMutexLocker>
@@ -11,12 +12,19 @@
 #include <numeric>
 #include <mutex>
 
-// Use shared quant utilities
-#include "quant_utils.hpp"
+namespace {
+
+// New tokens per request()
+constexpr int kRequestMaxTokens = 50;
+
+} // namespace
 
 InferenceEngine::InferenceEngine(const QString& ggufPath, QObject* parent)
     : QObject(parent), m_loader(nullptr)
 {
+    // Loop detection needs no phrase lists, so it is on unless replaced
+    m_failureMonitor = [] { return StreamingFailureDetector::loopMonitor(kRequestMaxTokens); };
+
     if (!ggufPath.isEmpty()) {
         loadModel(ggufPath);
     }
@@ -26,6 +34,9 @@ bool InferenceEngine::loadModel(const QString& path)
 {
     QMutexLocker lock(&m_mutex);
     
+    // Weights may alias the previous loader's file mapping
+    m_transformer.unload();
+    m_transformer.setWeightMapping(nullptr, 0);
     if (m_loader) {
         delete m_loader;
         m_loader = nullptr;
@@ -41,6 +52,12 @@ bool InferenceEngine::loadModel(const QString& path)
         return false;
     }
     
+    // Map the file once; native weights are then used in place instead of
+    // being read into the tensor cache and copied into ggml tensors
+    if (m_loader->mapFile()) {
+        m_transformer.setWeightMapping(m_loader->mappedData(), size_t(m_loader->mappedSize()));
+    }
+    
     m_modelPath = path;
     QString modelName = extractModelName(path);
     qInfo() << "Model loaded successfully:" << modelName;
@@ -48,7 +65,8 @@ bool InferenceEngine::loadModel(const QString& path)
     // Initialize tokenizer from model
     initializeTokenizer();
     
-    // Build initial quantized tensor cache
+    // Build initial tensor cache (weights are loaded once the model is sized below)
+    m_nLayers = 0;
     rebuildTensorCache();
     
     // === FIX: Dynamically read model architecture from GGUF metadata ===
@@ -62,8 +80,13 @@ bool InferenceEngine::loadModel(const QString& path)
     qInfo() << QString("Detected model architecture: Layers=%1, Embedding=%2, Heads=%3, Vocab=%4")
                  .arg(nLayers).arg(nEmbd).arg(nHead).arg(nVocab);
     
+    m_nLayers = nLayers;
+    m_nEmbd = nEmbd;
+    m_nHead = nHead;
+    m_nVocab = nVocab;
+    
     if (!m_tensorCache.isEmpty()) {
-        bool transformerLoaded = m_transformer.loadWeights(m_tensorCache, nLayers, nEmbd, nHead, nVocab);
+        bool transformerLoaded = loadTransformerWeights();
         if (!transformerLoaded) {
             qWarning() << "Transformer weight loading failed, inference will be limited";
         } else {
@@ -71,9 +94,6 @@ bool InferenceEngine::loadModel(const QString& path)
         }
     }
     
-    // Reset KV-cache state for new model
-    m_kvCacheReady = false;
-    
     emit modelLoadedChanged(true, modelName);
     return true;
 }
@@ -135,7 +155,29 @@ void InferenceEngine::request(const QString& prompt, qint64 reqId)
         
         // === CORE FIX: Delegate to the dedicated generate method (max 50 new tokens) ===
         // The generate method handles the autoregressive loop, logging, and performance metrics.
-        std::vector<int32_t> allTokens = generate(inputTokens, 50);
+        // Each token is streamed as soon as it completes a character, and the
+        // failure monitor can cut a refusal or loop short; generate() takes
+        // the mutex itself.
+        StreamingDetokenizer detokenizer = createDetokenizer();
+        StreamingFailureDetector monitor = m_failureMonitor ? m_failureMonitor() : StreamingFailureDetector();
+        lock.unlock();
+        std::vector<int32_t> allTokens = generate(inputTokens, kRequestMaxTokens, [&](int32_t token) {
+            const QString text = detokenizer.push(token);
+            if (!text.isEmpty()) {
+                emit streamToken(reqId, text);
+            }
+            return !monitor.feedToken(token, text).isFailure();
+        });
+        lock.relock();
+        if (monitor.shouldStop()) {
+            qWarning() << "Generation for request" << reqId << "stopped after" << monitor.tokensSeen()
+                       << "tokens:" << monitor.failure().description;
+        }
+        const QString tail = detokenizer.flush();
+        if (!tail.isEmpty()) {
+            emit streamToken(reqId, tail);
+        }
+        emit streamFinished(reqId);
 
         // Calculate generated tokens (excluding input tokens)
         int inputSize = inputTokens.size();
@@ -177,6 +219,8 @@ void InferenceEngine::unloadModel()
 {
     QMutexLocker lock(&m_mutex);
     
+    m_transformer.unload();
+    m_transformer.setWeightMapping(nullptr, 0);
     if (m_loader) {
         delete m_loader;
         m_loader = nullptr;
@@ -184,6 +228,8 @@ void InferenceEngine::unloadModel()
     
     m_modelPath.clear();
     m_tensorCache.clear();
+    m_tensorLayouts.clear();
+    m_nLayers = 0;
     
     emit modelLoadedChanged(false, QString());
 }
@@ -221,23 +267,49 @@ void InferenceEngine::setLayerQuant(const QString& tensorName, const QString& qu
 void InferenceEngine::rebuildTensorCache()
 {
     m_tensorCache.clear();
+    m_tensorLayouts.clear();
     
     if (!m_loader) return;
     
-    QStringList names = m_loader->tensorNames();
-    for (const QString& name : names) {
-        const QString qmode = m_perLayerQuant.contains(name) ? m_perLayerQuant.value(name) : m_quantMode;
-        QByteArray raw = m_loader->inflateWeight(name);
+    // Tensors are cached in their native GGUF encoding; the transformer keeps
+    // quantized types as-is and only requantizes float matrices on request.
+    // With a mapped file the cache holds non-owning views, not copies.
+    const bool mapped = m_loader->isMapped();
+    const QHash<QString, GGUFTensorInfo>& infos = m_loader->tensorInfos();
+    for (auto it = infos.constBegin(); it != infos.constEnd(); ++it) {
+        QByteArray raw = mapped ? m_loader->tensorView(it.key()) : m_loader->inflateWeight(it.key());
         if (raw.isEmpty()) continue;
-        m_tensorCache.insert(name, apply_quant(raw, qmode));
+        
+        TransformerInference::TensorLayout layout;
+        layout.type = int(it->type);
+        layout.ne.assign(it->dims.constBegin(), it->dims.constEnd());
+        m_tensorLayouts.insert(it.key(), layout);
+        m_tensorCache.insert(it.key(), raw);
     }
     
-    // Reload transformer weights if cache was rebuilt
-    if (!m_tensorCache.isEmpty() && m_loader) {
-        m_transformer.loadWeights(m_tensorCache, 12, 768, 12, 50257);
+    // Reload transformer weights if cache was rebuilt after the model was sized
+    if (!m_tensorCache.isEmpty() && m_nLayers > 0) {
+        loadTransformerWeights();
     }
 }
 
+bool InferenceEngine::loadTransformerWeights()
+{
+    // The quant mode only selects a requant target for float matrices;
+    // tensors already quantized in the file are used as stored
+    QHash<QString, int> overrides;
+    for (auto it = m_perLayerQuant.constBegin(); it != m_perLayerQuant.constEnd(); ++it) {
+        overrides.insert(it.key(), TransformerInference::weightTypeFromName(it.value()));
+    }
+    m_transformer.setWeightType(TransformerInference::weightTypeFromName(m_quantMode));
+    m_transformer.setWeightTypeOverrides(overrides);
+    bool ok = m_transformer.loadWeights(m_tensorCache, m_tensorLayouts, m_nLayers, m_nEmbd, m_nHead, m_nVocab);
+    if (ok) {
+        m_memoryUsageMB = qint64(m_transformer.weightBytes() / (1024 * 1024));
+    }
+    return ok;
+}
+
 std::vector<int32_t> InferenceEngine::tokenize(const QString& text)
 {
     // Use appropriate tokenizer based on mode
@@ -343,6 +415,57 @@ QString InferenceEngine::detokenize(const std::vector<int32_t>& tokens)
     return result.trimmed();
 }
 
+StreamingDetokenizer InferenceEngine::createDetokenizer() const
+{
+    switch (m_tokenizerMode) {
+        case TOKENIZER_BPE:
+            if (m_bpeTokenizer.isReady()) {
+                return StreamingDetokenizer(m_bpeTokenizer);
+            }
+            break;
+            
+        case TOKENIZER_SP:
+            if (m_spTokenizer.isReady()) {
+                return StreamingDetokenizer(m_spTokenizer);
+            }
+            break;
+            
+        case TOKENIZER_FALLBACK:
+        default:
+            break;
+    }
+    
+    // Same per-token text as the fallback branch of detokenize()
+    const VocabularyLoader* vocab = &m_vocab;
+    return StreamingDetokenizer([vocab](int32_t token, QByteArray& out) {
+        if (token == 1 || token == 2) return true;  // BOS/EOS
+        
+        if (vocab->isLoaded()) {
+            VocabularyLoader::Token vocabToken = vocab->getToken(token);
+            if (vocabToken.id >= 0) {
+                out.append(vocabToken.text.toUtf8());
+                out.append(' ');
+                return true;
+            }
+        }
+        
+        if (token >= 256 && token < 50256) {
+            out.append("tok_");
+            out.append(QByteArray::number(token));
+            out.append(' ');
+        } else if (token >= 0 && token < 256) {
+            out.append(QString(QChar(token)).toUtf8());
+        }
+        return true;
+    }, true);
+}
+
+void InferenceEngine::setFailureMonitor(std::function<StreamingFailureDetector()> factory)
+{
+    QMutexLocker lock(&m_mutex);
+    m_failureMonitor = std::move(factory);
+}
+
 void InferenceEngine::initializeTokenizer()
 {
     // Try to load vocabulary from GGUF file
@@ -379,7 +502,8 @@ void InferenceEngine::initializeTokenizer()
     }
 }
 
-std::vector<int32_t> InferenceEngine::generate(const std::vector<int32_t>& inputTokens, int maxTokens)
+std::vector<int32_t> InferenceEngine::generate(const std::vector<int32_t>& inputTokens, int maxTokens,
+                                               const std::function<bool(int32_t)>& onToken)
 {
     QMutexLocker lock(&m_mutex);
     
@@ -395,27 +519,17 @@ std::vector<int32_t> InferenceEngine::generate(const std::vector<int32_t>& input
         QElapsedTimer localTimer;
         localTimer.start();
         
-        // === ELEGANT FIX: Two-Phase Inference with KV-Cache ===
-        // Phase 1: Context prefill - process the entire input prompt once
-        // The transformer builds the KV-cache (Key-Value cache) for efficient generation.
-        // Note: If transformer has decodeContext method, use it; otherwise use forward
-        if (!m_kvCacheReady) {
-            // Process full context to populate KV-cache
-            // This is called only once per inference request
-            m_transformer.forward(inputTokens);
-            m_kvCacheReady = true;
-            qInfo() << "KV-cache prefilled with" << inputTokens.size() << "context tokens";
-        }
-        
-        // The last token ID becomes the starting point for autoregressive generation
-        int32_t currentToken = inputTokens.back();
+        // === Two-Phase Inference with KV-Cache ===
+        // Phase 1: Context prefill - process the entire input prompt once.
+        // The transformer appends K/V for every prompt position to its cache
+        // and returns the logits for the token following the prompt.
+        std::vector<float> logits = m_transformer.prefill(inputTokens);
+        qInfo() << "KV-cache prefilled with" << m_transformer.kvPosition() << "context tokens"
+                << "(" << m_transformer.lastReusedPrefixTokens() << "reused from prefix cache)";
+        MetricsCollector::instance().recordPrefixCacheLookup(int(inputTokens.size()), m_transformer.lastReusedPrefixTokens());
         
         // === Phase 2: Autoregressive Token Generation (Decoding) ===
         for (int i = 0; i < maxTokens; ++i) {
-            // Generate logits for the next token based ONLY on the current token
-            // The Transformer uses the internal KV-cache for past context context
-            std::vector<float> logits = m_transformer.forward(std::vector<int32_t>{currentToken});
-            
             if (logits.empty()) {
                 qWarning() << "Transformer forward pass returned no logits";
                 break;
@@ -423,7 +537,7 @@ std::vector<int32_t> InferenceEngine::generate(const std::vector<int32_t>& input
             
             // === Elegant Sampling Logic using Top-P ===
             // Delegate complex sampling to helper function
-            currentToken = sampleNextToken(logits, m_temperature, m_topP);
+            int32_t currentToken = sampleNextToken(logits, m_temperature, m_topP);
             
             // Check for EOS token (2 is common EOS)
             if (currentToken == 2 || currentToken == 0) {
@@ -432,6 +546,15 @@ std::vector<int32_t> InferenceEngine::generate(const std::vector<int32_t>& input
             }
             
             result.push_back(currentToken);
+            if (onToken && !onToken(currentToken)) {
+                qInfo() << "Generation stopped by caller";
+                break;
+            }
+            
+            // Feed only the new token; past context comes from the KV-cache
+            if (i + 1 < maxTokens) {
+                logits = m_transformer.decode(currentToken);
+            }
         }
         
         // Update performance metrics based on this generation step
@@ -445,9 +568,6 @@ std::vector<int32_t> InferenceEngine::generate(const std::vector<int32_t>& input
                 << "ms (" << QString::number(m_tokensPerSecond, 'f', 1) << " tok/s, Top-P=" 
                 << QString::number(m_topP, 'f', 2) << ")";
         
-        // Reset KV-cache for next inference
-        m_kvCacheReady = false;
-        
     } else {
         // Fallback: Simple echo with placeholder
         qWarning() << "Transformer not ready, using placeholder generation";
@@ -461,6 +581,66 @@ std::vector<int32_t> InferenceEngine::generate(const std::vector<int32_t>& input
     return result;
 }
 
+std::vector<float> InferenceEngine::beginSequence(int seqId, const std::vector<int32_t>& promptTokens)
+{
+    QMutexLocker lock(&m_mutex);
+    
+    if (!m_transformer.isReady() || promptTokens.empty()) {
+        return {};
+    }
+    
+    if (!m_transformer.selectSequence(seqId)) {
+        qWarning() << "Cannot create KV sequence" << seqId;
+        return {};
+    }
+    std::vector<float> logits = m_transformer.prefill(promptTokens);
+    if (logits.empty()) {
+        m_transformer.removeSequence(seqId);
+        return {};
+    }
+    MetricsCollector::instance().recordPrefixCacheLookup(int(promptTokens.size()), m_transformer.lastReusedPrefixTokens());
+    m_transformer.setSequencePinned(seqId, true);
+    return logits;
+}
+
+std::vector<std::vector<float>> InferenceEngine::decodeBatch(const std::vector<int>& seqIds,
+                                                             const std::vector<int32_t>& tokens)
+{
+    QMutexLocker lock(&m_mutex);
+    
+    if (!m_transformer.isReady()) {
+        return {};
+    }
+    
+    QElapsedTimer stepTimer;
+    stepTimer.start();
+    std::vector<std::vector<float>> logits = m_transformer.forwardBatch(seqIds, tokens);
+    
+    // Aggregate throughput across the whole batch
+    const qint64 elapsedUs = stepTimer.nsecsElapsed() / 1000;
+    if (!logits.empty() && elapsedUs > 0) {
+        m_tokensPerSecond = (seqIds.size() * 1e6) / elapsedUs;
+    }
+    return logits;
+}
+
+void InferenceEngine::endSequence(int seqId)
+{
+    QMutexLocker lock(&m_mutex);
+    
+    // Hand the active role back to the default sequence so this one can go
+    if (m_transformer.activeSequence() == seqId) {
+        m_transformer.selectSequence(0);
+    }
+    m_transformer.removeSequence(seqId);
+}
+
+int32_t InferenceEngine::sampleToken(std::vector<float>& logits, double temperature)
+{
+    QMutexLocker lock(&m_mutex);
+    return sampleNextToken(logits, temperature, m_topP);
+}
+
 // ============================================================================
 // ELEGANT IMPLEMENTATION: Top-P (Nucleus) Sampling
 // ============================================================================
@@ -7,10 +7,13 @@
 #include <QElapsedTimer>
 #include <vector>
 #include <cstdint>
+#include <functional>
 #include "gguf_loader.hpp"
 #include "transformer_inference.hpp"
 #include "bpe_tokenizer.hpp"
 #include "sentencepiece_tokenizer.hpp"
+#include "streaming_detokenizer.hpp"
+#include "streaming_failure_detector.hpp"
 #include "vocabulary_loader.hpp"/**
  * @brief Inference engine for GGUF models with brutal_gzip compression support
  * 
@@ -72,9 +75,12 @@ public:
      * @brief Generate tokens synchronously (for server API)
      * @param inputTokens Input token sequence
      * @param maxTokens Maximum number of tokens to generate
+     * @param onToken Called with each new token as soon as it is sampled;
+     *        returning false stops generation after that token
      * @return Generated token sequence
      */
-    std::vector<int32_t> generate(const std::vector<int32_t>& inputTokens, int maxTokens = 100);
+    std::vector<int32_t> generate(const std::vector<int32_t>& inputTokens, int maxTokens = 100,
+                                  const std::function<bool(int32_t)>& onToken = nullptr);
     
     /**
      * @brief Tokenize text (public for server API)
@@ -85,6 +91,76 @@ public:
      * @brief Detokenize tokens to text (public for server API)
      */
     QString detokenize(const std::vector<int32_t>& tokens);
+    
+    /**
+     * @brief Incremental decoder for one token stream with the active tokenizer
+     *
+     * Streaming consumers push each generated token and get only the text it
+     * completes, instead of re-running detokenize() over the whole reply.
+     * Valid until the next model load.
+     */
+    StreamingDetokenizer createDetokenizer() const;
+    
+    /**
+     * @brief Check streamed requests for refusals and loops as they generate
+     *
+     * The factory is called once per request(); generation stops at the
+     * first failure instead of running to the token limit. By default each
+     * request gets a loops-only detector. Pass a factory built on a
+     * FailurePatternSet to also catch refusals, or nullptr to disable.
+     */
+    void setFailureMonitor(std::function<StreamingFailureDetector()> factory);
+    
+    /**
+     * @brief Token positions in the paged KV pool shared by all sequences
+     *
+     * Takes effect on the next loadModel(); <= 0 sizes the pool for one
+     * context window. Batched decoding needs room for every sequence.
+     */
+    void setKVPoolTokens(int nTokens) { m_transformer.setKVPoolTokens(nTokens); }
+    
+    /**
+     * @brief Cap the KV pool at this many MB (never below one context window)
+     *
+     * Takes effect on the next loadModel(); < 0 (default) leaves it uncapped.
+     */
+    void setKVPoolBudgetMB(int mb) { m_transformer.setKVPoolBudgetMB(mb); }
+    
+    /**
+     * @brief Positions the loaded model's KV pool holds, for admission control
+     */
+    int kvPoolTokens() const { return m_transformer.kvPoolTokens(); }
+    
+    /**
+     * @brief Maximum positions one sequence can hold
+     */
+    int contextSize() const { return m_transformer.contextSize(); }
+    
+    /**
+     * @brief Prefill a prompt as KV sequence seqId for step-wise batched decoding
+     *
+     * The sequence stays pinned in the KV pool until endSequence(), so other
+     * requests' prefills cannot evict it mid-generation.
+     * @return Logits for the first generated token, empty on failure
+     */
+    std::vector<float> beginSequence(int seqId, const std::vector<int32_t>& promptTokens);
+    
+    /**
+     * @brief Advance several sequences by one token in a single forward pass
+     * @return Next-token logits per sequence, empty on failure
+     */
+    std::vector<std::vector<float>> decodeBatch(const std::vector<int>& seqIds,
+                                                const std::vector<int32_t>& tokens);
+    
+    /**
+     * @brief Drop a sequence started with beginSequence() and free its KV blocks
+     */
+    void endSequence(int seqId);
+    
+    /**
+     * @brief Top-P sample from logits at the given temperature (thread-safe)
+     */
+    int32_t sampleToken(std::vector<float>& logits, double temperature);
 
 public slots:
     /**
@@ -173,7 +249,14 @@ private:
     mutable QMutex m_mutex;
     QString m_quantMode{"Q4_0"};  // Default quantization
     QHash<QString, QString> m_perLayerQuant;  // Tensor-specific quants
-    QHash<QString, QByteArray> m_tensorCache;  // Cached quantized tensors
+    QHash<QString, QByteArray> m_tensorCache;  // Cached tensors (native GGUF encoding; views into the mapping when mapped)
+    QHash<QString, TransformerInference::TensorLayout> m_tensorLayouts;  // ggml type + shape per tensor
+    
+    // Model hyperparameters read at load time
+    int m_nLayers{0};
+    int m_nEmbd{0};
+    int m_nHead{0};
+    int m_nVocab{0};
     
     // Performance tracking
     qint64 m_memoryUsageMB{0};
@@ -186,6 +269,7 @@ private:
     
     // Tokenizers (auto-detect which to use)
     BPETokenizer m_bpeTokenizer;
+    std::function<StreamingFailureDetector()> m_failureMonitor;
     SentencePieceTokenizer m_spTokenizer;
     VocabularyLoader m_vocab;
     enum TokenizerMode {
@@ -197,6 +281,7 @@ private:
     // Helper methods
     QString extractModelName(const QString& path) const;
     void rebuildTensorCache();
+    bool loadTransformerWeights();
     void initializeTokenizer();
     
     // Advanced sampling
@@ -206,5 +291,4 @@ private:
     // Sampling configuration
     double m_topP{0.9};  // Top-P (nucleus) sampling threshold
     std::mt19937 m_randomEngine;  // Thread-safe random number generator
-    bool m_kvCacheReady{false};  // Track if KV-cache is prefilled
 };
@@ -51,17 +51,19 @@ void MetricsCollector::endRequest(qint64 requestId, int tokensGenerated, bool su
         return;
     }
     
-    RequestMetrics& metrics = m_activeRequests[requestId];
+    RequestMetrics metrics = m_activeRequests.value(requestId);
     metrics.endTime = QDateTime::currentDateTime();
     metrics.tokensGenerated = tokensGenerated;
     metrics.success = success;
     metrics.errorMessage = error;
-    metrics.memoryUsed = m_currentMemoryUsage;
+    metrics.memoryUsed = m_currentMemoryUsage.load(std::memory_order_relaxed);
     
+    qint64 durationUs = 0;
     if (m_timers.contains(requestId)) {
-        metrics.durationMs = m_timers[requestId].elapsed();
+        durationUs = m_timers[requestId].nsecsElapsed() / 1000;
         m_timers.remove(requestId);
     }
+    metrics.durationMs = durationUs / 1000;
     
     // Calculate tokens per second
     if (metrics.durationMs > 0 && tokensGenerated > 0) {
@@ -70,9 +72,25 @@ void MetricsCollector::endRequest(qint64 requestId, int tokensGenerated, bool su
         metrics.tokensPerSecond = 0.0f;
     }
     
-    // Move to completed requests
+    // Keep the most recent requests for lookups and exports
     m_completedRequests.append(metrics);
+    if (m_completedRequests.size() > kMaxCompletedRequests) {
+        m_completedRequests.removeFirst();
+    }
     m_activeRequests.remove(requestId);
+    locker.unlock();
+    
+    // Aggregates: histograms and atomics, no lock and no scan of past requests
+    (success ? m_successLatency : m_failureLatency).record(quint64(durationUs));
+    m_tokensPerSec.record(quint64(metrics.tokensPerSecond * 1000.0f));
+    m_memoryTotal.fetch_add(metrics.memoryUsed, std::memory_order_relaxed);
+    quint64 peak = m_peakMemory.load(std::memory_order_relaxed);
+    while (metrics.memoryUsed > peak &&
+           !m_peakMemory.compare_exchange_weak(peak, metrics.memoryUsed, std::memory_order_relaxed)) {
+    }
+    qint64 first = 0;
+    m_firstRequestMs.compare_exchange_strong(first, metrics.startTime.toMSecsSinceEpoch(), std::memory_order_relaxed);
+    m_lastRequestMs.store(metrics.endTime.toMSecsSinceEpoch(), std::memory_order_relaxed);
     
     // Performance warnings
     if (metrics.tokensPerSecond < 10.0f && success) {
@@ -108,8 +126,18 @@ void MetricsCollector::recordToken(qint64 requestId) {
 void MetricsCollector::recordMemoryUsage(size_t bytes) {
     if (!m_enabled) return;
     
-    QMutexLocker locker(&m_mutex);
-    m_currentMemoryUsage = bytes;
+    m_currentMemoryUsage.store(bytes, std::memory_order_relaxed);
+}
+
+void MetricsCollector::recordPrefixCacheLookup(int promptTokens, int reusedTokens) {
+    if (!m_enabled) return;
+    
+    m_prefixLookups.fetch_add(1, std::memory_order_relaxed);
+    if (reusedTokens > 0) {
+        m_prefixHits.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_prefillTokensSaved.fetch_add(reusedTokens, std::memory_order_relaxed);
+    m_prefillTokensTotal.fetch_add(promptTokens, std::memory_order_relaxed);
 }
 
 MetricsCollector::RequestMetrics MetricsCollector::getRequestMetrics(qint64 requestId) const {
@@ -130,70 +158,55 @@ MetricsCollector::RequestMetrics MetricsCollector::getRequestMetrics(qint64 requ
     return RequestMetrics();
 }
 
-MetricsCollector::AggregateMetrics MetricsCollector::getAggregateMetrics() const {
-    QMutexLocker locker(&m_mutex);
-    
+MetricsCollector::AggregateMetrics MetricsCollector::getAggregateMetrics(Window window) const {
     AggregateMetrics agg;
-    
-    if (m_completedRequests.isEmpty()) {
+    agg.prefixCacheLookups = m_prefixLookups.load(std::memory_order_relaxed);
+    agg.prefixCacheHits = m_prefixHits.load(std::memory_order_relaxed);
+    agg.prefixCacheHitRate = agg.prefixCacheLookups > 0 ? float(agg.prefixCacheHits) / agg.prefixCacheLookups : 0.0f;
+    agg.prefillTokensSaved = m_prefillTokensSaved.load(std::memory_order_relaxed);
+    agg.prefillTokensTotal = m_prefillTokensTotal.load(std::memory_order_relaxed);
+    
+    const auto succeeded = m_successLatency.snapshot(window);
+    const auto failed = m_failureLatency.snapshot(window);
+    auto latency = succeeded;
+    latency.merge(failed);
+    if (latency.count == 0) {
         return agg;
     }
     
-    agg.totalRequests = m_completedRequests.size();
-    agg.firstRequest = m_completedRequests.first().startTime;
-    agg.lastRequest = m_completedRequests.last().endTime;
-    
-    QList<qint64> latencies;
-    qint64 totalLatency = 0;
-    float totalTokensPerSec = 0;
-    size_t totalMemory = 0;
-    
-    for (const auto& metrics : m_completedRequests) {
-        if (metrics.success) {
-            agg.successfulRequests++;
-        } else {
-            agg.failedRequests++;
-        }
-        
-        latencies.append(metrics.durationMs);
-        totalLatency += metrics.durationMs;
-        
-        agg.minLatencyMs = qMin(agg.minLatencyMs, metrics.durationMs);
-        agg.maxLatencyMs = qMax(agg.maxLatencyMs, metrics.durationMs);
-        
-        totalTokensPerSec += metrics.tokensPerSecond;
-        agg.minTokensPerSec = qMin(agg.minTokensPerSec, metrics.tokensPerSecond);
-        agg.maxTokensPerSec = qMax(agg.maxTokensPerSec, metrics.tokensPerSecond);
-        
-        totalMemory += metrics.memoryUsed;
-        agg.peakMemoryUsage = qMax(agg.peakMemoryUsage, metrics.memoryUsed);
+    agg.totalRequests = int(latency.count);
+    agg.successfulRequests = int(succeeded.count);
+    agg.failedRequests = int(failed.count);
+    agg.firstRequest = QDateTime::fromMSecsSinceEpoch(m_firstRequestMs.load(std::memory_order_relaxed));
+    agg.lastRequest = QDateTime::fromMSecsSinceEpoch(m_lastRequestMs.load(std::memory_order_relaxed));
+    
+    // Histograms hold microseconds
+    agg.minLatencyMs = qint64(latency.min / 1000);
+    agg.maxLatencyMs = qint64(latency.max / 1000);
+    agg.avgLatencyMs = qint64(latency.mean() / 1000.0);
+    agg.p50LatencyMs = qint64(latency.percentile(50) / 1000);
+    agg.p95LatencyMs = qint64(latency.percentile(95) / 1000);
+    agg.p99LatencyMs = qint64(latency.percentile(99) / 1000);
+    
+    const auto tokensPerSec = m_tokensPerSec.snapshot(window);
+    if (tokensPerSec.count > 0) {
+        agg.minTokensPerSec = tokensPerSec.min / 1000.0f;
+        agg.maxTokensPerSec = tokensPerSec.max / 1000.0f;
+        agg.avgTokensPerSec = float(tokensPerSec.mean() / 1000.0);
     }
     
-    // Calculate averages
-    agg.avgLatencyMs = totalLatency / agg.totalRequests;
-    agg.avgTokensPerSec = totalTokensPerSec / agg.totalRequests;
-    agg.avgMemoryUsage = totalMemory / agg.totalRequests;
-    
-    // Calculate percentiles
-    std::sort(latencies.begin(), latencies.end());
-    int p50Idx = latencies.size() * 50 / 100;
-    int p95Idx = latencies.size() * 95 / 100;
-    int p99Idx = latencies.size() * 99 / 100;
-    
-    agg.p50LatencyMs = latencies[p50Idx];
-    agg.p95LatencyMs = latencies[p95Idx];
-    agg.p99LatencyMs = latencies[p99Idx];
+    const quint64 completed = m_successLatency.snapshot().count + m_failureLatency.snapshot().count;
+    agg.peakMemoryUsage = size_t(m_peakMemory.load(std::memory_order_relaxed));
+    agg.avgMemoryUsage = completed > 0 ? size_t(m_memoryTotal.load(std::memory_order_relaxed) / completed) : 0;
     
     return agg;
 }
 
 QString MetricsCollector::exportToJson() const {
-    QMutexLocker locker(&m_mutex);
-    
     QJsonObject root;
     root["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
     
-    // Aggregate metrics
+    // Aggregate metrics (lock-free, so gathered before taking the mutex)
     AggregateMetrics agg = getAggregateMetrics();
     QJsonObject aggObj;
     aggObj["totalRequests"] = agg.totalRequests;
@@ -205,9 +218,31 @@ QString MetricsCollector::exportToJson() const {
     aggObj["p99LatencyMs"] = (double)agg.p99LatencyMs;
     aggObj["avgTokensPerSec"] = (double)agg.avgTokensPerSec;
     aggObj["peakMemoryMB"] = (double)(agg.peakMemoryUsage / (1024.0 * 1024.0));
+    aggObj["prefixCacheLookups"] = (double)agg.prefixCacheLookups;
+    aggObj["prefixCacheHitRate"] = (double)agg.prefixCacheHitRate;
+    aggObj["prefillTokensSaved"] = (double)agg.prefillTokensSaved;
+    aggObj["prefillTokensTotal"] = (double)agg.prefillTokensTotal;
     root["aggregate"] = aggObj;
     
-    // Individual requests
+    // Rolling windows
+    const std::pair<const char*, Window> windows[] = {
+        {"1m", Window::OneMinute}, {"5m", Window::FiveMinutes}, {"1h", Window::OneHour}};
+    QJsonObject windowsObj;
+    for (const auto& window : windows) {
+        AggregateMetrics recent = getAggregateMetrics(window.second);
+        QJsonObject recentObj;
+        recentObj["totalRequests"] = recent.totalRequests;
+        recentObj["failedRequests"] = recent.failedRequests;
+        recentObj["p50LatencyMs"] = (double)recent.p50LatencyMs;
+        recentObj["p95LatencyMs"] = (double)recent.p95LatencyMs;
+        recentObj["p99LatencyMs"] = (double)recent.p99LatencyMs;
+        recentObj["avgTokensPerSec"] = (double)recent.avgTokensPerSec;
+        windowsObj[window.first] = recentObj;
+    }
+    root["windows"] = windowsObj;
+    
+    // Most recent individual requests
+    QMutexLocker locker(&m_mutex);
     QJsonArray requestsArray;
     for (const auto& metrics : m_completedRequests) {
         QJsonObject reqObj;
@@ -255,23 +290,28 @@ void MetricsCollector::reset() {
     m_activeRequests.clear();
     m_timers.clear();
     m_completedRequests.clear();
+    m_successLatency.reset();
+    m_failureLatency.reset();
+    m_tokensPerSec.reset();
+    m_memoryTotal = 0;
+    m_peakMemory = 0;
+    m_firstRequestMs = 0;
+    m_lastRequestMs = 0;
     m_currentMemoryUsage = 0;
+    m_prefixLookups = 0;
+    m_prefixHits = 0;
+    m_prefillTokensSaved = 0;
+    m_prefillTokensTotal = 0;
     
     qInfo() << "[MetricsCollector] Metrics reset";
     emit metricsUpdated();
 }
 
 void MetricsCollector::setEnabled(bool enabled) {
-    QMutexLocker locker(&m_mutex);
     m_enabled = enabled;
     qInfo() << "[MetricsCollector] Metrics collection" << (enabled ? "enabled" : "disabled");
 }
 
 bool MetricsCollector::isEnabled() const {
-    QMutexLocker locker(&m_mutex);
     return m_enabled;
 }
-
-void MetricsCollector::calculatePercentiles() {
-    // Already calculated in getAggregateMetrics()
-}
@@ -6,6 +6,9 @@
 #include <QElapsedTimer>
 #include <QDateTime>
 #include <QMutex>
+#include <QList>
+#include <atomic>
+#include "telemetry/latency_histogram.h"
 
 /**
  * @brief Performance metrics collector for telemetry and monitoring
@@ -15,8 +18,13 @@
  * - Token generation metrics (tokens/sec, latency)
  * - Memory usage monitoring
  * - Request/response timing
- * - Statistical aggregation (min, max, avg, p50, p95, p99)
+ * - Statistical aggregation (min, max, avg, p50, p95, p99) over the whole
+ *   session or the last 1m/5m/1h, from lock-free latency histograms
  * - Export to JSON/CSV
+ *
+ * Completed requests feed fixed-size histograms, so aggregates cost the
+ * same after a million requests as after ten and never take the mutex.
+ * Only the most recent kMaxCompletedRequests are kept individually.
  */
 class MetricsCollector : public QObject {
     Q_OBJECT
@@ -55,10 +63,20 @@ public:
         size_t peakMemoryUsage = 0;
         size_t avgMemoryUsage = 0;
         
+        qint64 prefixCacheLookups = 0;
+        qint64 prefixCacheHits = 0;
+        float prefixCacheHitRate = 0;
+        qint64 prefillTokensSaved = 0;    // Prompt tokens served from cached KV
+        qint64 prefillTokensTotal = 0;
+        
         QDateTime firstRequest;
         QDateTime lastRequest;
     };
 
+    using Window = RawrXD::Telemetry::LatencyHistogram::Window;
+
+    static constexpr int kMaxCompletedRequests = 1000;
+
     static MetricsCollector& instance();
     ~MetricsCollector();
 
@@ -82,15 +100,23 @@ public:
      */
     void recordMemoryUsage(size_t bytes);
 
+    /**
+     * @brief Record a prompt prefill and how many of its tokens reused cached KV
+     */
+    void recordPrefixCacheLookup(int promptTokens, int reusedTokens);
+
     /**
      * @brief Get metrics for specific request
      */
     RequestMetrics getRequestMetrics(qint64 requestId) const;
 
     /**
-     * @brief Get aggregate metrics
+     * @brief Get aggregate metrics for the session or a recent window
+     *
+     * Percentiles come from log buckets (within ~2%). Memory and the
+     * first/last timestamps always cover the whole session.
      */
-    AggregateMetrics getAggregateMetrics() const;
+    AggregateMetrics getAggregateMetrics(Window window = Window::Lifetime) const;
 
     /**
      * @brief Export metrics to JSON
@@ -128,13 +154,24 @@ private:
     MetricsCollector(const MetricsCollector&) = delete;
     MetricsCollector& operator=(const MetricsCollector&) = delete;
 
-    void calculatePercentiles();
-
     mutable QMutex m_mutex;
     QHash<qint64, RequestMetrics> m_activeRequests;
     QHash<qint64, QElapsedTimer> m_timers;
-    QList<RequestMetrics> m_completedRequests;
+    QList<RequestMetrics> m_completedRequests;   ///< Most recent only, oldest first
+    
+    // Lock-free aggregates
+    RawrXD::Telemetry::LatencyHistogram m_successLatency;   ///< Microseconds
+    RawrXD::Telemetry::LatencyHistogram m_failureLatency;   ///< Microseconds
+    RawrXD::Telemetry::LatencyHistogram m_tokensPerSec;     ///< Thousandths of a token/s
+    std::atomic<quint64> m_memoryTotal{0};
+    std::atomic<quint64> m_peakMemory{0};
+    std::atomic<qint64> m_firstRequestMs{0};   ///< Start of the first completed request
+    std::atomic<qint64> m_lastRequestMs{0};    ///< End of the latest completed request
     
-    size_t m_currentMemoryUsage = 0;
-    bool m_enabled = true;
+    std::atomic<size_t> m_currentMemoryUsage{0};
+    std::atomic<qint64> m_prefixLookups{0};
+    std::atomic<qint64> m_prefixHits{0};
+    std::atomic<qint64> m_prefillTokensSaved{0};
+    std::atomic<qint64> m_prefillTokensTotal{0};
+    std::atomic<bool> m_enabled{true};
 };
@@ -8,23 +8,10 @@ ModelQueue::ModelQueue(QObject* parent)
     : QObject(parent)
 {
     m_slots.resize(m_maxConcurrentModels);
-    for (int i = 0; i < m_maxConcurrentModels; ++i) {
-        m_slots[i].thread = new QThread(this);
-        m_slots[i].thread->setObjectName(QString("ModelSlot-%1").arg(i));
-    }
 }
 
 ModelQueue::~ModelQueue() {
     stop();
-    for (auto& slot : m_slots) {
-        if (slot.engine) {
-            slot.engine->deleteLater();
-        }
-        if (slot.thread) {
-            slot.thread->quit();
-            slot.thread->wait();
-        }
-    }
 }
 
 qint64 ModelQueue::enqueue(const QString& modelPath, const QString& prompt,
@@ -53,7 +40,8 @@ qint64 ModelQueue::enqueue(const QString& modelPath, const QString& prompt,
     qInfo() << "[ModelQueue] Enqueued request" << req.id 
             << "for model" << modelPath << "priority" << priority;
     
-    m_condition.wakeOne();
+    // Any slot may be the one to admit it at its next step boundary
+    m_condition.wakeAll();
     return req.id;
 }
 
@@ -75,10 +63,11 @@ bool ModelQueue::cancelRequest(qint64 requestId) {
         return true;
     }
     
-    // Check if request is active (can't cancel mid-inference)
+    // Running requests leave their batch at the next step boundary
     if (m_activeRequests.contains(requestId)) {
-        qWarning() << "[ModelQueue] Cannot cancel active request" << requestId;
-        return false;
+        m_cancelled.insert(requestId);
+        qInfo() << "[ModelQueue] Cancelling active request" << requestId;
+        return true;
     }
     
     return false;
@@ -98,37 +87,62 @@ int ModelQueue::activeModels() const {
     return count;
 }
 
+int ModelQueue::activeSequences() const {
+    QMutexLocker locker(&m_mutex);
+    int count = 0;
+    for (const auto& slot : m_slots) {
+        count += slot.running + slot.admitted.size();
+    }
+    return count;
+}
+
 void ModelQueue::start() {
     QMutexLocker locker(&m_mutex);
     if (m_running) return;
     
     m_running = true;
     
-    // Start processing thread
-    m_processingThread = new QThread(this);
-    m_processingThread->setObjectName("QueueProcessor");
-    
-    QObject::connect(m_processingThread, &QThread::started, this, &ModelQueue::processQueue);
-    m_processingThread->start();
+    // Each slot runs its own scheduling loop (not an event loop) on its thread
+    for (int i = 0; i < m_slots.size(); ++i) {
+        m_slots[i].thread = QThread::create([this, i] { runSlot(i); });
+        m_slots[i].thread->setObjectName(QString("ModelSlot-%1").arg(i));
+        m_slots[i].thread->start();
+    }
     
-    qInfo() << "[ModelQueue] Started with" << m_maxConcurrentModels << "model slots";
+    qInfo() << "[ModelQueue] Started with" << m_maxConcurrentModels << "model slots, batch size" << m_maxBatchSize;
 }
 
 void ModelQueue::stop() {
-    QMutexLocker locker(&m_mutex);
-    if (!m_running) return;
+    QList<QThread*> threads;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_running) return;
+        
+        m_running = false;
+        m_queue.clear();
+        for (auto& slot : m_slots) {
+            threads.append(slot.thread);
+            slot.thread = nullptr;
+        }
+        m_condition.wakeAll();
+    }
     
-    m_running = false;
-    m_queue.clear();
-    m_activeRequests.clear();
-    m_condition.wakeAll();
+    // Slot loops need the mutex to notice the stop, so join unlocked
+    for (QThread* thread : threads) {
+        if (thread) {
+            thread->wait();
+            delete thread;
+        }
+    }
     
-    if (m_processingThread) {
-        m_processingThread->quit();
-        m_processingThread->wait();
-        m_processingThread->deleteLater();
-        m_processingThread = nullptr;
+    QMutexLocker locker(&m_mutex);
+    for (auto& slot : m_slots) {
+        slot.admitted.clear();
+        slot.running = 0;
+        slot.busy = false;
     }
+    m_activeRequests.clear();
+    m_cancelled.clear();
     
     qInfo() << "[ModelQueue] Stopped";
 }
@@ -139,181 +153,276 @@ void ModelQueue::setMaxConcurrentModels(int max) {
         qWarning() << "[ModelQueue] Invalid max concurrent models:" << max;
         return;
     }
+    if (m_running) {
+        qWarning() << "[ModelQueue] Stop the queue before changing the model slot count";
+        return;
+    }
     
     m_maxConcurrentModels = max;
     m_slots.resize(max);
-    for (int i = 0; i < max; ++i) {
-        if (!m_slots[i].thread) {
-            m_slots[i].thread = new QThread(this);
-            m_slots[i].thread->setObjectName(QString("ModelSlot-%1").arg(i));
-        }
+}
+
+void ModelQueue::setMaxBatchSize(int max) {
+    QMutexLocker locker(&m_mutex);
+    if (max < 1 || max > 64) {
+        qWarning() << "[ModelQueue] Invalid max batch size:" << max;
+        return;
     }
+    
+    m_maxBatchSize = max;
 }
 
-void ModelQueue::processQueue() {
-    while (m_running) {
-        Request req;
+void ModelQueue::setKVPoolTokens(int tokens) {
+    QMutexLocker locker(&m_mutex);
+    m_kvPoolTokens = tokens;
+}
+
+void ModelQueue::setKVPoolBudgetMB(int mb) {
+    QMutexLocker locker(&m_mutex);
+    m_kvPoolBudgetMB = mb;
+}
+
+void ModelQueue::runSlot(int index) {
+    struct Sequence {
+        Request request;
+        int seqId = 0;
+        std::vector<int32_t> generated;
+        int reserved = 0;   // KV positions it may grow to
+        bool done = false;
+        bool failed = false;
+    };
+    std::vector<Sequence> batch;
+    
+    // The engine is created, used and destroyed on this thread only
+    InferenceEngine* engine = nullptr;
+    QString loadedModel;
+    int nextSeqId = 1;  // Sequence 0 is the engine's default
+    int reservedTokens = 0;
+    
+    // EOS (2 is common EOS) or the token budget ends a sequence
+    auto accept = [](Sequence& seq, int32_t token) {
+        if (token == 2 || token == 0) {
+            seq.done = true;
+            return;
+        }
+        seq.generated.push_back(token);
+        seq.done = (int)seq.generated.size() >= seq.request.maxTokens;
+    };
+    
+    for (;;) {
+        QList<Request> admitted;
+        QString model;
+        int kvPoolTokens = 0;
+        int kvPoolBudgetMB = -1;
+        int batchSize = 0;
         {
             QMutexLocker locker(&m_mutex);
-            
-            // Wait for requests
-            while (m_queue.isEmpty() && m_running) {
+            ModelSlot& slot = m_slots[index];
+            slot.running = (int)batch.size();
+            admitLocked(slot);
+            while (m_running && batch.empty() && slot.admitted.isEmpty()) {
+                slot.busy = false;
                 m_condition.wait(&m_mutex, 100);
+                admitLocked(slot);
             }
-            
             if (!m_running) break;
-            if (m_queue.isEmpty()) continue;
             
-            // Check for available slot
-            ModelSlot* slot = allocateSlot(m_queue.head().modelPath);
-            if (!slot) {
-                // No slots available, wait
-                QThread::msleep(50);
-                continue;
+            slot.busy = true;
+            admitted.swap(slot.admitted);
+            slot.running += admitted.size();
+            model = slot.currentModel;
+            kvPoolTokens = m_kvPoolTokens;
+            kvPoolBudgetMB = m_kvPoolBudgetMB;
+            batchSize = m_maxBatchSize;
+            for (auto& seq : batch) {
+                seq.done = m_cancelled.contains(seq.request.id);
             }
-            
-            req = m_queue.dequeue();
-            m_activeRequests[req.id] = req;
-            slot->busy = true;
         }
         
-        emit requestStarted(req.id);
-        
-        // Get or load model in slot
-        InferenceEngine* engine = getOrLoadModel(req.modelPath);
-        if (!engine) {
-            emit requestFailed(req.id, "Failed to load model");
+        // A slot only switches models when its batch has drained
+        if (model != loadedModel) {
+            delete engine;
+            engine = nullptr;
+            if (!loadedModel.isEmpty()) {
+                emit modelUnloaded(loadedModel);
+            }
+            loadedModel.clear();
+            
+            // A full batch of contexts, unless that exceeds the memory budget;
+            // admission below keeps the running sequences within the pool
+            InferenceEngine* fresh = new InferenceEngine();
+            fresh->setKVPoolTokens(kvPoolTokens > 0 ? kvPoolTokens : batchSize * fresh->contextSize());
+            fresh->setKVPoolBudgetMB(kvPoolTokens > 0 ? -1 : kvPoolBudgetMB);
+            if (fresh->loadModel(model)) {
+                engine = fresh;
+                loadedModel = model;
+                emit modelLoaded(model);
+            } else {
+                delete fresh;
+            }
+            
             QMutexLocker locker(&m_mutex);
-            m_activeRequests.remove(req.id);
-            continue;
+            m_slots[index].engine = engine;
+            if (!engine) {
+                m_slots[index].currentModel.clear();
+            }
         }
         
-        // Connect signals for this request
-        connect(engine, &InferenceEngine::inferenceComplete, this,
-            [this, requestId = req.id](const QString& reqIdStr, const QString& result) {
-                if (reqIdStr == QString::number(requestId)) {
-                    onInferenceComplete(requestId, result);
+        // Prefill newcomers between decode steps. A sequence reserves the
+        // positions it can grow to; one that would overrun the pool goes
+        // back to the queue until a running sequence finishes
+        bool deferred = false;
+        for (const Request& req : admitted) {
+            std::vector<int32_t> prompt;
+            int reserve = 0;
+            if (engine) {
+                prompt = engine->tokenize(req.prompt);
+                reserve = std::min(engine->contextSize(), (int)prompt.size() + std::max(0, req.maxTokens));
+                if (deferred || (!batch.empty() && reservedTokens + reserve > engine->kvPoolTokens())) {
+                    deferred = true;
+                    QMutexLocker locker(&m_mutex);
+                    requeueLocked(req);
+                    continue;
                 }
-            });
+            }
+            
+            emit requestStarted(req.id);
+            if (!engine) {
+                emit requestFailed(req.id, "Failed to load model");
+                retireRequest(req.id);
+                continue;
+            }
+            
+            Sequence seq;
+            seq.request = req;
+            seq.seqId = nextSeqId++;
+            seq.reserved = reserve;
+            std::vector<float> logits = engine->beginSequence(seq.seqId, prompt);
+            if (logits.empty()) {
+                engine->endSequence(seq.seqId);
+                emit requestFailed(req.id, "Prefill failed");
+                retireRequest(req.id);
+                continue;
+            }
+            accept(seq, engine->sampleToken(logits, req.temperature));
+            reservedTokens += seq.reserved;
+            batch.push_back(std::move(seq));
+        }
+        if (deferred) {
+            QMutexLocker locker(&m_mutex);
+            m_slots[index].kvFull = true;
+        }
         
-        connect(engine, &InferenceEngine::inferenceError, this,
-            [this, requestId = req.id](const QString& reqIdStr, const QString& error) {
-                if (reqIdStr == QString::number(requestId)) {
-                    onInferenceError(requestId, error);
+        // One forward for every sequence still generating
+        std::vector<int> seqIds;
+        std::vector<int32_t> tokens;
+        std::vector<Sequence*> stepping;
+        for (auto& seq : batch) {
+            if (!seq.done) {
+                seqIds.push_back(seq.seqId);
+                tokens.push_back(seq.generated.back());
+                stepping.push_back(&seq);
+            }
+        }
+        if (!stepping.empty()) {
+            std::vector<std::vector<float>> logits = engine->decodeBatch(seqIds, tokens);
+            for (size_t i = 0; i < stepping.size(); ++i) {
+                if (logits.empty()) {
+                    stepping[i]->done = true;
+                    stepping[i]->failed = true;
+                    continue;
                 }
-            });
+                accept(*stepping[i], engine->sampleToken(logits[i], stepping[i]->request.temperature));
+            }
+            if (logits.empty()) {
+                qWarning() << "[ModelQueue] Batched decode failed for" << stepping.size() << "sequences";
+            }
+        }
         
-        // Start inference (thread-safe via QMetaObject)
-        QMetaObject::invokeMethod(engine, "runInference", Qt::QueuedConnection,
-            Q_ARG(qint64, req.id),
-            Q_ARG(QString, req.prompt),
-            Q_ARG(int, req.maxTokens),
-            Q_ARG(float, req.temperature));
-    }
-}
-
-void ModelQueue::onInferenceComplete(qint64 reqId, const QString& result) {
-    QMutexLocker locker(&m_mutex);
-    
-    if (!m_activeRequests.contains(reqId)) return;
-    
-    m_activeRequests.remove(reqId);
-    
-    // Release slot
-    for (auto& slot : m_slots) {
-        if (slot.busy && slot.engine) {
-            slot.busy = false;
-            break;
+        // Finished sequences leave the batch right away
+        for (auto it = batch.begin(); it != batch.end();) {
+            if (!it->done) {
+                ++it;
+                continue;
+            }
+            engine->endSequence(it->seqId);
+            reservedTokens -= it->reserved;
+            bool cancelled = false;
+            {
+                QMutexLocker locker(&m_mutex);
+                cancelled = m_cancelled.contains(it->request.id);
+                m_slots[index].kvFull = false;
+            }
+            if (cancelled) {
+                emit requestFailed(it->request.id, "Cancelled");
+            } else if (it->failed) {
+                emit requestFailed(it->request.id, "Generation failed");
+            } else {
+                emit requestCompleted(it->request.id, engine->detokenize(it->generated));
+            }
+            retireRequest(it->request.id);
+            it = batch.erase(it);
         }
     }
     
-    emit requestCompleted(reqId, result);
-    
-    if (m_queue.isEmpty() && m_activeRequests.isEmpty()) {
-        emit queueEmpty();
-    }
-    
-    m_condition.wakeOne();
+    delete engine;
 }
 
-void ModelQueue::onInferenceError(qint64 reqId, const QString& error) {
-    QMutexLocker locker(&m_mutex);
-    
-    if (!m_activeRequests.contains(reqId)) return;
-    
-    m_activeRequests.remove(reqId);
+void ModelQueue::admitLocked(ModelSlot& slot) {
+    bool serving = slot.running > 0 || !slot.admitted.isEmpty();
+    int capacity = m_maxBatchSize - slot.running - slot.admitted.size();
+    if (slot.kvFull && slot.running > 0) {
+        return;
+    }
     
-    // Release slot
-    for (auto& slot : m_slots) {
-        if (slot.busy) {
-            slot.busy = false;
-            break;
+    // The queue is sorted by priority, so earlier matches are more urgent.
+    // A serving slot only takes its own model; an idle one also takes a
+    // model no other slot serves and switches to it.
+    for (auto it = m_queue.begin(); it != m_queue.end() && capacity > 0;) {
+        const bool sameModel = it->modelPath == slot.currentModel;
+        if (!sameModel && (serving || servedElsewhereLocked(it->modelPath, &slot))) {
+            ++it;
+            continue;
         }
+        
+        slot.currentModel = it->modelPath;
+        slot.admitted.append(*it);
+        m_activeRequests[it->id] = *it;
+        it = m_queue.erase(it);
+        serving = true;
+        --capacity;
     }
-    
-    emit requestFailed(reqId, error);
-    m_condition.wakeOne();
 }
 
-ModelQueue::ModelSlot* ModelQueue::allocateSlot(const QString& modelPath) {
-    // Try to find slot with same model already loaded
-    for (auto& slot : m_slots) {
-        if (!slot.busy && slot.currentModel == modelPath && slot.engine) {
-            return &slot;
-        }
-    }
-    
-    // Find any free slot
-    for (auto& slot : m_slots) {
-        if (!slot.busy) {
-            return &slot;
+bool ModelQueue::servedElsewhereLocked(const QString& modelPath, const ModelSlot* except) const {
+    for (const auto& slot : m_slots) {
+        if (&slot != except && slot.currentModel == modelPath) {
+            return true;
         }
     }
-    
-    return nullptr;
+    return false;
 }
 
-void ModelQueue::releaseSlot(ModelSlot* slot) {
-    if (!slot) return;
-    slot->busy = false;
+void ModelQueue::requeueLocked(const Request& req) {
+    // Back in priority order, ahead of later arrivals of the same priority
+    m_activeRequests.remove(req.id);
+    QList<Request> list = m_queue.toList();
+    list.insert(std::upper_bound(list.begin(), list.end(), req), req);
+    m_queue.clear();
+    for (const auto& r : list) {
+        m_queue.enqueue(r);
+    }
 }
 
-InferenceEngine* ModelQueue::getOrLoadModel(const QString& modelPath) {
-    // Find slot with model
-    for (auto& slot : m_slots) {
-        if (slot.currentModel == modelPath && slot.engine) {
-            return slot.engine;
-        }
-    }
+void ModelQueue::retireRequest(qint64 reqId) {
+    QMutexLocker locker(&m_mutex);
+    m_activeRequests.remove(reqId);
+    m_cancelled.remove(reqId);
+    const bool drained = m_queue.isEmpty() && m_activeRequests.isEmpty();
+    m_condition.wakeAll();
+    locker.unlock();
     
-    // Load model in free slot
-    for (auto& slot : m_slots) {
-        if (!slot.busy) {
-            if (slot.engine) {
-                slot.engine->deleteLater();
-            }
-            
-            slot.engine = new InferenceEngine(modelPath);
-            slot.engine->moveToThread(slot.thread);
-            slot.thread->start();
-            
-            // Load model synchronously
-            bool loaded = false;
-            QMetaObject::invokeMethod(slot.engine, "loadModel", Qt::BlockingQueuedConnection,
-                Q_RETURN_ARG(bool, loaded),
-                Q_ARG(QString, modelPath));
-            
-            if (loaded) {
-                slot.currentModel = modelPath;
-                emit modelLoaded(modelPath);
-                return slot.engine;
-            } else {
-                slot.engine->deleteLater();
-                slot.engine = nullptr;
-                return nullptr;
-            }
-        }
+    if (drained) {
+        emit queueEmpty();
     }
-    
-    return nullptr;
 }
@@ -7,6 +7,10 @@
 #include <QThread>
 #include <QString>
 #include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QVector>
 #include <memory>
 
 class InferenceEngine;
@@ -16,6 +20,9 @@ class InferenceEngine;
  * 
  * Features:
  * - Priority-based scheduling (HIGH, NORMAL, LOW)
+ * - Continuous batching: each slot decodes all of its sequences in one
+ *   forward per step, admits new requests between steps and retires
+ *   finished ones immediately
  * - Concurrent model loading (up to 2+ models)
  * - Memory-aware queue management
  * - Request throttling and backpressure
@@ -65,7 +72,7 @@ public:
                    Priority priority = NORMAL);
 
     /**
-     * @brief Cancel a pending request
+     * @brief Cancel a pending request, or stop a running one at the next step
      */
     bool cancelRequest(qint64 requestId);
 
@@ -74,6 +81,7 @@ public:
      */
     int pendingRequests() const;
     int activeModels() const;
+    int activeSequences() const;  // Admitted or decoding across all slots
     
     /**
      * @brief Start processing queue
@@ -86,9 +94,30 @@ public:
     void stop();
 
     /**
-     * @brief Set maximum concurrent models (default: 2)
+     * @brief Set maximum concurrent models (default: 2, only while stopped)
      */
     void setMaxConcurrentModels(int max);
+    
+    /**
+     * @brief Set maximum sequences decoded together per model (default: 8)
+     */
+    void setMaxBatchSize(int max);
+    
+    /**
+     * @brief Token positions in each slot's KV pool (applies to the next model load)
+     *
+     * <= 0 (default) asks for a full batch of context windows, capped by
+     * setKVPoolBudgetMB(). Requests that would not fit beside the running
+     * ones wait in the queue until sequences finish.
+     */
+    void setKVPoolTokens(int tokens);
+    
+    /**
+     * @brief Memory cap for each slot's default KV pool (default: 4096 MB)
+     *
+     * Ignored when setKVPoolTokens() is set; < 0 removes the cap.
+     */
+    void setKVPoolBudgetMB(int mb);
 
 signals:
     void requestStarted(qint64 requestId);
@@ -98,32 +127,41 @@ signals:
     void modelLoaded(const QString& modelPath);
     void modelUnloaded(const QString& modelPath);
 
-private slots:
-    void processQueue();
-    void onInferenceComplete(qint64 reqId, const QString& result);
-    void onInferenceError(qint64 reqId, const QString& error);
-
 private:
+    /**
+     * @brief One loaded model and the batch of sequences decoding on it
+     *
+     * The slot thread owns the engine: it loads the model, prefills admitted
+     * requests and runs the batched decode steps. Fields are guarded by
+     * m_mutex; the engine itself is only touched on the slot thread.
+     */
     struct ModelSlot {
-        QString currentModel;
+        QString currentModel;               // Model the slot serves (or will load)
         InferenceEngine* engine = nullptr;
-        bool busy = false;
+        bool busy = false;                  // Has admitted or running sequences
         QThread* thread = nullptr;
+        QList<Request> admitted;            // Waiting for prefill at the next step boundary
+        int running = 0;                    // Sequences in the decode batch
+        bool kvFull = false;                // A request waits for KV room; admit nothing until one finishes
     };
 
-    ModelSlot* allocateSlot(const QString& modelPath);
-    void releaseSlot(ModelSlot* slot);
-    InferenceEngine* getOrLoadModel(const QString& modelPath);
+    void runSlot(int index);
+    void admitLocked(ModelSlot& slot);
+    bool servedElsewhereLocked(const QString& modelPath, const ModelSlot* except) const;
+    void retireRequest(qint64 reqId);
+    void requeueLocked(const Request& req);
 
     mutable QMutex m_mutex;
     QWaitCondition m_condition;
     QQueue<Request> m_queue;
     QHash<qint64, Request> m_activeRequests;
+    QSet<qint64> m_cancelled;               // Running requests to drop at the next step
     QVector<ModelSlot> m_slots;
     
     qint64 m_nextRequestId = 1;
     int m_maxConcurrentModels = 2;
+    int m_maxBatchSize = 8;
+    int m_kvPoolTokens = 0;
+    int m_kvPoolBudgetMB = 4096;
     bool m_running = false;
-    
-    QThread* m_processingThread = nullptr;
 };
@@ -21,6 +21,7 @@ void ProxyHotpatcher::addRule(const ProxyHotpatchRule& rule)
 {
     QMutexLocker locker(&m_mutex);
     m_rules[rule.name] = rule;
+    m_rewritersDirty = true;
     qInfo() << "[ProxyHotpatcher] Added rule:" << rule.name;
 }
 
@@ -28,6 +29,7 @@ void ProxyHotpatcher::removeRule(const QString& name)
 {
     QMutexLocker locker(&m_mutex);
     if (m_rules.remove(name)) {
+        m_rewritersDirty = true;
         qInfo() << "[ProxyHotpatcher] Removed rule:" << name;
     }
 }
@@ -37,6 +39,7 @@ void ProxyHotpatcher::enableRule(const QString& name, bool enable)
     QMutexLocker locker(&m_mutex);
     if (m_rules.contains(name)) {
         m_rules[name].enabled = enable;
+        m_rewritersDirty = true;
         qInfo() << "[ProxyHotpatcher] Rule" << name << (enable ? "enabled" : "disabled");
     }
 }
@@ -63,6 +66,7 @@ void ProxyHotpatcher::clearAllRules()
 {
     QMutexLocker locker(&m_mutex);
     m_rules.clear();
+    m_rewritersDirty = true;
     qInfo() << "[ProxyHotpatcher] All rules cleared";
 }
 
@@ -76,19 +80,16 @@ QByteArray ProxyHotpatcher::processRequest(const QByteArray& requestData)
     
     m_timer.start();
     
-    QByteArray modified = requestData;
+    if (m_rewritersDirty) {
+        rebuildRewriters();
+    }
     
-    // Apply memory injection rules (parameter overrides)
-    for (const auto& rule : m_rules) {
-        if (!rule.enabled || rule.type != ProxyHotpatchRule::ParameterOverride) {
-            continue;
-        }
-        
-        if (!rule.searchPattern.isEmpty() && !rule.replacement.isEmpty()) {
-            modified = bytePatchInPlace(modified, rule.searchPattern, rule.replacement);
-            m_stats.patchesApplied++;
-            emit ruleApplied(rule.name, "Request:ParameterOverride");
-        }
+    // Apply memory injection rules (parameter overrides) in one pass
+    QByteArray modified = requestData;
+    if (!m_requestRewriter.isEmpty()) {
+        ByteRewriteEngine::Stream stream;
+        modified = m_requestRewriter.rewriteAll(requestData, &stream);
+        emitRewriteHits(stream, m_requestRewriteRules, "Request:ParameterOverride");
     }
     
     m_stats.requestsProcessed++;
@@ -139,37 +140,40 @@ QByteArray ProxyHotpatcher::processResponse(const QByteArray& responseData)
     
     m_timer.start();
     
+    if (m_rewritersDirty) {
+        rebuildRewriters();
+    }
+    
     QByteArray modified = responseData;
     
-    // Apply agent validation and correction
+    // Apply agent validation and correction (validation covers every rule at once)
+    bool validate = false;
     for (const auto& rule : m_rules) {
-        if (!rule.enabled) {
-            continue;
-        }
+        validate |= rule.enabled && rule.type == ProxyHotpatchRule::AgentValidation;
+    }
+    
+    if (validate) {
+        AgentValidation validation = validateAgentOutputLocked(modified);
         
-        if (rule.type == ProxyHotpatchRule::AgentValidation) {
-            AgentValidation validation = validateAgentOutput(modified);
+        if (!validation.isValid) {
+            m_stats.validationFailures++;
+            emit validationFailed(validation.errorMessage, validation.violations);
             
-            if (!validation.isValid) {
-                m_stats.validationFailures++;
-                emit validationFailed(validation.errorMessage, validation.violations);
-                
-                if (!validation.correctedOutput.isEmpty()) {
-                    modified = validation.correctedOutput.toUtf8();
-                    m_stats.correctionsApplied++;
-                    emit agentOutputCorrected(validation.errorMessage, modified);
-                }
-            }
-        }
-        else if (rule.type == ProxyHotpatchRule::ResponseCorrection) {
-            if (!rule.searchPattern.isEmpty() && !rule.replacement.isEmpty()) {
-                modified = bytePatchInPlace(modified, rule.searchPattern, rule.replacement);
-                m_stats.patchesApplied++;
-                emit ruleApplied(rule.name, "Response:Correction");
+            if (!validation.correctedOutput.isEmpty()) {
+                modified = validation.correctedOutput.toUtf8();
+                m_stats.correctionsApplied++;
+                emit agentOutputCorrected(validation.errorMessage, modified);
             }
         }
     }
     
+    // All response corrections in one pass
+    if (!m_responseRewriter.isEmpty()) {
+        ByteRewriteEngine::Stream stream;
+        modified = m_responseRewriter.rewriteAll(modified, &stream);
+        emitRewriteHits(stream, m_responseRewriteRules, "Response:Correction");
+    }
+    
     m_stats.responsesProcessed++;
     
     qint64 elapsed = m_timer.nsecsElapsed() / 1000000;
@@ -222,6 +226,11 @@ QJsonObject ProxyHotpatcher::processResponseJson(const QJsonObject& response)
 }
 
 QByteArray ProxyHotpatcher::processStreamChunk(const QByteArray& chunk, int chunkIndex)
+{
+    return processStreamChunk(QString(), chunk, chunkIndex);
+}
+
+QByteArray ProxyHotpatcher::processStreamChunk(const QString& streamId, const QByteArray& chunk, int chunkIndex)
 {
     QMutexLocker locker(&m_mutex);
     
@@ -234,30 +243,51 @@ QByteArray ProxyHotpatcher::processStreamChunk(const QByteArray& chunk, int chun
     // Check for RST injection (stream termination)
     if (shouldTerminateStream(chunkIndex)) {
         m_stats.streamsTerminated++;
+        m_streams.remove(streamId);
         emit streamTerminated(chunkIndex, "RST Injection triggered");
-        return QByteArray(); // Empty = terminate stream
+        return QByteArray(); // Null = terminate stream
     }
     
-    QByteArray modified = chunk;
+    if (m_rewritersDirty) {
+        rebuildRewriters();
+    }
     
-    // Apply stream-level corrections
-    for (const auto& rule : m_rules) {
-        if (!rule.enabled || rule.type != ProxyHotpatchRule::ResponseCorrection) {
-            continue;
-        }
-        
-        if (!rule.searchPattern.isEmpty() && !rule.replacement.isEmpty()) {
-            modified = bytePatchInPlace(modified, rule.searchPattern, rule.replacement);
-            m_stats.patchesApplied++;
-        }
+    ByteRewriteEngine::Stream& stream = m_streams[streamId];
+    if (chunkIndex == 0) {
+        stream = ByteRewriteEngine::Stream();
     }
     
+    // Apply stream-level corrections; matches may continue into the next chunk
+    QByteArray modified("");
+    const int replaced = m_responseRewriter.rewrite(stream, chunk, modified);
+    
     m_stats.chunksProcessed++;
+    m_stats.patchesApplied += replaced;
     m_stats.bytesPatched += modified.size();
     
     return modified;
 }
 
+QByteArray ProxyHotpatcher::finishStream(const QString& streamId)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    QByteArray tail("");
+    auto it = m_streams.find(streamId);
+    if (it == m_streams.end()) {
+        return tail;
+    }
+    m_responseRewriter.finish(it.value(), tail);
+    m_streams.erase(it);
+    return tail;
+}
+
+int ProxyHotpatcher::activeStreamCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_streams.size());
+}
+
 QByteArray ProxyHotpatcher::bytePatchInPlace(const QByteArray& data, const QByteArray& pattern, const QByteArray& replacement)
 {
     if (pattern.isEmpty() || data.isEmpty()) {
@@ -359,7 +389,11 @@ PatternMatch ProxyHotpatcher::boyerMooreSearch(const QByteArray& data, const QBy
 AgentValidation ProxyHotpatcher::validateAgentOutput(const QByteArray& output)
 {
     QMutexLocker locker(&m_mutex);
-    
+    return validateAgentOutputLocked(output);
+}
+
+AgentValidation ProxyHotpatcher::validateAgentOutputLocked(const QByteArray& output)
+{
     AgentValidation result = AgentValidation::valid();
     
     // Apply custom validators first (if any)
@@ -536,6 +570,53 @@ bool ProxyHotpatcher::isEnabled() const
 
 // Private helper methods
 
+void ProxyHotpatcher::rebuildRewriters()
+{
+    m_requestRewriter.clear();
+    m_responseRewriter.clear();
+    m_requestRewriteRules.clear();
+    m_responseRewriteRules.clear();
+    
+    // Sorted names make the winner between identical patterns deterministic
+    QStringList names = m_rules.keys();
+    std::sort(names.begin(), names.end());
+    for (const QString& name : names) {
+        const ProxyHotpatchRule& rule = m_rules[name];
+        if (!rule.enabled || rule.searchPattern.isEmpty() || rule.replacement.isEmpty()) {
+            continue;
+        }
+        
+        if (rule.type == ProxyHotpatchRule::ParameterOverride) {
+            m_requestRewriter.add(rule.searchPattern, rule.replacement);
+            m_requestRewriteRules.append(name);
+        } else if (rule.type == ProxyHotpatchRule::ResponseCorrection) {
+            m_responseRewriter.add(rule.searchPattern, rule.replacement);
+            m_responseRewriteRules.append(name);
+        }
+    }
+    
+    m_requestRewriter.build();
+    m_responseRewriter.build();
+    
+    // Streams in progress keep their held bytes but restart matching
+    for (ByteRewriteEngine::Stream& stream : m_streams) {
+        stream.state = 0;
+        stream.hits.clear();
+    }
+    m_rewritersDirty = false;
+}
+
+void ProxyHotpatcher::emitRewriteHits(const ByteRewriteEngine::Stream& stream, const QStringList& ruleNames, const QString& context)
+{
+    for (size_t r = 0; r < stream.hits.size(); ++r) {
+        if (stream.hits[r] == 0) {
+            continue;
+        }
+        m_stats.patchesApplied += stream.hits[r];
+        emit ruleApplied(ruleNames[int(r)], context);
+    }
+}
+
 QHash<quint8, qint64> ProxyHotpatcher::buildBadCharTable(const QByteArray& pattern) const
 {
     QHash<quint8, qint64> table;
@@ -12,6 +12,7 @@
 #include <QElapsedTimer>
 #include <functional>
 #include "model_memory_hotpatch.hpp"
+#include "byte_rewrite_engine.hpp"
 
 // Agent output validation result
 struct AgentValidation {
@@ -94,7 +95,29 @@ public:
     // Response processing (Agent Correction)
     QByteArray processResponse(const QByteArray& responseData);
     QJsonObject processResponseJson(const QJsonObject& response);
+    /**
+     * @brief Rewrite one chunk of the default stream
+     *
+     * Same as processStreamChunk(QString(), chunk, chunkIndex): chunk 0
+     * starts the stream and finishStream() returns its held-back tail, so
+     * only one stream at a time may use it.
+     */
     QByteArray processStreamChunk(const QByteArray& chunk, int chunkIndex);
+    /**
+     * @brief Rewrite one chunk of the response identified by @p streamId
+     *
+     * Chunk 0 starts the stream. Bytes that may begin a pattern split
+     * across chunks are held back and come out with the next chunk or
+     * finishStream(), so the result can be empty without the stream ending;
+     * only a null QByteArray means the stream was terminated. Concurrent
+     * streams need distinct ids (connection or request id).
+     */
+    QByteArray processStreamChunk(const QString& streamId, const QByteArray& chunk, int chunkIndex);
+    /**
+     * @brief End a stream: returns its held-back bytes and drops its state
+     */
+    QByteArray finishStream(const QString& streamId = QString());
+    int activeStreamCount() const;
     
     // Zero-copy byte patching (production-ready)
     QByteArray bytePatchInPlace(const QByteArray& data, const QByteArray& pattern, const QByteArray& replacement);
@@ -179,6 +202,11 @@ private:
     bool checkRequiredPatterns(const QByteArray& output, QStringList& violations);
     bool isPlanFormatValid(const QByteArray& output);
     bool isAgentFormatValid(const QByteArray& output);
+    AgentValidation validateAgentOutputLocked(const QByteArray& output);
+    
+    // Compiles enabled ParameterOverride / ResponseCorrection patterns
+    void rebuildRewriters();
+    void emitRewriteHits(const ByteRewriteEngine::Stream& stream, const QStringList& ruleNames, const QString& context);
     
     // Data members
     mutable QMutex m_mutex;
@@ -189,5 +217,13 @@ private:
     int m_streamTerminationPoint = -1;
     int m_currentChunkIndex = 0;
     
+    // One automaton per direction, rebuilt lazily after rule changes
+    ByteRewriteEngine m_requestRewriter;
+    ByteRewriteEngine m_responseRewriter;
+    QStringList m_requestRewriteRules;
+    QStringList m_responseRewriteRules;
+    bool m_rewritersDirty = true;
+    QHash<QString, ByteRewriteEngine::Stream> m_streams;  // Per streamId until finishStream()
+    
     QElapsedTimer m_timer;
 };
@@ -2,37 +2,53 @@
 #include <QFile>
 #include <QDataStream>
 #include <QDebug>
-#include <QRegularExpression>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 
-// Simple lattice structure for Viterbi algorithm
-struct SentencePieceTokenizer::Lattice {
-    struct Node {
-        int pos;                              // Position in text
-        float score;                          // Cumulative score
-        int backPointer;                      // Previous node
-        int32_t tokenId;                      // Token at this position
-    };
-    
-    QVector<QVector<Node>> nodes;  // nodes[pos] = possible tokens starting at pos
-    QString text;
-    
-    Lattice(const QString& t) : text(t) {
-        nodes.resize(t.length() + 1);
-        // Initialize start node
-        Node start{0, 0.0f, -1, -1};
-        nodes[0].append(start);
+namespace {
+
+constexpr int32_t kRootCheck = -2;
+
+// Bytes in the UTF-8 sequence led by this byte (stray continuation bytes count as one)
+inline int utf8Length(uint8_t lead) {
+    if (lead < 0xC0) return 1;
+    if (lead < 0xE0) return 2;
+    if (lead < 0xF0) return 3;
+    return 4;
+}
+
+inline void appendUtf8(std::string& out, char32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(char(cp));
+    } else if (cp < 0x800) {
+        out.push_back(char(0xC0 | (cp >> 6)));
+        out.push_back(char(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(char(0xE0 | (cp >> 12)));
+        out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(char(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(char(0xF0 | (cp >> 18)));
+        out.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(char(0x80 | (cp & 0x3F)));
     }
-};
+}
 
-SentencePieceTokenizer::SentencePieceTokenizer() {
-    m_trie = new TrieNode();
+// "<0xAB>" -> 0xAB, or -1
+int parseBytePiece(const QString& piece) {
+    if (piece.size() != 6 || !piece.startsWith("<0x") || piece[5] != QChar('>')) return -1;
+    bool ok = false;
+    const uint value = piece.mid(3, 2).toUInt(&ok, 16);
+    return ok ? int(value) : -1;
 }
 
-SentencePieceTokenizer::~SentencePieceTokenizer() {
-    delete m_trie;
+} // namespace
+
+SentencePieceTokenizer::SentencePieceTokenizer() {
+    std::fill(std::begin(m_byteTokens), std::end(m_byteTokens), -1);
 }
 
 bool SentencePieceTokenizer::loadFromFile(const QString& modelPath) {
@@ -45,12 +61,15 @@ bool SentencePieceTokenizer::loadFromFile(const QString& modelPath) {
     // Simplified protobuf parser (production would use proper protobuf library)
     QDataStream stream(&file);
     stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
     
     // Skip header, read pieces count
     file.seek(16);
     int32_t numPieces;
     stream >> numPieces;
     
+    m_pieces.clear();
+    m_pieceToId.clear();
     m_pieces.reserve(numPieces);
     
     for (int32_t i = 0; i < numPieces; ++i) {
@@ -79,7 +98,7 @@ bool SentencePieceTokenizer::loadFromFile(const QString& modelPath) {
         m_pieceToId[piece.piece] = i;
     }
     
-    buildTrie();
+    finalizeVocabulary(QByteArray());
     
     qInfo() << "SentencePiece loaded:" << m_pieces.size() << "pieces";
     return true;
@@ -95,6 +114,8 @@ bool SentencePieceTokenizer::loadFromGGUFMetadata(const QHash<QString, QByteArra
         int32_t numTokens;
         stream >> numTokens;
         
+        m_pieces.clear();
+        m_pieceToId.clear();
         m_pieces.reserve(numTokens);
         
         for (int32_t i = 0; i < numTokens; ++i) {
@@ -124,15 +145,17 @@ bool SentencePieceTokenizer::loadFromGGUFMetadata(const QHash<QString, QByteArra
             QByteArray scoresData = metadata["tokenizer.ggml.scores"];
             QDataStream scoreStream(scoresData);
             scoreStream.setByteOrder(QDataStream::LittleEndian);
+            scoreStream.setFloatingPointPrecision(QDataStream::SinglePrecision);  // float32, not the double default
             
-            for (int i = 0; i < m_pieces.size(); ++i) {
+            const int numScores = std::min(m_pieces.size(), int(scoresData.size() / qsizetype(sizeof(float))));
+            for (int i = 0; i < numScores; ++i) {
                 float score;
                 scoreStream >> score;
                 m_pieces[i].score = score;
             }
         }
         
-        buildTrie();
+        finalizeVocabulary(metadata.value("tokenizer.ggml.token_type"));
         qInfo() << "SentencePiece loaded from GGUF:" << m_pieces.size() << "pieces";
         return true;
     }
@@ -140,160 +163,225 @@ bool SentencePieceTokenizer::loadFromGGUFMetadata(const QHash<QString, QByteArra
     return false;
 }
 
-void SentencePieceTokenizer::buildTrie() {
-    for (const SentencePiece& piece : m_pieces) {
-        insertTrie(piece.piece, piece.id);
-    }
-}
-
-void SentencePieceTokenizer::insertTrie(const QString& piece, int32_t id) {
-    TrieNode* node = m_trie;
-    for (QChar ch : piece) {
-        if (!node->children.contains(ch)) {
-            node->children[ch] = new TrieNode();
+void SentencePieceTokenizer::finalizeVocabulary(const QByteArray& tokenTypes) {
+    // tokenizer.ggml.token_type is int32 per token: 1 normal, 2 unknown,
+    // 3 control, 4 user-defined, 5 unused, 6 byte. Without it, types are
+    // inferred from the piece text.
+    const qsizetype typedCount = tokenTypes.size() / qsizetype(sizeof(int32_t));
+    std::fill(std::begin(m_byteTokens), std::end(m_byteTokens), -1);
+    float minScore = 0.0f;
+    m_pieceBytes.assign(size_t(m_pieces.size()), std::string());
+    
+    for (int i = 0; i < m_pieces.size(); ++i) {
+        SentencePiece& piece = m_pieces[i];
+        const int byteValue = parseBytePiece(piece.piece);
+        if (i < typedCount) {
+            int32_t type;
+            std::memcpy(&type, tokenTypes.constData() + i * qsizetype(sizeof(int32_t)), sizeof(type));
+            piece.type = type >= 1 && type <= 6 ? SentencePiece::Type(type - 1) : SentencePiece::NORMAL;
+        } else if (byteValue >= 0) {
+            piece.type = SentencePiece::BYTE;
+        } else if (piece.piece == "<unk>") {
+            piece.type = SentencePiece::UNKNOWN;
+        } else if (piece.piece == "<s>" || piece.piece == "</s>" || piece.piece == "<pad>" ||
+                   piece.piece == "<|begin_of_text|>" || piece.piece == "<|end_of_text|>") {
+            piece.type = SentencePiece::CONTROL;
         }
-        node = node->children[ch];
-    }
-    node->tokenId = id;
-}
-
-QVector<int32_t> SentencePieceTokenizer::findMatchingPieces(const QString& text, int pos) {
-    QVector<int32_t> matches;
-    TrieNode* node = m_trie;
-    
-    for (int i = pos; i < text.length(); ++i) {
-        QChar ch = text[i];
-        if (!node->children.contains(ch)) break;
         
-        node = node->children[ch];
-        if (node->tokenId >= 0) {
-            matches.append(node->tokenId);
+        if (piece.type == SentencePiece::BYTE && byteValue >= 0) {
+            m_byteTokens[byteValue] = piece.id;
+            m_pieceBytes[size_t(i)].assign(1, char(byteValue));
+        } else {
+            const QByteArray utf8 = QString(piece.piece).replace(QChar(0x2581), QChar(' ')).toUtf8();
+            m_pieceBytes[size_t(i)].assign(utf8.constData(), size_t(utf8.size()));
+        }
+        if (piece.type == SentencePiece::NORMAL) {
+            minScore = std::min(minScore, piece.score);
         }
     }
     
-    return matches;
-}
-
-QString SentencePieceTokenizer::normalize(const QString& text) {
-    // Basic NFKC normalization (simplified)
-    QString result = text;
-    
-    // Replace various whitespace with standard space
-    result.replace(QRegularExpression("[\\t\\n\\r]+"), " ");
-    
-    // Trim
-    result = result.trimmed();
-    
-    return result;
-}
-
-QString SentencePieceTokenizer::replaceSP(const QString& text) {
-    // Replace space with ▁ (U+2581)
-    QString result = text;
-    result.replace(' ', QChar(0x2581));
-    return result;
-}
-
-QString SentencePieceTokenizer::unreplaceSP(const QString& text) {
-    // Replace ▁ with space
-    QString result = text;
-    result.replace(QChar(0x2581), ' ');
-    return result;
+    m_byteFallback = std::find(std::begin(m_byteTokens), std::end(m_byteTokens), -1) == std::end(m_byteTokens);
+    m_unkScore = minScore - 10.0f;
+    buildTrie();
 }
 
-SentencePieceTokenizer::Lattice* SentencePieceTokenizer::buildLattice(const QString& text) {
-    Lattice* lattice = new Lattice(text);
-    
-    for (int pos = 0; pos < text.length(); ++pos) {
-        if (lattice->nodes[pos].isEmpty()) continue;
+void SentencePieceTokenizer::buildTrie() {
+    // Matchable pieces as UTF-8 keys in byte order. Among duplicate strings
+    // the later id wins, as with the previous node trie.
+    std::vector<std::pair<std::string, int32_t>> keys;
+    keys.reserve(size_t(m_pieces.size()));
+    for (const SentencePiece& piece : m_pieces) {
+        if (piece.type != SentencePiece::NORMAL && piece.type != SentencePiece::USER_DEFINED) continue;
+        const QByteArray utf8 = piece.piece.toUtf8();
+        if (utf8.isEmpty()) continue;
+        keys.emplace_back(std::string(utf8.constData(), size_t(utf8.size())), piece.id);
+    }
+    std::stable_sort(keys.begin(), keys.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    size_t unique = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (unique > 0 && keys[unique - 1].first == keys[i].first) {
+            keys[unique - 1].second = keys[i].second;
+        } else {
+            if (unique != i) keys[unique] = std::move(keys[i]);
+            ++unique;
+        }
+    }
+    keys.resize(unique);
+    
+    // Place each node's children at the first base where all their slots are
+    // free. A node covers the sorted key range sharing its prefix.
+    struct Range {
+        int32_t node;
+        size_t depth;
+        size_t lo;
+        size_t hi;
+    };
+    std::vector<Range> pending{{0, 0, 0, keys.size()}};
+    std::vector<std::pair<uint8_t, size_t>> children;  // (label, first key)
+    m_trie.assign(1024, TrieUnit{});
+    m_trie[0].check = kRootCheck;
+    size_t firstFree = 1;
+    size_t used = 1;
+    
+    while (!pending.empty()) {
+        const Range range = pending.back();
+        pending.pop_back();
         
-        // Find all pieces that can start at this position
-        QVector<int32_t> matches = findMatchingPieces(text, pos);
+        size_t i = range.lo;
+        if (i < range.hi && keys[i].first.size() == range.depth) {
+            m_trie[size_t(range.node)].value = keys[i].second;
+            m_trie[size_t(range.node)].score = m_pieces[keys[i].second].score;
+            ++i;
+        }
+        children.clear();
+        for (; i < range.hi; ++i) {
+            const uint8_t label = uint8_t(keys[i].first[range.depth]);
+            if (children.empty() || children.back().first != label) children.emplace_back(label, i);
+        }
+        if (children.empty()) continue;
         
-        for (int32_t tokenId : matches) {
-            const SentencePiece& piece = m_pieces[tokenId];
-            int endPos = pos + piece.piece.length();
-            
-            if (endPos > text.length()) continue;
-            
-            // Add node to lattice
-            for (const Lattice::Node& prevNode : lattice->nodes[pos]) {
-                Lattice::Node newNode;
-                newNode.pos = endPos;
-                newNode.score = prevNode.score + piece.score;
-                newNode.backPointer = pos;
-                newNode.tokenId = tokenId;
-                
-                lattice->nodes[endPos].append(newNode);
+        size_t base = 0;
+        for (size_t pos = std::max(firstFree, size_t(children.front().first) + 1);; ++pos) {
+            base = pos - children.front().first;
+            if (base + 256 >= m_trie.size()) m_trie.resize(std::max(m_trie.size() * 2, base + 257));
+            if (m_trie[pos].check != -1) continue;
+            bool fits = true;
+            for (const auto& child : children) {
+                if (m_trie[base + child.first].check != -1) {
+                    fits = false;
+                    break;
+                }
             }
+            if (fits) break;
         }
         
-        // Byte fallback for unknown characters
-        if (m_byteFallback && lattice->nodes[pos + 1].isEmpty() && pos + 1 <= text.length()) {
-            uint8_t byte = text[pos].toLatin1();
-            
-            Lattice::Node byteNode;
-            byteNode.pos = pos + 1;
-            byteNode.score = lattice->nodes[pos].first().score - 10.0f;  // Penalty
-            byteNode.backPointer = pos;
-            byteNode.tokenId = m_unkId;
-            
-            lattice->nodes[pos + 1].append(byteNode);
+        m_trie[size_t(range.node)].base = int32_t(base);
+        used = std::max(used, base + 256);
+        for (size_t c = 0; c < children.size(); ++c) {
+            const size_t slot = base + children[c].first;
+            m_trie[slot].check = range.node;
+            const size_t hi = c + 1 < children.size() ? children[c + 1].second : range.hi;
+            pending.push_back(Range{int32_t(slot), range.depth + 1, children[c].second, hi});
         }
+        while (firstFree < m_trie.size() && m_trie[firstFree].check != -1) ++firstFree;
     }
     
-    return lattice;
+    // Any byte from any unit lands inside the array: leaves keep base 0
+    m_trie.resize(std::max(used, size_t(256)));
+    m_trie.shrink_to_fit();
 }
 
-std::vector<int32_t> SentencePieceTokenizer::viterbi(Lattice* lattice) {
-    std::vector<int32_t> result;
-    
-    int endPos = lattice->text.length();
-    if (lattice->nodes[endPos].isEmpty()) {
-        qWarning() << "No valid tokenization found";
-        delete lattice;
-        return result;
-    }
-    
-    // Find best path (highest score)
-    const Lattice::Node* bestEnd = &lattice->nodes[endPos].first();
-    for (const Lattice::Node& node : lattice->nodes[endPos]) {
-        if (node.score > bestEnd->score) {
-            bestEnd = &node;
+void SentencePieceTokenizer::normalize(const QString& text, std::string& out) const {
+    // Basic NFKC normalization (simplified): trim, collapse runs of tabs and
+    // line breaks to one space, then prefix a space and write spaces as ▁
+    static const char kSpace[] = "\xE2\x96\x81";  // U+2581
+    const QChar* chars = text.constData();
+    qsizetype begin = 0;
+    qsizetype end = text.size();
+    while (begin < end && chars[begin].isSpace()) ++begin;
+    while (end > begin && chars[end - 1].isSpace()) --end;
+    
+    out.clear();
+    out.append(kSpace, 3);
+    for (qsizetype i = begin; i < end; ++i) {
+        char32_t cp = chars[i].unicode();
+        if (cp == '\t' || cp == '\n' || cp == '\r') {
+            while (i + 1 < end && (chars[i + 1] == QChar('\t') || chars[i + 1] == QChar('\n') || chars[i + 1] == QChar('\r'))) ++i;
+            cp = ' ';
         }
+        if (cp == ' ') {
+            out.append(kSpace, 3);
+            continue;
+        }
+        if (QChar::isHighSurrogate(cp) && i + 1 < end && chars[i + 1].isLowSurrogate()) {
+            cp = QChar::surrogateToUcs4(chars[i], chars[i + 1]);
+            ++i;
+        } else if (QChar::isSurrogate(cp)) {
+            cp = 0xFFFD;
+        }
+        appendUtf8(out, cp);
     }
-    
-    // Backtrack to collect tokens
-    std::vector<int32_t> reversed;
-    int pos = endPos;
-    
-    while (pos > 0) {
-        const Lattice::Node* current = nullptr;
+}
+
+const std::vector<SentencePieceTokenizer::Segment>& SentencePieceTokenizer::viterbi(const std::string& text) const {
+    // best[i] is the best score of any segmentation of text[0, i); each
+    // position keeps only its best incoming edge. Every character start gets
+    // an unknown-character edge when no piece spans exactly that character,
+    // so the end is always reachable.
+    thread_local std::vector<float> best;
+    thread_local std::vector<int32_t> fromPos;
+    thread_local std::vector<int32_t> fromId;
+    thread_local std::vector<Segment> path;
+    
+    const int32_t n = int32_t(text.size());
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(text.data());
+    const TrieUnit* trie = m_trie.data();
+    best.assign(size_t(n) + 1, -std::numeric_limits<float>::infinity());
+    fromPos.resize(size_t(n) + 1);
+    fromId.resize(size_t(n) + 1);
+    best[0] = 0.0f;
+    
+    for (int32_t pos = 0; pos < n; ++pos) {
+        const float score = best[size_t(pos)];
+        if (score == -std::numeric_limits<float>::infinity()) continue;  // Inside a character
         
-        for (const Lattice::Node& node : lattice->nodes[pos]) {
-            if (&node == bestEnd || node.backPointer == bestEnd->backPointer) {
-                current = &node;
-                break;
+        const int32_t charEnd = std::min(n, pos + utf8Length(bytes[pos]));
+        bool charCovered = false;
+        int32_t node = 0;
+        for (int32_t i = pos; i < n; ++i) {
+            const int32_t next = trie[node].base + bytes[i];
+            if (trie[next].check != node) break;
+            node = next;
+            const int32_t id = trie[node].value;
+            if (id < 0) continue;
+            
+            const int32_t end = i + 1;
+            const float candidate = score + trie[node].score;
+            if (candidate > best[size_t(end)]) {
+                best[size_t(end)] = candidate;
+                fromPos[size_t(end)] = pos;
+                fromId[size_t(end)] = id;
             }
+            charCovered |= end == charEnd;
         }
         
-        if (!current) break;
-        
-        if (current->tokenId >= 0) {
-            reversed.push_back(current->tokenId);
-        }
-        
-        pos = current->backPointer;
-        if (pos >= 0 && !lattice->nodes[pos].isEmpty()) {
-            bestEnd = &lattice->nodes[pos].first();
+        if (!charCovered) {
+            const float candidate = score + m_unkScore;
+            if (candidate > best[size_t(charEnd)]) {
+                best[size_t(charEnd)] = candidate;
+                fromPos[size_t(charEnd)] = pos;
+                fromId[size_t(charEnd)] = -1;
+            }
         }
     }
     
-    // Reverse to get correct order
-    result.assign(reversed.rbegin(), reversed.rend());
-    
-    delete lattice;
-    return result;
+    path.clear();
+    for (int32_t end = n; end > 0; end = fromPos[size_t(end)]) {
+        path.push_back(Segment{fromPos[size_t(end)], end, fromId[size_t(end)]});
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
 }
 
 std::vector<int32_t> SentencePieceTokenizer::encode(const QString& text, bool addBos, bool addEos) {
@@ -302,21 +390,36 @@ std::vector<int32_t> SentencePieceTokenizer::encode(const QString& text, bool ad
         return {};
     }
     
+    // Normalize and preprocess
+    thread_local std::string normalized;
+    normalize(text, normalized);
+    
+    // Find best tokenization
+    const std::vector<Segment>& path = viterbi(normalized);
+    
+    size_t count = size_t(addBos) + size_t(addEos);
+    for (const Segment& segment : path) {
+        count += segment.id >= 0 || !m_byteFallback ? 1 : size_t(segment.end - segment.begin);
+    }
+    
     std::vector<int32_t> result;
+    result.reserve(count);
     
     if (addBos) {
         result.push_back(m_bosId);
     }
     
-    // Normalize and preprocess
-    QString normalized = normalize(text);
-    QString withSP = replaceSP(" " + normalized);  // Add leading space
-    
-    // Build lattice and find best tokenization
-    Lattice* lattice = buildLattice(withSP);
-    std::vector<int32_t> tokens = viterbi(lattice);
-    
-    result.insert(result.end(), tokens.begin(), tokens.end());
+    for (const Segment& segment : path) {
+        if (segment.id >= 0) {
+            result.push_back(segment.id);
+        } else if (m_byteFallback) {
+            for (int32_t i = segment.begin; i < segment.end; ++i) {
+                result.push_back(m_byteTokens[uint8_t(normalized[size_t(i)])]);
+            }
+        } else {
+            result.push_back(m_unkId);
+        }
+    }
     
     if (addEos) {
         result.push_back(m_eosId);
@@ -328,29 +431,27 @@ std::vector<int32_t> SentencePieceTokenizer::encode(const QString& text, bool ad
 QString SentencePieceTokenizer::decode(const std::vector<int32_t>& tokens, bool skipSpecial) {
     if (!isReady()) return QString();
     
-    QString result;
-    
+    // Byte pieces contribute raw bytes, so assemble UTF-8 first
+    QByteArray utf8;
     for (int32_t tokenId : tokens) {
-        if (tokenId < 0 || tokenId >= m_pieces.size()) {
+        if (!appendTokenBytes(tokenId, utf8, skipSpecial)) {
             qWarning() << "Invalid token ID:" << tokenId;
-            continue;
         }
-        
-        const SentencePiece& piece = m_pieces[tokenId];
-        
-        // Skip special tokens if requested
-        if (skipSpecial) {
-            if (tokenId == m_bosId || tokenId == m_eosId || 
-                tokenId == m_padId || tokenId == m_unkId) {
-                continue;
-            }
-        }
-        
-        result += piece.piece;
     }
     
-    // Replace ▁ with spaces
-    result = unreplaceSP(result);
+    return QString::fromUtf8(utf8).trimmed();
+}
+
+bool SentencePieceTokenizer::appendTokenBytes(int32_t tokenId, QByteArray& out, bool skipSpecial) const {
+    if (tokenId < 0 || size_t(tokenId) >= m_pieceBytes.size()) {
+        return false;
+    }
+    if (skipSpecial && (tokenId == m_bosId || tokenId == m_eosId ||
+                        tokenId == m_padId || tokenId == m_unkId)) {
+        return true;
+    }
     
-    return result.trimmed();
+    const std::string& bytes = m_pieceBytes[size_t(tokenId)];
+    out.append(bytes.data(), qsizetype(bytes.size()));
+    return true;
 }
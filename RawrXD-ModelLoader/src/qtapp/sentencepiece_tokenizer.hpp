@@ -1,8 +1,10 @@
 #pragma once
 #include <QString>
+#include <QByteArray>
 #include <QHash>
 #include <QVector>
 #include <vector>
+#include <string>
 #include <cstdint>
 
 /**
@@ -10,11 +12,15 @@
  * 
  * Implements unigram language model tokenization used by many modern LLMs
  * including LLaMA, Mistral, and others. Supports both encoding and decoding.
+ *
+ * The vocabulary is compiled once into a double-array trie over UTF-8 bytes;
+ * encode() runs Viterbi over the normalized bytes with thread-local score and
+ * backpointer arrays, so steady-state calls only allocate the returned vector.
  */
 class SentencePieceTokenizer {
 public:
     SentencePieceTokenizer();
-    ~SentencePieceTokenizer();
+    ~SentencePieceTokenizer() = default;
     
     /**
      * @brief Load SentencePiece model from file
@@ -47,6 +53,16 @@ public:
      */
     QString decode(const std::vector<int32_t>& tokens, bool skipSpecial = true);
     
+    /**
+     * @brief Append the UTF-8 bytes of one token, ▁ already turned into a space
+     * @param skipSpecial Append nothing for BOS/EOS/PAD/UNK
+     * @return false if the id is out of range
+     *
+     * Byte-fallback pieces yield single raw bytes that only form a character
+     * together with their neighbours; StreamingDetokenizer joins them.
+     */
+    bool appendTokenBytes(int32_t tokenId, QByteArray& out, bool skipSpecial = true) const;
+    
     /**
      * @brief Get vocabulary size
      */
@@ -80,31 +96,35 @@ private:
         } type;
     };
     
-    // Core tokenization algorithm
-    struct Lattice;
-    std::vector<int32_t> encodeUnigram(const QString& text);
-    Lattice* buildLattice(const QString& text);
-    std::vector<int32_t> viterbi(Lattice* lattice);
+    // One step of the best segmentation: bytes [begin, end) as piece id,
+    // or -1 for an unknown character
+    struct Segment {
+        int32_t begin;
+        int32_t end;
+        int32_t id;
+    };
     
-    // Normalization
-    QString normalize(const QString& text);
-    QString replaceSP(const QString& text);  // Replace spaces with ▁
-    QString unreplaceSP(const QString& text); // Replace ▁ with spaces
+    // Core tokenization algorithm
+    void normalize(const QString& text, std::string& out) const;  // NFKC-lite, ▁ for spaces, UTF-8
+    const std::vector<Segment>& viterbi(const std::string& text) const;
+    void finalizeVocabulary(const QByteArray& tokenTypes);
     
     // Vocabulary
     QVector<SentencePiece> m_pieces;
     QHash<QString, int32_t> m_pieceToId;
+    std::vector<std::string> m_pieceBytes;  // Decoded UTF-8 per id: ▁ as space, <0xXX> as the byte
     
-    // Trie for efficient prefix matching
-    struct TrieNode {
-        QHash<QChar, TrieNode*> children;
-        int32_t tokenId{-1};
-        ~TrieNode() { qDeleteAll(children); }
+    // Double-array trie over UTF-8 bytes: the child of unit s on byte c is
+    // t = base[s] + c when check[t] == s. Units ending a piece carry its id
+    // and score, so matching touches one contiguous array.
+    struct TrieUnit {
+        int32_t base{0};
+        int32_t check{-1};
+        int32_t value{-1};
+        float score{0.0f};
     };
-    TrieNode* m_trie{nullptr};
+    std::vector<TrieUnit> m_trie;
     void buildTrie();
-    void insertTrie(const QString& piece, int32_t id);
-    QVector<int32_t> findMatchingPieces(const QString& text, int pos);
     
     // Special tokens
     int32_t m_bosId{1};
@@ -112,7 +132,9 @@ private:
     int32_t m_unkId{0};
     int32_t m_padId{-1};
     
-    // Byte fallback for unknown characters
-    bool m_byteFallback{true};
-    QHash<uint8_t, int32_t> m_byteTokens;
+    // Unknown characters: one <0xXX> piece per byte when the vocabulary has
+    // all 256, otherwise <unk> scored below every piece
+    bool m_byteFallback{false};
+    int32_t m_byteTokens[256];
+    float m_unkScore{-10.0f};
 };
@@ -0,0 +1,81 @@
+#include "streaming_detokenizer.hpp"
+#include "bpe_tokenizer.hpp"
+#include "sentencepiece_tokenizer.hpp"
+#include <QDebug>
+
+StreamingDetokenizer::StreamingDetokenizer(const BPETokenizer& tokenizer)
+    : m_source([&tokenizer](int32_t tokenId, QByteArray& out) {
+          return tokenizer.appendTokenBytes(tokenId, out);
+      })
+{
+}
+
+StreamingDetokenizer::StreamingDetokenizer(const SentencePieceTokenizer& tokenizer)
+    : m_source([&tokenizer](int32_t tokenId, QByteArray& out) {
+          return tokenizer.appendTokenBytes(tokenId, out, true);
+      }),
+      m_stripLeadingSpace(true)
+{
+}
+
+StreamingDetokenizer::StreamingDetokenizer(ByteSource source, bool stripLeadingSpace)
+    : m_source(std::move(source)),
+      m_stripLeadingSpace(stripLeadingSpace)
+{
+}
+
+int StreamingDetokenizer::completeUtf8Prefix(const char* data, int size) {
+    // Only the last lead byte can start an unfinished sequence, and it is at
+    // most three bytes from the end
+    for (int back = 1; back <= 3 && back <= size; ++back) {
+        const uint8_t c = uint8_t(data[size - back]);
+        if ((c & 0xC0) == 0x80) continue;  // Continuation byte
+        if (c >= 0xC2 && c <= 0xF4) {
+            const int length = c >= 0xF0 ? 4 : (c >= 0xE0 ? 3 : 2);
+            if (length > back) return size - back;
+        }
+        return size;
+    }
+    return size;
+}
+
+QString StreamingDetokenizer::push(int32_t tokenId) {
+    return push(&tokenId, 1);
+}
+
+QString StreamingDetokenizer::push(const int32_t* tokens, size_t count) {
+    if (!m_source) return QString();
+    
+    for (size_t i = 0; i < count; ++i) {
+        if (!m_source(tokens[i], m_pending)) {
+            qWarning() << "StreamingDetokenizer: invalid token ID:" << tokens[i];
+        }
+    }
+    m_tokenCount += qint64(count);
+    return takeText(completeUtf8Prefix(m_pending.constData(), int(m_pending.size())));
+}
+
+QString StreamingDetokenizer::flush() {
+    return takeText(int(m_pending.size()));
+}
+
+void StreamingDetokenizer::reset() {
+    m_pending.clear();
+    m_atStart = true;
+    m_tokenCount = 0;
+}
+
+QString StreamingDetokenizer::takeText(int completeBytes) {
+    if (completeBytes <= 0) return QString();
+    
+    QString text = QString::fromUtf8(m_pending.constData(), completeBytes);
+    m_pending.remove(0, completeBytes);
+    
+    if (m_stripLeadingSpace && m_atStart) {
+        int first = 0;
+        while (first < text.size() && text[first].isSpace()) ++first;
+        text.remove(0, first);
+        m_atStart = text.isEmpty();
+    }
+    return text;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <functional>
+#include <cstdint>
+
+class BPETokenizer;
+class SentencePieceTokenizer;
+
+/**
+ * @brief Incremental token -> text decoder for one generation stream
+ *
+ * Each push() decodes only the new token and returns the characters it
+ * completes. Bytes of a UTF-8 sequence that is still open (a multi-byte
+ * character split across byte-level BPE tokens or <0xXX> fallback pieces)
+ * are held back until a later token finishes it, so concatenating every
+ * push() and the final flush() gives the same text as a full decode of
+ * the stream (SentencePiece decode() also trims trailing whitespace, which
+ * a stream cannot know about). Per-token cost does not depend on how long
+ * the stream is.
+ *
+ * The detokenizer references the tokenizer it was created from, which must
+ * outlive it. Not thread-safe; use one instance per stream.
+ */
+class StreamingDetokenizer {
+public:
+    /**
+     * @brief Appends the UTF-8 bytes of a token, false for an invalid id
+     */
+    using ByteSource = std::function<bool(int32_t tokenId, QByteArray& out)>;
+
+    StreamingDetokenizer() = default;
+    explicit StreamingDetokenizer(const BPETokenizer& tokenizer);
+
+    /**
+     * @brief SentencePiece streams drop the space that ▁ puts before the
+     * first word, like SentencePieceTokenizer::decode()
+     */
+    explicit StreamingDetokenizer(const SentencePieceTokenizer& tokenizer);
+
+    /**
+     * @param stripLeadingSpace Drop whitespace before the first visible character
+     */
+    explicit StreamingDetokenizer(ByteSource source, bool stripLeadingSpace = false);
+
+    /**
+     * @brief Decode one token
+     * @return Newly completed text, possibly empty
+     */
+    QString push(int32_t tokenId);
+
+    /**
+     * @brief Decode several tokens at once
+     */
+    QString push(const int32_t* tokens, size_t count);
+
+    /**
+     * @brief End the stream: bytes of an unfinished character become U+FFFD
+     */
+    QString flush();
+
+    /**
+     * @brief Start a new stream with the same tokenizer
+     */
+    void reset();
+
+    /**
+     * @brief True while a multi-byte character is waiting for more tokens
+     */
+    bool hasPendingBytes() const { return !m_pending.isEmpty(); }
+
+    /**
+     * @brief Tokens pushed since construction or reset()
+     */
+    qint64 tokenCount() const { return m_tokenCount; }
+
+    /**
+     * @brief Length of the longest prefix of data that does not end inside
+     * an unfinished UTF-8 sequence
+     *
+     * Invalid bytes count as complete so they are passed on (and replaced)
+     * instead of being held forever.
+     */
+    static int completeUtf8Prefix(const char* data, int size);
+
+private:
+    QString takeText(int completeBytes);
+
+    ByteSource m_source;
+    QByteArray m_pending;  // Decoded bytes not yet returned
+    bool m_stripLeadingSpace{false};
+    bool m_atStart{true};
+    qint64 m_tokenCount{0};
+};
@@ -0,0 +1,320 @@
+// streaming_failure_detector.cpp - Aho-Corasick phrase matching and rolling-hash loop detection
+#include "streaming_failure_detector.hpp"
+#include <QChar>
+#include <algorithm>
+#include <deque>
+
+namespace {
+
+constexpr int kAscii = 128;
+constexpr uint64_t kHashBase = 0x100000001B3ULL;
+
+// Lower is reported first when several failures show up in one chunk, in
+// the order AgenticFailureDetector::detectFailure() checks them
+int priority(FailureType type) {
+    switch (type) {
+        case FailureType::SafetyViolation: return 0;
+        case FailureType::Refusal:         return 1;
+        case FailureType::InfiniteLoop:    return 2;
+        case FailureType::Hallucination:   return 3;
+        default:                           return 4;
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// FailurePatternSet
+// ============================================================================
+
+char16_t FailurePatternSet::fold(char16_t c) {
+    if (c < kAscii) {
+        return (c >= 'A' && c <= 'Z') ? char16_t(c + ('a' - 'A')) : c;
+    }
+    const char32_t folded = QChar::toCaseFolded(char32_t(c));
+    return folded <= 0xFFFF ? char16_t(folded) : c;
+}
+
+void FailurePatternSet::add(const QString& pattern, FailureType type) {
+    if (pattern.isEmpty()) return;
+    m_patterns.push_back(Pattern{pattern, type});
+}
+
+int32_t FailurePatternSet::wideChild(int32_t state, char16_t c) const {
+    for (const auto& edge : m_nodes[size_t(state)].wide) {
+        if (edge.first == c) return edge.second;
+    }
+    return -1;
+}
+
+void FailurePatternSet::build() {
+    m_nodes.assign(1, Node());
+    m_ascii.assign(kAscii, -1);
+
+    // Trie of the folded patterns; -1 marks a missing ASCII edge until the
+    // table is completed below
+    for (int p = 0; p < int(m_patterns.size()); ++p) {
+        int32_t state = 0;
+        for (QChar qc : m_patterns[size_t(p)].text) {
+            const char16_t c = fold(qc.unicode());
+            int32_t next = c < kAscii ? m_ascii[size_t(state) * kAscii + c] : wideChild(state, c);
+            if (next < 0) {
+                next = int32_t(m_nodes.size());
+                m_nodes.emplace_back();
+                m_ascii.resize(m_ascii.size() + kAscii, -1);
+                if (c < kAscii) {
+                    m_ascii[size_t(state) * kAscii + c] = next;
+                } else {
+                    m_nodes[size_t(state)].wide.emplace_back(c, next);
+                }
+            }
+            state = next;
+        }
+        // Duplicates keep the first pattern
+        if (m_nodes[size_t(state)].output < 0) {
+            m_nodes[size_t(state)].output = p;
+        }
+    }
+
+    // Breadth-first: a node's failure state is shallower, so its row is
+    // complete by the time the node is processed
+    std::deque<int32_t> queue;
+    for (int c = 0; c < kAscii; ++c) {
+        int32_t& next = m_ascii[size_t(c)];
+        if (next < 0) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    for (const auto& edge : m_nodes[0].wide) {
+        queue.push_back(edge.second);
+    }
+
+    while (!queue.empty()) {
+        const int32_t state = queue.front();
+        queue.pop_front();
+        const int32_t fail = m_nodes[size_t(state)].fail;
+
+        for (int c = 0; c < kAscii; ++c) {
+            int32_t& next = m_ascii[size_t(state) * kAscii + c];
+            const int32_t viaFail = m_ascii[size_t(fail) * kAscii + c];
+            if (next < 0) {
+                next = viaFail;
+            } else {
+                m_nodes[size_t(next)].fail = viaFail;
+                queue.push_back(next);
+            }
+        }
+        for (const auto& edge : m_nodes[size_t(state)].wide) {
+            int32_t f = fail;
+            int32_t target = wideChild(f, edge.first);
+            while (target < 0 && f != 0) {
+                f = m_nodes[size_t(f)].fail;
+                target = wideChild(f, edge.first);
+            }
+            m_nodes[size_t(edge.second)].fail = target < 0 ? 0 : target;
+            queue.push_back(edge.second);
+        }
+
+        const Node& failNode = m_nodes[size_t(m_nodes[size_t(state)].fail)];
+        m_nodes[size_t(state)].dictLink = failNode.output >= 0 ? m_nodes[size_t(state)].fail : failNode.dictLink;
+    }
+}
+
+int32_t FailurePatternSet::step(int32_t state, char16_t c) const {
+    c = fold(c);
+    if (c < kAscii) {
+        return m_ascii[size_t(state) * kAscii + c];
+    }
+    for (;;) {
+        const int32_t next = wideChild(state, c);
+        if (next >= 0) return next;
+        if (state == 0) return 0;
+        state = m_nodes[size_t(state)].fail;
+    }
+}
+
+// ============================================================================
+// StreamingFailureDetector
+// ============================================================================
+
+void StreamingFailureDetector::NGramCounter::configure(int gram, int windowSize) {
+    n = std::max(1, gram);
+    window = std::max(1, windowSize);
+    power = 1;
+    for (int i = 1; i < n; ++i) power *= kHashBase;
+    clear();
+}
+
+void StreamingFailureDetector::NGramCounter::clear() {
+    recent.assign(size_t(n), 0);
+    grams.assign(size_t(window), 0);
+    counts.clear();
+    hash = 0;
+    seen = 0;
+}
+
+int StreamingFailureDetector::NGramCounter::push(uint32_t symbol) {
+    // Hash of the last n symbols: drop the oldest term, shift, add the new one
+    const size_t slot = size_t(seen % n);
+    const uint64_t value = uint64_t(symbol) + 1;
+    if (seen >= n) {
+        hash -= (uint64_t(recent[slot]) + 1) * power;
+    }
+    hash = hash * kHashBase + value;
+    recent[slot] = symbol;
+    ++seen;
+    if (seen < n) return 0;
+
+    // Count the n-gram within the sliding window of recent n-grams
+    const qint64 gramIndex = seen - n;
+    uint64_t& evicted = grams[size_t(gramIndex % window)];
+    if (gramIndex >= window) {
+        auto it = counts.find(evicted);
+        if (it != counts.end() && --it->second == 0) counts.erase(it);
+    }
+    evicted = hash;
+    return ++counts[hash];
+}
+
+StreamingFailureDetector::StreamingFailureDetector() {
+    m_options.refusal = m_options.hallucination = m_options.safety = m_options.loops = false;
+}
+
+StreamingFailureDetector::StreamingFailureDetector(std::shared_ptr<const FailurePatternSet> patterns,
+                                                   const Options& options, FailureCallback onFailure)
+    : m_patterns(std::move(patterns)),
+      m_options(options),
+      m_onFailure(std::move(onFailure))
+{
+    if (m_options.loops) {
+        m_tokenGrams.configure(m_options.tokenGram, m_options.window);
+        m_charGrams.configure(m_options.charGram, m_options.window);
+    }
+}
+
+StreamingFailureDetector StreamingFailureDetector::loopMonitor(int maxTokens) {
+    Options options;
+    options.refusal = options.hallucination = options.safety = false;
+    // Below a handful of tokens, ordinary repeated phrases would count as loops
+    options.tokenGram = std::clamp(maxTokens / (options.repeatThreshold + 1), 4, options.tokenGram);
+    return StreamingFailureDetector(nullptr, options);
+}
+
+void StreamingFailureDetector::reset() {
+    m_state = 0;
+    m_failure = FailureDetection::none();
+    m_tokensSeen = 0;
+    m_charsSeen = 0;
+    if (m_options.loops) {
+        m_tokenGrams.clear();
+        m_charGrams.clear();
+    }
+}
+
+bool StreamingFailureDetector::enabled(FailureType type) const {
+    switch (type) {
+        case FailureType::Refusal:         return m_options.refusal;
+        case FailureType::Hallucination:   return m_options.hallucination;
+        case FailureType::SafetyViolation: return m_options.safety;
+        case FailureType::InfiniteLoop:    return m_options.loops;
+        default:                           return false;
+    }
+}
+
+FailureDetection StreamingFailureDetector::feedToken(int32_t tokenId, const QString& text) {
+    if (m_failure.isFailure()) return m_failure;
+
+    FailureDetection found = scanText(text);
+    ++m_tokensSeen;
+    if (m_options.loops) {
+        const int count = m_tokenGrams.push(uint32_t(tokenId));
+        if (count >= m_options.repeatThreshold &&
+            (!found.isFailure() || priority(FailureType::InfiniteLoop) < priority(found.type))) {
+            found = loopDetection(count, m_tokensSeen);
+        }
+    }
+    return found.isFailure() ? report(found) : found;
+}
+
+FailureDetection StreamingFailureDetector::feedText(const QString& text) {
+    if (m_failure.isFailure()) return m_failure;
+
+    const qint64 start = m_charsSeen;
+    FailureDetection found = scanText(text);
+    if (m_options.loops) {
+        for (qsizetype i = 0; i < text.size(); ++i) {
+            const int count = m_charGrams.push(text[i].unicode());
+            if (count >= m_options.repeatThreshold &&
+                (!found.isFailure() || priority(FailureType::InfiniteLoop) < priority(found.type))) {
+                found = loopDetection(count, start + i + 1);
+                break;
+            }
+        }
+    }
+    return found.isFailure() ? report(found) : found;
+}
+
+FailureDetection StreamingFailureDetector::scanText(const QString& text) {
+    FailureDetection best = FailureDetection::none();
+    if (!m_patterns || m_patterns->isEmpty()) {
+        m_charsSeen += text.size();
+        return best;
+    }
+
+    const FailurePatternSet& patterns = *m_patterns;
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        m_state = patterns.step(m_state, text[i].unicode());
+        ++m_charsSeen;
+
+        int32_t node = patterns.output(m_state) >= 0 ? m_state : patterns.nextMatch(m_state);
+        for (; node >= 0; node = patterns.nextMatch(node)) {
+            const FailurePatternSet::Pattern& pattern = patterns.pattern(patterns.output(node));
+            if (!enabled(pattern.type)) continue;
+            if (best.isFailure() && priority(pattern.type) >= priority(best.type)) continue;
+
+            FailureDetection detection;
+            switch (pattern.type) {
+                case FailureType::Refusal: {
+                    // Same scoring as calculateConfidence(): refusals in short replies are surer
+                    const double confidence = m_charsSeen < 100 ? 0.9 : 0.7;
+                    if (confidence < m_options.refusalThreshold) continue;
+                    detection = FailureDetection::detected(FailureType::Refusal, confidence,
+                        "Model refused to answer using pattern: " + pattern.text, pattern.text);
+                    break;
+                }
+                case FailureType::Hallucination:
+                    detection = FailureDetection::detected(FailureType::Hallucination, 0.8,
+                        "Model may be hallucinating: " + pattern.text, pattern.text);
+                    break;
+                case FailureType::SafetyViolation:
+                    detection = FailureDetection::detected(FailureType::SafetyViolation, 0.95,
+                        "Potential safety violation: " + pattern.text, pattern.text);
+                    break;
+                default:
+                    continue;
+            }
+            detection.position = int(m_charsSeen);
+            best = detection;
+        }
+    }
+    return best;
+}
+
+FailureDetection StreamingFailureDetector::loopDetection(int count, qint64 position) const {
+    FailureDetection detection = FailureDetection::detected(
+        FailureType::InfiniteLoop,
+        std::min(1.0, count / 5.0),
+        QString("Model is repeating itself (%1 times)").arg(count));
+    detection.position = int(position);
+    return detection;
+}
+
+FailureDetection StreamingFailureDetector::report(const FailureDetection& detection) {
+    m_failure = detection;
+    if (m_onFailure) {
+        m_onFailure(detection);
+    }
+    return detection;
+}
@@ -0,0 +1,198 @@
+// streaming_failure_detector.hpp - Token-by-token failure checks that can stop generation early
+#pragma once
+
+#include <QString>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Types of failures the detector can identify
+enum class FailureType {
+    None,
+    Refusal,              // Model refuses to answer
+    Hallucination,        // Model generates false information
+    FormatViolation,      // Output doesn't match expected format
+    InfiniteLoop,         // Model repeats itself endlessly
+    QualityDegradation,   // Response quality drops below threshold
+    ToolMisuse,           // Incorrect tool/function calling
+    ContextLoss,          // Model loses track of conversation context
+    SafetyViolation       // Unsafe or harmful content
+};
+
+// Failure detection result
+struct FailureDetection {
+    FailureType type = FailureType::None;
+    double confidence = 0.0;      // 0.0 to 1.0
+    QString description;
+    QString detectedPattern;
+    int position = -1;
+
+    bool isFailure() const { return type != FailureType::None; }
+
+    static FailureDetection none() {
+        return FailureDetection{FailureType::None, 0.0, "", "", -1};
+    }
+
+    static FailureDetection detected(FailureType t, double conf, const QString& desc, const QString& pattern = "") {
+        return FailureDetection{t, conf, desc, pattern, 0};
+    }
+};
+
+/**
+ * @brief Case-insensitive Aho-Corasick automaton over many phrase patterns
+ *
+ * All refusal, hallucination and safety phrases are matched in one pass,
+ * one transition per character, however many patterns there are. ASCII
+ * transitions are a dense table; other characters follow failure links.
+ * Immutable after build(), so streams share one instance.
+ */
+class FailurePatternSet {
+public:
+    struct Pattern {
+        QString text;
+        FailureType type;
+    };
+
+    void add(const QString& pattern, FailureType type);
+    void build();
+
+    bool isEmpty() const { return m_patterns.empty(); }
+    int patternCount() const { return int(m_patterns.size()); }
+    const Pattern& pattern(int index) const { return m_patterns[size_t(index)]; }
+
+    /**
+     * @brief Next state after consuming one UTF-16 code unit
+     */
+    int32_t step(int32_t state, char16_t c) const;
+
+    /**
+     * @brief Pattern ending at this state, -1 if none
+     */
+    int32_t output(int32_t state) const { return m_nodes[size_t(state)].output; }
+
+    /**
+     * @brief Next state on the failure chain that ends a pattern, -1 if none
+     */
+    int32_t nextMatch(int32_t state) const { return m_nodes[size_t(state)].dictLink; }
+
+    static char16_t fold(char16_t c);
+
+private:
+    struct Node {
+        int32_t fail{0};
+        int32_t output{-1};
+        int32_t dictLink{-1};
+        std::vector<std::pair<char16_t, int32_t>> wide;  // Non-ASCII edges
+    };
+
+    int32_t wideChild(int32_t state, char16_t c) const;
+
+    std::vector<Pattern> m_patterns;
+    std::vector<Node> m_nodes;
+    std::vector<int32_t> m_ascii;  // nodes x 128 complete transition table
+};
+
+/**
+ * @brief Incremental failure check for one generation
+ *
+ * Fed each token (and the text it completed) as it is produced, so a
+ * refusal, unsafe phrase or repetition loop is caught within a few tokens
+ * of appearing instead of after maxTokens. Phrases use a shared
+ * FailurePatternSet and survive chunk boundaries; loops are found with a
+ * rolling hash over the last n token ids (or characters, for text-only
+ * streams): an n-gram seen repeatThreshold times within the window means
+ * the output has started cycling. Each call costs O(new text + 1).
+ *
+ * The first failure is sticky. Not thread-safe; use one per stream.
+ */
+class StreamingFailureDetector {
+public:
+    struct Options {
+        bool refusal = true;
+        bool hallucination = true;
+        bool safety = true;
+        bool loops = true;
+        double refusalThreshold = 0.7;
+        int repeatThreshold = 4;   // Occurrences of one n-gram that make a loop
+        int tokenGram = 32;        // n for token-id loops; boilerplate code repeats shorter runs
+        int charGram = 64;         // n for character loops in feedText()
+        int window = 2048;         // Recent n-grams counted
+    };
+
+    using FailureCallback = std::function<void(const FailureDetection&)>;
+
+    /**
+     * @brief A detector that never reports (no patterns, loops off)
+     */
+    StreamingFailureDetector();
+
+    StreamingFailureDetector(std::shared_ptr<const FailurePatternSet> patterns, const Options& options,
+                             FailureCallback onFailure = nullptr);
+
+    /**
+     * @brief Loops-only detector for a generation of at most @p maxTokens tokens
+     *
+     * A loop of period p is seen after tokenGram + (repeatThreshold - 1) * p
+     * tokens, so tokenGram is capped at maxTokens / (repeatThreshold + 1)
+     * to leave short generations room for loops longer than a few tokens.
+     */
+    static StreamingFailureDetector loopMonitor(int maxTokens);
+
+    /**
+     * @brief Check one generated token and the text it completed
+     */
+    FailureDetection feedToken(int32_t tokenId, const QString& text = QString());
+
+    /**
+     * @brief Check a text chunk when token ids are not available
+     */
+    FailureDetection feedText(const QString& text);
+
+    /**
+     * @brief True once a failure has been seen; generation should stop
+     */
+    bool shouldStop() const { return m_failure.isFailure(); }
+    const FailureDetection& failure() const { return m_failure; }
+
+    qint64 tokensSeen() const { return m_tokensSeen; }
+    qint64 charsSeen() const { return m_charsSeen; }
+
+    /**
+     * @brief Start over for a new generation with the same configuration
+     */
+    void reset();
+
+private:
+    // Occurrences of each recent n-gram, keyed by a polynomial rolling hash
+    struct NGramCounter {
+        int n{0};
+        int window{0};
+        std::vector<uint32_t> recent;   // Ring of the last n symbols
+        std::vector<uint64_t> grams;    // Ring of the last `window` n-gram hashes
+        std::unordered_map<uint64_t, int> counts;
+        uint64_t hash{0};
+        uint64_t power{1};              // B^(n-1)
+        qint64 seen{0};
+
+        void configure(int gram, int windowSize);
+        void clear();
+        int push(uint32_t symbol);      // Count of the n-gram ending here, 0 before n symbols
+    };
+
+    FailureDetection scanText(const QString& text);
+    FailureDetection loopDetection(int count, qint64 position) const;
+    FailureDetection report(const FailureDetection& detection);
+    bool enabled(FailureType type) const;
+
+    std::shared_ptr<const FailurePatternSet> m_patterns;
+    Options m_options;
+    FailureCallback m_onFailure;
+    int32_t m_state{0};
+    NGramCounter m_tokenGrams;
+    NGramCounter m_charGrams;
+    FailureDetection m_failure;
+    qint64 m_tokensSeen{0};
+    qint64 m_charsSeen{0};
+};
@@ -52,6 +52,14 @@ bool StreamingInferenceAPI::isStreamActive(qint64 streamId) const {
     return m_activeStreams.contains(streamId) && m_activeStreams[streamId].active;
 }
 
+void StreamingInferenceAPI::setDetokenizer(qint64 streamId, const StreamingDetokenizer& detokenizer) {
+    if (!m_activeStreams.contains(streamId)) {
+        qWarning() << "[StreamingAPI] Stream not found:" << streamId;
+        return;
+    }
+    m_activeStreams[streamId].detokenizer = detokenizer;
+}
+
 void StreamingInferenceAPI::setTokenCallback(TokenCallback callback) {
     m_tokenCallback = callback;
 }
@@ -89,6 +97,19 @@ void StreamingInferenceAPI::onTokenReady(qint64 streamId, const QString& token)
     onStreamProgress(streamId, state.tokensGenerated, state.maxTokens);
 }
 
+void StreamingInferenceAPI::onTokenIdReady(qint64 streamId, qint32 tokenId) {
+    if (!m_activeStreams.contains(streamId)) return;
+    
+    StreamState& state = m_activeStreams[streamId];
+    if (!state.active) return;
+    
+    // A token ending inside a multi-byte character yields no text yet
+    const QString text = state.detokenizer.push(tokenId);
+    if (!text.isEmpty()) {
+        onTokenReady(streamId, text);
+    }
+}
+
 void StreamingInferenceAPI::onStreamProgress(qint64 streamId, int current, int total) {
     if (!m_activeStreams.contains(streamId)) return;
     
@@ -102,6 +123,12 @@ void StreamingInferenceAPI::onStreamProgress(qint64 streamId, int current, int t
 void StreamingInferenceAPI::onStreamComplete(qint64 streamId, const QString& result) {
     if (!m_activeStreams.contains(streamId)) return;
     
+    // Bytes of a character the last token left unfinished
+    const QString tail = m_activeStreams[streamId].detokenizer.flush();
+    if (!tail.isEmpty()) {
+        onTokenReady(streamId, tail);
+    }
+    
     StreamState& state = m_activeStreams[streamId];
     state.active = false;
     
@@ -5,6 +5,7 @@
 #include <QByteArray>
 #include <QHash>
 #include <functional>
+#include "streaming_detokenizer.hpp"
 
 /**
  * @brief Streaming inference API with token-by-token callbacks
@@ -49,6 +50,14 @@ public:
      */
     bool isStreamActive(qint64 streamId) const;
 
+    /**
+     * @brief Decode token ids fed to onTokenIdReady() for this stream
+     *
+     * Typically InferenceEngine::createDetokenizer(); each id then costs the
+     * same however long the stream has run.
+     */
+    void setDetokenizer(qint64 streamId, const StreamingDetokenizer& detokenizer);
+
     /**
      * @brief Set token callback (called for each generated token)
      */
@@ -78,6 +87,7 @@ signals:
 
 public slots:
     void onTokenReady(qint64 streamId, const QString& token);
+    void onTokenIdReady(qint64 streamId, qint32 tokenId);
     void onStreamProgress(qint64 streamId, int current, int total);
     void onStreamComplete(qint64 streamId, const QString& result);
     void onStreamError(qint64 streamId, const QString& error);
@@ -91,6 +101,7 @@ private:
         int tokensGenerated = 0;
         int maxTokens;
         bool active = true;
+        StreamingDetokenizer detokenizer;
     };
 
     QHash<qint64, StreamState> m_activeStreams;
@@ -1,21 +1,152 @@
 #include "transformer_inference.hpp"
 #include <ggml.h>
+#include <ggml-alloc.h>
 #include <ggml-backend.h>
 #include <ggml-cpu.h>
+#include "flash_attention.h"
 #include <QDebug>
 #include <cstring>
 #include <cmath>
 #include <random>
 #include <algorithm>
+#include <thread>
+
+namespace {
+// Node budget for one forward graph (~40 nodes per layer plus K/V writes)
+constexpr size_t kGraphSize = 8192;
+
+// Attention spans the KV cache rounded up to this many positions, so the
+// decode graph keeps the same shape for kKVBucket consecutive tokens
+constexpr int kKVBucket = 256;
+
+// Token positions per KV pool block
+constexpr uint32_t kKVBlockSize = 16;
+
+// Kernel parameters for the attention ops below: src0 is roped Q
+// [head_dim, n_head, n_tokens], src1/src2 the gathered K/V rows [n_embd, n_kv]
+flash_attn_params flashParams(const ggml_tensor* dst) {
+    const ggml_tensor* q = dst->src[0];
+    const ggml_tensor* k = dst->src[1];
+    
+    flash_attn_params p = {};
+    p.q = (const float*)q->data;
+    p.k = (const float*)k->data;
+    p.v = (const float*)dst->src[2]->data;
+    p.o = (float*)dst->data;
+    p.n_q = (int)q->ne[2];
+    p.n_kv = (int)k->ne[1];
+    p.n_head = (int)q->ne[1];
+    p.n_kv_head = (int)(k->ne[0] / q->ne[0]);
+    p.head_dim = (int)q->ne[0];
+    p.q_token_stride = (ptrdiff_t)(q->nb[2] / sizeof(float));
+    p.q_head_stride = (ptrdiff_t)(q->nb[1] / sizeof(float));
+    p.kv_token_stride = (ptrdiff_t)(k->nb[1] / sizeof(float));
+    p.kv_head_stride = p.head_dim;
+    p.o_token_stride = (ptrdiff_t)(dst->nb[2] / sizeof(float));
+    p.o_head_stride = (ptrdiff_t)(dst->nb[1] / sizeof(float));
+    p.scale = 1.0f / sqrtf((float)p.head_dim);
+    p.causal = 1;
+    return p;
+}
+
+// ggml custom op: dst[head_dim, n_head, n_tokens] = causal attention of Q
+// over the gathered K/V with query positions from src3. Slots past a
+// query's position are never read, so bucket padding needs no mask.
+void flashAttentionOp(ggml_tensor* dst, int ith, int nth, void* /*userdata*/) {
+    flash_attn_params p = flashParams(dst);
+    p.q_pos = (const int32_t*)dst->src[3]->data;
+    
+    // Items come longest first, so dealing them round-robin gives every
+    // ggml thread a similar share of the causal triangle
+    const int items = flash_attn_work_items(&p);
+    for (int item = ith; item < items; item += nth) {
+        flash_attn_run(&p, item, item + 1);
+    }
+}
+
+// Batched decode variant: row t is one sequence's next token and attends
+// only to its own segment of the gathered K/V, rows src4[t]..src4[t] +
+// src3[t]. A step costs the sum of the sequence lengths instead of every
+// row scanning every sequence behind a block-diagonal mask.
+void segmentedAttentionOp(ggml_tensor* dst, int ith, int nth, void* /*userdata*/) {
+    const flash_attn_params whole = flashParams(dst);
+    const int32_t* pos = (const int32_t*)dst->src[3]->data;
+    const int32_t* starts = (const int32_t*)dst->src[4]->data;
+    
+    int item = 0;
+    for (int t = 0; t < whole.n_q; ++t) {
+        flash_attn_params p = whole;
+        p.q = whole.q + t * whole.q_token_stride;
+        p.o = whole.o + t * whole.o_token_stride;
+        p.k = whole.k + starts[t] * whole.kv_token_stride;
+        p.v = whole.v + starts[t] * whole.kv_token_stride;
+        p.n_q = 1;
+        p.n_kv = pos[t] + 1;
+        p.q_pos = nullptr;  // The query is the segment's last position
+        
+        const int items = flash_attn_work_items(&p);
+        for (int i = 0; i < items; ++i, ++item) {
+            if (item % nth == ith) {
+                flash_attn_run(&p, i, i + 1);
+            }
+        }
+    }
+}
+}
 
 TransformerInference::TransformerInference() {
+    m_nThreads = std::max(1u, std::thread::hardware_concurrency());
 }
 
 TransformerInference::~TransformerInference() {
     freeContext();
 }
 
+void TransformerInference::setThreadCount(int nThreads) {
+    m_nThreads = nThreads > 0 ? nThreads : (int)std::max(1u, std::thread::hardware_concurrency());
+    if (m_backend) {
+        ggml_backend_cpu_set_n_threads(m_backend, m_nThreads);
+    }
+}
+
+void TransformerInference::setFlashAttention(bool enabled) {
+    if (enabled == m_flashAttention) {
+        return;
+    }
+    m_flashAttention = enabled;
+    // The attention path is part of the graph topology
+    releaseGraph(m_decodeGraph);
+    releaseGraph(m_prefillGraph);
+}
+
+void TransformerInference::releaseGraph(GraphCache& graph) {
+    if (graph.ctx) {
+        ggml_free(graph.ctx);
+    }
+    if (graph.alloc) {
+        ggml_gallocr_free(graph.alloc);
+    }
+    std::vector<uint8_t> metaBuffer = std::move(graph.metaBuffer);
+    graph = GraphCache{};
+    graph.metaBuffer = std::move(metaBuffer);
+}
+
 void TransformerInference::freeContext() {
+    releaseGraph(m_decodeGraph);
+    releaseGraph(m_prefillGraph);
+    releaseGraph(m_batchGraph);
+    if (m_kvBuffer) {
+        ggml_backend_buffer_free(m_kvBuffer);
+        m_kvBuffer = nullptr;
+    }
+    if (m_mapBuffer) {
+        ggml_backend_buffer_free(m_mapBuffer);  // Does not unmap; the loader owns the mapping
+        m_mapBuffer = nullptr;
+    }
+    if (m_backend) {
+        ggml_backend_free(m_backend);
+        m_backend = nullptr;
+    }
     if (m_ctx) {
         ggml_free(m_ctx);
         m_ctx = nullptr;
@@ -24,50 +155,50 @@ void TransformerInference::freeContext() {
         ggml_free(m_kvCtx);
         m_kvCtx = nullptr;
     }
+    m_kCache.clear();
+    m_vCache.clear();
+    m_prefixCache.Clear();
+    m_kv.Release();
     m_ready = false;
 }
 
 bool TransformerInference::loadWeights(const QHash<QString, QByteArray>& tensorCache,
                                        int nLayers, int nEmbd, int nHead, int nVocab) {
+    return loadWeights(tensorCache, QHash<QString, TensorLayout>(), nLayers, nEmbd, nHead, nVocab);
+}
+
+bool TransformerInference::loadWeights(const QHash<QString, QByteArray>& tensorCache,
+                                       const QHash<QString, TensorLayout>& layouts,
+                                       int nLayers, int nEmbd, int nHead, int nVocab) {
     qInfo() << "Loading transformer weights: layers=" << nLayers 
             << "embd=" << nEmbd << "heads=" << nHead << "vocab=" << nVocab;
     
+    // Weights may be reloaded (quant mode change); drop the previous contexts
+    freeContext();
+    
     m_nLayers = nLayers;
     m_nEmbd = nEmbd;
     m_nHead = nHead;
     m_nVocab = nVocab;
+    m_tokenEmbed = nullptr;
+    m_outputWeight = nullptr;
+    m_layers.assign(m_nLayers, LayerWeights{});
     
-    // Allocate ggml context for model weights
-    size_t ctxSize = 1024ull * 1024 * 1024;  // 1GB for weights
-    struct ggml_init_params params = {
-        .mem_size = ctxSize,
-        .mem_buffer = nullptr,
-        .no_alloc = false,
-    };
-    
-    m_ctx = ggml_init(params);
-    if (!m_ctx) {
-        qCritical() << "Failed to initialize ggml context";
-        return false;
-    }
+    // Resolve every weight (name, native type, target type, shape) first so
+    // the context can be sized from the real tensor table
+    std::vector<WeightPlan> plan;
     
-    // Load token embedding: [vocab_size, n_embd]
-    int64_t embdShape[] = {m_nVocab, m_nEmbd};
-    m_tokenEmbed = createTensorFromCache("token_embd.weight", tensorCache, embdShape, 2);
-    if (!m_tokenEmbed) {
-        // Try alternative name
-        m_tokenEmbed = createTensorFromCache("model.embed_tokens.weight", tensorCache, embdShape, 2);
-    }
+    // Token embedding: n_vocab rows of n_embd (ggml ne0 = n_embd)
+    int64_t embdShape[] = {m_nEmbd, m_nVocab};
+    planWeight(plan, &m_tokenEmbed, "token_embd.weight", "model.embed_tokens.weight",
+               tensorCache, layouts, embdShape, 2);
     
-    // Load output projection: [n_embd, vocab_size]
+    // Output projection: [n_embd, vocab_size]
     int64_t outShape[] = {m_nEmbd, m_nVocab};
-    m_outputWeight = createTensorFromCache("output.weight", tensorCache, outShape, 2);
-    if (!m_outputWeight) {
-        m_outputWeight = createTensorFromCache("lm_head.weight", tensorCache, outShape, 2);
-    }
+    planWeight(plan, &m_outputWeight, "output.weight", "lm_head.weight",
+               tensorCache, layouts, outShape, 2);
     
-    // Load per-layer weights
-    m_layers.resize(m_nLayers);
+    // Per-layer weights
     for (int i = 0; i < m_nLayers; ++i) {
         QString prefix = QString("blk.%1.").arg(i);
         QString altPrefix = QString("model.layers.%1.").arg(i);
@@ -79,106 +210,341 @@ bool TransformerInference::loadWeights(const QHash<QString, QByteArray>& tensorC
         int64_t lnShape[] = {m_nEmbd};
         
         // Attention weights
-        layer.attn_q = createTensorFromCache(prefix + "attn_q.weight", tensorCache, qkvShape, 2);
-        if (!layer.attn_q) layer.attn_q = createTensorFromCache(altPrefix + "self_attn.q_proj.weight", tensorCache, qkvShape, 2);
-        
-        layer.attn_k = createTensorFromCache(prefix + "attn_k.weight", tensorCache, qkvShape, 2);
-        if (!layer.attn_k) layer.attn_k = createTensorFromCache(altPrefix + "self_attn.k_proj.weight", tensorCache, qkvShape, 2);
-        
-        layer.attn_v = createTensorFromCache(prefix + "attn_v.weight", tensorCache, qkvShape, 2);
-        if (!layer.attn_v) layer.attn_v = createTensorFromCache(altPrefix + "self_attn.v_proj.weight", tensorCache, qkvShape, 2);
-        
-        layer.attn_proj = createTensorFromCache(prefix + "attn_output.weight", tensorCache, qkvShape, 2);
-        if (!layer.attn_proj) layer.attn_proj = createTensorFromCache(altPrefix + "self_attn.o_proj.weight", tensorCache, qkvShape, 2);
+        planWeight(plan, &layer.attn_q, prefix + "attn_q.weight", altPrefix + "self_attn.q_proj.weight",
+                   tensorCache, layouts, qkvShape, 2);
+        planWeight(plan, &layer.attn_k, prefix + "attn_k.weight", altPrefix + "self_attn.k_proj.weight",
+                   tensorCache, layouts, qkvShape, 2);
+        planWeight(plan, &layer.attn_v, prefix + "attn_v.weight", altPrefix + "self_attn.v_proj.weight",
+                   tensorCache, layouts, qkvShape, 2);
+        planWeight(plan, &layer.attn_proj, prefix + "attn_output.weight", altPrefix + "self_attn.o_proj.weight",
+                   tensorCache, layouts, qkvShape, 2);
         
         // Layer norm
-        layer.ln1_weight = createTensorFromCache(prefix + "attn_norm.weight", tensorCache, lnShape, 1);
-        if (!layer.ln1_weight) layer.ln1_weight = createTensorFromCache(altPrefix + "input_layernorm.weight", tensorCache, lnShape, 1);
+        planWeight(plan, &layer.ln1_weight, prefix + "attn_norm.weight", altPrefix + "input_layernorm.weight",
+                   tensorCache, layouts, lnShape, 1);
         
         // MLP
-        layer.mlp_fc1 = createTensorFromCache(prefix + "ffn_up.weight", tensorCache, mlpShape, 2);
-        if (!layer.mlp_fc1) layer.mlp_fc1 = createTensorFromCache(altPrefix + "mlp.up_proj.weight", tensorCache, mlpShape, 2);
-        
-        layer.mlp_fc2 = createTensorFromCache(prefix + "ffn_down.weight", tensorCache, mlp2Shape, 2);
-        if (!layer.mlp_fc2) layer.mlp_fc2 = createTensorFromCache(altPrefix + "mlp.down_proj.weight", tensorCache, mlp2Shape, 2);
-        
-        layer.ln2_weight = createTensorFromCache(prefix + "ffn_norm.weight", tensorCache, lnShape, 1);
-        if (!layer.ln2_weight) layer.ln2_weight = createTensorFromCache(altPrefix + "post_attention_layernorm.weight", tensorCache, lnShape, 1);
+        planWeight(plan, &layer.mlp_fc1, prefix + "ffn_up.weight", altPrefix + "mlp.up_proj.weight",
+                   tensorCache, layouts, mlpShape, 2);
+        planWeight(plan, &layer.mlp_fc2, prefix + "ffn_down.weight", altPrefix + "mlp.down_proj.weight",
+                   tensorCache, layouts, mlp2Shape, 2);
+        planWeight(plan, &layer.ln2_weight, prefix + "ffn_norm.weight", altPrefix + "post_attention_layernorm.weight",
+                   tensorCache, layouts, lnShape, 1);
     }
     
+    // Allocate ggml context for model weights, sized to the planned tensors;
+    // tensors aliasing the file mapping only need their metadata here
+    size_t ctxSize = ggml_tensor_overhead() * (plan.size() + 1);
+    bool anyMapped = false;
+    for (const WeightPlan& w : plan) {
+        if (w.mappedData) {
+            anyMapped = true;
+            continue;
+        }
+        const size_t bytes = ggml_row_size((ggml_type)w.dstType, w.ne[0]) * (size_t)w.ne[1];
+        ctxSize += GGML_PAD(bytes, GGML_MEM_ALIGN);
+    }
+    struct ggml_init_params params = {
+        .mem_size = ctxSize,
+        .mem_buffer = nullptr,
+        .no_alloc = false,
+    };
+    
+    m_ctx = ggml_init(params);
+    if (!m_ctx) {
+        qCritical() << "Failed to initialize ggml context";
+        return false;
+    }
+    
+    if (anyMapped) {
+        // Weights are only read, so the read-only mapping can back a CPU buffer
+        m_mapBuffer = ggml_backend_cpu_buffer_from_ptr(const_cast<void*>(m_mapBase), m_mapSize);
+        if (!m_mapBuffer) {
+            qCritical() << "Failed to wrap model file mapping";
+            freeContext();
+            return false;
+        }
+        ggml_backend_buffer_set_usage(m_mapBuffer, GGML_BACKEND_BUFFER_USAGE_WEIGHTS);
+    }
+    
+    m_weightBytes = 0;
+    m_mappedWeightBytes = 0;
+    for (const WeightPlan& w : plan) {
+        *w.slot = createTensorFromCache(w, tensorCache);
+        if (*w.slot) {
+            m_weightBytes += ggml_nbytes(*w.slot);
+            if (w.mappedData) m_mappedWeightBytes += ggml_nbytes(*w.slot);
+        }
+    }
+    qInfo() << "Weight tensors:" << plan.size() << "bytes:" << m_weightBytes
+            << "mapped:" << m_mappedWeightBytes;
+    
+    // One CPU backend (and its thread pool) serves every forward pass
+    m_backend = ggml_backend_cpu_init();
+    if (!m_backend) {
+        qCritical() << "Failed to initialize GGML CPU backend";
+        freeContext();
+        return false;
+    }
+    ggml_backend_cpu_set_n_threads(m_backend, m_nThreads);
+    
     // Initialize KV cache
-    initKVCache();
+    if (!initKVCache()) {
+        freeContext();
+        return false;
+    }
     
     m_ready = true;
     qInfo() << "Transformer weights loaded successfully";
     return true;
 }
 
-void TransformerInference::initKVCache() {
-    // Allocate separate context for KV cache
-    size_t kvSize = 512ull * 1024 * 1024;  // 512MB for KV cache
+int TransformerInference::weightTypeFromName(const QString& name) {
+    for (int t = 0; t < GGML_TYPE_COUNT; ++t) {
+        if (ggml_get_type_traits((ggml_type)t)->blck_size == 0) continue;  // removed type ids
+        const char* typeName = ggml_type_name((ggml_type)t);
+        if (typeName && name.compare(QString::fromLatin1(typeName), Qt::CaseInsensitive) == 0) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+void TransformerInference::planWeight(std::vector<WeightPlan>& plan, ggml_tensor** slot,
+                                      const QString& name, const QString& altName,
+                                      const QHash<QString, QByteArray>& cache,
+                                      const QHash<QString, TensorLayout>& layouts,
+                                      const int64_t* shape, int nDims) {
+    WeightPlan w;
+    w.slot = slot;
+    w.name = cache.contains(name) ? name : altName;
+    if (!cache.contains(w.name)) {
+        qWarning() << "Tensor not found in cache:" << name;
+        return;
+    }
+    
+    // The file's layout wins over the shape implied by the hyperparameters
+    // (e.g. FFN width is rarely exactly 4 * n_embd)
+    w.nDims = nDims;
+    w.ne[0] = shape[0];
+    w.ne[1] = nDims == 2 ? shape[1] : 1;
+    w.srcType = GGML_TYPE_F32;
+    auto it = layouts.constFind(w.name);
+    if (it != layouts.constEnd() && !it->ne.empty()) {
+        if ((int)it->ne.size() != nDims) {
+            qWarning() << "Unsupported tensor dims:" << w.name << it->ne.size();
+            return;
+        }
+        w.srcType = it->type;
+        w.ne[0] = it->ne[0];
+        w.ne[1] = nDims == 2 ? it->ne[1] : 1;
+        if (w.ne[0] != shape[0] || (nDims == 2 && w.ne[1] != shape[1])) {
+            qInfo() << "Tensor" << w.name << "shape" << w.ne[0] << "x" << w.ne[1]
+                    << "differs from expected" << shape[0] << "x" << (nDims == 2 ? shape[1] : 1);
+        }
+    }
+    if (w.srcType < 0 || w.srcType >= GGML_TYPE_COUNT || ggml_get_type_traits((ggml_type)w.srcType)->blck_size == 0) {
+        qWarning() << "Unsupported ggml type" << w.srcType << "for" << w.name;
+        return;
+    }
+    
+    // Optionally requantize float matrices; quantized tensors stay as stored
+    w.dstType = w.srcType;
+    const int target = m_weightTypeOverrides.value(w.name, m_weightType);
+    const bool isFloat = w.srcType == GGML_TYPE_F32 || w.srcType == GGML_TYPE_F16;
+    if (target >= 0 && nDims == 2 && isFloat && target != w.srcType &&
+        w.ne[0] % ggml_blck_size((ggml_type)target) == 0 &&
+        !ggml_quantize_requires_imatrix((ggml_type)target)) {
+        w.dstType = target;
+    }
+    
+    // Native tensors inside the file mapping are used in place
+    if (m_mapBase && w.dstType == w.srcType) {
+        const QByteArray& data = cache[w.name];
+        const char* begin = static_cast<const char*>(m_mapBase);
+        const size_t bytes = ggml_row_size((ggml_type)w.srcType, w.ne[0]) * (size_t)w.ne[1];
+        if (data.constData() >= begin && (size_t)data.size() >= bytes &&
+            data.constData() + bytes <= begin + m_mapSize) {
+            w.mappedData = data.constData();
+        }
+    }
+    
+    plan.push_back(w);
+}
+
+bool TransformerInference::initKVCache() {
+    // Preallocated block pool shared by every sequence; past the budget,
+    // eviction and the caller's admission control share what there is
+    size_t poolTokens = m_kvPoolTokens > 0 ? (size_t)m_kvPoolTokens : (size_t)m_ctxSize;
+    if (m_kvPoolBudgetMB >= 0) {
+        const size_t bytesPerToken = 2ull * m_nLayers * m_nEmbd * sizeof(float);
+        const size_t budgetTokens = (size_t)m_kvPoolBudgetMB * 1024 * 1024 / bytesPerToken;
+        poolTokens = std::max((size_t)m_ctxSize, std::min(poolTokens, budgetTokens));
+    }
+    PagedKVConfig config;
+    config.n_layers = (uint32_t)m_nLayers;
+    config.kv_dim = (uint32_t)m_nEmbd;
+    config.block_size = kKVBlockSize;
+    config.num_blocks = ((uint32_t)poolTokens + kKVBlockSize - 1) / kKVBlockSize;
+    if (!m_kv.Init(config)) {
+        qWarning() << "Failed to allocate paged KV pool for" << poolTokens << "tokens";
+        return false;
+    }
+    m_kv.AddSequence(m_activeSeq);
+    m_kv.SetPinned(m_activeSeq, true);
+    m_pinnedSeqs.clear();
+    
+    // Cached prefixes live in the pool; if pool pressure evicts one, forget it
+    m_prefixCache.Clear();
+    m_prefixCache.SetEvictCallback([this](PagedKVCache::SeqId seq) { m_kv.RemoveSequence(seq); });
+    m_kv.SetEvictCallback([this](PagedKVCache::SeqId seq) {
+        if (seq < 0) m_prefixCache.Erase(seq);
+    });
+    applyPrefixCacheBudget();
+    
+    // Separate metadata-only context; K/V storage is the pool itself
+    size_t kvSize = 2ull * m_nLayers * ggml_tensor_overhead();
     struct ggml_init_params params = {
         .mem_size = kvSize,
         .mem_buffer = nullptr,
-        .no_alloc = false,
+        .no_alloc = true,
     };
     
     m_kvCtx = ggml_init(params);
     if (!m_kvCtx) {
         qWarning() << "Failed to init KV cache context";
-        return;
+        return false;
+    }
+    
+    // K and V planes per layer: [n_embd, pool slots], aliased onto the pool
+    // (already zeroed, so masked-out slots never hold NaN/Inf)
+    m_kvBuffer = ggml_backend_cpu_buffer_from_ptr(m_kv.PoolData(), m_kv.PoolBytes());
+    if (!m_kvBuffer) {
+        qWarning() << "Failed to wrap KV pool in a backend buffer";
+        return false;
     }
     
-    // Allocate K and V cache tensors: [n_layers, ctx_size, n_embd]
     m_kCache.resize(m_nLayers);
     m_vCache.resize(m_nLayers);
-    
+    const int64_t nSlots = m_kv.SlotCount();
     for (int i = 0; i < m_nLayers; ++i) {
-        m_kCache[i] = ggml_new_tensor_2d(m_kvCtx, GGML_TYPE_F32, m_nEmbd, m_ctxSize);
-        m_vCache[i] = ggml_new_tensor_2d(m_kvCtx, GGML_TYPE_F32, m_nEmbd, m_ctxSize);
-        
-        // Zero initialize
-        ggml_set_zero(m_kCache[i]);
-        ggml_set_zero(m_vCache[i]);
+        m_kCache[i] = ggml_new_tensor_2d(m_kvCtx, GGML_TYPE_F32, m_nEmbd, nSlots);
+        m_vCache[i] = ggml_new_tensor_2d(m_kvCtx, GGML_TYPE_F32, m_nEmbd, nSlots);
+        if (ggml_backend_tensor_alloc(m_kvBuffer, m_kCache[i], m_kv.KeyPlane(i)) != GGML_STATUS_SUCCESS ||
+            ggml_backend_tensor_alloc(m_kvBuffer, m_vCache[i], m_kv.ValuePlane(i)) != GGML_STATUS_SUCCESS) {
+            qWarning() << "Failed to place KV tensors for layer" << i;
+            return false;
+        }
     }
+    
+    qInfo() << "KV pool:" << config.num_blocks << "blocks of" << kKVBlockSize << "tokens,"
+            << m_kv.PoolBytes() / (1024 * 1024) << "MB";
+    return true;
 }
 
-ggml_tensor* TransformerInference::createTensorFromCache(
-    const QString& name,
-    const QHash<QString, QByteArray>& cache,
-    const int64_t* shape, int nDims) {
-    
-    if (!cache.contains(name)) {
-        qWarning() << "Tensor not found in cache:" << name;
-        return nullptr;
+void TransformerInference::resetKVCache() {
+    m_kv.TruncateSequence(m_activeSeq, 0);
+}
+
+bool TransformerInference::selectSequence(int seqId) {
+    if (!m_kv.IsInitialized()) {
+        m_activeSeq = seqId;  // Created with the pool on the next load
+        return true;
+    }
+    if (!m_kv.HasSequence(seqId) && !m_kv.AddSequence(seqId)) {
+        return false;
+    }
+    if (!m_pinnedSeqs.contains(m_activeSeq)) {
+        m_kv.SetPinned(m_activeSeq, false);
+    }
+    m_kv.SetPinned(seqId, true);
+    m_activeSeq = seqId;
+    return true;
+}
+
+bool TransformerInference::forkSequence(int srcSeq, int dstSeq) {
+    return m_kv.ForkSequence(srcSeq, dstSeq);
+}
+
+void TransformerInference::removeSequence(int seqId) {
+    m_pinnedSeqs.remove(seqId);
+    m_kv.RemoveSequence(seqId);
+    if (seqId == m_activeSeq && m_kv.IsInitialized()) {
+        // The active sequence always exists; it restarts empty
+        m_kv.AddSequence(seqId);
+        m_kv.SetPinned(seqId, true);
     }
+}
+
+void TransformerInference::setSequencePinned(int seqId, bool pinned) {
+    if (pinned) {
+        m_pinnedSeqs.insert(seqId);
+    } else {
+        m_pinnedSeqs.remove(seqId);
+    }
+    m_kv.SetPinned(seqId, pinned || seqId == m_activeSeq);
+}
+
+ggml_tensor* TransformerInference::createTensorFromCache(
+    const WeightPlan& plan,
+    const QHash<QString, QByteArray>& cache) {
     
-    const QByteArray& data = cache[name];
+    const QByteArray& data = cache[plan.name];
+    const ggml_type srcType = (ggml_type)plan.srcType;
+    const ggml_type dstType = (ggml_type)plan.dstType;
     
-    // Create tensor with specified shape
+    // Create tensor with its native (or requested) ggml type; mapped tensors
+    // get metadata only and point into the file below
+    ggml_set_no_alloc(m_ctx, plan.mappedData != nullptr);
     ggml_tensor* tensor = nullptr;
-    if (nDims == 1) {
-        tensor = ggml_new_tensor_1d(m_ctx, GGML_TYPE_F32, shape[0]);
-    } else if (nDims == 2) {
-        tensor = ggml_new_tensor_2d(m_ctx, GGML_TYPE_F32, shape[0], shape[1]);
+    if (plan.nDims == 1) {
+        tensor = ggml_new_tensor_1d(m_ctx, dstType, plan.ne[0]);
     } else {
-        qWarning() << "Unsupported tensor dims:" << nDims;
-        return nullptr;
+        tensor = ggml_new_tensor_2d(m_ctx, dstType, plan.ne[0], plan.ne[1]);
     }
+    ggml_set_no_alloc(m_ctx, false);
     
     if (!tensor) {
-        qWarning() << "Failed to create tensor:" << name;
+        qWarning() << "Failed to create tensor:" << plan.name;
         return nullptr;
     }
+    ggml_set_name(tensor, plan.name.toUtf8().constData());
     
-    // Copy quantized data - for now assume F32 or will need dequant
-    size_t expectedSize = ggml_nbytes(tensor);
-    if (data.size() < (int)expectedSize) {
-        qWarning() << "Tensor data too small:" << name << data.size() << "vs" << expectedSize;
-        // Copy what we have
-        std::memcpy(tensor->data, data.constData(), std::min<size_t>(data.size(), expectedSize));
-    } else {
-        std::memcpy(tensor->data, data.constData(), expectedSize);
+    if (plan.mappedData) {
+        if (ggml_backend_tensor_alloc(m_mapBuffer, tensor, const_cast<char*>(plan.mappedData)) != GGML_STATUS_SUCCESS) {
+            qWarning() << "Failed to alias mapped tensor:" << plan.name;
+            return nullptr;
+        }
+        return tensor;
+    }
+    
+    const size_t srcSize = ggml_row_size(srcType, plan.ne[0]) * (size_t)plan.ne[1];
+    if ((size_t)data.size() < srcSize) {
+        qWarning() << "Tensor data too small:" << plan.name << data.size() << "vs" << srcSize;
+        return nullptr;
+    }
+    
+    if (srcType == dstType) {
+        // Native bytes go straight in; ggml_mul_mat consumes quantized blocks
+        std::memcpy(tensor->data, data.constData(), srcSize);
+        return tensor;
+    }
+    
+    // Requantize a float matrix row block by row block
+    const int64_t nPerRow = plan.ne[0];
+    const int64_t nRows = plan.ne[1];
+    const int64_t rowsPerChunk = std::max<int64_t>(1, (1 << 20) / nPerRow);
+    std::vector<float> rows((size_t)(rowsPerChunk * nPerRow));
+    for (int64_t r0 = 0; r0 < nRows; r0 += rowsPerChunk) {
+        const int64_t nr = std::min(rowsPerChunk, nRows - r0);
+        const char* src = data.constData() + ggml_row_size(srcType, nPerRow) * r0;
+        if (srcType == GGML_TYPE_F16) {
+            ggml_fp16_to_fp32_row((const ggml_fp16_t*)src, rows.data(), nr * nPerRow);
+        } else {
+            std::memcpy(rows.data(), src, sizeof(float) * nr * nPerRow);
+        }
+        ggml_quantize_chunk(dstType, rows.data(), (char*)tensor->data + ggml_row_size(dstType, nPerRow) * r0,
+                            0, nr, nPerRow, nullptr);
     }
     
     return tensor;
@@ -194,85 +560,321 @@ std::vector<int32_t> TransformerInference::generate(const std::vector<int32_t>&
     std::vector<int32_t> tokens = prompt;
     tokens.reserve(prompt.size() + maxTokens);
     
-    for (int i = 0; i < maxTokens; ++i) {
-        // Run forward pass
-        std::vector<float> logits = forward(tokens);
-        if (logits.empty()) break;
-        
+    // Prefill once over the prompt, then feed back one token per step
+    std::vector<float> logits = prefill(prompt);
+    
+    for (int i = 0; i < maxTokens && !logits.empty(); ++i) {
         // Sample next token
         int32_t nextToken = sampleToken(logits, temperature);
         tokens.push_back(nextToken);
         
         // Stop on EOS (assuming token 2 is EOS)
         if (nextToken == 2) break;
+        
+        logits = decode(nextToken);
     }
     
     return tokens;
 }
 
+std::vector<float> TransformerInference::prefill(const std::vector<int32_t>& tokens) {
+    resetKVCache();
+    m_lastReusedTokens = 0;
+    if (!m_kv.IsInitialized() || tokens.empty() || m_prefixCache.GetMaxTokens() == 0) {
+        return forward(tokens);
+    }
+    
+    // Start from the longest cached prefix; at least the last prompt token
+    // is always evaluated, since its logits are the result
+    size_t matched = 0;
+    const PrefixCache::EntryId entry = m_prefixCache.Match(tokens.data(), tokens.size(), &matched);
+    matched = std::min(matched, tokens.size() - 1);
+    if (entry != PrefixCache::kNoEntry && matched > 0) {
+        // Shares the prefix's blocks; the first append copies a partial tail
+        m_kv.RemoveSequence(m_activeSeq);
+        if (m_kv.ForkSequence(entry, m_activeSeq) && m_kv.TruncateSequence(m_activeSeq, (uint32_t)matched)) {
+            m_lastReusedTokens = (int)matched;
+        } else {
+            m_kv.RemoveSequence(m_activeSeq);
+            m_kv.AddSequence(m_activeSeq);
+        }
+        m_kv.SetPinned(m_activeSeq, true);
+    }
+    
+    std::vector<float> logits = m_lastReusedTokens > 0
+        ? forward(std::vector<int32_t>(tokens.begin() + m_lastReusedTokens, tokens.end()))
+        : forward(tokens);
+    
+    // Cache the whole prompt as a fork of this sequence (no K/V is copied)
+    if (!logits.empty()) {
+        const int cacheSeq = m_nextPrefixSeq;
+        m_nextPrefixSeq = cacheSeq == INT32_MIN + 1 ? -1 : cacheSeq - 1;
+        if (m_kv.ForkSequence(m_activeSeq, cacheSeq) &&
+            !m_prefixCache.Insert(tokens.data(), tokens.size(), cacheSeq)) {
+            m_kv.RemoveSequence(cacheSeq);
+        }
+    }
+    return logits;
+}
+
+void TransformerInference::setPrefixCacheBudgetMB(int mb) {
+    m_prefixCacheBudgetMB = mb;
+    applyPrefixCacheBudget();
+}
+
+void TransformerInference::applyPrefixCacheBudget() {
+    if (!m_kv.IsInitialized()) {
+        return;  // Applied when the pool is created
+    }
+    const size_t poolTokens = m_kv.SlotCount();
+    if (m_prefixCacheBudgetMB < 0) {
+        m_prefixCache.SetMaxTokens(poolTokens);
+        return;
+    }
+    const size_t bytesPerToken = 2ull * m_nLayers * m_nEmbd * sizeof(float);
+    m_prefixCache.SetMaxTokens(std::min(poolTokens, (size_t)m_prefixCacheBudgetMB * 1024 * 1024 / bytesPerToken));
+}
+
+std::vector<float> TransformerInference::decode(int32_t token) {
+    return forward(std::vector<int32_t>{token});
+}
+
 std::vector<float> TransformerInference::forward(const std::vector<int32_t>& tokens) {
     if (!m_ready || tokens.empty()) return {};
     
-    // Create computation graph context
-    size_t graphMem = 128 * 1024 * 1024;  // 128MB for compute graph
-    struct ggml_init_params params = {
-        .mem_size = graphMem,
-        .mem_buffer = nullptr,
-        .no_alloc = false,
-    };
+    if (!m_backend || !m_kvBuffer) {
+        qWarning() << "KV cache not initialized";
+        return {};
+    }
     
-    ggml_context* gfCtx = ggml_init(params);
-    if (!gfCtx) {
-        qWarning() << "Failed to init graph context";
+    const int nTokens = (int)tokens.size();
+    const int nPast = kvPosition();
+    if (nPast + nTokens > m_ctxSize) {
+        qWarning() << "Context window exceeded:" << nPast << "+" << nTokens << ">" << m_ctxSize;
         return {};
     }
     
-    // Build computation graph
-    ggml_tensor* logitsTensor = buildGraph(gfCtx, tokens);
+    // Claim pool slots for the new positions (may evict idle sequences)
+    m_rowScratch.resize(nTokens);
+    if (!m_kv.Append(m_activeSeq, (uint32_t)nTokens, m_rowScratch.data())) {
+        qWarning() << "KV pool exhausted: cannot add" << nTokens << "tokens to sequence" << m_activeSeq;
+        return {};
+    }
     
-    if (!logitsTensor) {
-        ggml_free(gfCtx);
+    // Single-token steps share one cached graph; its shape only changes when
+    // the context crosses a kKVBucket boundary
+    const int nKV = std::min(m_ctxSize, (nPast + nTokens + kKVBucket - 1) / kKVBucket * kKVBucket);
+    GraphCache& graph = (nTokens == 1) ? m_decodeGraph : m_prefillGraph;
+    if (!prepareGraph(graph, nTokens, nKV)) {
+        m_kv.TruncateSequence(m_activeSeq, (uint32_t)nPast);
         return {};
     }
     
-    // Execute graph
-    struct ggml_cgraph* gf = ggml_new_graph(gfCtx);
-    ggml_build_forward_expand(gf, logitsTensor);
+    // Upload this step's inputs: token IDs, absolute positions, pool slots
+    // to write and to attend over, and (on the masked path) the causal mask
+    // (token j sees cached positions <= nPast + j; padding slots are masked)
+    m_posScratch.resize(nTokens);
+    for (int i = 0; i < nTokens; ++i) {
+        m_posScratch[i] = nPast + i;
+    }
+    m_slotScratch.resize(nKV);
+    m_kv.GatherSlots(m_activeSeq, (uint32_t)nKV, m_slotScratch.data());
     
-    // Create CPU backend for graph execution
-    ggml_backend_t backend = ggml_backend_cpu_init();
-    if (!backend) {
-        qCritical() << "Failed to initialize GGML CPU backend";
-        ggml_free(gfCtx);
-        return {};
+    ggml_backend_tensor_set(graph.tokens, tokens.data(), 0, nTokens * sizeof(int32_t));
+    ggml_backend_tensor_set(graph.pos, m_posScratch.data(), 0, nTokens * sizeof(int32_t));
+    ggml_backend_tensor_set(graph.kvRows, m_rowScratch.data(), 0, nTokens * sizeof(int64_t));
+    ggml_backend_tensor_set(graph.kvSlots, m_slotScratch.data(), 0, nKV * sizeof(int32_t));
+    if (graph.mask) {
+        const int64_t maskRows = graph.mask->ne[1];
+        m_maskScratch.assign((size_t)nKV * maskRows, -INFINITY);
+        for (int j = 0; j < nTokens; ++j) {
+            std::fill_n(m_maskScratch.begin() + (size_t)j * nKV, nPast + j + 1, 0.0f);
+        }
+        ggml_backend_tensor_set(graph.mask, m_maskScratch.data(), 0, m_maskScratch.size() * sizeof(float));
     }
     
     // Execute the computation graph
-    enum ggml_status status = ggml_backend_graph_compute(backend, gf);
+    enum ggml_status status = ggml_backend_graph_compute(m_backend, graph.gf);
     if (status != GGML_STATUS_SUCCESS) {
         qWarning() << "Graph computation failed with status" << status;
+        m_kv.TruncateSequence(m_activeSeq, (uint32_t)nPast);
+        return {};
     }
     
     // Extract logits from computed tensor
     std::vector<float> logits(m_nVocab);
-    ggml_backend_tensor_get(logitsTensor, logits.data(), 0, m_nVocab * sizeof(float));
+    ggml_backend_tensor_get(graph.logits, logits.data(), 0, m_nVocab * sizeof(float));
+    return logits;
+}
+
+std::vector<std::vector<float>> TransformerInference::forwardBatch(const std::vector<int>& seqIds,
+                                                                 const std::vector<int32_t>& tokens) {
+    if (!m_ready || seqIds.empty() || seqIds.size() != tokens.size()) return {};
+    
+    if (!m_backend || !m_kvBuffer) {
+        qWarning() << "KV cache not initialized";
+        return {};
+    }
+    
+    const int nSeqs = (int)seqIds.size();
+    for (int seqId : seqIds) {
+        if (!m_kv.HasSequence(seqId) && !m_kv.AddSequence(seqId)) {
+            qWarning() << "Cannot create KV sequence" << seqId;
+            return {};
+        }
+        if ((int)m_kv.SequenceLength(seqId) + 1 > m_ctxSize) {
+            qWarning() << "Context window exceeded for sequence" << seqId;
+            return {};
+        }
+    }
+    
+    // Claim one slot per sequence; on failure give back the ones already taken
+    m_rowScratch.resize(nSeqs);
+    for (int i = 0; i < nSeqs; ++i) {
+        if (!m_kv.Append(seqIds[i], 1, &m_rowScratch[i])) {
+            qWarning() << "KV pool exhausted: cannot extend sequence" << seqIds[i];
+            for (int j = 0; j < i; ++j) {
+                m_kv.TruncateSequence(seqIds[j], m_kv.SequenceLength(seqIds[j]) - 1);
+            }
+            return {};
+        }
+    }
     
-    // Cleanup backend
-    ggml_backend_free(backend);
+    // Attention reads every sequence's slots back to back; the graph shape
+    // only changes with the batch size or when the total crosses a bucket
+    int totalKV = 0;
+    for (int seqId : seqIds) {
+        totalKV += (int)m_kv.SequenceLength(seqId);
+    }
+    const int nKV = (totalKV + kKVBucket - 1) / kKVBucket * kKVBucket;
+    if (!prepareGraph(m_batchGraph, nSeqs, nKV, true)) {
+        for (int seqId : seqIds) {
+            m_kv.TruncateSequence(seqId, m_kv.SequenceLength(seqId) - 1);
+        }
+        return {};
+    }
+    GraphCache& graph = m_batchGraph;
+    
+    // Row i attends to its own segment [offset, offset + length) of the
+    // gathered slots, which ends with the position it is writing
+    m_posScratch.resize(nSeqs);
+    m_startScratch.resize(nSeqs);
+    m_slotScratch.assign(nKV, 0);
+    int offset = 0;
+    for (int i = 0; i < nSeqs; ++i) {
+        const int len = (int)m_kv.SequenceLength(seqIds[i]);
+        m_posScratch[i] = len - 1;
+        m_startScratch[i] = offset;
+        m_kv.GatherSlots(seqIds[i], (uint32_t)len, m_slotScratch.data() + offset);
+        offset += len;
+    }
+    
+    ggml_backend_tensor_set(graph.tokens, tokens.data(), 0, nSeqs * sizeof(int32_t));
+    ggml_backend_tensor_set(graph.pos, m_posScratch.data(), 0, nSeqs * sizeof(int32_t));
+    ggml_backend_tensor_set(graph.kvRows, m_rowScratch.data(), 0, nSeqs * sizeof(int64_t));
+    ggml_backend_tensor_set(graph.kvSlots, m_slotScratch.data(), 0, nKV * sizeof(int32_t));
+    ggml_backend_tensor_set(graph.kvStarts, m_startScratch.data(), 0, nSeqs * sizeof(int32_t));
+    
+    enum ggml_status status = ggml_backend_graph_compute(m_backend, graph.gf);
+    if (status != GGML_STATUS_SUCCESS) {
+        qWarning() << "Batched graph computation failed with status" << status;
+        for (int seqId : seqIds) {
+            m_kv.TruncateSequence(seqId, m_kv.SequenceLength(seqId) - 1);
+        }
+        return {};
+    }
     
-    ggml_free(gfCtx);
+    std::vector<std::vector<float>> logits(nSeqs, std::vector<float>(m_nVocab));
+    for (int i = 0; i < nSeqs; ++i) {
+        ggml_backend_tensor_get(graph.logits, logits[i].data(), (size_t)i * graph.logits->nb[1],
+                                m_nVocab * sizeof(float));
+    }
     return logits;
 }
 
-ggml_tensor* TransformerInference::buildGraph(ggml_context* ctx, const std::vector<int32_t>& tokens) {
-    int nTokens = tokens.size();
+bool TransformerInference::prepareGraph(GraphCache& graph, int nTokens, int nKV, bool allLogits) {
+    if (graph.gf && graph.nTokens == nTokens && graph.nKV == nKV && graph.allLogits == allLogits) {
+        return true;
+    }
+    
+    if (graph.ctx) {
+        ggml_free(graph.ctx);
+        graph.ctx = nullptr;
+        graph.gf = nullptr;
+    }
+    
+    // Metadata-only context in a buffer owned by the cache entry
+    const size_t metaSize = ggml_tensor_overhead() * kGraphSize
+                          + ggml_graph_overhead_custom(kGraphSize, false);
+    if (graph.metaBuffer.size() < metaSize) {
+        graph.metaBuffer.resize(metaSize);
+    }
+    struct ggml_init_params params = {
+        .mem_size = metaSize,
+        .mem_buffer = graph.metaBuffer.data(),
+        .no_alloc = true,
+    };
+    
+    graph.ctx = ggml_init(params);
+    if (!graph.ctx) {
+        qWarning() << "Failed to init graph context";
+        return false;
+    }
+    
+    graph.gf = ggml_new_graph_custom(graph.ctx, kGraphSize, false);
+    graph.nTokens = nTokens;
+    graph.nKV = nKV;
+    graph.allLogits = allLogits;
+    buildGraph(graph);
+    
+    // Activations live in a gallocr arena that grows to the largest graph
+    // seen and is then reused; inputs are placed at non-overlapping offsets
+    if (!graph.alloc) {
+        graph.alloc = ggml_gallocr_new(ggml_backend_get_default_buffer_type(m_backend));
+    }
+    if (!graph.alloc || !ggml_gallocr_alloc_graph(graph.alloc, graph.gf)) {
+        qWarning() << "Failed to allocate compute buffer for" << nTokens << "tokens";
+        releaseGraph(graph);
+        return false;
+    }
+    
+    return true;
+}
+
+void TransformerInference::buildGraph(GraphCache& graph) {
+    ggml_context* ctx = graph.ctx;
+    ggml_cgraph* gf = graph.gf;
+    const int nTokens = graph.nTokens;
+    const int nKV = graph.nKV;
+    const int headDim = m_nEmbd / m_nHead;
+    
+    // Per-step inputs, filled by forward() after allocation
+    graph.tokens = ggml_new_tensor_1d(ctx, GGML_TYPE_I32, nTokens);
+    graph.pos = ggml_new_tensor_1d(ctx, GGML_TYPE_I32, nTokens);
+    graph.kvRows = ggml_new_tensor_1d(ctx, GGML_TYPE_I64, nTokens);
+    graph.kvSlots = ggml_new_tensor_1d(ctx, GGML_TYPE_I32, nKV);
+    ggml_set_input(graph.tokens);
+    ggml_set_input(graph.pos);
+    ggml_set_input(graph.kvRows);
+    ggml_set_input(graph.kvSlots);
     
-    // Create input tensor for token IDs
-    ggml_tensor* inp = ggml_new_tensor_1d(ctx, GGML_TYPE_I32, nTokens);
-    std::memcpy(inp->data, tokens.data(), nTokens * sizeof(int32_t));
+    // Flash attention derives the causal limit from positions; only the
+    // masked path needs the mask. Batched decode rows are separate
+    // sequences, each attending to its own segment of the gathered slots.
+    const bool segmented = graph.allLogits;
+    const bool flash = m_flashAttention && !segmented;
+    graph.mask = nullptr;
+    graph.kvStarts = nullptr;
+    if (segmented) {
+        graph.kvStarts = ggml_new_tensor_1d(ctx, GGML_TYPE_I32, nTokens);
+        ggml_set_input(graph.kvStarts);
+    } else if (!flash) {
+        graph.mask = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, nKV, GGML_PAD(nTokens, GGML_KQ_MASK_PAD));
+        ggml_set_input(graph.mask);
+    }
     
     // Token embedding lookup: [n_tokens, n_embd]
-    ggml_tensor* cur = ggml_get_rows(ctx, m_tokenEmbed, inp);
+    ggml_tensor* cur = ggml_get_rows(ctx, m_tokenEmbed, graph.tokens);
     
     // Process through transformer layers
     for (int il = 0; il < m_nLayers; ++il) {
@@ -288,26 +890,58 @@ ggml_tensor* TransformerInference::buildGraph(ggml_context* ctx, const std::vect
             }
         }
         
-        // Self-attention with proper multi-head handling
-        // Project to Q, K, V: [n_tokens, n_embd] -> [n_tokens, n_embd]
-        ggml_tensor* Q = ggml_mul_mat(ctx, layer.attn_q, cur);
-        ggml_tensor* K = ggml_mul_mat(ctx, layer.attn_k, cur);
+        // Project to Q, K, V and split heads: [n_embd, n_tokens] -> [head_dim, n_head, n_tokens]
+        ggml_tensor* Q = ggml_reshape_3d(ctx, ggml_mul_mat(ctx, layer.attn_q, cur), headDim, m_nHead, nTokens);
+        ggml_tensor* K = ggml_reshape_3d(ctx, ggml_mul_mat(ctx, layer.attn_k, cur), headDim, m_nHead, nTokens);
         ggml_tensor* V = ggml_mul_mat(ctx, layer.attn_v, cur);
         
-        // Scaled dot-product attention: softmax((Q @ K^T) / sqrt(d_k)) @ V
-        // Note: ggml_mul_mat(A, B) computes A @ B^T for proper matrix mult
-        ggml_tensor* KQ = ggml_mul_mat(ctx, K, Q);  // [n_tokens, n_tokens] attention scores
+        Q = ggml_rope_ext(ctx, Q, graph.pos, nullptr, headDim, GGML_ROPE_TYPE_NORMAL, m_ctxSize,
+                          10000.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+        K = ggml_rope_ext(ctx, K, graph.pos, nullptr, headDim, GGML_ROPE_TYPE_NORMAL, m_ctxSize,
+                          10000.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f);
         
-        // Scale by 1/sqrt(d_k) where d_k = n_embd / n_head
-        float scale = 1.0f / sqrtf((float)(m_nEmbd / m_nHead));
-        KQ = ggml_scale(ctx, KQ, scale);
+        // Scatter this step's K/V rows into the pool at kvRows. Attention
+        // gathers from the set_rows results, so the writes are ordered
+        // before the reads by a real graph dependency.
+        ggml_tensor* kCache = ggml_set_rows(ctx, m_kCache[il], ggml_reshape_2d(ctx, K, m_nEmbd, nTokens), graph.kvRows);
+        ggml_tensor* vCache = ggml_set_rows(ctx, m_vCache[il], V, graph.kvRows);
         
-        // Apply causal mask for autoregressive generation (if needed)
-        // For simplicity, just softmax without mask
-        KQ = ggml_soft_max(ctx, KQ);
+        // Gather the sequence's first nKV positions through its block table
+        ggml_tensor* kSeq = ggml_get_rows(ctx, kCache, graph.kvSlots);  // [n_embd, n_kv]
+        ggml_tensor* vSeq = ggml_get_rows(ctx, vCache, graph.kvSlots);
         
-        // Attention output: [n_tokens, n_tokens] @ [n_tokens, n_embd] -> [n_tokens, n_embd]
-        ggml_tensor* attnOut = ggml_mul_mat(ctx, V, KQ);
+        ggml_tensor* attnOut = nullptr;
+        if (segmented) {
+            ggml_tensor* args[] = {Q, kSeq, vSeq, graph.pos, graph.kvStarts};
+            ggml_tensor* KQV = ggml_custom_4d(ctx, GGML_TYPE_F32, headDim, m_nHead, nTokens, 1,
+                                              args, 5, segmentedAttentionOp, GGML_N_TASKS_MAX, nullptr);
+            attnOut = ggml_reshape_2d(ctx, KQV, m_nEmbd, nTokens);
+        } else if (flash) {
+            // Tiled online-softmax attention on the gathered rows: [head_dim, n_head, n_tokens]
+            ggml_tensor* args[] = {Q, kSeq, vSeq, graph.pos};
+            ggml_tensor* KQV = ggml_custom_4d(ctx, GGML_TYPE_F32, headDim, m_nHead, nTokens, 1,
+                                              args, 4, flashAttentionOp, GGML_N_TASKS_MAX, nullptr);
+            attnOut = ggml_reshape_2d(ctx, KQV, m_nEmbd, nTokens);
+        } else {
+            // Attend over the first nKV cached positions: [head_dim, n_kv, n_head]
+            ggml_tensor* Kall = ggml_permute(ctx,
+                ggml_reshape_3d(ctx, kSeq, headDim, m_nHead, nKV),
+                0, 2, 1, 3);
+            ggml_tensor* Qh = ggml_permute(ctx, Q, 0, 2, 1, 3);  // [head_dim, n_tokens, n_head]
+            
+            // Scaled dot-product attention: softmax((Q @ K^T) / sqrt(d_k) + mask) @ V
+            ggml_tensor* KQ = ggml_mul_mat(ctx, Kall, Qh);  // [n_kv, n_tokens, n_head]
+            KQ = ggml_soft_max_ext(ctx, KQ, graph.mask, 1.0f / sqrtf((float)headDim), 0.0f);
+            
+            // V laid out as [n_kv, head_dim, n_head] so mul_mat contracts over n_kv
+            ggml_tensor* Vall = ggml_cont(ctx, ggml_permute(ctx,
+                ggml_reshape_3d(ctx, vSeq, headDim, m_nHead, nKV),
+                1, 2, 0, 3));
+            
+            ggml_tensor* KQV = ggml_mul_mat(ctx, Vall, KQ);  // [head_dim, n_tokens, n_head]
+            KQV = ggml_permute(ctx, KQV, 0, 2, 1, 3);         // [head_dim, n_head, n_tokens]
+            attnOut = ggml_cont_2d(ctx, KQV, m_nEmbd, nTokens);
+        }
         
         // Attention projection back to embedding dimension
         if (layer.attn_proj) {
@@ -338,6 +972,13 @@ ggml_tensor* TransformerInference::buildGraph(ggml_context* ctx, const std::vect
         cur = ggml_add(ctx, cur, inpL);
     }
     
+    // Only the last position is needed for next-token prediction, so slice
+    // before the final norm and vocabulary projection (batched decode needs
+    // every row: each one is a different sequence)
+    if (!graph.allLogits) {
+        cur = ggml_view_2d(ctx, cur, m_nEmbd, 1, cur->nb[1], (size_t)(nTokens - 1) * cur->nb[1]);
+    }
+    
     // Final layer norm (typically uses dedicated final norm weights)
     if (!m_layers.empty() && m_layers.back().ln2_weight) {
         cur = ggml_norm(ctx, cur, 1e-5f);
@@ -347,17 +988,14 @@ ggml_tensor* TransformerInference::buildGraph(ggml_context* ctx, const std::vect
         }
     }
     
-    // Output projection to vocabulary: [n_tokens, n_embd] -> [n_tokens, vocab]
+    // Output projection to vocabulary: [n_embd, rows] -> [vocab, rows]
     if (m_outputWeight) {
         cur = ggml_mul_mat(ctx, m_outputWeight, cur);
     }
     
-    // Extract last token logits for next-token prediction
-    // ggml_view_1d uses element offsets, not byte offsets
-    int lastTokenOffset = (nTokens - 1) * m_nVocab;
-    cur = ggml_view_1d(ctx, cur, m_nVocab, lastTokenOffset * sizeof(float));
-    
-    return cur;
+    ggml_set_output(cur);
+    ggml_build_forward_expand(gf, cur);
+    graph.logits = cur;
 }
 
 int TransformerInference::sampleToken(const std::vector<float>& logits, float temperature) {
@@ -2,13 +2,19 @@
 #include <QString>
 #include <QByteArray>
 #include <QHash>
+#include <QSet>
 #include <vector>
 #include <cstdint>
+#include "paged_kv_cache.h"
+#include "prefix_cache.h"
 
 // Forward declarations for ggml
 struct ggml_context;
 struct ggml_tensor;
 struct ggml_cgraph;
+struct ggml_backend;
+struct ggml_backend_buffer;
+struct ggml_gallocr;
 
 /**
  * @brief Lightweight transformer inference using ggml backend
@@ -25,9 +31,22 @@ public:
     TransformerInference();
     ~TransformerInference();
     
+    /**
+     * @brief Native layout of a weight tensor as stored in the GGUF file
+     */
+    struct TensorLayout {
+        int type{0};               // ggml_type id (0 = F32)
+        std::vector<int64_t> ne;   // ggml ne[] order: ne[0] is the contiguous dimension
+    };
+    
     /**
      * @brief Load model weights from quantized tensor cache
-     * @param tensorCache Map of tensor names to quantized data
+     *
+     * Tensors are created in their native ggml type (Q4_0, Q4_K, Q6_K, Q8_0,
+     * F16, ...) and fed to ggml_mul_mat without expansion to F32; the weight
+     * context is sized from the tensors actually used.
+     * @param tensorCache Map of tensor names to raw GGUF tensor data
+     * @param layouts Type and shape of each tensor (missing entries are F32)
      * @param nLayers Number of transformer layers
      * @param nEmbd Embedding dimension
      * @param nHead Number of attention heads
@@ -35,8 +54,59 @@ public:
      * @return true if loaded successfully
      */
     bool loadWeights(const QHash<QString, QByteArray>& tensorCache,
+                     const QHash<QString, TensorLayout>& layouts,
                      int nLayers, int nEmbd, int nHead, int nVocab);
     
+    /**
+     * @brief Load model weights from an all-F32 tensor cache
+     */
+    bool loadWeights(const QHash<QString, QByteArray>& tensorCache,
+                     int nLayers, int nEmbd, int nHead, int nVocab);
+    
+    /**
+     * @brief Requantize F32/F16 weight matrices to this type on load
+     * @param ggmlType Target ggml_type, or -1 to keep every tensor native
+     */
+    void setWeightType(int ggmlType) { m_weightType = ggmlType; }
+    
+    /**
+     * @brief Per-tensor requant targets that take precedence over setWeightType()
+     * @param overrides Tensor name to ggml_type (-1 keeps that tensor native)
+     */
+    void setWeightTypeOverrides(const QHash<QString, int>& overrides) { m_weightTypeOverrides = overrides; }
+    
+    /**
+     * @brief Map a quant mode name ("Q4_0", "Q6_K", "F16", ...) to a ggml_type
+     * @return ggml_type id, or -1 if the name is not a ggml weight type
+     */
+    static int weightTypeFromName(const QString& name);
+    
+    /**
+     * @brief Alias weights that lie inside this read-only file mapping
+     *
+     * Cache entries whose bytes point into [base, base + size) and need no
+     * requantization become ggml tensors over the mapping instead of copies.
+     * The mapping must outlive the loaded weights (see unload()).
+     * @param base Start of the mapping, or nullptr to always copy
+     * @param size Mapping length in bytes
+     */
+    void setWeightMapping(const void* base, size_t size) { m_mapBase = base; m_mapSize = size; }
+    
+    /**
+     * @brief Bytes held by weight tensors after loading
+     */
+    size_t weightBytes() const { return m_weightBytes; }
+    
+    /**
+     * @brief Portion of weightBytes() served directly from the file mapping
+     */
+    size_t mappedWeightBytes() const { return m_mappedWeightBytes; }
+    
+    /**
+     * @brief Release weights, KV cache and backend (drops references into the mapping)
+     */
+    void unload() { freeContext(); }
+    
     /**
      * @brief Generate tokens autoregressively
      * @param prompt Input token IDs
@@ -48,12 +118,166 @@ public:
                                    int maxTokens, float temperature = 0.7f);
     
     /**
-     * @brief Run a single forward pass
-     * @param tokens Input token sequence
-     * @return Logits for next token prediction [vocab_size]
+     * @brief Run a forward pass continuing from the cached context
+     *
+     * K/V for every input token are appended to the per-layer cache, and
+     * attention runs over all cached positions, so callers only pass tokens
+     * the model has not seen yet.
+     * @param tokens New token IDs (positions kvPosition()..kvPosition()+n-1)
+     * @return Logits for next token prediction [vocab_size], empty on failure
      */
     std::vector<float> forward(const std::vector<int32_t>& tokens);
     
+    /**
+     * @brief Reset the KV cache and evaluate a full prompt
+     *
+     * With the prefix cache enabled, the longest cached prefix of the prompt
+     * is shared into the sequence instead of being recomputed, and the prompt
+     * is cached for later requests.
+     * @param tokens Prompt token IDs
+     * @return Logits for the token following the prompt
+     */
+    std::vector<float> prefill(const std::vector<int32_t>& tokens);
+    
+    /**
+     * @brief Memory budget for cached prompt prefixes
+     *
+     * Cached prompts keep their KV blocks in the paged pool (shared with the
+     * sequences that reuse them) until evicted least recently used first,
+     * either by this budget or by pool pressure.
+     * @param mb Budget in MB of KV; < 0 lets the cache use the whole pool
+     *           (default), 0 disables prefix caching
+     */
+    void setPrefixCacheBudgetMB(int mb);
+    
+    /**
+     * @brief Prefix cache hit/miss and reuse counters
+     */
+    PrefixCacheStats prefixCacheStats() const { return m_prefixCache.GetStats(); }
+    
+    /**
+     * @brief Prompt tokens the last prefill() took from the prefix cache
+     */
+    int lastReusedPrefixTokens() const { return m_lastReusedTokens; }
+    
+    /**
+     * @brief Evaluate a single token against the cached context
+     * @param token Token ID appended at position kvPosition()
+     * @return Logits for the following token
+     */
+    std::vector<float> decode(int32_t token);
+    
+    /**
+     * @brief Decode one token for each of several sequences in a single forward
+     *
+     * All sequences share one graph: the weight matmuls run once over the
+     * whole batch, and each token attends only to its own sequence's
+     * gathered KV rows, so attention costs the sum of the lengths. Sequences are created on
+     * first use. The active sequence is left unchanged.
+     * @param seqIds Sequence per batch row (distinct)
+     * @param tokens Token appended to each sequence
+     * @return Next-token logits per sequence, empty on failure (no KV is kept)
+     */
+    std::vector<std::vector<float>> forwardBatch(const std::vector<int>& seqIds,
+                                                 const std::vector<int32_t>& tokens);
+    
+    /**
+     * @brief Discard the active sequence's K/V so the next forward() starts at position 0
+     */
+    void resetKVCache();
+    
+    /**
+     * @brief Number of tokens the active sequence holds in the KV cache
+     */
+    int kvPosition() const { return (int)m_kv.SequenceLength(m_activeSeq); }
+    
+    /**
+     * @brief Make seqId the sequence forward()/prefill()/decode() operate on
+     *
+     * K/V live in a paged pool shared by all sequences (see PagedKVCache), so
+     * several sessions can keep their context while another one runs. Unknown
+     * ids start empty. Idle sequences may be evicted when the pool fills up,
+     * after which they restart at position 0.
+     */
+    bool selectSequence(int seqId);
+    int activeSequence() const { return m_activeSeq; }
+    
+    /**
+     * @brief Start dstSeq as a copy of srcSeq's context without copying K/V
+     *
+     * Blocks are shared copy-on-write, so a common prompt prefix is stored once.
+     */
+    bool forkSequence(int srcSeq, int dstSeq);
+    
+    /**
+     * @brief Drop a sequence and return its blocks to the pool
+     */
+    void removeSequence(int seqId);
+    
+    /**
+     * @brief Keep a sequence's KV blocks from being evicted while it is idle
+     *
+     * Used for sequences that are mid-generation in a batch but not active.
+     */
+    void setSequencePinned(int seqId, bool pinned);
+    
+    /**
+     * @brief Total token positions in the KV pool, shared by all sequences
+     *
+     * Takes effect on the next loadWeights(); <= 0 sizes the pool for one
+     * full context window.
+     */
+    void setKVPoolTokens(int nTokens) { m_kvPoolTokens = nTokens; }
+    
+    /**
+     * @brief Cap on the KV pool's memory, in MB of K and V
+     *
+     * Takes effect on the next loadWeights(). The pool never shrinks below
+     * one context window; < 0 (default) leaves setKVPoolTokens() uncapped.
+     */
+    void setKVPoolBudgetMB(int mb) { m_kvPoolBudgetMB = mb; }
+    
+    /**
+     * @brief Token positions the KV pool actually holds (0 before loading)
+     */
+    int kvPoolTokens() const { return (int)m_kv.SlotCount(); }
+    
+    /**
+     * @brief Paged KV pool state (block usage, sharing, evictions)
+     */
+    PagedKVStats kvStats() const { return m_kv.GetStats(); }
+    
+    /**
+     * @brief Maximum number of positions the KV cache can hold
+     */
+    int contextSize() const { return m_ctxSize; }
+    
+    /**
+     * @brief Set the number of CPU threads used for graph compute
+     * @param nThreads Thread count (<= 0 selects hardware concurrency)
+     */
+    void setThreadCount(int nThreads);
+    
+    /**
+     * @brief Number of CPU threads used for graph compute
+     */
+    int threadCount() const { return m_nThreads; }
+    
+    /**
+     * @brief Route single-sequence attention through the tiled flash-attention kernel
+     *
+     * Prefill and decode graphs then attend straight from the gathered K/V
+     * rows, with the causal limit taken from the token positions, instead of
+     * materializing a [n_kv, n_tokens, n_head] score tensor. Batched decode
+     * keeps the masked ggml path. Enabled by default.
+     */
+    void setFlashAttention(bool enabled);
+    
+    /**
+     * @brief Whether single-sequence graphs use the flash-attention kernel
+     */
+    bool flashAttention() const { return m_flashAttention; }
+    
     /**
      * @brief Check if model is loaded and ready
      */
@@ -66,11 +290,59 @@ private:
     int m_nHead{0};
     int m_nVocab{0};
     int m_ctxSize{2048};  // Context window
+    int m_weightType{-1};  // Requant target for F32/F16 matrices (-1 = native)
+    QHash<QString, int> m_weightTypeOverrides;
+    size_t m_weightBytes{0};
+    size_t m_mappedWeightBytes{0};
+    const void* m_mapBase{nullptr};  // Read-only model file mapping (not owned)
+    size_t m_mapSize{0};
     
     // ggml computation context
     ggml_context* m_ctx{nullptr};
     ggml_context* m_kvCtx{nullptr};  // KV cache context
     
+    // Persistent CPU backend and KV cache storage (lifetime of the loaded model)
+    ggml_backend* m_backend{nullptr};
+    ggml_backend_buffer* m_kvBuffer{nullptr};
+    ggml_backend_buffer* m_mapBuffer{nullptr};  // Wraps m_mapBase for aliased weights
+    int m_nThreads{0};
+    bool m_flashAttention{true};
+    
+    /**
+     * @brief A built forward graph plus its compute arena
+     *
+     * The topology depends only on (nTokens, nKV); per-step values (token IDs,
+     * positions, KV write rows, causal mask) are input tensors, so a graph is
+     * rebuilt only when its shape changes. Graph metadata lives in metaBuffer
+     * and activations in a gallocr arena, so reuse costs no allocation.
+     */
+    struct GraphCache {
+        std::vector<uint8_t> metaBuffer;
+        ggml_context* ctx{nullptr};
+        ggml_cgraph* gf{nullptr};
+        ggml_gallocr* alloc{nullptr};
+        int nTokens{0};
+        int nKV{0};
+        bool allLogits{false};  // Logits for every row, not just the last
+        ggml_tensor* tokens{nullptr};
+        ggml_tensor* pos{nullptr};
+        ggml_tensor* kvRows{nullptr};   // Pool slots written this step
+        ggml_tensor* kvSlots{nullptr};  // Pool slots of positions 0..nKV-1, read by attention
+        ggml_tensor* mask{nullptr};
+        ggml_tensor* kvStarts{nullptr}; // Batched decode: each row's first gathered slot
+        ggml_tensor* logits{nullptr};
+    };
+    GraphCache m_decodeGraph;   // Single-token steps, reused across tokens
+    GraphCache m_prefillGraph;  // Multi-token batches
+    GraphCache m_batchGraph;    // One token per sequence (forwardBatch)
+    
+    // Host staging for per-step graph inputs (reused, never shrunk)
+    std::vector<int32_t> m_posScratch;
+    std::vector<int64_t> m_rowScratch;
+    std::vector<int32_t> m_slotScratch;
+    std::vector<int32_t> m_startScratch;
+    std::vector<float> m_maskScratch;
+    
     // Model weights as ggml tensors
     ggml_tensor* m_tokenEmbed{nullptr};
     ggml_tensor* m_outputWeight{nullptr};
@@ -89,18 +361,48 @@ private:
     };
     std::vector<LayerWeights> m_layers;
     
-    // KV cache for efficient generation
+    // KV cache for efficient generation: per-layer ggml views over the
+    // paged pool, whose rows are pool slots rather than positions
+    PagedKVCache m_kv;
     std::vector<ggml_tensor*> m_kCache;
     std::vector<ggml_tensor*> m_vCache;
+    int m_activeSeq{0};
+    int m_kvPoolTokens{0};
+    int m_kvPoolBudgetMB{-1};
+    
+    // Cached prompts map to negative KV sequence ids sharing the pool
+    PrefixCache m_prefixCache;
+    int m_prefixCacheBudgetMB{-1};
+    int m_nextPrefixSeq{-1};
+    int m_lastReusedTokens{0};
+    QSet<int> m_pinnedSeqs;  // Pinned besides the active sequence
     
     bool m_ready{false};
     
+    // One weight to create: resolved source name, file type and target type
+    struct WeightPlan {
+        ggml_tensor** slot{nullptr};
+        QString name;
+        int srcType{0};
+        int dstType{0};
+        int64_t ne[2]{1, 1};
+        int nDims{1};
+        const char* mappedData{nullptr};  // Set when the tensor aliases the file mapping
+    };
+    
     // Helper methods
-    ggml_tensor* createTensorFromCache(const QString& name, 
-                                       const QHash<QString, QByteArray>& cache,
-                                       const int64_t* shape, int nDims);
-    ggml_tensor* buildGraph(ggml_context* ctx, const std::vector<int32_t>& tokens);
+    void planWeight(std::vector<WeightPlan>& plan, ggml_tensor** slot,
+                    const QString& name, const QString& altName,
+                    const QHash<QString, QByteArray>& cache,
+                    const QHash<QString, TensorLayout>& layouts,
+                    const int64_t* shape, int nDims);
+    ggml_tensor* createTensorFromCache(const WeightPlan& plan,
+                                       const QHash<QString, QByteArray>& cache);
+    bool prepareGraph(GraphCache& graph, int nTokens, int nKV, bool allLogits = false);
+    void buildGraph(GraphCache& graph);
+    void releaseGraph(GraphCache& graph);
     int sampleToken(const std::vector<float>& logits, float temperature);
-    void initKVCache();
+    bool initKVCache();
+    void applyPrefixCacheBudget();
     void freeContext();
 };
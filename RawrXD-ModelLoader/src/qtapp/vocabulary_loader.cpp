@@ -7,6 +7,7 @@
 #include <QDir>
 #include <QDebug>
 #include <QDataStream>
+#include "gguf_parser.h"
 
 VocabularyLoader::VocabularyLoader() {
 }
@@ -31,113 +32,75 @@ bool VocabularyLoader::loadFromGGUF(const QString& ggufPath) {
 }
 
 bool VocabularyLoader::loadGGUFMetadata(QFile& file) {
-    QDataStream stream(&file);
-    stream.setByteOrder(QDataStream::LittleEndian);
-    
-    // Read GGUF header
-    char magic[4];
-    stream.readRawData(magic, 4);
-    if (memcmp(magic, "GGUF", 4) != 0) {
-        qWarning() << "Invalid GGUF magic";
+    // Parse straight out of a read-only mapping: token strings are decoded
+    // from the file bytes once, into m_tokens, with no intermediate copies
+    uchar* base = file.map(0, file.size());
+    if (!base) {
+        qWarning() << "Failed to map GGUF file:" << file.errorString();
         return false;
     }
     
-    quint32 version;
-    quint64 tensorCount, kvCount;
-    stream >> version >> tensorCount >> kvCount;
-    
-    qDebug() << "GGUF version:" << version << "kv_count:" << kvCount;
-    
-    // Read key-value metadata
-    QHash<QString, QByteArray> metadata;
-    
-    for (quint64 i = 0; i < kvCount; ++i) {
-        // Read key
-        quint64 keyLen;
-        stream >> keyLen;
-        QByteArray keyBytes(keyLen, Qt::Uninitialized);
-        stream.readRawData(keyBytes.data(), keyLen);
-        QString key = QString::fromUtf8(keyBytes);
-        
-        // Read value type
-        quint32 valueType;
-        stream >> valueType;
-        
-        QByteArray value;
-        
-        // Type 8 = string, 9 = array
-        if (valueType == 8) {
-            quint64 strLen;
-            stream >> strLen;
-            value.resize(strLen);
-            stream.readRawData(value.data(), strLen);
-        } else if (valueType == 9) {
-            // Array - read element type and count
-            quint32 elemType;
-            quint64 arrayLen;
-            stream >> elemType >> arrayLen;
-            
-            // For string arrays (common for tokens)
-            if (elemType == 8) {
-                for (quint64 j = 0; j < arrayLen; ++j) {
-                    quint64 strLen;
-                    stream >> strLen;
-                    QByteArray str(strLen, Qt::Uninitialized);
-                    stream.readRawData(str.data(), strLen);
-                    value.append(str);
-                    value.append('\0');  // Delimiter
-                }
-            }
-        } else {
-            // Skip other types
-            stream.skipRawData(16);  // Approximate
-        }
-        
-        metadata[key] = value;
+    gguf::Parser parser;
+    if (parser.Parse(base, size_t(file.size())) != gguf::Parser::Status::Ok) {
+        qWarning() << "Invalid GGUF header:" << QString::fromStdString(parser.Error());
+        file.unmap(base);
+        return false;
     }
+    qDebug() << "GGUF version:" << parser.Version() << "kv_count:" << parser.KVCount();
+    
+    m_tokens.clear();
+    m_textToId.clear();
+    m_idToIndex.clear();
     
     // Extract tokens from metadata
-    if (metadata.contains("tokenizer.ggml.tokens")) {
-        QByteArray tokensData = metadata["tokenizer.ggml.tokens"];
-        QList<QByteArray> tokenList = tokensData.split('\0');
+    if (const gguf::Value* tokens = parser.Find("tokenizer.ggml.tokens")) {
+        const int count = int(tokens->ArraySize());
+        m_tokens.reserve(count);
+        m_textToId.reserve(count);
+        m_idToIndex.reserve(count);
         
-        m_tokens.reserve(tokenList.size());
+        const gguf::Value* scores = parser.Find("tokenizer.ggml.scores");
+        const gguf::Value* types = parser.Find("tokenizer.ggml.token_type");
+        const bool hasScores = scores && scores->IsScalarArray() && int(scores->ArraySize()) == count;
+        const bool hasTypes = types && types->IsScalarArray() && int(types->ArraySize()) == count;
         
-        for (int i = 0; i < tokenList.size(); ++i) {
-            if (tokenList[i].isEmpty()) continue;
-            
+        int32_t id = 0;
+        for (std::string_view text : tokens->Strings()) {
             Token token;
-            token.text = QString::fromUtf8(tokenList[i]);
-            token.id = i;
-            token.score = 0.0f;
-            token.isSpecial = false;
+            token.text = QString::fromUtf8(text.data(), qsizetype(text.size()));
+            token.id = id;
+            token.score = hasScores ? float(scores->ArrayDouble(id)) : 0.0f;
+            // llama.cpp token types: 3 = control, 4 = user defined
+            const int64_t type = hasTypes ? types->ArrayInt(id) : 1;
+            token.isSpecial = type == 3 || type == 4;
             
             m_tokens.append(token);
-            m_textToId[token.text] = token.id;
-            m_idToIndex[token.id] = m_tokens.size() - 1;
+            m_textToId.insert(token.text, token.id);
+            m_idToIndex.insert(token.id, m_tokens.size() - 1);
+            ++id;
         }
     }
     
-    // Load scores if available
-    if (metadata.contains("tokenizer.ggml.scores")) {
-        QByteArray scoresData = metadata["tokenizer.ggml.scores"];
-        QDataStream scoreStream(scoresData);
-        scoreStream.setByteOrder(QDataStream::LittleEndian);
-        
-        for (int i = 0; i < qMin(m_tokens.size(), scoresData.size() / 4); ++i) {
-            float score;
-            scoreStream >> score;
-            if (i < m_tokens.size()) {
-                m_tokens[i].score = score;
-            }
-        }
-    }
+    // Special token ids recorded by the converter take precedence over name matching
+    m_special.bos = int32_t(parser.GetInt("tokenizer.ggml.bos_token_id", m_special.bos));
+    m_special.eos = int32_t(parser.GetInt("tokenizer.ggml.eos_token_id", m_special.eos));
+    m_special.unk = int32_t(parser.GetInt("tokenizer.ggml.unknown_token_id", m_special.unk));
+    m_special.pad = int32_t(parser.GetInt("tokenizer.ggml.padding_token_id", m_special.pad));
+    
+    // tokenizer.ggml.model names the tokenizer family outright
+    const std::string_view model = parser.GetString("tokenizer.ggml.model");
+    m_declaredType = model == "gpt2" ? BPE
+                   : model == "llama" ? SENTENCEPIECE
+                   : model == "bert" ? WORDPIECE
+                   : UNKNOWN;
     
     // Get model name
-    if (metadata.contains("general.name")) {
-        m_modelName = QString::fromUtf8(metadata["general.name"]);
+    const std::string_view name = parser.GetString("general.name");
+    if (!name.empty()) {
+        m_modelName = QString::fromUtf8(name.data(), qsizetype(name.size()));
     }
     
+    file.unmap(base);
     m_vocabSize = m_tokens.size();
     return !m_tokens.isEmpty();
 }
@@ -278,6 +241,7 @@ bool VocabularyLoader::loadFromText(const QString& txtPath) {
 
 VocabularyLoader::TokenizerType VocabularyLoader::detectType() {
     if (m_tokens.isEmpty()) return UNKNOWN;
+    if (m_declaredType != UNKNOWN) return m_declaredType;
     
     // Check for SentencePiece markers (▁ character)
     int spaceMarkers = 0;
@@ -344,7 +308,7 @@ void VocabularyLoader::detectSpecialTokens() {
     for (const Token& token : m_tokens) {
         for (auto it = specialPatterns.begin(); it != specialPatterns.end(); ++it) {
             if (token.text == it.key()) {
-                *(it.value()) = token.id;
+                if (*(it.value()) < 0) *(it.value()) = token.id;  // Keep ids declared in metadata
                 const_cast<Token&>(token).isSpecial = true;
             }
         }
@@ -127,6 +127,7 @@ private:
     
     SpecialTokens m_special;
     TokenizerType m_type{UNKNOWN};
+    TokenizerType m_declaredType{UNKNOWN};  // From tokenizer.ggml.model, if present
     
     // Metadata
     QString m_modelName;
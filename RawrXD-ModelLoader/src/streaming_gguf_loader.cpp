@@ -5,7 +5,8 @@
 #include <iostream>
 
 StreamingGGUFLoader::StreamingGGUFLoader()
-    : is_open_(false), current_zone_memory_(0), max_zone_memory_mb_(512) {
+    : is_open_(false), current_zone_memory_(0), resident_bytes_(0),
+      max_zone_memory_mb_(512), auto_prefetch_(true), stop_prefetch_(false) {
     std::memset(&header_, 0, sizeof(GGUFHeader));
 }
 
@@ -44,6 +45,15 @@ bool StreamingGGUFLoader::Open(const std::string& filepath) {
     // Assign tensors to zones
     AssignTensorsToZones();
     
+    // Background prefetch gets its own handle so it never moves file_'s cursor
+    prefetch_file_.open(filepath, std::ios::binary);
+    if (prefetch_file_.is_open()) {
+        stop_prefetch_ = false;
+        prefetch_thread_ = std::thread(&StreamingGGUFLoader::PrefetchLoop, this);
+    } else {
+        std::cerr << "⚠️ Prefetch disabled: could not reopen " << filepath << std::endl;
+    }
+    
     std::cout << "✅ GGUF Model opened in streaming mode" << std::endl;
     std::cout << "   File: " << filepath << std::endl;
     std::cout << "   Tensors: " << tensor_index_.size() << std::endl;
@@ -54,44 +64,60 @@ bool StreamingGGUFLoader::Open(const std::string& filepath) {
 }
 
 bool StreamingGGUFLoader::Close() {
+    StopPrefetchThread();
+    if (prefetch_file_.is_open()) {
+        prefetch_file_.close();
+    }
     if (file_.is_open()) {
         file_.close();
     }
     is_open_ = false;
+    parser_ = gguf::Parser();
+    tensor_lookup_.clear();
     tensor_index_.clear();
     zones_.clear();
-    active_zones_.clear();
+    lru_.clear();
+    prefetch_queue_.clear();
+    inflight_.clear();
+    prefetched_unused_.clear();
     current_zone_ = "";
+    current_zone_memory_ = 0;
+    resident_bytes_ = 0;
+    stats_ = {};
     return true;
 }
 
+void StreamingGGUFLoader::StopPrefetchThread() {
+    if (!prefetch_thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(zone_mutex_);
+        stop_prefetch_ = true;
+    }
+    prefetch_cv_.notify_all();
+    prefetch_thread_.join();
+}
+
 bool StreamingGGUFLoader::ParseHeader() {
     if (!file_.is_open()) return false;
     
-    file_.seekg(0);
-    
-    // Read magic
-    if (!ReadValue(header_.magic)) return false;
-    if (header_.magic != 0x46554747) {  // "GGUF"
-        std::cerr << "❌ Invalid GGUF magic: 0x" << std::hex << header_.magic << std::endl;
-        return false;
-    }
-    
-    // Read version
-    if (!ReadValue(header_.version)) return false;
-    if (header_.version != 3) {
-        std::cerr << "❌ Unsupported GGUF version: " << header_.version << std::endl;
+    // Header, metadata and tensor table are parsed in one pass from a prefix
+    // of the file (shared parser, see gguf_parser.h)
+    const gguf::Parser::Status status = parser_.ParseFrom([this](uint64_t offset, void* dst, size_t n) -> size_t {
+        file_.clear();
+        file_.seekg(static_cast<std::streamoff>(offset));
+        file_.read(static_cast<char*>(dst), static_cast<std::streamsize>(n));
+        return static_cast<size_t>(file_.gcount());
+    }, GetTotalFileSize());
+    if (status != gguf::Parser::Status::Ok) {
+        std::cerr << "❌ Failed to parse GGUF header: " << parser_.Error() << std::endl;
         return false;
     }
     
-    // Read tensor count
-    if (!ReadValue(header_.tensor_count)) return false;
-    
-    // Read metadata KV count
-    if (!ReadValue(header_.metadata_kv_count)) return false;
-    
-    // Calculate metadata offset
-    header_.metadata_offset = file_.tellg();
+    header_.magic = gguf::Parser::kMagic;
+    header_.version = parser_.Version();
+    header_.tensor_count = parser_.TensorCount();
+    header_.metadata_kv_count = parser_.KVCount();
+    header_.metadata_offset = 24;  // magic + version + two u64 counts
     
     return true;
 }
@@ -101,61 +127,11 @@ GGUFHeader StreamingGGUFLoader::GetHeader() const {
 }
 
 bool StreamingGGUFLoader::ParseMetadata() {
-    if (!file_.is_open() || header_.metadata_kv_count == 0) {
+    if (!file_.is_open()) {
         return false;
     }
     
-    file_.seekg(header_.metadata_offset);
-    
-    for (uint64_t i = 0; i < header_.metadata_kv_count; ++i) {
-        std::string key, value;
-        
-        if (!ReadString(key)) {
-            std::cerr << "❌ Failed to read metadata key at index " << i << std::endl;
-            return false;
-        }
-        
-        uint32_t value_type;
-        if (!ReadValue(value_type)) {
-            std::cerr << "❌ Failed to read metadata value type for key: " << key << std::endl;
-            return false;
-        }
-        
-        // Value type 1 = UTF-8 string
-        if (value_type == 1) {
-            if (!ReadString(value)) {
-                std::cerr << "❌ Failed to read metadata string value for key: " << key << std::endl;
-                return false;
-            }
-            metadata_.kv_pairs[key] = value;
-            
-            // Parse important metadata
-            if (key == "general.architecture") {
-                if (value == "llama") metadata_.architecture_type = 1;
-            } else if (key == "llama.block_count") {
-                metadata_.layer_count = std::stoul(value);
-            } else if (key == "llama.context_length") {
-                metadata_.context_length = std::stoul(value);
-            } else if (key == "llama.embedding_length") {
-                metadata_.embedding_dim = std::stoul(value);
-            } else if (key == "llama.vocab_size") {
-                metadata_.vocab_size = std::stoul(value);
-            }
-        } else if (value_type == 4) {  // uint32
-            uint32_t uint_val;
-            if (!ReadValue(uint_val)) return false;
-            metadata_.kv_pairs[key] = std::to_string(uint_val);
-        } else if (value_type == 5) {  // int32
-            int32_t int_val;
-            if (!ReadValue(int_val)) return false;
-            metadata_.kv_pairs[key] = std::to_string(int_val);
-        } else if (value_type == 6) {  // float32
-            float float_val;
-            if (!ReadValue(float_val)) return false;
-            metadata_.kv_pairs[key] = std::to_string(float_val);
-        }
-    }
-    
+    GGUFLoader::FillMetadata(parser_, metadata_);
     return true;
 }
 
@@ -168,70 +144,53 @@ bool StreamingGGUFLoader::BuildTensorIndex() {
         return false;
     }
     
-    // Skip metadata to get to tensor info
-    file_.seekg(header_.metadata_offset);
-    
-    // Skip metadata entries
-    for (uint64_t i = 0; i < header_.metadata_kv_count; ++i) {
-        std::string key, value;
-        if (!ReadString(key)) return false;
-        
-        uint32_t value_type;
-        if (!ReadValue(value_type)) return false;
-        
-        if (value_type == 1) {
-            if (!ReadString(value)) return false;
-        } else if (value_type == 4 || value_type == 5 || value_type == 6) {
-            uint32_t dummy;
-            if (!ReadValue(dummy)) return false;
-        }
-    }
-    
-    // Now read tensor info (no data!)
-    for (uint64_t i = 0; i < header_.tensor_count; ++i) {
+    // Tensor info comes from the parsed table (no data!); offsets are absolute
+    tensor_lookup_.clear();
+    tensor_index_.clear();
+    tensor_index_.reserve(parser_.Tensors().size());
+    for (const gguf::TensorDesc& desc : parser_.Tensors()) {
         TensorRef ref;
+        ref.name.assign(desc.name);
+        ref.shape.assign(desc.ne, desc.ne + desc.n_dims);
+        ref.type = static_cast<GGMLType>(desc.type);
+        ref.offset = desc.offset;
+        ref.size = desc.size_bytes;
+        ref.zone_name = "";  // Will be assigned later
         
-        if (!ReadString(ref.name)) {
-            std::cerr << "❌ Failed to read tensor name at index " << i << std::endl;
+        if (ref.size == 0 && desc.ElementCount() != 0) {
+            std::cerr << "❌ Unsupported tensor type " << desc.type << " for " << ref.name << std::endl;
             return false;
         }
         
-        uint32_t n_dims;
-        if (!ReadValue(n_dims)) return false;
-        
-        ref.shape.resize(n_dims);
-        for (uint32_t d = 0; d < n_dims; ++d) {
-            if (!ReadValue(ref.shape[d])) return false;
-        }
-        
-        uint32_t type_val;
-        if (!ReadValue(type_val)) return false;
-        ref.type = static_cast<GGMLType>(type_val);
-        
-        if (!ReadValue(ref.offset)) return false;
-        
-        ref.size = CalculateTensorSize(ref.shape, ref.type);
-        ref.zone_name = "";  // Will be assigned later
-        
-        tensor_index_[ref.name] = ref;
+        tensor_index_.push_back(std::move(ref));
+    }
+    
+    // File order makes every zone a forward sweep of the file
+    std::stable_sort(tensor_index_.begin(), tensor_index_.end(),
+                     [](const TensorRef& a, const TensorRef& b) { return a.offset < b.offset; });
+    tensor_lookup_.reserve(tensor_index_.size());
+    for (uint32_t i = 0; i < tensor_index_.size(); ++i) {
+        tensor_lookup_.emplace(tensor_index_[i].name, i);
     }
     
     return true;
 }
 
 std::vector<TensorRef> StreamingGGUFLoader::GetTensorIndex() const {
-    std::vector<TensorRef> result;
-    for (const auto& [name, ref] : tensor_index_) {
-        result.push_back(ref);
-    }
-    return result;
+    return tensor_index_;
+}
+
+const TensorRef* StreamingGGUFLoader::FindTensor(const std::string& tensor_name) const {
+    auto it = tensor_lookup_.find(tensor_name);
+    return it == tensor_lookup_.end() ? nullptr : &tensor_index_[it->second];
 }
 
 void StreamingGGUFLoader::AssignTensorsToZones() {
     // Zone assignment strategy (like a game engine):
     // Group tensors into zones (8 layers per zone)
     
-    for (auto& [tensor_name, tensor_ref] : tensor_index_) {
+    for (TensorRef& tensor_ref : tensor_index_) {
+        const std::string& tensor_name = tensor_ref.name;
         std::string zone;
         
         // Pattern matching to assign zones
@@ -258,9 +217,13 @@ void StreamingGGUFLoader::AssignTensorsToZones() {
         if (zones_.find(zone) == zones_.end()) {
             zones_[zone] = {zone, {}, 0, false, {}};
         }
-        zones_[zone].tensors.push_back(tensor_name);
-        zones_[zone].total_bytes += tensor_ref.size;
-        
+        // The index is in file order, so zones are too and each tensor's
+        // place in the zone buffer is the running total so far
+        TensorZoneInfo& zone_info = zones_[zone];
+        tensor_ref.zone_offset = zone_info.total_bytes;
+        zone_info.tensors.push_back(tensor_name);
+        zone_info.total_bytes += tensor_ref.size;
+    
         tensor_ref.zone_name = zone;
     }
     
@@ -290,11 +253,8 @@ int32_t StreamingGGUFLoader::ExtractLayerNumber(const std::string& tensor_name)
 }
 
 std::string StreamingGGUFLoader::GetZoneForTensor(const std::string& tensor_name) const {
-    auto it = tensor_index_.find(tensor_name);
-    if (it != tensor_index_.end()) {
-        return it->second.zone_name;
-    }
-    return "";
+    const TensorRef* ref = FindTensor(tensor_name);
+    return ref ? ref->zone_name : "";
 }
 
 std::string StreamingGGUFLoader::GetTensorZone(const std::string& tensor_name) const {
@@ -302,6 +262,12 @@ std::string StreamingGGUFLoader::GetTensorZone(const std::string& tensor_name) c
 }
 
 bool StreamingGGUFLoader::LoadZone(const std::string& zone_name, uint64_t max_memory_mb) {
+    std::unique_lock<std::mutex> lock(zone_mutex_);
+    
+    if (max_memory_mb != 0) {
+        max_zone_memory_mb_ = max_memory_mb;
+    }
+    
     auto zone_it = zones_.find(zone_name);
     if (zone_it == zones_.end()) {
         std::cerr << "❌ Zone not found: " << zone_name << std::endl;
@@ -310,128 +276,362 @@ bool StreamingGGUFLoader::LoadZone(const std::string& zone_name, uint64_t max_me
     
     TensorZoneInfo& zone = zone_it->second;
     
+    // A prefetch of this zone is already reading it; wait rather than read twice
+    if (inflight_.count(zone_name)) {
+        ++stats_.prefetch_waits;
+        zone_cv_.wait(lock, [&] { return inflight_.count(zone_name) == 0; });
+    }
+    
     // Already loaded?
     if (zone.is_loaded) {
-        std::cout << "✓ Zone already loaded: " << zone_name << std::endl;
+        ++stats_.hits;
+        if (prefetched_unused_.erase(zone_name)) {
+            ++stats_.prefetch_hits;
+        }
+        TouchZoneLocked(zone_name);
+        QueueNextZoneLocked(zone_name);
         return true;
     }
     
-    // Unload previous zone if needed
-    if (!current_zone_.empty() && current_zone_ != zone_name) {
-        UnloadZone(current_zone_);
-    }
-    
     // Check file is open
     if (!is_open_ || !file_.is_open()) {
         std::cerr << "❌ File not open for streaming" << std::endl;
         return false;
     }
     
-    // Stream from disk
-    zone.data.clear();
-    zone.data.reserve(zone.total_bytes);
-    
-    uint64_t total_loaded = 0;
+    // Miss: read on the calling thread. Start on the following zone first so
+    // its read overlaps with the compute on this one.
+    ++stats_.stalls;
+    inflight_.insert(zone_name);
+    QueueNextZoneLocked(zone_name);
+    lock.unlock();
     
     std::cout << "📥 Loading zone: " << zone_name << " (" << (zone.total_bytes / (1024.0*1024.0)) << " MB)..." << std::endl;
     
+    std::vector<uint8_t> data;
+    bool ok;
+    {
+        std::lock_guard<std::mutex> file_lock(file_mutex_);
+        ok = StreamZoneFromDisk(zone, file_, data);
+    }
+    
+    lock.lock();
+    inflight_.erase(zone_name);
+    if (ok) {
+        stats_.bytes_read += data.size();
+        InstallZone(zone_name, std::move(data), false);
+        std::cout << "✅ Zone loaded: " << zone_name << " (" << (current_zone_memory_ / (1024.0*1024.0)) << " MB)" << std::endl;
+    }
+    lock.unlock();
+    zone_cv_.notify_all();
+    
+    return ok;
+}
+
+bool StreamingGGUFLoader::StreamZoneFromDisk(const TensorZoneInfo& zone, std::ifstream& file, std::vector<uint8_t>& out) {
+    out.clear();
+    out.reserve(zone.total_bytes);
+    
     for (const auto& tensor_name : zone.tensors) {
         // Get tensor metadata from index
-        auto tensor_it = tensor_index_.find(tensor_name);
-        if (tensor_it == tensor_index_.end()) {
+        const TensorRef* ref = FindTensor(tensor_name);
+        if (!ref) {
             std::cerr << "❌ Tensor not in index: " << tensor_name << std::endl;
             return false;
         }
-        
-        const TensorRef& ref = tensor_it->second;
-        
-        // Seek to tensor offset in file
-        file_.seekg(ref.offset, std::ios::beg);
-        
-        // Read from disk into zone buffer
-        size_t old_size = zone.data.size();
-        zone.data.resize(old_size + ref.size);
-        
-        file_.read(reinterpret_cast<char*>(zone.data.data() + old_size), ref.size);
-        
-        if (!file_.good()) {
+    
+        // Tensors are sorted by offset, so this seek only skips alignment padding
+        file.clear();
+        file.seekg(ref->offset, std::ios::beg);
+    
+        size_t old_size = out.size();
+        out.resize(old_size + ref->size);
+    
+        file.read(reinterpret_cast<char*>(out.data() + old_size), ref->size);
+    
+        if (!file.good()) {
             std::cerr << "❌ Failed to read tensor: " << tensor_name << std::endl;
-            zone.data.resize(old_size);
+            out.clear();
             return false;
         }
-        
-        total_loaded += ref.size;
     }
     
+    return true;
+}
+
+bool StreamingGGUFLoader::InstallZone(const std::string& zone_name, std::vector<uint8_t>&& data, bool speculative) {
+    TensorZoneInfo& zone = zones_.at(zone_name);
+    const uint64_t budget = max_zone_memory_mb_ * 1024 * 1024;
+    const uint64_t size = data.size();
+    
+    if (speculative) {
+        // Only evict unpinned zones older than the one being computed on
+        uint64_t reclaimable = 0;
+        for (auto it = std::next(lru_.begin(), lru_.empty() ? 0 : 1); it != lru_.end(); ++it) {
+            const TensorZoneInfo& other = zones_.at(*it);
+            if (other.pin_count == 0) reclaimable += other.data.size();
+        }
+        if (resident_bytes_ - reclaimable + size > budget) {
+            ++stats_.dropped_prefetches;
+            return false;
+        }
+    }
+    
+    while (resident_bytes_ + size > budget) {
+        const std::string* victim = EvictionCandidateLocked(speculative ? 1 : 0);
+        if (!victim) break;
+        EvictZoneLocked(*victim);
+        ++stats_.evictions;
+    }
+    if (resident_bytes_ + size > budget) {
+        std::cerr << "⚠️ Zone " << zone_name << " (" << (size / (1024*1024))
+                  << " MB) exceeds the memory budget of " << max_zone_memory_mb_ << " MB" << std::endl;
+    }
+    
+    zone.data = std::move(data);
     zone.is_loaded = true;
+    resident_bytes_ += size;
+    
+    if (speculative) {
+        // Resident but not yet used: rank just behind the current zone
+        lru_.insert(std::next(lru_.begin(), lru_.empty() ? 0 : 1), zone_name);
+        prefetched_unused_.insert(zone_name);
+    } else {
+        lru_.push_front(zone_name);
+        current_zone_ = zone_name;
+        current_zone_memory_ = size;
+    }
+    stats_.resident_bytes = resident_bytes_;
+    return true;
+}
+
+void StreamingGGUFLoader::EvictZoneLocked(std::string zone_name) {
+    TensorZoneInfo& zone = zones_.at(zone_name);
+    if (!zone.is_loaded) return;
+    
+    resident_bytes_ -= zone.data.size();
+    zone.data.clear();
+    zone.data.shrink_to_fit();
+    zone.is_loaded = false;
+    lru_.remove(zone_name);
+    prefetched_unused_.erase(zone_name);
+    if (current_zone_ == zone_name) {
+        current_zone_.clear();
+        current_zone_memory_ = 0;
+    }
+    stats_.resident_bytes = resident_bytes_;
+    std::cout << "📤 Zone unloaded: " << zone_name << std::endl;
+}
+
+const std::string* StreamingGGUFLoader::EvictionCandidateLocked(size_t keep) const {
+    size_t position = lru_.size();
+    for (auto it = lru_.rbegin(); it != lru_.rend() && position > keep; ++it, --position) {
+        if (zones_.at(*it).pin_count == 0) return &*it;
+    }
+    return nullptr;
+}
+
+void StreamingGGUFLoader::TouchZoneLocked(const std::string& zone_name) {
+    auto it = std::find(lru_.begin(), lru_.end(), zone_name);
+    if (it != lru_.end()) {
+        lru_.splice(lru_.begin(), lru_, it);
+    }
     current_zone_ = zone_name;
-    current_zone_memory_ = total_loaded;
+    current_zone_memory_ = zones_.at(zone_name).data.size();
+}
+
+void StreamingGGUFLoader::QueueNextZoneLocked(const std::string& zone_name) {
+    if (!auto_prefetch_ || !prefetch_thread_.joinable()) return;
     
-    std::cout << "✅ Zone loaded: " << zone_name << " (" << (total_loaded / (1024.0*1024.0)) << " MB)" << std::endl;
+    // Forward-pass order: embedding → layers_0 … layers_N → output_head
+    std::string next;
+    if (zone_name == "embedding") {
+        next = "layers_0";
+    } else if (zone_name.rfind("layers_", 0) == 0) {
+        next = "layers_" + std::to_string(std::stoi(zone_name.substr(7)) + 1);
+        if (zones_.find(next) == zones_.end()) {
+            next = "output_head";
+        }
+    }
     
-    return true;
+    auto it = zones_.find(next);
+    if (it == zones_.end() || it->second.is_loaded || inflight_.count(next) ||
+        std::find(prefetch_queue_.begin(), prefetch_queue_.end(), next) != prefetch_queue_.end()) {
+        return;
+    }
+    prefetch_queue_.push_back(next);
+    prefetch_cv_.notify_one();
+}
+
+void StreamingGGUFLoader::PrefetchZone(const std::string& zone_name) {
+    std::lock_guard<std::mutex> lock(zone_mutex_);
+    auto it = zones_.find(zone_name);
+    if (!prefetch_thread_.joinable() || it == zones_.end() || it->second.is_loaded ||
+        inflight_.count(zone_name) ||
+        std::find(prefetch_queue_.begin(), prefetch_queue_.end(), zone_name) != prefetch_queue_.end()) {
+        return;
+    }
+    prefetch_queue_.push_back(zone_name);
+    prefetch_cv_.notify_one();
+}
+
+void StreamingGGUFLoader::PrefetchLoop() {
+    std::unique_lock<std::mutex> lock(zone_mutex_);
+    for (;;) {
+        prefetch_cv_.wait(lock, [this] { return stop_prefetch_ || !prefetch_queue_.empty(); });
+        if (stop_prefetch_) return;
+    
+        std::string zone_name = std::move(prefetch_queue_.front());
+        prefetch_queue_.pop_front();
+    
+        const TensorZoneInfo& zone = zones_.at(zone_name);
+        if (zone.is_loaded || inflight_.count(zone_name)) continue;
+        if (zone.total_bytes > max_zone_memory_mb_ * 1024 * 1024) {
+            ++stats_.dropped_prefetches;
+            continue;
+        }
+    
+        inflight_.insert(zone_name);
+        lock.unlock();
+    
+        std::vector<uint8_t> data;
+        const bool ok = StreamZoneFromDisk(zone, prefetch_file_, data);
+    
+        lock.lock();
+        inflight_.erase(zone_name);
+        if (ok) {
+            stats_.bytes_read += data.size();
+            if (InstallZone(zone_name, std::move(data), true)) {
+                ++stats_.prefetched_zones;
+            }
+        }
+        zone_cv_.notify_all();
+    }
+}
+
+void StreamingGGUFLoader::SetMemoryBudgetMB(uint64_t max_memory_mb) {
+    std::lock_guard<std::mutex> lock(zone_mutex_);
+    max_zone_memory_mb_ = max_memory_mb;
+    
+    // Shrink immediately, keeping the most recently used zone
+    const uint64_t budget = max_zone_memory_mb_ * 1024 * 1024;
+    while (resident_bytes_ > budget) {
+        const std::string* victim = EvictionCandidateLocked(1);
+        if (!victim) break;
+        EvictZoneLocked(*victim);
+        ++stats_.evictions;
+    }
+}
+
+uint64_t StreamingGGUFLoader::GetMemoryBudgetMB() const {
+    std::lock_guard<std::mutex> lock(zone_mutex_);
+    return max_zone_memory_mb_;
+}
+
+ZoneStreamStats StreamingGGUFLoader::GetStreamStats() const {
+    std::lock_guard<std::mutex> lock(zone_mutex_);
+    return stats_;
 }
 
 bool StreamingGGUFLoader::UnloadZone(const std::string& zone_name) {
+    std::unique_lock<std::mutex> lock(zone_mutex_);
     auto zone_it = zones_.find(zone_name);
     if (zone_it == zones_.end()) {
         return false;
     }
     
-    TensorZoneInfo& zone = zone_it->second;
+    // Let an in-flight read land first so it is not resurrected afterwards
+    zone_cv_.wait(lock, [&] { return inflight_.count(zone_name) == 0; });
+    prefetch_queue_.erase(std::remove(prefetch_queue_.begin(), prefetch_queue_.end(), zone_name),
+                          prefetch_queue_.end());
     
-    if (zone.is_loaded) {
-        zone.data.clear();
-        zone.data.shrink_to_fit();
-        zone.is_loaded = false;
-        std::cout << "📤 Zone unloaded: " << zone_name << std::endl;
+    if (zone_it->second.pin_count != 0) {
+        std::cerr << "⚠️ Zone " << zone_name << " is pinned by " << zone_it->second.pin_count
+                  << " tensor view(s); not unloading" << std::endl;
+        return false;
+    }
+    if (zone_it->second.is_loaded) {
+        EvictZoneLocked(zone_name);
     }
     
     return true;
 }
 
 bool StreamingGGUFLoader::GetTensorData(const std::string& tensor_name, std::vector<uint8_t>& data) {
-    // Find which zone this tensor belongs to
-    std::string zone_name = GetTensorZone(tensor_name);
-    if (zone_name.empty()) {
-        std::cerr << "❌ Tensor not found: " << tensor_name << std::endl;
+    TensorView view = GetTensorView(tensor_name);
+    if (!view) {
         return false;
     }
     
-    // Load zone if not already loaded
-    if (!zones_[zone_name].is_loaded) {
-        if (!LoadZone(zone_name)) {
-            return false;
-        }
-    }
-    
-    // Find tensor in zone
-    TensorZoneInfo& zone = zones_[zone_name];
-    
-    auto tensor_it = tensor_index_.find(tensor_name);
-    if (tensor_it == tensor_index_.end()) {
-        return false;
+    // Copy tensor data
+    data.assign(view.data(), view.data() + view.size());
+    return true;
+}
+
+TensorView StreamingGGUFLoader::GetTensorView(const std::string& tensor_name) {
+    const TensorRef* ref = FindTensor(tensor_name);
+    if (!ref) {
+        std::cerr << "❌ Tensor not found: " << tensor_name << std::endl;
+        return {};
     }
     
-    const TensorRef& ref = tensor_it->second;
-    
-    // Find offset within zone data
-    uint64_t offset_in_zone = 0;
-    for (const auto& other_name : zone.tensors) {
-        if (other_name == tensor_name) {
-            break;
+    // Another thread may evict the zone between LoadZone and the pin; retry
+    for (;;) {
+        // Load zone if not already loaded (0 keeps the configured budget)
+        if (!LoadZone(ref->zone_name, 0)) {
+            return {};
+        }
+        
+        std::lock_guard<std::mutex> lock(zone_mutex_);
+        TensorZoneInfo& zone = zones_.at(ref->zone_name);
+        if (!zone.is_loaded) {
+            continue;
         }
-        offset_in_zone += tensor_index_[other_name].size;
+        
+        ++zone.pin_count;
+        TensorView view;
+        view.loader_ = this;
+        view.zone_ = &zone;
+        view.data_ = zone.data.data() + ref->zone_offset;
+        view.size_ = ref->size;
+        return view;
     }
-    
-    // Copy tensor data
-    data.resize(ref.size);
-    std::memcpy(data.data(), zone.data.data() + offset_in_zone, ref.size);
-    
-    return true;
+}
+
+void StreamingGGUFLoader::UnpinZone(TensorZoneInfo* zone) {
+    std::lock_guard<std::mutex> lock(zone_mutex_);
+    if (zone->pin_count > 0) {
+        --zone->pin_count;
+    }
+}
+
+TensorView& TensorView::operator=(TensorView&& other) noexcept {
+    if (this != &other) {
+        Release();
+        loader_ = other.loader_;
+        zone_ = other.zone_;
+        data_ = other.data_;
+        size_ = other.size_;
+        other.loader_ = nullptr;
+        other.zone_ = nullptr;
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+void TensorView::Release() {
+    if (loader_ && zone_) {
+        loader_->UnpinZone(zone_);
+    }
+    loader_ = nullptr;
+    zone_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
 }
 
 TensorZoneInfo StreamingGGUFLoader::GetZoneInfo(const std::string& zone_name) const {
+    std::lock_guard<std::mutex> lock(zone_mutex_);
     auto it = zones_.find(zone_name);
     if (it != zones_.end()) {
         return it->second;
@@ -442,6 +642,7 @@ TensorZoneInfo StreamingGGUFLoader::GetZoneInfo(const std::string& zone_name) co
 uint64_t StreamingGGUFLoader::GetTotalFileSize() const {
     if (!file_.is_open()) return 0;
     
+    std::lock_guard<std::mutex> file_lock(file_mutex_);
     std::streampos current = file_.tellg();
     file_.seekg(0, std::ios::end);
     uint64_t size = file_.tellg();
@@ -455,17 +656,15 @@ uint64_t StreamingGGUFLoader::GetCurrentMemoryUsage() const {
     // Header + metadata + index
     usage += 100 * 1024 * 1024;  // ~100 MB for overhead
     
-    // Active zones
-    for (const auto& [zone_name, zone_info] : zones_) {
-        if (zone_info.is_loaded) {
-            usage += zone_info.data.size();
-        }
-    }
+    // Resident zones
+    std::lock_guard<std::mutex> lock(zone_mutex_);
+    usage += resident_bytes_;
     
     return usage;
 }
 
 std::vector<std::string> StreamingGGUFLoader::GetLoadedZones() const {
+    std::lock_guard<std::mutex> lock(zone_mutex_);
     std::vector<std::string> result;
     for (const auto& [zone_name, zone_info] : zones_) {
         if (zone_info.is_loaded) {
@@ -485,9 +684,10 @@ std::vector<std::string> StreamingGGUFLoader::GetAllZones() const {
 
 std::vector<TensorInfo> StreamingGGUFLoader::GetAllTensorInfo() const {
     std::vector<TensorInfo> result;
-    for (const auto& [name, ref] : tensor_index_) {
+    result.reserve(tensor_index_.size());
+    for (const TensorRef& ref : tensor_index_) {
         TensorInfo info;
-        info.name = name;
+        info.name = ref.name;
         info.shape = ref.shape;
         info.type = ref.type;
         info.offset = ref.offset;
@@ -509,34 +709,25 @@ std::string StreamingGGUFLoader::GetTypeString(GGMLType type) const {
     switch (type) {
         case GGMLType::F32: return "F32 (float32)";
         case GGMLType::F16: return "F16 (float16)";
+        case GGMLType::BF16: return "BF16 (bfloat16)";
         case GGMLType::Q4_0: return "Q4_0 (quantized 4-bit, zero point)";
         case GGMLType::Q4_1: return "Q4_1 (quantized 4-bit with delta)";
+        case GGMLType::Q5_0: return "Q5_0 (quantized 5-bit, zero point)";
+        case GGMLType::Q5_1: return "Q5_1 (quantized 5-bit with delta)";
         case GGMLType::Q2_K: return "Q2_K (gguf2 quantized 2-bit)";
         case GGMLType::Q3_K: return "Q3_K (gguf2 quantized 3-bit)";
         case GGMLType::Q4_K: return "Q4_K (gguf2 quantized 4-bit)";
         case GGMLType::Q5_K: return "Q5_K (gguf2 quantized 5-bit)";
         case GGMLType::Q6_K: return "Q6_K (gguf2 quantized 6-bit)";
         case GGMLType::Q8_0: return "Q8_0 (quantized 8-bit, zero point)";
+        case GGMLType::Q8_K: return "Q8_K (gguf2 quantized 8-bit)";
         default: return "Unknown";
     }
 }
 
 // ============================================================================
-// PRIVATE TEMPLATE FUNCTIONS
-template<typename T>
-bool StreamingGGUFLoader::ReadValue(T& value) {
-    file_.read(reinterpret_cast<char*>(&value), sizeof(T));
-    return file_.good();
-}
-
-bool StreamingGGUFLoader::ReadString(std::string& value) {
-    uint64_t len;
-    if (!ReadValue(len)) return false;
-    
-    value.resize(len);
-    file_.read(&value[0], len);
-    return file_.good();
-}
+// PRIVATE HELPERS
+// ============================================================================
 
 uint64_t StreamingGGUFLoader::CalculateTensorSize(const std::vector<uint64_t>& shape, GGMLType type) const {
     uint64_t num_elements = 1;
@@ -544,21 +735,8 @@ uint64_t StreamingGGUFLoader::CalculateTensorSize(const std::vector<uint64_t>& s
         num_elements *= dim;
     }
     
-    float bytes_per_element = 4.0f;  // Default F32
-    switch (type) {
-        case GGMLType::F32: bytes_per_element = 4.0f; break;
-        case GGMLType::F16: bytes_per_element = 2.0f; break;
-        case GGMLType::Q4_0:
-        case GGMLType::Q4_1: bytes_per_element = 0.5f; break;
-        case GGMLType::Q2_K: bytes_per_element = 0.3125f; break;
-        case GGMLType::Q3_K: bytes_per_element = 0.4375f; break;
-        case GGMLType::Q4_K: bytes_per_element = 0.5f; break;
-        case GGMLType::Q5_K: bytes_per_element = 0.625f; break;
-        case GGMLType::Q6_K: bytes_per_element = 0.75f; break;
-        case GGMLType::Q8_0: bytes_per_element = 1.0f; break;
-    }
-    
-    return static_cast<uint64_t>(num_elements * bytes_per_element);
+    // Exact block-aligned size from the shared ggml block table
+    return gguf::TensorBytes(static_cast<uint32_t>(type), num_elements);
 }
 
 // ============================================================================
@@ -574,28 +752,19 @@ bool StreamingGGUFLoader::LoadTensorRange(size_t start_idx, size_t count, std::v
     // Get all tensors and load the requested range
     data.clear();
     
-    std::vector<std::string> tensor_names;
-    for (const auto& [name, ref] : tensor_index_) {
-        tensor_names.push_back(name);
-    }
-    
-    // Sort by offset to get consistent ordering
-    std::sort(tensor_names.begin(), tensor_names.end(), [this](const std::string& a, const std::string& b) {
-        return tensor_index_.at(a).offset < tensor_index_.at(b).offset;
-    });
-    
-    if (start_idx >= tensor_names.size()) {
+    // The index is already in file offset order
+    if (start_idx >= tensor_index_.size()) {
         return false;
     }
     
-    size_t end_idx = std::min(start_idx + count, tensor_names.size());
+    size_t end_idx = std::min(start_idx + count, tensor_index_.size());
     
     for (size_t i = start_idx; i < end_idx; ++i) {
-        std::vector<uint8_t> tensor_data;
-        if (!GetTensorData(tensor_names[i], tensor_data)) {
+        TensorView view = GetTensorView(tensor_index_[i].name);
+        if (!view) {
             return false;
         }
-        data.insert(data.end(), tensor_data.begin(), tensor_data.end());
+        data.insert(data.end(), view.data(), view.data() + view.size());
     }
     
     return true;
@@ -1,6 +1,5 @@
 #include "telemetry/ai_metrics.h"
 #include <algorithm>
-#include <numeric>
 #include <sstream>
 #include <iomanip>
 #include <fstream>
@@ -21,28 +20,19 @@ void AIMetricsCollector::recordOllamaRequest(const std::string& model,
                                             bool success, 
                                             uint64_t prompt_tokens,
                                             uint64_t completion_tokens) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
-    m_total_requests++;
+    // Session-wide numbers never wait on the mutex
+    m_latency.record(latency_ms);
+    m_last_latency_ms.store(latency_ms, std::memory_order_relaxed);
+    m_prompt_tokens.fetch_add(prompt_tokens, std::memory_order_relaxed);
+    m_completion_tokens.fetch_add(completion_tokens, std::memory_order_relaxed);
     if (success) {
-        m_successful_requests++;
+        m_successful_requests.fetch_add(1, std::memory_order_relaxed);
     } else {
-        m_failed_requests++;
-    }
-    
-    // Record latency
-    m_latency_samples.push_back(latency_ms);
-    if (m_latency_samples.size() > MAX_TIME_SERIES_POINTS) {
-        m_latency_samples.pop_front();
+        m_failed_requests.fetch_add(1, std::memory_order_relaxed);
     }
+    m_total_requests.fetch_add(1, std::memory_order_relaxed);
     
-    // Record tokens
-    m_prompt_token_samples.push_back(prompt_tokens);
-    m_completion_token_samples.push_back(completion_tokens);
-    if (m_prompt_token_samples.size() > MAX_TIME_SERIES_POINTS) {
-        m_prompt_token_samples.pop_front();
-        m_completion_token_samples.pop_front();
-    }
+    std::lock_guard<std::mutex> lock(m_mutex);
     
     // Update model metrics
     auto& metrics = m_model_metrics[model];
@@ -63,6 +53,12 @@ void AIMetricsCollector::recordOllamaRequest(const std::string& model,
     metrics.tokens.avg_completion_tokens = static_cast<double>(metrics.tokens.total_completion_tokens) / 
                                           metrics.request_count;
     
+    auto& model_latency = m_model_latency[model];
+    if (!model_latency) {
+        model_latency = std::make_unique<LatencyHistogram>(false);
+    }
+    model_latency->record(latency_ms);
+    
     // Time series
     auto now = std::chrono::system_clock::now();
     m_timeSeries["latency"].push_back({now, static_cast<double>(latency_ms), model});
@@ -89,7 +85,12 @@ void AIMetricsCollector::recordToolInvocation(const std::string& tool_name,
     }
     stats.success_rate = static_cast<double>(stats.success_count) / stats.invocation_count;
     
-    // Update latency stats (simplified - store samples)
+    auto& tool_latency = m_tool_latency[tool_name];
+    if (!tool_latency) {
+        tool_latency = std::make_unique<LatencyHistogram>(false);
+    }
+    tool_latency->record(latency_ms);
+    
     auto now = std::chrono::system_clock::now();
     m_timeSeries["tool_" + tool_name].push_back({now, static_cast<double>(latency_ms), tool_name});
     pruneTimeSeries("tool_" + tool_name);
@@ -118,9 +119,8 @@ void AIMetricsCollector::recordCustomMetric(const std::string& metric_name,
     pruneTimeSeries(metric_name);
 }
 
-LatencyStats AIMetricsCollector::getOllamaLatencyStats() const {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return calculateLatencyStats(m_latency_samples);
+LatencyStats AIMetricsCollector::getOllamaLatencyStats(Window window) const {
+    return calculateLatencyStats(m_latency.snapshot(window));
 }
 
 TokenStats AIMetricsCollector::getTokenStats() const {
@@ -129,20 +129,17 @@ TokenStats AIMetricsCollector::getTokenStats() const {
 }
 
 TokenStats AIMetricsCollector::getTokenStatsInternal() const {
-    // No lock - assumes caller holds mutex
+    // Atomics only - safe with or without the mutex
     TokenStats stats;
     
-    if (!m_prompt_token_samples.empty()) {
-        stats.total_prompt_tokens = std::accumulate(
-            m_prompt_token_samples.begin(), m_prompt_token_samples.end(), 0ULL);
-        stats.total_completion_tokens = std::accumulate(
-            m_completion_token_samples.begin(), m_completion_token_samples.end(), 0ULL);
+    const uint64_t requests = m_total_requests.load(std::memory_order_relaxed);
+    if (requests > 0) {
+        stats.total_prompt_tokens = m_prompt_tokens.load(std::memory_order_relaxed);
+        stats.total_completion_tokens = m_completion_tokens.load(std::memory_order_relaxed);
         stats.total_tokens = stats.total_prompt_tokens + stats.total_completion_tokens;
         
-        stats.avg_prompt_tokens = static_cast<double>(stats.total_prompt_tokens) / 
-                                 m_prompt_token_samples.size();
-        stats.avg_completion_tokens = static_cast<double>(stats.total_completion_tokens) / 
-                                     m_completion_token_samples.size();
+        stats.avg_prompt_tokens = static_cast<double>(stats.total_prompt_tokens) / requests;
+        stats.avg_completion_tokens = static_cast<double>(stats.total_completion_tokens) / requests;
     }
     
     return stats;
@@ -158,6 +155,10 @@ std::vector<ToolStats> AIMetricsCollector::getToolStatsInternal() const {
     std::vector<ToolStats> result;
     for (const auto& pair : m_tool_stats) {
         result.push_back(pair.second);
+        auto it = m_tool_latency.find(pair.first);
+        if (it != m_tool_latency.end()) {
+            result.back().latency = calculateLatencyStats(it->second->snapshot());
+        }
     }
     
     // Sort by invocation count descending
@@ -175,16 +176,10 @@ std::vector<ModelMetrics> AIMetricsCollector::getModelMetrics() const {
     for (auto& pair : m_model_metrics) {
         auto metrics = pair.second;
         
-        // Calculate latency for this model
-        std::deque<uint64_t> model_latencies;
-        if (m_timeSeries.count("latency")) {
-            for (const auto& point : m_timeSeries.at("latency")) {
-                if (point.label == pair.first) {
-                    model_latencies.push_back(static_cast<uint64_t>(point.value));
-                }
-            }
+        auto it = m_model_latency.find(pair.first);
+        if (it != m_model_latency.end()) {
+            metrics.latency = calculateLatencyStats(it->second->snapshot());
         }
-        metrics.latency = calculateLatencyStats(model_latencies);
         
         result.push_back(metrics);
     }
@@ -217,19 +212,17 @@ AIMetricsCollector::DisplayMetrics AIMetricsCollector::getDisplayMetrics() const
     
     DisplayMetrics display;
     
-    display.total_requests = m_total_requests;
-    display.successful_requests = m_successful_requests;
-    display.failed_requests = m_failed_requests;
-    
-    if (m_total_requests > 0) {
-        display.success_rate = static_cast<double>(m_successful_requests) / m_total_requests * 100.0;
-    }
+    display.total_requests = m_total_requests.load(std::memory_order_relaxed);
+    display.successful_requests = m_successful_requests.load(std::memory_order_relaxed);
+    display.failed_requests = m_failed_requests.load(std::memory_order_relaxed);
     
-    if (!m_latency_samples.empty()) {
-        display.last_request_latency_ms = static_cast<double>(m_latency_samples.back());
+    if (display.total_requests > 0) {
+        display.success_rate = static_cast<double>(display.successful_requests) / display.total_requests * 100.0;
+        display.last_request_latency_ms = static_cast<double>(m_last_latency_ms.load(std::memory_order_relaxed));
     }
     
-    display.latency_stats = calculateLatencyStats(m_latency_samples);
+    display.latency_stats = calculateLatencyStats(m_latency.snapshot());
+    display.recent_latency_stats = calculateLatencyStats(m_latency.snapshot(Window::FiveMinutes));
     display.token_stats = getTokenStatsInternal(); // Use internal version to avoid deadlock
     
     // Top 5 tools
@@ -280,11 +273,14 @@ void AIMetricsCollector::clearMetrics() {
     std::lock_guard<std::mutex> lock(m_mutex);
     
     m_timeSeries.clear();
-    m_latency_samples.clear();
-    m_prompt_token_samples.clear();
-    m_completion_token_samples.clear();
+    m_latency.reset();
+    m_last_latency_ms = 0;
+    m_prompt_tokens = 0;
+    m_completion_tokens = 0;
     m_model_metrics.clear();
+    m_model_latency.clear();
     m_tool_stats.clear();
+    m_tool_latency.clear();
     m_error_counts.clear();
     m_recent_errors.clear();
 }
@@ -301,7 +297,7 @@ void AIMetricsCollector::resetMetrics() {
 size_t AIMetricsCollector::getTotalRecordedMetrics() const {
     std::lock_guard<std::mutex> lock(m_mutex);
     
-    size_t total = m_latency_samples.size();
+    size_t total = static_cast<size_t>(m_latency.snapshot().count);
     for (const auto& pair : m_timeSeries) {
         total += pair.second.size();
     }
@@ -309,32 +305,24 @@ size_t AIMetricsCollector::getTotalRecordedMetrics() const {
 }
 
 LatencyStats AIMetricsCollector::calculateLatencyStats(
-    const std::deque<uint64_t>& samples) const {
+    const LatencyHistogram::Snapshot& snapshot) {
     
     LatencyStats stats;
     
-    if (samples.empty()) return stats;
+    if (snapshot.count == 0) return stats;
     
-    std::vector<uint64_t> sorted(samples.begin(), samples.end());
-    std::sort(sorted.begin(), sorted.end());
-    
-    stats.sample_count = sorted.size();
+    stats.sample_count = snapshot.count;
     
     // Percentiles
-    size_t p50_idx = sorted.size() * 50 / 100;
-    size_t p95_idx = sorted.size() * 95 / 100;
-    size_t p99_idx = sorted.size() * 99 / 100;
-    
-    stats.p50_ms = static_cast<double>(sorted[p50_idx]);
-    stats.p95_ms = static_cast<double>(sorted[std::min(p95_idx, sorted.size() - 1)]);
-    stats.p99_ms = static_cast<double>(sorted[std::min(p99_idx, sorted.size() - 1)]);
+    stats.p50_ms = static_cast<double>(snapshot.percentile(50));
+    stats.p95_ms = static_cast<double>(snapshot.percentile(95));
+    stats.p99_ms = static_cast<double>(snapshot.percentile(99));
     
     // Mean
-    uint64_t sum = std::accumulate(sorted.begin(), sorted.end(), 0ULL);
-    stats.mean_ms = static_cast<double>(sum) / sorted.size();
+    stats.mean_ms = snapshot.mean();
     
     // Max
-    stats.max_ms = static_cast<double>(sorted.back());
+    stats.max_ms = static_cast<double>(snapshot.max);
     
     return stats;
 }
@@ -365,7 +353,7 @@ std::string AIMetricsCollector::toJSON() const {
     
     oss << "  },\n";
     
-    auto latency = calculateLatencyStats(m_latency_samples);
+    auto latency = calculateLatencyStats(m_latency.snapshot());
     oss << "  \"latency\": {\n";
     oss << "    \"p50_ms\": " << latency.p50_ms << ",\n";
     oss << "    \"p95_ms\": " << latency.p95_ms << ",\n";
@@ -374,6 +362,19 @@ std::string AIMetricsCollector::toJSON() const {
     oss << "    \"max_ms\": " << latency.max_ms << "\n";
     oss << "  },\n";
     
+    const std::pair<const char*, Window> windows[] = {
+        {"1m", Window::OneMinute}, {"5m", Window::FiveMinutes}, {"1h", Window::OneHour}};
+    oss << "  \"latency_windows\": {\n";
+    for (size_t i = 0; i < 3; ++i) {
+        auto recent = calculateLatencyStats(m_latency.snapshot(windows[i].second));
+        oss << "    \"" << windows[i].first << "\": {";
+        oss << "\"requests\": " << recent.sample_count << ", ";
+        oss << "\"p50_ms\": " << recent.p50_ms << ", ";
+        oss << "\"p95_ms\": " << recent.p95_ms << ", ";
+        oss << "\"p99_ms\": " << recent.p99_ms << "}" << (i < 2 ? "," : "") << "\n";
+    }
+    oss << "  },\n";
+    
     auto tokens = getTokenStats();
     oss << "  \"tokens\": {\n";
     oss << "    \"total_prompt\": " << tokens.total_prompt_tokens << ",\n";
@@ -392,7 +393,8 @@ std::string AIMetricsCollector::toJSON() const {
         oss << "      \"invocations\": " << tool.invocation_count << ",\n";
         oss << "      \"successes\": " << tool.success_count << ",\n";
         oss << "      \"errors\": " << tool.error_count << ",\n";
-        oss << "      \"success_rate\": " << (tool.success_rate * 100.0) << "\n";
+        oss << "      \"success_rate\": " << (tool.success_rate * 100.0) << ",\n";
+        oss << "      \"p95_ms\": " << tool.latency.p95_ms << "\n";
         oss << "    }" << (i < tools.size() - 1 ? "," : "") << "\n";
     }
     oss << "  ]\n";
@@ -410,7 +412,7 @@ std::string AIMetricsCollector::toCSV() const {
     oss << "Successful Requests," << m_successful_requests << "\n";
     oss << "Failed Requests," << m_failed_requests << "\n";
     
-    auto latency = calculateLatencyStats(m_latency_samples);
+    auto latency = calculateLatencyStats(m_latency.snapshot());
     oss << "Latency P50 (ms)," << latency.p50_ms << "\n";
     oss << "Latency P95 (ms)," << latency.p95_ms << "\n";
     oss << "Latency P99 (ms)," << latency.p99_ms << "\n";
@@ -450,7 +452,7 @@ std::string AIMetricsCollector::toText() const {
     }
     
     oss << "\nLatency Statistics:\n";
-    auto latency = calculateLatencyStats(m_latency_samples);
+    auto latency = calculateLatencyStats(m_latency.snapshot());
     oss << "  P50 (median):        " << latency.p50_ms << " ms\n";
     oss << "  P95:                 " << latency.p95_ms << " ms\n";
     oss << "  P99:                 " << latency.p99_ms << " ms\n";
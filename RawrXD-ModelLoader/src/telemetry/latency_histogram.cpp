@@ -0,0 +1,315 @@
+#include "telemetry/latency_histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace RawrXD {
+namespace Telemetry {
+
+namespace {
+
+constexpr int64_t kEmpty = -1;       // Checkpoint never taken
+constexpr int64_t kWriting = -2;     // Checkpoint being copied
+
+struct RingLayout {
+    int64_t sliceMs;
+    int slices;
+};
+
+// Indexed by Window - 1; every slice length is a multiple of the first
+constexpr RingLayout kRings[] = {
+    {10 * 1000, 6},         // 1 minute
+    {60 * 1000, 5},         // 5 minutes
+    {5 * 60 * 1000, 12},    // 1 hour
+};
+constexpr int kRingCount = int(sizeof(kRings) / sizeof(kRings[0]));
+constexpr int64_t kCheckpointMs = kRings[0].sliceMs;
+
+std::atomic<unsigned> g_nextShard{0};
+
+int shardSlot() {
+    thread_local const int slot =
+        int(g_nextShard.fetch_add(1, std::memory_order_relaxed) % LatencyHistogram::kShards);
+    return slot;
+}
+
+uint64_t saturatingSub(uint64_t a, uint64_t b) {
+    return a > b ? a - b : 0;
+}
+
+} // namespace
+
+// One writer group's counters, on their own cache lines
+struct alignas(64) LatencyHistogram::Shard {
+    std::array<std::atomic<uint64_t>, kBuckets> counts{};
+    std::atomic<uint64_t> sum{0};
+};
+
+// Lifetime totals as of the first sample in each recent slice. A window is
+// the lifetime view minus the checkpoint that opens it.
+struct LatencyHistogram::Ring {
+    struct Checkpoint {
+        std::atomic<int64_t> epoch{kEmpty};
+        std::atomic<uint64_t> sum{0};
+        std::unique_ptr<std::atomic<uint64_t>[]> counts =
+            std::make_unique<std::atomic<uint64_t>[]>(kBuckets);
+    };
+
+    RingLayout layout{};
+    int size = 0;                       // slices + 1, so the opening checkpoint survives
+    std::unique_ptr<Checkpoint[]> checkpoints;
+    std::atomic<int64_t> lastEpoch{kEmpty};   // Newest epoch stored
+
+    void init(const RingLayout& l) {
+        layout = l;
+        size = l.slices + 1;
+        checkpoints = std::make_unique<Checkpoint[]>(size);
+    }
+
+    void store(int64_t nowMs, const std::vector<uint64_t>& counts, uint64_t sum) {
+        const int64_t epoch = nowMs / layout.sliceMs;
+        int64_t last = lastEpoch.load(std::memory_order_relaxed);
+        do {
+            if (epoch <= last) return;
+        } while (!lastEpoch.compare_exchange_weak(last, epoch, std::memory_order_relaxed));
+        Checkpoint& cp = checkpoints[epoch % size];
+        cp.epoch.store(kWriting, std::memory_order_release);
+        for (int i = 0; i < kBuckets; ++i) {
+            cp.counts[i].store(counts[i], std::memory_order_relaxed);
+        }
+        cp.sum.store(sum, std::memory_order_relaxed);
+        cp.epoch.store(epoch, std::memory_order_release);
+    }
+
+    // Copies the oldest checkpoint inside the window. Slices without one saw
+    // no samples, so the next checkpoint holds the same totals. False when no
+    // sample landed inside the window.
+    bool opening(int64_t nowMs, std::vector<uint64_t>& counts, uint64_t& sum) const {
+        const int64_t first = nowMs / layout.sliceMs - layout.slices + 1;
+        for (int attempt = 0; attempt < 4; ++attempt) {
+            int best = -1;
+            int64_t bestEpoch = INT64_MAX;
+            for (int s = 0; s < size; ++s) {
+                const int64_t epoch = checkpoints[s].epoch.load(std::memory_order_acquire);
+                if (epoch >= first && epoch < bestEpoch) {
+                    best = s;
+                    bestEpoch = epoch;
+                }
+            }
+            if (best < 0) return false;
+
+            const Checkpoint& cp = checkpoints[best];
+            for (int i = 0; i < kBuckets; ++i) {
+                counts[i] = cp.counts[i].load(std::memory_order_relaxed);
+            }
+            sum = cp.sum.load(std::memory_order_relaxed);
+            if (cp.epoch.load(std::memory_order_acquire) == bestEpoch) return true;
+        }
+        return false;
+    }
+
+    void clear() {
+        for (int s = 0; s < size; ++s) {
+            checkpoints[s].epoch.store(kEmpty, std::memory_order_relaxed);
+        }
+        lastEpoch.store(kEmpty, std::memory_order_relaxed);
+    }
+};
+
+LatencyHistogram::LatencyHistogram(bool windowed)
+    : m_windowed(windowed)
+    , m_shards(std::make_unique<Shard[]>(kShards))
+{
+    if (m_windowed) {
+        m_rings = std::make_unique<Ring[]>(kRingCount);
+        for (int r = 0; r < kRingCount; ++r) {
+            m_rings[r].init(kRings[r]);
+        }
+    }
+}
+
+LatencyHistogram::~LatencyHistogram() = default;
+
+void LatencyHistogram::recordAt(uint64_t value, int64_t nowMs) {
+    if (m_windowed && nowMs >= m_nextCheckpointMs.load(std::memory_order_relaxed)) {
+        checkpoint(nowMs);
+    }
+
+    const int bucket = bucketIndex(value);
+    Shard& shard = m_shards[shardSlot()];
+    shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+
+    // Min and max are only written when they move, so they stay shared-clean
+    uint64_t seen = m_min.load(std::memory_order_relaxed);
+    while (value < seen && !m_min.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+    seen = m_max.load(std::memory_order_relaxed);
+    while (value > seen && !m_max.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::checkpoint(int64_t nowMs) {
+    if (nowMs < 0) return;
+    int64_t next = m_nextCheckpointMs.load(std::memory_order_acquire);
+    const int64_t following = (nowMs / kCheckpointMs + 1) * kCheckpointMs;
+    // One writer per slice boundary copies the totals; the others record on
+    if (nowMs < next || !m_nextCheckpointMs.compare_exchange_strong(next, following, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    std::vector<uint64_t> counts(kBuckets, 0);
+    uint64_t sum = 0;
+    collectLifetime(counts, sum);
+    for (int r = 0; r < kRingCount; ++r) {
+        m_rings[r].store(nowMs, counts, sum);
+    }
+}
+
+void LatencyHistogram::collectLifetime(std::vector<uint64_t>& counts, uint64_t& sum) const {
+    for (int s = 0; s < kShards; ++s) {
+        for (int i = 0; i < kBuckets; ++i) {
+            counts[i] += m_shards[s].counts[i].load(std::memory_order_relaxed);
+        }
+        sum += m_shards[s].sum.load(std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshotAt(Window window, int64_t nowMs) const {
+    Snapshot snap;
+    if (window != Window::Lifetime && (!m_windowed || nowMs < 0)) return snap;
+
+    std::vector<uint64_t> counts(kBuckets, 0);
+    uint64_t sum = 0;
+    collectLifetime(counts, sum);
+
+    if (window != Window::Lifetime) {
+        std::vector<uint64_t> opening(kBuckets);
+        uint64_t openingSum = 0;
+        if (!m_rings[int(window) - 1].opening(nowMs, opening, openingSum)) return snap;
+        for (int i = 0; i < kBuckets; ++i) {
+            counts[i] = saturatingSub(counts[i], opening[i]);
+        }
+        sum = saturatingSub(sum, openingSum);
+    }
+
+    int first = -1;
+    int last = -1;
+    for (int i = 0; i < kBuckets; ++i) {
+        if (counts[i] == 0) continue;
+        if (first < 0) first = i;
+        last = i;
+        snap.count += counts[i];
+    }
+    if (snap.count == 0) return snap;
+
+    snap.counts = std::move(counts);
+    snap.sum = sum;
+    snap.min = bucketLow(first);
+    snap.max = bucketHigh(last);
+    if (window == Window::Lifetime) {
+        // Exact extremes; clamped in case a writer is between its bucket and min/max updates
+        snap.min = std::clamp(m_min.load(std::memory_order_relaxed), snap.min, bucketHigh(first));
+        snap.max = std::clamp(m_max.load(std::memory_order_relaxed), bucketLow(last), snap.max);
+    }
+    return snap;
+}
+
+void LatencyHistogram::reset() {
+    for (int s = 0; s < kShards; ++s) {
+        for (int i = 0; i < kBuckets; ++i) {
+            m_shards[s].counts[i].store(0, std::memory_order_relaxed);
+        }
+        m_shards[s].sum.store(0, std::memory_order_relaxed);
+    }
+    if (m_windowed) {
+        for (int r = 0; r < kRingCount; ++r) {
+            m_rings[r].clear();
+        }
+    }
+    m_min.store(UINT64_MAX, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+    m_nextCheckpointMs.store(INT64_MIN, std::memory_order_release);
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < uint64_t(kLinearLimit)) return int(value);
+    const int octave = int(std::bit_width(value)) - 1;   // >= 6
+    if (octave > kMaxOctave) return kBuckets - 1;
+    const int sub = int(value >> (octave - 5)) - kSubBuckets;
+    return kLinearLimit + (octave - 6) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketLow(int index) {
+    if (index < kLinearLimit) return uint64_t(index);
+    const int octave = 6 + (index - kLinearLimit) / kSubBuckets;
+    const int sub = (index - kLinearLimit) % kSubBuckets;
+    return uint64_t(kSubBuckets + sub) << (octave - 5);
+}
+
+uint64_t LatencyHistogram::bucketHigh(int index) {
+    if (index < kLinearLimit) return uint64_t(index);
+    if (index == kBuckets - 1) return UINT64_MAX;
+    const int octave = 6 + (index - kLinearLimit) / kSubBuckets;
+    return bucketLow(index) + (uint64_t(1) << (octave - 5)) - 1;
+}
+
+int64_t LatencyHistogram::nowMs() {
+    // Coarse ticks (1-16 ms) are plenty for 10 s slices and cost a fraction of steady_clock
+#ifdef _WIN32
+    return int64_t(GetTickCount64());
+#elif defined(CLOCK_MONOTONIC_COARSE)
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+#else
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const {
+    if (count == 0) return 0;
+    const double clamped = std::clamp(p, 0.0, 100.0);
+    uint64_t rank = uint64_t(clamped / 100.0 * double(count));   // Same index as sorted[n * p / 100]
+    if (rank >= count) rank = count - 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += counts[i];
+        if (seen > rank) {
+            const uint64_t low = bucketLow(i);
+            const uint64_t high = i == kBuckets - 1 ? max : bucketHigh(i);
+            return std::clamp(low + (high - low) / 2, min, max);
+        }
+    }
+    return max;
+}
+
+void LatencyHistogram::Snapshot::merge(const Snapshot& other) {
+    if (other.count == 0) return;
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    for (int i = 0; i < kBuckets; ++i) {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+} // namespace Telemetry
+} // namespace RawrXD
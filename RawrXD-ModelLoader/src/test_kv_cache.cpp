@@ -1,11 +1,16 @@
 // KV Cache Infrastructure Test
-// Tests the GPU KV cache allocation, append, and retrieval operations
+// Tests the GPU KV cache allocation, append, and retrieval operations, and
+// stress-tests the paged block manager shared by concurrent sequences
 
 #include "vulkan_compute.h"
+#include "paged_kv_cache.h"
 #include <iostream>
 #include <vector>
 #include <cassert>
 #include <cmath>
+#include <map>
+#include <random>
+#include <set>
 
 // Simple assertion helper
 #define ASSERT(condition, message) \
@@ -289,6 +294,213 @@ bool testRealisticTokenSequence() {
     return true;
 }
 
+// ---- Paged KV cache (host block manager, no GPU required) ----
+
+// Every K/V float written for a position encodes (sequence tag, position, layer)
+static float pagedValue(int tag, uint32_t pos, uint32_t layer, bool is_value) {
+    return float(tag * 100000 + pos * 10 + layer) + (is_value ? 0.5f : 0.0f);
+}
+
+static void writePaged(PagedKVCache& kv, int tag, uint32_t first_pos, const std::vector<int64_t>& slots) {
+    const PagedKVConfig& cfg = kv.GetConfig();
+    for (size_t i = 0; i < slots.size(); ++i) {
+        for (uint32_t layer = 0; layer < cfg.n_layers; ++layer) {
+            float* k = kv.KeyRow(layer, slots[i]);
+            float* v = kv.ValueRow(layer, slots[i]);
+            for (uint32_t d = 0; d < cfg.kv_dim; ++d) {
+                k[d] = pagedValue(tag, first_pos + uint32_t(i), layer, false);
+                v[d] = pagedValue(tag, first_pos + uint32_t(i), layer, true);
+            }
+        }
+    }
+}
+
+// Checks positions [0, tags.size()) of seq against the tag that wrote each one
+static bool pagedMatches(PagedKVCache& kv, PagedKVCache::SeqId seq, const std::vector<int>& tags) {
+    const PagedKVConfig& cfg = kv.GetConfig();
+    if (kv.SequenceLength(seq) != tags.size()) return false;
+    std::vector<int32_t> slots(tags.size() + 3);
+    if (!kv.GatherSlots(seq, uint32_t(slots.size()), slots.data(), -1)) return false;
+    for (uint32_t pos = 0; pos < tags.size(); ++pos) {
+        if (slots[pos] != kv.SlotOf(seq, pos)) return false;
+        for (uint32_t layer = 0; layer < cfg.n_layers; ++layer) {
+            const float* k = kv.KeyRow(layer, slots[pos]);
+            const float* v = kv.ValueRow(layer, slots[pos]);
+            if (k[0] != pagedValue(tags[pos], pos, layer, false) || k[cfg.kv_dim - 1] != k[0] ||
+                v[cfg.kv_dim - 1] != pagedValue(tags[pos], pos, layer, true)) {
+                return false;
+            }
+        }
+    }
+    return slots[tags.size()] == -1 && kv.SlotOf(seq, uint32_t(tags.size())) == -1;
+}
+
+// Test 6: Fork shares blocks and diverges copy-on-write
+bool testPagedKVForkCopyOnWrite() {
+    std::cout << "\n=== Test 6: Paged KV Fork / Copy-on-Write ===" << std::endl;
+    
+    PagedKVCache kv;
+    ASSERT(kv.Init({2, 8, 4, 16}), "Init 16 blocks of 4 slots");
+    ASSERT(uintptr_t(kv.PoolData()) % 64 == 0, "Pool should be cache-line aligned");
+    ASSERT(kv.AddSequence(0), "AddSequence(0)");
+    ASSERT(!kv.AddSequence(0), "Duplicate sequence should be rejected");
+    
+    // 10 tokens = two full blocks and half of a third
+    std::vector<int64_t> slots(10);
+    ASSERT(kv.Append(0, 10, slots.data()), "Prefill 10 tokens");
+    writePaged(kv, 1, 0, slots);
+    std::vector<int> parent_tags(10, 1);
+    
+    ASSERT(kv.ForkSequence(0, 1), "Fork 0 -> 1");
+    PagedKVStats stats = kv.GetStats();
+    ASSERT(stats.shared_blocks == 3 && stats.free_blocks == 13, "Fork should share all three blocks");
+    std::vector<int> child_tags = parent_tags;
+    ASSERT(pagedMatches(kv, 1, child_tags), "Child should see the parent's tokens");
+    
+    // The child's first append un-shares only the partial tail block
+    std::vector<int64_t> one(1);
+    ASSERT(kv.Append(1, 1, one.data()), "Child append");
+    writePaged(kv, 2, 10, one);
+    child_tags.push_back(2);
+    stats = kv.GetStats();
+    ASSERT(stats.cow_copies == 1 && stats.shared_blocks == 2, "Tail block should be copied once");
+    ASSERT(kv.SlotOf(1, 3) == kv.SlotOf(0, 3), "Full blocks stay shared");
+    ASSERT(kv.SlotOf(1, 9) != kv.SlotOf(0, 9), "Tail block is now private");
+    
+    ASSERT(kv.Append(0, 1, one.data()), "Parent append");
+    writePaged(kv, 3, 10, one);
+    parent_tags.push_back(3);
+    ASSERT(kv.GetStats().cow_copies == 1, "Parent owns its tail again, no second copy");
+    ASSERT(pagedMatches(kv, 0, parent_tags), "Parent contents after divergence");
+    ASSERT(pagedMatches(kv, 1, child_tags), "Child contents after divergence");
+    
+    // Truncating to a block boundary and removing return every block
+    ASSERT(kv.TruncateSequence(1, 8), "Truncate child to two blocks");
+    ASSERT(!kv.TruncateSequence(1, 9), "Truncate cannot grow a sequence");
+    ASSERT(kv.RemoveSequence(0) && kv.RemoveSequence(1), "Remove both sequences");
+    stats = kv.GetStats();
+    ASSERT(stats.free_blocks == 16 && stats.shared_blocks == 0 && stats.live_tokens == 0,
+           "All blocks should be free again");
+    
+    std::cout << "✓ Forked sequences share full blocks and copy only the partial tail" << std::endl;
+    return true;
+}
+
+// Test 7: LRU eviction respects pins and the requester
+bool testPagedKVEviction() {
+    std::cout << "\n=== Test 7: Paged KV Eviction ===" << std::endl;
+    
+    PagedKVCache kv;
+    ASSERT(kv.Init({1, 4, 4, 6}), "Init 6 blocks of 4 slots");
+    std::vector<PagedKVCache::SeqId> evicted;
+    kv.SetEvictCallback([&](PagedKVCache::SeqId seq) { evicted.push_back(seq); });
+    
+    std::vector<int64_t> slots(24);
+    for (PagedKVCache::SeqId seq = 0; seq < 3; ++seq) {
+        ASSERT(kv.AddSequence(seq) && kv.Append(seq, 8, slots.data()), "Fill two blocks per sequence");
+    }
+    ASSERT(kv.GetStats().free_blocks == 0, "Pool should be full");
+    
+    // Sequence 0 is oldest but pinned, so 1 goes first
+    kv.SetPinned(0, true);
+    ASSERT(kv.AddSequence(3) && kv.Append(3, 4, slots.data()), "Append under pressure");
+    ASSERT(evicted.size() == 1 && evicted[0] == 1, "LRU unpinned sequence evicted");
+    ASSERT(!kv.HasSequence(1) && kv.HasSequence(0), "Pinned sequence kept");
+    
+    // Only 2 and 3 are evictable; 3 is the requester, so a 24-token append fails
+    ASSERT(!kv.Append(3, 24, slots.data()), "Append larger than reclaimable space fails");
+    ASSERT(kv.SequenceLength(3) == 4, "Failed append leaves the sequence unchanged");
+    ASSERT(kv.GetStats().free_blocks == 3 && !kv.HasSequence(2), "Blocks freed by eviction return to the pool");
+    
+    kv.SetPinned(0, false);
+    ASSERT(kv.Append(3, 16, slots.data()), "Append succeeds once the pin is released");
+    ASSERT(kv.GetStats().evicted_sequences == evicted.size(), "Eviction counter matches callbacks");
+    
+    std::cout << "✓ Evicted " << evicted.size() << " idle sequences, pinned sequence survived" << std::endl;
+    return true;
+}
+
+// Test 8: Randomized append/fork/truncate/remove against per-sequence references
+bool testPagedKVStress() {
+    std::cout << "\n=== Test 8: Paged KV Stress ===" << std::endl;
+    
+    PagedKVCache kv;
+    const uint32_t num_blocks = 48;
+    ASSERT(kv.Init({3, 16, 8, num_blocks}), "Init 48 blocks of 8 slots");
+    
+    std::map<PagedKVCache::SeqId, std::vector<int>> reference;
+    kv.SetEvictCallback([&](PagedKVCache::SeqId seq) { reference.erase(seq); });
+    
+    std::mt19937 rng(1234);
+    PagedKVCache::SeqId next_id = 0;
+    int next_tag = 1;
+    int appends = 0, forks = 0, truncates = 0, removes = 0;
+    
+    for (int step = 0; step < 4000; ++step) {
+        const int op = int(rng() % 10);
+        if (reference.empty() || op == 0) {
+            ASSERT(kv.AddSequence(next_id), "AddSequence");
+            reference[next_id++];
+            continue;
+        }
+        auto it = std::next(reference.begin(), rng() % reference.size());
+        const PagedKVCache::SeqId seq = it->first;
+        
+        if (op <= 5) {
+            const uint32_t n = 1 + rng() % 20;
+            std::vector<int64_t> slots(n);
+            const uint32_t len = uint32_t(it->second.size());
+            if (kv.Append(seq, n, slots.data())) {
+                // Eviction never takes the appending sequence
+                writePaged(kv, next_tag, len, slots);
+                reference[seq].insert(reference[seq].end(), n, next_tag++);
+                ++appends;
+            } else {
+                ASSERT(kv.SequenceLength(seq) == len, "Failed append leaves the sequence unchanged");
+            }
+        } else if (op <= 7) {
+            ASSERT(kv.ForkSequence(seq, next_id), "ForkSequence");
+            reference[next_id++] = it->second;
+            ++forks;
+        } else if (op == 8) {
+            const uint32_t n = it->second.empty() ? 0 : uint32_t(rng() % it->second.size());
+            ASSERT(kv.TruncateSequence(seq, n), "TruncateSequence");
+            it->second.resize(n);
+            ++truncates;
+        } else {
+            ASSERT(kv.RemoveSequence(seq), "RemoveSequence");
+            reference.erase(it);
+            ++removes;
+        }
+        
+        if (step % 50 == 0 || step == 3999) {
+            // Every live position reads back what was written for it, and
+            // free blocks plus referenced blocks account for the whole pool
+            std::set<int64_t> used;
+            uint64_t live = 0;
+            for (const auto& [id, tags] : reference) {
+                ASSERT(pagedMatches(kv, id, tags), "Sequence contents diverged from reference");
+                for (uint32_t pos = 0; pos < tags.size(); ++pos) {
+                    used.insert(kv.SlotOf(id, pos) / 8);
+                }
+                live += tags.size();
+            }
+            const PagedKVStats stats = kv.GetStats();
+            ASSERT(stats.sequences == reference.size(), "Sequence count mismatch");
+            ASSERT(stats.live_tokens == live, "Live token count mismatch");
+            ASSERT(stats.free_blocks + used.size() == num_blocks, "Block accounting leak");
+        }
+    }
+    
+    const PagedKVStats stats = kv.GetStats();
+    std::cout << "✓ " << appends << " appends, " << forks << " forks, " << truncates << " truncates, "
+              << removes << " removes" << std::endl;
+    std::cout << "  copy-on-write blocks: " << stats.cow_copies
+              << ", evicted sequences: " << stats.evicted_sequences << std::endl;
+    ASSERT(stats.cow_copies > 0 && stats.evicted_sequences > 0, "Stress run should exercise CoW and eviction");
+    return true;
+}
+
 int main() {
     std::cout << "========================================" << std::endl;
     std::cout << "KV Cache Infrastructure Test Suite" << std::endl;
@@ -301,6 +513,9 @@ int main() {
     all_passed &= testKVCacheRetrieval();
     all_passed &= testMultiLayerKVCache();
     all_passed &= testRealisticTokenSequence();
+    all_passed &= testPagedKVForkCopyOnWrite();
+    all_passed &= testPagedKVEviction();
+    all_passed &= testPagedKVStress();
     
     std::cout << "\n========================================" << std::endl;
     if (all_passed) {
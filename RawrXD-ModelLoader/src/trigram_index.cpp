@@ -0,0 +1,740 @@
+/**
+ * @file trigram_index.cpp
+ * @brief Trigram extraction, delta-varint posting lists and the on-disk format.
+ *
+ * @copyright MIT License
+ */
+
+#include "trigram_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t kTrigramSpace = 1u << 24;
+constexpr size_t kBinaryProbe = 8192;  // As FileSearchEngine
+constexpr char kMagic[8] = {'R', 'X', 'T', 'R', 'I', 'G', 'R', '1'};
+constexpr uint32_t kFormatVersion = 1;
+
+// Overlay and dead slots beyond this share of the index trigger a rebuild
+constexpr uint64_t kRebuildSlack = 65536;
+
+std::string pathToUtf8(const fs::path& path) {
+#if defined(__cpp_char8_t)
+    const std::u8string s = path.generic_u8string();
+    return std::string(s.begin(), s.end());
+#else
+    return path.generic_u8string();
+#endif
+}
+
+fs::path utf8ToPath(const std::string& s) {
+#if defined(__cpp_char8_t)
+    return fs::path(std::u8string(s.begin(), s.end()));
+#else
+    return fs::u8path(s);
+#endif
+}
+
+// One spelling per file: '/' separators, no "." or "..", no trailing '/'
+std::string normalizePath(const std::string& path) {
+    std::string out = pathToUtf8(utf8ToPath(path).lexically_normal());
+    while (out.size() > 1 && out.back() == '/') out.pop_back();
+    return out;
+}
+
+std::string parentOf(const std::string& path) {
+    const size_t slash = path.rfind('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash);
+}
+
+uint8_t foldByte(uint8_t c) {
+    return c >= 'A' && c <= 'Z' ? uint8_t(c + 32) : c;
+}
+
+void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(uint8_t(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
+}
+
+// Appends the ids of one encoded list
+template <typename Fn>
+void decodeList(const uint8_t* p, const uint8_t* end, Fn&& fn) {
+    uint32_t id = 0;
+    while (p < end) {
+        uint32_t delta = 0;
+        int shift = 0;
+        while (p < end) {
+            const uint8_t b = *p++;
+            delta |= uint32_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+            shift += 7;
+        }
+        id += delta;
+        fn(id);
+    }
+}
+
+template <typename T>
+void writePod(std::ofstream& out, const T& v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+// Bounds-checked reader over a loaded index file
+struct Reader {
+    const char* p;
+    const char* end;
+
+    template <typename T>
+    bool pod(T& v) {
+        if (size_t(end - p) < sizeof(T)) return false;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+    bool bytes(void* dst, size_t n) {
+        if (size_t(end - p) < n) return false;
+        std::memcpy(dst, p, n);
+        p += n;
+        return true;
+    }
+    bool string(std::string& s) {
+        uint32_t n = 0;
+        if (!pod(n) || size_t(end - p) < n) return false;
+        s.assign(p, n);
+        p += n;
+        return true;
+    }
+};
+
+} // namespace
+
+TrigramIndex::TrigramIndex(const FileSearchEngine::Options& walkOptions)
+    : m_options(walkOptions) {
+    m_offsets.assign(1, 0);
+}
+
+std::string TrigramIndex::defaultIndexPath(const std::string& root) {
+    return normalizePath(root) + "/.rawrxd/trigram.idx";
+}
+
+std::string TrigramIndex::root() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_root;
+}
+
+std::vector<TrigramIndex::Extracted> TrigramIndex::extract(const std::vector<FileSearchEntry>& entries) const {
+    std::vector<Extracted> out(entries.size());
+    std::atomic<size_t> next{0};
+    auto cancelled = [this] { return m_options.cancel && m_options.cancel->load(std::memory_order_relaxed); };
+
+    auto worker = [&] {
+        // Seen-trigram bitmap, cleared through the touched list after each file
+        std::vector<uint64_t> seen(kTrigramSpace / 64, 0);
+        std::vector<char> buffer;
+        for (size_t i = next.fetch_add(1); i < entries.size() && !cancelled(); i = next.fetch_add(1)) {
+            std::ifstream in(utf8ToPath(entries[i].path), std::ios::binary);
+            if (!in) continue;
+            in.seekg(0, std::ios::end);
+            const std::streamoff size = in.tellg();
+            if (size < 0 || uint64_t(size) > m_options.maxFileSize) continue;
+            in.seekg(0, std::ios::beg);
+            buffer.resize(size_t(size));
+            if (size > 0 && !in.read(buffer.data(), size)) continue;
+
+            Extracted& e = out[i];
+            e.ok = true;
+            const size_t n = buffer.size();
+            if (n > 0 && std::memchr(buffer.data(), 0, std::min(n, kBinaryProbe))) {
+                e.binary = true;
+                continue;
+            }
+            uint32_t t = 0;
+            for (size_t k = 0; k < n; ++k) {
+                t = ((t << 8) | foldByte(uint8_t(buffer[k]))) & (kTrigramSpace - 1);
+                if (k < 2) continue;
+                uint64_t& word = seen[t >> 6];
+                const uint64_t bit = uint64_t(1) << (t & 63);
+                if (word & bit) continue;
+                word |= bit;
+                e.trigrams.push_back(t);
+            }
+            for (uint32_t x : e.trigrams) seen[x >> 6] = 0;
+            std::sort(e.trigrams.begin(), e.trigrams.end());
+        }
+    };
+
+    int threads = m_options.threads > 0 ? m_options.threads : int(std::thread::hardware_concurrency());
+    threads = std::max(1, std::min(threads, int(entries.size() / 8) + 1));
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool) t.join();
+
+    if (cancelled()) out.clear();
+    return out;
+}
+
+void TrigramIndex::clearLocked() {
+    m_root.clear();
+    m_directories.clear();
+    m_files.clear();
+    m_ids.clear();
+    m_liveFiles = 0;
+    m_keys.clear();
+    m_offsets.assign(1, 0);
+    m_blob.clear();
+    m_postings = 0;
+    m_overlay.clear();
+    m_firstOverlayId = 0;
+    m_overlayPostings = 0;
+}
+
+void TrigramIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    clearLocked();
+}
+
+void TrigramIndex::dropFileLocked(const std::string& path) {
+    const auto it = m_ids.find(path);
+    if (it == m_ids.end()) return;
+    m_files[it->second].live = false;
+    m_ids.erase(it);
+    --m_liveFiles;
+}
+
+void TrigramIndex::applyLocked(const std::vector<FileSearchEntry>& entries, std::vector<Extracted>& extracted) {
+    std::vector<std::pair<uint32_t, const std::vector<uint32_t>*>> fresh;
+    uint64_t freshPostings = 0;
+    for (size_t i = 0; i < entries.size() && i < extracted.size(); ++i) {
+        dropFileLocked(entries[i].path);
+        if (!extracted[i].ok) continue;  // Gone between listing and reading
+
+        const uint32_t id = uint32_t(m_files.size());
+        FileEntry file;
+        file.path = entries[i].path;
+        file.size = entries[i].size;
+        file.mtime = entries[i].mtime;
+        file.live = true;
+        file.binary = extracted[i].binary;
+        m_files.push_back(std::move(file));
+        m_ids[entries[i].path] = id;
+        ++m_liveFiles;
+        fresh.emplace_back(id, &extracted[i].trigrams);
+        freshPostings += extracted[i].trigrams.size();
+    }
+
+    // Large batches (the first build among them) go straight into the encoded
+    // lists; small ones wait in the overlay
+    const uint64_t budget = (m_postings + m_overlayPostings) / 4 + kRebuildSlack;
+    const uint64_t dead = m_files.size() - m_liveFiles;
+    if (m_overlayPostings + freshPostings > budget || dead > m_liveFiles / 4 + 1024) {
+        rebuildLocked(fresh);
+        return;
+    }
+    for (const auto& f : fresh) {
+        for (uint32_t t : *f.second) m_overlay[t].push_back(f.first);
+    }
+    m_overlayPostings += freshPostings;
+}
+
+void TrigramIndex::rebuildLocked(const std::vector<std::pair<uint32_t, const std::vector<uint32_t>*>>& fresh) {
+    // Live files keep their order, so every list stays sorted after renumbering
+    std::vector<uint32_t> remap(m_files.size(), UINT32_MAX);
+    std::vector<FileEntry> files;
+    files.reserve(size_t(m_liveFiles));
+    for (size_t id = 0; id < m_files.size(); ++id) {
+        if (!m_files[id].live) continue;
+        remap[id] = uint32_t(files.size());
+        files.push_back(std::move(m_files[id]));
+    }
+
+    // Per trigram: encoded ids, then overlay ids, then fresh ids, each ascending
+    auto forEachPosting = [&](auto&& fn) {
+        for (size_t k = 0; k < m_keys.size(); ++k) {
+            decodeList(m_blob.data() + m_offsets[k], m_blob.data() + m_offsets[k + 1], [&](uint32_t id) {
+                if (remap[id] != UINT32_MAX) fn(m_keys[k], remap[id]);
+            });
+        }
+        for (const auto& entry : m_overlay) {
+            for (uint32_t id : entry.second) {
+                if (remap[id] != UINT32_MAX) fn(entry.first, remap[id]);
+            }
+        }
+        for (const auto& f : fresh) {
+            if (remap[f.first] == UINT32_MAX) continue;
+            for (uint32_t t : *f.second) fn(t, remap[f.first]);
+        }
+    };
+
+    std::vector<uint32_t> cursor(kTrigramSpace, 0);
+    uint64_t total = 0;
+    forEachPosting([&](uint32_t t, uint32_t) {
+        ++cursor[t];
+        ++total;
+    });
+    std::vector<uint64_t> start;
+    std::vector<uint32_t> keys;
+    uint64_t at = 0;
+    for (uint32_t t = 0; t < kTrigramSpace; ++t) {
+        if (!cursor[t]) continue;
+        keys.push_back(t);
+        start.push_back(at);
+        const uint32_t n = cursor[t];
+        cursor[t] = uint32_t(keys.size() - 1);  // Now the key slot
+        at += n;
+    }
+    std::vector<uint64_t> fill(start);
+    std::vector<uint32_t> flat(static_cast<size_t>(total));
+    forEachPosting([&](uint32_t t, uint32_t id) { flat[size_t(fill[cursor[t]]++)] = id; });
+
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t> blob;
+    offsets.reserve(keys.size() + 1);
+    blob.reserve(size_t(total) + size_t(total) / 4);
+    offsets.push_back(0);
+    for (size_t k = 0; k < keys.size(); ++k) {
+        const uint64_t end = k + 1 < keys.size() ? start[k + 1] : total;
+        uint32_t prev = 0;
+        for (uint64_t i = start[k]; i < end; ++i) {
+            putVarint(blob, flat[size_t(i)] - prev);
+            prev = flat[size_t(i)];
+        }
+        offsets.push_back(blob.size());
+    }
+
+    m_files = std::move(files);
+    m_ids.clear();
+    m_ids.reserve(m_files.size());
+    for (size_t id = 0; id < m_files.size(); ++id) m_ids[m_files[id].path] = uint32_t(id);
+    m_liveFiles = m_files.size();
+    m_keys = std::move(keys);
+    m_offsets = std::move(offsets);
+    m_blob = std::move(blob);
+    m_postings = total;
+    m_overlay.clear();
+    m_overlayPostings = 0;
+    m_firstOverlayId = uint32_t(m_files.size());
+}
+
+void TrigramIndex::compact() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (m_overlay.empty() && m_liveFiles == m_files.size()) return;
+    rebuildLocked({});
+}
+
+bool TrigramIndex::refresh(const std::string& root) {
+    std::lock_guard<std::mutex> update(m_updateMutex);
+    const std::string rootPath = normalizePath(root);
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (m_root != rootPath) {
+            clearLocked();
+            m_root = rootPath;
+        }
+    }
+
+    std::vector<FileSearchEntry> walked;
+    std::vector<FileSearchEntry> listing = FileSearchEngine(m_options).listFiles(rootPath, &walked);
+    if (m_options.cancel && m_options.cancel->load(std::memory_order_relaxed)) return false;
+
+    std::vector<FileSearchEntry> todo;
+    std::vector<std::string> gone;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        std::unordered_set<std::string> present;
+        present.reserve(listing.size());
+        for (FileSearchEntry& entry : listing) {
+            entry.path = normalizePath(entry.path);
+            if (entry.size > m_options.maxFileSize) continue;
+            present.insert(entry.path);
+            const auto it = m_ids.find(entry.path);
+            if (it == m_ids.end() || m_files[it->second].size != entry.size ||
+                m_files[it->second].mtime != entry.mtime) {
+                todo.push_back(entry);
+            }
+        }
+        for (const FileEntry& file : m_files) {
+            if (file.live && !present.count(file.path)) gone.push_back(file.path);
+        }
+    }
+
+    std::vector<Extracted> extracted = extract(todo);
+    if (extracted.size() != todo.size()) return false;
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (const std::string& path : gone) dropFileLocked(path);
+    applyLocked(todo, extracted);
+    m_directories.clear();
+    for (const FileSearchEntry& dir : walked) m_directories[normalizePath(dir.path)] = dir.mtime;
+    return true;
+}
+
+void TrigramIndex::updateFile(const std::string& path) {
+    std::lock_guard<std::mutex> update(m_updateMutex);
+    FileSearchEntry entry;
+    entry.path = normalizePath(path);
+    const fs::path native = utf8ToPath(entry.path);
+    std::error_code ec;
+    entry.size = fs::file_size(native, ec);
+    if (!ec) entry.mtime = int64_t(fs::last_write_time(native, ec).time_since_epoch().count());
+    if (ec || entry.size > m_options.maxFileSize) {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        dropFileLocked(entry.path);
+        return;
+    }
+
+    const std::vector<FileSearchEntry> entries{entry};
+    std::vector<Extracted> extracted = extract(entries);
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (extracted.empty()) return;
+    applyLocked(entries, extracted);
+}
+
+void TrigramIndex::removeFile(const std::string& path) {
+    const std::string key = normalizePath(path);
+    std::lock_guard<std::mutex> update(m_updateMutex);
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    dropFileLocked(key);
+}
+
+void TrigramIndex::refreshDirectory(const std::string& dir) {
+    std::lock_guard<std::mutex> update(m_updateMutex);
+    rescanDirectory(normalizePath(dir));
+}
+
+size_t TrigramIndex::refreshChangedDirectories(const std::function<bool(const std::string&)>& skip) {
+    std::lock_guard<std::mutex> update(m_updateMutex);
+    std::vector<std::pair<std::string, int64_t>> known;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        known.assign(m_directories.begin(), m_directories.end());
+    }
+
+    size_t rescanned = 0;
+    for (const auto& [dir, mtime] : known) {
+        if (skip && skip(dir)) continue;
+        if (m_options.cancel && m_options.cancel->load(std::memory_order_relaxed)) break;
+        std::error_code ec;
+        const auto time = fs::last_write_time(utf8ToPath(dir), ec);
+        if (!ec && int64_t(time.time_since_epoch().count()) == mtime) continue;
+        rescanDirectory(dir);
+        ++rescanned;
+    }
+    return rescanned;
+}
+
+void TrigramIndex::rescanDirectory(const std::string& dirPath) {
+    std::string root;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        root = m_root.empty() ? dirPath : m_root;
+    }
+    const FileSearchEngine engine(m_options);
+    auto cancelled = [this] { return m_options.cancel && m_options.cancel->load(std::memory_order_relaxed); };
+
+    // Only dir's own files, with the ignore rules a walk from the root would
+    // apply; a dir that is gone or now ignored lists nothing and is dropped
+    std::vector<FileSearchEntry> found;
+    std::vector<FileSearchEntry> listing;
+    for (FileSearchEntry& entry : engine.listFiles(root, dirPath, false, &found)) {
+        entry.path = normalizePath(entry.path);
+        if (entry.size <= m_options.maxFileSize) listing.push_back(std::move(entry));
+    }
+    if (cancelled()) return;
+    int64_t dirTime = 0;
+    bool exists = false;
+    std::set<std::string> subdirs;
+    for (const FileSearchEntry& d : found) {
+        std::string path = normalizePath(d.path);
+        if (path == dirPath) {
+            exists = true;
+            dirTime = d.mtime;
+        } else {
+            subdirs.insert(std::move(path));
+        }
+    }
+
+    // Subdirectories that appeared since the last walk are indexed whole;
+    // ones that disappeared take their files and subdirectories with them
+    std::vector<std::string> newDirs;
+    std::vector<std::string> goneDirs;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        for (const std::string& sub : subdirs) {
+            if (!m_directories.count(sub)) newDirs.push_back(sub);
+        }
+        for (const auto& known : m_directories) {
+            if (parentOf(known.first) == dirPath && !subdirs.count(known.first)) goneDirs.push_back(known.first);
+        }
+    }
+    std::vector<FileSearchEntry> walked;
+    for (const std::string& sub : newDirs) {
+        std::vector<FileSearchEntry> subWalked;
+        for (FileSearchEntry& entry : engine.listFiles(root, sub, true, &subWalked)) {
+            entry.path = normalizePath(entry.path);
+            if (entry.size <= m_options.maxFileSize) listing.push_back(std::move(entry));
+        }
+        for (FileSearchEntry& d : subWalked) {
+            d.path = normalizePath(d.path);
+            walked.push_back(std::move(d));
+        }
+    }
+    if (cancelled()) return;
+
+    std::vector<FileSearchEntry> todo;
+    std::vector<std::string> gone;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        std::unordered_set<std::string> present;
+        for (const FileSearchEntry& entry : listing) {
+            present.insert(entry.path);
+            const auto it = m_ids.find(entry.path);
+            if (it == m_ids.end() || m_files[it->second].size != entry.size ||
+                m_files[it->second].mtime != entry.mtime) {
+                todo.push_back(entry);
+            }
+        }
+        auto under = [](const std::string& path, const std::string& root) {
+            return path.size() > root.size() && path.compare(0, root.size(), root) == 0 && path[root.size()] == '/';
+        };
+        for (const FileEntry& file : m_files) {
+            if (!file.live || present.count(file.path)) continue;
+            bool drop = parentOf(file.path) == dirPath;
+            for (size_t i = 0; !drop && i < goneDirs.size(); ++i) drop = under(file.path, goneDirs[i]);
+            if (drop) gone.push_back(file.path);
+        }
+        const size_t goneRoots = goneDirs.size();
+        for (const auto& known : m_directories) {
+            for (size_t i = 0; i < goneRoots; ++i) {
+                if (under(known.first, goneDirs[i])) {
+                    goneDirs.push_back(known.first);
+                    break;
+                }
+            }
+        }
+    }
+
+    // An mtime is only recorded once the files behind it are indexed, so an
+    // interrupted rescan is retried by refreshChangedDirectories()
+    std::vector<Extracted> extracted = extract(todo);
+    const bool complete = extracted.size() == todo.size();
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (const std::string& path : gone) dropFileLocked(path);
+    if (complete) applyLocked(todo, extracted);
+    for (const std::string& d : goneDirs) m_directories.erase(d);
+    // Known subdirectories keep their own mtime until they are rescanned themselves
+    for (const FileSearchEntry& d : walked) m_directories[d.path] = complete ? d.mtime : 0;
+    if (exists) {
+        m_directories[dirPath] = complete ? dirTime : 0;
+    } else {
+        m_directories.erase(dirPath);
+    }
+}
+
+void TrigramIndex::postingsLocked(uint32_t trigram, std::vector<uint32_t>& out) const {
+    out.clear();
+    const auto key = std::lower_bound(m_keys.begin(), m_keys.end(), trigram);
+    if (key != m_keys.end() && *key == trigram) {
+        const size_t k = size_t(key - m_keys.begin());
+        decodeList(m_blob.data() + m_offsets[k], m_blob.data() + m_offsets[k + 1], [&](uint32_t id) {
+            if (m_files[id].live) out.push_back(id);
+        });
+    }
+    const auto overlay = m_overlay.find(trigram);
+    if (overlay != m_overlay.end()) {
+        for (uint32_t id : overlay->second) {
+            if (m_files[id].live) out.push_back(id);
+        }
+    }
+}
+
+bool TrigramIndex::candidates(const std::string& literal, std::vector<std::string>& out) const {
+    out.clear();
+    if (literal.size() < 3) return false;
+
+    std::vector<uint32_t> trigrams;
+    uint32_t t = 0;
+    for (size_t k = 0; k < literal.size(); ++k) {
+        t = ((t << 8) | foldByte(uint8_t(literal[k]))) & (kTrigramSpace - 1);
+        if (k >= 2) trigrams.push_back(t);
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+    // Shortest lists first, by encoded size, so the running set shrinks fast
+    auto estimate = [this](uint32_t trigram) -> uint64_t {
+        uint64_t bytes = 0;
+        const auto key = std::lower_bound(m_keys.begin(), m_keys.end(), trigram);
+        if (key != m_keys.end() && *key == trigram) {
+            const size_t k = size_t(key - m_keys.begin());
+            bytes = m_offsets[k + 1] - m_offsets[k];
+        }
+        const auto overlay = m_overlay.find(trigram);
+        return bytes + (overlay != m_overlay.end() ? overlay->second.size() : 0);
+    };
+    std::vector<std::pair<uint64_t, uint32_t>> order;
+    for (uint32_t trigram : trigrams) order.emplace_back(estimate(trigram), trigram);
+    std::sort(order.begin(), order.end());
+
+    std::vector<uint32_t> result, list, merged;
+    postingsLocked(order[0].second, result);
+    for (size_t i = 1; i < order.size() && !result.empty(); ++i) {
+        postingsLocked(order[i].second, list);
+        merged.clear();
+        std::set_intersection(result.begin(), result.end(), list.begin(), list.end(), std::back_inserter(merged));
+        result.swap(merged);
+    }
+
+    out.reserve(result.size());
+    for (uint32_t id : result) out.push_back(m_files[id].path);
+    return true;
+}
+
+TrigramIndex::Stats TrigramIndex::stats() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    Stats s;
+    s.files = m_liveFiles;
+    for (size_t id = 0; id < m_files.size(); ++id) {
+        const FileEntry& file = m_files[id];
+        if (!file.live) continue;
+        if (!file.binary) s.textBytes += file.size;
+        if (id >= m_firstOverlayId) ++s.overlayFiles;
+    }
+    s.trigrams = m_keys.size();
+    s.postings = m_postings + m_overlayPostings;
+    s.encodedBytes = m_blob.size();
+    return s;
+}
+
+std::vector<std::string> TrigramIndex::directories() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    std::set<std::string> dirs;
+    for (const auto& known : m_directories) dirs.insert(dirs.end(), known.first);
+    for (const FileEntry& file : m_files) {
+        if (file.live) dirs.insert(parentOf(file.path));
+    }
+    return std::vector<std::string>(dirs.begin(), dirs.end());
+}
+
+bool TrigramIndex::save(const std::string& file) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (!m_overlay.empty() || m_liveFiles != m_files.size()) rebuildLocked({});
+
+    const fs::path target = utf8ToPath(file);
+    const fs::path temp = utf8ToPath(file + ".tmp");
+    std::error_code ec;
+    fs::create_directories(target.parent_path(), ec);
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        // Host byte order: the file never leaves the machine that wrote it
+        out.write(kMagic, sizeof(kMagic));
+        writePod(out, kFormatVersion);
+        writePod(out, uint32_t(m_root.size()));
+        out.write(m_root.data(), std::streamsize(m_root.size()));
+        writePod(out, uint32_t(m_files.size()));
+        for (const FileEntry& f : m_files) {
+            writePod(out, uint32_t(f.path.size()));
+            out.write(f.path.data(), std::streamsize(f.path.size()));
+            writePod(out, f.size);
+            writePod(out, f.mtime);
+            writePod(out, uint8_t(f.binary ? 1 : 0));
+        }
+        writePod(out, uint32_t(m_keys.size()));
+        out.write(reinterpret_cast<const char*>(m_keys.data()), std::streamsize(m_keys.size() * sizeof(uint32_t)));
+        out.write(reinterpret_cast<const char*>(m_offsets.data()), std::streamsize(m_offsets.size() * sizeof(uint64_t)));
+        out.write(reinterpret_cast<const char*>(m_blob.data()), std::streamsize(m_blob.size()));
+        if (!out) return false;
+    }
+    fs::rename(temp, target, ec);
+    return !ec;
+}
+
+bool TrigramIndex::load(const std::string& file) {
+    std::ifstream in(utf8ToPath(file), std::ios::binary);
+    std::vector<char> data;
+    if (in) {
+        in.seekg(0, std::ios::end);
+        const std::streamoff size = in.tellg();
+        in.seekg(0, std::ios::beg);
+        if (size > 0) {
+            data.resize(size_t(size));
+            if (!in.read(data.data(), size)) data.clear();
+        }
+    }
+
+    Reader r{data.data(), data.data() + data.size()};
+    char magic[sizeof(kMagic)];
+    uint32_t version = 0, fileCount = 0, keyCount = 0;
+    std::string root;
+    std::vector<FileEntry> files;
+    std::vector<uint32_t> keys;
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t> blob;
+
+    bool ok = r.bytes(magic, sizeof(magic)) && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0 && r.pod(version) &&
+              version == kFormatVersion && r.string(root) && r.pod(fileCount);
+    if (ok) {
+        files.resize(fileCount);
+        for (FileEntry& f : files) {
+            uint8_t binary = 0;
+            ok = r.string(f.path) && r.pod(f.size) && r.pod(f.mtime) && r.pod(binary);
+            if (!ok) break;
+            f.binary = binary != 0;
+            f.live = true;
+        }
+    }
+    ok = ok && r.pod(keyCount) && size_t(r.end - r.p) / sizeof(uint32_t) >= keyCount;
+    if (ok) {
+        keys.resize(keyCount);
+        offsets.resize(size_t(keyCount) + 1);
+        ok = r.bytes(keys.data(), keys.size() * sizeof(uint32_t)) &&
+             r.bytes(offsets.data(), offsets.size() * sizeof(uint64_t)) && offsets[0] == 0 &&
+             offsets.back() == uint64_t(r.end - r.p);
+    }
+    for (size_t k = 0; ok && k < keys.size(); ++k) {
+        ok = keys[k] < kTrigramSpace && (k == 0 || keys[k] > keys[k - 1]) && offsets[k + 1] >= offsets[k];
+    }
+    uint64_t postings = 0;
+    if (ok) {
+        blob.assign(reinterpret_cast<const uint8_t*>(r.p), reinterpret_cast<const uint8_t*>(r.end));
+        // Every id must name a file, or a query could index past the table
+        for (size_t k = 0; ok && k < keys.size(); ++k) {
+            decodeList(blob.data() + offsets[k], blob.data() + offsets[k + 1], [&](uint32_t id) {
+                ok = ok && id < fileCount;
+                ++postings;
+            });
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    clearLocked();
+    if (!ok) return false;
+    m_root = root;
+    m_files = std::move(files);
+    for (size_t id = 0; id < m_files.size(); ++id) m_ids[m_files[id].path] = uint32_t(id);
+    m_liveFiles = m_files.size();
+    m_keys = std::move(keys);
+    m_offsets = std::move(offsets);
+    m_blob = std::move(blob);
+    m_postings = postings;
+    m_firstOverlayId = uint32_t(m_files.size());
+    return true;
+}
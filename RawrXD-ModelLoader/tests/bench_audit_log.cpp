@@ -0,0 +1,387 @@
+// AuditLog against ComplianceLogger's previous write path: a mutex around
+// format-write-flush on the calling thread, with and without an fsync per
+// event. Before timing, every record from concurrent producers must read back
+// once and in per-producer order, a time-range read must return exactly the
+// records in range by seeking through the index, a corrupted frame must be
+// skipped without losing its neighbours, reopening after a torn write must
+// repair the index and truncate the tail, Drop must account for every refused
+// record, Block must lose nothing, retention must delete whole segments, and
+// flush() must report records the file system refused to take.
+// Timing reports events/s seen by producers and end to end (through flush())
+// for each SyncPolicy.
+#include "audit_log.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <csignal>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  ✗ %s\n", what);
+        ++failures;
+    }
+}
+
+template <typename Fn>
+double time_ms(Fn&& fn) {
+    const auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+constexpr int64_t kBaseMs = 1700000000000;
+
+// Roughly the size of a formatted compliance entry
+std::string MakeLine(int producer, int i) {
+    char buf[192];
+    std::snprintf(buf, sizeof(buf),
+                  "[2024-01-01T00:00:00.000] [AUDIT] [MODEL_ACCESS] User=user%d Action=ModelLoad "
+                  "Resource=models/llama-7b-q4.gguf IP=10.0.0.%d Details=p=%d i=%d",
+                  producer, producer, producer, i);
+    return buf;
+}
+
+bool ParseSeq(const std::string& text, int& producer, int& i) {
+    const size_t at = text.rfind("p=");
+    return at != std::string::npos && std::sscanf(text.c_str() + at, "p=%d i=%d", &producer, &i) == 2;
+}
+
+// The previous ComplianceLogger::writeLogEntry: format, write and flush under one mutex
+struct SyncWriter {
+    std::mutex mutex;
+    std::FILE* file = nullptr;
+    bool fsyncEach = false;
+
+    void log(const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::fwrite(line.data(), 1, line.size(), file);
+        std::fputc('\n', file);
+        std::fflush(file);
+        if (fsyncEach) {
+#ifdef _WIN32
+            _commit(_fileno(file));
+#else
+            fsync(fileno(file));
+#endif
+        }
+    }
+};
+
+// Runs producers that each append perThread records; returns producer-side ms
+template <typename Fn>
+double RunProducers(int producers, int perThread, Fn&& log) {
+    std::vector<std::thread> pool;
+    return time_ms([&] {
+        for (int p = 0; p < producers; ++p) {
+            pool.emplace_back([&, p] {
+                for (int i = 0; i < perThread; ++i) log(p, i);
+            });
+        }
+        for (auto& th : pool) th.join();
+    });
+}
+
+double SyncWriterRate(const fs::path& dir, int producers, int perThread, bool fsyncEach) {
+    SyncWriter writer;
+    writer.file = std::fopen((dir / "baseline.log").string().c_str(), "wb");
+    writer.fsyncEach = fsyncEach;
+    const double ms = RunProducers(producers, perThread, [&](int p, int i) { writer.log(MakeLine(p, i)); });
+    std::fclose(writer.file);
+    fs::remove(dir / "baseline.log");
+    return double(producers) * perThread * 1000.0 / ms;
+}
+
+struct Rates {
+    double enqueue = 0.0;
+    double endToEnd = 0.0;
+    uint64_t batches = 0;
+    uint64_t syncs = 0;
+};
+
+Rates AuditLogRate(const fs::path& dir, int producers, int perThread, AuditLog::SyncPolicy sync) {
+    std::error_code ec;
+    fs::remove_all(dir / "rate", ec);
+    AuditLog log;
+    AuditLog::Options options;
+    options.sync = sync;
+    options.syncIntervalMs = 50;
+    log.open((dir / "rate" / "audit").string(), options);
+    Rates r;
+    double enqueueMs = 0.0;
+    const double totalMs = time_ms([&] {
+        enqueueMs = RunProducers(producers, perThread, [&](int p, int i) {
+            log.append({kBaseMs + i, 4, MakeLine(p, i)});
+        });
+        log.flush();
+    });
+    const double events = double(producers) * perThread;
+    r.enqueue = events * 1000.0 / enqueueMs;
+    r.endToEnd = events * 1000.0 / totalMs;
+    r.batches = log.stats().batches;
+    r.syncs = log.stats().syncs;
+    log.close();
+    fs::remove_all(dir / "rate", ec);
+    return r;
+}
+
+} // namespace
+
+int main() {
+    std::puts("=== AuditLog ===");
+
+    const fs::path dir = fs::temp_directory_path() / "rawrxd_bench_audit_log";
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir);
+
+    const int producers = std::max(4u, std::thread::hardware_concurrency());
+    constexpr int kPerProducer = 20000;
+    const uint64_t total = uint64_t(producers) * kPerProducer;
+
+    // Concurrent producers: everything reads back once, in per-producer order
+    const std::string base = (dir / "main" / "audit").string();
+    {
+        AuditLog log;
+        AuditLog::Options options;
+        options.maxBatch = 512;
+        options.seal = [](AuditRecord& r) { r.text += " Checksum=sealed"; };
+        Check(log.open(base, options), "open creates the log");
+        RunProducers(producers, kPerProducer, [&](int p, int i) {
+            log.append({kBaseMs + i, uint32_t(p % 2 ? 3 : 4), MakeLine(p, i)});
+        });
+        Check(log.flush(), "flush returns once everything is written");
+        Check(log.stats().written == total, "writer wrote every record");
+        log.close();
+    }
+    AuditLog reader;
+    Check(reader.open(base), "reopen existing segments");
+    std::vector<int> next(size_t(producers), 0);
+    bool ordered = true;
+    bool sealed = true;
+    size_t fullCount = 0;
+    const double fullMs = time_ms([&] {
+        fullCount = reader.read(INT64_MIN, INT64_MAX, [&](const AuditRecord& r) {
+            int p = -1;
+            int i = -1;
+            if (!ParseSeq(r.text, p, i) || p < 0 || p >= producers || i != next[size_t(p)]++ ||
+                r.timestampMs != kBaseMs + i) {
+                ordered = false;
+            }
+            if (r.text.size() < 15 || r.text.compare(r.text.size() - 15, 15, "Checksum=sealed") != 0) sealed = false;
+        });
+    });
+    Check(fullCount == total, "every record reads back");
+    Check(ordered, "records keep per-producer order and timestamps");
+    Check(sealed, "seal hook ran on every record");
+
+    // Range read seeks by index
+    const int64_t lo = kBaseMs + kPerProducer / 2;
+    const int64_t hi = lo + 99;
+    size_t inRange = 0;
+    bool allInRange = true;
+    size_t rangeCount = 0;
+    const double rangeMs = time_ms([&] {
+        rangeCount = reader.read(lo, hi, [&](const AuditRecord& r) {
+            ++inRange;
+            if (r.timestampMs < lo || r.timestampMs > hi) allInRange = false;
+        });
+    });
+    Check(rangeCount == inRange && inRange == size_t(producers) * 100, "range read returns exactly the range");
+    Check(allInRange, "range read returns nothing outside the range");
+    Check(reader.read(kBaseMs - 1000, kBaseMs - 1, [](const AuditRecord&) {}) == 0, "empty range reads nothing");
+    reader.close();
+
+    // Crash recovery: index lags the segment and the segment has a torn tail
+    const std::string crashBase = (dir / "crash" / "audit").string();
+    std::string segPath;
+    {
+        AuditLog log;
+        AuditLog::Options options;
+        options.maxBatch = 100;
+        log.open(crashBase, options);
+        for (int i = 0; i < 1000; ++i) {
+            log.append({kBaseMs + i, 4, MakeLine(0, i)});
+            if (i % 100 == 99) log.flush();   // At least ten frames
+        }
+        log.close();
+        segPath = crashBase + ".000001.seg";
+    }
+    const uint64_t cleanBytes = fs::file_size(segPath);
+    fs::resize_file(crashBase + ".000001.idx", fs::file_size(crashBase + ".000001.idx") - 32 - 7);
+    if (std::FILE* f = std::fopen(segPath.c_str(), "ab")) {
+        std::fwrite("RXA1 torn frame", 1, 15, f);
+        std::fclose(f);
+    }
+    {
+        AuditLog log;
+        log.open(crashBase);
+        Check(log.read(INT64_MIN, INT64_MAX, [](const AuditRecord&) {}) == 1000, "recovery re-indexes unindexed frames");
+        log.close();
+    }
+    Check(fs::file_size(segPath) == cleanBytes, "recovery truncates the torn tail");
+
+    // A corrupted frame is skipped, its neighbours survive
+    if (std::FILE* f = std::fopen(segPath.c_str(), "r+b")) {
+        std::fseek(f, 100, SEEK_SET);
+        const int c = std::fgetc(f);
+        std::fseek(f, 100, SEEK_SET);
+        std::fputc(c ^ 0x5A, f);
+        std::fclose(f);
+    }
+    {
+        AuditLog log;
+        log.open(crashBase);
+        int first = -1;
+        const size_t n = log.read(INT64_MIN, INT64_MAX, [&](const AuditRecord& r) {
+            if (first < 0) first = int(r.timestampMs - kBaseMs);
+        });
+        Check(first > 0 && n == size_t(1000 - first), "CRC rejects the damaged frame only");
+        log.close();
+    }
+
+    // Backpressure: a tiny ring and a slow writer
+    constexpr int kPressure = 5000;
+    const uint64_t attempts = uint64_t(producers) * kPressure;
+    for (auto policy : {AuditLog::Backpressure::Drop, AuditLog::Backpressure::Block}) {
+        fs::remove_all(dir / "pressure", ec);
+        AuditLog log;
+        AuditLog::Options options;
+        options.ringCapacity = 64;
+        options.maxBatch = 16;
+        options.sync = AuditLog::SyncPolicy::None;
+        options.backpressure = policy;
+        options.seal = [](AuditRecord&) { std::this_thread::sleep_for(std::chrono::microseconds(20)); };
+        log.open((dir / "pressure" / "audit").string(), options);
+        std::atomic<uint64_t> accepted{0};
+        RunProducers(producers, kPressure, [&](int p, int i) {
+            if (log.append({kBaseMs + i, 4, MakeLine(p, i)})) accepted.fetch_add(1, std::memory_order_relaxed);
+        });
+        log.flush();
+        const AuditLog::Stats s = log.stats();
+        if (policy == AuditLog::Backpressure::Drop) {
+            Check(s.dropped > 0, "Drop refuses records when the ring is full");
+            Check(s.appended + s.dropped == attempts && s.appended == accepted, "Drop accounts for every attempt");
+            Check(s.written == s.appended, "Drop writes every accepted record");
+            std::printf("Drop: %llu of %llu refused with a 64-slot ring\n", (unsigned long long)s.dropped,
+                        (unsigned long long)attempts);
+        } else {
+            Check(s.dropped == 0 && s.written == attempts && accepted == attempts, "Block loses nothing");
+        }
+        log.close();
+    }
+
+    // Rotation and retention
+    {
+        const std::string rotBase = (dir / "rotate" / "audit").string();
+        AuditLog log;
+        AuditLog::Options options;
+        options.segmentBytes = 16 * 1024;
+        options.maxBatch = 50;
+        log.open(rotBase, options);
+        for (int i = 0; i < 2000; ++i) {
+            log.append({kBaseMs + i, 4, MakeLine(0, i)});
+            if (i % 50 == 49) log.flush();
+        }
+        log.rotate();
+        log.append({kBaseMs + 5000, 4, MakeLine(0, 5000)});
+        log.flush();
+        const uint32_t segments = log.stats().segments;
+        Check(segments > 4, "segmentBytes starts new segments");
+        const size_t removed = log.removeSegmentsBefore(kBaseMs + 1000);
+        Check(removed > 0 && log.stats().segments == segments - removed, "retention removes old segments");
+        size_t kept = 0;
+        int64_t oldest = INT64_MAX;
+        log.read(INT64_MIN, INT64_MAX, [&](const AuditRecord& r) {
+            ++kept;
+            oldest = std::min(oldest, r.timestampMs);
+        });
+        Check(oldest <= kBaseMs + 1000 && oldest > kBaseMs, "retention keeps segments that reach the cutoff");
+        Check(kept == size_t(2001 - (oldest - kBaseMs)), "retention removes whole segments only");
+        log.removeSegmentsBefore(INT64_MAX);
+        Check(log.stats().segments == 1 &&
+                  log.read(INT64_MIN, INT64_MAX, [](const AuditRecord&) {}) == 1,
+              "the segment being written is never removed");
+        log.close();
+    }
+
+#ifndef _WIN32
+    // A file size limit makes the next frame's write fail
+    {
+        const std::string failBase = (dir / "fail" / "audit").string();
+        AuditLog log;
+        log.open(failBase, AuditLog::Options());
+        log.append({kBaseMs, 4, MakeLine(0, 0)});
+        Check(log.flush(), "flush succeeds before the failure");
+
+        std::signal(SIGXFSZ, SIG_IGN);
+        rlimit limit{};
+        getrlimit(RLIMIT_FSIZE, &limit);
+        const rlimit saved = limit;
+        limit.rlim_cur = rlim_t(log.stats().bytes + 16);
+        setrlimit(RLIMIT_FSIZE, &limit);
+        log.append({kBaseMs + 1, 4, MakeLine(0, 1)});
+        while (log.stats().writeErrors == 0) std::this_thread::yield();
+        const bool refused = log.flush();
+        setrlimit(RLIMIT_FSIZE, &saved);
+        Check(!refused, "flush reports a record that failed to write");
+
+        log.append({kBaseMs + 2, 4, MakeLine(0, 2)});
+        Check(log.flush(), "the next flush succeeds once writes do");
+        Check(log.read(INT64_MIN, INT64_MAX, [](const AuditRecord&) {}) == 2, "the failed record is not read back");
+        log.close();
+    }
+#endif
+
+    // Throughput
+    constexpr int kRatePerProducer = 50000;
+    constexpr int kFsyncPerProducer = 250;
+    const double flushRate = SyncWriterRate(dir, producers, kRatePerProducer, false);
+    const double fsyncRate = SyncWriterRate(dir, producers, kFsyncPerProducer, true);
+    const Rates none = AuditLogRate(dir, producers, kRatePerProducer, AuditLog::SyncPolicy::None);
+    const Rates interval = AuditLogRate(dir, producers, kRatePerProducer, AuditLog::SyncPolicy::Interval);
+    const Rates every = AuditLogRate(dir, producers, kRatePerProducer, AuditLog::SyncPolicy::EveryBatch);
+
+    std::printf("\n%llu records from %d producers, %u hardware threads\n", (unsigned long long)total, producers,
+                std::thread::hardware_concurrency());
+    std::printf("full read %.1f ms, 100 ms range read %.2f ms\n", fullMs, rangeMs);
+    std::printf("%-36s %14s %14s %9s %7s\n", "", "enqueue ev/s", "durable ev/s", "batches", "syncs");
+    std::printf("%-36s %14.0f %14s\n", "mutex + write + fflush per event", flushRate, "-");
+    std::printf("%-36s %14.0f %14.0f\n", "mutex + write + fsync per event", fsyncRate, fsyncRate);
+    std::printf("%-36s %14.0f %14.0f %9llu %7llu\n", "AuditLog, SyncPolicy::None", none.enqueue, none.endToEnd,
+                (unsigned long long)none.batches, (unsigned long long)none.syncs);
+    std::printf("%-36s %14.0f %14.0f %9llu %7llu\n", "AuditLog, SyncPolicy::Interval", interval.enqueue,
+                interval.endToEnd, (unsigned long long)interval.batches, (unsigned long long)interval.syncs);
+    std::printf("%-36s %14.0f %14.0f %9llu %7llu\n", "AuditLog, SyncPolicy::EveryBatch", every.enqueue,
+                every.endToEnd, (unsigned long long)every.batches, (unsigned long long)every.syncs);
+
+    Check(rangeMs < fullMs, "range read is faster than a full scan");
+    Check(none.enqueue > flushRate, "enqueue beats the synchronous write path");
+    Check(every.endToEnd > fsyncRate * 5.0, "group commit beats fsync per event by 5x");
+
+    fs::remove_all(dir, ec);
+    if (failures) {
+        std::printf("❌ AUDIT LOG: %d check(s) failed\n", failures);
+        return 1;
+    }
+    std::puts("✅ AUDIT LOG: batched writer keeps every record, readable by time range");
+    return 0;
+}
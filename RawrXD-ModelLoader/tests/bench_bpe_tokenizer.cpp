@@ -0,0 +1,379 @@
+// BPE encode throughput (MB/s) on a 48 KB code context, the size of the
+// prompts the IDE sends. Pass a GGUF model to use its tokenizer.ggml.tokens
+// and tokenizer.ggml.merges; without one, a GGUF-style byte-level vocabulary
+// is trained on a separate synthetic corpus. Before timing, pre-tokens are
+// checked against the GPT-2 regex and ids against the previous string-pair
+// merge loop, for every thread / cache configuration.
+#include "bpe_tokenizer.hpp"
+#include "gguf_parser.h"
+#include <QRegularExpression>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  ✗ %s\n", what);
+        ++failures;
+    }
+}
+
+// GPT-2 bytes_to_unicode
+std::vector<QChar> ByteChars() {
+    std::vector<int> bytes;
+    for (int i = 33; i <= 126; ++i) bytes.push_back(i);
+    for (int i = 161; i <= 172; ++i) bytes.push_back(i);
+    for (int i = 174; i <= 255; ++i) bytes.push_back(i);
+    std::vector<QChar> chars(256);
+    for (int b : bytes) chars[b] = QChar(b);
+    int n = 0;
+    for (int b = 0; b < 256; ++b) {
+        if (std::find(bytes.begin(), bytes.end(), b) == bytes.end()) chars[b] = QChar(256 + n++);
+    }
+    return chars;
+}
+
+// C++-like source: indented statements over a fixed vocabulary of keywords,
+// compound identifiers with numeric suffixes (the long tail), literals,
+// comments with contractions and some non-ASCII text
+QString MakeCodeContext(unsigned seed, size_t bytes) {
+    static const char* kWords[] = {
+        "int", "return", "const", "auto", "std", "vector", "size_t", "tokenizer", "encode",
+        "merge", "buffer", "offset", "length", "result", "QString", "m_vocab", "index", "for",
+        "if", "else", "while", "static_cast", "uint32_t", "nullptr", "true", "false", "template",
+        "typename", "namespace", "model", "layer", "tensor", "weights", "cache", "thread",
+        "count", "value", "push_back", "reserve", "emplace", "begin", "end", "data", "size",
+    };
+    static const char* kOps[] = {"(", ")", "->", "::", " += ", " == ", " = ", "; ", ", ", "[", "]", " < ", " && "};
+    static const char* kComments[] = {
+        "// it's the caller's job to keep views alive",
+        "// we're done once the heap is empty, they'll retry",
+        "// naïve café résumé: don't split multi-byte runs",
+        "// 日本語のコメント → mixed scripts ½",
+        "//   aligned    columns\t\ttabs",
+    };
+    const int nWords = int(sizeof(kWords) / sizeof(kWords[0]));
+    const int nOps = int(sizeof(kOps) / sizeof(kOps[0]));
+    const int nComments = int(sizeof(kComments) / sizeof(kComments[0]));
+
+    std::mt19937 rng(seed);
+    std::string out;
+    int depth = 0;
+    while (out.size() < bytes) {
+        out.append(size_t(depth) * 4, ' ');
+        const unsigned kind = rng() % 10;
+        if (kind == 0) {
+            out += kComments[rng() % nComments];
+        } else if (kind == 1 && depth < 4) {
+            out += std::string(kWords[rng() % nWords]) + " (" + kWords[rng() % nWords] + ") {";
+            ++depth;
+        } else if (kind == 2 && depth > 0) {
+            out.resize(out.size() - 4);
+            out += "}";
+            --depth;
+        } else {
+            const int terms = 2 + int(rng() % 6);
+            for (int t = 0; t < terms; ++t) {
+                const unsigned r = rng() % 8;
+                if (r < 4) {
+                    out += kWords[rng() % nWords];
+                } else if (r < 6) {
+                    out += std::string(kWords[rng() % nWords]) + "_" + kWords[rng() % nWords] + std::to_string(rng() % 100);
+                } else if (r == 6) {
+                    out += std::to_string(rng() % 100000);
+                } else {
+                    out += "\"it's " + std::string(kWords[rng() % nWords]) + "\"";
+                }
+                out += kOps[rng() % nOps];
+            }
+            out += ";";
+        }
+        out += "\n";
+    }
+    return QString::fromUtf8(out.data(), qsizetype(out.size()));
+}
+
+// Same packing as GGUFLoader::getTokenizerMetadata
+bool LoadGGUFTokenizer(const char* path, QHash<QString, QByteArray>& metadata) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    const uint64_t fileSize = uint64_t(file.tellg());
+    gguf::Parser parser;
+    const auto status = parser.ParseFrom([&](uint64_t offset, void* dst, size_t n) -> size_t {
+        file.seekg(std::streamoff(offset));
+        file.read(static_cast<char*>(dst), std::streamsize(n));
+        return size_t(file.gcount());
+    }, fileSize);
+    if (status != gguf::Parser::Status::Ok) return false;
+
+    const gguf::Value* tokens = parser.Find("tokenizer.ggml.tokens");
+    const gguf::Value* merges = parser.Find("tokenizer.ggml.merges");
+    if (!tokens || !merges) return false;
+
+    QByteArray packed;
+    const qint32 count = qint32(tokens->ArraySize());
+    packed.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (std::string_view token : tokens->Strings()) {
+        const quint32 len = quint32(token.size());
+        packed.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        packed.append(token.data(), qsizetype(token.size()));
+    }
+    metadata.insert("tokenizer.ggml.tokens", packed);
+
+    QByteArray text;
+    for (std::string_view merge : merges->Strings()) {
+        text.append(merge.data(), qsizetype(merge.size()));
+        text.append('\n');
+    }
+    metadata.insert("tokenizer.ggml.merges", text);
+    return true;
+}
+
+// Byte-level BPE training: repeatedly merge the most frequent adjacent pair
+// over the corpus' pre-tokens, emitting tokens and merges in GGUF layout
+QHash<QString, QByteArray> TrainVocabulary(const QString& corpus, int maxMerges) {
+    const std::vector<QChar> byteChars = ByteChars();
+    std::vector<QString> tokens;
+    for (int b = 0; b < 256; ++b) tokens.push_back(QString(byteChars[b]));
+
+    std::unordered_map<std::string, int> freq;
+    BPETokenizer splitter;
+    for (const QString& piece : splitter.preTokenize(corpus)) {
+        const QByteArray utf8 = piece.toUtf8();
+        ++freq[std::string(utf8.constData(), size_t(utf8.size()))];
+    }
+    struct Word { std::vector<int> symbols; int freq; };
+    std::vector<Word> words;
+    for (const auto& entry : freq) {
+        Word w{{}, entry.second};
+        for (unsigned char c : entry.first) w.symbols.push_back(c);
+        words.push_back(std::move(w));
+    }
+
+    QByteArray mergesText;
+    for (int m = 0; m < maxMerges; ++m) {
+        std::unordered_map<uint64_t, long> counts;
+        for (const Word& w : words) {
+            for (size_t i = 0; i + 1 < w.symbols.size(); ++i) {
+                counts[(uint64_t(w.symbols[i]) << 32) | uint32_t(w.symbols[i + 1])] += w.freq;
+            }
+        }
+        uint64_t best = 0;
+        long bestCount = 1;
+        for (const auto& entry : counts) {
+            if (entry.second > bestCount || (entry.second == bestCount && bestCount > 1 && entry.first < best)) {
+                best = entry.first;
+                bestCount = entry.second;
+            }
+        }
+        if (bestCount < 2) break;
+
+        const int left = int(best >> 32), right = int(best & 0xFFFFFFFF);
+        const int merged = int(tokens.size());
+        tokens.push_back(tokens[left] + tokens[right]);
+        mergesText += (tokens[left] + " " + tokens[right]).toUtf8() + "\n";
+        for (Word& w : words) {
+            std::vector<int> next;
+            next.reserve(w.symbols.size());
+            for (size_t i = 0; i < w.symbols.size(); ++i) {
+                if (i + 1 < w.symbols.size() && w.symbols[i] == left && w.symbols[i + 1] == right) {
+                    next.push_back(merged);
+                    ++i;
+                } else {
+                    next.push_back(w.symbols[i]);
+                }
+            }
+            w.symbols.swap(next);
+        }
+    }
+
+    QByteArray packed;
+    const qint32 count = qint32(tokens.size());
+    packed.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const QString& token : tokens) {
+        const QByteArray utf8 = token.toUtf8();
+        const quint32 len = quint32(utf8.size());
+        packed.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        packed.append(utf8);
+    }
+    QHash<QString, QByteArray> metadata;
+    metadata.insert("tokenizer.ggml.tokens", packed);
+    metadata.insert("tokenizer.ggml.merges", mergesText);
+    return metadata;
+}
+
+// The previous encoder: per pre-token, rescan every adjacent string pair for
+// the best-ranked merge and rebuild the symbol vector after each one
+class ReferenceBPE {
+public:
+    explicit ReferenceBPE(const QHash<QString, QByteArray>& metadata) : byteChars_(ByteChars()) {
+        const QByteArray tokens = metadata.value("tokenizer.ggml.tokens");
+        const char* p = tokens.constData();
+        qint32 count;
+        std::memcpy(&count, p, sizeof(count));
+        p += sizeof(count);
+        for (qint32 i = 0; i < count; ++i) {
+            quint32 len;
+            std::memcpy(&len, p, sizeof(len));
+            p += sizeof(len);
+            vocab_.insert(QString::fromUtf8(p, qsizetype(len)), i);
+            p += len;
+        }
+        int rank = 0;
+        for (const QString& line : QString::fromUtf8(metadata.value("tokenizer.ggml.merges")).split('\n')) {
+            const QStringList parts = line.split(' ');
+            if (parts.size() >= 2 && !merges_.contains(qMakePair(parts[0], parts[1]))) {
+                merges_.insert(qMakePair(parts[0], parts[1]), rank);
+            }
+            ++rank;
+        }
+    }
+
+    std::vector<int32_t> encode(const QStringList& pieces, int32_t unk) const {
+        std::vector<int32_t> result;
+        for (const QString& piece : pieces) {
+            QVector<QString> symbols;
+            for (char c : piece.toUtf8()) symbols.append(QString(byteChars_[uint8_t(c)]));
+            while (symbols.size() > 1) {
+                int bestIdx = -1, bestRank = INT32_MAX;
+                for (int i = 0; i + 1 < symbols.size(); ++i) {
+                    auto it = merges_.constFind(qMakePair(symbols[i], symbols[i + 1]));
+                    if (it != merges_.constEnd() && *it < bestRank) {
+                        bestRank = *it;
+                        bestIdx = i;
+                    }
+                }
+                if (bestIdx < 0) break;
+                QVector<QString> next;
+                for (int i = 0; i < symbols.size(); ++i) {
+                    if (i == bestIdx) {
+                        next.append(symbols[i] + symbols[i + 1]);
+                        ++i;
+                    } else {
+                        next.append(symbols[i]);
+                    }
+                }
+                symbols = next;
+            }
+            for (const QString& s : symbols) result.push_back(vocab_.value(s, unk));
+        }
+        return result;
+    }
+
+private:
+    std::vector<QChar> byteChars_;
+    QHash<QString, int32_t> vocab_;
+    QHash<QPair<QString, QString>, int> merges_;
+};
+
+QStringList RegexPreTokens(const QString& text) {
+    static const QRegularExpression pattern(
+        "'s|'t|'re|'ve|'m|'ll|'d| ?\\p{L}+| ?\\p{N}+| ?[^\\s\\p{L}\\p{N}]+|\\s+(?!\\S)|\\s+",
+        QRegularExpression::UseUnicodePropertiesOption);
+    QStringList result;
+    QRegularExpressionMatchIterator it = pattern.globalMatch(text);
+    while (it.hasNext()) result.append(it.next().captured(0));
+    return result;
+}
+
+template <typename Fn>
+double time_ms(Fn&& fn, double budget_ms) {
+    fn();
+    int iters = 0;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    double elapsed = 0.0;
+    do {
+        fn();
+        ++iters;
+        elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+    } while (elapsed < budget_ms);
+    return elapsed / iters;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::printf("=== BPE Tokenizer Bench ===\n");
+
+    QHash<QString, QByteArray> metadata;
+    if (argc > 1) {
+        if (!LoadGGUFTokenizer(argv[1], metadata)) {
+            std::printf("❌ BPE: no BPE tokenizer in %s\n", argv[1]);
+            return 1;
+        }
+        std::printf("Vocabulary: %s\n", argv[1]);
+    } else {
+        metadata = TrainVocabulary(MakeCodeContext(1, 256 * 1024), 3000);
+        std::printf("Vocabulary: trained on a synthetic 256 KB corpus (pass a GGUF path to use a model's)\n");
+    }
+
+    BPETokenizer tokenizer;
+    Check(tokenizer.loadFromGGUFMetadata(metadata) && tokenizer.isReady(), "tokenizer loads from GGUF metadata");
+    std::printf("  %d tokens, %d merges\n", tokenizer.vocabSize(), tokenizer.mergeCount());
+
+    const QString context = MakeCodeContext(2, 48 * 1024);
+    const double mb = double(context.toUtf8().size()) / 1e6;
+
+    // Pre-tokenizer against the regex, including whitespace and contraction edges
+    const QString edges = QString::fromUtf8("I'm  here,\tyou're   'there'  x \n\n  y's 'LL 12ab３４ ½ naïve　日本 ");
+    Check(tokenizer.preTokenize(context) == RegexPreTokens(context), "pre-tokens of the code context match the GPT-2 regex");
+    Check(tokenizer.preTokenize(edges) == RegexPreTokens(edges), "pre-tokens of the edge cases match the GPT-2 regex");
+
+    // Ids against the previous encoder, for every configuration
+    const ReferenceBPE reference(metadata);
+    const std::vector<int32_t> expected = reference.encode(tokenizer.preTokenize(context), tokenizer.unkToken());
+    const std::vector<int32_t> expectedEdges = reference.encode(tokenizer.preTokenize(edges), tokenizer.unkToken());
+    const int threads = std::max(4, int(std::thread::hardware_concurrency()));
+
+    tokenizer.setThreadCount(1);
+    tokenizer.setWordCacheCapacity(0);
+    Check(tokenizer.encode(context) == expected, "single thread, no cache matches the reference");
+    Check(tokenizer.encode(edges) == expectedEdges, "edge cases match the reference");
+    tokenizer.setWordCacheCapacity(8192);
+    tokenizer.encode(context);
+    Check(tokenizer.encode(context) == expected, "warm word cache matches the reference");
+    tokenizer.setWordCacheCapacity(64);
+    Check(tokenizer.encode(context) == expected, "evicting word cache matches the reference");
+    tokenizer.setThreadCount(threads);
+    Check(tokenizer.encode(context) == expected, "multi-threaded encode matches the reference");
+    std::printf("  %zu tokens from %.1f KB (%.2f bytes/token)\n", expected.size(), mb * 1e3, mb * 1e6 / double(expected.size()));
+
+    struct Config { int threads; size_t cache; };
+    const Config configs[] = {{1, 0}, {1, 8192}, {threads, 0}, {threads, 8192}};
+    const double msRef = time_ms([&] { reference.encode(tokenizer.preTokenize(context), tokenizer.unkToken()); }, 500.0);
+    std::printf("\n%-26s %10s %10s %8s\n", "encoder", "ms", "MB/s", "speedup");
+    std::printf("%-26s %10.3f %10.2f %7.1fx\n", "reference (string pairs)", msRef, mb / (msRef / 1e3), 1.0);
+    double coldSpeedup = 0.0;
+    for (const Config& c : configs) {
+        tokenizer.setThreadCount(c.threads);
+        tokenizer.setWordCacheCapacity(c.cache);
+        const double ms = time_ms([&] { tokenizer.encode(context); }, 500.0);
+        if (c.threads == 1 && c.cache == 0) coldSpeedup = msRef / ms;
+        char name[64];
+        std::snprintf(name, sizeof(name), "%d thread%s, %s", c.threads, c.threads > 1 ? "s" : "",
+                      c.cache ? "warm cache" : "no cache");
+        std::printf("%-26s %10.3f %10.2f %7.1fx\n", name, ms, mb / (ms / 1e3), msRef / ms);
+    }
+
+    if (failures) {
+        std::printf("❌ BPE: %d check(s) failed\n", failures);
+        return 1;
+    }
+    if (coldSpeedup >= 5.0) {
+        std::puts("✅ BPE: >= 5× single-thread speedup over the string-pair encoder");
+        return 0;
+    }
+    std::printf("❌ BPE: %.1fx single-thread speedup (target: >= 5×)\n", coldSpeedup);
+    return 1;
+}
@@ -0,0 +1,402 @@
+// Context::Indexer on a generated C++ tree (default ~12 MB; pass a directory
+// to time a real tree instead). Compares the tokenizer-based parallel build
+// against the previous indexer: four std::regex per file, up to four
+// regex_search calls per line, one thread. Before timing, a hand-written
+// snippet must yield exactly the expected declarations, the generated tree
+// must yield exactly the symbols planted in it, thread count must not change
+// the result, unchanged files must be skipped (by mtime, then by content
+// hash), edits and deletions must update every lookup, and a saved index
+// must load back identical.
+#include "context/indexer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <regex>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace RawrXD::Context;
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  ✗ %s\n", what);
+        ++failures;
+    }
+}
+
+template <typename Fn>
+double time_ms(Fn&& fn) {
+    const auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+using SymbolKey = std::tuple<std::string, std::string, std::string, int>;
+
+SymbolKey Key(const Symbol& s) {
+    return SymbolKey(s.file, s.name, s.kind, s.line);
+}
+
+// Every symbol in the index, through findInFile
+std::vector<SymbolKey> AllSymbols(const Indexer& index, const std::vector<std::string>& files) {
+    std::vector<SymbolKey> out;
+    for (const std::string& f : files) {
+        for (const Symbol& s : index.findInFile(f)) out.push_back(Key(s));
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+// The previous Indexer::indexFile()
+size_t LegacyIndexFile(const std::string& path) {
+    std::ifstream ifs(path);
+    if (!ifs) return 0;
+    std::string line;
+    size_t found = 0;
+
+    std::regex re_func(R"((?:^|\s)(?:[\w:\\*&<>]+)\s+([A-Za-z_][A-Za-z0-9_]*)\s*\([^;]*\)\s*\{)");
+    std::regex re_class(R"((?:^|\s)class\s+([A-Za-z_][A-Za-z0-9_]*)\s*)");
+    std::regex re_struct(R"((?:^|\s)struct\s+([A-Za-z_][A-Za-z0-9_]*)\s*)");
+    std::regex re_var(R"((?:^|\s)(?:int|float|double|bool|auto|std::\w+)\s+([A-Za-z_][A-Za-z0-9_]*)\s*(=|;))");
+
+    while (std::getline(ifs, line)) {
+        std::smatch m;
+        if (std::regex_search(line, m, re_class) || std::regex_search(line, m, re_struct) ||
+            std::regex_search(line, m, re_func) || std::regex_search(line, m, re_var)) {
+            ++found;
+        }
+    }
+    return found;
+}
+
+const char* const kSnippet = R"SNIP(#include <vector>
+#define BRACE {
+#define MULTI(x) \
+    struct NotThis {
+/* class Commented { */
+// struct AlsoCommented {
+namespace app {
+namespace detail { int helperCount = 0; }
+class Forward;
+struct Point { int x, y; };
+template <class T> class Box final : public Base<T> {
+    Q_OBJECT
+public slots:
+    int size() const { return n; }
+    bool operator==(const Box& o) const { return n == o.n; }
+    operator bool() const { return n != 0; }
+    T values[4];
+private:
+    static constexpr int kLimit = 8;
+    int n = 0;
+    void declared(int);
+    virtual void pure() = 0;
+};
+enum class Color : unsigned char { Red, Green };
+union Bits { int i; float f; };
+Box<int>::Box(int a) : n{a}, m_s("{") {
+    auto lambda = [](int q) { struct Local { int z; }; return q; };
+    const char* s = "} class Fake {";
+    const char* raw = R"x(} struct Fake2 {)x";
+}
+Box<int>::~Box() {}
+std::vector<int> table{1, 2, 3};
+const char* names[] = {"a", "b"};
+static int counter, *cursor;
+extern "C" {
+int c_entry(void) { return 0; }
+}
+template <typename K, typename V = std::vector<K>>
+V transform(const K& key) {
+    if (key) { return {}; }
+}
+} // namespace app
+)SNIP";
+
+struct Expected {
+    const char* name;
+    const char* kind;
+    int line;
+};
+
+const Expected kExpected[] = {
+    {"helperCount", "variable", 8},
+    {"Point", "struct", 10},
+    {"x", "variable", 10},
+    {"y", "variable", 10},
+    {"Box", "class", 11},
+    {"size", "function", 14},
+    {"operator==", "function", 15},
+    {"operator bool", "function", 16},
+    {"values", "variable", 17},
+    {"kLimit", "variable", 19},
+    {"n", "variable", 20},
+    {"Color", "enum", 24},
+    {"Bits", "union", 25},
+    {"i", "variable", 25},
+    {"f", "variable", 25},
+    {"Box", "function", 26},
+    {"~Box", "function", 31},
+    {"table", "variable", 32},
+    {"names", "variable", 33},
+    {"counter", "variable", 34},
+    {"cursor", "variable", 34},
+    {"c_entry", "function", 36},
+    {"transform", "function", 39},
+};
+
+void WriteFile(const fs::path& path, const std::string& text) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary) << text;
+}
+
+struct Tree {
+    std::vector<std::string> files;
+    std::vector<SymbolKey> symbols;  // Planted declarations
+    uint64_t bytes = 0;
+};
+
+// Headers and sources with namespaces, classes, members, methods defined in
+// and out of class, free functions and globals; bodies carry statements,
+// lambdas, strings and comments that must not produce symbols
+std::string MakeFile(std::mt19937& rng, const std::string& path, int fileNo, size_t bytes, std::vector<SymbolKey>& symbols) {
+    std::string out = "// Generated for bench_indexer\n#pragma once\n#include <string>\n";
+    int line = 4;
+    auto add = [&](const std::string& text) {
+        out += text;
+        out += '\n';
+        ++line;
+    };
+    auto plant = [&](const std::string& name, const char* kind) { symbols.emplace_back(path, name, kind, line); };
+
+    add("namespace gen" + std::to_string(fileNo % 7) + " {");
+    for (int c = 0; out.size() < bytes; ++c) {
+        const std::string cls = "Widget" + std::to_string(fileNo) + "_" + std::to_string(c);
+        plant(cls, c % 3 ? "class" : "struct");
+        add(std::string(c % 3 ? "class " : "struct ") + cls + " : public Base {");
+        if (c % 3) add("public:");
+        const int members = 2 + int(rng() % 4);
+        for (int m = 0; m < members; ++m) {
+            plant("m_field" + std::to_string(m), "variable");
+            add("    int m_field" + std::to_string(m) + " = " + std::to_string(m) + ";");
+        }
+        plant("inlineGet", "function");
+        add("    int inlineGet() const { return m_field0; }");
+        add("    void declaredOnly(int value);");
+        add("};");
+        add("");
+
+        const int methods = 1 + int(rng() % 3);
+        for (int m = 0; m < methods; ++m) {
+            const std::string fn = "process" + std::to_string(m);
+            plant(fn, "function");
+            add("std::string " + cls + "::" + fn + "(const std::string& input, int count) {");
+            const int statements = 4 + int(rng() % 12);
+            for (int s = 0; s < statements; ++s) {
+                switch (rng() % 5) {
+                case 0: add("    int local" + std::to_string(s) + " = count * " + std::to_string(s) + ";"); break;
+                case 1: add("    if (count > " + std::to_string(s) + ") { count -= 1; }"); break;
+                case 2: add("    auto f" + std::to_string(s) + " = [&](int x) { return x + count; };"); break;
+                case 3: add("    const char* text = \"class NotReal { int x; };\"; // struct Nope {"); break;
+                default: add("    for (int i = 0; i < count; ++i) { /* { */ count ^= i; }"); break;
+                }
+            }
+            add("    return input;");
+            add("}");
+            add("");
+        }
+        if (rng() % 2) {
+            const std::string g = "g_total" + std::to_string(c);
+            plant(g, "variable");
+            add("static int " + g + " = 0;");
+        }
+    }
+    add("} // namespace");
+    return out;
+}
+
+Tree MakeTree(const fs::path& root, size_t totalBytes) {
+    std::mt19937 rng(41);
+    Tree tree;
+    fs::remove_all(root);
+    size_t made = 0;
+    for (int i = 0; made < totalBytes; ++i) {
+        const fs::path path = root / ("m" + std::to_string(i % 23)) / ("unit" + std::to_string(i) + (i % 2 ? ".cpp" : ".h"));
+        const std::string text = MakeFile(rng, path.string(), i, 1000 + rng() % 14000, tree.symbols);
+        WriteFile(path, text);
+        tree.files.push_back(path.string());
+        tree.bytes += text.size();
+        made += text.size();
+    }
+    WriteFile(root / "README.md", "Nothing to index here.\n");
+    tree.files.push_back((root / "README.md").string());
+    WriteFile(root / "data.bin", "class Skipped {};\n");  // Not a code file
+    std::sort(tree.files.begin(), tree.files.end());
+    std::sort(tree.symbols.begin(), tree.symbols.end());
+    return tree;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::puts("=== Context::Indexer ===");
+
+    // Declarations read off a hand-written snippet
+    {
+        const std::vector<Symbol> got = Indexer::extractSymbols(kSnippet, std::strlen(kSnippet));
+        std::set<std::tuple<std::string, std::string, int>> want, have;
+        for (const Expected& e : kExpected) want.emplace(e.name, e.kind, e.line);
+        for (const Symbol& s : got) have.emplace(s.name, s.kind, s.line);
+        for (const auto& w : want) {
+            if (!have.count(w)) std::printf("    missing %s %s:%d\n", std::get<1>(w).c_str(), std::get<0>(w).c_str(), std::get<2>(w));
+        }
+        for (const auto& h : have) {
+            if (!want.count(h)) std::printf("    extra %s %s:%d\n", std::get<1>(h).c_str(), std::get<0>(h).c_str(), std::get<2>(h));
+        }
+        Check(want == have && got.size() == want.size(), "snippet yields exactly its declarations");
+    }
+
+    const bool generated = argc < 2;
+    const fs::path root = generated ? fs::temp_directory_path() / "rawrxd_bench_indexer" : fs::path(argv[1]);
+    const std::string rootText = root.string();
+    Tree tree;
+    if (generated) {
+        tree = MakeTree(root, size_t(12) << 20);
+    } else {
+        for (const auto& e : fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied)) {
+            if (e.is_regular_file() && Indexer::isCodeFile(e.path().string())) {
+                tree.files.push_back(e.path().string());
+                tree.bytes += e.file_size();
+            }
+        }
+    }
+
+    const int threads = int(std::max(4u, std::thread::hardware_concurrency()));
+    Indexer index(rootText);
+    index.setThreadCount(threads);
+    IndexStats first;
+    const double buildMs = time_ms([&] { first = index.build(); });
+    Indexer single(rootText);
+    single.setThreadCount(1);
+    const double singleMs = time_ms([&] { single.build(); });
+
+    size_t legacySymbols = 0;
+    const double legacyMs = time_ms([&] {
+        for (const std::string& f : tree.files) legacySymbols += LegacyIndexFile(f);
+    });
+
+    Check(first.files_indexed == tree.files.size() && first.files_parsed == tree.files.size(), "every code file is indexed");
+    Check(AllSymbols(single, tree.files) == AllSymbols(index, tree.files), "one thread finds the same symbols as four");
+
+    IndexStats again;
+    const double rebuildMs = time_ms([&] { again = index.build(); });
+    Check(again.files_parsed == 0 && again.files_unchanged == tree.files.size(), "an unchanged tree is not re-read");
+
+    const std::string indexFile = (fs::temp_directory_path() / "rawrxd_bench_indexer.idx").string();
+    double saveMs = 0.0, loadMs = 0.0;
+    saveMs = time_ms([&] { Check(index.save(indexFile), "index saves"); });
+    Indexer loaded(rootText);
+    loadMs = time_ms([&] { Check(loaded.load(indexFile), "index loads"); });
+    Check(AllSymbols(loaded, tree.files) == AllSymbols(index, tree.files) && loaded.symbolCount() == index.symbolCount(),
+          "loaded index equals the built one");
+    Check(!Indexer("/elsewhere").load(indexFile), "an index for another root is rejected");
+
+    if (generated) {
+        Check(AllSymbols(index, tree.files) == tree.symbols, "tree yields exactly the planted symbols");
+        Check(index.findByName("inlineGet").size() == size_t(std::count_if(tree.symbols.begin(), tree.symbols.end(),
+                  [](const SymbolKey& k) { return std::get<1>(k) == "inlineGet"; })),
+              "findByName returns every definition");
+        size_t classes = 0;
+        for (const SymbolKey& k : tree.symbols) classes += std::get<2>(k) == "class";
+        Check(index.findByKind("class").size() == classes, "findByKind returns every class");
+
+        // Same bytes, new mtime: hashed, not tokenized
+        const std::string touched = tree.files[1];
+        fs::last_write_time(touched, fs::last_write_time(touched) + std::chrono::seconds(5));
+        const IndexStats t = index.build();
+        Check(t.files_parsed == 0 && t.files_unchanged == tree.files.size(), "a touched file is skipped by content hash");
+
+        // Edit, delete, add
+        const std::string edited = tree.files[2];
+        WriteFile(edited, "namespace x {\nclass RenamedWidget {};\nint freshGlobal = 1;\n}\n");
+        fs::remove(tree.files[3]);
+        WriteFile(root / "m0" / "added.cpp", "void addedFunction() {}\n");
+        const IndexStats u = index.build();
+        Check(u.files_parsed == 2 && u.files_removed == 1, "only edited and new files are re-read");
+        Check(index.findInFile(edited).size() == 2 && index.findByName("RenamedWidget").size() == 1 &&
+                  index.findInFile(tree.files[3]).empty() && index.findByName("addedFunction").size() == 1,
+              "lookups follow edits, deletions and additions");
+        size_t stale = 0;
+        for (const Symbol& s : index.findByKind("variable")) stale += s.file == tree.files[3];
+        Check(stale == 0, "kind lists drop deleted files");
+
+        WriteFile(edited, "int editedAgain = 2;\n");
+        index.indexFile(edited);
+        Check(index.findByName("RenamedWidget").empty() && index.findByName("editedAgain").size() == 1,
+              "indexFile re-indexes one file");
+        index.removeFile(edited);
+        Check(index.findInFile(edited).empty() && index.findByName("editedAgain").empty(), "removeFile drops one file");
+    }
+
+    // Lookup latency against a linear scan of a flat symbol vector
+    std::vector<Symbol> flat;
+    for (const std::string& f : tree.files) {
+        for (Symbol& s : single.findInFile(f)) flat.push_back(std::move(s));
+    }
+    std::string probe = "main";
+    for (size_t i = flat.size() / 2; i < flat.size(); ++i) {
+        if (flat[i].kind == "class") {
+            probe = flat[i].name;
+            break;
+        }
+    }
+    constexpr int kLookups = 200;
+    size_t sink = 0;
+    const double hashedUs = time_ms([&] {
+        for (int i = 0; i < kLookups; ++i) sink += single.findByName(probe).size();
+    }) * 1000.0 / kLookups;
+    const double linearUs = time_ms([&] {
+        for (int i = 0; i < kLookups; ++i) {
+            for (const Symbol& s : flat) sink += s.name == probe;
+        }
+    }) * 1000.0 / kLookups;
+
+    const double mb = double(tree.bytes) / (1024.0 * 1024.0);
+    std::error_code ec;
+    std::printf("\n%zu files, %.1f MB, %zu symbols, %d threads, %u hardware threads\n", tree.files.size(), mb,
+                single.symbolCount(), threads, std::thread::hardware_concurrency());
+    std::printf("%-28s %10s %10s\n", "", "ms", "MB/s");
+    std::printf("%-28s %10.0f %10.1f   (%zu line matches)\n", "legacy regex, 1 thread", legacyMs, mb / (legacyMs / 1000.0), legacySymbols);
+    std::printf("%-28s %10.0f %10.1f\n", "tokenizer, 1 thread", singleMs, mb / (singleMs / 1000.0));
+    std::printf("%-28s %10.0f %10.1f\n", "tokenizer, pool", buildMs, mb / (buildMs / 1000.0));
+    std::printf("%-28s %10.1f\n", "rebuild, nothing changed", rebuildMs);
+    std::printf("%-28s %10.1f   (%.2f MB on disk)\n", "save", saveMs, double(fs::file_size(indexFile, ec)) / (1024.0 * 1024.0));
+    std::printf("%-28s %10.1f\n", "load (mapped)", loadMs);
+    std::printf("findByName('%s'): %.2f us hashed, %.1f us linear scan (%zu)\n", probe.c_str(), hashedUs, linearUs, sink % 2);
+
+    if (generated) {
+        Check(legacyMs / singleMs > 10.0, "tokenizer beats per-line regex by 10x on one thread");
+        Check(rebuildMs < singleMs / 4.0, "an unchanged rebuild costs a fraction of a full build");
+        fs::remove_all(root);
+    }
+    fs::remove(indexFile);
+
+    if (failures) {
+        std::printf("❌ INDEXER: %d check(s) failed\n", failures);
+        return 1;
+    }
+    std::puts("✅ INDEXER: tokenizer index matches planted symbols");
+    return 0;
+}
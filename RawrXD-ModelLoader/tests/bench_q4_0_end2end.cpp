@@ -1,90 +1,145 @@
 #include <immintrin.h>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <cmath>
 #include <vector>
 #include <chrono>
 #include <random>
 #include <algorithm>
 
-extern "C" void ggml_gemm_q4_0(int M, int N, int K, const float* A, const uint8_t* Bq4, float scale, float* C);
+// C[M x N] = A[M x K] * B^T, B = N rows of K/32 GGUF block_q4_0 (18 bytes each)
+extern "C" void ggml_gemm_q4_0(int M, int N, int K, const float* A, const uint8_t* Bq4, float* C);
 
-static void gemm_q4_0_scalar(int M, int N, int K, const float* A, const uint8_t* Bq4, float scale, float* C) {
-    for (int i = 0; i < M; ++i) {
-        for (int j = 0; j < N; ++j) {
-            float sum = 0.0f;
-            for (int k = 0; k < K; ++k) {
-                int idx = k * N + j;
-                int byteIndex = idx >> 1;
-                bool hi = (idx & 1) != 0;
-                uint8_t byte = Bq4[byteIndex];
-                int8_t w4 = hi ? ((byte >> 4) & 0xF) : (byte & 0xF);
-                float w = (float)(w4 - 8) * scale;
-                sum += A[i * K + k] * w;
+static uint16_t fp32_to_fp16(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const int exp = (int)((x >> 23) & 0xFF) - 127 + 15;
+    if (exp <= 0) return (uint16_t)sign;
+    if (exp >= 31) return (uint16_t)(sign | 0x7C00);
+    uint32_t mant = x & 0x7FFFFF;
+    uint32_t h = sign | ((uint32_t)exp << 10) | (mant >> 13);
+    if ((mant & 0x1FFF) > 0x1000 || ((mant & 0x1FFF) == 0x1000 && (h & 1))) ++h;
+    return (uint16_t)h;
+}
+
+static float fp16_to_fp32(uint16_t h) {
+    const int exp = (h >> 10) & 0x1F;
+    const int mant = h & 0x3FF;
+    const float sign = (h & 0x8000) ? -1.0f : 1.0f;
+    if (exp == 0) return sign * std::ldexp((float)mant, -24);
+    return sign * std::ldexp((float)(mant | 0x400), exp - 25);
+}
+
+// ggml quantize_row_q4_0: d = max / -8 (max is the signed value of largest magnitude)
+static void pack_q4_0(int N, int K, const float* W, uint8_t* Bq4) {
+    for (int j = 0; j < N; ++j) {
+        for (int b = 0; b < K / 32; ++b) {
+            const float* x = W + (size_t)j * K + b * 32;
+            uint8_t* blk = Bq4 + ((size_t)j * (K / 32) + b) * 18;
+            float amax = 0.0f, max = 0.0f;
+            for (int q = 0; q < 32; ++q) {
+                if (std::fabs(x[q]) > amax) { amax = std::fabs(x[q]); max = x[q]; }
+            }
+            const float d = max / -8.0f;
+            const float id = d != 0.0f ? 1.0f / d : 0.0f;
+            const uint16_t dh = fp32_to_fp16(d);
+            std::memcpy(blk, &dh, 2);
+            for (int q = 0; q < 16; ++q) {
+                const int lo = std::min(15, (int)(x[q] * id + 8.5f));
+                const int hi = std::min(15, (int)(x[q + 16] * id + 8.5f));
+                blk[2 + q] = (uint8_t)(lo | (hi << 4));
             }
-            C[i * N + j] = sum;
         }
     }
 }
 
-static void pack_q4_0(int K, int N, const float* Bfp32, float scale, uint8_t* Bq4) {
-    for (int k = 0; k < K; ++k) {
-        for (int j = 0; j < N; j += 2) {
-            float w0 = Bfp32[k * N + j] / scale;
-            float w1 = (j + 1 < N) ? (Bfp32[k * N + j + 1] / scale) : 0.0f;
-            int v0 = std::clamp((int)std::round(w0) + 8, 0, 15);
-            int v1 = std::clamp((int)std::round(w1) + 8, 0, 15);
-            int byteIndex = (k * N + j) >> 1;
-            Bq4[byteIndex] = (uint8_t)((v1 << 4) | v0);
+// Reference: dequantize every weight, then a plain double-accumulated GEMM
+static void gemm_q4_0_reference(int M, int N, int K, const float* A, const uint8_t* Bq4, float* C) {
+    std::vector<float> row(K);
+    for (int j = 0; j < N; ++j) {
+        for (int b = 0; b < K / 32; ++b) {
+            const uint8_t* blk = Bq4 + ((size_t)j * (K / 32) + b) * 18;
+            uint16_t dh;
+            std::memcpy(&dh, blk, 2);
+            const float d = fp16_to_fp32(dh);
+            for (int q = 0; q < 16; ++q) {
+                row[b * 32 + q] = ((blk[2 + q] & 0x0F) - 8) * d;
+                row[b * 32 + q + 16] = ((blk[2 + q] >> 4) - 8) * d;
+            }
+        }
+        for (int i = 0; i < M; ++i) {
+            double sum = 0.0;
+            for (int k = 0; k < K; ++k) sum += (double)A[(size_t)i * K + k] * row[k];
+            C[(size_t)i * N + j] = (float)sum;
         }
     }
 }
 
-int main() {
-    const int M = 64;
-    const int K = 128;
-    const int N = 64;
+template <typename Fn>
+static double time_ms(Fn&& fn, double budget_ms) {
+    fn();
+    int iters = 0;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    double elapsed = 0.0;
+    do {
+        fn();
+        ++iters;
+        elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+    } while (elapsed < budget_ms);
+    return elapsed / iters;
+}
 
-    std::vector<float> A(M * K);
-    std::vector<float> Bfp32(K * N);
-    std::vector<uint8_t> Bq4((K * N + 1) / 2);
-    std::vector<float> Cref(M * N);
-    std::vector<float> Copt(M * N);
+int main() {
+    struct Shape { const char* name; int M, N, K; };
+    const Shape shapes[] = {
+        {"decode  (M=1)",  1, 4096, 4096},
+        {"batch   (M=8)",  8, 4096, 4096},
+        {"prefill (M=64)", 64, 4096, 4096},
+        {"edge    (M=7)",  7, 61, 608},
+    };
 
     std::mt19937 rng(42);
-    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    bool ok = true;
+    double prefill_speedup = 0.0;
 
-    for (auto& v : A) v = dist(rng);
-    for (auto& v : Bfp32) v = std::round(dist(rng) * 7.0f);
+    std::printf("%-16s %10s %10s %10s %10s %8s %10s\n", "shape", "ref ms", "fused ms", "GFLOP/s", "GB/s", "speedup", "max rel");
+    for (const Shape& s : shapes) {
+        std::vector<float> A((size_t)s.M * s.K), W((size_t)s.N * s.K);
+        std::vector<uint8_t> Bq4((size_t)s.N * (s.K / 32) * 18);
+        std::vector<float> Cref((size_t)s.M * s.N), Copt((size_t)s.M * s.N);
+        for (auto& v : A) v = dist(rng);
+        for (auto& v : W) v = dist(rng);
+        pack_q4_0(s.N, s.K, W.data(), Bq4.data());
 
-    float scale = 0.5f;
-    pack_q4_0(K, N, Bfp32.data(), scale, Bq4.data());
+        gemm_q4_0_reference(s.M, s.N, s.K, A.data(), Bq4.data(), Cref.data());
+        ggml_gemm_q4_0(s.M, s.N, s.K, A.data(), Bq4.data(), Copt.data());
 
-    gemm_q4_0_scalar(M, N, K, A.data(), Bq4.data(), scale, Cref.data());
-    ggml_gemm_q4_0(M, N, K, A.data(), Bq4.data(), scale, Copt.data());
-
-    float max_abs = 0.0f;
-    for (int i = 0; i < M * N; ++i) max_abs = std::max(max_abs, std::abs(Cref[i] - Copt[i]));
-    std::printf("Max abs diff: %.6f\n", max_abs);
+        double scale = 0.0, err = 0.0;
+        for (size_t i = 0; i < Cref.size(); ++i) {
+            scale = std::max(scale, (double)std::fabs(Cref[i]));
+            err = std::max(err, (double)std::fabs(Cref[i] - Copt[i]));
+        }
+        const double rel = scale > 0.0 ? err / scale : err;
+        if (rel > 1e-4) ok = false;
 
-    const int iters = 100;
-    auto t0 = std::chrono::high_resolution_clock::now();
-    for (int it = 0; it < iters; ++it) {
-        gemm_q4_0_scalar(M, N, K, A.data(), Bq4.data(), scale, Cref.data());
+        const double ms_ref = time_ms([&] { gemm_q4_0_reference(s.M, s.N, s.K, A.data(), Bq4.data(), Cref.data()); }, 200.0);
+        const double ms_opt = time_ms([&] { ggml_gemm_q4_0(s.M, s.N, s.K, A.data(), Bq4.data(), Copt.data()); }, 200.0);
+        const double flops = 2.0 * s.M * s.N * s.K;
+        const double bytes = (double)Bq4.size() + A.size() * sizeof(float) + Copt.size() * sizeof(float);
+        const double speedup = ms_ref / ms_opt;
+        if (s.M == 64) prefill_speedup = speedup;
+        std::printf("%-16s %10.3f %10.3f %10.2f %10.2f %7.1fx %10.2e\n", s.name, ms_ref, ms_opt,
+                    flops / (ms_opt * 1e6), bytes / (ms_opt * 1e6), speedup, rel);
     }
-    auto t1 = std::chrono::high_resolution_clock::now();
-    double ms_scalar = std::chrono::duration<double, std::milli>(t1 - t0).count();
 
-    t0 = std::chrono::high_resolution_clock::now();
-    for (int it = 0; it < iters; ++it) {
-        ggml_gemm_q4_0(M, N, K, A.data(), Bq4.data(), scale, Copt.data());
+    if (!ok) {
+        std::puts("❌ END-TO-END: fused Q4_0 GEMM disagrees with the dequantized reference");
+        return 1;
     }
-    t1 = std::chrono::high_resolution_clock::now();
-    double ms_opt = std::chrono::duration<double, std::milli>(t1 - t0).count();
-
-    double speedup = ms_scalar / ms_opt;
-    std::printf("Scalar: %.2f ms  Opt(AVX2): %.2f ms  Speedup: %.2fx\n", ms_scalar, ms_opt, speedup);
-
-    if (speedup >= 1.8) {
+    if (prefill_speedup >= 1.8) {
         std::puts("✅ END-TO-END: >= 1.8× speedup achieved");
         return 0;
     } else {
@@ -0,0 +1,123 @@
+// Per-token decode benchmark for TransformerInference.
+//
+// Builds a synthetic F32 model in memory (no GGUF file needed), prefills a
+// prompt and then decodes token-by-token through the KV cache. The "overhead"
+// probe uses a tiny model so timings are dominated by per-step fixed costs
+// (graph build, allocation, backend dispatch) rather than matmul work.
+//
+// Usage: bench_transformer_decode [n_layer n_embd n_head n_vocab prompt_len gen_len]
+#include "transformer_inference.hpp"
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct ModelShape {
+    const char* label;
+    int nLayers;
+    int nEmbd;
+    int nHead;
+    int nVocab;
+};
+
+QByteArray randomF32(size_t n, std::mt19937& rng, float stddev) {
+    std::normal_distribution<float> dist(0.0f, stddev);
+    QByteArray bytes(int(n * sizeof(float)), Qt::Uninitialized);
+    float* f = reinterpret_cast<float*>(bytes.data());
+    for (size_t i = 0; i < n; ++i) f[i] = dist(rng);
+    return bytes;
+}
+
+QByteArray onesF32(size_t n) {
+    QByteArray bytes(int(n * sizeof(float)), Qt::Uninitialized);
+    float* f = reinterpret_cast<float*>(bytes.data());
+    for (size_t i = 0; i < n; ++i) f[i] = 1.0f;
+    return bytes;
+}
+
+QHash<QString, QByteArray> makeWeights(const ModelShape& m) {
+    std::mt19937 rng(42);
+    const size_t e = m.nEmbd;
+    QHash<QString, QByteArray> cache;
+    cache.insert("token_embd.weight", randomF32(e * m.nVocab, rng, 1.0f));
+    cache.insert("output.weight", randomF32(e * m.nVocab, rng, 0.05f));
+    for (int i = 0; i < m.nLayers; ++i) {
+        const QString p = QString("blk.%1.").arg(i);
+        cache.insert(p + "attn_q.weight", randomF32(e * e, rng, 0.05f));
+        cache.insert(p + "attn_k.weight", randomF32(e * e, rng, 0.05f));
+        cache.insert(p + "attn_v.weight", randomF32(e * e, rng, 0.05f));
+        cache.insert(p + "attn_output.weight", randomF32(e * e, rng, 0.05f));
+        cache.insert(p + "ffn_up.weight", randomF32(e * e * 4, rng, 0.05f));
+        cache.insert(p + "ffn_down.weight", randomF32(e * e * 4, rng, 0.05f));
+        cache.insert(p + "attn_norm.weight", onesF32(e));
+        cache.insert(p + "ffn_norm.weight", onesF32(e));
+    }
+    return cache;
+}
+
+void runShape(const ModelShape& m, int promptLen, int genLen, int nThreads) {
+    TransformerInference model;
+    model.setThreadCount(nThreads);
+    if (!model.loadWeights(makeWeights(m), m.nLayers, m.nEmbd, m.nHead, m.nVocab)) {
+        std::printf("%-10s load failed\n", m.label);
+        return;
+    }
+
+    std::vector<int32_t> prompt(promptLen);
+    for (int i = 0; i < promptLen; ++i) prompt[i] = (i * 7919) % m.nVocab;
+
+    using clock = std::chrono::high_resolution_clock;
+    auto t0 = clock::now();
+    std::vector<float> logits = model.prefill(prompt);
+    auto t1 = clock::now();
+
+    int32_t token = 1;
+    int decoded = 0;
+    for (int i = 0; i < genLen && !logits.empty(); ++i) {
+        logits = model.decode(token);
+        token = (token * 31 + 7) % m.nVocab;
+        ++decoded;
+    }
+    auto t2 = clock::now();
+
+    const double prefillMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    const double decodeMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+    const double perToken = decoded ? decodeMs / decoded : 0.0;
+    std::printf("%-10s threads=%-2d prefill(%d)=%8.2f ms  decode=%7.3f ms/tok  %8.1f tok/s\n",
+                m.label, nThreads, promptLen, prefillMs, perToken,
+                perToken > 0.0 ? 1000.0 / perToken : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    ModelShape custom{"custom", 4, 512, 8, 8000};
+    int promptLen = 128;
+    int genLen = 256;
+    if (argc >= 7) {
+        custom.nLayers = std::atoi(argv[1]);
+        custom.nEmbd = std::atoi(argv[2]);
+        custom.nHead = std::atoi(argv[3]);
+        custom.nVocab = std::atoi(argv[4]);
+        promptLen = std::atoi(argv[5]);
+        genLen = std::atoi(argv[6]);
+    }
+
+    const ModelShape overhead{"overhead", 1, 64, 4, 256};
+    const int hw = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    std::printf("TransformerInference decode benchmark\n");
+    for (int nThreads : {1, hw}) {
+        runShape(overhead, promptLen, genLen, nThreads);
+        runShape(custom, promptLen, genLen, nThreads);
+        if (hw == 1) break;
+    }
+    return 0;
+}
@@ -0,0 +1,343 @@
+// TrigramIndex, the MultiFileSearchWidget candidate filter, against the full
+// FileSearchEngine scan it short-cuts. Runs on a generated tree (default
+// ~48 MB of identifier-heavy source; pass a directory to time a real tree).
+// Reports build time, index size on disk and per-query latency. Before timing,
+// indexed hits must equal full-scan hits for literal, case-folded and regex
+// queries, and must stay equal through file edits, new files, deletions,
+// directory refreshes (notified and by mtime), compact() and a save/load
+// round trip.
+#include "file_search_engine.h"
+#include "trigram_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <regex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  ✗ %s\n", what);
+        ++failures;
+    }
+}
+
+template <typename Fn>
+double time_ms(Fn&& fn) {
+    const auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+using HitKey = std::tuple<std::string, int, int, std::string>;
+
+FileSearchQuery::LineMatcher RegexMatcher(const std::string& pattern) {
+    auto re = std::make_shared<std::regex>(pattern);
+    return [re](const char* line, size_t size, std::vector<std::pair<size_t, size_t>>& out) {
+        for (std::cregex_iterator it(line, line + size, *re), end; it != end; ++it) {
+            if (it->length(0) == 0) continue;
+            out.emplace_back(size_t(it->position(0)), size_t(it->length(0)));
+        }
+    };
+}
+
+FileSearchEngine::BatchCallback Collect(std::mutex& mutex, std::vector<HitKey>& hits) {
+    return [&mutex, &hits](std::vector<FileSearchHit>& batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const FileSearchHit& h : batch) {
+            hits.emplace_back(fs::path(h.path).lexically_normal().generic_string(), h.line, h.column, h.matchText);
+        }
+    };
+}
+
+std::vector<HitKey> FullScan(const FileSearchEngine& engine, const std::string& root, const FileSearchQuery& query) {
+    std::mutex mutex;
+    std::vector<HitKey> hits;
+    engine.search(root, query, Collect(mutex, hits));
+    std::sort(hits.begin(), hits.end());
+    return hits;
+}
+
+// What the widget does with the index ready
+std::vector<HitKey> IndexedScan(const TrigramIndex& index, const FileSearchEngine& engine, const FileSearchQuery& query,
+                                size_t* candidateCount = nullptr) {
+    std::mutex mutex;
+    std::vector<HitKey> hits;
+    std::vector<std::string> files;
+    if (index.candidates(query.literal, files)) {
+        engine.searchFiles(files, query, Collect(mutex, hits));
+    }
+    if (candidateCount) *candidateCount = files.size();
+    std::sort(hits.begin(), hits.end());
+    return hits;
+}
+
+void WriteFile(const fs::path& path, const std::string& text) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary) << text;
+}
+
+// Identifiers drawn Zipf-like from a large vocabulary, so common trigrams sit
+// in most files and rare ones in few, as in real code
+struct Vocabulary {
+    std::vector<std::string> words;
+    std::vector<double> cumulative;
+
+    explicit Vocabulary(std::mt19937& rng) {
+        static const char* kParts[] = {
+            "parse", "token", "buffer", "model", "layer", "cache", "index", "state", "value", "stream",
+            "header", "block", "quant", "tensor", "weight", "config", "loader", "worker", "queue", "file",
+        };
+        const size_t parts = sizeof(kParts) / sizeof(kParts[0]);
+        double sum = 0.0;
+        for (int i = 0; i < 40000; ++i) {
+            std::string w = kParts[rng() % parts];
+            std::string next = kParts[rng() % parts];
+            next[0] = char(next[0] - 32);
+            w += next;
+            if (i % 3 == 0) w += std::to_string(rng() % 1000);
+            words.push_back(w);
+            sum += 1.0 / std::pow(double(i + 1), 0.9);
+            cumulative.push_back(sum);
+        }
+        for (double& c : cumulative) c /= sum;
+    }
+
+    const std::string& draw(std::mt19937& rng) const {
+        const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        const size_t i = size_t(std::lower_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin());
+        return words[std::min(i, words.size() - 1)];
+    }
+};
+
+struct Tree {
+    size_t files = 0;
+    uint64_t bytes = 0;
+    std::vector<fs::path> rareFiles;  // Files holding rareNeedleQuartz
+};
+
+// src/dN/*.cpp|.h; rareNeedleQuartz in 1 file in 700, hotPathMarker in 1 in 15;
+// build/ is ignored and assets/*.bin are binary
+Tree MakeTree(const fs::path& root, size_t totalBytes) {
+    std::mt19937 rng(23);
+    const Vocabulary vocab(rng);
+    Tree tree;
+    fs::remove_all(root);
+    WriteFile(root / ".gitignore", "build/\n");
+    WriteFile(root / "build" / "gen.cpp", "rareNeedleQuartz in an ignored file\n");
+
+    size_t made = 0;
+    for (int i = 0; made < totalBytes; ++i) {
+        const size_t bytes = (i % 10 == 0) ? 64 * 1024 + rng() % (128 * 1024) : 300 + rng() % 10000;
+        std::string text;
+        while (text.size() < bytes) {
+            text.append(size_t(rng() % 3) * 4, ' ');
+            const int words = 2 + int(rng() % 8);
+            for (int w = 0; w < words; ++w) {
+                text += vocab.draw(rng);
+                text += (w + 1 < words) ? (rng() % 4 ? " " : "(") : ";\n";
+            }
+        }
+        if (i % 700 == 3) text += "    // rareNeedleQuartz, RARENEEDLEQUARTZ, rareNeedleOnyx\n";
+        if (i % 15 == 1) text += "    hotPathMarker();\n";
+        const fs::path path = root / "src" / ("d" + std::to_string(i % 53)) / ("file" + std::to_string(i) + (i % 3 ? ".cpp" : ".h"));
+        WriteFile(path, text);
+        if (i % 700 == 3) tree.rareFiles.push_back(path);
+        ++tree.files;
+        tree.bytes += text.size();
+        made += text.size();
+        if (i % 211 == 0) {
+            std::string blob = text.substr(0, 256) + "rareNeedleQuartz";
+            blob[10] = '\0';
+            WriteFile(root / "assets" / ("blob" + std::to_string(i) + ".bin"), blob);
+        }
+    }
+    return tree;
+}
+
+struct Case {
+    const char* name;
+    std::string literal;
+    bool caseSensitive;
+    std::string regex;
+};
+
+FileSearchQuery MakeQuery(const Case& c) {
+    FileSearchQuery q;
+    q.caseSensitive = c.caseSensitive;
+    q.literal = c.regex.empty() ? c.literal : FileSearchEngine::requiredLiteral(c.regex, c.caseSensitive);
+    if (!c.regex.empty()) q.matcher = RegexMatcher(c.regex);
+    return q;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::puts("=== TrigramIndex ===");
+
+    const bool generated = argc < 2;
+    const fs::path root = generated ? fs::temp_directory_path() / "rawrxd_bench_trigram_index" : fs::path(argv[1]);
+    const std::string rootText = root.lexically_normal().generic_string();
+    Tree tree;
+    if (generated) tree = MakeTree(root, size_t(48) << 20);
+
+    FileSearchEngine::Options options;
+    options.threads = std::max(4u, std::thread::hardware_concurrency());
+    const FileSearchEngine engine(options);
+    const std::string indexFile = TrigramIndex::defaultIndexPath(rootText);
+    fs::remove(indexFile);
+
+    TrigramIndex index(options);
+    const double buildMs = time_ms([&] { index.refresh(rootText); });
+    double saveMs = 0.0, loadMs = 0.0, refreshMs = 0.0;
+    saveMs = time_ms([&] { Check(index.save(indexFile), "index saves"); });
+    const TrigramIndex::Stats stats = index.stats();
+
+    TrigramIndex reloaded(options);
+    loadMs = time_ms([&] { Check(reloaded.load(indexFile), "index loads"); });
+    refreshMs = time_ms([&] { reloaded.refresh(rootText); });
+    const TrigramIndex::Stats reloadedStats = reloaded.stats();
+    Check(reloaded.root() == rootText && reloadedStats.files == stats.files &&
+              reloadedStats.postings == stats.postings && reloadedStats.overlayFiles == 0,
+          "an unchanged tree reloads without re-reading files");
+
+    const std::vector<Case> cases = {
+        {"rare literal", "rareNeedleQuartz", true, ""},
+        {"rare -i", "RARENEEDLEQUARTZ", false, ""},
+        {"rare regex", "", true, "rareNeedle[A-Z][a-z]+"},
+        {"7% literal", "hotPathMarker", true, ""},
+        {"common", "parseToken", true, ""},
+        {"absent", "zzqvxj_nowhere", true, ""},
+    };
+
+    if (generated) {
+        bool same = true, reloadSame = true;
+        for (const Case& c : cases) {
+            const FileSearchQuery q = MakeQuery(c);
+            const auto full = FullScan(engine, rootText, q);
+            if (IndexedScan(index, engine, q) != full) {
+                std::printf("    %s: indexed hits differ from the full scan\n", c.name);
+                same = false;
+            }
+            reloadSame &= IndexedScan(reloaded, engine, q) == full;
+        }
+        Check(same, "indexed hits equal the full scan");
+        Check(reloadSame, "a loaded index finds the same hits");
+
+        std::vector<std::string> files;
+        Check(!index.candidates("ab", files) && files.empty(), "literals under three bytes do not narrow");
+        index.candidates("rareNeedleQuartz", files);
+        Check(files.size() == tree.rareFiles.size(), "ignored and binary files are not candidates");
+
+        // Incremental updates; each must leave indexed hits equal to the full scan
+        const FileSearchQuery quartz = MakeQuery(cases[0]);
+        const FileSearchQuery fresh = MakeQuery({"fresh", "freshNeedleGarnet", true, ""});
+        auto agrees = [&](const FileSearchQuery& q) { return IndexedScan(index, engine, q) == FullScan(engine, rootText, q); };
+
+        const fs::path edited = tree.rareFiles.front();
+        WriteFile(edited, "int onlyThisNow; // freshNeedleGarnet\n");
+        index.updateFile(edited.string());
+        Check(agrees(quartz) && agrees(fresh), "updateFile replaces a file's trigrams");
+
+        const fs::path added = root / "src" / "d0" / "added.cpp";
+        WriteFile(added, "void f() { freshNeedleGarnet(); rareNeedleQuartz(); }\n");
+        index.updateFile(added.string());
+        Check(agrees(quartz) && agrees(fresh), "updateFile adds a new file");
+
+        fs::remove(tree.rareFiles.back());
+        index.removeFile(tree.rareFiles.back().string());
+        Check(agrees(quartz), "removeFile drops a file");
+
+        const fs::path dropped = root / "src" / "d1" / "dropped.h";
+        WriteFile(dropped, "#define FRESH freshNeedleGarnet\n");
+        fs::remove(added);
+        index.refreshDirectory((root / "src" / "d1").string());
+        index.refreshDirectory((root / "src" / "d0").string());
+        Check(agrees(quartz) && agrees(fresh), "refreshDirectory picks up new and deleted files");
+
+        // New subdirectories are walked under every .gitignore from the root down
+        WriteFile(root / "src" / ".gitignore", "cache/\n");
+        WriteFile(root / "src" / "d3" / "build" / "out.cpp", "freshNeedleGarnet in build\n");
+        WriteFile(root / "src" / "d3" / "cache" / "hit.cpp", "freshNeedleGarnet in cache\n");
+        WriteFile(root / "src" / "d3" / "kept" / "new.cpp", "freshNeedleGarnet kept\n");
+        index.refreshDirectory((root / "src" / "d3").string());
+        index.refreshDirectory((root / "src" / "d3" / "cache").string());
+        Check(agrees(fresh), "refreshDirectory skips directories an ancestor .gitignore excludes");
+
+        // Directories nobody watches are caught by their mtime
+        index.refreshChangedDirectories();  // Settle the edits above
+        WriteFile(root / "src" / "d4" / "unseen.cpp", "freshNeedleGarnet unseen\n");
+        WriteFile(root / "src" / "d5" / "deeper" / "unseen.h", "freshNeedleGarnet deeper\n");
+        fs::remove(root / "src" / "d3" / "kept" / "new.cpp");
+        Check(index.refreshChangedDirectories([](const std::string&) { return true; }) == 0,
+              "skipped directories are not checked");
+        Check(index.refreshChangedDirectories() == 3 && agrees(fresh),
+              "refreshChangedDirectories catches files added and removed without a notification");
+        Check(index.refreshChangedDirectories() == 0, "unchanged directories are not rescanned");
+        Check(index.stats().overlayFiles > 0, "small updates go to the overlay");
+
+        index.compact();
+        Check(index.stats().overlayFiles == 0 && agrees(quartz) && agrees(fresh), "compact keeps every posting");
+
+        Check(index.save(indexFile) && reloaded.load(indexFile), "updated index round-trips");
+        Check(IndexedScan(reloaded, engine, fresh) == FullScan(engine, rootText, fresh), "round trip keeps updates");
+
+        // A tree edited while the IDE was closed
+        WriteFile(root / "src" / "d2" / "offline.cpp", "freshNeedleGarnet\n");
+        fs::remove(dropped);
+        reloaded.refresh(rootText);
+        Check(IndexedScan(reloaded, engine, fresh) == FullScan(engine, rootText, fresh), "refresh catches offline edits");
+    }
+
+    // Latency, warm cache
+    const double mb = double(stats.textBytes) / (1024.0 * 1024.0);
+    std::error_code ec;
+    const uint64_t diskBytes = fs::file_size(indexFile, ec);
+    std::printf("\n%llu files, %.1f MB text, %d threads, %u hardware threads\n", (unsigned long long)stats.files, mb,
+                options.threads, std::thread::hardware_concurrency());
+    std::printf("build %.0f ms (%.0f MB/s), save %.1f ms, load %.1f ms, refresh after load %.1f ms\n", buildMs,
+                mb / (buildMs / 1000.0), saveMs, loadMs, refreshMs);
+    std::printf("%llu trigrams, %llu postings, %.1f MB encoded, %.1f MB on disk (%.1f%% of text)\n",
+                (unsigned long long)stats.trigrams, (unsigned long long)stats.postings,
+                double(stats.encodedBytes) / (1024.0 * 1024.0), double(diskBytes) / (1024.0 * 1024.0),
+                100.0 * double(diskBytes) / double(std::max<uint64_t>(stats.textBytes, 1)));
+    std::printf("%-14s %10s %12s %12s %10s %9s %8s\n", "query", "files", "lookup ms", "indexed ms", "scan ms",
+                "speedup", "hits");
+    double rareMs = 0.0;
+    for (const Case& c : cases) {
+        const FileSearchQuery q = MakeQuery(c);
+        FullScan(engine, rootText, q);  // Warm
+        size_t candidates = 0, hits = 0;
+        std::vector<std::string> files;
+        const double lookup = time_ms([&] { index.candidates(q.literal, files); });
+        const double indexed = time_ms([&] { hits = IndexedScan(index, engine, q, &candidates).size(); });
+        const double scan = time_ms([&] { FullScan(engine, rootText, q); });
+        if (c.name == cases[0].name || c.name == cases[2].name) rareMs = std::max(rareMs, indexed);
+        std::printf("%-14s %10zu %12.2f %12.2f %10.1f %8.1fx %8zu\n", c.name, candidates, lookup, indexed, scan,
+                    scan / indexed, hits);
+    }
+    if (generated) {
+        Check(rareMs < 100.0, "rare literal and regex queries finish under 100 ms");
+        fs::remove_all(root);
+    }
+
+    if (failures) {
+        std::printf("❌ TRIGRAM-INDEX: %d check(s) failed\n", failures);
+        return 1;
+    }
+    std::puts("✅ TRIGRAM-INDEX: indexed search matches full scan");
+    return 0;
+}
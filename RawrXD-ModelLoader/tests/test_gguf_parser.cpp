@@ -0,0 +1,180 @@
+// Shared GGUF parser test: builds a v3 file in memory with every metadata
+// value type (including string/float arrays and a custom alignment), then
+// checks keys, lazily decoded arrays, tensor offsets and incremental parsing.
+#include "gguf_parser.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+class GGUFWriter {
+public:
+    std::vector<uint8_t> bytes;
+
+    template<typename T>
+    void Put(T v) {
+        const size_t at = bytes.size();
+        bytes.resize(at + sizeof(T));
+        std::memcpy(bytes.data() + at, &v, sizeof(T));
+    }
+    void PutString(const std::string& s) {
+        Put<uint64_t>(s.size());
+        bytes.insert(bytes.end(), s.begin(), s.end());
+    }
+    void Key(const std::string& key, gguf::ValueType type) {
+        PutString(key);
+        Put<uint32_t>(static_cast<uint32_t>(type));
+    }
+};
+
+int failures = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "  ✗ " << what << std::endl;
+        ++failures;
+    }
+}
+
+std::vector<uint8_t> BuildModel(const std::vector<std::string>& tokens, uint64_t& q8_offset, uint64_t& f32_offset) {
+    using VT = gguf::ValueType;
+    GGUFWriter w;
+    w.Put<uint32_t>(gguf::Parser::kMagic);
+    w.Put<uint32_t>(3);
+    w.Put<uint64_t>(2);   // tensors
+    w.Put<uint64_t>(13);  // metadata pairs
+
+    w.Key("general.architecture", VT::STRING); w.PutString("llama");
+    w.Key("general.alignment", VT::UINT32); w.Put<uint32_t>(64);
+    w.Key("llama.block_count", VT::UINT32); w.Put<uint32_t>(2);
+    w.Key("llama.context_length", VT::UINT64); w.Put<uint64_t>(4096);
+    w.Key("llama.embedding_length", VT::INT32); w.Put<int32_t>(64);
+    w.Key("llama.rope.freq_base", VT::FLOAT64); w.Put<double>(10000.0);
+    w.Key("llama.attention.layer_norm_rms_epsilon", VT::FLOAT32); w.Put<float>(1e-5f);
+    w.Key("tokenizer.ggml.add_bos_token", VT::BOOL); w.Put<uint8_t>(1);
+    w.Key("tokenizer.ggml.bos_token_id", VT::INT64); w.Put<int64_t>(1);
+    w.Key("tokenizer.ggml.tokens", VT::ARRAY);
+    w.Put<uint32_t>(static_cast<uint32_t>(VT::STRING)); w.Put<uint64_t>(tokens.size());
+    for (const std::string& t : tokens) w.PutString(t);
+    w.Key("tokenizer.ggml.scores", VT::ARRAY);
+    w.Put<uint32_t>(static_cast<uint32_t>(VT::FLOAT32)); w.Put<uint64_t>(tokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i) w.Put<float>(-static_cast<float>(i));
+    w.Key("tokenizer.ggml.token_type", VT::ARRAY);
+    w.Put<uint32_t>(static_cast<uint32_t>(VT::INT32)); w.Put<uint64_t>(tokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i) w.Put<int32_t>(i < 3 ? 3 : 1);
+    w.Key("tokenizer.ggml.merges", VT::ARRAY);
+    w.Put<uint32_t>(static_cast<uint32_t>(VT::STRING)); w.Put<uint64_t>(2);
+    w.PutString("a b"); w.PutString("ab c");
+
+    // Tensor table: Q8_0 [64, 2] at relative 0, F32 [64] after it (64-byte aligned)
+    const uint64_t q8_bytes = 2 * 2 * 34;
+    const uint64_t f32_rel = (q8_bytes + 63) / 64 * 64;
+    w.PutString("blk.0.attn_q.weight"); w.Put<uint32_t>(2); w.Put<uint64_t>(64); w.Put<uint64_t>(2);
+    w.Put<uint32_t>(8); w.Put<uint64_t>(0);
+    w.PutString("blk.0.attn_norm.weight"); w.Put<uint32_t>(1); w.Put<uint64_t>(64);
+    w.Put<uint32_t>(0); w.Put<uint64_t>(f32_rel);
+
+    const uint64_t data_start = (w.bytes.size() + 63) / 64 * 64;
+    w.bytes.resize(data_start + f32_rel + 64 * 4, 0);
+    q8_offset = data_start;
+    f32_offset = data_start + f32_rel;
+    for (int i = 0; i < 64; ++i) {
+        const float v = static_cast<float>(i);
+        std::memcpy(w.bytes.data() + f32_offset + i * 4, &v, 4);
+    }
+    return w.bytes;
+}
+
+void CheckParsed(const gguf::Parser& p, const std::vector<std::string>& tokens,
+                 uint64_t q8_offset, uint64_t f32_offset, const std::vector<uint8_t>& file) {
+    Check(p.Version() == 3, "version");
+    Check(p.KVCount() == 13 && p.Metadata().size() == 13, "metadata count");
+    Check(p.Alignment() == 64, "general.alignment honoured");
+    Check(p.Architecture() == "llama", "architecture string");
+    Check(p.GetArchInt("block_count") == 2, "u32 via arch prefix");
+    Check(p.GetArchInt("context_length") == 4096, "u64 value");
+    Check(p.GetArchInt("embedding_length") == 64, "i32 value");
+    Check(std::fabs(p.GetDouble("llama.rope.freq_base") - 10000.0) < 1e-9, "f64 value");
+    Check(std::fabs(p.GetDouble("llama.attention.layer_norm_rms_epsilon") - 1e-5) < 1e-9, "f32 value");
+    Check(p.Find("tokenizer.ggml.add_bos_token") && p.Find("tokenizer.ggml.add_bos_token")->ToBool(), "bool value");
+    Check(p.GetInt("tokenizer.ggml.bos_token_id", -1) == 1, "i64 value");
+    Check(p.GetInt("missing.key", 7) == 7, "fallback for missing key");
+
+    const gguf::Value* toks = p.Find("tokenizer.ggml.tokens");
+    Check(toks && toks->ArraySize() == tokens.size(), "token array size");
+    if (toks) {
+        size_t i = 0;
+        bool same = true;
+        for (std::string_view t : toks->Strings()) same &= (i < tokens.size() && t == tokens[i++]);
+        Check(same && i == tokens.size(), "token strings decoded in order");
+    }
+    const gguf::Value* scores = p.Find("tokenizer.ggml.scores");
+    Check(scores && scores->IsScalarArray() && scores->ArrayDouble(5) == -5.0, "f32 array element");
+    const gguf::Value* types = p.Find("tokenizer.ggml.token_type");
+    Check(types && types->ArrayInt(0) == 3 && types->ArrayInt(10) == 1, "i32 array element");
+
+    Check(p.Tensors().size() == 2, "tensor count");
+    const gguf::TensorDesc* q = p.FindTensor("blk.0.attn_q.weight");
+    Check(q && q->type == 8 && q->n_dims == 2 && q->ne[0] == 64 && q->ne[1] == 2, "Q8_0 tensor shape");
+    Check(q && q->offset == q8_offset && q->size_bytes == 136, "Q8_0 absolute offset and size");
+    const gguf::TensorDesc* n = p.FindTensor("blk.0.attn_norm.weight");
+    Check(n && n->offset == f32_offset && n->size_bytes == 256, "F32 absolute offset and size");
+    if (n && n->offset + n->size_bytes <= file.size()) {
+        float v = 0.0f;
+        std::memcpy(&v, file.data() + n->offset + 10 * 4, 4);
+        Check(v == 10.0f, "tensor data found at parsed offset");
+    }
+    Check(p.DataOffset() % 64 == 0 && p.DataOffset() >= p.HeaderBytes(), "data section aligned");
+}
+
+} // namespace
+
+int main() {
+    std::cout << "=== GGUF Parser Test ===" << std::endl;
+
+    std::vector<std::string> tokens;
+    for (int i = 0; i < 1000; ++i) tokens.push_back("tok_" + std::to_string(i));
+    tokens[0] = "<unk>";
+    tokens[1] = "<s>";
+    tokens[2] = "</s>";
+
+    uint64_t q8_offset = 0, f32_offset = 0;
+    const std::vector<uint8_t> file = BuildModel(tokens, q8_offset, f32_offset);
+
+    std::cout << "Test 1: parse from memory (mapping)..." << std::endl;
+    gguf::Parser mapped;
+    Check(mapped.Parse(file.data(), file.size()) == gguf::Parser::Status::Ok, "parse ok: " + mapped.Error());
+    CheckParsed(mapped, tokens, q8_offset, f32_offset, file);
+
+    std::cout << "Test 2: incremental parse from a small prefix..." << std::endl;
+    gguf::Parser streamed;
+    size_t reads = 0;
+    const auto status = streamed.ParseFrom([&](uint64_t offset, void* dst, size_t n) -> size_t {
+        ++reads;
+        std::memcpy(dst, file.data() + offset, n);
+        return n;
+    }, file.size(), 64);
+    Check(status == gguf::Parser::Status::Ok, "incremental parse ok: " + streamed.Error());
+    Check(reads > 1, "prefix buffer grew");
+    gguf::Parser moved = std::move(streamed);  // Views must survive a move
+    CheckParsed(moved, tokens, q8_offset, f32_offset, file);
+
+    std::cout << "Test 3: truncated and corrupt input..." << std::endl;
+    gguf::Parser truncated;
+    Check(truncated.Parse(file.data(), 200) == gguf::Parser::Status::Truncated, "truncated header detected");
+    Check(truncated.Metadata().empty() && truncated.Tensors().empty(), "no partial results kept");
+    std::vector<uint8_t> bad = file;
+    bad[4] = 1;  // GGUF v1 used 32-bit lengths
+    gguf::Parser v1;
+    Check(v1.Parse(bad.data(), bad.size()) == gguf::Parser::Status::Invalid, "unsupported version rejected");
+
+    if (failures) {
+        std::cerr << "\n=== " << failures << " CHECK(S) FAILED ===" << std::endl;
+        return 1;
+    }
+    std::cout << "\n=== ALL GGUF PARSER TESTS PASSED ===" << std::endl;
+    return 0;
+}
@@ -0,0 +1,160 @@
+// Prefix cache test: radix tree matching (exact, mid-edge, shared system
+// prompt), LRU eviction under the token budget, erase/prune, and a randomized
+// comparison against a brute-force longest-common-prefix search.
+#include "prefix_cache.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "  ✗ " << what << std::endl;
+        ++failures;
+    }
+}
+
+std::vector<int32_t> Concat(std::vector<int32_t> a, const std::vector<int32_t>& b) {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+size_t CommonPrefix(const std::vector<int32_t>& a, const std::vector<int32_t>& b) {
+    size_t k = 0;
+    while (k < a.size() && k < b.size() && a[k] == b[k]) ++k;
+    return k;
+}
+
+} // namespace
+
+int main() {
+    std::cout << "=== Prefix Cache Test ===" << std::endl;
+
+    std::vector<int32_t> system(600);
+    for (size_t i = 0; i < system.size(); ++i) system[i] = int32_t(1000 + i % 97);
+
+    std::cout << "Test 1: shared system prompt..." << std::endl;
+    {
+        PrefixCache cache(10000);
+        const std::vector<int32_t> turn1 = Concat(system, {1, 2, 3});
+        const std::vector<int32_t> turn2 = Concat(system, {4, 5});
+        size_t matched = 99;
+        Check(cache.Match(turn1.data(), turn1.size(), &matched) == PrefixCache::kNoEntry && matched == 0,
+              "empty cache misses");
+        Check(cache.Insert(turn1.data(), turn1.size(), 1), "insert first turn");
+
+        Check(cache.Match(turn2.data(), turn2.size(), &matched) == 1 && matched == system.size(),
+              "second turn reuses the system prompt (mid-edge match)");
+        Check(cache.Insert(turn2.data(), turn2.size(), 2), "insert second turn");
+        Check(cache.Match(turn1.data(), turn1.size(), &matched) == 1 && matched == turn1.size(), "exact match");
+        Check(!cache.Insert(turn1.data(), turn1.size(), 3), "duplicate prompt not re-inserted");
+        Check(!cache.Insert(system.data(), 10, 2), "entry id in use");
+
+        const std::vector<int32_t> longer = Concat(turn2, {6, 7, 8});
+        Check(cache.Match(longer.data(), longer.size(), &matched) == 2 && matched == turn2.size(),
+              "longest cached prefix wins");
+        const std::vector<int32_t> other = {7, 7, 7};
+        Check(cache.Match(other.data(), other.size(), &matched) == PrefixCache::kNoEntry, "unrelated prompt misses");
+
+        const PrefixCacheStats stats = cache.GetStats();
+        Check(stats.lookups == 5 && stats.hits == 3, "lookup and hit counters");
+        Check(stats.matched_tokens == system.size() + turn1.size() + turn2.size(), "matched token counter");
+        Check(stats.entries == 2 && stats.cached_tokens == turn1.size() + turn2.size(), "entry accounting");
+    }
+
+    std::cout << "Test 2: LRU eviction under the token budget..." << std::endl;
+    {
+        PrefixCache cache(2 * 603);
+        std::vector<PrefixCache::EntryId> evicted;
+        cache.SetEvictCallback([&](PrefixCache::EntryId id) { evicted.push_back(id); });
+        const std::vector<int32_t> a = Concat(system, {1, 1, 1});
+        const std::vector<int32_t> b = Concat(system, {2, 2, 2});
+        const std::vector<int32_t> c = Concat(system, {3, 3, 3});
+        cache.Insert(a.data(), a.size(), 10);
+        cache.Insert(b.data(), b.size(), 11);
+        size_t matched = 0;
+        cache.Match(a.data(), a.size(), &matched);  // a becomes most recent
+        cache.Insert(c.data(), c.size(), 12);
+        Check(evicted.size() == 1 && evicted[0] == 11, "least recently used entry evicted");
+        Check(cache.Match(b.data(), b.size(), &matched) != 11 && matched == system.size(),
+              "evicted entry no longer matched in full");
+
+        Check(cache.Insert(system.data(), system.size(), 13) && cache.GetStats().cached_tokens <= 2 * 603,
+              "budget holds after insert");
+        cache.SetMaxTokens(0);
+        Check(cache.GetStats().entries == 0 && cache.GetStats().cached_tokens == 0, "zero budget empties the cache");
+        Check(!cache.Insert(a.data(), a.size(), 14), "zero budget caches nothing");
+    }
+
+    std::cout << "Test 3: erase prunes the tree..." << std::endl;
+    {
+        PrefixCache cache(100000);
+        const std::vector<int32_t> a = Concat(system, {1});
+        const std::vector<int32_t> b = Concat(system, {2});
+        cache.Insert(a.data(), a.size(), 1);
+        cache.Insert(b.data(), b.size(), 2);
+        Check(cache.Erase(1) && !cache.Erase(1), "erase once");
+        size_t matched = 0;
+        Check(cache.Match(a.data(), a.size(), &matched) == 2 && matched == system.size(), "sibling still matches the shared part");
+        Check(cache.Insert(a.data(), a.size(), 3), "re-insert after erase");
+        Check(cache.Match(a.data(), a.size(), &matched) == 3 && matched == a.size(), "re-inserted entry matches in full");
+        cache.Clear();
+        Check(cache.Match(a.data(), a.size(), &matched) == PrefixCache::kNoEntry, "clear drops everything");
+    }
+
+    std::cout << "Test 4: randomized against brute force..." << std::endl;
+    {
+        PrefixCache cache(1u << 30);
+        std::map<PrefixCache::EntryId, std::vector<int32_t>> reference;
+        std::mt19937 rng(42);
+        PrefixCache::EntryId next_id = 0;
+        int mismatches = 0;
+        for (int step = 0; step < 5000; ++step) {
+            // Few distinct tokens and shared stems force plenty of edge splits
+            std::vector<int32_t> tokens;
+            if (!reference.empty() && rng() % 2) {
+                const auto& base = std::next(reference.begin(), rng() % reference.size())->second;
+                tokens.assign(base.begin(), base.begin() + rng() % (base.size() + 1));
+            }
+            const size_t extra = rng() % 6;
+            for (size_t i = 0; i < extra; ++i) tokens.push_back(int32_t(rng() % 4));
+            if (tokens.empty()) tokens.push_back(0);
+
+            const unsigned op = rng() % 10;
+            if (op < 4) {
+                size_t matched = 0;
+                const PrefixCache::EntryId id = cache.Match(tokens.data(), tokens.size(), &matched);
+                size_t best = 0;
+                for (const auto& [rid, rtokens] : reference) best = std::max(best, CommonPrefix(rtokens, tokens));
+                if (matched != best) ++mismatches;
+                if (id != PrefixCache::kNoEntry && CommonPrefix(reference.at(id), tokens) != matched) ++mismatches;
+            } else if (op < 8) {
+                const bool duplicate = std::any_of(reference.begin(), reference.end(),
+                                                   [&](const auto& kv) { return kv.second == tokens; });
+                const bool inserted = cache.Insert(tokens.data(), tokens.size(), next_id);
+                if (inserted == duplicate) ++mismatches;
+                if (inserted) reference[next_id] = tokens;
+                ++next_id;
+            } else if (!reference.empty()) {
+                auto it = std::next(reference.begin(), rng() % reference.size());
+                if (!cache.Erase(it->first)) ++mismatches;
+                reference.erase(it);
+            }
+        }
+        Check(mismatches == 0, "matches agree with brute force (" + std::to_string(mismatches) + " mismatches)");
+        Check(cache.GetStats().entries == reference.size(), "entry count agrees");
+    }
+
+    if (failures) {
+        std::cerr << "\n=== " << failures << " CHECK(S) FAILED ===" << std::endl;
+        return 1;
+    }
+    std::cout << "\n=== ALL PREFIX CACHE TESTS PASSED ===" << std::endl;
+    return 0;
+}
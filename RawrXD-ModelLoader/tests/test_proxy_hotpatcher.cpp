@@ -0,0 +1,76 @@
+// ProxyHotpatcher streaming: a response-correction pattern split across two
+// chunks must be rewritten through the public API, on the default stream and
+// on interleaved keyed streams, with the held-back tail coming out of
+// finishStream(). Chunk 0 must start a fresh stream, and a termination point
+// must end the stream and drop its state.
+#include "proxy_hotpatcher.hpp"
+#include <cstdio>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  ✗ %s\n", what);
+        ++failures;
+    }
+}
+
+ProxyHotpatchRule Correction(const QString& name, const QByteArray& pattern, const QByteArray& replacement) {
+    ProxyHotpatchRule rule;
+    rule.name = name;
+    rule.type = ProxyHotpatchRule::ResponseCorrection;
+    rule.searchPattern = pattern;
+    rule.replacement = replacement;
+    return rule;
+}
+
+} // namespace
+
+int main() {
+    std::puts("=== ProxyHotpatcher streams ===");
+    ProxyHotpatcher hotpatcher;
+    hotpatcher.addRule(Correction("refusal", "I cannot help", "Here is help"));
+
+    // Default stream, the pattern split across the chunk boundary
+    QByteArray out = hotpatcher.processStreamChunk(QByteArray("Well, I can"), 0);
+    out += hotpatcher.processStreamChunk(QByteArray("not help with that."), 1);
+    out += hotpatcher.finishStream();
+    Check(out == "Well, Here is help with that.", "a pattern split across two chunks is rewritten");
+    Check(hotpatcher.activeStreamCount() == 0, "finishStream() drops the default stream");
+
+    // A held-back prefix of an abandoned stream is not joined to the next one
+    hotpatcher.processStreamChunk(QByteArray("abandoned, I can"), 0);
+    out = hotpatcher.processStreamChunk(QByteArray("not help"), 0);
+    out += hotpatcher.finishStream();
+    Check(out == "not help", "chunk 0 starts a fresh default stream");
+
+    // Interleaved streams keep their own state
+    const QString a = QStringLiteral("conn-a");
+    const QString b = QStringLiteral("conn-b");
+    QByteArray outA = hotpatcher.processStreamChunk(a, QByteArray("I cannot"), 0);
+    QByteArray outB = hotpatcher.processStreamChunk(b, QByteArray("Sorry, I can"), 0);
+    outA += hotpatcher.processStreamChunk(a, QByteArray(" help you"), 1);
+    outB += hotpatcher.processStreamChunk(b, QByteArray("not help."), 1);
+    Check(hotpatcher.activeStreamCount() == 2, "each stream id has its own state");
+    outA += hotpatcher.finishStream(a);
+    outB += hotpatcher.finishStream(b);
+    Check(outA == "Here is help you" && outB == "Sorry, Here is help.", "interleaved streams are rewritten independently");
+
+    const ProxyHotpatcher::Stats stats = hotpatcher.getStatistics();
+    Check(stats.patchesApplied == 3 && stats.chunksProcessed == 8, "statistics count chunks and patches");
+
+    // Termination ends the stream and forgets it
+    hotpatcher.setStreamTerminationPoint(1);
+    Check(!hotpatcher.processStreamChunk(a, QByteArray("I can"), 0).isNull(), "chunks before the termination point pass");
+    Check(hotpatcher.processStreamChunk(a, QByteArray("not help"), 1).isNull(), "the termination point ends the stream");
+    Check(hotpatcher.activeStreamCount() == 0, "a terminated stream drops its state");
+
+    if (failures) {
+        std::printf("❌ PROXY-HOTPATCHER: %d check(s) failed\n", failures);
+        return 1;
+    }
+    std::puts("✅ PROXY-HOTPATCHER: split patterns are rewritten per stream");
+    return 0;
+}
@@ -0,0 +1,210 @@
+// QuantBackend test: Q4_0/Q8_0 block quantization error bounds, SIMD kernels
+// against the scalar kernels and a dequantized F32 reference, GGUF block
+// adoption, batched gemm, and a decode-sized GEMV throughput report.
+#include "QuantBackend.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "  ✗ " << what << std::endl;
+        ++failures;
+    }
+}
+
+std::vector<float> RandomFloats(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> v(n);
+    for (float& x : v) x = dist(rng);
+    return v;
+}
+
+float HalfToFloat(uint16_t h) {
+    const int exp = (h >> 10) & 0x1F;
+    const int mant = h & 0x3FF;
+    const float sign = (h & 0x8000) ? -1.0f : 1.0f;
+    if (exp == 0) return sign * std::ldexp(float(mant), -24);
+    return sign * std::ldexp(float(mant | 0x400), exp - 25);
+}
+
+// Reference dequantization, independent of the backend
+std::vector<float> Dequantize(const QuantMatrix& W) {
+    std::vector<float> out(size_t(W.rows) * W.cols);
+    if (W.mode == QuantMode::F32) {
+        std::memcpy(out.data(), W.data.data(), out.size() * sizeof(float));
+        return out;
+    }
+    const size_t nblocks = out.size() / kQuantBlockSize;
+    for (size_t b = 0; b < nblocks; ++b) {
+        float* dst = out.data() + b * kQuantBlockSize;
+        if (W.mode == QuantMode::Q4_0) {
+            const BlockQ4_0& blk = reinterpret_cast<const BlockQ4_0*>(W.data.data())[b];
+            for (int j = 0; j < 16; ++j) {
+                dst[j] = ((blk.qs[j] & 0x0F) - 8) * HalfToFloat(blk.d);
+                dst[j + 16] = ((blk.qs[j] >> 4) - 8) * HalfToFloat(blk.d);
+            }
+        } else {
+            const BlockQ8_0& blk = reinterpret_cast<const BlockQ8_0*>(W.data.data())[b];
+            for (int j = 0; j < kQuantBlockSize; ++j) dst[j] = blk.qs[j] * HalfToFloat(blk.d);
+        }
+    }
+    return out;
+}
+
+double MaxRelError(const std::vector<float>& got, const std::vector<float>& want) {
+    double scale = 0.0, err = 0.0;
+    for (size_t i = 0; i < want.size(); ++i) {
+        scale = std::max(scale, double(std::fabs(want[i])));
+        err = std::max(err, double(std::fabs(got[i] - want[i])));
+    }
+    return scale > 0.0 ? err / scale : err;
+}
+
+const char* ModeName(QuantMode mode) {
+    return mode == QuantMode::Q4_0 ? "Q4_0" : mode == QuantMode::Q8_0 ? "Q8_0" : "F32";
+}
+
+} // namespace
+
+int main() {
+    std::cout << "=== Quant Backend Test ===" << std::endl;
+    QuantBackend& qb = QuantBackend::instance();
+    const QuantKernel best = qb.currentKernel();
+    std::cout << "Kernels: AVX-512 " << (QuantBackend::kernelSupported(QuantKernel::AVX512) ? "yes" : "no")
+              << ", AVX2 " << (QuantBackend::kernelSupported(QuantKernel::AVX2) ? "yes" : "no")
+              << " (default " << QuantBackend::kernelName(best) << ")" << std::endl;
+
+    const QuantKernel kernels[] = {QuantKernel::Scalar, QuantKernel::AVX2, QuantKernel::AVX512};
+    const QuantMode modes[] = {QuantMode::Q4_0, QuantMode::Q8_0, QuantMode::F32};
+
+    std::cout << "Test 1: block quantization error bounds..." << std::endl;
+    {
+        const std::vector<float> w = RandomFloats(64 * 256, 1);
+        for (QuantMode mode : {QuantMode::Q4_0, QuantMode::Q8_0}) {
+            qb.setMode(mode);
+            QuantMatrix m;
+            Check(qb.quantizeMatrix(w.data(), 64, 256, m) && m.mode == mode, std::string("quantize ") + ModeName(mode));
+            Check(m.data.size() == 64 * m.rowBytes(), "packed size");
+            const std::vector<float> back = Dequantize(m);
+            // Per block: Q8_0 rounds to steps of amax/127; Q4_0 steps are amax/8
+            // and the side opposite the signed extreme clamps at +7 (one full step)
+            bool ok = true;
+            for (size_t b = 0; b < w.size() / kQuantBlockSize; ++b) {
+                float amax = 0.0f;
+                for (int j = 0; j < kQuantBlockSize; ++j) amax = std::max(amax, std::fabs(w[b * 32 + j]));
+                const float bound = (mode == QuantMode::Q4_0 ? amax / 8.0f : amax / 127.0f * 0.5f) * 1.01f + 1e-3f * amax;
+                for (int j = 0; j < kQuantBlockSize; ++j) ok = ok && std::fabs(back[b * 32 + j] - w[b * 32 + j]) <= bound;
+            }
+            Check(ok, std::string(ModeName(mode)) + " round trip within one quantization step");
+
+            std::vector<uint8_t> raw(m.data.size());
+            Check(qb.quantizeWeights(w.data(), raw.data(), w.size()) && raw == m.data, "quantizeWeights matches quantizeMatrix");
+        }
+        qb.setMode(QuantMode::Q4_0);
+        QuantMatrix odd;
+        Check(qb.quantizeMatrix(w.data(), 4, 40, odd) && odd.mode == QuantMode::F32, "non-multiple of 32 stays F32");
+    }
+
+    std::cout << "Test 2: kernels agree with scalar and the F32 reference..." << std::endl;
+    {
+        // 3 blocks per row exercises the AVX-512 odd-block tail
+        for (int cols : {96, 1024}) {
+            const int rows = 37;
+            const std::vector<float> w = RandomFloats(size_t(rows) * cols, 2);
+            const std::vector<float> x = RandomFloats(cols, 3);
+            for (QuantMode mode : modes) {
+                qb.setMode(mode);
+                QuantMatrix m;
+                qb.quantizeMatrix(w.data(), rows, cols, m);
+                const std::vector<float> deq = Dequantize(m);
+                std::vector<float> ref(rows);
+                for (int r = 0; r < rows; ++r) {
+                    double s = 0.0;
+                    for (int c = 0; c < cols; ++c) s += double(deq[size_t(r) * cols + c]) * x[c];
+                    ref[r] = float(s);
+                }
+
+                qb.setKernel(QuantKernel::Scalar);
+                std::vector<float> scalar(rows);
+                qb.gemv(m, x.data(), scalar.data());
+                // Only activation rounding separates the kernels from F32 math
+                const double refTol = mode == QuantMode::F32 ? 1e-5 : 2e-2;
+                Check(MaxRelError(scalar, ref) < refTol, std::string("scalar ") + ModeName(mode) + " vs F32 reference, cols " + std::to_string(cols));
+
+                for (QuantKernel k : kernels) {
+                    if (k == QuantKernel::Scalar || !qb.setKernel(k)) continue;
+                    std::vector<float> y(rows);
+                    qb.gemv(m, x.data(), y.data());
+                    Check(MaxRelError(y, scalar) < 1e-5, std::string(QuantBackend::kernelName(k)) + " " + ModeName(mode) +
+                          " vs scalar, cols " + std::to_string(cols));
+                }
+            }
+        }
+        qb.setKernel(best);
+    }
+
+    std::cout << "Test 3: GGUF blocks adopted as-is, batched gemm..." << std::endl;
+    {
+        const int rows = 16, cols = 128, n = 5;
+        const std::vector<float> w = RandomFloats(size_t(rows) * cols, 4);
+        const std::vector<float> a = RandomFloats(size_t(n) * cols, 5);
+        qb.setMode(QuantMode::Q8_0);
+        QuantMatrix packed, adopted;
+        qb.quantizeMatrix(w.data(), rows, cols, packed);
+        Check(qb.loadBlocks(QuantMode::Q8_0, packed.data.data(), rows, cols, adopted) && adopted.data == packed.data,
+              "loadBlocks keeps the block bytes");
+        Check(!qb.loadBlocks(QuantMode::Q8_0, packed.data.data(), rows, 100, adopted), "loadBlocks rejects partial blocks");
+        Check(!qb.loadBlocks(QuantMode::F32, packed.data.data(), rows, cols, adopted), "loadBlocks only takes block formats");
+
+        std::vector<float> batched(size_t(n) * rows), single(rows);
+        qb.gemm(packed, a.data(), batched.data(), n);
+        bool same = true;
+        for (int i = 0; i < n; ++i) {
+            qb.gemv(packed, a.data() + size_t(i) * cols, single.data());
+            same = same && std::memcmp(single.data(), batched.data() + size_t(i) * rows, rows * sizeof(float)) == 0;
+        }
+        Check(same, "gemm rows equal gemv");
+    }
+
+    std::cout << "Test 4: decode GEMV throughput (4096 x 4096)..." << std::endl;
+    {
+        const int rows = 4096, cols = 4096;
+        const std::vector<float> w = RandomFloats(size_t(rows) * cols, 6);
+        const std::vector<float> x = RandomFloats(cols, 7);
+        std::vector<float> y(rows);
+        for (QuantMode mode : modes) {
+            qb.setMode(mode);
+            QuantMatrix m;
+            qb.quantizeMatrix(w.data(), rows, cols, m);
+            for (QuantKernel k : kernels) {
+                if (!qb.setKernel(k)) continue;
+                qb.gemv(m, x.data(), y.data());
+                const int iters = k == QuantKernel::Scalar ? 3 : 20;
+                const auto t0 = std::chrono::steady_clock::now();
+                for (int i = 0; i < iters; ++i) qb.gemv(m, x.data(), y.data());
+                const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / iters;
+                std::cout << "  " << ModeName(mode) << " " << QuantBackend::kernelName(k) << ": " << ms << " ms, "
+                          << (m.data.size() / 1e6) / ms << " GB/s of weights" << std::endl;
+            }
+        }
+        qb.setKernel(best);
+        qb.setMode(QuantMode::FALLBACK);
+    }
+
+    if (failures) {
+        std::cerr << "\n=== " << failures << " CHECK(S) FAILED ===" << std::endl;
+        return 1;
+    }
+    std::cout << "\n=== ALL QUANT BACKEND TESTS PASSED ===" << std::endl;
+    return 0;
+}
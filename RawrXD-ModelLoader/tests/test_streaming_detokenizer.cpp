@@ -0,0 +1,258 @@
+// StreamingDetokenizer against full decode() on byte-level BPE and
+// SentencePiece byte-fallback vocabularies, where multi-byte characters
+// (CJK, emoji, accents) span several tokens. Every push() must be valid
+// text, the concatenation must equal decode() of the whole stream, and the
+// per-token cost must stay flat while re-decoding the reply each step grows
+// with its length.
+#include "streaming_detokenizer.hpp"
+#include "bpe_tokenizer.hpp"
+#include "sentencepiece_tokenizer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  ✗ %s\n", what);
+        ++failures;
+    }
+}
+
+template <typename Fn>
+double time_ms(Fn&& fn) {
+    const auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+QByteArray PackTokens(const std::vector<QString>& tokens) {
+    QByteArray packed;
+    const qint32 count = qint32(tokens.size());
+    packed.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const QString& token : tokens) {
+        const QByteArray utf8 = token.toUtf8();
+        const quint32 len = quint32(utf8.size());
+        packed.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        packed.append(utf8);
+    }
+    return packed;
+}
+
+// Prose mixing ASCII with 2-, 3- and 4-byte characters
+QString MakeReply(unsigned seed, int words) {
+    static const char* kWords[] = {
+        "the", "model", "streams", "tokens", "while", "decoding", "naïve", "café", "résumé",
+        "日本語", "の", "テキスト", "→", "½", "😀", "🚀", "Ω", "ßtraße", "data", "reply",
+    };
+    std::mt19937 rng(seed);
+    std::string out;
+    for (int i = 0; i < words; ++i) {
+        if (i) out += (rng() % 11 == 0) ? "\n" : " ";
+        out += kWords[rng() % (sizeof(kWords) / sizeof(kWords[0]))];
+    }
+    return QString::fromUtf8(out.data(), qsizetype(out.size()));
+}
+
+// GPT-2 style vocabulary: the 256 byte symbols plus a few ASCII merges, so
+// every non-ASCII character is split across byte tokens
+bool BuildBpe(BPETokenizer& tokenizer) {
+    std::vector<int> bytes;
+    for (int b = 33; b <= 126; ++b) bytes.push_back(b);
+    for (int b = 161; b <= 172; ++b) bytes.push_back(b);
+    for (int b = 174; b <= 255; ++b) bytes.push_back(b);
+    std::vector<int> chars(bytes);
+    for (int b = 0, n = 0; b < 256; ++b) {
+        if (std::find(bytes.begin(), bytes.end(), b) == bytes.end()) {
+            bytes.push_back(b);
+            chars.push_back(256 + n++);
+        }
+    }
+    std::vector<QString> symbol(256);
+    for (size_t i = 0; i < 256; ++i) symbol[size_t(bytes[i])] = QString(QChar(chars[i]));
+
+    // Ids 0-2 stay special (pad, bos, eos), then the byte symbols
+    std::vector<QString> tokens = {"<pad>", "<s>", "</s>"};
+    for (int b = 0; b < 256; ++b) tokens.push_back(symbol[size_t(b)]);
+    const QString space = symbol[' '];
+    const char* kMerges[][2] = {{"t", "h"}, {"th", "e"}, {"e", "r"}, {"i", "n"}, {"o", "d"}};
+    QByteArray merges;
+    for (const auto& m : kMerges) {
+        tokens.push_back(QString(m[0]) + m[1]);
+        merges += QByteArray(m[0]) + " " + m[1] + "\n";
+    }
+    tokens.push_back(space + "the");
+    merges += space.toUtf8() + " the\n";
+
+    QHash<QString, QByteArray> metadata;
+    metadata["tokenizer.ggml.tokens"] = PackTokens(tokens);
+    metadata["tokenizer.ggml.merges"] = merges;
+    return tokenizer.loadFromGGUFMetadata(metadata);
+}
+
+// LLaMA layout: <unk>, <s>, </s>, 256 byte pieces, then ▁-prefixed words
+bool BuildSentencePiece(SentencePieceTokenizer& tokenizer) {
+    std::vector<QString> pieces = {"<unk>", "<s>", "</s>"};
+    std::vector<int32_t> types = {2, 3, 3};
+    for (int b = 0; b < 256; ++b) {
+        char name[8];
+        std::snprintf(name, sizeof(name), "<0x%02X>", b);
+        pieces.push_back(QString::fromUtf8(name));
+        types.push_back(6);
+    }
+    const QString mark(QChar(0x2581));
+    for (const char* word : {"the", "model", "streams", "tokens", "data", "reply", "caf", "na"}) {
+        pieces.push_back(mark + QString::fromUtf8(word));
+        types.push_back(1);
+    }
+    for (char c = 'a'; c <= 'z'; ++c) {
+        pieces.push_back(QString(QChar(c)));
+        types.push_back(1);
+    }
+    pieces.push_back(mark);
+    types.push_back(1);
+
+    std::vector<float> scores;
+    for (size_t i = 0; i < pieces.size(); ++i) scores.push_back(-float(i % 97) / 10.0f);
+
+    QHash<QString, QByteArray> metadata;
+    metadata["tokenizer.ggml.tokens"] = PackTokens(pieces);
+    metadata["tokenizer.ggml.scores"] =
+        QByteArray(reinterpret_cast<const char*>(scores.data()), qsizetype(scores.size() * sizeof(float)));
+    metadata["tokenizer.ggml.token_type"] =
+        QByteArray(reinterpret_cast<const char*>(types.data()), qsizetype(types.size() * sizeof(int32_t)));
+    return tokenizer.loadFromGGUFMetadata(metadata);
+}
+
+struct StreamResult {
+    QString text;
+    bool allValid = true;  // No chunk carried a replacement character
+    int emptyPushes = 0;   // Tokens that ended inside a character
+};
+
+StreamResult Stream(StreamingDetokenizer detokenizer, const std::vector<int32_t>& tokens) {
+    StreamResult result;
+    for (int32_t token : tokens) {
+        const QString chunk = detokenizer.push(token);
+        if (chunk.contains(QChar(0xFFFD))) result.allValid = false;
+        if (chunk.isEmpty()) ++result.emptyPushes;
+        result.text += chunk;
+    }
+    result.text += detokenizer.flush();
+    return result;
+}
+
+} // namespace
+
+int main() {
+    std::puts("=== StreamingDetokenizer ===");
+
+    // UTF-8 boundary detection
+    const struct { const char* bytes; int complete; } kPrefixes[] = {
+        {"", 0}, {"a", 1}, {"a\xC3", 1}, {"\xC3\xA9", 2}, {"\xE2\x82", 0}, {"x\xE2\x82\xAC", 4},
+        {"\xF0\x9F\x98", 0}, {"\xF0\x9F\x98\x80", 4}, {"\x80", 1}, {"\xFF", 1}, {"\xE2" "a", 2},
+    };
+    for (const auto& p : kPrefixes) {
+        Check(StreamingDetokenizer::completeUtf8Prefix(p.bytes, int(std::strlen(p.bytes))) == p.complete,
+              "completeUtf8Prefix boundary");
+    }
+
+    // One byte per token: the emoji appears only with its last byte, and an
+    // unfinished character is flushed as U+FFFD
+    {
+        const QByteArray bytes("\xF0\x9F\x98\x80!\xE2\x82", 7);
+        StreamingDetokenizer raw([&bytes](int32_t id, QByteArray& out) {
+            if (id < 0 || id >= bytes.size()) return false;
+            out.append(bytes[id]);
+            return true;
+        });
+        QString seen;
+        for (int i = 0; i < 4; ++i) seen += raw.push(i);
+        Check(seen == QString::fromUtf8("😀"), "4-byte character held until complete");
+        Check(raw.push(4) == QString("!") && raw.push(5).isEmpty() && raw.push(6).isEmpty(), "ASCII passes through");
+        Check(raw.hasPendingBytes() && raw.flush() == QString(QChar(0xFFFD)), "flush replaces an unfinished character");
+        raw.reset();
+        Check(!raw.hasPendingBytes() && raw.tokenCount() == 0, "reset clears the stream");
+    }
+
+    BPETokenizer bpe;
+    SentencePieceTokenizer sp;
+    Check(BuildBpe(bpe) && bpe.isReady(), "BPE vocabulary loads");
+    Check(BuildSentencePiece(sp) && sp.isReady(), "SentencePiece vocabulary loads");
+
+    std::printf("%-14s %8s %8s %10s %8s\n", "tokenizer", "tokens", "split", "matches", "valid");
+    for (int run = 0; run < 2; ++run) {
+        const bool isBpe = run == 0;
+        bool allMatch = true, allValid = true;
+        size_t tokenTotal = 0;
+        int splitTotal = 0;
+        for (unsigned seed = 1; seed <= 20; ++seed) {
+            const QString reply = MakeReply(seed, 40 + int(seed) * 7);
+            std::vector<int32_t> tokens = isBpe ? bpe.encode(reply) : sp.encode(reply, true, true);
+            const QString full = isBpe ? bpe.decode(tokens) : sp.decode(tokens);
+            const StreamResult streamed = isBpe ? Stream(StreamingDetokenizer(bpe), tokens)
+                                                : Stream(StreamingDetokenizer(sp), tokens);
+            allMatch &= streamed.text == full && (!isBpe || full == reply);
+            allValid &= streamed.allValid;
+            tokenTotal += tokens.size();
+            splitTotal += streamed.emptyPushes;
+        }
+        std::printf("%-14s %8zu %8d %10s %8s\n", isBpe ? "BPE" : "SentencePiece", tokenTotal, splitTotal,
+                    allMatch ? "yes" : "NO", allValid ? "yes" : "NO");
+        Check(allMatch, isBpe ? "BPE stream equals decode()" : "SentencePiece stream equals decode()");
+        Check(allValid, "no chunk splits a character");
+        Check(splitTotal > 0, "vocabulary splits characters across tokens");
+    }
+
+    // Streaming a long reply: push() per token against re-running decode()
+    // over the reply so far at every step
+    const QString longReply = MakeReply(99, 3000);
+    const std::vector<int32_t> longTokens = sp.encode(longReply);
+    const size_t n = longTokens.size();
+    double incremental = 0.0, firstQuarter = 0.0, lastQuarter = 0.0;
+    {
+        StreamingDetokenizer detokenizer(sp);
+        QString text;
+        incremental = time_ms([&] {
+            for (size_t i = 0; i < n; ++i) {
+                const auto t0 = std::chrono::steady_clock::now();
+                text += detokenizer.push(longTokens[i]);
+                const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                if (i < n / 4) firstQuarter += ms;
+                if (i >= n - n / 4) lastQuarter += ms;
+            }
+            text += detokenizer.flush();
+        });
+        Check(text == sp.decode(longTokens), "long stream equals decode()");
+    }
+    const double redecode = time_ms([&] {
+        std::vector<int32_t> prefix;
+        prefix.reserve(n);
+        QString last;
+        for (size_t i = 0; i < n; ++i) {
+            prefix.push_back(longTokens[i]);
+            const QString all = sp.decode(prefix);
+            last = all.mid(last.size());  // The consumer's "new text"
+        }
+    });
+    std::printf("\n%zu tokens: incremental %.2f ms (%.0f ns/token), re-decode %.2f ms, %.0fx\n",
+                n, incremental, incremental * 1e6 / double(n), redecode, redecode / incremental);
+    std::printf("per-token cost, first vs last quarter: %.0f / %.0f ns\n",
+                firstQuarter * 1e6 / double(n / 4), lastQuarter * 1e6 / double(n / 4));
+    Check(redecode > incremental * 10.0, "incremental decode beats re-decoding by 10x");
+    Check(lastQuarter < firstQuarter * 3.0 + 1.0, "per-token cost independent of stream length");
+
+    if (failures) {
+        std::printf("❌ STREAMING-DETOKENIZER: %d check(s) failed\n", failures);
+        return 1;
+    }
+    std::puts("✅ STREAMING-DETOKENIZER: incremental output matches full decode");
+    return 0;
+}
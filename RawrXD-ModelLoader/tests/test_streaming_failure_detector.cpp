@@ -0,0 +1,294 @@
+// StreamingFailureDetector: the Aho-Corasick pattern set must report exactly
+// the case-insensitive occurrences a per-pattern search finds, phrases split
+// across tokens must still match, and a repetition loop must stop generation
+// within a few periods of starting without firing on non-repeating output,
+// including loops of 20-30 tokens under the engine's token budget.
+// Also compares per-token cost with re-checking the whole response.
+#include "streaming_failure_detector.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  ✗ %s\n", what);
+        ++failures;
+    }
+}
+
+template <typename Fn>
+double time_ms(Fn&& fn) {
+    const auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// The detector's default phrase lists
+const char* kRefusals[] = {
+    "I cannot", "I can't", "I'm not able to", "I am not able to", "I don't have the ability",
+    "I'm unable to", "I apologize, but I cannot", "Sorry, I can't", "I'm sorry, but I can't",
+    "As an AI", "As a language model", "I don't feel comfortable", "That would be inappropriate",
+    "I cannot assist with that", "I'm not programmed to", "I must decline", "I refuse to",
+};
+const char* kHallucinations[] = {
+    "According to my training data", "I remember that", "I recall", "I have personal experience",
+    "I was there when", "I personally", "In my opinion based on facts", "The documented evidence shows",
+};
+const char* kSafety[] = {
+    "illegal activity", "harmful content", "dangerous instructions", "how to harm", "how to hurt",
+    "violent content", "explicit sexual", "self-harm", "suicide instructions",
+};
+
+std::shared_ptr<FailurePatternSet> DefaultPatterns() {
+    auto set = std::make_shared<FailurePatternSet>();
+    for (const char* p : kSafety) set->add(QString(p), FailureType::SafetyViolation);
+    for (const char* p : kRefusals) set->add(QString(p), FailureType::Refusal);
+    for (const char* p : kHallucinations) set->add(QString(p), FailureType::Hallucination);
+    set->build();
+    return set;
+}
+
+QString Fold(const QString& text) {
+    QString out = text;
+    for (auto& c : out) c = FailurePatternSet::fold(c);
+    return out;
+}
+
+// (end offset, pattern index) of every match, by searching for each pattern
+std::set<std::pair<int, int>> ReferenceMatches(const FailurePatternSet& set, const QString& text) {
+    std::set<std::pair<int, int>> matches;
+    const QString folded = Fold(text);
+    for (int p = 0; p < set.patternCount(); ++p) {
+        const QString needle = Fold(set.pattern(p).text);
+        for (size_t at = folded.find(needle); at != QString::npos; at = folded.find(needle, at + 1)) {
+            matches.insert({int(at + needle.size()), p});
+        }
+    }
+    return matches;
+}
+
+std::set<std::pair<int, int>> AutomatonMatches(const FailurePatternSet& set, const QString& text) {
+    std::set<std::pair<int, int>> matches;
+    int32_t state = 0;
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        state = set.step(state, text[i].unicode());
+        for (int32_t node = set.output(state) >= 0 ? state : set.nextMatch(state); node >= 0; node = set.nextMatch(node)) {
+            matches.insert({int(i + 1), set.output(node)});
+        }
+    }
+    return matches;
+}
+
+// Plausible tokens: Zipf-distributed ids over a 32k vocabulary
+struct TokenSource {
+    std::mt19937 rng;
+    std::vector<double> cdf;
+    explicit TokenSource(unsigned seed) : rng(seed) {
+        double sum = 0.0;
+        for (int i = 1; i <= 32000; ++i) cdf.push_back(sum += 1.0 / i);
+        for (double& c : cdf) c /= sum;
+    }
+    int32_t next() {
+        const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return int32_t(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    }
+};
+
+// InferenceEngine::generate() with a scripted model: `preamble` random tokens,
+// then a cycle of `period` tokens, until the monitor stops it or the budget
+// runs out. Returns the number of tokens generated.
+int Generate(StreamingFailureDetector& monitor, int maxTokens, int preamble, int period, unsigned seed) {
+    TokenSource source(seed);
+    std::vector<int32_t> cycle;
+    for (int i = 0; i < period; ++i) cycle.push_back(source.next());
+    for (int i = 0; i < maxTokens; ++i) {
+        const int32_t token = i < preamble ? source.next() : cycle[size_t((i - preamble) % period)];
+        if (monitor.feedToken(token).isFailure()) return i + 1;
+    }
+    return maxTokens;
+}
+
+} // namespace
+
+int main() {
+    std::puts("=== StreamingFailureDetector ===");
+
+    // Overlapping, nested and non-ASCII patterns against a per-pattern search
+    {
+        FailurePatternSet set;
+        for (const char* p : {"he", "she", "his", "hers", "ushe", "a", "aa", "aaa", "Naïve", "ÜBER", "日本"}) {
+            set.add(QString::fromUtf8(p), FailureType::Refusal);
+        }
+        set.build();
+        const char* kAlphabet[] = {"h", "e", "s", "r", "i", "u", "a", "A", "S", "H", " ", "naïve", "NAÏVE", "über", "日本", "日"};
+        std::mt19937 rng(7);
+        bool same = true;
+        for (int trial = 0; trial < 300 && same; ++trial) {
+            std::string text;
+            for (int i = 0; i < 80; ++i) text += kAlphabet[rng() % (sizeof(kAlphabet) / sizeof(kAlphabet[0]))];
+            const QString q = QString::fromUtf8(text.data(), qsizetype(text.size()));
+            same = ReferenceMatches(set, q) == AutomatonMatches(set, q);
+        }
+        Check(same, "automaton matches equal per-pattern search");
+    }
+
+    const std::shared_ptr<const FailurePatternSet> patterns = DefaultPatterns();
+    StreamingFailureDetector::Options options;
+
+    // A refusal split across tokens, in any case
+    {
+        StreamingFailureDetector detector(patterns, options);
+        const char* kPieces[] = {"Well", ",", " i", " CAN", "NOT", " do", " that"};
+        int stoppedAt = -1;
+        for (int i = 0; i < 7 && stoppedAt < 0; ++i) {
+            if (detector.feedToken(100 + i, QString(kPieces[i])).isFailure()) stoppedAt = i;
+        }
+        Check(stoppedAt == 4, "refusal detected on the token that completes it");
+        Check(detector.failure().type == FailureType::Refusal && detector.failure().detectedPattern == "I cannot",
+              "refusal reports its pattern");
+        Check(detector.feedToken(1, QString(" more")).type == FailureType::Refusal, "failure is sticky");
+    }
+
+    // Priority within one chunk: safety before refusal, disabled types ignored
+    {
+        StreamingFailureDetector detector(patterns, options);
+        Check(detector.feedText(QString("As an AI I recall how to harm")).type == FailureType::SafetyViolation,
+              "safety outranks refusal and hallucination");
+        StreamingFailureDetector::Options noSafety = options;
+        noSafety.safety = false;
+        noSafety.refusal = false;
+        StreamingFailureDetector quiet(patterns, noSafety);
+        Check(quiet.feedText(QString("how to harm, as an AI")).type == FailureType::None, "disabled types are skipped");
+        Check(StreamingFailureDetector().feedText(QString("I cannot")).type == FailureType::None,
+              "default detector never reports");
+    }
+
+    // Loops: random tokens, then a cycle of `period` tokens
+    std::printf("\n%8s %10s %10s %10s\n", "period", "loop at", "stopped", "bound");
+    bool loopsCaught = true;
+    for (int period : {1, 7, 16, 23, 64, 200}) {
+        TokenSource source{unsigned(period)};
+        StreamingFailureDetector detector(patterns, options);
+        std::vector<int32_t> cycle;
+        for (int i = 0; i < period; ++i) cycle.push_back(source.next());
+        const int loopStart = 300;
+        int stoppedAt = -1;
+        for (int i = 0; i < 4096 && stoppedAt < 0; ++i) {
+            const int32_t token = i < loopStart ? source.next() : cycle[size_t((i - loopStart) % period)];
+            if (detector.feedToken(token).isFailure()) stoppedAt = i;
+        }
+        // The n-gram ending at the first full window of the loop recurs once
+        // per period; the repeatThreshold-th sighting stops generation
+        const int bound = loopStart + std::max(options.tokenGram, period) + (options.repeatThreshold - 1) * period;
+        std::printf("%8d %10d %10d %10s\n", period, loopStart, stoppedAt,
+                    stoppedAt >= loopStart && stoppedAt <= bound ? "ok" : "LATE");
+        loopsCaught &= stoppedAt >= loopStart && stoppedAt <= bound &&
+                       detector.failure().type == FailureType::InfiniteLoop;
+    }
+    Check(loopsCaught, "loops stop within a few periods of the n-gram");
+
+    // The engine's monitor under its token budget. With the default 32-token
+    // n-gram, 50 tokens only fit loops of period 6 or less
+    {
+        bool early = true;
+        for (int period = 20; period <= 30; ++period) {
+            StreamingFailureDetector monitor = StreamingFailureDetector::loopMonitor(128);
+            early &= Generate(monitor, 128, 8, period, unsigned(period)) < 128 &&
+                     monitor.failure().type == FailureType::InfiniteLoop;
+        }
+        Check(early, "20-30 token loops end a 128-token generation early");
+
+        StreamingFailureDetector::Options loopsOnly;
+        loopsOnly.refusal = loopsOnly.hallucination = loopsOnly.safety = false;
+        StreamingFailureDetector uncapped(nullptr, loopsOnly);
+        StreamingFailureDetector capped = StreamingFailureDetector::loopMonitor(50);
+        Check(Generate(uncapped, 50, 0, 12, 3) == 50 && Generate(capped, 50, 0, 12, 3) < 50,
+              "a 12-token loop ends a 50-token generation only with the capped n-gram");
+    }
+
+    // Repetitive code: the same 20-token statement three times, with
+    // different lines between, is not a loop
+    {
+        TokenSource source(7);
+        std::vector<int32_t> statement;
+        for (int i = 0; i < 20; ++i) statement.push_back(source.next());
+        StreamingFailureDetector detector(patterns, options);
+        for (int block = 0; block < 3; ++block) {
+            for (int32_t token : statement) detector.feedToken(token);
+            for (int i = 0; i < 40; ++i) detector.feedToken(source.next());
+        }
+        Check(!detector.shouldStop(), "repeated boilerplate is not a loop");
+    }
+
+    {
+        int falseAlarms = 0;
+        for (unsigned seed = 100; seed < 110; ++seed) {
+            TokenSource source(seed);
+            StreamingFailureDetector detector(patterns, options);
+            for (int i = 0; i < 20000; ++i) {
+                if (detector.feedToken(source.next()).isFailure()) { ++falseAlarms; break; }
+            }
+        }
+        Check(falseAlarms == 0, "no loop reported on non-repeating streams");
+    }
+
+    // Text-only streams: character n-grams
+    {
+        StreamingFailureDetector detector(patterns, options);
+        QString sentence("The function returns the cached value for the key. ");
+        bool stopped = false;
+        int chunks = 0;
+        for (; chunks < 100 && !stopped; ++chunks) stopped = detector.feedText(sentence).isFailure();
+        Check(stopped && chunks <= 5 && detector.failure().type == FailureType::InfiniteLoop,
+              "repeated sentence stops a text stream");
+    }
+
+    // Cost per token: incremental check vs re-scanning the whole response
+    // with every pattern, as a post-hoc check repeated each step would
+    {
+        const int n = 4000;
+        TokenSource source(42);
+        std::vector<int32_t> tokens;
+        std::vector<QString> pieces;
+        const char* kWords[] = {" the", " model", " returns", " value", " cache", " for", " key", ".", "\n", " and"};
+        for (int i = 0; i < n; ++i) {
+            tokens.push_back(source.next());
+            pieces.push_back(QString(kWords[size_t(tokens.back()) % 10]));
+        }
+        StreamingFailureDetector detector(patterns, options);
+        const double incremental = time_ms([&] {
+            for (int i = 0; i < n; ++i) detector.feedToken(tokens[size_t(i)], pieces[size_t(i)]);
+        });
+        std::vector<QString> folded;
+        for (int p = 0; p < patterns->patternCount(); ++p) folded.push_back(Fold(patterns->pattern(p).text));
+        int hits = 0;
+        const double rescan = time_ms([&] {
+            QString response;
+            for (int i = 0; i < n; ++i) {
+                response += pieces[size_t(i)];
+                const QString text = Fold(response);
+                for (const QString& needle : folded) hits += text.find(needle) != QString::npos;
+            }
+        });
+        std::printf("\n%d tokens: incremental %.2f ms (%.0f ns/token), full re-check %.1f ms, %.0fx\n",
+                    n, incremental, incremental * 1e6 / n, rescan, rescan / incremental);
+        Check(!detector.shouldStop() && hits == 0, "benign response passes");
+        Check(rescan > incremental * 10.0, "incremental check beats re-checking by 10x");
+    }
+
+    if (failures) {
+        std::printf("❌ STREAMING-FAILURE-DETECTOR: %d check(s) failed\n", failures);
+        return 1;
+    }
+    std::puts("✅ STREAMING-FAILURE-DETECTOR: phrases and loops caught while generating");
+    return 0;
+}
@@ -0,0 +1,185 @@
+// Streaming loader test: writes a small multi-zone GGUF to disk, then checks
+// tensor contents, background prefetch of the next zone, the LRU memory
+// budget, the residency counters and pinned zero-copy tensor views.
+#include "streaming_gguf_loader.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kTensorFloats = 64 * 1024;            // 256 KB per tensor
+constexpr uint64_t kZoneBytes = 8 * kTensorFloats * 4;   // 8 layers per zone = 2 MB
+constexpr int kLayers = 24;                               // layers_0 .. layers_2
+
+int failures = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "  ✗ " << what << std::endl;
+        ++failures;
+    }
+}
+
+struct Writer {
+    std::vector<uint8_t> bytes;
+    template<typename T>
+    void Put(T v) {
+        const size_t at = bytes.size();
+        bytes.resize(at + sizeof(T));
+        std::memcpy(bytes.data() + at, &v, sizeof(T));
+    }
+    void PutString(const std::string& s) {
+        Put<uint64_t>(s.size());
+        bytes.insert(bytes.end(), s.begin(), s.end());
+    }
+};
+
+std::vector<std::string> TensorNames() {
+    std::vector<std::string> names = {"token_embd.weight"};
+    for (int i = 0; i < kLayers; ++i) names.push_back("blk." + std::to_string(i) + ".ffn_up.weight");
+    names.push_back("output.weight");
+    return names;
+}
+
+// Every float of tensor i holds i, so misplaced reads are easy to spot
+bool WriteModel(const std::string& path) {
+    const std::vector<std::string> names = TensorNames();
+    Writer w;
+    w.Put<uint32_t>(gguf::Parser::kMagic);
+    w.Put<uint32_t>(3);
+    w.Put<uint64_t>(names.size());
+    w.Put<uint64_t>(1);
+    w.PutString("general.architecture");
+    w.Put<uint32_t>(static_cast<uint32_t>(gguf::ValueType::STRING));
+    w.PutString("llama");
+    for (size_t i = 0; i < names.size(); ++i) {
+        w.PutString(names[i]);
+        w.Put<uint32_t>(1);
+        w.Put<uint64_t>(kTensorFloats);
+        w.Put<uint32_t>(0);  // F32
+        w.Put<uint64_t>(i * kTensorFloats * 4);
+    }
+    const size_t data_start = (w.bytes.size() + 31) / 32 * 32;
+    w.bytes.resize(data_start + names.size() * kTensorFloats * 4, 0);
+    for (size_t i = 0; i < names.size(); ++i) {
+        float* dst = reinterpret_cast<float*>(w.bytes.data() + data_start + i * kTensorFloats * 4);
+        for (uint64_t j = 0; j < kTensorFloats; ++j) dst[j] = static_cast<float>(i);
+    }
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(w.bytes.data()), static_cast<std::streamsize>(w.bytes.size()));
+    return out.good();
+}
+
+bool TensorHolds(StreamingGGUFLoader& loader, const std::string& name, float expected) {
+    std::vector<uint8_t> data;
+    if (!loader.GetTensorData(name, data) || data.size() != kTensorFloats * 4) return false;
+    const float* f = reinterpret_cast<const float*>(data.data());
+    return f[0] == expected && f[kTensorFloats - 1] == expected;
+}
+
+bool WaitForZone(StreamingGGUFLoader& loader, const std::string& zone) {
+    for (int i = 0; i < 500; ++i) {
+        if (loader.GetZoneInfo(zone).is_loaded) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return false;
+}
+
+} // namespace
+
+int main() {
+    std::cout << "=== Streaming GGUF Loader Test ===" << std::endl;
+
+    const std::string path = "test_streaming_gguf_loader.gguf";
+    if (!WriteModel(path)) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return 1;
+    }
+
+    StreamingGGUFLoader loader;
+    if (!loader.Open(path)) {
+        std::cerr << "Failed to open " << path << std::endl;
+        std::remove(path.c_str());
+        return 1;
+    }
+    Check(loader.GetAllZones().size() == 5, "embedding, three layer zones, output_head");
+
+    std::cout << "Test 1: tensor data and next-zone prefetch..." << std::endl;
+    loader.SetMemoryBudgetMB(5);  // Room for two 2 MB zones
+    Check(TensorHolds(loader, "blk.3.ffn_up.weight", 4.0f), "blk.3 contents");
+    Check(TensorHolds(loader, "blk.0.ffn_up.weight", 1.0f), "blk.0 contents (same zone)");
+    Check(WaitForZone(loader, "layers_1"), "layers_1 prefetched in the background");
+    ZoneStreamStats stats = loader.GetStreamStats();
+    Check(stats.stalls == 1 && stats.hits == 1, "one synchronous load, then a hit");
+    Check(stats.prefetched_zones == 1, "prefetch counted");
+
+    Check(TensorHolds(loader, "blk.9.ffn_up.weight", 10.0f), "blk.9 served from the prefetched zone");
+    stats = loader.GetStreamStats();
+    Check(stats.stalls == 1 && stats.prefetch_hits == 1, "prefetched zone used without a stall");
+
+    std::cout << "Test 2: LRU eviction under the memory budget..." << std::endl;
+    Check(WaitForZone(loader, "layers_2"), "layers_2 prefetched");
+    Check(TensorHolds(loader, "blk.20.ffn_up.weight", 21.0f), "blk.20 contents");
+    stats = loader.GetStreamStats();
+    Check(stats.resident_bytes <= 5 * 1024 * 1024, "resident set within budget");
+    Check(!loader.GetZoneInfo("layers_0").is_loaded, "least recently used zone evicted");
+    Check(loader.GetZoneInfo("layers_2").is_loaded, "current zone resident");
+    Check(stats.evictions >= 1, "eviction counted");
+
+    std::cout << "Test 3: stalls without prefetch..." << std::endl;
+    loader.SetAutoPrefetch(false);
+    Check(loader.UnloadZone("layers_1") && loader.UnloadZone("layers_2"), "explicit unload");
+    const uint64_t stalls_before = loader.GetStreamStats().stalls;
+    Check(TensorHolds(loader, "blk.8.ffn_up.weight", 9.0f), "blk.8 reloaded");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Check(!loader.GetZoneInfo("layers_2").is_loaded, "no prefetch when disabled");
+    stats = loader.GetStreamStats();
+    Check(stats.stalls == stalls_before + 1, "reload counted as a stall");
+    Check(stats.bytes_read >= 4 * kZoneBytes, "bytes read accumulate across both paths");
+
+    std::cout << "Test 4: zero-copy views pin their zone..." << std::endl;
+    const TensorRef* ref = loader.FindTensor("blk.17.ffn_up.weight");
+    Check(ref && ref->zone_name == "layers_2" && ref->zone_offset == kTensorFloats * 4, "precomputed zone offset");
+    Check(!loader.FindTensor("blk.99.ffn_up.weight"), "unknown tensor not found");
+    {
+        TensorView view = loader.GetTensorView("blk.17.ffn_up.weight");
+        Check(view && view.size() == kTensorFloats * 4, "view size");
+        Check(view && reinterpret_cast<const float*>(view.data())[7] == 18.0f, "view contents");
+
+        loader.SetMemoryBudgetMB(2);  // Only one zone fits
+        Check(TensorHolds(loader, "blk.2.ffn_up.weight", 3.0f), "other zone loads past the pinned one");
+        Check(loader.GetZoneInfo("layers_2").is_loaded, "pinned zone survives eviction pressure");
+        Check(!loader.UnloadZone("layers_2"), "pinned zone refuses to unload");
+        Check(reinterpret_cast<const float*>(view.data())[0] == 18.0f, "view still valid");
+
+        TensorView moved = std::move(view);
+        Check(!view && moved, "view ownership moves");
+    }
+    Check(loader.UnloadZone("layers_2"), "zone unloads once views are gone");
+
+    std::cout << "Test 5: default LoadZone keeps the budget..." << std::endl;
+    IGGUFLoader& base = loader;
+    Check(base.LoadZone("layers_0") && base.LoadZone("layers_1"), "zones load through the interface");
+    Check(loader.GetStreamStats().resident_bytes <= 2 * 1024 * 1024, "SetMemoryBudgetMB still applies");
+
+    const std::vector<TensorRef> index = loader.GetTensorIndex();
+    bool ordered = true;
+    for (size_t i = 1; i < index.size(); ++i) ordered &= index[i - 1].offset < index[i].offset;
+    Check(ordered && index.size() == TensorNames().size(), "index in file order");
+
+    loader.Close();
+    std::remove(path.c_str());
+
+    if (failures) {
+        std::cerr << "\n=== " << failures << " CHECK(S) FAILED ===" << std::endl;
+        return 1;
+    }
+    std::cout << "\n=== ALL STREAMING LOADER TESTS PASSED ===" << std::endl;
+    return 0;
+}